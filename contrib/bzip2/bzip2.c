@@ -209,6 +209,7 @@ Char    *progName;
 Char    progNameReally[FILE_NAME_LEN];
 FILE    *outputHandleJustInCase;
 Int32   workFactor;
+Int32   numThreads;
 
 static void    panic                 ( const Char* ) NORETURN;
 static void    ioError               ( void )        NORETURN;
@@ -341,8 +342,8 @@ void compressStream ( FILE *stream, FILE *zStream )
    if (ferror(stream)) goto errhandler_io;
    if (ferror(zStream)) goto errhandler_io;
 
-   bzf = BZ2_bzWriteOpen ( &bzerr, zStream, 
-                           blockSize100k, verbosity, workFactor );   
+   bzf = BZ2_bzWriteOpenMT ( &bzerr, zStream, blockSize100k,
+                             verbosity, workFactor, numThreads );
    if (bzerr != BZ_OK) goto errhandler;
 
    if (verbosity >= 2) fprintf ( stderr, "\n" );
@@ -451,9 +452,9 @@ Bool uncompressStream ( FILE *zStream, FILE *stream )
 
    while (True) {
 
-      bzf = BZ2_bzReadOpen ( 
+      bzf = BZ2_bzReadOpenMT ( 
                &bzerr, zStream, verbosity, 
-               (int)smallMode, unused, nUnused
+               (int)smallMode, unused, nUnused, numThreads
             );
       if (bzf == NULL || bzerr != BZ_OK) goto errhandler;
       streamNo++;
@@ -569,9 +570,9 @@ Bool testStream ( FILE *zStream )
 
    while (True) {
 
-      bzf = BZ2_bzReadOpen ( 
+      bzf = BZ2_bzReadOpenMT ( 
                &bzerr, zStream, verbosity, 
-               (int)smallMode, unused, nUnused
+               (int)smallMode, unused, nUnused, numThreads
             );
       if (bzf == NULL || bzerr != BZ_OK) goto errhandler;
       streamNo++;
@@ -1646,6 +1647,7 @@ void usage ( Char *fullProgName )
       "   -1 .. -9            set block size to 100k .. 900k\n"
       "   --fast              alias for -1\n"
       "   --best              alias for -9\n"
+      "   --threads=N         use N threads (0: one per CPU)\n"
       "\n"
       "   If invoked as `bzip2', default action is to compress.\n"
       "              as `bunzip2',  default action is to decompress.\n"
@@ -1800,6 +1802,7 @@ IntNative main ( IntNative argc, Char *argv[] )
    numFileNames            = 0;
    numFilesProcessed       = 0;
    workFactor              = 30;
+   numThreads              = 1;
    deleteOutputOnInterrupt = False;
    exitValue               = 0;
    i = j = 0; /* avoid bogus warning from egcs-1.1.X */
@@ -1928,6 +1931,18 @@ IntNative main ( IntNative argc, Char *argv[] )
       if (ISFLAG("--verbose"))           verbosity++;                else
       if (ISFLAG("--help"))              { usage ( progName ); exit ( 0 ); }
          else
+      if (strncmp ( aa->name, "--threads=", 10) == 0) {
+         Char* end;
+         long  n = strtol ( aa->name + 10, &end, 10 );
+         if (end == aa->name + 10 || *end != '\0' || n < 0 || n > 256) {
+            fprintf ( stderr, "%s: Bad thread count `%s'\n",
+                      progName, aa->name + 10 );
+            usage ( progName );
+            exit ( 1 );
+         }
+         numThreads = (Int32)n;
+      }
+         else
          if (strncmp ( aa->name, "--", 2) == 0) {
             fprintf ( stderr, "%s: Bad flag `%s'\n", progName, aa->name );
             usage ( progName );
@@ -1936,6 +1951,12 @@ IntNative main ( IntNative argc, Char *argv[] )
    }
 
    if (verbosity > 4) verbosity = 4;
+   if (numThreads == 0) {
+#     if BZ_UNIX
+      numThreads = (Int32)sysconf ( _SC_NPROCESSORS_ONLN );
+#     endif
+      if (numThreads < 1) numThreads = 1;
+   }
    if (opMode == OM_Z && smallMode && blockSize100k > 2) 
       blockSize100k = 2;
 
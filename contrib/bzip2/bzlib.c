@@ -33,6 +33,17 @@ __FBSDID("$FreeBSD$");
 
 #include "bzlib_private.h"
 
+#ifdef BZ_THREADS
+#include <pthread.h>
+
+#ifndef BZ_NO_COMPRESS
+static int  cmt_compress   ( bz_stream* strm, int action );
+static void cmt_free       ( bz_stream* strm );
+#endif
+static int  dmt_decompress ( bz_stream* strm );
+static void dmt_free       ( bz_stream* strm );
+#endif
+
 #ifndef BZ_NO_COMPRESS
 
 /*---------------------------------------------------*/
@@ -418,6 +429,9 @@ int BZ_API(BZ2_bzCompress) ( bz_stream *strm, int action )
    s = strm->state;
    if (s == NULL) return BZ_PARAM_ERROR;
    if (s->strm != strm) return BZ_PARAM_ERROR;
+#ifdef BZ_THREADS
+   if (s->mode == BZ_M_THREADED) return cmt_compress ( strm, action );
+#endif
 
    preswitch:
    switch (s->mode) {
@@ -478,6 +492,12 @@ int BZ_API(BZ2_bzCompressEnd)  ( bz_stream *strm )
    s = strm->state;
    if (s == NULL) return BZ_PARAM_ERROR;
    if (s->strm != strm) return BZ_PARAM_ERROR;
+#ifdef BZ_THREADS
+   if (s->mode == BZ_M_THREADED) {
+      cmt_free ( strm );
+      return BZ_OK;
+   }
+#endif
 
    if (s->arr1 != NULL) BZFREE(s->arr1);
    if (s->arr2 != NULL) BZFREE(s->arr2);
@@ -820,6 +840,9 @@ int BZ_API(BZ2_bzDecompress) ( bz_stream *strm )
    s = strm->state;
    if (s == NULL) return BZ_PARAM_ERROR;
    if (s->strm != strm) return BZ_PARAM_ERROR;
+#ifdef BZ_THREADS
+   if (s->state == BZ_X_THREADED) return dmt_decompress ( strm );
+#endif
 
    while (True) {
       if (s->state == BZ_X_IDLE) return BZ_SEQUENCE_ERROR;
@@ -873,6 +896,12 @@ int BZ_API(BZ2_bzDecompressEnd)  ( bz_stream *strm )
    s = strm->state;
    if (s == NULL) return BZ_PARAM_ERROR;
    if (s->strm != strm) return BZ_PARAM_ERROR;
+#ifdef BZ_THREADS
+   if (s->state == BZ_X_THREADED) {
+      dmt_free ( strm );
+      return BZ_OK;
+   }
+#endif
 
    if (s->tt   != NULL) BZFREE(s->tt);
    if (s->ll16 != NULL) BZFREE(s->ll16);
@@ -884,6 +913,1283 @@ int BZ_API(BZ2_bzDecompressEnd)  ( bz_stream *strm )
    return BZ_OK;
 }
 
+/*---------------------------------------------------*/
+/*--- Multithreaded front ends                    ---*/
+/*---------------------------------------------------*/
+
+/*--
+   A bzip2 stream is a header followed by blocks that are
+   coded independently; only the combined CRC in the
+   trailer ties them together, and blocks are not byte
+   aligned.
+
+   The threaded compressor fills blocks on the caller's
+   thread (the run-length state flows from one block into
+   the next, so this part is inherently serial and cheap),
+   hands each full block to a worker for sorting and coding,
+   and splices the coded blocks back together in order at
+   the bit level.  The result is byte-for-byte what the
+   serial compressor produces.
+
+   The threaded decompressor finds block boundaries by
+   scanning for the 48-bit block and end-of-stream magics.
+   Each block is wrapped in a synthetic one-block stream and
+   handed to a worker, which decodes it with the ordinary
+   decoder and so checks its CRC.  A magic that turns up by
+   chance inside coded data makes the blocks on either side
+   of it fail; a failed block is joined with its successor
+   and decoded again.  An end-of-stream magic is only
+   believed once the block before it decodes and the stream
+   CRC agrees.  Whenever a block cannot be placed this way,
+   the rest of the stream goes to the serial decoder, so the
+   scan never turns a valid stream into an error.
+
+   Memory touched by the workers comes from malloc() rather
+   than strm->bzalloc, which need not be thread-safe.
+--*/
+
+#ifdef BZ_THREADS
+
+#define BZ_MT_MAX_THREADS  256
+
+/*-- Largest span of coded bits we accept as one block. --*/
+#define BZ_MT_MAX_SEGMENT  (5 * 1024 * 1024)
+
+/*-- Input is scanned in pieces of this size. --*/
+#define BZ_MT_CHUNK        (64 * 1024)
+
+#define BZ_MT_BLOCK_MAGIC  0x314159265359ULL
+#define BZ_MT_EOS_MAGIC    0x177245385090ULL
+#define BZ_MT_MAGIC_MASK   0xffffffffffffULL
+
+static
+void mt_add_total ( unsigned int* lo32, unsigned int* hi32, UInt32 n )
+{
+   UInt32 old = *lo32;
+   *lo32 += n;
+   if (*lo32 < old) (*hi32)++;
+}
+
+
+/*---------------------------------------------------*/
+/*-- A minimal big-endian bit writer, as bsW does it. --*/
+
+typedef
+   struct {
+      UChar*  buf;
+      UInt32  pos;      /* bytes written */
+      UInt32  buff;
+      Int32   live;
+   }
+   MTBits;
+
+static __inline__
+void mt_bits_put ( MTBits* w, Int32 n, UInt32 v )
+{
+   while (w->live >= 8) {
+      w->buf[w->pos++] = (UChar)(w->buff >> 24);
+      w->buff <<= 8;
+      w->live -= 8;
+   }
+   w->buff |= (v << (32 - w->live - n));
+   w->live += n;
+}
+
+static
+void mt_bits_finish ( MTBits* w )
+{
+   while (w->live > 0) {
+      w->buf[w->pos++] = (UChar)(w->buff >> 24);
+      w->buff <<= 8;
+      w->live -= 8;
+   }
+   w->live = 0;
+}
+
+/*-- Append nbits bits of src, starting at bit sbit. --*/
+static
+void mt_bits_copy ( MTBits* w, const UChar* src, UInt32 sbit, UInt32 nbits )
+{
+   UInt32 i   = sbit >> 3;
+   Int32  sh  = sbit & 7;
+
+   if (sh != 0 && nbits > 0) {
+      Int32 n = 8 - sh;
+      if ((UInt32)n > nbits) n = nbits;
+      mt_bits_put ( w, n, (src[i] >> (8 - sh - n)) & ((1 << n) - 1) );
+      nbits -= n;
+      i++;
+   }
+   while (nbits >= 8) {
+      mt_bits_put ( w, 8, src[i++] );
+      nbits -= 8;
+   }
+   if (nbits > 0)
+      mt_bits_put ( w, nbits, src[i] >> (8 - nbits) );
+}
+
+
+#ifndef BZ_NO_COMPRESS
+
+/*---------------------------------------------------*/
+/*-- Threaded compression.                         --*/
+
+#define CJ_FREE     0
+#define CJ_FILLING  1
+#define CJ_QUEUED   2
+#define CJ_RUNNING  3
+#define CJ_DONE     4
+
+typedef
+   struct {
+      bz_stream strm;        /* owns this block's EState */
+      Int32     state;
+   }
+   CJob;
+
+typedef
+   struct {
+      /* must match the start of EState */
+      bz_stream* strm;
+      Int32      mode;
+
+      Int32      action;     /* BZ_M_RUNNING etc. */
+      UInt32     avail_in_expect;
+      Int32      blockSize100k;
+
+      pthread_mutex_t lock;
+      pthread_cond_t  work_cv;
+      pthread_cond_t  done_cv;
+      pthread_t* threads;
+      Int32      nThreads;
+      Int32      nStarted;
+      Bool       shutdown;
+
+      /* ring of blocks; seq % nJobs picks the slot */
+      CJob*      jobs;
+      Int32      nJobs;
+      UInt32     seqFill;    /* block being filled */
+      UInt32     seqRun;     /* next block for a worker */
+      UInt32     seqEmit;    /* next block to splice */
+      Bool       filling;
+
+      /* run-length state carried between blocks */
+      UInt32     carry_ch;
+      Int32      carry_len;
+
+      /* spliced output not yet handed to the caller */
+      MTBits     out;
+      UInt32     outPos;
+      UInt32     combinedCRC;
+      Bool       trailerDone;
+   }
+   CMTState;
+
+
+static
+void* cmt_worker ( void* arg )
+{
+   CMTState* m = arg;
+   CJob*     j;
+
+   pthread_mutex_lock ( &m->lock );
+   while (True) {
+      while (!m->shutdown && m->seqRun == m->seqFill)
+         pthread_cond_wait ( &m->work_cv, &m->lock );
+      if (m->shutdown) break;
+      j = &m->jobs[m->seqRun % m->nJobs];
+      m->seqRun++;
+      j->state = CJ_RUNNING;
+      pthread_mutex_unlock ( &m->lock );
+
+      BZ2_bsInitWrite ( (EState*)j->strm.state );
+      BZ2_compressBlock ( (EState*)j->strm.state, False );
+
+      pthread_mutex_lock ( &m->lock );
+      j->state = CJ_DONE;
+      pthread_cond_broadcast ( &m->done_cv );
+   }
+   pthread_mutex_unlock ( &m->lock );
+   return NULL;
+}
+
+
+/*-- The slot for seqFill, ready for input; NULL if still busy. --*/
+static
+EState* cmt_filling ( CMTState* m )
+{
+   CJob*   j = &m->jobs[m->seqFill % m->nJobs];
+   EState* s = j->strm.state;
+
+   if (m->filling) return s;
+   if (m->seqFill - m->seqEmit >= (UInt32)m->nJobs) return NULL;
+
+   prepare_new_block ( s );
+   /*-- Any number but 1 keeps BZ2_compressBlock from
+        writing a stream header. --*/
+   s->blockNo      = 2;
+   s->state_in_ch  = m->carry_ch;
+   s->state_in_len = m->carry_len;
+   j->state        = CJ_FILLING;
+   m->filling      = True;
+   return s;
+}
+
+
+static
+Bool cmt_fill ( CMTState* m, EState* s )
+{
+   bz_stream* strm = m->strm;
+   UInt32     n = 0;
+
+   while (s->nblock < s->nblockMAX && strm->avail_in > 0) {
+      if (m->action != BZ_M_RUNNING) {
+         if (m->avail_in_expect == 0) break;
+         m->avail_in_expect--;
+      }
+      ADD_CHAR_TO_BLOCK ( s, (UInt32)(*((UChar*)(strm->next_in))) );
+      strm->next_in++;
+      strm->avail_in--;
+      n++;
+   }
+   mt_add_total ( &strm->total_in_lo32, &strm->total_in_hi32, n );
+   return n > 0;
+}
+
+
+static
+void cmt_submit ( CMTState* m )
+{
+   CJob*   j = &m->jobs[m->seqFill % m->nJobs];
+   EState* s = j->strm.state;
+
+   m->carry_ch  = s->state_in_ch;
+   m->carry_len = s->state_in_len;
+   m->filling   = False;
+   if (s->nblock == 0) {
+      j->state = CJ_FREE;
+      return;
+   }
+
+   pthread_mutex_lock ( &m->lock );
+   j->state = CJ_QUEUED;
+   m->seqFill++;
+   if (m->nStarted < m->nThreads &&
+       pthread_create ( &m->threads[m->nStarted], NULL,
+                        cmt_worker, m ) == 0)
+      m->nStarted++;
+   pthread_cond_signal ( &m->work_cv );
+   pthread_mutex_unlock ( &m->lock );
+
+   if (m->nStarted == 0) {
+      /*-- No threads to be had; do the work here. --*/
+      m->seqRun++;
+      BZ2_bsInitWrite ( s );
+      BZ2_compressBlock ( s, False );
+      j->state = CJ_DONE;
+   }
+}
+
+
+/*-- Splice the oldest block onto the output if it is coded,
+     or, if wait is set, once it is.  Only done when the
+     previous output has been collected, which bounds the
+     output buffer to one coded block. --*/
+static
+Bool cmt_splice ( CMTState* m, Bool wait )
+{
+   CJob*   j;
+   EState* s;
+   Int32   i;
+
+   if (m->seqEmit == m->seqFill || m->outPos < m->out.pos)
+      return False;
+   j = &m->jobs[m->seqEmit % m->nJobs];
+
+   pthread_mutex_lock ( &m->lock );
+   if (j->state != CJ_DONE && !wait) {
+      pthread_mutex_unlock ( &m->lock );
+      return False;
+   }
+   while (j->state != CJ_DONE)
+      pthread_cond_wait ( &m->done_cv, &m->lock );
+   pthread_mutex_unlock ( &m->lock );
+
+   s = j->strm.state;
+   m->out.pos = m->outPos = 0;
+   for (i = 0; i < s->numZ; i++)
+      mt_bits_put ( &m->out, 8, s->zbits[i] );
+   /*-- The tail of the block is still in the bit buffer. --*/
+   for (i = 0; i + 8 <= s->bsLive; i += 8)
+      mt_bits_put ( &m->out, 8, (s->bsBuff >> (24 - i)) & 0xff );
+   if (i < s->bsLive)
+      mt_bits_put ( &m->out, s->bsLive - i,
+                    (s->bsBuff >> (32 - s->bsLive)) &
+                    ((1 << (s->bsLive - i)) - 1) );
+
+   m->combinedCRC = (m->combinedCRC << 1) | (m->combinedCRC >> 31);
+   m->combinedCRC ^= s->blockCRC;
+   j->state = CJ_FREE;
+   m->seqEmit++;
+   return True;
+}
+
+
+static
+Bool cmt_copy_out ( CMTState* m )
+{
+   bz_stream* strm = m->strm;
+   UInt32     n = m->out.pos - m->outPos;
+
+   if (n > strm->avail_out) n = strm->avail_out;
+   if (n == 0) return False;
+   memcpy ( strm->next_out, m->out.buf + m->outPos, n );
+   m->outPos       += n;
+   strm->next_out  += n;
+   strm->avail_out -= n;
+   mt_add_total ( &strm->total_out_lo32, &strm->total_out_hi32, n );
+   return True;
+}
+
+
+static
+Bool cmt_all_out ( CMTState* m )
+{
+   return m->avail_in_expect == 0 && !m->filling &&
+          m->carry_ch >= 256 && m->seqEmit == m->seqFill &&
+          m->outPos == m->out.pos;
+}
+
+
+static
+int cmt_compress ( bz_stream* strm, int action )
+{
+   CMTState* m = strm->state;
+   EState*   s;
+   Bool      progress = False;
+
+   switch (m->action) {
+      case BZ_M_IDLE:
+         return BZ_SEQUENCE_ERROR;
+      case BZ_M_RUNNING:
+         if (action == BZ_RUN) break;
+         if (action != BZ_FLUSH && action != BZ_FINISH)
+            return BZ_PARAM_ERROR;
+         m->avail_in_expect = strm->avail_in;
+         m->action = (action == BZ_FLUSH) ? BZ_M_FLUSHING
+                                          : BZ_M_FINISHING;
+         break;
+      case BZ_M_FLUSHING:
+         if (action != BZ_FLUSH) return BZ_SEQUENCE_ERROR;
+         if (m->avail_in_expect != strm->avail_in)
+            return BZ_SEQUENCE_ERROR;
+         break;
+      case BZ_M_FINISHING:
+         if (action != BZ_FINISH) return BZ_SEQUENCE_ERROR;
+         if (m->avail_in_expect != strm->avail_in)
+            return BZ_SEQUENCE_ERROR;
+         break;
+   }
+
+   while (True) {
+      progress |= cmt_copy_out ( m );
+      if (m->outPos < m->out.pos) break;
+
+      if (cmt_splice ( m, False )) continue;
+
+      if (strm->avail_in > 0 &&
+          (m->action == BZ_M_RUNNING || m->avail_in_expect > 0)) {
+         s = cmt_filling ( m );
+         if (s == NULL) {
+            cmt_splice ( m, True );
+            continue;
+         }
+         progress |= cmt_fill ( m, s );
+         if (s->nblock >= s->nblockMAX) cmt_submit ( m );
+         continue;
+      }
+      if (m->action == BZ_M_RUNNING) break;
+
+      /*-- Flushing or finishing, and all the input is in. --*/
+      if (m->filling || m->carry_ch < 256) {
+         s = cmt_filling ( m );
+         if (s == NULL) {
+            cmt_splice ( m, True );
+            continue;
+         }
+         flush_RL ( s );
+         cmt_submit ( m );
+         continue;
+      }
+      if (m->seqEmit != m->seqFill) {
+         cmt_splice ( m, True );
+         continue;
+      }
+      if (m->action == BZ_M_FINISHING && !m->trailerDone) {
+         m->out.pos = m->outPos = 0;
+         mt_bits_put ( &m->out, 8, 0x17 ); mt_bits_put ( &m->out, 8, 0x72 );
+         mt_bits_put ( &m->out, 8, 0x45 ); mt_bits_put ( &m->out, 8, 0x38 );
+         mt_bits_put ( &m->out, 8, 0x50 ); mt_bits_put ( &m->out, 8, 0x90 );
+         mt_bits_put ( &m->out, 16, m->combinedCRC >> 16 );
+         mt_bits_put ( &m->out, 16, m->combinedCRC & 0xffff );
+         mt_bits_finish ( &m->out );
+         m->trailerDone = True;
+         continue;
+      }
+      break;
+   }
+
+   switch (m->action) {
+      case BZ_M_RUNNING:
+         return progress ? BZ_RUN_OK : BZ_PARAM_ERROR;
+      case BZ_M_FLUSHING:
+         if (!cmt_all_out ( m )) return BZ_FLUSH_OK;
+         m->action = BZ_M_RUNNING;
+         return BZ_RUN_OK;
+      default:
+         if (!progress) return BZ_SEQUENCE_ERROR;
+         if (!cmt_all_out ( m ) || !m->trailerDone) return BZ_FINISH_OK;
+         m->action = BZ_M_IDLE;
+         return BZ_STREAM_END;
+   }
+}
+
+
+static
+void cmt_free ( bz_stream* strm )
+{
+   CMTState* m = strm->state;
+   Int32 i;
+
+   pthread_mutex_lock ( &m->lock );
+   m->shutdown = True;
+   pthread_cond_broadcast ( &m->work_cv );
+   pthread_mutex_unlock ( &m->lock );
+   for (i = 0; i < m->nStarted; i++)
+      pthread_join ( m->threads[i], NULL );
+   pthread_mutex_destroy ( &m->lock );
+   pthread_cond_destroy ( &m->work_cv );
+   pthread_cond_destroy ( &m->done_cv );
+
+   if (m->jobs != NULL) {
+      for (i = 0; i < m->nJobs; i++)
+         if (m->jobs[i].strm.state != NULL)
+            BZ2_bzCompressEnd ( &m->jobs[i].strm );
+      free ( m->jobs );
+   }
+   free ( m->threads );
+   free ( m->out.buf );
+   BZFREE ( m );
+   strm->state = NULL;
+}
+
+
+static
+int cmt_init ( bz_stream* strm, int blockSize100k, int workFactor,
+               int nThreads )
+{
+   CMTState* m;
+   Int32     i, ret;
+
+   m = BZALLOC( sizeof(CMTState) );
+   if (m == NULL) return BZ_MEM_ERROR;
+   memset ( m, 0, sizeof(CMTState) );
+   strm->state      = m;
+   m->strm          = strm;
+   m->mode          = BZ_M_THREADED;
+   m->action        = BZ_M_RUNNING;
+   m->blockSize100k = blockSize100k;
+   m->nThreads      = nThreads;
+   /*-- One block filling, one per worker, one to splice. --*/
+   m->nJobs         = nThreads + 2;
+   m->carry_ch      = 256;
+   pthread_mutex_init ( &m->lock, NULL );
+   pthread_cond_init ( &m->work_cv, NULL );
+   pthread_cond_init ( &m->done_cv, NULL );
+
+   /*-- A coded block lives in arr2 after the block itself,
+        so it can never exceed 3 bytes per input byte. --*/
+   m->out.buf = malloc ( 3 * 100000 * blockSize100k + 256 );
+   m->threads = calloc ( nThreads, sizeof(pthread_t) );
+   m->jobs    = calloc ( m->nJobs, sizeof(CJob) );
+   if (m->out.buf == NULL || m->threads == NULL || m->jobs == NULL) {
+      cmt_free ( strm );
+      return BZ_MEM_ERROR;
+   }
+   for (i = 0; i < m->nJobs; i++) {
+      ret = BZ2_bzCompressInit ( &m->jobs[i].strm, blockSize100k,
+                                 0, workFactor );
+      if (ret != BZ_OK) {
+         cmt_free ( strm );
+         return ret;
+      }
+   }
+
+   mt_bits_put ( &m->out, 8, BZ_HDR_B );
+   mt_bits_put ( &m->out, 8, BZ_HDR_Z );
+   mt_bits_put ( &m->out, 8, BZ_HDR_h );
+   mt_bits_put ( &m->out, 8, BZ_HDR_0 + blockSize100k );
+   mt_bits_finish ( &m->out );
+
+   strm->total_in_lo32  = 0;
+   strm->total_in_hi32  = 0;
+   strm->total_out_lo32 = 0;
+   strm->total_out_hi32 = 0;
+   return BZ_OK;
+}
+
+#endif /* BZ_NO_COMPRESS */
+
+
+/*---------------------------------------------------*/
+/*-- Threaded decompression.                       --*/
+
+#define DJ_FREE     0
+#define DJ_QUEUED   1
+#define DJ_RUNNING  2
+#define DJ_DONE     3
+
+typedef
+   struct {
+      Int32   state;
+      UChar*  bits;       /* the block, from its magic on */
+      UInt32  nbits;
+      UInt32  bitsCap;
+      UInt32  blockCRC;
+      UChar*  out;
+      UInt32  outLen;
+      UInt32  outPos;
+      UInt32  outCap;
+      Int32   ret;
+   }
+   DJob;
+
+#define DM_HEADER   0
+#define DM_BLOCKS   1
+#define DM_TRAILER  2   /* saw the end magic, want the CRC */
+#define DM_DRAIN    3   /* whole stream is in */
+#define DM_END      4
+
+typedef
+   struct {
+      /* must match the start of DState */
+      bz_stream* strm;
+      Int32      state;
+
+      Int32      phase;
+      Int32      small;
+      Int32      blockSize100k;
+      Int32      err;
+
+      pthread_mutex_t lock;
+      pthread_cond_t  work_cv;
+      pthread_cond_t  done_cv;
+      pthread_t* threads;
+      Int32      nThreads;
+      Int32      nStarted;
+      Bool       shutdown;
+
+      /* ring of blocks; seq % nJobs picks the slot */
+      DJob*      jobs;
+      Int32      nJobs;
+      UInt32     maxQueued;
+      UInt32     seqQueued;
+      UInt32     seqRun;
+      UInt32     seqEmit;
+
+      /* input from the start of the current block on */
+      UChar*     in;
+      UInt32     inLen;
+      UInt32     inCap;
+      UInt32     scan;       /* next byte of in[] to look at */
+      unsigned long long reg;
+      Int32      regBits;
+      Int32      segStart;   /* bit offset of the block magic, or -1 */
+      UInt32     eosPos;     /* bit offset of the end magic */
+
+      UInt32     storedCRC;
+      Bool       crcKnown;
+      UInt32     combinedCRC;
+
+      /* serial decoder that takes over if a block cannot be placed */
+      bz_stream  fb;
+      Bool       fbActive;
+      UChar*     fbBuf;      /* input it still has to see first */
+      UInt32     fbLen;
+      UInt32     fbPos;
+   }
+   DMTState;
+
+
+static
+UInt32 dmt_get32 ( const UChar* p, UInt32 bit )
+{
+   UInt32 v = 0;
+   Int32  i;
+
+   for (i = 0; i < 32; i++, bit++)
+      v = (v << 1) | ((p[bit >> 3] >> (7 - (bit & 7))) & 1);
+   return v;
+}
+
+
+/*-- Decode one block by wrapping it in a one-block stream. --*/
+static
+void dmt_decode ( DJob* j, Int32 small, Int32 blockSize100k )
+{
+   bz_stream z;
+   MTBits    w;
+   UInt32    cap;
+   Int32     r;
+
+   w.buf = malloc ( 4 + j->nbits / 8 + 16 );
+   if (w.buf == NULL) { j->ret = BZ_MEM_ERROR; return; }
+   w.pos = 0; w.buff = 0; w.live = 0;
+   mt_bits_put ( &w, 8, BZ_HDR_B );
+   mt_bits_put ( &w, 8, BZ_HDR_Z );
+   mt_bits_put ( &w, 8, BZ_HDR_h );
+   mt_bits_put ( &w, 8, BZ_HDR_0 + blockSize100k );
+   mt_bits_copy ( &w, j->bits, 0, j->nbits );
+   mt_bits_put ( &w, 24, BZ_MT_EOS_MAGIC >> 24 );
+   mt_bits_put ( &w, 24, BZ_MT_EOS_MAGIC & 0xffffff );
+   /*-- A one-block stream's combined CRC is its block CRC. --*/
+   mt_bits_put ( &w, 16, j->blockCRC >> 16 );
+   mt_bits_put ( &w, 16, j->blockCRC & 0xffff );
+   mt_bits_finish ( &w );
+
+   z.bzalloc = NULL;
+   z.bzfree  = NULL;
+   z.opaque  = NULL;
+   r = BZ2_bzDecompressInit ( &z, 0, small );
+   if (r != BZ_OK) { free ( w.buf ); j->ret = r; return; }
+   z.next_in  = (char*)w.buf;
+   z.avail_in = w.pos;
+
+   j->outLen = j->outPos = 0;
+   while (True) {
+      if (j->outCap - j->outLen < 4096) {
+         UChar* p;
+         cap = j->outCap ? 2 * j->outCap
+                         : (UInt32)(100000 * blockSize100k + 4096);
+         p = realloc ( j->out, cap );
+         if (p == NULL) { r = BZ_MEM_ERROR; break; }
+         j->out = p;
+         j->outCap = cap;
+      }
+      z.next_out  = (char*)j->out + j->outLen;
+      z.avail_out = j->outCap - j->outLen;
+      r = BZ2_bzDecompress ( &z );
+      j->outLen = j->outCap - z.avail_out;
+      if (r == BZ_STREAM_END) { r = BZ_OK; break; }
+      if (r != BZ_OK) break;
+      if (z.avail_out > 0) { r = BZ_DATA_ERROR; break; }
+   }
+   BZ2_bzDecompressEnd ( &z );
+   free ( w.buf );
+   j->ret = r;
+}
+
+
+static
+void* dmt_worker ( void* arg )
+{
+   DMTState* m = arg;
+   DJob*     j;
+
+   pthread_mutex_lock ( &m->lock );
+   while (True) {
+      while (!m->shutdown && m->seqRun == m->seqQueued)
+         pthread_cond_wait ( &m->work_cv, &m->lock );
+      if (m->shutdown) break;
+      j = &m->jobs[m->seqRun % m->nJobs];
+      m->seqRun++;
+      j->state = DJ_RUNNING;
+      pthread_mutex_unlock ( &m->lock );
+
+      dmt_decode ( j, m->small, m->blockSize100k );
+
+      pthread_mutex_lock ( &m->lock );
+      j->state = DJ_DONE;
+      pthread_cond_broadcast ( &m->done_cv );
+   }
+   pthread_mutex_unlock ( &m->lock );
+   return NULL;
+}
+
+
+/*-- Queue the bits [a, b) of in[] as a block. --*/
+static
+Int32 dmt_queue ( DMTState* m, UInt32 a, UInt32 b )
+{
+   DJob*  j = &m->jobs[m->seqQueued % m->nJobs];
+   UInt32 need = (b - a + 7) / 8;
+   MTBits w;
+
+   if (j->bitsCap < need) {
+      free ( j->bits );
+      j->bits = malloc ( need );
+      if (j->bits == NULL) { j->bitsCap = 0; return BZ_MEM_ERROR; }
+      j->bitsCap = need;
+   }
+   w.buf = j->bits; w.pos = 0; w.buff = 0; w.live = 0;
+   mt_bits_copy ( &w, m->in, a, b - a );
+   mt_bits_finish ( &w );
+   j->nbits    = b - a;
+   j->blockCRC = (j->nbits >= 80) ? dmt_get32 ( j->bits, 48 ) : 0;
+   j->ret      = BZ_OK;
+
+   pthread_mutex_lock ( &m->lock );
+   j->state = DJ_QUEUED;
+   m->seqQueued++;
+   if (m->nStarted < m->nThreads &&
+       pthread_create ( &m->threads[m->nStarted], NULL,
+                        dmt_worker, m ) == 0)
+      m->nStarted++;
+   pthread_cond_signal ( &m->work_cv );
+   pthread_mutex_unlock ( &m->lock );
+
+   if (m->nStarted == 0) {
+      /*-- No threads to be had; do the work here. --*/
+      m->seqRun++;
+      dmt_decode ( j, m->small, m->blockSize100k );
+      j->state = DJ_DONE;
+   }
+   return BZ_OK;
+}
+
+
+/*-- Scan in[] for block boundaries, queueing blocks as they
+     complete.  Stops when the queue is full or at the end of
+     the stream. --*/
+static
+Int32 dmt_scan ( DMTState* m )
+{
+   unsigned long long v;
+   UInt32 pos, drop;
+   Int32  k, r;
+   UChar  c;
+
+   while (m->scan < m->inLen && m->phase < DM_DRAIN) {
+      if (m->seqQueued - m->seqEmit >= m->maxQueued) break;
+      c = m->in[m->scan++];
+
+      if (m->phase == DM_HEADER) {
+         if (m->scan < 4) continue;
+         if (m->in[0] != BZ_HDR_B || m->in[1] != BZ_HDR_Z ||
+             m->in[2] != BZ_HDR_h ||
+             m->in[3] < (BZ_HDR_0 + 1) || m->in[3] > (BZ_HDR_0 + 9))
+            return BZ_DATA_ERROR_MAGIC;
+         m->blockSize100k = m->in[3] - BZ_HDR_0;
+         m->phase = DM_BLOCKS;
+         continue;
+      }
+
+      if (m->phase == DM_TRAILER) {
+         if (m->scan * 8 < m->eosPos + 80) continue;
+         m->storedCRC = dmt_get32 ( m->in, m->eosPos + 48 );
+         m->crcKnown  = True;
+         /*-- Keep the last byte until all the output is out, so
+              that callers who stop when the input runs dry still
+              come back for it. --*/
+         if (m->seqEmit != m->seqQueued) {
+            m->scan--;
+            break;
+         }
+         m->phase = DM_DRAIN;
+         break;
+      }
+
+      m->reg = (m->reg << 8) | c;
+      if (m->regBits < 64) m->regBits += 8;
+      for (k = 7; k >= 0 && m->phase == DM_BLOCKS; k--) {
+         if (m->regBits - k < 48) continue;
+         v = (m->reg >> k) & BZ_MT_MAGIC_MASK;
+         if (v != BZ_MT_BLOCK_MAGIC && v != BZ_MT_EOS_MAGIC) continue;
+
+         pos = m->scan * 8 - k - 48;
+         /*-- A block holds at least its magic and CRC. --*/
+         if (m->segStart >= 0 && pos < (UInt32)m->segStart + 80)
+            continue;
+         if (m->segStart < 0) {
+            /*-- Nothing but a magic may follow the header. --*/
+            if (pos != 32) return BZ_DATA_ERROR;
+         } else {
+            r = dmt_queue ( m, m->segStart, pos );
+            if (r != BZ_OK) return r;
+         }
+
+         /*-- Forget everything before this magic. --*/
+         drop = pos / 8;
+         memmove ( m->in, m->in + drop, m->inLen - drop );
+         m->inLen -= drop;
+         m->scan  -= drop;
+         pos      -= drop * 8;
+
+         if (v == BZ_MT_BLOCK_MAGIC) {
+            m->segStart = pos;
+         } else {
+            m->segStart = -1;
+            m->eosPos   = pos;
+            m->phase    = DM_TRAILER;
+         }
+      }
+
+      if (m->segStart >= 0 &&
+          m->scan * 8 - m->segStart > BZ_MT_MAX_SEGMENT * 8)
+         return BZ_DATA_ERROR;
+   }
+   return BZ_OK;
+}
+
+
+/*-- Take what the caller offers, up to a chunk, and give back
+     whatever the scanner did not get to, so that nothing past
+     the end of the stream is ever consumed. --*/
+static
+Int32 dmt_take_input ( DMTState* m, Bool* progress )
+{
+   bz_stream* strm = m->strm;
+   UInt32     n, left;
+   Int32      r;
+
+   n = strm->avail_in;
+   if (n > BZ_MT_CHUNK) n = BZ_MT_CHUNK;
+   if (m->inCap - m->inLen < n) {
+      UChar* p;
+      UInt32 cap = 2 * (m->inLen + n);
+      p = realloc ( m->in, cap );
+      if (p == NULL) return BZ_MEM_ERROR;
+      m->in = p;
+      m->inCap = cap;
+   }
+   memcpy ( m->in + m->inLen, strm->next_in, n );
+   m->inLen += n;
+
+   r = dmt_scan ( m );
+
+   /*-- Everything before this call had been scanned. --*/
+   left = m->inLen - m->scan;
+   m->inLen = m->scan;
+   n -= left;
+   if (n > 0) *progress = True;
+   strm->next_in  += n;
+   strm->avail_in -= n;
+   mt_add_total ( &strm->total_in_lo32, &strm->total_in_hi32, n );
+   return r;
+}
+
+
+/*-- Give up on the scanner: everything from the head block on
+     goes to an ordinary serial decoder instead.  That decoder
+     is started with a made-up stream header, the bits of the
+     queued blocks and of the block being scanned are handed to
+     it first, and then it reads the caller's input directly.
+     It is primed with the combined CRC of the blocks already
+     written out, so the stream CRC is still checked in full. --*/
+static
+Int32 dmt_fallback ( DMTState* m )
+{
+   DState* s;
+   DJob*   j;
+   UChar   hdr[4];
+   UInt32  nbits, tail, lead, q;
+   MTBits  w;
+   Int32   r;
+
+   tail = 0;
+   if (m->phase == DM_TRAILER)
+      tail = m->eosPos;
+   else if (m->segStart >= 0)
+      tail = m->segStart;
+   else
+      tail = m->inLen * 8;
+   nbits = m->inLen * 8 - tail;
+   for (q = m->seqEmit; q != m->seqQueued; q++)
+      nbits += m->jobs[q % m->nJobs].nbits;
+
+   /*-- The bits end on a byte boundary of the input.  Pad the
+        front to one too; the odd leading bits are then handed
+        to the decoder through its bit buffer. --*/
+   lead = nbits & 7;
+   m->fbBuf = malloc ( nbits / 8 + 1 );
+   if (m->fbBuf == NULL) return BZ_MEM_ERROR;
+   w.buf = m->fbBuf; w.pos = 0; w.buff = 0; w.live = 0;
+   if (lead != 0) mt_bits_put ( &w, 8 - lead, 0 );
+   for (q = m->seqEmit; q != m->seqQueued; q++) {
+      j = &m->jobs[q % m->nJobs];
+      mt_bits_copy ( &w, j->bits, 0, j->nbits );
+   }
+   mt_bits_copy ( &w, m->in, tail, m->inLen * 8 - tail );
+   mt_bits_finish ( &w );
+   m->fbLen = w.pos;
+   m->fbPos = 0;
+
+   r = BZ2_bzDecompressInit ( &m->fb, 0, m->small );
+   if (r != BZ_OK) return r;
+   m->fbActive = True;
+   hdr[0] = BZ_HDR_B;
+   hdr[1] = BZ_HDR_Z;
+   hdr[2] = BZ_HDR_h;
+   hdr[3] = BZ_HDR_0 + m->blockSize100k;
+   m->fb.next_in   = (char*)hdr;
+   m->fb.avail_in  = 4;
+   m->fb.next_out  = NULL;
+   m->fb.avail_out = 0;
+   r = BZ2_bzDecompress ( &m->fb );
+   if (r != BZ_OK) return r;
+
+   s = m->fb.state;
+   if (lead != 0) {
+      m->fbPos   = 1;
+      s->bsBuff  = m->fbBuf[0] & ((1 << lead) - 1);
+      s->bsLive  = lead;
+   }
+   s->calculatedCombinedCRC = m->combinedCRC;
+   return BZ_OK;
+}
+
+
+/*-- Run the serial decoder on what is left of the stream. --*/
+static
+int dmt_serial ( DMTState* m )
+{
+   bz_stream* strm = m->strm;
+   Bool       own;
+   UInt32     inBefore, outBefore, n;
+   Int32      r;
+
+   while (True) {
+      own = (m->fbPos < m->fbLen);
+      if (own) {
+         m->fb.next_in  = (char*)m->fbBuf + m->fbPos;
+         m->fb.avail_in = m->fbLen - m->fbPos;
+      } else {
+         m->fb.next_in  = strm->next_in;
+         m->fb.avail_in = strm->avail_in;
+      }
+      m->fb.next_out  = strm->next_out;
+      m->fb.avail_out = strm->avail_out;
+      inBefore  = m->fb.avail_in;
+      outBefore = m->fb.avail_out;
+
+      r = BZ2_bzDecompress ( &m->fb );
+
+      n = inBefore - m->fb.avail_in;
+      if (own) {
+         m->fbPos += n;
+      } else {
+         strm->next_in  += n;
+         strm->avail_in -= n;
+         mt_add_total ( &strm->total_in_lo32, &strm->total_in_hi32, n );
+      }
+      n = outBefore - m->fb.avail_out;
+      strm->next_out  += n;
+      strm->avail_out -= n;
+      mt_add_total ( &strm->total_out_lo32, &strm->total_out_hi32, n );
+
+      if (r == BZ_STREAM_END) {
+         m->phase = DM_END;
+         return BZ_STREAM_END;
+      }
+      if (r != BZ_OK) {
+         m->err = r;
+         return r;
+      }
+      /*-- Go on into the caller's input once ours is used up. --*/
+      if (!own || m->fbPos < m->fbLen || strm->avail_out == 0)
+         return BZ_OK;
+   }
+}
+
+
+/*-- Wait for the head block.  While it fails to decode, fold
+     it into the next block, which becomes the head.  The block
+     before an end-of-stream magic is only taken once the stream
+     CRC agrees, since the magic may have turned up by chance
+     inside it.  Returns BZ_OK when the head block is good,
+     BZ_OK with *stall set when more input is needed first or
+     when the serial decoder has taken over, or an error. --*/
+static
+Int32 dmt_settle_head ( DMTState* m, Bool wait, Bool* stall )
+{
+   DJob*  j;
+   DJob*  n;
+   UChar* p;
+   MTBits w;
+   UInt32 crc;
+   Bool   last;
+
+   *stall = False;
+   while (True) {
+      j = &m->jobs[m->seqEmit % m->nJobs];
+      pthread_mutex_lock ( &m->lock );
+      if (j->state != DJ_DONE && !wait) {
+         pthread_mutex_unlock ( &m->lock );
+         *stall = True;
+         return BZ_OK;
+      }
+      while (j->state != DJ_DONE)
+         pthread_cond_wait ( &m->done_cv, &m->lock );
+      pthread_mutex_unlock ( &m->lock );
+
+      last = (m->seqEmit + 1 == m->seqQueued);
+      if (j->ret == BZ_OK) {
+         if (!last || m->phase != DM_TRAILER) return BZ_OK;
+         if (!m->crcKnown) {
+            *stall = True;
+            return BZ_OK;
+         }
+         crc = (m->combinedCRC << 1) | (m->combinedCRC >> 31);
+         if ((crc ^ j->blockCRC) == m->storedCRC) return BZ_OK;
+         *stall = True;
+         return dmt_fallback ( m );
+      }
+      if (j->ret == BZ_MEM_ERROR) return BZ_MEM_ERROR;
+
+      if (last) {
+         /*-- Nothing follows the last block yet.  If that is
+              because of an end-of-stream magic, the magic was
+              a chance one. --*/
+         *stall = True;
+         if (m->phase == DM_TRAILER) return dmt_fallback ( m );
+         return BZ_OK;
+      }
+      n = &m->jobs[(m->seqEmit + 1) % m->nJobs];
+      pthread_mutex_lock ( &m->lock );
+      while (n->state != DJ_DONE)
+         pthread_cond_wait ( &m->done_cv, &m->lock );
+      pthread_mutex_unlock ( &m->lock );
+
+      if (j->nbits + n->nbits > BZ_MT_MAX_SEGMENT * 8) {
+         *stall = True;
+         return dmt_fallback ( m );
+      }
+      p = malloc ( (j->nbits + n->nbits + 7) / 8 );
+      if (p == NULL) return BZ_MEM_ERROR;
+      w.buf = p; w.pos = 0; w.buff = 0; w.live = 0;
+      mt_bits_copy ( &w, j->bits, 0, j->nbits );
+      mt_bits_copy ( &w, n->bits, 0, n->nbits );
+      mt_bits_finish ( &w );
+      free ( n->bits );
+      n->bits     = p;
+      n->bitsCap  = w.pos;
+      n->nbits   += j->nbits;
+      n->blockCRC = j->blockCRC;
+      j->state    = DJ_FREE;
+      m->seqEmit++;
+      dmt_decode ( n, m->small, m->blockSize100k );
+   }
+}
+
+
+/*-- Hand decoded data to the caller, in order. --*/
+static
+Int32 dmt_emit ( DMTState* m, Bool wait, Bool* progress )
+{
+   bz_stream* strm = m->strm;
+   DJob*      j;
+   UInt32     n;
+   Bool       stall;
+   Int32      r;
+
+   while (m->seqEmit != m->seqQueued && strm->avail_out > 0) {
+      if (m->jobs[m->seqEmit % m->nJobs].outPos == 0) {
+         r = dmt_settle_head ( m, wait, &stall );
+         if (r != BZ_OK) return r;
+         if (stall) return BZ_OK;
+      }
+      j = &m->jobs[m->seqEmit % m->nJobs];
+      n = j->outLen - j->outPos;
+      if (n > strm->avail_out) n = strm->avail_out;
+      memcpy ( strm->next_out, j->out + j->outPos, n );
+      j->outPos       += n;
+      strm->next_out  += n;
+      strm->avail_out -= n;
+      mt_add_total ( &strm->total_out_lo32, &strm->total_out_hi32, n );
+      if (n > 0) *progress = True;
+      if (j->outPos < j->outLen) break;
+
+      m->combinedCRC = (m->combinedCRC << 1) | (m->combinedCRC >> 31);
+      m->combinedCRC ^= j->blockCRC;
+      j->state  = DJ_FREE;
+      j->outPos = 0;
+      m->seqEmit++;
+      wait = False;
+   }
+   return BZ_OK;
+}
+
+
+static
+int dmt_decompress ( bz_stream* strm )
+{
+   DMTState* m = strm->state;
+   Bool      progress;
+   Int32     r;
+
+   if (m->phase == DM_END) return BZ_SEQUENCE_ERROR;
+   if (m->err != BZ_OK) return m->err;
+
+   while (True) {
+      if (m->fbActive) return dmt_serial ( m );
+      progress = False;
+      r = dmt_emit ( m, False, &progress );
+      if (r != BZ_OK) break;
+      if (m->fbActive) continue;
+
+      if (m->phase == DM_DRAIN && m->seqEmit == m->seqQueued) {
+         if (m->combinedCRC != m->storedCRC) {
+            r = BZ_DATA_ERROR;
+            break;
+         }
+         m->phase = DM_END;
+         return BZ_STREAM_END;
+      }
+      if (strm->avail_out == 0) return BZ_OK;
+
+      if (m->phase < DM_DRAIN && strm->avail_in > 0 &&
+          m->seqQueued - m->seqEmit < m->maxQueued) {
+         r = dmt_take_input ( m, &progress );
+         if (r != BZ_OK) break;
+         if (progress) continue;
+      }
+      if (m->seqEmit != m->seqQueued) {
+         r = dmt_emit ( m, True, &progress );
+         if (r != BZ_OK) break;
+         if (progress || m->fbActive) continue;
+      }
+      return BZ_OK;
+   }
+   m->err = r;
+   return r;
+}
+
+
+static
+void dmt_free ( bz_stream* strm )
+{
+   DMTState* m = strm->state;
+   Int32 i;
+
+   pthread_mutex_lock ( &m->lock );
+   m->shutdown = True;
+   pthread_cond_broadcast ( &m->work_cv );
+   pthread_mutex_unlock ( &m->lock );
+   for (i = 0; i < m->nStarted; i++)
+      pthread_join ( m->threads[i], NULL );
+   pthread_mutex_destroy ( &m->lock );
+   pthread_cond_destroy ( &m->work_cv );
+   pthread_cond_destroy ( &m->done_cv );
+
+   if (m->jobs != NULL) {
+      for (i = 0; i < m->nJobs; i++) {
+         free ( m->jobs[i].bits );
+         free ( m->jobs[i].out );
+      }
+      free ( m->jobs );
+   }
+   if (m->fbActive) BZ2_bzDecompressEnd ( &m->fb );
+   free ( m->fbBuf );
+   free ( m->threads );
+   free ( m->in );
+   BZFREE ( m );
+   strm->state = NULL;
+}
+
+
+static
+int dmt_init ( bz_stream* strm, int small, int nThreads )
+{
+   DMTState* m;
+
+   m = BZALLOC( sizeof(DMTState) );
+   if (m == NULL) return BZ_MEM_ERROR;
+   memset ( m, 0, sizeof(DMTState) );
+   strm->state  = m;
+   m->strm      = strm;
+   m->state     = BZ_X_THREADED;
+   m->phase     = DM_HEADER;
+   m->small     = small;
+   m->err       = BZ_OK;
+   m->nThreads  = nThreads;
+   /*-- Several magics can end in the same input byte. --*/
+   m->maxQueued = 2 * nThreads + 2;
+   m->nJobs     = m->maxQueued + 8;
+   m->segStart  = -1;
+   pthread_mutex_init ( &m->lock, NULL );
+   pthread_cond_init ( &m->work_cv, NULL );
+   pthread_cond_init ( &m->done_cv, NULL );
+
+   m->threads = calloc ( nThreads, sizeof(pthread_t) );
+   m->jobs    = calloc ( m->nJobs, sizeof(DJob) );
+   if (m->threads == NULL || m->jobs == NULL) {
+      dmt_free ( strm );
+      return BZ_MEM_ERROR;
+   }
+
+   strm->total_in_lo32  = 0;
+   strm->total_in_hi32  = 0;
+   strm->total_out_lo32 = 0;
+   strm->total_out_hi32 = 0;
+   return BZ_OK;
+}
+
+#endif /* BZ_THREADS */
+
+
+#ifndef BZ_NO_COMPRESS
+/*---------------------------------------------------*/
+int BZ_API(BZ2_bzCompressInitMT)
+                    ( bz_stream* strm,
+                     int        blockSize100k,
+                     int        verbosity,
+                     int        workFactor,
+                     int        nThreads )
+{
+   if (nThreads < 0) return BZ_PARAM_ERROR;
+#ifdef BZ_THREADS
+   if (nThreads > 1) {
+      if (!bz_config_ok()) return BZ_CONFIG_ERROR;
+      if (strm == NULL ||
+          blockSize100k < 1 || blockSize100k > 9 ||
+          workFactor < 0 || workFactor > 250)
+        return BZ_PARAM_ERROR;
+      if (workFactor == 0) workFactor = 30;
+      if (strm->bzalloc == NULL) strm->bzalloc = default_bzalloc;
+      if (strm->bzfree == NULL) strm->bzfree = default_bzfree;
+      if (nThreads > BZ_MT_MAX_THREADS) nThreads = BZ_MT_MAX_THREADS;
+      return cmt_init ( strm, blockSize100k, workFactor, nThreads );
+   }
+#endif
+   return BZ2_bzCompressInit ( strm, blockSize100k, verbosity, workFactor );
+}
+#endif
+
+
+/*---------------------------------------------------*/
+int BZ_API(BZ2_bzDecompressInitMT)
+                     ( bz_stream* strm,
+                       int        verbosity,
+                       int        small,
+                       int        nThreads )
+{
+   if (nThreads < 0) return BZ_PARAM_ERROR;
+#ifdef BZ_THREADS
+   if (nThreads > 1) {
+      if (!bz_config_ok()) return BZ_CONFIG_ERROR;
+      if (strm == NULL) return BZ_PARAM_ERROR;
+      if (small != 0 && small != 1) return BZ_PARAM_ERROR;
+      if (verbosity < 0 || verbosity > 4) return BZ_PARAM_ERROR;
+      if (strm->bzalloc == NULL) strm->bzalloc = default_bzalloc;
+      if (strm->bzfree == NULL) strm->bzfree = default_bzfree;
+      if (nThreads > BZ_MT_MAX_THREADS) nThreads = BZ_MT_MAX_THREADS;
+      return dmt_init ( strm, small, nThreads );
+   }
+#endif
+   return BZ2_bzDecompressInit ( strm, verbosity, small );
+}
+
+
 #ifndef BZ_NO_COMPRESS
 
 #ifndef BZ_NO_STDIO
@@ -927,6 +2233,20 @@ BZFILE* BZ_API(BZ2_bzWriteOpen)
                       int   blockSize100k, 
                       int   verbosity,
                       int   workFactor )
+{
+   return BZ2_bzWriteOpenMT ( bzerror, f, blockSize100k, verbosity,
+                              workFactor, 1 );
+}
+
+
+/*---------------------------------------------------*/
+BZFILE* BZ_API(BZ2_bzWriteOpenMT)
+                    ( int*  bzerror,
+                      FILE* f,
+                      int   blockSize100k,
+                      int   verbosity,
+                      int   workFactor,
+                      int   nThreads )
 {
    Int32   ret;
    bzFile* bzf = NULL;
@@ -936,7 +2256,8 @@ BZFILE* BZ_API(BZ2_bzWriteOpen)
    if (f == NULL ||
        (blockSize100k < 1 || blockSize100k > 9) ||
        (workFactor < 0 || workFactor > 250) ||
-       (verbosity < 0 || verbosity > 4))
+       (verbosity < 0 || verbosity > 4) ||
+       nThreads < 0)
       { BZ_SETERR(BZ_PARAM_ERROR); return NULL; };
 
    if (ferror(f))
@@ -956,8 +2277,8 @@ BZFILE* BZ_API(BZ2_bzWriteOpen)
    bzf->strm.opaque   = NULL;
 
    if (workFactor == 0) workFactor = 30;
-   ret = BZ2_bzCompressInit ( &(bzf->strm), blockSize100k, 
-                              verbosity, workFactor );
+   ret = BZ2_bzCompressInitMT ( &(bzf->strm), blockSize100k,
+                                verbosity, workFactor, nThreads );
    if (ret != BZ_OK)
       { BZ_SETERR(ret); free(bzf); return NULL; };
 
@@ -1099,6 +2420,21 @@ BZFILE* BZ_API(BZ2_bzReadOpen)
                      int   small,
                      void* unused,
                      int   nUnused )
+{
+   return BZ2_bzReadOpenMT ( bzerror, f, verbosity, small,
+                             unused, nUnused, 1 );
+}
+
+
+/*---------------------------------------------------*/
+BZFILE* BZ_API(BZ2_bzReadOpenMT)
+                   ( int*  bzerror,
+                     FILE* f,
+                     int   verbosity,
+                     int   small,
+                     void* unused,
+                     int   nUnused,
+                     int   nThreads )
 {
    bzFile* bzf = NULL;
    int     ret;
@@ -1109,7 +2445,8 @@ BZFILE* BZ_API(BZ2_bzReadOpen)
        (small != 0 && small != 1) ||
        (verbosity < 0 || verbosity > 4) ||
        (unused == NULL && nUnused != 0) ||
-       (unused != NULL && (nUnused < 0 || nUnused > BZ_MAX_UNUSED)))
+       (unused != NULL && (nUnused < 0 || nUnused > BZ_MAX_UNUSED)) ||
+       nThreads < 0)
       { BZ_SETERR(BZ_PARAM_ERROR); return NULL; };
 
    if (ferror(f))
@@ -1135,7 +2472,8 @@ BZFILE* BZ_API(BZ2_bzReadOpen)
       nUnused--;
    }
 
-   ret = BZ2_bzDecompressInit ( &(bzf->strm), verbosity, small );
+   ret = BZ2_bzDecompressInitMT ( &(bzf->strm), verbosity, small,
+                                  nThreads );
    if (ret != BZ_OK)
       { BZ_SETERR(ret); free(bzf); return NULL; };
 
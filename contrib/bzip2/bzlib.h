@@ -128,6 +128,28 @@ BZ_EXTERN int BZ_API(BZ2_bzDecompressEnd) (
    );
 
 
+/*-- Block-parallel variants; nThreads of 0 or 1 is the
+     same as the calls above.  The output of the threaded
+     compressor is identical to that of the serial one. --*/
+
+#define BZ_HAVE_MT 1
+
+BZ_EXTERN int BZ_API(BZ2_bzCompressInitMT) (
+      bz_stream* strm,
+      int        blockSize100k,
+      int        verbosity,
+      int        workFactor,
+      int        nThreads
+   );
+
+BZ_EXTERN int BZ_API(BZ2_bzDecompressInitMT) (
+      bz_stream *strm,
+      int       verbosity,
+      int       small,
+      int       nThreads
+   );
+
+
 
 /*-- High(er) level library functions --*/
 
@@ -145,6 +167,16 @@ BZ_EXTERN BZFILE* BZ_API(BZ2_bzReadOpen) (
       int   nUnused 
    );
 
+BZ_EXTERN BZFILE* BZ_API(BZ2_bzReadOpenMT) (
+      int*  bzerror,
+      FILE* f,
+      int   verbosity,
+      int   small,
+      void* unused,
+      int   nUnused,
+      int   nThreads
+   );
+
 BZ_EXTERN void BZ_API(BZ2_bzReadClose) ( 
       int*    bzerror, 
       BZFILE* b 
@@ -172,6 +204,15 @@ BZ_EXTERN BZFILE* BZ_API(BZ2_bzWriteOpen) (
       int   workFactor 
    );
 
+BZ_EXTERN BZFILE* BZ_API(BZ2_bzWriteOpenMT) (
+      int*  bzerror,
+      FILE* f,
+      int   blockSize100k,
+      int   verbosity,
+      int   workFactor,
+      int   nThreads
+   );
+
 BZ_EXTERN void BZ_API(BZ2_bzWrite) ( 
       int*    bzerror, 
       BZFILE* b, 
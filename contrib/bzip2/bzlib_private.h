@@ -179,6 +179,7 @@ extern UInt32 BZ2_crc32Table[256];
 #define BZ_M_RUNNING   2
 #define BZ_M_FLUSHING  3
 #define BZ_M_FINISHING 4
+#define BZ_M_THREADED  5   /* state is a CMTState, see bzlib.c */
 
 #define BZ_S_OUTPUT    1
 #define BZ_S_INPUT     2
@@ -333,6 +334,8 @@ BZ2_hbMakeCodeLengths ( UChar*, Int32*, Int32, Int32 );
 #define BZ_X_CCRC_3      49
 #define BZ_X_CCRC_4      50
 
+#define BZ_X_THREADED    99   /* state is a DMTState, see bzlib.c */
+
 
 
 /*-- Constants for the fast MTF decoder. --*/
@@ -7,6 +7,10 @@
 
 #include <strings.h>
 #include <time.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 #ifdef HAVE_SSL
 /* this entire file is rather useless when you don't have
@@ -212,11 +216,13 @@ ldns_sign_public_buffer(ldns_buffer *sign_buf, ldns_key *current_key)
 }
 
 /**
- * use this function to sign with a public/private key alg
- * return the created signatures
+ * Sign the rrset with the keys for which use[i] is set, or with the
+ * keys marked for use if use is NULL.  The keys are only read, so
+ * several threads can sign with the same key list.
  */
-ldns_rr_list *
-ldns_sign_public(ldns_rr_list *rrset, ldns_key_list *keys)
+static ldns_rr_list *
+ldns_sign_public_keys(ldns_rr_list *rrset, ldns_key_list *keys,
+		const bool *use)
 {
 	ldns_rr_list *signatures;
 	ldns_rr_list *rrset_clone;
@@ -226,20 +232,19 @@ ldns_sign_public(ldns_rr_list *rrset, ldns_key_list *keys)
 	size_t key_count;
 	uint16_t i;
 	ldns_buffer *sign_buf;
-	ldns_rdf *new_owner;
+	ldns_buffer *rrset_buf;
 
 	if (!rrset || ldns_rr_list_rr_count(rrset) < 1 || !keys) {
 		return NULL;
 	}
 
-	new_owner = NULL;
-
 	signatures = ldns_rr_list_new();
 
 	/* prepare a signature and add all the know data
 	 * prepare the rrset. Sign this together.  */
 	rrset_clone = ldns_rr_list_clone(rrset);
 	if (!rrset_clone) {
+		ldns_rr_list_free(signatures);
 		return NULL;
 	}
 
@@ -252,22 +257,30 @@ ldns_sign_public(ldns_rr_list *rrset, ldns_key_list *keys)
 	/* sort */
 	ldns_rr_list_sort(rrset_clone);
 
+	/* the canonical wire format of the rrset is the same for all keys,
+	 * its buffer grows when needed */
+	sign_buf = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	rrset_buf = ldns_buffer_new(LDNS_MIN_BUFLEN);
+	if (!sign_buf || !rrset_buf ||
+	    ldns_rr_list2buffer_wire(rrset_buf, rrset_clone)
+	    != LDNS_STATUS_OK) {
+		ldns_buffer_free(sign_buf);
+		ldns_buffer_free(rrset_buf);
+		ldns_rr_list_deep_free(rrset_clone);
+		ldns_rr_list_free(signatures);
+		return NULL;
+	}
+
 	for (key_count = 0;
 		key_count < ldns_key_list_key_count(keys);
 		key_count++) {
-		if (!ldns_key_use(ldns_key_list_key(keys, key_count))) {
+		current_key = ldns_key_list_key(keys, key_count);
+		if (use ? !use[key_count] : !ldns_key_use(current_key)) {
 			continue;
 		}
-		sign_buf = ldns_buffer_new(LDNS_MAX_PACKETLEN);
-		if (!sign_buf) {
-			ldns_rr_list_free(rrset_clone);
-			ldns_rr_list_free(signatures);
-			ldns_rdf_free(new_owner);
-			return NULL;
-		}
+		ldns_buffer_clear(sign_buf); /* restart for the next key */
 		b64rdf = NULL;
 
-		current_key = ldns_key_list_key(keys, key_count);
 		/* sign all RRs with keys that have ZSKbit, !SEPbit.
 		   sign DNSKEY RRs with keys that have ZSKbit&SEPbit */
 		if (ldns_key_flags(current_key) & LDNS_KEY_ZONE_KEY) {
@@ -281,6 +294,7 @@ ldns_sign_public(ldns_rr_list *rrset, ldns_key_list *keys)
 			if (ldns_rrsig2buffer_wire(sign_buf, current_sig)
 			    != LDNS_STATUS_OK) {
 				ldns_buffer_free(sign_buf);
+				ldns_buffer_free(rrset_buf);
 				/* ERROR */
 				ldns_rr_list_deep_free(rrset_clone);
 				ldns_rr_free(current_sig);
@@ -289,9 +303,12 @@ ldns_sign_public(ldns_rr_list *rrset, ldns_key_list *keys)
 			}
 
 			/* add the rrset in sign_buf */
-			if (ldns_rr_list2buffer_wire(sign_buf, rrset_clone)
-			    != LDNS_STATUS_OK) {
+			ldns_buffer_write(sign_buf,
+			    ldns_buffer_begin(rrset_buf),
+			    ldns_buffer_position(rrset_buf));
+			if (ldns_buffer_status(sign_buf) != LDNS_STATUS_OK) {
 				ldns_buffer_free(sign_buf);
+				ldns_buffer_free(rrset_buf);
 				ldns_rr_list_deep_free(rrset_clone);
 				ldns_rr_free(current_sig);
 				ldns_rr_list_deep_free(signatures);
@@ -302,6 +319,8 @@ ldns_sign_public(ldns_rr_list *rrset, ldns_key_list *keys)
 
 			if (!b64rdf) {
 				/* signing went wrong */
+				ldns_buffer_free(sign_buf);
+				ldns_buffer_free(rrset_buf);
 				ldns_rr_list_deep_free(rrset_clone);
 				ldns_rr_free(current_sig);
 				ldns_rr_list_deep_free(signatures);
@@ -313,13 +332,24 @@ ldns_sign_public(ldns_rr_list *rrset, ldns_key_list *keys)
 			/* push the signature to the signatures list */
 			ldns_rr_list_push_rr(signatures, current_sig);
 		}
-		ldns_buffer_free(sign_buf); /* restart for the next key */
 	}
+	ldns_buffer_free(sign_buf);
+	ldns_buffer_free(rrset_buf);
 	ldns_rr_list_deep_free(rrset_clone);
 
 	return signatures;
 }
 
+/**
+ * use this function to sign with a public/private key alg
+ * return the created signatures
+ */
+ldns_rr_list *
+ldns_sign_public(ldns_rr_list *rrset, ldns_key_list *keys)
+{
+	return ldns_sign_public_keys(rrset, keys, NULL);
+}
+
 /**
  * Sign data with DSA
  *
@@ -863,6 +893,148 @@ ldns_dnssec_zone_create_nsecs(ldns_dnssec_zone *zone,
 }
 
 #ifdef HAVE_SSL
+/* Most threads that are used with LDNS_SIGN_WITH_THREADS */
+#define LDNS_SIGN_MAX_THREADS 64
+/* Number of RRsets that are signed between two passes over the results */
+#define LDNS_SIGN_BATCH 4096
+/* Number of items a thread takes at a time */
+#define LDNS_SIGN_CHUNK 16
+
+/* Work that is shared by the threads of ldns_sign_parallel() */
+struct ldns_sign_work {
+	void (*func)(void *, size_t);
+	void *arg;
+	size_t count;
+	size_t next;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_t lock;
+#endif
+};
+
+#ifdef HAVE_PTHREAD_H
+static void *
+ldns_sign_work_run(void *arg)
+{
+	struct ldns_sign_work *work = (struct ldns_sign_work *) arg;
+	size_t i, end;
+
+	for (;;) {
+		pthread_mutex_lock(&work->lock);
+		i = work->next;
+		end = work->count - i > LDNS_SIGN_CHUNK ?
+			i + LDNS_SIGN_CHUNK : work->count;
+		work->next = end;
+		pthread_mutex_unlock(&work->lock);
+		if (i == end) {
+			break;
+		}
+		for (; i < end; i++) {
+			work->func(work->arg, i);
+		}
+	}
+	return NULL;
+}
+#endif /* HAVE_PTHREAD_H */
+
+/** Number of threads to use for the signing flags */
+static size_t
+ldns_sign_threads(int flags)
+{
+#if defined(HAVE_PTHREAD_H) && defined(_SC_NPROCESSORS_ONLN)
+	long n;
+
+	if (flags & LDNS_SIGN_WITH_THREADS) {
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+		if (n > LDNS_SIGN_MAX_THREADS) {
+			n = LDNS_SIGN_MAX_THREADS;
+		}
+		if (n > 1) {
+			return (size_t) n;
+		}
+	}
+#else
+	(void) flags;
+#endif
+	return 1;
+}
+
+/**
+ * Call func(arg, i) for every i below count, with nthreads threads
+ * (the calling one included).  Returns when all calls are done.
+ */
+static void
+ldns_sign_parallel(size_t nthreads, size_t count,
+		void (*func)(void *, size_t), void *arg)
+{
+	size_t i;
+#ifdef HAVE_PTHREAD_H
+	struct ldns_sign_work work;
+	pthread_t threads[LDNS_SIGN_MAX_THREADS];
+	size_t started;
+
+	if (nthreads > 1 && count > LDNS_SIGN_CHUNK &&
+	    pthread_mutex_init(&work.lock, NULL) == 0) {
+		work.func = func;
+		work.arg = arg;
+		work.count = count;
+		work.next = 0;
+		/* if a thread cannot be created, the others do its share */
+		for (started = 0; started < nthreads - 1 &&
+		    started < LDNS_SIGN_MAX_THREADS; started++) {
+			if (pthread_create(&threads[started], NULL,
+			    ldns_sign_work_run, &work) != 0) {
+				break;
+			}
+		}
+		(void) ldns_sign_work_run(&work);
+		for (i = 0; i < started; i++) {
+			pthread_join(threads[i], NULL);
+		}
+		pthread_mutex_destroy(&work.lock);
+		return;
+	}
+#else
+	(void) nthreads;
+#endif
+	for (i = 0; i < count; i++) {
+		func(arg, i);
+	}
+}
+
+/* Names whose NSEC3 records are created together */
+struct ldns_nsec3_batch {
+	ldns_dnssec_name **names;
+	ldns_rr **nsec3s;
+	const ldns_rdf *zone_name;
+	uint8_t algorithm;
+	uint8_t flags;
+	uint16_t iterations;
+	uint8_t salt_length;
+	uint8_t *salt;
+};
+
+static void
+ldns_nsec3_batch_create(void *arg, size_t i)
+{
+	struct ldns_nsec3_batch *batch = (struct ldns_nsec3_batch *) arg;
+	ldns_rr *nsec_rr;
+
+	nsec_rr = ldns_dnssec_create_nsec3(batch->names[i],
+	                                   NULL,
+	                                   batch->zone_name,
+	                                   batch->algorithm,
+	                                   batch->flags,
+	                                   batch->iterations,
+	                                   batch->salt_length,
+	                                   batch->salt);
+	/* by default, our nsec based generator adds rrsigs
+	 * remove the bitmap for empty nonterminals */
+	if (nsec_rr && !batch->names[i]->rrsets) {
+		ldns_rdf_deep_free(ldns_rr_pop_rdf(nsec_rr));
+	}
+	batch->nsec3s[i] = nsec_rr;
+}
+
 static void
 ldns_hashed_names_node_free(ldns_rbnode_t *node, void *arg) {
 	(void) arg;
@@ -877,7 +1049,8 @@ ldns_dnssec_zone_create_nsec3s_mkmap(ldns_dnssec_zone *zone,
 		uint16_t iterations,
 		uint8_t salt_length,
 		uint8_t *salt,
-		ldns_rbtree_t **map)
+		ldns_rbtree_t **map,
+		int signflags)
 {
 	ldns_rbnode_t *first_name_node;
 	ldns_rbnode_t *current_name_node;
@@ -888,6 +1061,8 @@ ldns_dnssec_zone_create_nsec3s_mkmap(ldns_dnssec_zone *zone,
 	uint32_t nsec_ttl;
 	ldns_dnssec_rrsets *soa;
 	ldns_rbnode_t *hashmap_node;
+	struct ldns_nsec3_batch batch;
+	size_t count, i;
 
 	if (!zone || !new_rrs || !zone->names) {
 		return LDNS_STATUS_ERR;
@@ -925,24 +1100,44 @@ ldns_dnssec_zone_create_nsec3s_mkmap(ldns_dnssec_zone *zone,
 	first_name_node = ldns_dnssec_name_node_next_nonglue(
 					  ldns_rbtree_first(zone->names));
 
-	current_name_node = first_name_node;
-
-	while (current_name_node && current_name_node != LDNS_RBTREE_NULL &&
-			result == LDNS_STATUS_OK) {
-
-		current_name = (ldns_dnssec_name *) current_name_node->data;
-		nsec_rr = ldns_dnssec_create_nsec3(current_name,
-		                                   NULL,
-		                                   zone->soa->name,
-		                                   algorithm,
-		                                   flags,
-		                                   iterations,
-		                                   salt_length,
-		                                   salt);
-		/* by default, our nsec based generator adds rrsigs
-		 * remove the bitmap for empty nonterminals */
-		if (!current_name->rrsets) {
-			ldns_rdf_deep_free(ldns_rr_pop_rdf(nsec_rr));
+	/* the hashing is done up front, for all names at once */
+	count = 0;
+	for (current_name_node = first_name_node;
+	     current_name_node && current_name_node != LDNS_RBTREE_NULL;
+	     current_name_node = ldns_dnssec_name_node_next_nonglue(
+			ldns_rbtree_next(current_name_node))) {
+		count++;
+	}
+	batch.names = LDNS_XMALLOC(ldns_dnssec_name *, count + 1);
+	batch.nsec3s = LDNS_XMALLOC(ldns_rr *, count + 1);
+	if (!batch.names || !batch.nsec3s) {
+		LDNS_FREE(batch.names);
+		LDNS_FREE(batch.nsec3s);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	i = 0;
+	for (current_name_node = first_name_node;
+	     current_name_node && current_name_node != LDNS_RBTREE_NULL;
+	     current_name_node = ldns_dnssec_name_node_next_nonglue(
+			ldns_rbtree_next(current_name_node))) {
+		batch.names[i++] = (ldns_dnssec_name *) current_name_node->data;
+	}
+	batch.zone_name = zone->soa->name;
+	batch.algorithm = algorithm;
+	batch.flags = flags;
+	batch.iterations = iterations;
+	batch.salt_length = salt_length;
+	batch.salt = salt;
+	ldns_sign_parallel(ldns_sign_threads(signflags), count,
+			ldns_nsec3_batch_create, &batch);
+
+	for (i = 0; i < count && result == LDNS_STATUS_OK; i++) {
+
+		current_name = batch.names[i];
+		nsec_rr = batch.nsec3s[i];
+		if (!nsec_rr) {
+			result = LDNS_STATUS_MEM_ERR;
+			break;
 		}
 		ldns_rr_set_ttl(nsec_rr, nsec_ttl);
 		result = ldns_dnssec_name_add_rr(current_name, nsec_rr);
@@ -950,14 +1145,18 @@ ldns_dnssec_zone_create_nsec3s_mkmap(ldns_dnssec_zone *zone,
 		if (ldns_rr_owner(nsec_rr)) {
 			hashmap_node = LDNS_MALLOC(ldns_rbnode_t);
 			if (hashmap_node == NULL) {
-				return LDNS_STATUS_MEM_ERR;
+				result = LDNS_STATUS_MEM_ERR;
+				i++;
+				break;
 			}
 			current_name->hashed_name = 
 				ldns_dname_label(ldns_rr_owner(nsec_rr), 0);
 
 			if (current_name->hashed_name == NULL) {
 				LDNS_FREE(hashmap_node);
-				return LDNS_STATUS_MEM_ERR;
+				result = LDNS_STATUS_MEM_ERR;
+				i++;
+				break;
 			}
 			hashmap_node->key  = current_name->hashed_name;
 			hashmap_node->data = current_name;
@@ -967,9 +1166,13 @@ ldns_dnssec_zone_create_nsec3s_mkmap(ldns_dnssec_zone *zone,
 				LDNS_FREE(hashmap_node);
 			}
 		}
-		current_name_node = ldns_dnssec_name_node_next_nonglue(
-		                   ldns_rbtree_next(current_name_node));
 	}
+	/* the records that were not added to the zone */
+	for (; i < count; i++) {
+		ldns_rr_free(batch.nsec3s[i]);
+	}
+	LDNS_FREE(batch.names);
+	LDNS_FREE(batch.nsec3s);
 	if (result != LDNS_STATUS_OK) {
 		return result;
 	}
@@ -1006,7 +1209,7 @@ ldns_dnssec_zone_create_nsec3s(ldns_dnssec_zone *zone,
 		uint8_t *salt)
 {
 	return ldns_dnssec_zone_create_nsec3s_mkmap(zone, new_rrs, algorithm,
-		       	flags, iterations, salt_length, salt, NULL);
+		       	flags, iterations, salt_length, salt, NULL, 0);
 
 }
 #endif /* HAVE_SSL */
@@ -1197,6 +1400,89 @@ ldns_key_list_filter_for_non_dnskey(ldns_key_list *key_list, int flags)
 	}
 }
 
+/* An RRset, or the NSEC(3) of a name, that is to be signed */
+struct ldns_sign_job {
+	ldns_rr_list *rr_list;
+	ldns_dnssec_rrs **signatures;	/* where the new signatures go */
+	ldns_rr_list *siglist;
+};
+
+/* RRsets whose signatures are created together */
+struct ldns_sign_batch {
+	ldns_key_list *key_list;
+	size_t key_count;
+	struct ldns_sign_job *jobs;
+	bool *use;			/* key_count flags per job */
+	size_t count;
+	size_t size;
+};
+
+static void
+ldns_sign_batch_sign(void *arg, size_t i)
+{
+	struct ldns_sign_batch *batch = (struct ldns_sign_batch *) arg;
+	struct ldns_sign_job *job = &batch->jobs[i];
+
+	job->siglist = ldns_sign_public_keys(job->rr_list, batch->key_list,
+			batch->use + i * batch->key_count);
+}
+
+/**
+ * Queue the rr_list for signing with the keys that are marked for use
+ * now.  The signatures are added to *signatures later, in the order
+ * the RRsets were queued in.
+ */
+static void
+ldns_sign_batch_add(struct ldns_sign_batch *batch, ldns_rr_list *rr_list,
+		ldns_dnssec_rrs **signatures)
+{
+	struct ldns_sign_job *job = &batch->jobs[batch->count];
+	bool *use = batch->use + batch->count * batch->key_count;
+	size_t i;
+
+	job->rr_list = rr_list;
+	job->signatures = signatures;
+	job->siglist = NULL;
+	for (i = 0; i < batch->key_count; i++) {
+		use[i] = ldns_key_use(ldns_key_list_key(batch->key_list, i));
+	}
+	batch->count++;
+}
+
+/** Sign the queued RRsets and add the signatures to the zone */
+static ldns_status
+ldns_sign_batch_flush(struct ldns_sign_batch *batch, ldns_rr_list *new_rrs,
+		size_t nthreads, ldns_status result)
+{
+	struct ldns_sign_job *job;
+	ldns_rr_list *siglist;
+	size_t i, j;
+
+	ldns_sign_parallel(nthreads, batch->count, ldns_sign_batch_sign, batch);
+	for (j = 0; j < batch->count; j++) {
+		job = &batch->jobs[j];
+		siglist = job->siglist;
+		for (i = 0; i < ldns_rr_list_rr_count(siglist); i++) {
+			if (*job->signatures) {
+				result = ldns_dnssec_rrs_add_rr(*job->signatures,
+								   ldns_rr_list_rr(siglist, i));
+			} else {
+				*job->signatures = ldns_dnssec_rrs_new();
+				(*job->signatures)->rr =
+					ldns_rr_list_rr(siglist, i);
+			}
+			if (new_rrs) {
+				ldns_rr_list_push_rr(new_rrs,
+							 ldns_rr_list_rr(siglist, i));
+			}
+		}
+		ldns_rr_list_free(siglist);
+		ldns_rr_list_free(job->rr_list);
+	}
+	batch->count = 0;
+	return result;
+}
+
 ldns_status
 ldns_dnssec_zone_create_rrsigs_flg( ldns_dnssec_zone *zone
 				  , ldns_rr_list *new_rrs
@@ -1215,7 +1501,8 @@ ldns_dnssec_zone_create_rrsigs_flg( ldns_dnssec_zone *zone
 	ldns_dnssec_rrsets *cur_rrset;
 	ldns_dnssec_rrs *cur_rr;
 
-	ldns_rr_list *siglist;
+	struct ldns_sign_batch batch;
+	size_t nthreads;
 
 	size_t i;
 
@@ -1228,6 +1515,25 @@ ldns_dnssec_zone_create_rrsigs_flg( ldns_dnssec_zone *zone
 							key_list, i))
 				    );
 	}
+
+	/* The keys to use are decided here, one RRset after the other.
+	 * The signing itself is done a batch at a time, by several
+	 * threads if the flags ask for it.
+	 */
+	nthreads = ldns_sign_threads(flags);
+	batch.key_list = key_list;
+	batch.key_count = ldns_key_list_key_count(key_list);
+	batch.count = 0;
+	batch.size = nthreads > 1 ? LDNS_SIGN_BATCH : 1;
+	batch.jobs = LDNS_XMALLOC(struct ldns_sign_job, batch.size);
+	batch.use = LDNS_XMALLOC(bool, batch.size * batch.key_count + 1);
+	if (!batch.jobs || !batch.use) {
+		LDNS_FREE(batch.jobs);
+		LDNS_FREE(batch.use);
+		ldns_rr_list_deep_free(pubkey_list);
+		return LDNS_STATUS_MEM_ERR;
+	}
+
 	/* TODO: callback to see is list should be signed */
 	/* TODO: remove 'old' signatures from signature list */
 	cur_node = ldns_rbtree_first(zone->names);
@@ -1277,28 +1583,16 @@ ldns_dnssec_zone_create_rrsigs_flg( ldns_dnssec_zone *zone
 							== LDNS_RR_TYPE_NSEC ||
 						ldns_rr_list_type(rr_list) 
 							== LDNS_RR_TYPE_NSEC3) {
-					siglist = ldns_sign_public(rr_list, key_list);
-					for (i = 0; i < ldns_rr_list_rr_count(siglist); i++) {
-						if (cur_rrset->signatures) {
-							result = ldns_dnssec_rrs_add_rr(cur_rrset->signatures,
-											   ldns_rr_list_rr(siglist,
-														    i));
-						} else {
-							cur_rrset->signatures = ldns_dnssec_rrs_new();
-							cur_rrset->signatures->rr =
-								ldns_rr_list_rr(siglist, i);
-						}
-						if (new_rrs) {
-							ldns_rr_list_push_rr(new_rrs,
-												 ldns_rr_list_rr(siglist,
-															  i));
-						}
+					ldns_sign_batch_add(&batch, rr_list,
+							&cur_rrset->signatures);
+					if (batch.count == batch.size) {
+						result = ldns_sign_batch_flush(&batch,
+								new_rrs, nthreads, result);
 					}
-					ldns_rr_list_free(siglist);
+				} else {
+					ldns_rr_list_free(rr_list);
 				}
 
-				ldns_rr_list_free(rr_list);
-
 				cur_rrset = cur_rrset->next;
 			}
 
@@ -1313,29 +1607,19 @@ ldns_dnssec_zone_create_rrsigs_flg( ldns_dnssec_zone *zone
 
 			rr_list = ldns_rr_list_new();
 			ldns_rr_list_push_rr(rr_list, cur_name->nsec);
-			siglist = ldns_sign_public(rr_list, key_list);
-
-			for (i = 0; i < ldns_rr_list_rr_count(siglist); i++) {
-				if (cur_name->nsec_signatures) {
-					result = ldns_dnssec_rrs_add_rr(cur_name->nsec_signatures,
-									   ldns_rr_list_rr(siglist, i));
-				} else {
-					cur_name->nsec_signatures = ldns_dnssec_rrs_new();
-					cur_name->nsec_signatures->rr =
-						ldns_rr_list_rr(siglist, i);
-				}
-				if (new_rrs) {
-					ldns_rr_list_push_rr(new_rrs,
-								 ldns_rr_list_rr(siglist, i));
-				}
+			ldns_sign_batch_add(&batch, rr_list,
+					&cur_name->nsec_signatures);
+			if (batch.count == batch.size) {
+				result = ldns_sign_batch_flush(&batch, new_rrs,
+						nthreads, result);
 			}
-
-			ldns_rr_list_free(siglist);
-			ldns_rr_list_free(rr_list);
 		}
 		cur_node = ldns_rbtree_next(cur_node);
 	}
+	result = ldns_sign_batch_flush(&batch, new_rrs, nthreads, result);
 
+	LDNS_FREE(batch.jobs);
+	LDNS_FREE(batch.use);
 	ldns_rr_list_deep_free(pubkey_list);
 	return result;
 }
@@ -1473,7 +1757,8 @@ ldns_dnssec_zone_sign_nsec3_flg_mkmap(ldns_dnssec_zone *zone,
 											iterations,
 											salt_length,
 											salt,
-											map);
+											map,
+											signflags);
 			if (result != LDNS_STATUS_OK) {
 				return result;
 			}
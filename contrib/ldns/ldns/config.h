@@ -210,6 +210,9 @@
 /* Define to 1 if you have the <pcap.h> header file. */
 /* #undef HAVE_PCAP_H */
 
+/* Define to 1 if you have the <pthread.h> header file. */
+#define HAVE_PTHREAD_H 1
+
 /* This platform supports poll(7). */
 #define HAVE_POLL 1
 
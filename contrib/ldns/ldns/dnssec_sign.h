@@ -14,6 +14,10 @@ extern "C" {
 /** Sign flag that makes DNSKEY type signed by all keys, not only by SEP keys*/
 #define LDNS_SIGN_DNSKEY_WITH_ZSK 1
 #define LDNS_SIGN_WITH_ALL_ALGORITHMS 2 
+/** Sign flag that spreads NSEC3 hashing and signing over one thread per CPU.
+ * The output is the same as without it, in the same order.  This is a
+ * local flag; it stays clear of the bits upstream ldns uses (4, 8, 16). */
+#define LDNS_SIGN_WITH_THREADS 0x100
 
 /**
  * Create an empty RRSIG RR (i.e. without the actual signature data)
@@ -181,7 +185,8 @@ ldns_dnssec_rrs *ldns_dnssec_remove_signatures(ldns_dnssec_rrs *signatures,
  * RRset signed with the minimal key set, that is only SEP keys are used
  * for signing. If there are no SEP keys available, non-SEP keys will
  * be used. LDNS_SIGN_DNSKEY_WITH_ZSK makes DNSKEY type signed with all
- * keys. 0 is the default.
+ * keys. LDNS_SIGN_WITH_THREADS creates the signatures with several
+ * threads. 0 is the default.
  * \return LDNS_STATUS_OK on success, error otherwise
  */
 ldns_status ldns_dnssec_zone_create_rrsigs_flg(ldns_dnssec_zone *zone,
@@ -232,7 +237,8 @@ ldns_status ldns_dnssec_zone_create_rrsigs(ldns_dnssec_zone *zone,
  * RRset signed with the minimal key set, that is only SEP keys are used
  * for signing. If there are no SEP keys available, non-SEP keys will
  * be used. LDNS_SIGN_DNSKEY_WITH_ZSK makes DNSKEY type signed with all
- * keys. 0 is the default.
+ * keys. LDNS_SIGN_WITH_THREADS creates the signatures with several
+ * threads. 0 is the default.
  * \return LDNS_STATUS_OK on success, an error code otherwise
  */
 ldns_status ldns_dnssec_zone_sign_flg(ldns_dnssec_zone *zone,
@@ -255,7 +261,9 @@ ldns_status ldns_dnssec_zone_sign_flg(ldns_dnssec_zone *zone,
  * \param[in] iterations the number of NSEC3 hash iterations to use
  * \param[in] salt_length the length (in octets) of the NSEC3 salt
  * \param[in] salt the NSEC3 salt data
- * \param[in] signflags option flags for signing process. 0 is the default.
+ * \param[in] signflags option flags for signing process. With
+ * LDNS_SIGN_WITH_THREADS, the NSEC3 hashes are computed with several
+ * threads as well. 0 is the default.
  * \return LDNS_STATUS_OK on success, an error code otherwise
  */
 ldns_status ldns_dnssec_zone_sign_nsec3_flg(ldns_dnssec_zone *zone,
@@ -283,7 +291,9 @@ ldns_status ldns_dnssec_zone_sign_nsec3_flg(ldns_dnssec_zone *zone,
  * \param[in] iterations the number of NSEC3 hash iterations to use
  * \param[in] salt_length the length (in octets) of the NSEC3 salt
  * \param[in] salt the NSEC3 salt data
- * \param[in] signflags option flags for signing process. 0 is the default.
+ * \param[in] signflags option flags for signing process. With
+ * LDNS_SIGN_WITH_THREADS, the NSEC3 hashes are computed with several
+ * threads as well. 0 is the default.
  * \param[out] map a referenced rbtree pointer variable. The newly created 
  *                 rbtree will contain mappings from hashed owner names to the 
  *                 unhashed name.
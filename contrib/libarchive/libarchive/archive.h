@@ -562,6 +562,14 @@ __LA_DECL int archive_read_next_header2(struct archive *,
  */
 __LA_DECL la_int64_t		 archive_read_header_position(struct archive *);
 
+/*
+ * Retrieve the byte range in UNCOMPRESSED data that holds the stored
+ * (possibly compressed) body of the last-read entry.  Returns
+ * ARCHIVE_WARN if the format reader cannot tell.
+ */
+__LA_DECL int		 archive_read_entry_data_range(struct archive *,
+		     la_int64_t *offset, la_int64_t *length);
+
 /*
  * Returns 1 if the archive contains at least one encrypted entry.
  * If the archive format not support encryption at all
@@ -917,6 +925,9 @@ __LA_DECL int archive_write_disk_set_skip_file(struct archive *,
  * This accepts a bitmask of ARCHIVE_EXTRACT_XXX flags defined above. */
 __LA_DECL int		 archive_write_disk_set_options(struct archive *,
 		     int flags);
+/* Hand small regular files to a pool of writer threads; 0 disables. */
+__LA_DECL int		 archive_write_disk_set_writer_threads(struct archive *,
+		     int nthreads);
 /*
  * The lookup functions are given uname/uid (or gname/gid) pairs and
  * return a uid (gid) suitable for this system.  These are used for
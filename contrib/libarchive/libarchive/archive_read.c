@@ -653,6 +653,8 @@ _archive_read_next_header2(struct archive *_a, struct archive_entry *entry)
 
 	/* Record start-of-header offset in uncompressed stream. */
 	a->header_position = a->filter->position;
+	a->entry_data_offset = -1;
+	a->entry_data_length = -1;
 
 	++_a->file_count;
 	r2 = (a->format->read_header)(a, entry);
@@ -766,6 +768,25 @@ archive_read_header_position(struct archive *_a)
 	return (a->header_position);
 }
 
+/*
+ * Return the file offset and length (within the uncompressed data
+ * stream) of the stored body of the last-read entry, for formats that
+ * record it.
+ */
+int
+archive_read_entry_data_range(struct archive *_a, la_int64_t *offset,
+    la_int64_t *length)
+{
+	struct archive_read *a = (struct archive_read *)_a;
+	archive_check_magic(_a, ARCHIVE_READ_MAGIC,
+	    ARCHIVE_STATE_DATA, "archive_read_entry_data_range");
+	*offset = a->entry_data_offset;
+	*length = a->entry_data_length;
+	if (*offset < 0 || *length < 0)
+		return (ARCHIVE_WARN);
+	return (ARCHIVE_OK);
+}
+
 /*
  * Returns 1 if the archive contains at least one encrypted entry.
  * If the archive format not support encryption at all
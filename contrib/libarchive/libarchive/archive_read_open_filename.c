@@ -29,6 +29,9 @@ __FBSDID("$FreeBSD$");
 #ifdef HAVE_SYS_IOCTL_H
 #include <sys/ioctl.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #ifdef HAVE_SYS_STAT_H
 #include <sys/stat.h>
 #endif
@@ -61,6 +64,7 @@ __FBSDID("$FreeBSD$");
 
 #include "archive.h"
 #include "archive_private.h"
+#include "archive_read_private.h"
 #include "archive_string.h"
 
 #ifndef O_BINARY
@@ -70,12 +74,38 @@ __FBSDID("$FreeBSD$");
 #define O_CLOEXEC	0
 #endif
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+/*
+ * With the "mmap" read option, regular files are read through a
+ * sliding mmap() window instead of read(2).  Each window is handed to
+ * libarchive as one block, so the read-ahead layer can return views
+ * straight into the page cache rather than copying the data into a
+ * private buffer first.  Once a window is mapped the kernel is asked
+ * to start reading the next one.
+ *
+ * A file that is truncated while a window is mapped raises SIGBUS on
+ * access instead of returning a read error, which is why this is not
+ * the default.  Each window is sized from a fresh fstat(), so a file
+ * that shrank before the window was mapped still ends cleanly.
+ */
+#define	USE_MMAP	1
+#define	MMAP_WINDOW	(64 * 1024 * 1024)
+#endif
+
 struct read_file_data {
 	int	 fd;
 	size_t	 block_size;
 	void	*buffer;
 	mode_t	 st_mode;  /* Mode bits for opened file. */
 	char	 use_lseek;
+#ifdef USE_MMAP
+	char	 use_mmap;
+	void	*map;		/* Current window, or NULL. */
+	size_t	 map_size;
+	int64_t	 map_offset;	/* File offset of the current window. */
+	int64_t	 offset;	/* Logical read position. */
+	int64_t	 size;		/* File size when last checked. */
+#endif
 	enum fnt_e { FNT_STDIN, FNT_MBS, FNT_WCS } filename_type;
 	union {
 		char	 m[1];/* MBS filename. */
@@ -91,6 +121,11 @@ static ssize_t	file_read(struct archive *, void *, const void **buff);
 static int64_t	file_seek(struct archive *, void *, int64_t request, int);
 static int64_t	file_skip(struct archive *, void *, int64_t request);
 static int64_t	file_skip_lseek(struct archive *, void *, int64_t request);
+#ifdef USE_MMAP
+static void	file_unmap(struct read_file_data *);
+static ssize_t	file_read_mmap(struct archive *, struct read_file_data *,
+		    const void **buff);
+#endif
 
 int
 archive_read_open_file(struct archive *a, const char *filename,
@@ -373,6 +408,28 @@ file_open(struct archive *a, void *client_data)
 	if (is_disk_like)
 		mine->use_lseek = 1;
 
+#ifdef USE_MMAP
+	/*
+	 * Map named regular files if asked to.  stdin is left alone so
+	 * that the caller's descriptor offset keeps tracking what we
+	 * consumed.
+	 */
+	mine->use_mmap = 0;
+	mine->map = NULL;
+	if (((struct archive_read *)a)->use_mmap &&
+	    S_ISREG(st.st_mode) && st.st_size > 0 &&
+	    mine->filename_type != FNT_STDIN) {
+		mine->use_mmap = 1;
+		mine->offset = 0;
+		mine->size = st.st_size;
+	}
+#endif
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_SEQUENTIAL)
+	/* Archives are nearly always read front to back. */
+	if (S_ISREG(st.st_mode))
+		(void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
 	return (ARCHIVE_OK);
 fail:
 	/*
@@ -394,9 +451,10 @@ file_read(struct archive *a, void *client_data, const void **buff)
 	 * mis-aligned, read and return a short block to try to get
 	 * us back in alignment. */
 
-	/* TODO: Someday, try mmap() here; if that succeeds, give
-	 * the entire file to libarchive as a single block.  That
-	 * could be a lot faster than block-by-block manual I/O. */
+#ifdef USE_MMAP
+	if (mine->use_mmap)
+		return (file_read_mmap(a, mine, buff));
+#endif
 
 	/* TODO: We might be able to improve performance on pipes and
 	 * sockets by setting non-blocking I/O and just accepting
@@ -423,6 +481,84 @@ file_read(struct archive *a, void *client_data, const void **buff)
 	}
 }
 
+#ifdef USE_MMAP
+static void
+file_unmap(struct read_file_data *mine)
+{
+	if (mine->map != NULL) {
+		munmap(mine->map, mine->map_size);
+		mine->map = NULL;
+	}
+}
+
+/*
+ * Return a view of the file from the current offset to the end of a
+ * freshly mapped window.  libarchive guarantees it is done with the
+ * previous block by the time it asks for the next one, so the old
+ * window is simply dropped.  If fstat() or mmap() fails for any
+ * reason, position the descriptor and carry on with plain read(2).
+ */
+static ssize_t
+file_read_mmap(struct archive *a, struct read_file_data *mine,
+    const void **buff)
+{
+	static long pagesize;
+	struct stat st;
+	int64_t start, len;
+	void *p;
+
+	file_unmap(mine);
+	/* Never map past the current end of file. */
+	if (fstat(mine->fd, &st) != 0)
+		goto fallback;
+	mine->size = st.st_size;
+	if (mine->offset >= mine->size)
+		return (0);
+
+	if (pagesize == 0) {
+#ifdef HAVE_SYSCONF
+		pagesize = sysconf(_SC_PAGESIZE);
+#endif
+		if (pagesize <= 0)
+			pagesize = 4096;
+	}
+	start = mine->offset - (mine->offset % pagesize);
+	len = mine->size - start;
+	if (len > MMAP_WINDOW)
+		len = MMAP_WINDOW;
+	p = mmap(NULL, (size_t)len, PROT_READ, MAP_SHARED, mine->fd,
+	    (off_t)start);
+	if (p == MAP_FAILED)
+		goto fallback;
+	mine->map = p;
+	mine->map_size = (size_t)len;
+	mine->map_offset = start;
+#if defined(HAVE_MADVISE) && defined(MADV_SEQUENTIAL)
+	(void)madvise(p, (size_t)len, MADV_SEQUENTIAL);
+#endif
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+	/* Start pulling in the next window while this one is consumed. */
+	if (start + len < mine->size)
+		(void)posix_fadvise(mine->fd, start + len, MMAP_WINDOW,
+		    POSIX_FADV_WILLNEED);
+#endif
+
+	*buff = (const char *)p + (mine->offset - start);
+	len -= mine->offset - start;
+	mine->offset += len;
+	return ((ssize_t)len);
+
+fallback:
+	mine->use_mmap = 0;
+	if (lseek(mine->fd, mine->offset, SEEK_SET) < 0) {
+		archive_set_error(a, errno, "Error seeking in '%s'",
+		    mine->filename.m);
+		return (-1);
+	}
+	return (file_read(a, mine, buff));
+}
+#endif
+
 /*
  * Regular files and disk-like block devices can use simple lseek
  * without needing to round the request to the block size.
@@ -495,6 +631,18 @@ file_skip(struct archive *a, void *client_data, int64_t request)
 {
 	struct read_file_data *mine = (struct read_file_data *)client_data;
 
+#ifdef USE_MMAP
+	if (mine->use_mmap) {
+		/* Skipping is free; the next window starts further on. */
+		if (request > mine->size - mine->offset)
+			request = mine->size - mine->offset;
+		if (request < 0)
+			request = 0;
+		mine->offset += request;
+		return (request);
+	}
+#endif
+
 	/* Delegate skip requests. */
 	if (mine->use_lseek)
 		return (file_skip_lseek(a, client_data, request));
@@ -512,11 +660,31 @@ file_seek(struct archive *a, void *client_data, int64_t request, int whence)
 	struct read_file_data *mine = (struct read_file_data *)client_data;
 	int64_t r;
 
+#ifdef USE_MMAP
+	if (mine->use_mmap) {
+		switch (whence) {
+		case SEEK_SET: r = request; break;
+		case SEEK_CUR: r = mine->offset + request; break;
+		case SEEK_END: r = mine->size + request; break;
+		default: r = -1; break;
+		}
+		if (r >= 0) {
+			mine->offset = r;
+			return (r);
+		}
+		errno = EINVAL;
+		goto fail;
+	}
+#endif
+
 	/* We use off_t here because lseek() is declared that way. */
 	/* See above for notes about when off_t is less than 64 bits. */
 	r = lseek(mine->fd, request, whence);
 	if (r >= 0)
 		return r;
+#ifdef USE_MMAP
+fail:
+#endif
 
 	/* If the input is corrupted or truncated, fail. */
 	if (mine->filename_type == FNT_STDIN)
@@ -537,6 +705,10 @@ file_close2(struct archive *a, void *client_data)
 
 	(void)a; /* UNUSED */
 
+#ifdef USE_MMAP
+	file_unmap(mine);
+	mine->use_mmap = 0;
+#endif
 	/* Only flush and close if open succeeded. */
 	if (mine->fd >= 0) {
 		/*
@@ -180,9 +180,21 @@ struct archive_read {
 	/* Whether to bypass filter bidding process */
 	int bypass_filter_bidding;
 
+	/* Whether archive_read_open_filename() may mmap() regular files. */
+	int		  use_mmap;
+
+	/* Threads a decompression filter may use, from the "threads"
+	 * filter option; 0 means one per online CPU. */
+	int		  filter_threads;
+
 	/* File offset of beginning of most recently-read header. */
 	int64_t		  header_position;
 
+	/* Location of the stored body of the most recently-read entry,
+	 * or -1 if the format reader does not know. */
+	int64_t		  entry_data_offset;
+	int64_t		  entry_data_length;
+
 	/* Nodes and offsets of compressed data block */
 	unsigned int data_start_node;
 	unsigned int data_end_node;
@@ -26,6 +26,16 @@
 #include "archive_platform.h"
 __FBSDID("$FreeBSD$");
 
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
 #include "archive_read_private.h"
 #include "archive_options_private.h"
 
@@ -71,6 +81,26 @@ archive_read_set_options(struct archive *a, const char *options)
 	    archive_set_option);
 }
 
+/*
+ * Parse the value of the "threads" filter option: a decimal number of
+ * at most 256, where 0 means one thread per online CPU.
+ */
+static int
+parse_threads(const char *value, int *threads)
+{
+	char *endptr;
+	long n;
+
+	if (!(value[0] >= '0' && value[0] <= '9'))
+		return (ARCHIVE_WARN);
+	errno = 0;
+	n = strtol(value, &endptr, 10);
+	if (errno != 0 || *endptr != '\0' || n > 256)
+		return (ARCHIVE_WARN);
+	*threads = (int)n;
+	return (ARCHIVE_OK);
+}
+
 static int
 archive_set_format_option(struct archive *_a, const char *m, const char *o,
     const char *v)
@@ -117,6 +147,23 @@ archive_set_filter_option(struct archive *_a, const char *m, const char *o,
 	struct archive_read_filter_bidder *bidder;
 	int r, rv = ARCHIVE_WARN, matched_modules = 0;
 
+	/*
+	 * Filters only exist once the archive is open, which is too late
+	 * for "threads", so keep it where the zstd filter will find it.
+	 */
+	if (strcmp(o, "threads") == 0 && (m == NULL || strcmp(m, "zstd") == 0)) {
+		if (m != NULL)
+			++matched_modules;
+		if (v == NULL)
+			a->filter_threads = 1;
+		else if (parse_threads(v, &a->filter_threads) != ARCHIVE_OK) {
+			archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+			    "Invalid number of threads: %s", v);
+			return (ARCHIVE_FAILED);
+		}
+		rv = ARCHIVE_OK;
+	}
+
 	for (filter = a->filter; filter != NULL; filter = filter->upstream) {
 		bidder = filter->bidder;
 		if (bidder == NULL)
@@ -146,10 +193,17 @@ archive_set_filter_option(struct archive *_a, const char *m, const char *o,
 }
 
 static int
-archive_set_option(struct archive *a, const char *m, const char *o,
+archive_set_option(struct archive *_a, const char *m, const char *o,
     const char *v)
 {
-	return _archive_set_either_option(a, m, o, v,
+	struct archive_read *a = (struct archive_read *)_a;
+
+	/* "mmap" belongs to archive_read_open_filename(), not a module. */
+	if (m == NULL && o != NULL && strcmp(o, "mmap") == 0) {
+		a->use_mmap = (v != NULL);
+		return (ARCHIVE_OK);
+	}
+	return _archive_set_either_option(_a, m, o, v,
 	    archive_set_format_option,
 	    archive_set_filter_option);
 }
@@ -44,6 +44,9 @@ __FBSDID("$FreeBSD$");
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #if HAVE_ZSTD_H
 #include <zstd.h>
 #endif
@@ -55,17 +58,43 @@ __FBSDID("$FreeBSD$");
 
 #if HAVE_ZSTD_H && HAVE_LIBZSTD
 
+#ifdef HAVE_PTHREAD_H
+#define	ZSTD_PARALLEL_DECODE
+#endif
+
+/* One frame, as described by a seekable-format index. */
+struct zstd_seek_frame {
+	int64_t		 offset;	/* Of the frame in the input. */
+	uint32_t	 csize;
+	uint32_t	 dsize;
+};
+
+#ifdef ZSTD_PARALLEL_DECODE
+struct zstd_par;
+#endif
+
 struct private_data {
 	ZSTD_DStream	*dstream;
 	unsigned char	*out_block;
 	size_t		 out_block_size;
 	int64_t		 total_out;
+	int64_t		 total_in; /* Bytes consumed from upstream. */
 	char		 in_frame; /* True = in the middle of a zstd frame. */
 	char		 eof; /* True = found end of compressed data. */
+	/* Frame table from a seekable-format index, if there is one. */
+	struct zstd_seek_frame *frames;
+	size_t		 nframes;
+#ifdef ZSTD_PARALLEL_DECODE
+	int		 threads;
+	/* True once a frame that workers could take was decoded inline. */
+	char		 par_seen;
+	struct zstd_par	*par;
+#endif
 };
 
 /* Zstd Filter. */
 static ssize_t	zstd_filter_read(struct archive_read_filter *, const void**);
+static int64_t	zstd_filter_skip(struct archive_read_filter *, int64_t);
 static int	zstd_filter_close(struct archive_read_filter *);
 #endif
 
@@ -160,6 +189,513 @@ zstd_bidder_init(struct archive_read_filter *self)
 
 #else
 
+/* Magic numbers of the seekable format's index. */
+#define	ZSTD_SEEK_TABLE_MAGIC	0x184D2A5EU
+#define	ZSTD_SEEK_FOOTER_MAGIC	0x8F92EAB1U
+#define	ZSTD_SEEK_FOOTER_SIZE	9
+/* Largest index we are willing to load. */
+#define	ZSTD_SEEK_MAX_FRAMES	(1024 * 1024)
+
+/*
+ * The seekable format (see contrib/seekable_format in the zstd
+ * distribution) ends with a skippable frame listing the compressed
+ * and decompressed size of every frame in the stream.  If the input
+ * is a seekable file that starts with the stream, load that table so
+ * that skip requests can step over whole frames without reading or
+ * decoding them.  Anything that does not look exactly right is
+ * ignored.  The input is left rewound to the start.
+ */
+static int
+zstd_read_seek_table(struct archive_read_filter *self)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	struct archive_read_filter *upstream = self->upstream;
+	struct zstd_seek_frame *frames = NULL;
+	const unsigned char *p;
+	int64_t end, offset, table_size;
+	uint32_t i, n, entry_size;
+
+	if (self->archive->client.seeker == NULL || upstream->seek == NULL ||
+	    upstream->position != 0)
+		return (ARCHIVE_OK);
+
+	end = __archive_read_filter_seek(upstream, 0, SEEK_END);
+	if (end < 0)
+		return (ARCHIVE_OK);
+	if (end < 8 + ZSTD_SEEK_FOOTER_SIZE)
+		goto rewind;
+	if (__archive_read_filter_seek(upstream, end - ZSTD_SEEK_FOOTER_SIZE,
+	    SEEK_SET) < 0)
+		goto rewind;
+	p = __archive_read_filter_ahead(upstream, ZSTD_SEEK_FOOTER_SIZE, NULL);
+	if (p == NULL || archive_le32dec(p + 5) != ZSTD_SEEK_FOOTER_MAGIC)
+		goto rewind;
+	/* Bit 7 of the descriptor flags per-frame checksums; bits 2-6
+	 * are reserved and must be zero. */
+	if (p[4] & 0x7c)
+		goto rewind;
+	n = archive_le32dec(p);
+	entry_size = (p[4] & 0x80) ? 12 : 8;
+	if (n == 0 || n > ZSTD_SEEK_MAX_FRAMES)
+		goto rewind;
+	table_size = 8 + (int64_t)n * entry_size + ZSTD_SEEK_FOOTER_SIZE;
+	if (table_size > end)
+		goto rewind;
+	if (__archive_read_filter_seek(upstream, end - table_size,
+	    SEEK_SET) < 0)
+		goto rewind;
+	p = __archive_read_filter_ahead(upstream, (size_t)table_size, NULL);
+	if (p == NULL || archive_le32dec(p) != ZSTD_SEEK_TABLE_MAGIC ||
+	    archive_le32dec(p + 4) != table_size - 8)
+		goto rewind;
+	frames = calloc(n, sizeof(*frames));
+	if (frames == NULL)
+		goto rewind;
+	p += 8;
+	offset = 0;
+	for (i = 0; i < n; i++, p += entry_size) {
+		frames[i].offset = offset;
+		frames[i].csize = archive_le32dec(p);
+		frames[i].dsize = archive_le32dec(p + 4);
+		if (frames[i].csize == 0)
+			break;
+		offset += frames[i].csize;
+	}
+	/* The frames must account for everything before the index. */
+	if (i != n || offset != end - table_size) {
+		free(frames);
+		frames = NULL;
+	}
+rewind:
+	if (__archive_read_filter_seek(upstream, 0, SEEK_SET) != 0) {
+		free(frames);
+		archive_set_error(&self->archive->archive, ARCHIVE_ERRNO_MISC,
+		    "Can't rewind zstd input");
+		return (ARCHIVE_FATAL);
+	}
+	state->frames = frames;
+	state->nframes = frames != NULL ? n : 0;
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Find the indexed frame that starts at the given input offset.
+ */
+static const struct zstd_seek_frame *
+zstd_seek_lookup(struct private_data *state, int64_t offset)
+{
+	size_t lo = 0, hi = state->nframes, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (state->frames[mid].offset == offset)
+			return (&state->frames[mid]);
+		if (state->frames[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (NULL);
+}
+
+#ifdef ZSTD_PARALLEL_DECODE
+/* ------------------------------------------------------------------------ */
+
+/*
+ * Parallel frame decoding.
+ *
+ * Streams written by pzstd, by the seekable-format compressor, or by
+ * simply concatenating .zst files consist of many independent frames.
+ * Whenever the next frame states its decompressed size (in its header
+ * or in the seekable index) and is not too large, the whole frame is
+ * copied out of the input and handed to a pool of worker threads,
+ * each with its own decompression context.  All I/O stays on the
+ * caller's thread and frames are returned in input order, each as a
+ * single block.
+ *
+ * The first such frame is decoded inline like any other, so that the
+ * usual single-frame file gets neither threads nor an extra copy.
+ * Only when a second one follows is the pool set up, and it gets one
+ * more worker for every queued frame, up to the "threads" option.
+ *
+ * Frames of unknown size, and anything the read-ahead does not
+ * understand, are left to the regular streaming decoder, which only
+ * runs once the queue has drained and stops at the end of the frame
+ * so that read-ahead can resume.
+ */
+
+/* Largest frame, compressed or not, that is decoded on a worker. */
+#define	ZSTD_PAR_MAX_FRAME	(16 * 1024 * 1024)
+/* Limit on the bytes held by queued jobs. */
+#define	ZSTD_PAR_MAX_BYTES	(64 * 1024 * 1024)
+/* Enough to hold any frame header. */
+#define	ZSTD_PAR_HEADER_SIZE	18
+
+struct zstd_par_job {
+	struct zstd_par_job	*next;
+	unsigned char		*compressed;
+	size_t			 compressed_size;
+	unsigned char		*uncompressed;
+	size_t			 uncompressed_size;
+	size_t			 zret;
+	int			 state;
+#define	ZSTD_PAR_QUEUED		0
+#define	ZSTD_PAR_RUNNING	1
+#define	ZSTD_PAR_DONE		2
+};
+
+struct zstd_par_worker {
+	struct zstd_par		*par;
+	pthread_t		 thread;
+	ZSTD_DCtx		*dctx;
+};
+
+struct zstd_par {
+	pthread_mutex_t		 lock;
+	pthread_cond_t		 work_cv;	/* Workers wait for jobs. */
+	pthread_cond_t		 done_cv;	/* Caller waits for results. */
+	struct zstd_par_worker	*workers;
+	int			 nthreads;
+	int			 maxthreads;
+	int			 shutdown;
+	/* Jobs in input order; the first is the next to be returned. */
+	struct zstd_par_job	*first;
+	struct zstd_par_job	*last;
+	int			 njobs;
+	size_t			 bytes;
+	/* Job whose output was last returned by zstd_filter_read(). */
+	struct zstd_par_job	*current;
+};
+
+static void *
+zstd_par_worker(void *arg)
+{
+	struct zstd_par_worker *w = (struct zstd_par_worker *)arg;
+	struct zstd_par *par = w->par;
+	struct zstd_par_job *job;
+
+	pthread_mutex_lock(&par->lock);
+	while (!par->shutdown) {
+		for (job = par->first; job != NULL; job = job->next)
+			if (job->state == ZSTD_PAR_QUEUED)
+				break;
+		if (job == NULL) {
+			pthread_cond_wait(&par->work_cv, &par->lock);
+			continue;
+		}
+		job->state = ZSTD_PAR_RUNNING;
+		pthread_mutex_unlock(&par->lock);
+
+		job->zret = ZSTD_decompressDCtx(w->dctx, job->uncompressed,
+		    job->uncompressed_size, job->compressed,
+		    job->compressed_size);
+
+		pthread_mutex_lock(&par->lock);
+		job->state = ZSTD_PAR_DONE;
+		pthread_cond_broadcast(&par->done_cv);
+	}
+	pthread_mutex_unlock(&par->lock);
+	return (NULL);
+}
+
+static int
+zstd_par_init(struct private_data *state)
+{
+	struct zstd_par *par;
+
+	par = calloc(1, sizeof(*par));
+	if (par == NULL)
+		return (ARCHIVE_FATAL);
+	par->workers = calloc(state->threads, sizeof(*par->workers));
+	if (par->workers == NULL) {
+		free(par);
+		return (ARCHIVE_FATAL);
+	}
+	par->maxthreads = state->threads;
+	pthread_mutex_init(&par->lock, NULL);
+	pthread_cond_init(&par->work_cv, NULL);
+	pthread_cond_init(&par->done_cv, NULL);
+	state->par = par;
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Start another worker if there are more queued frames than workers.
+ * If that fails, make do with the workers there are; with none, the
+ * caller decodes the frames itself.
+ */
+static void
+zstd_par_grow(struct zstd_par *par)
+{
+	struct zstd_par_worker *w;
+
+	if (par->nthreads >= par->maxthreads || par->nthreads >= par->njobs)
+		return;
+	w = &par->workers[par->nthreads];
+	w->par = par;
+	if ((w->dctx = ZSTD_createDCtx()) == NULL) {
+		par->maxthreads = par->nthreads;
+		return;
+	}
+	if (pthread_create(&w->thread, NULL, zstd_par_worker, w) != 0) {
+		ZSTD_freeDCtx(w->dctx);
+		par->maxthreads = par->nthreads;
+		return;
+	}
+	par->nthreads++;
+}
+
+/*
+ * Unlink a job from the queue and free it, waiting first if a worker
+ * is still busy with it.
+ */
+static void
+zstd_par_release(struct zstd_par *par, struct zstd_par_job *job)
+{
+	struct zstd_par_job **pp;
+
+	pthread_mutex_lock(&par->lock);
+	while (job->state == ZSTD_PAR_RUNNING)
+		pthread_cond_wait(&par->done_cv, &par->lock);
+	for (pp = &par->first; *pp != job; pp = &(*pp)->next)
+		continue;
+	*pp = job->next;
+	if (par->last == job) {
+		par->last = NULL;
+		for (pp = &par->first; *pp != NULL; pp = &(*pp)->next)
+			par->last = *pp;
+	}
+	par->njobs--;
+	par->bytes -= job->compressed_size + job->uncompressed_size;
+	pthread_mutex_unlock(&par->lock);
+	if (par->current == job)
+		par->current = NULL;
+	free(job->compressed);
+	free(job->uncompressed);
+	free(job);
+}
+
+static void
+zstd_par_free(struct private_data *state)
+{
+	struct zstd_par *par = state->par;
+	int i;
+
+	if (par == NULL)
+		return;
+	pthread_mutex_lock(&par->lock);
+	par->shutdown = 1;
+	pthread_cond_broadcast(&par->work_cv);
+	pthread_mutex_unlock(&par->lock);
+	for (i = 0; i < par->nthreads; i++) {
+		pthread_join(par->workers[i].thread, NULL);
+		ZSTD_freeDCtx(par->workers[i].dctx);
+	}
+	while (par->first != NULL)
+		zstd_par_release(par, par->first);
+	pthread_cond_destroy(&par->done_cv);
+	pthread_cond_destroy(&par->work_cv);
+	pthread_mutex_destroy(&par->lock);
+	free(par->workers);
+	free(par);
+	state->par = NULL;
+}
+
+/*
+ * Work out the sizes of the frame at the read position.  Returns 0
+ * if it should be left to the streaming decoder.  With a NULL csize,
+ * only the frame header is looked at.
+ */
+static int
+zstd_par_frame_size(struct archive_read_filter *self, size_t *csize,
+    size_t *dsize)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	const struct zstd_seek_frame *f;
+	const void *h;
+	unsigned long long size;
+	ssize_t avail;
+	size_t want, ret;
+
+	h = __archive_read_filter_ahead(self->upstream, ZSTD_PAR_HEADER_SIZE,
+	    &avail);
+	if (h == NULL && avail > 0)
+		h = __archive_read_filter_ahead(self->upstream, avail, &avail);
+	if (h == NULL)
+		return (0);
+	size = ZSTD_getFrameContentSize(h, avail);
+	f = zstd_seek_lookup(state, state->total_in);
+	if (size == ZSTD_CONTENTSIZE_ERROR)
+		return (0);
+	if (size == ZSTD_CONTENTSIZE_UNKNOWN) {
+		if (f == NULL)
+			return (0);
+		size = f->dsize;
+	}
+	if (size > ZSTD_PAR_MAX_FRAME)
+		return (0);
+	*dsize = (size_t)size;
+	if (csize == NULL)
+		return (1);
+
+	if (f != NULL) {
+		*csize = f->csize;
+		return (*csize <= ZSTD_PAR_MAX_FRAME);
+	}
+	/* Room for the frame header, the blocks and a checksum. */
+	want = ZSTD_compressBound(*dsize) + ZSTD_PAR_HEADER_SIZE + 4;
+	h = __archive_read_filter_ahead(self->upstream, want, &avail);
+	if (h == NULL && avail > 0)
+		h = __archive_read_filter_ahead(self->upstream, avail, &avail);
+	if (h == NULL)
+		return (0);
+	ret = ZSTD_findFrameCompressedSize(h, avail);
+	if (ZSTD_isError(ret))
+		return (0);
+	*csize = ret;
+	return (1);
+}
+
+/*
+ * Queue up the frames that follow the read position.  Skippable
+ * frames (pzstd puts one in front of every frame) are stepped over.
+ */
+static int
+zstd_par_read_ahead(struct archive_read_filter *self)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	struct zstd_par *par;
+	struct zstd_par_job *job;
+	const unsigned char *h;
+	size_t csize, dsize;
+	int64_t skip;
+	uint32_t magic;
+
+	while (state->par == NULL ||
+	    (state->par->njobs < state->threads * 2 &&
+	     state->par->bytes < ZSTD_PAR_MAX_BYTES)) {
+		h = __archive_read_filter_ahead(self->upstream, 8, NULL);
+		if (h == NULL)
+			break;
+		magic = archive_le32dec(h);
+		if ((magic & 0xFFFFFFF0U) == 0x184D2A50U) {
+			skip = 8 + (int64_t)archive_le32dec(h + 4);
+			if (__archive_read_filter_consume(self->upstream, skip)
+			    < 0)
+				return (ARCHIVE_FATAL);
+			state->total_in += skip;
+			continue;
+		}
+		if (magic != 0xFD2FB528U ||
+		    !zstd_par_frame_size(self, NULL, &dsize))
+			break;
+		if (state->par == NULL) {
+			/* Leave the first frame to the streaming decoder. */
+			if (!state->par_seen) {
+				state->par_seen = 1;
+				break;
+			}
+			if (zstd_par_init(state) != ARCHIVE_OK) {
+				/* Carry on without workers. */
+				state->threads = 1;
+				break;
+			}
+		}
+		if (!zstd_par_frame_size(self, &csize, &dsize))
+			break;
+		par = state->par;
+
+		h = __archive_read_filter_ahead(self->upstream, csize, NULL);
+		if (h == NULL)
+			break;
+		job = calloc(1, sizeof(*job));
+		if (job == NULL)
+			break;
+		job->compressed_size = csize;
+		job->uncompressed_size = dsize;
+		job->compressed = malloc(csize);
+		/* Never ask for zero bytes. */
+		job->uncompressed = malloc(dsize + 1);
+		if (job->compressed == NULL || job->uncompressed == NULL) {
+			free(job->compressed);
+			free(job->uncompressed);
+			free(job);
+			break;
+		}
+		memcpy(job->compressed, h, csize);
+		__archive_read_filter_consume(self->upstream, csize);
+		state->total_in += csize;
+
+		pthread_mutex_lock(&par->lock);
+		if (par->last != NULL)
+			par->last->next = job;
+		else
+			par->first = job;
+		par->last = job;
+		par->njobs++;
+		par->bytes += job->compressed_size + job->uncompressed_size;
+		pthread_cond_signal(&par->work_cv);
+		pthread_mutex_unlock(&par->lock);
+		zstd_par_grow(par);
+	}
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Return the output of the next queued frame.  Returns 0 if there is
+ * none, in which case the streaming decoder takes over.
+ */
+static ssize_t
+zstd_par_read(struct archive_read_filter *self, const void **p)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	struct zstd_par *par;
+	struct zstd_par_job *job;
+
+	for (;;) {
+		if (state->par != NULL && state->par->current != NULL)
+			zstd_par_release(state->par, state->par->current);
+		if (zstd_par_read_ahead(self) != ARCHIVE_OK)
+			return (ARCHIVE_FATAL);
+		if ((par = state->par) == NULL || (job = par->first) == NULL)
+			return (0);
+
+		pthread_mutex_lock(&par->lock);
+		if (par->nthreads == 0) {
+			/* No worker could be started. */
+			pthread_mutex_unlock(&par->lock);
+			job->zret = ZSTD_decompressDCtx(state->dstream,
+			    job->uncompressed, job->uncompressed_size,
+			    job->compressed, job->compressed_size);
+			pthread_mutex_lock(&par->lock);
+			job->state = ZSTD_PAR_DONE;
+		}
+		while (job->state != ZSTD_PAR_DONE)
+			pthread_cond_wait(&par->done_cv, &par->lock);
+		pthread_mutex_unlock(&par->lock);
+		if (ZSTD_isError(job->zret)) {
+			archive_set_error(&self->archive->archive,
+			    ARCHIVE_ERRNO_MISC,
+			    "Zstd decompression failed: %s",
+			    ZSTD_getErrorName(job->zret));
+			return (ARCHIVE_FATAL);
+		}
+		if (job->zret != job->uncompressed_size) {
+			archive_set_error(&self->archive->archive,
+			    ARCHIVE_ERRNO_MISC,
+			    "Zstd frame size does not match its header");
+			return (ARCHIVE_FATAL);
+		}
+		par->current = job;
+		if (job->uncompressed_size > 0)
+			break;
+	}
+	state->total_out += job->uncompressed_size;
+	*p = job->uncompressed;
+	return ((ssize_t)job->uncompressed_size);
+}
+#endif /* ZSTD_PARALLEL_DECODE */
+
 /*
  * Initialize the filter object
  */
@@ -192,14 +728,29 @@ zstd_bidder_init(struct archive_read_filter *self)
 	state->out_block_size = out_block_size;
 	state->out_block = out_block;
 	state->dstream = dstream;
+#ifdef ZSTD_PARALLEL_DECODE
+	/*
+	 * The "threads" option, or one thread per online CPU; frames are
+	 * decoded inline on 1.
+	 */
+	state->threads = ((struct archive_read *)self->archive)->filter_threads;
+#if defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+	if (state->threads == 0)
+		state->threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (state->threads < 1)
+		state->threads = 1;
+	else if (state->threads > 256)
+		state->threads = 256;
+#endif
 	self->read = zstd_filter_read;
-	self->skip = NULL; /* not supported */
+	self->skip = zstd_filter_skip;
 	self->close = zstd_filter_close;
 
 	state->eof = 0;
 	state->in_frame = 0;
 
-	return (ARCHIVE_OK);
+	return (zstd_read_seek_table(self));
 }
 
 static ssize_t
@@ -210,13 +761,31 @@ zstd_filter_read(struct archive_read_filter *self, const void **p)
 	ssize_t avail_in;
 	ZSTD_outBuffer out;
 	ZSTD_inBuffer in;
+	int frame_at_a_time;
 
 	state = (struct private_data *)self->data;
 
+	/*
+	 * With workers or an index, stop at the end of every frame so
+	 * that the next frame can be queued or skipped.
+	 */
+	frame_at_a_time = state->frames != NULL;
+#ifdef ZSTD_PARALLEL_DECODE
+	if (state->threads > 1)
+		frame_at_a_time = 1;
+#endif
+
 	out = (ZSTD_outBuffer) { state->out_block, state->out_block_size, 0 };
 
 	/* Try to fill the output buffer. */
 	while (out.pos < out.size && !state->eof) {
+#ifdef ZSTD_PARALLEL_DECODE
+		if (state->threads > 1 && !state->in_frame && out.pos == 0) {
+			ssize_t ret = zstd_par_read(self, p);
+			if (ret != 0)
+				return (ret);
+		}
+#endif
 		if (!state->in_frame) {
 			const size_t ret = ZSTD_initDStream(state->dstream);
 			if (ZSTD_isError(ret)) {
@@ -261,10 +830,13 @@ zstd_filter_read(struct archive_read_filter *self, const void **p)
 
 			/* Decompressor made some progress */
 			__archive_read_filter_consume(self->upstream, in.pos);
+			state->total_in += in.pos;
 
 			/* ret guaranteed to be > 0 if frame isn't done yet */
 			state->in_frame = (ret != 0);
 		}
+		if (frame_at_a_time && !state->in_frame && out.pos > 0)
+			break;
 	}
 
 	decompressed = out.pos;
@@ -276,6 +848,52 @@ zstd_filter_read(struct archive_read_filter *self, const void **p)
 	return (decompressed);
 }
 
+/*
+ * Skip output without decoding it where we can: drop queued frames
+ * and, with a seekable index, step over whole frames in the input.
+ * Whatever is left is read and discarded by the caller.
+ */
+static int64_t
+zstd_filter_skip(struct archive_read_filter *self, int64_t request)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	const struct zstd_seek_frame *f;
+	int64_t skipped = 0;
+#ifdef ZSTD_PARALLEL_DECODE
+	struct zstd_par *par = state->par;
+	struct zstd_par_job *job;
+#endif
+
+	if (state->in_frame || state->eof)
+		return (0);
+#ifdef ZSTD_PARALLEL_DECODE
+	if (par != NULL) {
+		if (par->current != NULL)
+			zstd_par_release(par, par->current);
+		while ((job = par->first) != NULL &&
+		    (int64_t)job->uncompressed_size <= request - skipped) {
+			skipped += job->uncompressed_size;
+			zstd_par_release(par, job);
+		}
+		if (par->first != NULL)
+			goto done;
+	}
+#endif
+	while ((f = zstd_seek_lookup(state, state->total_in)) != NULL &&
+	    f->dsize <= request - skipped) {
+		if (__archive_read_filter_consume(self->upstream, f->csize)
+		    < 0)
+			return (ARCHIVE_FATAL);
+		state->total_in += f->csize;
+		skipped += f->dsize;
+	}
+#ifdef ZSTD_PARALLEL_DECODE
+done:
+#endif
+	state->total_out += skipped;
+	return (skipped);
+}
+
 /*
  * Clean up the decompressor.
  */
@@ -286,7 +904,11 @@ zstd_filter_close(struct archive_read_filter *self)
 
 	state = (struct private_data *)self->data;
 
+#ifdef ZSTD_PARALLEL_DECODE
+	zstd_par_free(state);
+#endif
 	ZSTD_freeDStream(state->dstream);
+	free(state->frames);
 	free(state->out_block);
 	free(state);
 
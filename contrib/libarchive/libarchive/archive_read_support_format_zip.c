@@ -58,6 +58,12 @@ __FBSDID("$FreeBSD$");
 #ifdef HAVE_LZMA_H
 #include <lzma.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "archive.h"
 #include "archive_digest_private.h"
@@ -75,6 +81,10 @@ __FBSDID("$FreeBSD$");
 #include "archive_crc32.h"
 #endif
 
+#if defined(HAVE_ZLIB_H) && defined(HAVE_PTHREAD_H)
+#define	ZIP_PARALLEL_DECODE
+#endif
+
 struct zip_entry {
 	struct archive_rb_node	node;
 	struct zip_entry	*next;
@@ -241,6 +251,11 @@ struct zip {
 	uint8_t			*iv;
 	uint8_t			*erd;
 	uint8_t			*v_data;
+
+	/* Parallel decoding of upcoming entries (seekable Zip only). */
+	int			threads;
+	struct zip_par		*par;
+	struct zip_par_job	*par_job;
 };
 
 /* Many systems define min or MIN, but not all. */
@@ -1096,6 +1111,9 @@ zip_read_local_file_header(struct archive_read *a, struct archive_entry *entry,
 	}
 	__archive_read_consume(a, extra_length);
 
+	/* The entry body starts here. */
+	a->entry_data_offset = archive_filter_bytes(&a->archive, 0);
+
 	/* Work around a bug in Info-Zip: When reading from a pipe, it
 	 * stats the pipe instead of synthesizing a file entry. */
 	if ((zip_entry->mode & AE_IFMT) == AE_IFIFO) {
@@ -1222,6 +1240,9 @@ zip_read_local_file_header(struct archive_read *a, struct archive_entry *entry,
 		}
 	}
 
+	if (0 == (zip_entry->zip_flags & ZIP_LENGTH_AT_END))
+		a->entry_data_length = zip_entry->compressed_size;
+
 	/* Populate some additional entry fields: */
 	archive_entry_set_mode(entry, zip_entry->mode);
 	archive_entry_set_uid(entry, zip_entry->uid);
@@ -2483,6 +2504,407 @@ zip_read_data_deflate(struct archive_read *a, const void **buff,
 }
 #endif
 
+#ifdef ZIP_PARALLEL_DECODE
+/* ------------------------------------------------------------------------ */
+
+/*
+ * Parallel entry decoding (seekable Zip only).
+ *
+ * The central directory tells us where every entry lives, so when the
+ * "threads" option is set the seekable reader reads the compressed
+ * bodies of the next few deflated entries ahead of time and hands them
+ * to a pool of worker threads.  All I/O stays on the caller's thread;
+ * the workers only inflate and checksum.  Entries are still returned in
+ * order: read_data() waits for the job belonging to the current entry
+ * and returns the whole body as a single block.
+ *
+ * Anything unusual (encryption, other compression methods, large
+ * entries, local headers that disagree with the central directory, or
+ * a job that failed to inflate) falls back to the regular inline
+ * decoder, which is left positioned at the start of the entry body.
+ */
+
+/* Largest entry, compressed or not, that is decoded on a worker. */
+#define	ZIP_PAR_MAX_ENTRY	(16 * 1024 * 1024)
+/* Limit on the bytes held by queued jobs. */
+#define	ZIP_PAR_MAX_BYTES	(64 * 1024 * 1024)
+
+struct zip_par_job {
+	struct zip_par_job	*next;
+	struct zip_entry	*entry;
+	int64_t			 data_offset;
+	size_t			 compressed_size;
+	size_t			 compressed_used;
+	unsigned char		*compressed;
+	size_t			 uncompressed_size;
+	size_t			 uncompressed_bytes;
+	unsigned char		*uncompressed;
+	unsigned long		(*crc32func)(unsigned long, const void *,
+				    size_t);
+	unsigned long		 crc32;
+	int			 zret;
+	int			 state;
+#define	ZIP_PAR_QUEUED	0
+#define	ZIP_PAR_RUNNING	1
+#define	ZIP_PAR_DONE	2
+};
+
+struct zip_par {
+	pthread_mutex_t		 lock;
+	pthread_cond_t		 work_cv;	/* Workers wait for jobs. */
+	pthread_cond_t		 done_cv;	/* Caller waits for results. */
+	pthread_t		*threads;
+	int			 nthreads;
+	int			 shutdown;
+	/* Jobs in entry order; the first is for the current entry. */
+	struct zip_par_job	*first;
+	struct zip_par_job	*last;
+	int			 njobs;
+	size_t			 bytes;
+	/* Last entry considered for read-ahead. */
+	struct zip_entry	*ahead;
+};
+
+static void
+zip_par_decode(struct zip_par_job *job)
+{
+	z_stream stream;
+	int r;
+
+	memset(&stream, 0, sizeof(stream));
+	r = inflateInit2(&stream, -15 /* Don't check for zlib header */);
+	if (r != Z_OK) {
+		job->zret = r;
+		return;
+	}
+	stream.next_in = job->compressed;
+	stream.avail_in = (uInt)job->compressed_size;
+	stream.next_out = job->uncompressed;
+	/* One spare byte so that an oversized body is noticed. */
+	stream.avail_out = (uInt)job->uncompressed_size + 1;
+	r = inflate(&stream, Z_FINISH);
+	job->compressed_used = stream.total_in;
+	job->uncompressed_bytes = stream.total_out;
+	inflateEnd(&stream);
+	job->zret = r;
+	if (r == Z_STREAM_END)
+		job->crc32 = job->crc32func(job->crc32func(0, NULL, 0),
+		    job->uncompressed, job->uncompressed_bytes);
+}
+
+static void *
+zip_par_worker(void *arg)
+{
+	struct zip_par *par = (struct zip_par *)arg;
+	struct zip_par_job *job;
+
+	pthread_mutex_lock(&par->lock);
+	while (!par->shutdown) {
+		for (job = par->first; job != NULL; job = job->next)
+			if (job->state == ZIP_PAR_QUEUED)
+				break;
+		if (job == NULL) {
+			pthread_cond_wait(&par->work_cv, &par->lock);
+			continue;
+		}
+		job->state = ZIP_PAR_RUNNING;
+		pthread_mutex_unlock(&par->lock);
+
+		zip_par_decode(job);
+
+		pthread_mutex_lock(&par->lock);
+		job->state = ZIP_PAR_DONE;
+		pthread_cond_broadcast(&par->done_cv);
+	}
+	pthread_mutex_unlock(&par->lock);
+	return (NULL);
+}
+
+static int
+zip_par_init(struct zip *zip)
+{
+	struct zip_par *par;
+	int i;
+
+	par = calloc(1, sizeof(*par));
+	if (par == NULL)
+		return (ARCHIVE_FATAL);
+	par->threads = calloc(zip->threads, sizeof(*par->threads));
+	if (par->threads == NULL) {
+		free(par);
+		return (ARCHIVE_FATAL);
+	}
+	pthread_mutex_init(&par->lock, NULL);
+	pthread_cond_init(&par->work_cv, NULL);
+	pthread_cond_init(&par->done_cv, NULL);
+	for (i = 0; i < zip->threads; i++) {
+		if (pthread_create(&par->threads[i], NULL, zip_par_worker,
+		    par) != 0)
+			break;
+		par->nthreads++;
+	}
+	if (par->nthreads == 0) {
+		pthread_cond_destroy(&par->done_cv);
+		pthread_cond_destroy(&par->work_cv);
+		pthread_mutex_destroy(&par->lock);
+		free(par->threads);
+		free(par);
+		return (ARCHIVE_FATAL);
+	}
+	zip->par = par;
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Unlink a job from the queue and free it, waiting first if a worker
+ * is still busy with it.
+ */
+static void
+zip_par_release(struct zip_par *par, struct zip_par_job *job)
+{
+	struct zip_par_job **pp;
+
+	pthread_mutex_lock(&par->lock);
+	while (job->state == ZIP_PAR_RUNNING)
+		pthread_cond_wait(&par->done_cv, &par->lock);
+	for (pp = &par->first; *pp != job; pp = &(*pp)->next)
+		continue;
+	*pp = job->next;
+	if (par->last == job) {
+		par->last = NULL;
+		for (pp = &par->first; *pp != NULL; pp = &(*pp)->next)
+			par->last = *pp;
+	}
+	par->njobs--;
+	par->bytes -= job->compressed_size + job->uncompressed_size;
+	pthread_mutex_unlock(&par->lock);
+	free(job->compressed);
+	free(job->uncompressed);
+	free(job);
+}
+
+static void
+zip_par_free(struct zip *zip)
+{
+	struct zip_par *par = zip->par;
+	int i;
+
+	if (par == NULL)
+		return;
+	zip->par_job = NULL;
+	pthread_mutex_lock(&par->lock);
+	par->shutdown = 1;
+	pthread_cond_broadcast(&par->work_cv);
+	pthread_mutex_unlock(&par->lock);
+	for (i = 0; i < par->nthreads; i++)
+		pthread_join(par->threads[i], NULL);
+	while (par->first != NULL)
+		zip_par_release(par, par->first);
+	pthread_cond_destroy(&par->done_cv);
+	pthread_cond_destroy(&par->work_cv);
+	pthread_mutex_destroy(&par->lock);
+	free(par->threads);
+	free(par);
+	zip->par = NULL;
+}
+
+/*
+ * Decide whether an entry, as described by the central directory, is
+ * worth handing to a worker.
+ */
+static int
+zip_par_eligible(const struct zip_entry *e)
+{
+	if (e->compression != 8)
+		return (0);
+	if (e->zip_flags & (ZIP_ENCRYPTED | ZIP_STRONG_ENCRYPTED))
+		return (0);
+	if ((e->mode & AE_IFMT) != AE_IFREG && (e->mode & AE_IFMT) != 0)
+		return (0);
+	if (e->compressed_size <= 0 || e->compressed_size > ZIP_PAR_MAX_ENTRY)
+		return (0);
+	if (e->uncompressed_size < 0 ||
+	    e->uncompressed_size > ZIP_PAR_MAX_ENTRY)
+		return (0);
+	return (1);
+}
+
+/*
+ * Read the compressed body of an entry into a new job.  Anything but
+ * ARCHIVE_OK ends the read-ahead; the inline decoder will run into
+ * the same problem and report it properly.
+ */
+static int
+zip_par_read_job(struct archive_read *a, struct zip_entry *e,
+    struct zip_par_job **jobp)
+{
+	struct zip *zip = (struct zip *)(a->format->data);
+	struct zip_par_job *job;
+	const char *p;
+	ssize_t bytes_avail;
+	size_t hsize, done;
+
+	*jobp = NULL;
+	if (__archive_read_seek(a, e->local_header_offset, SEEK_SET) < 0)
+		return (ARCHIVE_FATAL);
+	if ((p = __archive_read_ahead(a, 30, NULL)) == NULL)
+		return (ARCHIVE_WARN);
+	if (memcmp(p, "PK\003\004", 4) != 0)
+		return (ARCHIVE_WARN);
+	hsize = 30 + archive_le16dec(p + 26) + archive_le16dec(p + 28);
+	__archive_read_consume(a, hsize);
+
+	job = calloc(1, sizeof(*job));
+	if (job == NULL)
+		return (ARCHIVE_WARN);
+	job->entry = e;
+	job->data_offset = e->local_header_offset + hsize;
+	job->compressed_size = (size_t)e->compressed_size;
+	job->uncompressed_size = (size_t)e->uncompressed_size;
+	job->crc32func = zip->crc32func;
+	job->compressed = malloc(job->compressed_size);
+	job->uncompressed = malloc(job->uncompressed_size + 1);
+	if (job->compressed == NULL || job->uncompressed == NULL)
+		goto fail;
+	for (done = 0; done < job->compressed_size; done += bytes_avail) {
+		p = __archive_read_ahead(a, 1, &bytes_avail);
+		if (p == NULL || bytes_avail <= 0)
+			goto fail;
+		if ((size_t)bytes_avail > job->compressed_size - done)
+			bytes_avail = job->compressed_size - done;
+		memcpy(job->compressed + done, p, bytes_avail);
+		__archive_read_consume(a, bytes_avail);
+	}
+	*jobp = job;
+	return (ARCHIVE_OK);
+fail:
+	free(job->compressed);
+	free(job->uncompressed);
+	free(job);
+	return (ARCHIVE_WARN);
+}
+
+/*
+ * Called once the local header of the current entry has been read:
+ * pick up the job queued for it, if any, and queue the following
+ * entries.  The read position is restored before returning.
+ */
+static int
+zip_par_read_ahead(struct archive_read *a, struct zip *zip)
+{
+	struct zip_par *par;
+	struct zip_par_job *job;
+	struct zip_entry *e;
+	int64_t offset;
+
+	if (zip->threads <= 1)
+		return (ARCHIVE_OK);
+	if (zip->par == NULL && zip_par_init(zip) != ARCHIVE_OK) {
+		/* Carry on without workers. */
+		zip->threads = 1;
+		return (ARCHIVE_OK);
+	}
+	par = zip->par;
+	offset = archive_filter_bytes(&a->archive, 0);
+
+	/* Drop jobs for entries that are behind us. */
+	while ((job = par->first) != NULL && job->entry != zip->entry &&
+	    job->entry->local_header_offset <=
+	    zip->entry->local_header_offset)
+		zip_par_release(par, job);
+
+	/* Use the job for this entry only if the local header agrees. */
+	if (job != NULL && job->entry == zip->entry) {
+		if (job->data_offset == offset &&
+		    (int64_t)job->compressed_size ==
+		    zip->entry->compressed_size &&
+		    zip->entry->compression == 8 &&
+		    (zip->entry->zip_flags &
+		     (ZIP_ENCRYPTED | ZIP_STRONG_ENCRYPTED)) == 0 &&
+		    (zip->entry->mode & AE_IFMT) == AE_IFREG)
+			zip->par_job = job;
+		else
+			zip_par_release(par, job);
+	}
+
+	/* Queue up the entries that follow. */
+	if (par->ahead == NULL || par->ahead->local_header_offset <
+	    zip->entry->local_header_offset)
+		par->ahead = zip->entry;
+	while (par->njobs < par->nthreads * 2 &&
+	    par->bytes < ZIP_PAR_MAX_BYTES) {
+		e = (struct zip_entry *)__archive_rb_tree_iterate(
+		    &zip->tree, &par->ahead->node, ARCHIVE_RB_DIR_RIGHT);
+		if (e == NULL)
+			break;
+		par->ahead = e;
+		if (!zip_par_eligible(e))
+			continue;
+		if (zip_par_read_job(a, e, &job) != ARCHIVE_OK)
+			break;
+		pthread_mutex_lock(&par->lock);
+		if (par->last != NULL)
+			par->last->next = job;
+		else
+			par->first = job;
+		par->last = job;
+		par->njobs++;
+		par->bytes += job->compressed_size + job->uncompressed_size;
+		pthread_cond_signal(&par->work_cv);
+		pthread_mutex_unlock(&par->lock);
+	}
+
+	if (archive_filter_bytes(&a->archive, 0) != offset &&
+	    __archive_read_seek(a, offset, SEEK_SET) < 0)
+		return (ARCHIVE_FATAL);
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Wait for the current entry's job.  Returns ARCHIVE_OK if it holds
+ * the decoded body; otherwise the job is discarded and the caller
+ * decodes the entry inline.
+ */
+static int
+zip_par_wait(struct zip *zip)
+{
+	struct zip_par *par = zip->par;
+	struct zip_par_job *job = zip->par_job;
+
+	pthread_mutex_lock(&par->lock);
+	while (job->state != ZIP_PAR_DONE)
+		pthread_cond_wait(&par->done_cv, &par->lock);
+	pthread_mutex_unlock(&par->lock);
+	if (job->zret == Z_STREAM_END &&
+	    job->compressed_used == job->compressed_size &&
+	    (int64_t)job->uncompressed_bytes ==
+	    zip->entry->uncompressed_size)
+		return (ARCHIVE_OK);
+	zip_par_release(par, job);
+	zip->par_job = NULL;
+	return (ARCHIVE_WARN);
+}
+
+static int
+zip_read_data_parallel(struct archive_read *a, const void **buff,
+    size_t *size, int64_t *offset)
+{
+	struct zip *zip = (struct zip *)(a->format->data);
+	struct zip_par_job *job = zip->par_job;
+
+	(void)offset; /* UNUSED */
+
+	*buff = job->uncompressed;
+	*size = job->uncompressed_bytes;
+	zip->entry_bytes_remaining = 0;
+	zip->entry_compressed_bytes_read += job->compressed_used;
+	zip->entry_uncompressed_bytes_read += job->uncompressed_bytes;
+	zip->entry_crc32 = job->crc32;
+	zip->end_of_entry = 1;
+	return (ARCHIVE_OK);
+}
+#endif /* ZIP_PARALLEL_DECODE */
+
 static int
 read_decryption_header(struct archive_read *a)
 {
@@ -2925,6 +3347,12 @@ archive_read_format_zip_read_data(struct archive_read *a,
 
 #ifdef HAVE_ZLIB_H
 	case 8: /* Deflate compression. */
+#ifdef ZIP_PARALLEL_DECODE
+		if (zip->par_job != NULL && zip_par_wait(zip) == ARCHIVE_OK) {
+			r = zip_read_data_parallel(a, buff, size, offset);
+			break;
+		}
+#endif
 		r =  zip_read_data_deflate(a, buff, size, offset);
 		break;
 #endif
@@ -2940,8 +3368,8 @@ archive_read_format_zip_read_data(struct archive_read *a,
 	}
 	if (r != ARCHIVE_OK)
 		return (r);
-	/* Update checksum */
-	if (*size)
+	/* Update checksum (a worker already did it for a parallel job). */
+	if (*size && zip->par_job == NULL)
 		zip->entry_crc32 = zip->crc32func(zip->entry_crc32, *buff,
 		    (unsigned)*size);
 	/* If we hit the end, swallow any end-of-data marker. */
@@ -2991,6 +3419,10 @@ archive_read_format_zip_cleanup(struct archive_read *a)
 
 	zip = (struct zip *)(a->format->data);
 
+#ifdef ZIP_PARALLEL_DECODE
+	zip_par_free(zip);
+#endif
+
 #ifdef HAVE_ZLIB_H
 	if (zip->stream_valid)
 		inflateEnd(&zip->stream);
@@ -3089,6 +3521,24 @@ archive_read_format_zip_options(struct archive_read *a,
 	} else if (strcmp(key, "mac-ext") == 0) {
 		zip->process_mac_extensions = (val != NULL && val[0] != 0);
 		return (ARCHIVE_OK);
+	} else if (strcmp(key, "threads") == 0) {
+		long threads;
+		char *end;
+
+		if (val == NULL || val[0] == 0)
+			return (ARCHIVE_WARN);
+		threads = strtol(val, &end, 10);
+		if (*end != '\0' || threads < 0 || threads > 256)
+			return (ARCHIVE_WARN);
+		if (threads == 0) {
+#if defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+			threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+			if (threads < 1)
+				threads = 1;
+		}
+		zip->threads = (int)threads;
+		return (ARCHIVE_OK);
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -4090,6 +4540,12 @@ archive_read_format_zip_seekable_read_header(struct archive_read *a,
 		    SEEK_SET);
 	}
 	zip->unconsumed = 0;
+#ifdef ZIP_PARALLEL_DECODE
+	if (zip->par_job != NULL) {
+		zip_par_release(zip->par, zip->par_job);
+		zip->par_job = NULL;
+	}
+#endif
 	r = zip_read_local_file_header(a, entry, zip);
 	if (r != ARCHIVE_OK)
 		return r;
@@ -4098,6 +4554,10 @@ archive_read_format_zip_seekable_read_header(struct archive_read *a,
 		if (ret2 < ret)
 			ret = ret2;
 	}
+#ifdef ZIP_PARALLEL_DECODE
+	if (zip_par_read_ahead(a, zip) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+#endif
 	return (ret);
 }
 
@@ -243,6 +243,33 @@ __archive_write_filter(struct archive_write_filter *f,
 	return (r);
 }
 
+/*
+ * Parse the value of a filter's "threads" option: a decimal number of
+ * at most 256, where 0 means one thread per online CPU.
+ */
+int
+__archive_write_filter_parse_threads(const char *value, int *threads)
+{
+	char *endptr;
+	long n;
+
+	if (value == NULL || !(value[0] >= '0' && value[0] <= '9'))
+		return (ARCHIVE_WARN);
+	errno = 0;
+	n = strtol(value, &endptr, 10);
+	if (errno != 0 || *endptr != '\0' || n > 256)
+		return (ARCHIVE_WARN);
+	if (n == 0) {
+#if defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if (n < 1)
+			n = 1;
+	}
+	*threads = (int)n;
+	return (ARCHIVE_OK);
+}
+
 /*
  * Recursive function for opening the filter chain
  * Last filter is opened first
@@ -57,6 +57,7 @@ archive_write_set_compression_bzip2(struct archive *a)
 
 struct private_data {
 	int		 compression_level;
+	int		 threads;
 #if defined(HAVE_BZLIB_H) && defined(BZ_CONFIG_ERROR)
 	bz_stream	 stream;
 	int64_t		 total_in;
@@ -94,6 +95,7 @@ archive_write_add_filter_bzip2(struct archive *_a)
 		return (ARCHIVE_FATAL);
 	}
 	data->compression_level = 9; /* default */
+	data->threads = 1;
 
 	f->data = data;
 	f->options = &archive_compressor_bzip2_options;
@@ -139,6 +141,9 @@ archive_compressor_bzip2_options(struct archive_write_filter *f,
 			data->compression_level = 1;
 		return (ARCHIVE_OK);
 	}
+	if (strcmp(key, "threads") == 0)
+		return (__archive_write_filter_parse_threads(value,
+		    &data->threads));
 
 	/* Note: The "warn" return is just to inform the options
 	 * supervisor that we didn't handle it.  It will generate
@@ -194,6 +199,12 @@ archive_compressor_bzip2_open(struct archive_write_filter *f)
 	f->write = archive_compressor_bzip2_write;
 
 	/* Initialize compression library */
+#ifdef BZ_HAVE_MT
+	if (data->threads > 1)
+		ret = BZ2_bzCompressInitMT(&(data->stream),
+		    data->compression_level, 0, 30, data->threads);
+	else
+#endif
 	ret = BZ2_bzCompressInit(&(data->stream),
 	    data->compression_level, 0, 30);
 	if (ret == BZ_OK) {
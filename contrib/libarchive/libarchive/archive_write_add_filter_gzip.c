@@ -40,6 +40,10 @@ __FBSDID("$FreeBSD: head/lib/libarchive/archive_write_set_compression_gzip.c 201
 #ifdef HAVE_ZLIB_H
 #include <zlib.h>
 #endif
+#if defined(HAVE_ZLIB_H) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define	GZIP_MT	1
+#endif
 
 #include "archive.h"
 #include "archive_private.h"
@@ -57,15 +61,72 @@ archive_write_set_compression_gzip(struct archive *a)
 
 /* Don't compile this if we don't have zlib. */
 
+#ifdef GZIP_MT
+/*
+ * Block-parallel deflate, in the manner of pigz.  Input is cut into
+ * fixed-size blocks, each of which is compressed by a worker thread as
+ * a raw deflate fragment primed with the last 32KiB of the preceding
+ * block as a preset dictionary.  All but the final fragment end with a
+ * sync flush, so they land on a byte boundary and can simply be
+ * concatenated.  Each worker also computes the CRC of its block; the
+ * writer combines them in order, so the result is one ordinary gzip
+ * member that any gunzip can read.
+ */
+#define	GZIP_MT_BLOCK_SIZE	(128 * 1024)
+#define	GZIP_MT_DICT_SIZE	(32 * 1024)
+
+enum gzip_mt_state {
+	GZIP_JOB_FREE,
+	GZIP_JOB_FILLING,
+	GZIP_JOB_QUEUED,
+	GZIP_JOB_RUNNING,
+	GZIP_JOB_DONE
+};
+
+struct gzip_mt_job {
+	enum gzip_mt_state	 state;
+	int			 last;
+	int			 zret;
+	unsigned char		*in;
+	size_t			 in_len;
+	unsigned char		*dict;
+	size_t			 dict_len;
+	unsigned char		*out;
+	size_t			 out_len;
+	unsigned long		 crc;
+};
+
+struct gzip_mt {
+	pthread_mutex_t		 lock;
+	pthread_cond_t		 work_cv;	/* Workers wait for jobs. */
+	pthread_cond_t		 done_cv;	/* Writer waits for results. */
+	pthread_t		*workers;
+	int			 nworkers;
+	int			 shutdown;
+	int			 level;
+	size_t			 out_size;
+	struct gzip_mt_job	*jobs;
+	int			 njobs;
+	/* Monotonic job sequence numbers; slot is seq % njobs. */
+	uint64_t		 nsubmitted;
+	uint64_t		 nstarted;
+	uint64_t		 nemitted;
+};
+#endif
+
 struct private_data {
 	int		 compression_level;
 	int		 timestamp;
+	int		 threads;
 #ifdef HAVE_ZLIB_H
 	z_stream	 stream;
 	int64_t		 total_in;
 	unsigned char	*compressed;
 	size_t		 compressed_buffer_size;
 	unsigned long	 crc;
+#ifdef GZIP_MT
+	struct gzip_mt	*mt;
+#endif
 #else
 	struct archive_write_program_data *pdata;
 #endif
@@ -88,6 +149,17 @@ static int archive_compressor_gzip_free(struct archive_write_filter *);
 #ifdef HAVE_ZLIB_H
 static int drive_compressor(struct archive_write_filter *,
 		    struct private_data *, int finishing);
+static int write_trailer(struct archive_write_filter *,
+		    struct private_data *);
+#endif
+#ifdef GZIP_MT
+static int gzip_mt_open(struct archive_write_filter *,
+		    struct private_data *);
+static int gzip_mt_write(struct archive_write_filter *,
+		    struct private_data *, const void *, size_t);
+static int gzip_mt_close(struct archive_write_filter *,
+		    struct private_data *);
+static void gzip_mt_free(struct gzip_mt *);
 #endif
 
 
@@ -115,6 +187,7 @@ archive_write_add_filter_gzip(struct archive *_a)
 	f->free = &archive_compressor_gzip_free;
 	f->code = ARCHIVE_FILTER_GZIP;
 	f->name = "gzip";
+	data->threads = 1;
 #ifdef HAVE_ZLIB_H
 	data->compression_level = Z_DEFAULT_COMPRESSION;
 	return (ARCHIVE_OK);
@@ -138,6 +211,9 @@ archive_compressor_gzip_free(struct archive_write_filter *f)
 	struct private_data *data = (struct private_data *)f->data;
 
 #ifdef HAVE_ZLIB_H
+#ifdef GZIP_MT
+	gzip_mt_free(data->mt);
+#endif
 	free(data->compressed);
 #else
 	__archive_write_program_free(data->pdata);
@@ -167,6 +243,9 @@ archive_compressor_gzip_options(struct archive_write_filter *f, const char *key,
 		data->timestamp = (value == NULL)?-1:1;
 		return (ARCHIVE_OK);
 	}
+	if (strcmp(key, "threads") == 0)
+		return (__archive_write_filter_parse_threads(value,
+		    &data->threads));
 
 	/* Note: The "warn" return is just to inform the options
 	 * supervisor that we didn't handle it.  It will generate
@@ -234,6 +313,11 @@ archive_compressor_gzip_open(struct archive_write_filter *f)
 
 	f->write = archive_compressor_gzip_write;
 
+#ifdef GZIP_MT
+	if (data->threads > 1)
+		return (gzip_mt_open(f, data));
+#endif
+
 	/* Initialize compression library. */
 	ret = deflateInit2(&(data->stream),
 	    data->compression_level,
@@ -282,6 +366,11 @@ archive_compressor_gzip_write(struct archive_write_filter *f, const void *buff,
 	struct private_data *data = (struct private_data *)f->data;
 	int ret;
 
+#ifdef GZIP_MT
+	if (data->mt != NULL)
+		return (gzip_mt_write(f, data, buff, length));
+#endif
+
 	/* Update statistics */
 	data->crc = crc32(data->crc, (const Bytef *)buff, (uInt)length);
 	data->total_in += length;
@@ -301,10 +390,18 @@ archive_compressor_gzip_write(struct archive_write_filter *f, const void *buff,
 static int
 archive_compressor_gzip_close(struct archive_write_filter *f)
 {
-	unsigned char trailer[8];
 	struct private_data *data = (struct private_data *)f->data;
 	int ret;
 
+#ifdef GZIP_MT
+	if (data->mt != NULL) {
+		ret = gzip_mt_close(f, data);
+		if (ret == ARCHIVE_OK)
+			ret = write_trailer(f, data);
+		return (ret);
+	}
+#endif
+
 	/* Finish compression cycle */
 	ret = drive_compressor(f, data, 1);
 	if (ret == ARCHIVE_OK) {
@@ -313,18 +410,8 @@ archive_compressor_gzip_close(struct archive_write_filter *f)
 		    data->compressed,
 		    data->compressed_buffer_size - data->stream.avail_out);
 	}
-	if (ret == ARCHIVE_OK) {
-		/* Build and write out 8-byte trailer. */
-		trailer[0] = (uint8_t)(data->crc)&0xff;
-		trailer[1] = (uint8_t)(data->crc >> 8)&0xff;
-		trailer[2] = (uint8_t)(data->crc >> 16)&0xff;
-		trailer[3] = (uint8_t)(data->crc >> 24)&0xff;
-		trailer[4] = (uint8_t)(data->total_in)&0xff;
-		trailer[5] = (uint8_t)(data->total_in >> 8)&0xff;
-		trailer[6] = (uint8_t)(data->total_in >> 16)&0xff;
-		trailer[7] = (uint8_t)(data->total_in >> 24)&0xff;
-		ret = __archive_write_filter(f->next_filter, trailer, 8);
-	}
+	if (ret == ARCHIVE_OK)
+		ret = write_trailer(f, data);
 
 	switch (deflateEnd(&(data->stream))) {
 	case Z_OK:
@@ -337,6 +424,25 @@ archive_compressor_gzip_close(struct archive_write_filter *f)
 	return ret;
 }
 
+/*
+ * Build and write out 8-byte trailer.
+ */
+static int
+write_trailer(struct archive_write_filter *f, struct private_data *data)
+{
+	unsigned char trailer[8];
+
+	trailer[0] = (uint8_t)(data->crc)&0xff;
+	trailer[1] = (uint8_t)(data->crc >> 8)&0xff;
+	trailer[2] = (uint8_t)(data->crc >> 16)&0xff;
+	trailer[3] = (uint8_t)(data->crc >> 24)&0xff;
+	trailer[4] = (uint8_t)(data->total_in)&0xff;
+	trailer[5] = (uint8_t)(data->total_in >> 8)&0xff;
+	trailer[6] = (uint8_t)(data->total_in >> 16)&0xff;
+	trailer[7] = (uint8_t)(data->total_in >> 24)&0xff;
+	return (__archive_write_filter(f->next_filter, trailer, 8));
+}
+
 /*
  * Utility function to push input data through compressor,
  * writing full output blocks as necessary.
@@ -392,6 +498,346 @@ drive_compressor(struct archive_write_filter *f,
 	}
 }
 
+#ifdef GZIP_MT
+/*
+ * Worker: compress one block.  Each worker keeps its own deflate
+ * stream and just resets it between blocks.
+ */
+static void
+gzip_mt_compress(struct gzip_mt *mt, z_stream *strm, struct gzip_mt_job *job)
+{
+	int ret;
+
+	job->crc = crc32(crc32(0L, NULL, 0), job->in, (uInt)job->in_len);
+
+	ret = deflateReset(strm);
+	if (ret == Z_OK && job->dict_len > 0)
+		ret = deflateSetDictionary(strm, job->dict,
+		    (uInt)job->dict_len);
+	if (ret != Z_OK) {
+		job->zret = ret;
+		return;
+	}
+	strm->next_in = job->in;
+	strm->avail_in = (uInt)job->in_len;
+	strm->next_out = job->out;
+	strm->avail_out = (uInt)mt->out_size;
+	ret = deflate(strm, job->last ? Z_FINISH : Z_SYNC_FLUSH);
+	job->out_len = mt->out_size - strm->avail_out;
+	if (job->last)
+		job->zret = (ret == Z_STREAM_END) ? Z_OK : Z_BUF_ERROR;
+	else
+		job->zret = (ret == Z_OK && strm->avail_in == 0 &&
+		    strm->avail_out > 0) ? Z_OK : Z_BUF_ERROR;
+}
+
+static void *
+gzip_mt_worker(void *arg)
+{
+	struct gzip_mt *mt = (struct gzip_mt *)arg;
+	struct gzip_mt_job *job;
+	z_stream strm;
+	int initret;
+
+	memset(&strm, 0, sizeof(strm));
+	initret = deflateInit2(&strm, mt->level, Z_DEFLATED, -15, 8,
+	    Z_DEFAULT_STRATEGY);
+
+	pthread_mutex_lock(&mt->lock);
+	for (;;) {
+		while (!mt->shutdown && mt->nstarted == mt->nsubmitted)
+			pthread_cond_wait(&mt->work_cv, &mt->lock);
+		if (mt->nstarted == mt->nsubmitted)
+			break;
+		job = &mt->jobs[mt->nstarted++ % mt->njobs];
+		job->state = GZIP_JOB_RUNNING;
+		pthread_mutex_unlock(&mt->lock);
+
+		if (initret == Z_OK)
+			gzip_mt_compress(mt, &strm, job);
+		else
+			job->zret = initret;
+
+		pthread_mutex_lock(&mt->lock);
+		job->state = GZIP_JOB_DONE;
+		pthread_cond_broadcast(&mt->done_cv);
+	}
+	pthread_mutex_unlock(&mt->lock);
+
+	if (initret == Z_OK)
+		deflateEnd(&strm);
+	return (NULL);
+}
+
+/*
+ * Stop and join the workers.  Jobs already queued are finished first.
+ */
+static void
+gzip_mt_stop(struct gzip_mt *mt)
+{
+	int i;
+
+	if (mt->workers == NULL)
+		return;
+	pthread_mutex_lock(&mt->lock);
+	mt->shutdown = 1;
+	pthread_cond_broadcast(&mt->work_cv);
+	pthread_mutex_unlock(&mt->lock);
+	for (i = 0; i < mt->nworkers; i++)
+		pthread_join(mt->workers[i], NULL);
+	free(mt->workers);
+	mt->workers = NULL;
+	mt->nworkers = 0;
+}
+
+static void
+gzip_mt_free(struct gzip_mt *mt)
+{
+	int i;
+
+	if (mt == NULL)
+		return;
+	gzip_mt_stop(mt);
+	if (mt->jobs != NULL) {
+		for (i = 0; i < mt->njobs; i++) {
+			free(mt->jobs[i].in);
+			free(mt->jobs[i].dict);
+			free(mt->jobs[i].out);
+		}
+		free(mt->jobs);
+	}
+	pthread_cond_destroy(&mt->done_cv);
+	pthread_cond_destroy(&mt->work_cv);
+	pthread_mutex_destroy(&mt->lock);
+	free(mt);
+}
+
+static int
+gzip_mt_open(struct archive_write_filter *f, struct private_data *data)
+{
+	struct gzip_mt *mt;
+	int i;
+
+	mt = calloc(1, sizeof(*mt));
+	if (mt == NULL) {
+		archive_set_error(f->archive, ENOMEM,
+		    "Can't allocate data for compression");
+		return (ARCHIVE_FATAL);
+	}
+	pthread_mutex_init(&mt->lock, NULL);
+	pthread_cond_init(&mt->work_cv, NULL);
+	pthread_cond_init(&mt->done_cv, NULL);
+	data->mt = mt;
+
+	mt->level = data->compression_level;
+	/* Room for a sync flush marker on top of the worst case. */
+	mt->out_size = deflateBound(NULL, GZIP_MT_BLOCK_SIZE) + 16;
+	/* Two jobs per worker keeps everyone busy while we write. */
+	mt->njobs = data->threads * 2;
+	mt->jobs = calloc(mt->njobs, sizeof(*mt->jobs));
+	if (mt->jobs == NULL)
+		goto nomem;
+	for (i = 0; i < mt->njobs; i++) {
+		mt->jobs[i].in = malloc(GZIP_MT_BLOCK_SIZE);
+		mt->jobs[i].dict = malloc(GZIP_MT_DICT_SIZE);
+		mt->jobs[i].out = malloc(mt->out_size);
+		if (mt->jobs[i].in == NULL || mt->jobs[i].dict == NULL ||
+		    mt->jobs[i].out == NULL)
+			goto nomem;
+	}
+
+	mt->workers = calloc(data->threads, sizeof(*mt->workers));
+	if (mt->workers == NULL)
+		goto nomem;
+	for (i = 0; i < data->threads; i++) {
+		if (pthread_create(&mt->workers[i], NULL, gzip_mt_worker,
+		    mt) != 0)
+			break;
+		mt->nworkers++;
+	}
+	if (mt->nworkers == 0) {
+		free(mt->workers);
+		mt->workers = NULL;
+		archive_set_error(f->archive, ARCHIVE_ERRNO_MISC,
+		    "Can't create compression threads");
+		return (ARCHIVE_FATAL);
+	}
+
+	/* The header was primed in the output buffer; send it now. */
+	return (__archive_write_filter(f->next_filter, data->compressed,
+	    data->stream.next_out - data->compressed));
+nomem:
+	archive_set_error(f->archive, ENOMEM,
+	    "Can't allocate data for compression buffer");
+	return (ARCHIVE_FATAL);
+}
+
+/*
+ * Write out finished jobs in submission order.  If `wait' is set,
+ * block until at least the oldest outstanding job has been written.
+ */
+static int
+gzip_mt_emit(struct archive_write_filter *f, struct private_data *data,
+    int wait)
+{
+	struct gzip_mt *mt = data->mt;
+	struct gzip_mt_job *job;
+	int ret;
+
+	pthread_mutex_lock(&mt->lock);
+	while (mt->nemitted < mt->nsubmitted) {
+		job = &mt->jobs[mt->nemitted % mt->njobs];
+		if (job->state != GZIP_JOB_DONE) {
+			if (!wait)
+				break;
+			pthread_cond_wait(&mt->done_cv, &mt->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&mt->lock);
+
+		if (job->zret != Z_OK) {
+			archive_set_error(f->archive, ARCHIVE_ERRNO_MISC,
+			    "GZip compression failed:"
+			    " deflate() call returned status %d",
+			    job->zret);
+			return (ARCHIVE_FATAL);
+		}
+		ret = __archive_write_filter(f->next_filter, job->out,
+		    job->out_len);
+		if (ret != ARCHIVE_OK)
+			return (ARCHIVE_FATAL);
+		data->crc = crc32_combine(data->crc, job->crc,
+		    (z_off_t)job->in_len);
+
+		pthread_mutex_lock(&mt->lock);
+		job->state = GZIP_JOB_FREE;
+		mt->nemitted++;
+		wait = 0;
+	}
+	pthread_mutex_unlock(&mt->lock);
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Return the job currently being filled, claiming a new slot if
+ * needed.  When every slot is in flight, drain the oldest one first.
+ */
+static int
+gzip_mt_fill_job(struct archive_write_filter *f, struct private_data *data,
+    struct gzip_mt_job **jobp)
+{
+	struct gzip_mt *mt = data->mt;
+	struct gzip_mt_job *job, *prev;
+	size_t dlen;
+	int filling, ret;
+
+	/* Workers update job states, so they are only looked at locked. */
+	job = &mt->jobs[mt->nsubmitted % mt->njobs];
+	pthread_mutex_lock(&mt->lock);
+	filling = (job->state == GZIP_JOB_FILLING);
+	pthread_mutex_unlock(&mt->lock);
+	if (filling) {
+		*jobp = job;
+		return (ARCHIVE_OK);
+	}
+	while (mt->nsubmitted - mt->nemitted >= (uint64_t)mt->njobs) {
+		ret = gzip_mt_emit(f, data, 1);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+	}
+
+	pthread_mutex_lock(&mt->lock);
+	job->state = GZIP_JOB_FILLING;
+	pthread_mutex_unlock(&mt->lock);
+	job->last = 0;
+	job->in_len = 0;
+	job->dict_len = 0;
+	/*
+	 * Prime with the tail of the previous block.  That block cannot
+	 * have been recycled yet, since its slot is only reused after
+	 * this one has been written out.
+	 */
+	if (mt->nsubmitted > 0) {
+		prev = &mt->jobs[(mt->nsubmitted - 1) % mt->njobs];
+		dlen = prev->in_len;
+		if (dlen > GZIP_MT_DICT_SIZE)
+			dlen = GZIP_MT_DICT_SIZE;
+		memcpy(job->dict, prev->in + prev->in_len - dlen, dlen);
+		job->dict_len = dlen;
+	}
+	*jobp = job;
+	return (ARCHIVE_OK);
+}
+
+static void
+gzip_mt_submit(struct gzip_mt *mt, struct gzip_mt_job *job)
+{
+	pthread_mutex_lock(&mt->lock);
+	job->state = GZIP_JOB_QUEUED;
+	mt->nsubmitted++;
+	pthread_cond_signal(&mt->work_cv);
+	pthread_mutex_unlock(&mt->lock);
+}
+
+static int
+gzip_mt_write(struct archive_write_filter *f, struct private_data *data,
+    const void *buff, size_t length)
+{
+	struct gzip_mt *mt = data->mt;
+	struct gzip_mt_job *job;
+	const unsigned char *p = buff;
+	size_t n;
+	int ret;
+
+	data->total_in += length;
+	while (length > 0) {
+		ret = gzip_mt_fill_job(f, data, &job);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+		n = GZIP_MT_BLOCK_SIZE - job->in_len;
+		if (n > length)
+			n = length;
+		memcpy(job->in + job->in_len, p, n);
+		job->in_len += n;
+		p += n;
+		length -= n;
+		if (job->in_len == GZIP_MT_BLOCK_SIZE) {
+			gzip_mt_submit(mt, job);
+			/* Opportunistically flush whatever is ready. */
+			ret = gzip_mt_emit(f, data, 0);
+			if (ret != ARCHIVE_OK)
+				return (ret);
+		}
+	}
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Submit the final (possibly empty) block, which carries the deflate
+ * end-of-stream marker, and drain everything.
+ */
+static int
+gzip_mt_close(struct archive_write_filter *f, struct private_data *data)
+{
+	struct gzip_mt *mt = data->mt;
+	struct gzip_mt_job *job;
+	int ret;
+
+	ret = gzip_mt_fill_job(f, data, &job);
+	if (ret != ARCHIVE_OK)
+		return (ret);
+	job->last = 1;
+	gzip_mt_submit(mt, job);
+	while (mt->nemitted < mt->nsubmitted) {
+		ret = gzip_mt_emit(f, data, 1);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+	}
+	gzip_mt_stop(mt);
+	return (ARCHIVE_OK);
+}
+#endif /* GZIP_MT */
+
 #else /* HAVE_ZLIB_H */
 
 static int
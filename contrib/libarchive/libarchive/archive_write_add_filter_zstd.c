@@ -37,6 +37,9 @@ __FBSDID("$FreeBSD$");
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #ifdef HAVE_ZSTD_H
 #include <zstd.h>
 #endif
@@ -50,6 +53,7 @@ __FBSDID("$FreeBSD$");
 
 struct private_data {
 	int		 compression_level;
+	int		 threads;
 #if HAVE_ZSTD_H && HAVE_LIBZSTD
 	ZSTD_CStream	*cstream;
 	int64_t		 total_in;
@@ -68,6 +72,7 @@ struct private_data {
 
 #define MINVER_NEGCLEVEL 10304
 #define MINVER_MINCLEVEL 10306
+#define MINVER_NBWORKERS 10400
 
 static int archive_compressor_zstd_options(struct archive_write_filter *,
 		    const char *, const char *);
@@ -107,6 +112,7 @@ archive_write_add_filter_zstd(struct archive *_a)
 	f->code = ARCHIVE_FILTER_ZSTD;
 	f->name = "zstd";
 	data->compression_level = CLEVEL_DEFAULT;
+	data->threads = 1;
 #if HAVE_ZSTD_H && HAVE_LIBZSTD
 	data->cstream = ZSTD_createCStream();
 	if (data->cstream == NULL) {
@@ -204,6 +210,9 @@ archive_compressor_zstd_options(struct archive_write_filter *f, const char *key,
 		}
 		data->compression_level = level;
 		return (ARCHIVE_OK);
+	} else if (strcmp(key, "threads") == 0) {
+		return (__archive_write_filter_parse_threads(value,
+		    &data->threads));
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -252,6 +261,20 @@ archive_compressor_zstd_open(struct archive_write_filter *f)
 		return (ARCHIVE_FATAL);
 	}
 
+	/*
+	 * Hand the stream to zstdmt workers.  A library built without
+	 * ZSTD_MULTITHREAD rejects nbWorkers > 0; stay single-threaded.
+	 */
+#if ZSTD_VERSION_NUMBER >= MINVER_NBWORKERS
+	if (ZSTD_versionNumber() >= MINVER_NBWORKERS) {
+		size_t zret = ZSTD_CCtx_setParameter(data->cstream,
+		    ZSTD_c_nbWorkers, data->threads > 1 ? data->threads : 0);
+		if (ZSTD_isError(zret) && data->threads > 1)
+			(void)ZSTD_CCtx_setParameter(data->cstream,
+			    ZSTD_c_nbWorkers, 0);
+	}
+#endif
+
 	return (ARCHIVE_OK);
 }
 
@@ -366,6 +389,14 @@ archive_compressor_zstd_open(struct archive_write_filter *f)
 		archive_strcat(&as, " --ultra");
 	}
 
+	if (data->threads != 1) {
+		struct archive_string as2;
+		archive_string_init(&as2);
+		archive_string_sprintf(&as2, " --threads=%d", data->threads);
+		archive_string_concat(&as, &as2);
+		archive_string_free(&as2);
+	}
+
 	f->write = archive_compressor_zstd_write;
 	r = __archive_write_program_open(f, data->pdata, as.s);
 	archive_string_free(&as);
@@ -90,6 +90,9 @@ __FBSDID("$FreeBSD$");
 #ifdef HAVE_LIMITS_H
 #include <limits.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #ifdef HAVE_PWD_H
 #include <pwd.h>
 #endif
@@ -217,6 +220,69 @@ struct fixup_entry {
 #define	TODO_MAC_METADATA	ARCHIVE_EXTRACT_MAC_METADATA
 #define	TODO_HFS_COMPRESSION	ARCHIVE_EXTRACT_HFS_COMPRESSION_FORCED
 
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_FCHMOD) && \
+    defined(HAVE_FCHOWN) && defined(HAVE_FTRUNCATE) && \
+    ((defined(HAVE_UTIMENSAT) && defined(HAVE_FUTIMENS)) || \
+     (defined(HAVE_UTIMES) && defined(HAVE_FUTIMES))) && \
+    !defined(F_SETTIMES)
+#define	ASYNC_WRITERS	1
+
+/*
+ * Asynchronous writers.
+ *
+ * When enabled with archive_write_disk_set_writer_threads(), small
+ * regular files are created on the caller's thread as usual -- all
+ * path handling, directory creation and security checks stay where
+ * they were -- but their data is buffered and the write(), fchown(),
+ * fchmod(), futimens() and close() calls are handed to a pool of
+ * worker threads that only ever touch the open descriptor.
+ * Anything that needs more than that (SUID/SGID checks, xattrs,
+ * ACLs, file flags, temporary files, sparse or unknown-size data)
+ * takes the ordinary synchronous path.
+ *
+ * The pool is drained whenever ordering could be observed: before
+ * an entry replaces or stats an existing object, before a hardlink
+ * is made, and before directory fixups at close.
+ */
+#define	ASYNC_MAX_FILE_SIZE	(1024 * 1024)
+#define	ASYNC_MAX_PENDING_BYTES	(64 * 1024 * 1024)
+#define	ASYNC_JOBS_PER_THREAD	16
+
+#define	ASYNC_CHOWN	1
+#define	ASYNC_CHMOD	2
+#define	ASYNC_TIMES	4
+
+struct async_job {
+	struct async_job	*next;
+	int			 fd;
+	int			 todo;
+	char			*buff;
+	size_t			 size;		/* Bytes of buff to write. */
+	int64_t			 filesize;
+	int64_t			 uid;
+	int64_t			 gid;
+	mode_t			 mode;
+	time_t			 atime, birthtime, mtime;
+	long			 atime_nanos, birthtime_nanos, mtime_nanos;
+	char			*name;		/* For error messages only. */
+};
+
+struct async_writers {
+	pthread_mutex_t		 lock;
+	pthread_cond_t		 work_cv;	/* Workers wait for jobs. */
+	pthread_cond_t		 idle_cv;	/* Caller waits for room. */
+	pthread_t		*threads;
+	int			 nthreads;
+	int			 shutdown;
+	struct async_job	*head, **tailp;
+	int			 pending;	/* Queued plus running. */
+	size_t			 pending_bytes;
+	/* First failure seen by a worker, reported by the caller. */
+	int			 err;
+	struct archive_string	 err_msg;
+};
+#endif
+
 struct archive_write_disk {
 	struct archive	archive;
 
@@ -308,6 +374,11 @@ struct archive_write_disk {
 	int			 stream_valid;
 	int			 decmpfs_compression_level;
 #endif
+#ifdef ASYNC_WRITERS
+	struct async_writers	*async;
+	/* Job being filled for the current entry, if any. */
+	struct async_job	*async_job;
+#endif
 };
 
 /*
@@ -395,6 +466,15 @@ static int	set_times_from_entry(struct archive_write_disk *);
 static struct fixup_entry *sort_dir_list(struct fixup_entry *p);
 static ssize_t	write_data_block(struct archive_write_disk *,
 		    const char *, size_t);
+#ifdef ASYNC_WRITERS
+static void	async_begin_entry(struct archive_write_disk *);
+static ssize_t	async_write_data(struct archive_write_disk *,
+		    const char *, size_t);
+static int	async_finish_entry(struct archive_write_disk *);
+static void	async_drain(struct archive_write_disk *);
+static int	async_check_error(struct archive_write_disk *);
+static void	async_free(struct archive_write_disk *);
+#endif
 
 static struct archive_vtable *archive_write_disk_vtable(void);
 
@@ -767,6 +847,12 @@ _archive_write_disk_header(struct archive *_a, struct archive_entry *entry)
 	edit_deep_directories(a);
 #endif
 
+#ifdef ASYNC_WRITERS
+	/* The link target may still be in a writer's hands. */
+	if (archive_entry_hardlink(a->entry) != NULL)
+		async_drain(a);
+#endif
+
 	ret = restore_entry(a);
 
 #if defined(__APPLE__) && defined(UF_COMPRESSED) && defined(HAVE_ZLIB_H)
@@ -898,6 +984,10 @@ _archive_write_disk_header(struct archive *_a, struct archive_entry *entry)
 	/* We've created the object and are ready to pour data into it. */
 	if (ret >= ARCHIVE_WARN)
 		a->archive.state = ARCHIVE_STATE_DATA;
+#ifdef ASYNC_WRITERS
+	if (ret >= ARCHIVE_WARN)
+		async_begin_entry(a);
+#endif
 	/*
 	 * If it's not open, tell our client not to try writing.
 	 * In particular, dirs, links, etc, don't get written to.
@@ -938,6 +1028,11 @@ write_data_block(struct archive_write_disk *a, const char *buff, size_t size)
 		return (ARCHIVE_WARN);
 	}
 
+#ifdef ASYNC_WRITERS
+	if (a->async_job != NULL)
+		return (async_write_data(a, buff, size));
+#endif
+
 	if (a->flags & ARCHIVE_EXTRACT_SPARSE) {
 #if HAVE_STRUCT_STAT_ST_BLKSIZE
 		int r;
@@ -1008,6 +1103,406 @@ write_data_block(struct archive_write_disk *a, const char *buff, size_t size)
 	return (start_size - size);
 }
 
+#ifdef ASYNC_WRITERS
+/*
+ * Runs on a worker thread.  Only the descriptor is used; the name is
+ * never resolved here since the caller may chdir() for deep paths.
+ * Returns 0 or an errno value, with *what describing the failure.
+ */
+static int
+async_run_job(struct async_job *job, const char **what)
+{
+	const char *p = job->buff;
+	size_t size = job->size;
+	ssize_t bytes_written;
+	int r = 0;
+
+	while (size > 0) {
+		bytes_written = write(job->fd, p, size);
+		if (bytes_written < 0) {
+			if (errno == EINTR)
+				continue;
+			*what = "Write failed";
+			r = errno;
+			goto done;
+		}
+		p += bytes_written;
+		size -= bytes_written;
+	}
+	if ((int64_t)job->size < job->filesize &&
+	    ftruncate(job->fd, job->filesize) != 0) {
+		*what = "File size could not be restored";
+		r = errno;
+		goto done;
+	}
+	if ((job->todo & ASYNC_CHOWN) &&
+	    fchown(job->fd, (uid_t)job->uid, (gid_t)job->gid) != 0) {
+		*what = "Can't set user/group";
+		r = errno;
+	}
+	if ((job->todo & ASYNC_CHMOD) && fchmod(job->fd, job->mode) != 0 &&
+	    r == 0) {
+		*what = "Can't set permissions";
+		r = errno;
+	}
+	if (job->todo & ASYNC_TIMES) {
+		int r1 = 0, r2;
+#ifdef HAVE_STRUCT_STAT_ST_BIRTHTIME
+		/* Same birthtime dance as set_times(). */
+		if (job->birthtime < job->mtime
+		    || (job->birthtime == job->mtime
+		    && job->birthtime_nanos < job->mtime_nanos))
+			r1 = set_time(job->fd, job->mode, NULL,
+			    job->atime, job->atime_nanos,
+			    job->birthtime, job->birthtime_nanos);
+#endif
+		r2 = set_time(job->fd, job->mode, NULL,
+		    job->atime, job->atime_nanos,
+		    job->mtime, job->mtime_nanos);
+		if ((r1 != 0 || r2 != 0) && r == 0) {
+			*what = "Can't restore time";
+			r = errno;
+		}
+	}
+done:
+	close(job->fd);
+	return (r);
+}
+
+static void *
+async_worker(void *arg)
+{
+	struct async_writers *aw = (struct async_writers *)arg;
+	struct async_job *job;
+	const char *what;
+	int r;
+
+	pthread_mutex_lock(&aw->lock);
+	for (;;) {
+		while (!aw->shutdown && aw->head == NULL)
+			pthread_cond_wait(&aw->work_cv, &aw->lock);
+		if (aw->head == NULL)
+			break;
+		job = aw->head;
+		aw->head = job->next;
+		if (aw->head == NULL)
+			aw->tailp = &aw->head;
+		pthread_mutex_unlock(&aw->lock);
+
+		what = NULL;
+		r = async_run_job(job, &what);
+
+		pthread_mutex_lock(&aw->lock);
+		if (r != 0 && aw->err == 0) {
+			aw->err = r;
+			archive_string_empty(&aw->err_msg);
+			archive_string_sprintf(&aw->err_msg, "%s: %s",
+			    what, job->name);
+		}
+		aw->pending--;
+		aw->pending_bytes -= job->size;
+		pthread_cond_broadcast(&aw->idle_cv);
+		free(job->buff);
+		free(job->name);
+		free(job);
+	}
+	pthread_mutex_unlock(&aw->lock);
+	return (NULL);
+}
+
+/*
+ * Wait until every submitted job has been written and closed.
+ */
+static void
+async_drain(struct archive_write_disk *a)
+{
+	struct async_writers *aw = a->async;
+
+	if (aw == NULL)
+		return;
+	pthread_mutex_lock(&aw->lock);
+	while (aw->pending > 0)
+		pthread_cond_wait(&aw->idle_cv, &aw->lock);
+	pthread_mutex_unlock(&aw->lock);
+}
+
+/*
+ * Report the first failure seen by a worker since the last call.
+ * It surfaces on whichever entry is being finished at the time.
+ */
+static int
+async_check_error(struct archive_write_disk *a)
+{
+	struct async_writers *aw = a->async;
+	int ret = ARCHIVE_OK;
+
+	if (aw == NULL)
+		return (ARCHIVE_OK);
+	pthread_mutex_lock(&aw->lock);
+	if (aw->err != 0) {
+		archive_set_error(&a->archive, aw->err, "%s",
+		    aw->err_msg.s);
+		aw->err = 0;
+		ret = ARCHIVE_WARN;
+	}
+	pthread_mutex_unlock(&aw->lock);
+	return (ret);
+}
+
+/*
+ * Stop the workers.  Queued jobs are finished first.
+ */
+static void
+async_free(struct archive_write_disk *a)
+{
+	struct async_writers *aw = a->async;
+	int i;
+
+	if (aw == NULL)
+		return;
+	pthread_mutex_lock(&aw->lock);
+	aw->shutdown = 1;
+	pthread_cond_broadcast(&aw->work_cv);
+	pthread_mutex_unlock(&aw->lock);
+	for (i = 0; i < aw->nthreads; i++)
+		pthread_join(aw->threads[i], NULL);
+	free(aw->threads);
+	archive_string_free(&aw->err_msg);
+	pthread_cond_destroy(&aw->idle_cv);
+	pthread_cond_destroy(&aw->work_cv);
+	pthread_mutex_destroy(&aw->lock);
+	free(aw);
+	a->async = NULL;
+}
+
+/*
+ * Decide whether the entry just created can be finished by a worker,
+ * and if so start buffering its data.
+ */
+static void
+async_begin_entry(struct archive_write_disk *a)
+{
+	struct async_writers *aw = a->async;
+	struct async_job *job;
+	unsigned long set, clear;
+	size_t metadata_size;
+
+	if (aw == NULL || a->fd < 0 || a->tmpname != NULL)
+		return;
+	if (!S_ISREG(a->mode) || a->filesize < 0 ||
+	    a->filesize > ASYNC_MAX_FILE_SIZE)
+		return;
+	if (archive_entry_hardlink(a->entry) != NULL)
+		return;
+	if (a->flags & ARCHIVE_EXTRACT_SPARSE)
+		return;
+	if (a->todo & (TODO_SUID | TODO_SGID | TODO_HFS_COMPRESSION |
+	    TODO_APPLEDOUBLE))
+		return;
+	if ((a->todo & TODO_XATTR) && archive_entry_xattr_count(a->entry) > 0)
+		return;
+	if ((a->todo & TODO_ACLS) && archive_entry_acl_count(a->entry,
+	    ARCHIVE_ENTRY_ACL_TYPE_POSIX1E | ARCHIVE_ENTRY_ACL_TYPE_NFS4) > 0)
+		return;
+	if (a->todo & TODO_FFLAGS) {
+		archive_entry_fflags(a->entry, &set, &clear);
+		if (set != 0 || clear != 0)
+			return;
+	}
+	if ((a->todo & TODO_MAC_METADATA) &&
+	    archive_entry_mac_metadata(a->entry, &metadata_size) != NULL &&
+	    metadata_size > 0)
+		return;
+
+	/* Bound the number of open files and the memory held. */
+	pthread_mutex_lock(&aw->lock);
+	while (aw->pending > 0 &&
+	    (aw->pending >= aw->nthreads * ASYNC_JOBS_PER_THREAD ||
+	     aw->pending_bytes + (size_t)a->filesize >
+	     ASYNC_MAX_PENDING_BYTES))
+		pthread_cond_wait(&aw->idle_cv, &aw->lock);
+	pthread_mutex_unlock(&aw->lock);
+
+	job = calloc(1, sizeof(*job));
+	if (job == NULL)
+		return;
+	job->buff = malloc(a->filesize > 0 ? (size_t)a->filesize : 1);
+	job->name = strdup(archive_entry_pathname(a->entry));
+	if (job->buff == NULL || job->name == NULL) {
+		free(job->buff);
+		free(job->name);
+		free(job);
+		return;
+	}
+	job->fd = -1;
+	a->async_job = job;
+}
+
+/*
+ * Buffer entry data; mirrors the bookkeeping in write_data_block().
+ */
+static ssize_t
+async_write_data(struct archive_write_disk *a, const char *buff, size_t size)
+{
+	struct async_job *job = a->async_job;
+
+	if (a->offset >= a->filesize)
+		return (0);
+	if ((int64_t)(a->offset + size) > a->filesize)
+		size = (size_t)(a->filesize - a->offset);
+	/* Anything skipped over reads back as zeros. */
+	if ((size_t)a->offset > job->size)
+		memset(job->buff + job->size, 0, (size_t)a->offset - job->size);
+	memcpy(job->buff + a->offset, buff, size);
+	a->offset += size;
+	a->fd_offset = a->offset;
+	a->total_bytes_written += size;
+	if ((size_t)a->offset > job->size)
+		job->size = (size_t)a->offset;
+	return (size);
+}
+
+/*
+ * Resolve the metadata that has to be computed on the caller's
+ * thread, then queue the job.
+ */
+static int
+async_finish_entry(struct archive_write_disk *a)
+{
+	struct async_writers *aw = a->async;
+	struct async_job *job = a->async_job;
+	int ret = ARCHIVE_OK, r;
+
+	a->async_job = NULL;
+	job->fd = a->fd;
+	a->fd = -1;
+	job->filesize = a->filesize;
+	job->mode = a->mode & 07777;
+	if (a->todo & TODO_MODE)
+		job->todo |= ASYNC_CHMOD;
+	if (a->todo & TODO_OWNER) {
+		a->uid = archive_write_disk_uid(&a->archive,
+		    archive_entry_uname(a->entry),
+		    archive_entry_uid(a->entry));
+		a->gid = archive_write_disk_gid(&a->archive,
+		    archive_entry_gname(a->entry),
+		    archive_entry_gid(a->entry));
+#if !defined(__CYGWIN__) && !defined(__linux__)
+		/* See set_ownership(). */
+		if (a->user_uid != 0 && a->user_uid != a->uid) {
+			archive_set_error(&a->archive, errno,
+			    "Can't set UID=%jd", (intmax_t)a->uid);
+			ret = ARCHIVE_WARN;
+		} else
+#endif
+		{
+			job->todo |= ASYNC_CHOWN;
+			job->uid = a->uid;
+			job->gid = a->gid;
+		}
+	}
+	if ((a->todo & TODO_TIMES)
+	    && (archive_entry_atime_is_set(a->entry)
+#if HAVE_STRUCT_STAT_ST_BIRTHTIME
+	    || archive_entry_birthtime_is_set(a->entry)
+#endif
+	    || archive_entry_mtime_is_set(a->entry))) {
+		/* Same defaults as set_times_from_entry(). */
+		job->todo |= ASYNC_TIMES;
+		job->atime = job->birthtime = job->mtime = a->start_time;
+		if (archive_entry_atime_is_set(a->entry)) {
+			job->atime = archive_entry_atime(a->entry);
+			job->atime_nanos = archive_entry_atime_nsec(a->entry);
+		}
+		if (archive_entry_birthtime_is_set(a->entry)) {
+			job->birthtime = archive_entry_birthtime(a->entry);
+			job->birthtime_nanos =
+			    archive_entry_birthtime_nsec(a->entry);
+		}
+		if (archive_entry_mtime_is_set(a->entry)) {
+			job->mtime = archive_entry_mtime(a->entry);
+			job->mtime_nanos = archive_entry_mtime_nsec(a->entry);
+		}
+	}
+
+	pthread_mutex_lock(&aw->lock);
+	*aw->tailp = job;
+	aw->tailp = &job->next;
+	aw->pending++;
+	aw->pending_bytes += job->size;
+	pthread_cond_signal(&aw->work_cv);
+	pthread_mutex_unlock(&aw->lock);
+
+	archive_entry_free(a->entry);
+	a->entry = NULL;
+	a->archive.state = ARCHIVE_STATE_HEADER;
+	r = async_check_error(a);
+	return (r < ret ? r : ret);
+}
+#endif /* ASYNC_WRITERS */
+
+/*
+ * Hand file data and final metadata for small regular files to
+ * a pool of writer threads.  See the comment above struct
+ * async_writers.
+ */
+int
+archive_write_disk_set_writer_threads(struct archive *_a, int nthreads)
+{
+	struct archive_write_disk *a = (struct archive_write_disk *)_a;
+#ifdef ASYNC_WRITERS
+	struct async_writers *aw;
+	int i;
+#endif
+
+	archive_check_magic(&a->archive, ARCHIVE_WRITE_DISK_MAGIC,
+	    ARCHIVE_STATE_HEADER, "archive_write_disk_set_writer_threads");
+#ifdef ASYNC_WRITERS
+	async_drain(a);
+	if (async_check_error(a) != ARCHIVE_OK)
+		return (ARCHIVE_WARN);
+	async_free(a);
+	if (nthreads <= 0)
+		return (ARCHIVE_OK);
+	if (nthreads > 256)
+		nthreads = 256;
+
+	aw = calloc(1, sizeof(*aw));
+	if (aw != NULL)
+		aw->threads = calloc(nthreads, sizeof(*aw->threads));
+	if (aw == NULL || aw->threads == NULL) {
+		free(aw);
+		archive_set_error(&a->archive, ENOMEM, "Out of memory");
+		return (ARCHIVE_FATAL);
+	}
+	pthread_mutex_init(&aw->lock, NULL);
+	pthread_cond_init(&aw->work_cv, NULL);
+	pthread_cond_init(&aw->idle_cv, NULL);
+	aw->tailp = &aw->head;
+	a->async = aw;
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&aw->threads[i], NULL, async_worker,
+		    aw) != 0)
+			break;
+		aw->nthreads++;
+	}
+	if (aw->nthreads == 0) {
+		async_free(a);
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+		    "Can't create writer threads");
+		return (ARCHIVE_WARN);
+	}
+	return (ARCHIVE_OK);
+#else
+	if (nthreads > 0) {
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+		    "Writer threads are not supported on this platform");
+		return (ARCHIVE_WARN);
+	}
+	return (ARCHIVE_OK);
+#endif
+}
+
 #if defined(__APPLE__) && defined(UF_COMPRESSED) && defined(HAVE_SYS_XATTR_H)\
 	&& defined(HAVE_ZLIB_H)
 
@@ -1674,6 +2169,11 @@ _archive_write_disk_finish_entry(struct archive *_a)
 		return (ARCHIVE_OK);
 	archive_clear_error(&a->archive);
 
+#ifdef ASYNC_WRITERS
+	if (a->async_job != NULL)
+		return (async_finish_entry(a));
+#endif
+
 	/* Pad or truncate file to the right size. */
 	if (a->fd < 0) {
 		/* There's no file. */
@@ -2088,6 +2588,15 @@ restore_entry(struct archive_write_disk *a)
 		return (ARCHIVE_OK);
 	}
 
+#ifdef ASYNC_WRITERS
+	/*
+	 * Whatever is in the way may be a file a writer has not
+	 * finished yet; let it settle before we stat or replace it.
+	 */
+	if (en == EISDIR || en == EEXIST)
+		async_drain(a);
+#endif
+
 	/*
 	 * Some platforms return EISDIR if you call
 	 * open(O_WRONLY | O_EXCL | O_CREAT) on a directory, some
@@ -2462,6 +2971,15 @@ _archive_write_disk_close(struct archive *_a)
 	    ARCHIVE_STATE_HEADER | ARCHIVE_STATE_DATA,
 	    "archive_write_disk_close");
 	ret = _archive_write_disk_finish_entry(&a->archive);
+#ifdef ASYNC_WRITERS
+	/* Files must be complete before their dirs are fixed up. */
+	async_drain(a);
+	{
+		int r = async_check_error(a);
+		if (r < ret)
+			ret = r;
+	}
+#endif
 
 	/* Sort dir list so directories are fixed up in depth-first order. */
 	p = sort_dir_list(a->fixup_list);
@@ -2522,6 +3040,9 @@ _archive_write_disk_free(struct archive *_a)
 	    ARCHIVE_STATE_ANY | ARCHIVE_STATE_FATAL, "archive_write_disk_free");
 	a = (struct archive_write_disk *)_a;
 	ret = _archive_write_disk_close(&a->archive);
+#ifdef ASYNC_WRITERS
+	async_free(a);
+#endif
 	archive_write_disk_set_group_lookup(&a->archive, NULL, NULL, NULL);
 	archive_write_disk_set_user_lookup(&a->archive, NULL, NULL, NULL);
 	archive_entry_free(a->entry);
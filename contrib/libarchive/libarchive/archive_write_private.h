@@ -72,6 +72,7 @@ struct archive_write_filter *__archive_write_allocate_filter(struct archive *);
 int __archive_write_output(struct archive_write *, const void *, size_t);
 int __archive_write_nulls(struct archive_write *, size_t);
 int __archive_write_filter(struct archive_write_filter *, const void *, size_t);
+int __archive_write_filter_parse_threads(const char *, int *);
 
 struct archive_write {
 	struct archive	archive;
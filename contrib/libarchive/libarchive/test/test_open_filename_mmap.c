@@ -0,0 +1,171 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+__FBSDID("$FreeBSD$");
+
+/*
+ * Read archives through archive_read_open_filename() with the "mmap"
+ * option, which maps regular files instead of read(2)ing them.
+ */
+
+#define	BIGSIZE	819200
+
+static void
+make_data(char *data, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		data[i] = (char)(i * 7 + i / 4096);
+}
+
+static void
+write_archive(const char *name, int zip, const char *data)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+
+	assert((a = archive_write_new()) != NULL);
+	if (zip) {
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_zip(a));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_option(a, "zip", "compression", "store"));
+	} else
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_format_ustar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_open_filename(a, name));
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "file");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, 8);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualIntA(a, 8, archive_write_data(a, "12345678", 8));
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "file2");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, BIGSIZE);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualIntA(a, BIGSIZE, archive_write_data(a, data, BIGSIZE));
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "file3");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, 4);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualIntA(a, 4, archive_write_data(a, "abcd", 4));
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+}
+
+static void
+read_archive(const char *name, int seekable, const char *options,
+    int skip, const char *data)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char buff[64], *rbuff;
+
+	rbuff = malloc(BIGSIZE + 1);
+	assert(rbuff != NULL);
+
+	assert((a = archive_read_new()) != NULL);
+	if (seekable)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_format_zip_seekable(a));
+	else
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, name, 512));
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file", archive_entry_pathname(ae));
+	assertEqualIntA(a, 8, archive_read_data(a, buff, sizeof(buff)));
+	assertEqualMem(buff, "12345678", 8);
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file2", archive_entry_pathname(ae));
+	assertEqualInt(BIGSIZE, archive_entry_size(ae));
+	if (skip)
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_data_skip(a));
+	else {
+		assertEqualIntA(a, BIGSIZE,
+		    archive_read_data(a, rbuff, BIGSIZE + 1));
+		assertEqualMem(rbuff, data, BIGSIZE);
+	}
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file3", archive_entry_pathname(ae));
+	assertEqualIntA(a, 4, archive_read_data(a, buff, sizeof(buff)));
+	assertEqualMem(buff, "abcd", 4);
+
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(rbuff);
+}
+
+DEFINE_TEST(test_open_filename_mmap)
+{
+	struct archive *a;
+	char *data;
+
+	data = malloc(BIGSIZE);
+	assert(data != NULL);
+	make_data(data, BIGSIZE);
+
+	/* The option has no module; a module name is rejected. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_option(a, NULL, "mmap", "1"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_option(a, NULL, "mmap", NULL));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_option(a, "tar", "mmap", "1"));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	write_archive("test.tar", 0, data);
+	read_archive("test.tar", 0, "mmap", 0, data);
+	read_archive("test.tar", 0, "mmap", 1, data);
+	read_archive("test.tar", 0, "!mmap", 0, data);
+
+	/* The seekable Zip reader seeks from the end of the file. */
+	write_archive("test.zip", 1, data);
+	read_archive("test.zip", 1, "mmap", 0, data);
+	read_archive("test.zip", 1, "mmap", 1, data);
+	read_archive("test.zip", 0, "mmap", 0, data);
+
+	free(data);
+}
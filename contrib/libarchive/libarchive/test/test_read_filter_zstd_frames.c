@@ -0,0 +1,249 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+__FBSDID("$FreeBSD$");
+
+/*
+ * Read a tar archive compressed as one zstd frame per header and per
+ * file body, with and without a seekable-format index at the end.
+ * With the index, the body of a skipped entry is stepped over without
+ * being decoded, which is checked by overwriting that frame with junk.
+ * The frames are read with the default number of threads, and with
+ * the "threads" option set before the archive is opened.
+ */
+
+#define	NFILES	24
+#define	JUNK	13	/* Entry whose body frame is overwritten. */
+
+static size_t
+file_size(int i)
+{
+	return ((size_t)(i % 5 + 1) * 1024);
+}
+
+/* Compress a chunk as a single zstd frame; returns its size. */
+static size_t
+compress_frame(const char *src, size_t size, char *dst, size_t dstsize)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	size_t used;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_raw(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_zstd(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_bytes_per_block(a, 0));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, dst, dstsize, &used));
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "chunk");
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	archive_entry_set_size(ae, size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualInt(size, archive_write_data(a, src, size));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	return (used);
+}
+
+static void
+le32enc(char *p, unsigned int v)
+{
+	p[0] = (char)(v & 0xff);
+	p[1] = (char)((v >> 8) & 0xff);
+	p[2] = (char)((v >> 16) & 0xff);
+	p[3] = (char)((v >> 24) & 0xff);
+}
+
+/*
+ * Read the archive back, skipping the bodies of every third entry
+ * (which includes JUNK).  Returns the index of the first entry that
+ * could not be read, or NFILES if everything went well.
+ */
+static int
+verify(const char *buff, size_t used, const char *data, int seekable,
+    const char *threads)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	char name[32], *rbuff;
+	size_t size;
+	int i, r;
+
+	rbuff = malloc(file_size(4) + 1);
+	assert(rbuff != NULL);
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_zstd(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	if (threads != NULL)
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_set_filter_option(a,
+		    "zstd", "threads", threads));
+	/* Opening reads ahead, so it may run into the junk already. */
+	if (seekable)
+		r = read_open_memory_seek(a, buff, used, 7);
+	else
+		r = read_open_memory(a, buff, used, 7);
+
+	for (i = 0; r == ARCHIVE_OK && i < NFILES; i++) {
+		if (archive_read_next_header(a, &ae) != ARCHIVE_OK)
+			break;
+		snprintf(name, sizeof(name), "f%d", i);
+		size = file_size(i);
+		assertEqualString(name, archive_entry_pathname(ae));
+		assertEqualInt(size, archive_entry_size(ae));
+		if (i % 3 == 1)
+			continue;
+		if (archive_read_data(a, rbuff, size + 1) != (ssize_t)size)
+			break;
+		assertEqualMem(data + i, rbuff, size);
+	}
+	if (i == NFILES)
+		assertEqualIntA(a, ARCHIVE_EOF,
+		    archive_read_next_header(a, &ae));
+	archive_read_close(a);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(rbuff);
+	return (i);
+}
+
+DEFINE_TEST(test_read_filter_zstd_frames)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	char name[32], *tar, *buff, *data, *single, *p;
+	size_t tarsize = 256 * 1024, buffsize = 512 * 1024, used, off, n;
+	size_t chunk[2 * NFILES + 1], csize[2 * NFILES + 1];
+	size_t junk_offset = 0, junk_size = 0, size;
+	int i, nframes;
+
+	data = malloc(file_size(4) + NFILES);
+	assert(data != NULL);
+	for (i = 0; i < (int)(file_size(4) + NFILES); i++)
+		data[i] = (char)('a' + (i * 11 + i / 37) % 26);
+	tar = malloc(tarsize);
+	buff = malloc(buffsize);
+	assert(tar != NULL && buff != NULL);
+
+	/* Write an uncompressed tar archive. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_ustar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, tar, tarsize, &used));
+	for (i = 0; i < NFILES; i++) {
+		snprintf(name, sizeof(name), "f%d", i);
+		size = file_size(i);
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, size);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		archive_entry_free(ae);
+		assertEqualInt(size, archive_write_data(a, data + i, size));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	/* Each header and each body goes in a frame of its own. */
+	nframes = 0;
+	for (i = 0; i < NFILES; i++) {
+		chunk[nframes++] = 512;
+		chunk[nframes++] = file_size(i);
+	}
+	/* The end-of-archive marker. */
+	for (n = 0, i = 0; i < nframes; i++)
+		n += chunk[i];
+	chunk[nframes++] = used - n;
+
+	/* Check whether zstd writing works at all. */
+	assert((a = archive_write_new()) != NULL);
+	if (archive_write_add_filter_zstd(a) != ARCHIVE_OK) {
+		skipping("zstd writing not supported on this platform");
+		assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+		free(buff);
+		free(tar);
+		free(data);
+		return;
+	}
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	off = 0;
+	n = 0;
+	for (i = 0; i < nframes; i++) {
+		csize[i] = compress_frame(tar + n, chunk[i], buff + off,
+		    buffsize - off);
+		if (i == 2 * JUNK + 1) {
+			junk_offset = off;
+			junk_size = csize[i];
+		}
+		n += chunk[i];
+		off += csize[i];
+	}
+	assertEqualInt(used, n);
+
+	/* Plain concatenated frames. */
+	assertEqualInt(NFILES, verify(buff, off, data, 0, NULL));
+	assertEqualInt(NFILES, verify(buff, off, data, 1, NULL));
+	assertEqualInt(NFILES, verify(buff, off, data, 0, "1"));
+	assertEqualInt(NFILES, verify(buff, off, data, 0, "3"));
+
+	/* The whole archive as a single frame. */
+	single = malloc(buffsize);
+	assert(single != NULL);
+	n = compress_frame(tar, used, single, buffsize);
+	assertEqualInt(NFILES, verify(single, n, data, 0, NULL));
+	assertEqualInt(NFILES, verify(single, n, data, 1, "0"));
+	free(single);
+
+	/* Append a seekable-format index without checksums. */
+	p = buff + off;
+	le32enc(p, 0x184D2A5E);
+	le32enc(p + 4, nframes * 8 + 9);
+	p += 8;
+	for (i = 0; i < nframes; i++, p += 8) {
+		le32enc(p, (unsigned int)csize[i]);
+		le32enc(p + 4, (unsigned int)chunk[i]);
+	}
+	le32enc(p, nframes);
+	p[4] = 0;
+	le32enc(p + 5, 0x8F92EAB1);
+	used = off + 8 + nframes * 8 + 9;
+	assertEqualInt(NFILES, verify(buff, used, data, 0, NULL));
+	assertEqualInt(NFILES, verify(buff, used, data, 1, NULL));
+
+	/*
+	 * Overwrite a body that is skipped.  Only a reader that uses the
+	 * index gets past it.
+	 */
+	memset(buff + junk_offset, 0xff, junk_size);
+	assertEqualInt(NFILES, verify(buff, used, data, 1, NULL));
+	assert(verify(buff, used, data, 0, NULL) <= JUNK + 1);
+
+	free(buff);
+	free(tar);
+	free(data);
+}
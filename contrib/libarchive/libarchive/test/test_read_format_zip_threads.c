@@ -0,0 +1,168 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+__FBSDID("$FreeBSD$");
+
+/*
+ * Read a Zip archive of many deflated entries with the seekable reader
+ * and the "threads" option, skipping some entries along the way, and
+ * check contents and the byte ranges reported for each entry body.
+ */
+
+#define	NFILES	40
+
+static size_t
+file_size(int i)
+{
+	return ((size_t)i * 2039);
+}
+
+static void
+verify(const char *buff, size_t used, const char *data, const char *threads,
+    int skip)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	la_int64_t offset, length, end;
+	char name[32], *rbuff;
+	size_t size;
+	int i;
+
+	rbuff = malloc(file_size(NFILES));
+	assert(rbuff != NULL);
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_format_option(a, "zip", "threads", threads));
+	assertEqualIntA(a, ARCHIVE_OK, read_open_memory_seek(a, buff, used, 7));
+
+	end = 0;
+	for (i = 0; i < NFILES; i++) {
+		snprintf(name, sizeof(name), "f%d", i);
+		size = file_size(i);
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+		assertEqualString(name, archive_entry_pathname(ae));
+		assertEqualInt(size, archive_entry_size(ae));
+
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_entry_data_range(a, &offset, &length));
+		assert(offset >= end);
+		assert(length > 0);
+		assert(offset + length <= (la_int64_t)used);
+		end = offset + length;
+
+		if (skip && i % 3 == 1)
+			continue;
+		assertEqualInt(size, archive_read_data(a, rbuff, size + 1));
+		assertEqualMem(data, rbuff, size);
+		assertEqualInt(0, archive_read_data(a, rbuff, 1));
+	}
+
+	/* Entries that are never handed to the workers. */
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("dir/", archive_entry_pathname(ae));
+	assertEqualInt(AE_IFDIR, archive_entry_filetype(ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("symlink", archive_entry_pathname(ae));
+	assertEqualInt(AE_IFLNK, archive_entry_filetype(ae));
+	assertEqualString("f1", archive_entry_symlink(ae));
+
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(rbuff);
+}
+
+DEFINE_TEST(test_read_format_zip_threads)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	char name[32], *buff, *data;
+	size_t buffsize = 4 * 1024 * 1024, used, size;
+	int i;
+
+	if (!canGzip()) {
+		skipping("zlib not available");
+		return;
+	}
+
+	data = malloc(file_size(NFILES));
+	assert(data != NULL);
+	for (i = 0; i < (int)file_size(NFILES); i++)
+		data[i] = (char)('a' + (i * 7 + i / 4093) % 26);
+	buff = malloc(buffsize);
+	assert(buff != NULL);
+
+	/* Write the archive. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	for (i = 0; i < NFILES; i++) {
+		snprintf(name, sizeof(name), "f%d", i);
+		size = file_size(i);
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, size);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		archive_entry_free(ae);
+		assertEqualInt(size, archive_write_data(a, data, size));
+	}
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "dir/");
+	archive_entry_set_mode(ae, AE_IFDIR | 0755);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "symlink");
+	archive_entry_set_mode(ae, AE_IFLNK | 0755);
+	archive_entry_copy_symlink(ae, "f1");
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	/* Bad values are rejected. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_format_option(a, "zip", "threads", "abc"));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_format_option(a, "zip", "threads", "-2"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_format_option(a, "zip", "threads", "4"));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	verify(buff, used, data, "1", 0);
+	verify(buff, used, data, "3", 0);
+	verify(buff, used, data, "3", 1);
+	verify(buff, used, data, "0", 1);
+
+	free(buff);
+	free(data);
+}
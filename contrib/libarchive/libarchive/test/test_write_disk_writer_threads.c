@@ -0,0 +1,138 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+__FBSDID("$FreeBSD$");
+
+/*
+ * Extract a batch of small files through the writer threads and
+ * check that contents, modes and times all land on disk, including
+ * for files that are overwritten or hardlinked while still pending.
+ */
+
+#define	NFILES	64
+
+static void
+write_file(struct archive *ad, const char *name, int mode, time_t mtime,
+    const char *buff, size_t size)
+{
+	struct archive_entry *ae;
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, name);
+	archive_entry_set_mode(ae, S_IFREG | mode);
+	archive_entry_set_size(ae, size);
+	archive_entry_set_mtime(ae, mtime, 0);
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_header(ad, ae));
+	if (size > 0)
+		assertEqualInt(size, archive_write_data(ad, buff, size));
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_finish_entry(ad));
+	archive_entry_free(ae);
+}
+
+DEFINE_TEST(test_write_disk_writer_threads)
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+	skipping("writer threads are not supported on Windows");
+#else
+	struct archive *ad;
+	struct archive_entry *ae;
+	char name[32], *buff;
+	size_t size;
+	int i, r;
+
+	assertUmask(022);
+	buff = malloc(100000);
+	assert(buff != NULL);
+	for (i = 0; i < 100000; i++)
+		buff[i] = (char)('a' + i % 23);
+
+	assert((ad = archive_write_disk_new()) != NULL);
+	assertEqualIntA(ad, ARCHIVE_OK,
+	    archive_write_disk_set_options(ad, ARCHIVE_EXTRACT_TIME |
+	    ARCHIVE_EXTRACT_PERM));
+	r = archive_write_disk_set_writer_threads(ad, 4);
+	if (r == ARCHIVE_WARN) {
+		skipping("writer threads are not supported on this platform");
+		assertEqualInt(ARCHIVE_OK, archive_write_free(ad));
+		free(buff);
+		return;
+	}
+	assertEqualIntA(ad, ARCHIVE_OK, r);
+
+	assertMakeDir("wt", 0755);
+	for (i = 0; i < NFILES; i++) {
+		snprintf(name, sizeof(name), "wt/f%d", i);
+		size = (size_t)i * 1531;
+		write_file(ad, name, 0600 + (i % 8) * 010, 86400 + i,
+		    buff, size);
+	}
+
+	/* Replace a file that may still be pending. */
+	write_file(ad, "wt/f1", 0644, 1000, "replaced", 8);
+
+	/* Hardlink to a file that may still be pending. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "wt/link");
+	archive_entry_copy_hardlink(ae, "wt/f10");
+	archive_entry_set_mode(ae, S_IFREG | 0600);
+	archive_entry_set_size(ae, 0);
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_header(ad, ae));
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_finish_entry(ad));
+	archive_entry_free(ae);
+
+	/* Turning the pool off completes whatever is outstanding. */
+	assertEqualIntA(ad, ARCHIVE_OK,
+	    archive_write_disk_set_writer_threads(ad, 0));
+	write_file(ad, "wt/sync", 0644, 2000, buff, 10);
+	assertEqualIntA(ad, ARCHIVE_OK,
+	    archive_write_disk_set_writer_threads(ad, 2));
+	write_file(ad, "wt/last", 0640, 3000, buff, 99999);
+	assertEqualInt(ARCHIVE_OK, archive_write_free(ad));
+
+	/* Verify everything. */
+	for (i = 0; i < NFILES; i++) {
+		if (i == 1)
+			continue;
+		snprintf(name, sizeof(name), "wt/f%d", i);
+		size = (size_t)i * 1531;
+		assertIsReg(name, 0600 + (i % 8) * 010);
+		assertFileSize(name, size);
+		if (size > 0)
+			assertFileContents(buff, (int)size, name);
+		assertFileMtime(name, 86400 + i, 0);
+	}
+	assertIsReg("wt/f1", 0644);
+	assertFileContents("replaced", 8, "wt/f1");
+	assertFileMtime("wt/f1", 1000, 0);
+	assertIsHardlink("wt/f10", "wt/link");
+	assertFileContents(buff, 10 * 1531, "wt/link");
+	assertFileContents(buff, 10, "wt/sync");
+	assertFileMtime("wt/sync", 2000, 0);
+	assertIsReg("wt/last", 0640);
+	assertFileContents(buff, 99999, "wt/last");
+	assertFileMtime("wt/last", 3000, 0);
+	free(buff);
+#endif
+}
@@ -130,6 +130,12 @@ DEFINE_TEST(test_write_filter_bzip2)
 	    NULL, "compression-level", "99"));
 	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_filter_option(a,
 	    NULL, "compression-level", "9"));
+	assertEqualIntA(a, ARCHIVE_FAILED, archive_write_set_filter_option(a,
+	    NULL, "threads", "abc"));
+	assertEqualIntA(a, ARCHIVE_FAILED, archive_write_set_filter_option(a,
+	    NULL, "threads", "-2"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_filter_option(a,
+	    NULL, "threads", "4"));
 	assertEqualIntA(a, ARCHIVE_OK,
 	    archive_write_open_memory(a, buff, buffsize, &used2));
 	for (i = 0; i < 999; i++) {
@@ -0,0 +1,132 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer
+ *    in this position and unchanged.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test.h"
+__FBSDID("$FreeBSD$");
+
+/*
+ * Write an archive large enough to span many compression blocks
+ * with "gzip:threads" set and verify that every byte reads back.
+ * The block-parallel encoder must still produce a single gzip
+ * member with a valid CRC, which the reader checks for us.
+ */
+
+DEFINE_TEST(test_write_filter_gzip_threads)
+{
+	static const char *threads[] = { "1", "2", "4", "0" };
+	struct archive_entry *ae;
+	struct archive* a;
+	char *buff, *data, *rdata;
+	size_t buffsize, datasize;
+	size_t used, i;
+	char path[16];
+	int n, t, r;
+
+	buffsize = 8000000;
+	assert(NULL != (buff = (char *)malloc(buffsize)));
+	if (buff == NULL)
+		return;
+
+	datasize = 300000;
+	data = (char *)malloc(datasize);
+	rdata = (char *)malloc(datasize);
+	assert(data != NULL && rdata != NULL);
+	if (data == NULL || rdata == NULL) {
+		free(data);
+		free(rdata);
+		free(buff);
+		return;
+	}
+	/* Mildly compressible data so that dictionaries matter. */
+	for (i = 0; i < datasize; i++)
+		data[i] = (char)("abcdefgh"[(i * 7 + (i >> 10)) & 7] ^ (i >> 13));
+
+	for (t = 0; t < (int)(sizeof(threads) / sizeof(threads[0])); t++) {
+		assert((a = archive_write_new()) != NULL);
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_format_ustar(a));
+		r = archive_write_add_filter_gzip(a);
+		if (r != ARCHIVE_OK) {
+			skipping("gzip writing not supported on this platform");
+			assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+			break;
+		}
+		assertEqualIntA(a, ARCHIVE_FAILED,
+		    archive_write_set_filter_option(a, NULL, "threads", "abc"));
+		assertEqualIntA(a, ARCHIVE_FAILED,
+		    archive_write_set_filter_option(a, NULL, "threads", "-1"));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_filter_option(a, NULL, "threads",
+		    threads[t]));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_open_memory(a, buff, buffsize, &used));
+		for (n = 0; n < 20; n++) {
+			sprintf(path, "file%03d", n);
+			assert((ae = archive_entry_new()) != NULL);
+			archive_entry_copy_pathname(ae, path);
+			archive_entry_set_size(ae, datasize);
+			archive_entry_set_filetype(ae, AE_IFREG);
+			assertEqualIntA(a, ARCHIVE_OK,
+			    archive_write_header(a, ae));
+			assertEqualIntA(a, datasize,
+			    archive_write_data(a, data, datasize));
+			archive_entry_free(ae);
+		}
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+		assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+		assert((a = archive_read_new()) != NULL);
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_format_all(a));
+		r = archive_read_support_filter_gzip(a);
+		if (r == ARCHIVE_WARN) {
+			skipping("gzip reading not fully supported on this platform");
+			assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+			break;
+		}
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_open_memory(a, buff, used));
+		for (n = 0; n < 20; n++) {
+			sprintf(path, "file%03d", n);
+			failure("threads=%s, reading %s", threads[t], path);
+			if (!assertEqualIntA(a, ARCHIVE_OK,
+			    archive_read_next_header(a, &ae)))
+				break;
+			assertEqualString(path, archive_entry_pathname(ae));
+			assertEqualIntA(a, datasize,
+			    archive_read_data(a, rdata, datasize));
+			assertEqualMem(data, rdata, datasize);
+		}
+		assertEqualIntA(a, ARCHIVE_EOF,
+		    archive_read_next_header(a, &ae));
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+		assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	}
+
+	free(rdata);
+	free(data);
+	free(buff);
+}
@@ -899,6 +899,44 @@ APPEND_CHAIN(struct evbuffer *dst, struct evbuffer *src)
 	dst->total_len += src->total_len;
 }
 
+#ifdef USE_SENDFILE
+/* File segment chains added to a buffer that does not drain to a fd have
+ * to be mapped or read into memory.  When such chains move into a buffer
+ * that does with evbuffer_add_buffer_sendfile_(), as when evhttp hands a
+ * reply body to its bufferevent, turn them back into sendfile chains so
+ * that they are not copied through userspace.  Like the chains
+ * evbuffer_add_file_segment() makes for sendfile, they no longer point at
+ * the data: it can only be written out.  Requires lock on 'dst'. */
+static void
+evbuffer_chains_to_sendfile(struct evbuffer *dst, struct evbuffer_chain *chain)
+{
+	struct evbuffer_chain_file_segment *info;
+	struct evbuffer_file_segment *seg;
+
+	ASSERT_EVBUFFER_LOCKED(dst);
+	if (!(dst->flags & EVBUFFER_FLAG_DRAINS_TO_FD))
+		return;
+
+	for (; chain; chain = chain->next) {
+		if ((chain->flags & (EVBUFFER_FILESEGMENT|EVBUFFER_SENDFILE)) !=
+		    EVBUFFER_FILESEGMENT || CHAIN_PINNED(chain) || !chain->off)
+			continue;
+		info = EVBUFFER_CHAIN_EXTRA(struct evbuffer_chain_file_segment,
+		    chain);
+		seg = info->segment;
+		if (!seg->can_sendfile || !seg->contents)
+			continue;
+		chain->misalign = seg->file_offset + ((char *)chain->buffer +
+		    chain->misalign - seg->contents);
+		chain->buffer_len = chain->misalign + chain->off;
+		chain->buffer = EVBUFFER_CHAIN_EXTRA(unsigned char, chain);
+		chain->flags |= EVBUFFER_SENDFILE;
+	}
+}
+#else
+#define evbuffer_chains_to_sendfile(dst, chain) ((void)0)
+#endif
+
 static inline void
 APPEND_CHAIN_MULTICAST(struct evbuffer *dst, struct evbuffer *src)
 {
@@ -957,8 +995,9 @@ PREPEND_CHAIN(struct evbuffer *dst, struct evbuffer *src)
 	}
 }
 
-int
-evbuffer_add_buffer(struct evbuffer *outbuf, struct evbuffer *inbuf)
+static int
+evbuffer_add_buffer_impl(struct evbuffer *outbuf, struct evbuffer *inbuf,
+    int to_sendfile)
 {
 	struct evbuffer_chain *pinned, *last;
 	size_t in_total_len, out_total_len;
@@ -981,6 +1020,9 @@ evbuffer_add_buffer(struct evbuffer *outbuf, struct evbuffer *inbuf)
 		goto done;
 	}
 
+	if (to_sendfile)
+		evbuffer_chains_to_sendfile(outbuf, inbuf->first);
+
 	if (out_total_len == 0) {
 		/* There might be an empty chain at the start of outbuf; free
 		 * it. */
@@ -1003,6 +1045,18 @@ evbuffer_add_buffer(struct evbuffer *outbuf, struct evbuffer *inbuf)
 	return result;
 }
 
+int
+evbuffer_add_buffer(struct evbuffer *outbuf, struct evbuffer *inbuf)
+{
+	return evbuffer_add_buffer_impl(outbuf, inbuf, 0);
+}
+
+int
+evbuffer_add_buffer_sendfile_(struct evbuffer *outbuf, struct evbuffer *inbuf)
+{
+	return evbuffer_add_buffer_impl(outbuf, inbuf, 1);
+}
+
 int
 evbuffer_add_buffer_reference(struct evbuffer *outbuf, struct evbuffer *inbuf)
 {
@@ -2169,9 +2223,11 @@ evbuffer_expand(struct evbuffer *buf, size_t datlen)
 
 #ifdef EVENT__HAVE_SYS_UIO_H
 /* number of iovec we use for writev, fragmentation is going to determine
- * how much we end up writing */
+ * how much we end up writing.  Buffers filled from many small adds or by
+ * reference can hold hundreds of chains, so take as many as the system
+ * allows rather than coming back for another writev. */
 
-#define DEFAULT_WRITE_IOVEC 128
+#define DEFAULT_WRITE_IOVEC 1024
 
 #if defined(UIO_MAXIOV) && UIO_MAXIOV < DEFAULT_WRITE_IOVEC
 #define NUM_WRITE_IOVEC UIO_MAXIOV
@@ -2398,6 +2454,12 @@ evbuffer_read(struct evbuffer *buf, evutil_socket_t fd, int howmuch)
 	return result;
 }
 
+#if defined(USE_IOVEC_IMPL) && defined(SENDFILE_IS_FREEBSD)
+static inline int evbuffer_write_sendfile_hdr(struct evbuffer_chain *chain,
+    evutil_socket_t dest_fd, struct iovec *hdr, int n_hdr,
+    ev_ssize_t howmuch);
+#endif
+
 #ifdef USE_IOVEC_IMPL
 static inline int
 evbuffer_write_iovec(struct evbuffer *buffer, evutil_socket_t fd,
@@ -2417,8 +2479,16 @@ evbuffer_write_iovec(struct evbuffer *buffer, evutil_socket_t fd,
 	while (chain != NULL && i < NUM_WRITE_IOVEC && howmuch) {
 #ifdef USE_SENDFILE
 		/* we cannot write the file info via writev */
-		if (chain->flags & EVBUFFER_SENDFILE)
+		if (chain->flags & EVBUFFER_SENDFILE) {
+#ifdef SENDFILE_IS_FREEBSD
+			/* ... but sendfile can take the data in front of it
+			 * as headers, and send both with one call. */
+			if (i && chain->off)
+				return evbuffer_write_sendfile_hdr(chain, fd,
+				    iov, i, howmuch);
+#endif
 			break;
+		}
 #endif
 		iov[i].IOV_PTR_FIELD = (void *) (chain->buffer + chain->misalign);
 		if ((size_t)howmuch >= chain->off) {
@@ -2460,9 +2530,13 @@ evbuffer_write_sendfile(struct evbuffer *buffer, evutil_socket_t dest_fd,
 	    EVBUFFER_CHAIN_EXTRA(struct evbuffer_chain_file_segment,
 		chain);
 	const int source_fd = info->segment->fd;
+	/* Don't send more than we were asked to; rate limiting relies on
+	 * it. */
+	const size_t nbytes = (size_t)howmuch < chain->off ?
+	    (size_t)howmuch : chain->off;
 #if defined(SENDFILE_IS_MACOSX) || defined(SENDFILE_IS_FREEBSD)
 	int res;
-	ev_off_t len = chain->off;
+	ev_off_t len = nbytes;
 #elif defined(SENDFILE_IS_LINUX) || defined(SENDFILE_IS_SOLARIS)
 	ev_ssize_t res;
 	ev_off_t offset = chain->misalign;
@@ -2470,6 +2544,11 @@ evbuffer_write_sendfile(struct evbuffer *buffer, evutil_socket_t dest_fd,
 
 	ASSERT_EVBUFFER_LOCKED(buffer);
 
+	/* A length of zero would mean "up to the end of the file" to
+	 * some of these. */
+	if (nbytes == 0)
+		return (0);
+
 #if defined(SENDFILE_IS_MACOSX)
 	res = sendfile(source_fd, dest_fd, chain->misalign, &len, NULL, 0);
 	if (res == -1 && !EVUTIL_ERR_RW_RETRIABLE(errno))
@@ -2477,14 +2556,14 @@ evbuffer_write_sendfile(struct evbuffer *buffer, evutil_socket_t dest_fd,
 
 	return (len);
 #elif defined(SENDFILE_IS_FREEBSD)
-	res = sendfile(source_fd, dest_fd, chain->misalign, chain->off, NULL, &len, 0);
+	res = sendfile(source_fd, dest_fd, chain->misalign, nbytes, NULL, &len, 0);
 	if (res == -1 && !EVUTIL_ERR_RW_RETRIABLE(errno))
 		return (-1);
 
 	return (len);
 #elif defined(SENDFILE_IS_LINUX)
 	/* TODO(niels): implement splice */
-	res = sendfile(dest_fd, source_fd, &offset, chain->off);
+	res = sendfile(dest_fd, source_fd, &offset, nbytes);
 	if (res == -1 && EVUTIL_ERR_RW_RETRIABLE(errno)) {
 		/* if this is EAGAIN or EINTR return 0; otherwise, -1 */
 		return (0);
@@ -2493,7 +2572,7 @@ evbuffer_write_sendfile(struct evbuffer *buffer, evutil_socket_t dest_fd,
 #elif defined(SENDFILE_IS_SOLARIS)
 	{
 		const off_t offset_orig = offset;
-		res = sendfile(dest_fd, source_fd, &offset, chain->off);
+		res = sendfile(dest_fd, source_fd, &offset, nbytes);
 		if (res == -1 && EVUTIL_ERR_RW_RETRIABLE(errno)) {
 			if (offset - offset_orig)
 				return offset - offset_orig;
@@ -2505,6 +2584,45 @@ evbuffer_write_sendfile(struct evbuffer *buffer, evutil_socket_t dest_fd,
 	}
 #endif
 }
+
+#if defined(USE_IOVEC_IMPL) && defined(SENDFILE_IS_FREEBSD)
+/* Send the n_hdr iovecs in 'hdr' followed by at most 'howmuch' bytes of
+ * the sendfile chain 'chain' with a single sendfile call.  Returns the
+ * total number of bytes written, like writev. */
+static inline int
+evbuffer_write_sendfile_hdr(struct evbuffer_chain *chain,
+    evutil_socket_t dest_fd, struct iovec *hdr, int n_hdr,
+    ev_ssize_t howmuch)
+{
+	struct evbuffer_chain_file_segment *info =
+	    EVBUFFER_CHAIN_EXTRA(struct evbuffer_chain_file_segment,
+		chain);
+	const size_t nbytes = (size_t)howmuch < chain->off ?
+	    (size_t)howmuch : chain->off;
+	struct sf_hdtr hdtr;
+	off_t len = 0;
+	int res;
+
+	EVUTIL_ASSERT(chain->flags & EVBUFFER_SENDFILE);
+	EVUTIL_ASSERT(nbytes > 0);
+
+	hdtr.headers = hdr;
+	hdtr.hdr_cnt = n_hdr;
+	hdtr.trailers = NULL;
+	hdtr.trl_cnt = 0;
+
+	res = sendfile(info->segment->fd, dest_fd, chain->misalign, nbytes,
+	    &hdtr, &len, 0);
+	if (res == -1 && !EVUTIL_ERR_RW_RETRIABLE(errno))
+		return (-1);
+
+	/* sendfile reports EAGAIN even if it got some of it out. */
+	if (res == -1 && len == 0)
+		return (-1);
+
+	return (len);
+}
+#endif
 #endif
 
 int
@@ -2944,6 +3062,76 @@ evbuffer_add_reference(struct evbuffer *outbuf,
 	return result;
 }
 
+struct evbuffer_ref_segment *
+evbuffer_ref_segment_new(const void *data, size_t datlen,
+    evbuffer_ref_cleanup_cb cleanupfn, void *cleanupfn_arg)
+{
+	struct evbuffer_ref_segment *seg;
+
+	if (datlen > EVBUFFER_CHAIN_MAX)
+		return NULL;
+	seg = mm_calloc(1, sizeof(struct evbuffer_ref_segment));
+	if (!seg)
+		return NULL;
+	seg->refcnt = 1;
+	seg->data = data;
+	seg->length = datlen;
+	seg->cleanupfn = cleanupfn;
+	seg->cleanupfn_arg = cleanupfn_arg;
+	EVTHREAD_ALLOC_LOCK(seg->lock, 0);
+	return seg;
+}
+
+void
+evbuffer_ref_segment_free(struct evbuffer_ref_segment *seg)
+{
+	int refcnt;
+	EVLOCK_LOCK(seg->lock, 0);
+	refcnt = --seg->refcnt;
+	EVLOCK_UNLOCK(seg->lock, 0);
+	if (refcnt > 0)
+		return;
+	EVUTIL_ASSERT(refcnt == 0);
+
+	if (seg->cleanupfn)
+		(*seg->cleanupfn)(seg->data, seg->length, seg->cleanupfn_arg);
+
+	EVTHREAD_FREE_LOCK(seg->lock, 0);
+	mm_free(seg);
+}
+
+/* Cleanup function for the reference chains of an evbuffer_ref_segment */
+static void
+evbuffer_ref_segment_chain_cleanup(const void *data, size_t datalen,
+    void *extra)
+{
+	evbuffer_ref_segment_free(extra);
+}
+
+int
+evbuffer_add_ref_segment(struct evbuffer *buf,
+    struct evbuffer_ref_segment *seg, size_t offset, ev_ssize_t length)
+{
+	if (offset > seg->length)
+		return -1;
+	if (length < 0)
+		length = seg->length - offset;
+	else if ((size_t)length > seg->length - offset)
+		return -1;
+
+	EVLOCK_LOCK(seg->lock, 0);
+	EVUTIL_ASSERT(seg->refcnt > 0);
+	++seg->refcnt;
+	EVLOCK_UNLOCK(seg->lock, 0);
+
+	if (evbuffer_add_reference(buf, seg->data + offset, length,
+		evbuffer_ref_segment_chain_cleanup, seg) < 0) {
+		evbuffer_ref_segment_free(seg); /* Lowers the refcount */
+		return -1;
+	}
+	return 0;
+}
+
 /* TODO(niels): we may want to add to automagically convert to mmap, in
  * case evbuffer_remove() or evbuffer_pullup() are being used.
  */
@@ -265,6 +265,19 @@ struct evbuffer_file_segment {
 	void *cleanup_cb_arg;
 };
 
+/** A reference-counted piece of memory; every chain that refers to it
+ * is an EVBUFFER_REFERENCE chain that holds a reference. */
+struct evbuffer_ref_segment {
+	void *lock; /**< lock prevent concurrent access to refcnt */
+	int refcnt; /**< Reference count for this segment */
+	/** The memory, and its length. */
+	const char *data;
+	size_t length;
+	/** Called once the last reference is gone. */
+	evbuffer_ref_cleanup_cb cleanupfn;
+	void *cleanupfn_arg;
+};
+
 /** Information about the multicast parent of a chain.  Lives at the
  * end of an evbuffer_chain with the EVBUFFER_MULTICAST flag set.  */
 struct evbuffer_multicast_parent {
@@ -339,6 +352,13 @@ void evbuffer_set_parent_(struct evbuffer *buf, struct bufferevent *bev);
 
 void evbuffer_invoke_callbacks_(struct evbuffer *buf);
 
+/** As evbuffer_add_buffer, but if outbuf has EVBUFFER_FLAG_DRAINS_TO_FD set,
+ * data that was added to inbuf from a file is switched to sendfile where it
+ * can be.  That data can then only be written out, so only use this when
+ * nothing looks at the contents of outbuf. */
+int evbuffer_add_buffer_sendfile_(struct evbuffer *outbuf,
+    struct evbuffer *inbuf);
+
 
 int evbuffer_get_callbacks_(struct evbuffer *buffer,
     struct event_callback **cbs,
@@ -38,6 +38,7 @@ extern "C" {
 #include <sys/queue.h>
 #include "event2/event_struct.h"
 #include "minheap-internal.h"
+#include "timerwheel-internal.h"
 #include "evsignal-internal.h"
 #include "mm-internal.h"
 #include "defer-internal.h"
@@ -286,6 +287,9 @@ struct event_base {
 
 	/** Priority queue of events with timeouts. */
 	struct min_heap timeheap;
+	/** Timer wheel for the timeouts that are not due yet, if the base
+	 * was created with EVENT_BASE_FLAG_TIMER_WHEEL; NULL otherwise. */
+	struct timer_wheel *timewheel;
 
 	/** Stored timeval: used to avoid calling gettimeofday/clock_gettime
 	 * too often. */
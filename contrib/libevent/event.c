@@ -155,6 +155,8 @@ static int	event_process_active(struct event_base *);
 
 static int	timeout_next(struct event_base *, struct timeval **);
 static void	timeout_process(struct event_base *);
+static int	timeout_reserve(struct event_base *);
+static int	timeout_is_first(struct event_base *, struct event *);
 
 static inline void	event_signal_closure(struct event_base *, struct event *ev);
 static inline void	event_persist_closure(struct event_base *, struct event *ev);
@@ -600,6 +602,21 @@ event_base_new_with_config(const struct event_config *cfg)
 
 	min_heap_ctor_(&base->timeheap);
 
+	if (should_check_environment &&
+	    evutil_getenv_("EVENT_TIMER_WHEEL") != NULL)
+		base->flags |= EVENT_BASE_FLAG_TIMER_WHEEL;
+	if (base->flags & EVENT_BASE_FLAG_TIMER_WHEEL) {
+		struct timeval tmp;
+		base->timewheel = mm_malloc(sizeof(struct timer_wheel));
+		if (base->timewheel == NULL) {
+			event_warn("%s: malloc", __func__);
+			mm_free(base);
+			return NULL;
+		}
+		gettime(base, &tmp);
+		timer_wheel_ctor_(base->timewheel, &tmp);
+	}
+
 	base->sig.ev_signal_pair[0] = -1;
 	base->sig.ev_signal_pair[1] = -1;
 	base->th_notify_fd[0] = -1;
@@ -833,6 +850,11 @@ event_base_free_(struct event_base *base, int run_finalizers)
 		event_del(ev);
 		++n_deleted;
 	}
+	while (base->timewheel &&
+	    (ev = timer_wheel_any_(base->timewheel)) != NULL) {
+		event_del(ev);
+		++n_deleted;
+	}
 	for (i = 0; i < base->n_common_timeouts; ++i) {
 		struct common_timeout_list *ctl =
 		    base->common_timeout_queues[i];
@@ -886,6 +908,10 @@ event_base_free_(struct event_base *base, int run_finalizers)
 
 	EVUTIL_ASSERT(min_heap_empty_(&base->timeheap));
 	min_heap_dtor_(&base->timeheap);
+	if (base->timewheel) {
+		EVUTIL_ASSERT(timer_wheel_empty_(base->timewheel));
+		mm_free(base->timewheel);
+	}
 
 	mm_free(base->activequeues);
 
@@ -2575,9 +2601,9 @@ event_add_nolock_(struct event *ev, const struct timeval *tv,
 	 * prepare for timeout insertion further below, if we get a
 	 * failure on any step, we should not change any state.
 	 */
-	if (tv != NULL && !(ev->ev_flags & EVLIST_TIMEOUT)) {
-		if (min_heap_reserve_(&base->timeheap,
-			1 + min_heap_size_(&base->timeheap)) == -1)
+	if (tv != NULL && (!(ev->ev_flags & EVLIST_TIMEOUT) ||
+		is_common_timeout(&ev->ev_timeout, base))) {
+		if (timeout_reserve(base) == -1)
 			return (-1);  /* ENOMEM == errno */
 	}
 
@@ -2698,7 +2724,7 @@ event_add_nolock_(struct event *ev, const struct timeval *tv,
 			 * We double check the timeout of the top element to
 			 * handle time distortions due to system suspension.
 			 */
-			if (min_heap_elt_is_top_(ev))
+			if (timeout_is_first(base, ev))
 				notify = 1;
 			else if ((top = min_heap_top_(&base->timeheap)) != NULL &&
 					 evutil_timercmp(&top->ev_timeout, &now, <))
@@ -3088,14 +3114,25 @@ static int
 timeout_next(struct event_base *base, struct timeval **tv_p)
 {
 	/* Caller must hold th_base_lock */
-	struct timeval now;
+	struct timeval now, wheel_tv;
 	struct event *ev;
 	struct timeval *tv = *tv_p;
+	const struct timeval *first = NULL;
 	int res = 0;
 
 	ev = min_heap_top_(&base->timeheap);
+	if (ev != NULL)
+		first = &ev->ev_timeout;
+
+	/* The wheel has to be advanced when its first slot comes up. */
+	if (base->timewheel &&
+	    timer_wheel_next_(base->timewheel, &wheel_tv) &&
+	    (first == NULL || evutil_timercmp(&wheel_tv, first, <))) {
+		ev = NULL;
+		first = &wheel_tv;
+	}
 
-	if (ev == NULL) {
+	if (first == NULL) {
 		/* if no time-based events are active wait for I/O */
 		*tv_p = NULL;
 		goto out;
@@ -3106,12 +3143,12 @@ timeout_next(struct event_base *base, struct timeval **tv_p)
 		goto out;
 	}
 
-	if (evutil_timercmp(&ev->ev_timeout, &now, <=)) {
+	if (evutil_timercmp(first, &now, <=)) {
 		evutil_timerclear(tv);
 		goto out;
 	}
 
-	evutil_timersub(&ev->ev_timeout, &now, tv);
+	evutil_timersub(first, &now, tv);
 
 	EVUTIL_ASSERT(tv->tv_sec >= 0);
 	EVUTIL_ASSERT(tv->tv_usec >= 0);
@@ -3129,12 +3166,27 @@ timeout_process(struct event_base *base)
 	struct timeval now;
 	struct event *ev;
 
-	if (min_heap_empty_(&base->timeheap)) {
+	if (min_heap_empty_(&base->timeheap) &&
+	    (!base->timewheel || timer_wheel_empty_(base->timewheel))) {
 		return;
 	}
 
 	gettime(base, &now);
 
+	/* Move the timeouts whose tick has come from the wheel to the
+	 * heap; there was room reserved for them when they were added. */
+	if (base->timewheel) {
+		struct event_list expired;
+
+		TAILQ_INIT(&expired);
+		timer_wheel_advance_(base->timewheel, &now, &expired);
+		while ((ev = TAILQ_FIRST(&expired)) != NULL) {
+			TAILQ_REMOVE(&expired, ev,
+			    ev_timeout_pos.ev_next_with_common_timeout);
+			min_heap_push_(&base->timeheap, ev);
+		}
+	}
+
 	while ((ev = min_heap_top_(&base->timeheap))) {
 		if (evutil_timercmp(&ev->ev_timeout, &now, >))
 			break;
@@ -3148,6 +3200,35 @@ timeout_process(struct event_base *base)
 	}
 }
 
+/* Make sure that adding one more timeout cannot fail.  Every event in the
+ * timer wheel may end up in the heap without warning, so the heap always
+ * has room for them all. */
+static int
+timeout_reserve(struct event_base *base)
+{
+	unsigned n = 1 + min_heap_size_(&base->timeheap);
+
+	if (base->timewheel)
+		n += base->timewheel->n;
+	return min_heap_reserve_(&base->timeheap, n);
+}
+
+/* Return true if 'ev' is the first timeout the loop will wake up for. */
+static int
+timeout_is_first(struct event_base *base, struct event *ev)
+{
+	struct event *top;
+	struct timeval tv;
+
+	if (!base->timewheel || !timer_wheel_holds_(base->timewheel, ev))
+		return min_heap_elt_is_top_(ev);
+	if (!timer_wheel_is_first_(base->timewheel, ev) ||
+	    !timer_wheel_next_(base->timewheel, &tv))
+		return 0;
+	top = min_heap_top_(&base->timeheap);
+	return top == NULL || evutil_timercmp(&tv, &top->ev_timeout, <);
+}
+
 #if (EVLIST_INTERNAL >> 4) != 1
 #error "Mismatch for value of EVLIST_INTERNAL"
 #endif
@@ -3229,6 +3310,9 @@ event_queue_remove_timeout(struct event_base *base, struct event *ev)
 		    get_common_timeout_list(base, &ev->ev_timeout);
 		TAILQ_REMOVE(&ctl->events, ev,
 		    ev_timeout_pos.ev_next_with_common_timeout);
+	} else if (base->timewheel &&
+	    timer_wheel_holds_(base->timewheel, ev)) {
+		timer_wheel_erase_(base->timewheel, ev);
 	} else {
 		min_heap_erase_(&base->timeheap, ev);
 	}
@@ -3379,6 +3463,9 @@ event_queue_insert_timeout(struct event_base *base, struct event *ev)
 		struct common_timeout_list *ctl =
 		    get_common_timeout_list(base, &ev->ev_timeout);
 		insert_common_timeout_inorder(ctl, ev);
+	} else if (base->timewheel &&
+	    timer_wheel_holds_(base->timewheel, ev)) {
+		timer_wheel_push_(base->timewheel, ev);
 	} else {
 		min_heap_push_(&base->timeheap, ev);
 	}
@@ -3649,6 +3736,24 @@ event_base_foreach_event_nolock_(struct event_base *base,
 			return r;
 	}
 
+	/* And with those in the timer wheel. */
+	if (base->timewheel) {
+		struct timer_wheel *w = base->timewheel;
+		struct event_list *list;
+		for (u = 0; u <= TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; ++u) {
+			list = u < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS ?
+			    &w->slots[u / TIMER_WHEEL_SLOTS][u % TIMER_WHEEL_SLOTS] :
+			    &w->overflow;
+			TAILQ_FOREACH(ev, list,
+			    ev_timeout_pos.ev_next_with_common_timeout) {
+				if (ev->ev_flags & EVLIST_INSERTED)
+					continue;
+				if ((r = fn(base, ev, arg)))
+					return r;
+			}
+		}
+	}
+
 	/* Now for the events in one of the timeout queues.
 	 * the min-heap. */
 	for (i = 0; i < base->n_common_timeouts; ++i) {
@@ -3900,6 +4005,47 @@ event_base_assert_ok_nolock_(struct event_base *base)
 		EVUTIL_ASSERT(ev->ev_timeout_pos.min_heap_idx == i);
 	}
 
+	/* Check that every event in the timer wheel is where it should be,
+	 * and that there is room in the heap for all of them. */
+	if (base->timewheel) {
+		struct timer_wheel *w = base->timewheel;
+		struct event_list *list, *expect;
+		struct event *ev;
+		int level, slot, j;
+		unsigned n = 0;
+
+		for (i = 0; i <= TIMER_WHEEL_LEVELS; ++i) {
+			for (j = 0; j < TIMER_WHEEL_SLOTS; ++j) {
+				if (i == TIMER_WHEEL_LEVELS && j > 0)
+					break;
+				list = i < TIMER_WHEEL_LEVELS ?
+				    &w->slots[i][j] : &w->overflow;
+				EVUTIL_ASSERT_TAILQ_OK(list, event,
+				    ev_timeout_pos.ev_next_with_common_timeout);
+				if (i < TIMER_WHEEL_LEVELS)
+					EVUTIL_ASSERT(!(w->pending[i] &
+					    ((ev_uint64_t)1 << j)) ==
+					    TAILQ_EMPTY(list));
+				TAILQ_FOREACH(ev, list,
+				    ev_timeout_pos.ev_next_with_common_timeout) {
+					EVUTIL_ASSERT(ev->ev_flags & EVLIST_TIMEOUT);
+					EVUTIL_ASSERT(!is_common_timeout(&ev->ev_timeout, base));
+					EVUTIL_ASSERT(timer_wheel_holds_(w, ev));
+					expect = timer_wheel_slot_(w,
+					    timer_wheel_tick_(&ev->ev_timeout),
+					    &level, &slot);
+					EVUTIL_ASSERT(expect == list);
+					++n;
+				}
+			}
+		}
+		EVUTIL_ASSERT(n == w->n);
+		EVUTIL_ASSERT(base->timeheap.a >= base->timeheap.n + w->n);
+		for (i = 0; i < (int)base->timeheap.n; ++i)
+			EVUTIL_ASSERT(!timer_wheel_holds_(w,
+			    base->timeheap.p[i]));
+	}
+
 	/* Check that the common timeouts are fine */
 	for (i = 0; i < base->n_common_timeouts; ++i) {
 		struct common_timeout_list *ctl = base->common_timeout_queues[i];
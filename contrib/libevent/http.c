@@ -94,6 +94,7 @@
 #include "event2/http.h"
 #include "event2/event.h"
 #include "event2/buffer.h"
+#include "event2/buffer_compat.h"
 #include "event2/bufferevent.h"
 #include "event2/http_struct.h"
 #include "event2/http_compat.h"
@@ -104,6 +105,7 @@
 #include "http-internal.h"
 #include "mm-internal.h"
 #include "bufferevent-internal.h"
+#include "evbuffer-internal.h"
 
 #ifndef EVENT__HAVE_GETNAMEINFO
 #define NI_MAXSERV 32
@@ -616,9 +618,14 @@ evhttp_make_header(struct evhttp_connection *evcon, struct evhttp_request *req)
 		evbuffer_get_length(req->output_buffer)) {
 		/*
 		 * For a request, we add the POST data, for a reply, this
-		 * is the regular data.
+		 * is the regular data.  Nothing reads a reply body back
+		 * from the output, so it can go out with sendfile.
 		 */
-		evbuffer_add_buffer(output, req->output_buffer);
+		if (req->kind == EVHTTP_RESPONSE)
+			evbuffer_add_buffer_sendfile_(output,
+			    req->output_buffer);
+		else
+			evbuffer_add_buffer(output, req->output_buffer);
 	}
 }
 
@@ -2858,7 +2865,7 @@ evhttp_send_reply_chunk_with_cb(struct evhttp_request *req, struct evbuffer *dat
 		evbuffer_add_printf(output, "%x\r\n",
 				    (unsigned)evbuffer_get_length(databuf));
 	}
-	evbuffer_add_buffer(output, databuf);
+	evbuffer_add_buffer_sendfile_(output, databuf);
 	if (req->chunked) {
 		evbuffer_add(output, "\r\n", 2);
 	}
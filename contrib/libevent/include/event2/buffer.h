@@ -499,13 +499,62 @@ int evbuffer_add_reference(struct evbuffer *outbuf,
     const void *data, size_t datlen,
     evbuffer_ref_cleanup_cb cleanupfn, void *cleanupfn_arg);
 
+/**
+  An evbuffer_ref_segment holds a reference-counted piece of memory that
+  can be added, in whole or in part, to any number of evbuffers without
+  copying it.  This suits data that is sent over and over, like a cached
+  file body: the memory is released once, when the last evbuffer that
+  refers to it and the segment itself have been freed.
+ */
+struct evbuffer_ref_segment;
+
+/**
+  Create and return a new evbuffer_ref_segment for some memory.
+
+  The memory needs to remain valid until the cleanup function is
+  invoked.
+
+  @param data the memory to reference
+  @param datlen how much memory to reference
+  @param cleanupfn callback to be invoked when the memory is no longer
+	referenced by the segment or by any evbuffer, or NULL.
+  @param cleanupfn_arg optional argument to the cleanup callback
+  @return a new evbuffer_ref_segment, or NULL on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+struct evbuffer_ref_segment *evbuffer_ref_segment_new(const void *data,
+    size_t datlen, evbuffer_ref_cleanup_cb cleanupfn, void *cleanupfn_arg);
+
+/**
+  Free an evbuffer_ref_segment
+
+  The memory is not released while the segment is still in use by one or
+  more evbuffers.
+ */
+EVENT2_EXPORT_SYMBOL
+void evbuffer_ref_segment_free(struct evbuffer_ref_segment *seg);
+
+/**
+  Insert some or all of an evbuffer_ref_segment at the end of an evbuffer
+
+  @param buf the evbuffer to append to
+  @param seg the segment to add
+  @param offset the offset within the segment to start from
+  @param length the amount of data to add, or -1 to add it all.
+  @return 0 on success, -1 on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+int evbuffer_add_ref_segment(struct evbuffer *buf,
+    struct evbuffer_ref_segment *seg, size_t offset, ev_ssize_t length);
+
 /**
   Copy data from a file into the evbuffer for writing to a socket.
 
   This function avoids unnecessary data copies between userland and
   kernel.  If sendfile is available and the EVBUFFER_FLAG_DRAINS_TO_FD
   flag is set, it uses those functions.  Otherwise, it tries to use
-  mmap (or CreateFileMapping on Windows).
+  mmap (or CreateFileMapping on Windows).  An evhttp reply body that
+  was added this way is sent with sendfile where it is available.
 
   The function owns the resulting file descriptor and will close it
   when finished transferring data.
@@ -1008,6 +1057,9 @@ int evbuffer_prepend(struct evbuffer *buf, const void *data, size_t size);
   Prepends all data from the src evbuffer to the beginning of the dst
   evbuffer.
 
+  File data in src may be switched to sendfile as with
+  evbuffer_add_buffer().
+
   @param dst the evbuffer to which to prepend data
   @param src the evbuffer to prepend; it will be emptied as a result
   @return 0 if successful, or -1 otherwise
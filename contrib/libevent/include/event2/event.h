@@ -570,7 +570,23 @@ enum event_base_config_flag {
 	    however, we use less efficient more precise timer, assuming one is
 	    present.
 	 */
-	EVENT_BASE_FLAG_PRECISE_TIMER = 0x20
+	EVENT_BASE_FLAG_PRECISE_TIMER = 0x20,
+
+	/** Ordinarily, Libevent keeps the events that have a timeout in a
+	    min-heap, which makes adding and deleting a timeout take
+	    O(log n) time.  If this flag is set, timeouts that are not due
+	    within the next millisecond are kept in a hierarchical timer wheel
+	    instead, where adding and deleting them takes constant time.
+	    Timeout callbacks still run in the order of their timeouts.
+
+	    This pays off when there are many timeouts that are moved
+	    forward over and over but rarely expire, such as idle timeouts
+	    on a large number of connections.
+
+	    This flag can also be activated by setting the
+	    EVENT_TIMER_WHEEL environment variable.
+	 */
+	EVENT_BASE_FLAG_TIMER_WHEEL = 0x1000
 };
 
 /**
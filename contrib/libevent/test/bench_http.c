@@ -52,6 +52,10 @@ static void http_basic_cb(struct evhttp_request *req, void *arg);
 
 static char *content;
 static size_t content_len = 0;
+static struct evbuffer_ref_segment *content_seg;
+#ifndef _WIN32
+static struct evbuffer_file_segment *content_file;
+#endif
 
 static void
 http_basic_cb(struct evhttp_request *req, void *arg)
@@ -81,6 +85,56 @@ http_ref_cb(struct evhttp_request *req, void *arg)
 }
 #endif
 
+static void
+http_seg_cb(struct evhttp_request *req, void *arg)
+{
+	struct evbuffer *evb = evbuffer_new();
+
+	evbuffer_add_ref_segment(evb, content_seg, 0, -1);
+
+	evhttp_send_reply(req, HTTP_OK, "Everything is fine", evb);
+
+	evbuffer_free(evb);
+}
+
+#ifndef _WIN32
+static void
+http_file_cb(struct evhttp_request *req, void *arg)
+{
+	struct evbuffer *evb = evbuffer_new();
+
+	evbuffer_add_file_segment(evb, content_file, 0, -1);
+
+	evhttp_send_reply(req, HTTP_OK, "Everything is fine", evb);
+
+	evbuffer_free(evb);
+}
+
+/* Put the content into an unlinked temporary file. */
+static int
+make_content_file(void)
+{
+	char tmpfilename[] = "/tmp/bench_http.XXXXXX";
+	size_t written = 0;
+	ssize_t n;
+	int fd;
+
+	fd = mkstemp(tmpfilename);
+	if (fd == -1)
+		return -1;
+	unlink(tmpfilename);
+	while (written < content_len) {
+		n = write(fd, content + written, content_len - written);
+		if (n <= 0) {
+			close(fd);
+			return -1;
+		}
+		written += n;
+	}
+	return fd;
+}
+#endif
+
 int
 main(int argc, char **argv)
 {
@@ -90,6 +144,9 @@ main(int argc, char **argv)
 	int i;
 	int c;
 	int use_iocp = 0;
+#ifndef _WIN32
+	int fd;
+#endif
 	ev_uint16_t port = 8080;
 	char *endptr = NULL;
 
@@ -174,6 +231,28 @@ main(int argc, char **argv)
 	evhttp_set_cb(http, "/ref", http_ref_cb, NULL);
 	fprintf(stderr, "/ref - basic content (reference)\n");
 
+	content_seg = evbuffer_ref_segment_new(content, content_len,
+	    NULL, NULL);
+	if (content_seg == NULL) {
+		fprintf(stderr, "Cannot allocate content segment\n");
+		exit(1);
+	}
+	evhttp_set_cb(http, "/seg", http_seg_cb, NULL);
+	fprintf(stderr, "/seg - basic content (shared reference segment)\n");
+
+#ifndef _WIN32
+	fd = make_content_file();
+	if (fd != -1)
+		content_file = evbuffer_file_segment_new(fd, 0, content_len,
+		    EVBUF_FS_CLOSE_ON_FREE);
+	if (content_file == NULL) {
+		fprintf(stderr, "Cannot create content file\n");
+		exit(1);
+	}
+	evhttp_set_cb(http, "/file", http_file_cb, NULL);
+	fprintf(stderr, "/file - basic content (file segment)\n");
+#endif
+
 	fprintf(stderr, "Serving %d bytes on port %d using %s\n",
 	    (int)content_len, port,
 	    use_iocp? "IOCP" : event_base_get_method(base));
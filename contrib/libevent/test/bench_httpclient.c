@@ -187,7 +187,7 @@ main(int argc, char **argv)
 	WSAStartup(0x101, &WSAData);
 #endif
 
-	resource = "/ref";
+	resource = argc > 1 ? argv[1] : "/ref";
 
 	setvbuf(stdout, NULL, _IONBF, 0);
 
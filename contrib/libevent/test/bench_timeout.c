@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2026 The HardenedBSD Project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 4. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "event2/event-config.h"
+
+#include <sys/types.h>
+#ifdef EVENT__HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef EVENT__HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <getopt.h>
+#include <event2/event.h>
+#include <event2/event_struct.h>
+#include <event2/util.h>
+
+/*
+ * This benchmark measures the cost of timeouts on a base with many idle
+ * connections: first moving every timeout forward, as is done whenever
+ * a connection sees some traffic, and then letting them all expire.  It
+ * runs once with the default min-heap and once with the timer wheel.
+ */
+
+static int fired;
+
+static void
+timeout_cb(evutil_socket_t fd, short which, void *arg)
+{
+	fired++;
+}
+
+static double
+elapsed_ns(const struct timeval *ts)
+{
+	struct timeval te;
+
+	evutil_gettimeofday(&te, NULL);
+	evutil_timersub(&te, ts, &te);
+	return (te.tv_sec * 1e9 + te.tv_usec * 1e3);
+}
+
+static void
+run_once(int flags, int num_timeouts, int num_rounds)
+{
+	struct event_config *cfg;
+	struct event_base *base;
+	struct event *events;
+	struct timeval ts, tv;
+	double reset_ns, expire_ns;
+	int i, round;
+
+	cfg = event_config_new();
+	if (cfg == NULL) {
+		perror("event_config_new");
+		exit(1);
+	}
+	event_config_set_flag(cfg, EVENT_BASE_FLAG_IGNORE_ENV | flags);
+	base = event_base_new_with_config(cfg);
+	events = calloc(num_timeouts, sizeof(struct event));
+	if (base == NULL || events == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	/* Idle timeouts of 30 to 60 seconds, moved forward again and
+	 * again. */
+	for (i = 0; i < num_timeouts; i++)
+		event_assign(&events[i], base, -1, 0, timeout_cb, NULL);
+	evutil_gettimeofday(&ts, NULL);
+	for (round = 0; round < num_rounds; round++) {
+		for (i = 0; i < num_timeouts; i++) {
+			tv.tv_sec = 30 + rand() % 30;
+			tv.tv_usec = rand() % 1000000;
+			event_add(&events[i], &tv);
+		}
+		event_base_loop(base, EVLOOP_NONBLOCK);
+	}
+	reset_ns = elapsed_ns(&ts) / ((double)num_rounds * num_timeouts);
+
+	/* Then let them all expire within 100 milliseconds; only the
+	 * time spent running the loop counts. */
+	for (i = 0; i < num_timeouts; i++) {
+		tv.tv_sec = 0;
+		tv.tv_usec = rand() % 100000;
+		event_add(&events[i], &tv);
+	}
+#ifdef _WIN32
+	Sleep(150);
+#else
+	usleep(150000);
+#endif
+	fired = 0;
+	evutil_gettimeofday(&ts, NULL);
+	while (fired < num_timeouts)
+		event_base_loop(base, EVLOOP_NONBLOCK);
+	expire_ns = elapsed_ns(&ts) / num_timeouts;
+
+	fprintf(stdout, "%-5s %8d timeouts: reset %7.1f ns, expiry %7.1f ns\n",
+	    flags & EVENT_BASE_FLAG_TIMER_WHEEL ? "wheel" : "heap",
+	    num_timeouts, reset_ns, expire_ns);
+
+	event_base_free(base);
+	event_config_free(cfg);
+	free(events);
+}
+
+int
+main(int argc, char **argv)
+{
+	int c;
+	int num_timeouts = 100000;
+	int num_rounds = 10;
+#ifdef _WIN32
+	WSADATA WSAData;
+	WSAStartup(0x101, &WSAData);
+#endif
+
+	while ((c = getopt(argc, argv, "n:r:")) != -1) {
+		switch (c) {
+		case 'n':
+			num_timeouts = atoi(optarg);
+			break;
+		case 'r':
+			num_rounds = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Illegal argument \"%c\"\n", c);
+			exit(1);
+		}
+	}
+	if (num_timeouts < 1 || num_rounds < 1) {
+		fprintf(stderr, "Usage: %s [-n timeouts] [-r rounds]\n",
+		    argv[0]);
+		exit(1);
+	}
+
+	run_once(0, num_timeouts, num_rounds);
+	run_once(EVENT_BASE_FLAG_TIMER_WHEEL, num_timeouts, num_rounds);
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+
+	exit(0);
+}
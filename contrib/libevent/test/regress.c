@@ -1906,6 +1906,122 @@ test_event_remove_timeout(void *ptr)
 	event_free(ev[4]);
 }
 
+#define TIMEOUT_ORDER_N 2000
+
+struct timeout_order_state {
+	struct timeval last;	/* timeout of the last callback to run */
+	int fired;
+	int early;		/* callbacks run before their timeout */
+	int disorder;		/* callbacks run out of order */
+	int deleted;		/* callbacks for deleted events */
+};
+
+struct timeout_order_event {
+	struct event ev;
+	struct timeout_order_state *state;
+	int deleted;
+};
+
+static void
+timeout_order_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct timeout_order_event *te = arg;
+	struct timeout_order_state *st = te->state;
+	struct timeval now;
+
+	evutil_gettime_monotonic_(&te->ev.ev_base->monotonic_timer, &now);
+	if (evutil_timercmp(&now, &te->ev.ev_timeout, <))
+		++st->early;
+	if (evutil_timercmp(&te->ev.ev_timeout, &st->last, <))
+		++st->disorder;
+	if (te->deleted)
+		++st->deleted;
+	st->last = te->ev.ev_timeout;
+	++st->fired;
+}
+
+/* Add, move and delete many timeouts, and check that the ones left run
+ * in order, and not before their time. */
+static void
+test_timeout_order(void *ptr)
+{
+	struct basic_test_data *data = ptr;
+	const int wheel = strstr(data->setup_data, "wheel") != NULL;
+	struct event_config *cfg = NULL;
+	struct event_base *base = NULL;
+	struct timeout_order_event *tes = NULL;
+	struct timeout_order_state st;
+	struct timeval tv, exit_tv = { 0, 400*1000 };
+	int i, round, expected = 0, left = 0;
+
+	cfg = event_config_new();
+	tt_assert(cfg);
+	event_config_set_flag(cfg, EVENT_BASE_FLAG_IGNORE_ENV);
+	if (wheel)
+		event_config_set_flag(cfg, EVENT_BASE_FLAG_TIMER_WHEEL);
+	base = event_base_new_with_config(cfg);
+	tt_assert(base);
+	tt_int_op(base->timewheel != NULL, ==, wheel);
+
+	memset(&st, 0, sizeof(st));
+	tes = calloc(TIMEOUT_ORDER_N, sizeof(*tes));
+	tt_assert(tes);
+	for (i = 0; i < TIMEOUT_ORDER_N; ++i) {
+		tes[i].state = &st;
+		event_assign(&tes[i].ev, base, -1, 0, timeout_order_cb,
+		    &tes[i]);
+	}
+
+	/* Move every timeout a few times, as with idle timeouts.  The
+	 * short ones end up in the first levels of the wheel, the long
+	 * ones in the last levels and in the overflow list. */
+	for (round = 0; round < 3; ++round) {
+		for (i = 0; i < TIMEOUT_ORDER_N; ++i) {
+			if (i % 8 == 7) {
+				tv.tv_sec = 60 * (1 + test_weakrand() % 1000);
+				tv.tv_usec = test_weakrand() % 1000000;
+			} else {
+				tv.tv_sec = 0;
+				tv.tv_usec = test_weakrand() % 300000;
+			}
+			event_add(&tes[i].ev, &tv);
+		}
+		event_base_assert_ok_(base);
+	}
+	for (i = 0; i < TIMEOUT_ORDER_N; i += 5) {
+		event_del(&tes[i].ev);
+		tes[i].deleted = 1;
+	}
+	event_base_assert_ok_(base);
+	for (i = 0; i < TIMEOUT_ORDER_N; ++i) {
+		if (tes[i].deleted)
+			continue;
+		if (i % 8 == 7)
+			++left;
+		else
+			++expected;
+	}
+
+	event_base_loopexit(base, &exit_tv);
+	event_base_dispatch(base);
+	event_base_assert_ok_(base);
+
+	tt_int_op(st.fired, ==, expected);
+	tt_int_op(st.early, ==, 0);
+	tt_int_op(st.disorder, ==, 0);
+	tt_int_op(st.deleted, ==, 0);
+	tt_int_op(event_base_get_num_events(base, EVENT_BASE_COUNT_ADDED), ==,
+	    left);
+
+end:
+	/* Freeing the base deletes the long timeouts. */
+	if (base)
+		event_base_free(base);
+	if (cfg)
+		event_config_free(cfg);
+	free(tes);
+}
+
 static void
 test_event_base_new(void *ptr)
 {
@@ -3382,6 +3498,10 @@ struct testcase_t main_testcases[] = {
 	BASIC(bad_reentrant, TT_FORK|TT_NEED_BASE|TT_NO_LOGS),
 	BASIC(active_later, TT_FORK|TT_NEED_BASE|TT_NEED_SOCKETPAIR),
 	BASIC(event_remove_timeout, TT_FORK|TT_NEED_BASE|TT_NEED_SOCKETPAIR),
+	{ "timeout_order", test_timeout_order, TT_FORK, &basic_setup,
+	  (void*)"heap" },
+	{ "timeout_order_wheel", test_timeout_order, TT_FORK, &basic_setup,
+	  (void*)"wheel" },
 
 	/* These are still using the old API */
 	LEGACY(persistent_timeout, TT_FORK|TT_NEED_BASE),
@@ -927,6 +927,10 @@ test_evbuffer_add_file(void *ptr)
 	struct basic_test_data *testdata = ptr;
 	const char *impl = testdata->setup_data;
 	struct evbuffer *src = evbuffer_new(), *dest = evbuffer_new();
+	struct evbuffer *body = NULL, *plain = NULL;
+	char *copy = NULL;
+	const char header[] = "HTTP/1.0 200 OK\r\n\r\n";
+	size_t header_len = 0;
 	char *tmpfilename = NULL;
 	char *data = NULL;
 	const char *expect_data;
@@ -936,7 +940,7 @@ test_evbuffer_add_file(void *ptr)
 	int want_ismapping = -1, want_cansendfile = -1;
 	unsigned flags = 0;
 	int use_segment = 1, use_bigfile = 0, map_from_offset = 0,
-	    view_from_offset = 0;
+	    view_from_offset = 0, via_buffer = 0;
 	struct evbuffer_file_segment *seg = NULL;
 	ev_off_t starting_offset = 0, mapping_len = -1;
 	ev_off_t segment_offset = 0, segment_len = -1;
@@ -970,6 +974,13 @@ test_evbuffer_add_file(void *ptr)
 		 * the segment. */
 		view_from_offset = 1;
 	}
+	if (strstr(impl, "via_buffer")) {
+		/* If via_buffer is set, we add the file to a buffer that
+		 * does not drain to a fd, and then move it behind a header
+		 * in one that does, as evhttp does with a reply body. */
+		via_buffer = 1;
+		header_len = strlen(header);
+	}
 	if (strstr(impl, "sendfile")) {
 		/* If sendfile is set, we try to use a sendfile/splice style
 		 * backend. */
@@ -1059,13 +1070,41 @@ test_evbuffer_add_file(void *ptr)
 
 	tt_assert(fd != -1);
 
+	if (via_buffer) {
+		body = evbuffer_new();
+		tt_assert(body);
+		evbuffer_add(src, header, header_len);
+	} else {
+		body = src;
+	}
 	if (use_segment) {
-		tt_assert(evbuffer_add_file_segment(src, seg,
+		tt_assert(evbuffer_add_file_segment(body, seg,
 			segment_offset, segment_len)!=-1);
 	} else {
-		tt_assert(evbuffer_add_file(src, fd, starting_offset,
+		tt_assert(evbuffer_add_file(body, fd, starting_offset,
 			mapping_len) != -1);
 	}
+	if (via_buffer) {
+		evbuffer_validate(body);
+		/* A plain move leaves the file data readable. */
+		plain = evbuffer_new();
+		tt_assert(plain);
+		evbuffer_set_flags(plain, EVBUFFER_FLAG_DRAINS_TO_FD);
+		tt_assert(evbuffer_add_buffer(plain, body) == 0);
+		tt_assert(!(plain->last->flags & EVBUFFER_SENDFILE));
+		copy = malloc(expect_len);
+		tt_assert(copy);
+		tt_int_op(evbuffer_copyout(plain, copy, expect_len), ==,
+		    expect_len);
+		tt_assert(!memcmp(copy, expect_data, expect_len));
+		tt_assert(evbuffer_add_buffer(body, plain) == 0);
+		/* The way evhttp sends a reply body switches to sendfile. */
+		tt_assert(evbuffer_add_buffer_sendfile_(src, body) == 0);
+		tt_int_op(evbuffer_get_length(body), ==, 0);
+		/* The file data should go out with sendfile after all. */
+		if (use_segment && seg->can_sendfile)
+			tt_assert(src->last->flags & EVBUFFER_SENDFILE);
+	}
 
 	evbuffer_validate(src);
 
@@ -1087,12 +1126,15 @@ test_evbuffer_add_file(void *ptr)
 	evbuffer_validate(dest);
 
 	tt_assert(addfile_test_done_writing);
-	tt_int_op(addfile_test_total_written, ==, expect_len);
-	tt_int_op(addfile_test_total_read, ==, expect_len);
+	tt_int_op(addfile_test_total_written, ==, header_len + expect_len);
+	tt_int_op(addfile_test_total_read, ==, header_len + expect_len);
 
-	compare = (char *)evbuffer_pullup(dest, expect_len);
+	compare = (char *)evbuffer_pullup(dest, header_len + expect_len);
 	tt_assert(compare != NULL);
-	if (memcmp(compare, expect_data, expect_len)) {
+	if (memcmp(compare, header, header_len)) {
+		tt_abort_msg("Header in front of add_file differs.");
+	}
+	if (memcmp(compare + header_len, expect_data, expect_len)) {
 		tt_abort_msg("Data from add_file differs.");
 	}
 
@@ -1102,6 +1144,12 @@ test_evbuffer_add_file(void *ptr)
 		free(data);
 	if (seg)
 		evbuffer_file_segment_free(seg);
+	if (body && body != src)
+		evbuffer_free(body);
+	if (plain)
+		evbuffer_free(plain);
+	if (copy)
+		free(copy);
 	if (src)
 		evbuffer_free(src);
 	if (dest)
@@ -1924,6 +1972,65 @@ test_evbuffer_add_reference(void *ptr)
 		evbuffer_free(buf2);
 }
 
+static void
+test_evbuffer_ref_segment(void *ptr)
+{
+	const char chunk[] = "If you have found the answer to such a problem";
+	size_t len = strlen(chunk);
+	struct evbuffer *buf1 = NULL, *buf2 = NULL;
+	struct evbuffer_ref_segment *seg = NULL;
+	char tmp[16];
+
+	ref_done_cb_called_count = 0;
+	buf1 = evbuffer_new();
+	buf2 = evbuffer_new();
+	tt_assert(buf1 && buf2);
+
+	seg = evbuffer_ref_segment_new(chunk, len, ref_done_cb, (void*)111);
+	tt_assert(seg);
+
+	/* Out of range */
+	tt_int_op(evbuffer_add_ref_segment(buf1, seg, len + 1, -1), ==, -1);
+	tt_int_op(evbuffer_add_ref_segment(buf1, seg, 3, len - 2), ==, -1);
+	tt_int_op(evbuffer_get_length(buf1), ==, 0);
+
+	/* The same memory, twice in one buffer and once in another. */
+	tt_int_op(evbuffer_add_ref_segment(buf1, seg, 0, -1), ==, 0);
+	tt_int_op(evbuffer_add_ref_segment(buf1, seg, 3, 4), ==, 0);
+	tt_int_op(evbuffer_add_ref_segment(buf2, seg, 12, 12), ==, 0);
+	tt_int_op(evbuffer_get_length(buf1), ==, len + 4);
+	tt_int_op(evbuffer_get_length(buf2), ==, 12);
+	evbuffer_validate(buf1);
+	evbuffer_validate(buf2);
+	tt_int_op(memcmp(evbuffer_pullup(buf1, -1) + len, "you ", 4), ==, 0);
+	tt_int_op(evbuffer_remove(buf2, tmp, 5), ==, 5);
+	tt_int_op(memcmp(tmp, "found", 5), ==, 0);
+
+	/* Nothing is released until the segment and every chain that
+	 * refers to it are gone. */
+	evbuffer_ref_segment_free(seg);
+	seg = NULL;
+	tt_int_op(ref_done_cb_called_count, ==, 0);
+	evbuffer_free(buf1);
+	buf1 = NULL;
+	tt_int_op(ref_done_cb_called_count, ==, 0);
+
+	evbuffer_free(buf2);
+	buf2 = NULL;
+	tt_int_op(ref_done_cb_called_count, ==, 1);
+	tt_assert(ref_done_cb_called_with == (void*)111);
+	tt_assert(ref_done_cb_called_with_data == chunk);
+	tt_assert(ref_done_cb_called_with_len == len);
+
+end:
+	if (buf1)
+		evbuffer_free(buf1);
+	if (buf2)
+		evbuffer_free(buf2);
+	if (seg)
+		evbuffer_ref_segment_free(seg);
+}
+
 static void
 test_evbuffer_multicast(void *ptr)
 {
@@ -2524,6 +2631,7 @@ struct testcase_t evbuffer_testcases[] = {
 	{ "search", test_evbuffer_search, 0, NULL, NULL },
 	{ "callbacks", test_evbuffer_callbacks, 0, NULL, NULL },
 	{ "add_reference", test_evbuffer_add_reference, 0, NULL, NULL },
+	{ "ref_segment", test_evbuffer_ref_segment, 0, NULL, NULL },
 	{ "multicast", test_evbuffer_multicast, 0, NULL, NULL },
 	{ "multicast_drain", test_evbuffer_multicast_drain, 0, NULL, NULL },
 	{ "prepend", test_evbuffer_prepend, TT_FORK, NULL, NULL },
@@ -2559,5 +2667,11 @@ struct testcase_t evbuffer_testcases[] = {
 	ADDFILE_TEST_GROUP("add_file_offset3",
 	    "bigfile offset_in_segment map_offset"),
 
+	ADDFILE_TEST_GROUP("add_file_via_buffer", "via_buffer"),
+	ADDFILE_TEST("add_file_via_buffer_nosegment",
+	    "default nosegment via_buffer"),
+	ADDFILE_TEST_GROUP("add_big_file_via_buffer",
+	    "bigfile offset_in_segment map_offset via_buffer"),
+
 	END_OF_TESTCASES
 };
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2026 The HardenedBSD Project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TIMERWHEEL_INTERNAL_H_INCLUDED_
+#define TIMERWHEEL_INTERNAL_H_INCLUDED_
+
+#include "event2/event-config.h"
+#include "evconfig-private.h"
+#include "event2/event.h"
+#include "event2/event_struct.h"
+#include "event2/util.h"
+#include "util-internal.h"
+#include "mm-internal.h"
+
+/*
+  A hierarchical timer wheel, used by event_bases created with
+  EVENT_BASE_FLAG_TIMER_WHEEL to hold the timeouts that are not due yet.
+
+  Time is counted in ticks of 1024 microseconds.  Level 0 has a slot for
+  each of the next 64 ticks, level 1 a slot for each of the next 64 runs
+  of 64 ticks, and so on; timeouts beyond the last level go on an
+  overflow list.  An event goes in the slot of the highest 6-bit digit
+  in which its tick differs from the tick the wheel was last advanced
+  to, so its slot follows from its timeout alone, and adding or removing
+  it takes constant time.  When the wheel is advanced, the slots that
+  were passed are emptied, and their events are put back in lower slots
+  or, if their tick has come, handed back to the caller.
+
+  The wheel only holds events whose tick is later than the current one,
+  so whether an event is in the wheel also follows from its timeout.
+  The events in a slot are not sorted: the caller moves them to the
+  min-heap when their tick comes, which keeps the firing order exact.
+*/
+
+#define TIMER_WHEEL_TICK_SHIFT	10
+#define TIMER_WHEEL_BITS	6
+#define TIMER_WHEEL_SLOTS	(1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS	4
+
+typedef struct timer_wheel
+{
+	/** The tick the wheel was last advanced to. */
+	ev_uint64_t now;
+	/** Number of events in the wheel. */
+	unsigned n;
+	/** For each level, a bit for each slot that is not empty. */
+	ev_uint64_t pending[TIMER_WHEEL_LEVELS];
+	struct event_list slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	struct event_list overflow;
+} timer_wheel_t;
+
+static inline void	     timer_wheel_ctor_(timer_wheel_t* w, const struct timeval* now);
+static inline ev_uint64_t    timer_wheel_tick_(const struct timeval* tv);
+static inline int	     timer_wheel_empty_(const timer_wheel_t* w);
+static inline int	     timer_wheel_holds_(const timer_wheel_t* w, const struct event* e);
+static inline void	     timer_wheel_push_(timer_wheel_t* w, struct event* e);
+static inline void	     timer_wheel_erase_(timer_wheel_t* w, struct event* e);
+static inline struct event*  timer_wheel_any_(timer_wheel_t* w);
+static inline int	     timer_wheel_next_(timer_wheel_t* w, struct timeval* tv);
+static inline int	     timer_wheel_is_first_(timer_wheel_t* w, const struct event* e);
+static inline void	     timer_wheel_advance_(timer_wheel_t* w, const struct timeval* now, struct event_list* expired);
+static inline struct event_list* timer_wheel_slot_(timer_wheel_t* w, ev_uint64_t tick, int* level, int* slot);
+
+#define timer_wheel_digit(tick, level) \
+	((int)(((tick) >> ((level) * TIMER_WHEEL_BITS)) & (TIMER_WHEEL_SLOTS - 1)))
+
+static inline int
+timer_wheel_ffs_(ev_uint64_t bits)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(bits);
+#else
+	int i = 0;
+	while (!(bits & 1)) {
+		bits >>= 1;
+		++i;
+	}
+	return i;
+#endif
+}
+
+void timer_wheel_ctor_(timer_wheel_t* w, const struct timeval* now)
+{
+	int i, j;
+
+	w->now = timer_wheel_tick_(now);
+	w->n = 0;
+	for (i = 0; i < TIMER_WHEEL_LEVELS; ++i) {
+		w->pending[i] = 0;
+		for (j = 0; j < TIMER_WHEEL_SLOTS; ++j)
+			TAILQ_INIT(&w->slots[i][j]);
+	}
+	TAILQ_INIT(&w->overflow);
+}
+
+ev_uint64_t timer_wheel_tick_(const struct timeval* tv)
+{
+	return ((ev_uint64_t)tv->tv_sec * 1000000 + tv->tv_usec) >>
+	    TIMER_WHEEL_TICK_SHIFT;
+}
+
+int timer_wheel_empty_(const timer_wheel_t* w) { return 0u == w->n; }
+
+int timer_wheel_holds_(const timer_wheel_t* w, const struct event* e)
+{
+	return timer_wheel_tick_(&e->ev_timeout) > w->now;
+}
+
+/* Return the list for 'tick', which must be later than w->now, and its
+ * place in the wheel; the level is TIMER_WHEEL_LEVELS for the overflow
+ * list. */
+struct event_list* timer_wheel_slot_(timer_wheel_t* w, ev_uint64_t tick, int* level, int* slot)
+{
+	ev_uint64_t diff = tick ^ w->now;
+	int l;
+
+	if (diff >> (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) {
+		*level = TIMER_WHEEL_LEVELS;
+		*slot = 0;
+		return &w->overflow;
+	}
+	for (l = TIMER_WHEEL_LEVELS - 1; l > 0; --l)
+		if (diff >> (l * TIMER_WHEEL_BITS))
+			break;
+	*level = l;
+	*slot = timer_wheel_digit(tick, l);
+	return &w->slots[l][*slot];
+}
+
+void timer_wheel_push_(timer_wheel_t* w, struct event* e)
+{
+	struct event_list *list;
+	int level, slot;
+
+	list = timer_wheel_slot_(w, timer_wheel_tick_(&e->ev_timeout),
+	    &level, &slot);
+	TAILQ_INSERT_TAIL(list, e, ev_timeout_pos.ev_next_with_common_timeout);
+	if (level < TIMER_WHEEL_LEVELS)
+		w->pending[level] |= (ev_uint64_t)1 << slot;
+	++w->n;
+}
+
+void timer_wheel_erase_(timer_wheel_t* w, struct event* e)
+{
+	struct event_list *list;
+	int level, slot;
+
+	list = timer_wheel_slot_(w, timer_wheel_tick_(&e->ev_timeout),
+	    &level, &slot);
+	TAILQ_REMOVE(list, e, ev_timeout_pos.ev_next_with_common_timeout);
+	if (level < TIMER_WHEEL_LEVELS && TAILQ_EMPTY(list))
+		w->pending[level] &= ~((ev_uint64_t)1 << slot);
+	--w->n;
+	e->ev_timeout_pos.min_heap_idx = -1;
+}
+
+/* Return some event in the wheel, or NULL. */
+struct event* timer_wheel_any_(timer_wheel_t* w)
+{
+	int l;
+
+	for (l = 0; l < TIMER_WHEEL_LEVELS; ++l)
+		if (w->pending[l])
+			return TAILQ_FIRST(&w->slots[l][timer_wheel_ffs_(w->pending[l])]);
+	return TAILQ_FIRST(&w->overflow);
+}
+
+/* Find the first slot that is not empty.  Returns its list, and sets
+ * 'tick' to the tick at which it has to be looked at. */
+static inline struct event_list*
+timer_wheel_first_(timer_wheel_t* w, ev_uint64_t* tick)
+{
+	const int top = TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS;
+	int l, slot;
+
+	for (l = 0; l < TIMER_WHEEL_LEVELS; ++l) {
+		if (!w->pending[l])
+			continue;
+		slot = timer_wheel_ffs_(w->pending[l]);
+		*tick = (w->now >> ((l + 1) * TIMER_WHEEL_BITS)
+		    << ((l + 1) * TIMER_WHEEL_BITS)) |
+		    ((ev_uint64_t)slot << (l * TIMER_WHEEL_BITS));
+		return &w->slots[l][slot];
+	}
+	if (TAILQ_EMPTY(&w->overflow))
+		return NULL;
+	*tick = ((w->now >> top) + 1) << top;
+	return &w->overflow;
+}
+
+/* Set 'tv' to the time at which the wheel next has to be advanced;
+ * returns 0 if it is empty. */
+int timer_wheel_next_(timer_wheel_t* w, struct timeval* tv)
+{
+	ev_uint64_t tick, usec;
+
+	if (timer_wheel_first_(w, &tick) == NULL)
+		return 0;
+	usec = tick << TIMER_WHEEL_TICK_SHIFT;
+	tv->tv_sec = usec / 1000000;
+	tv->tv_usec = usec % 1000000;
+	return 1;
+}
+
+/* Return true if 'e', which is in the wheel, is in its first slot. */
+int timer_wheel_is_first_(timer_wheel_t* w, const struct event* e)
+{
+	ev_uint64_t tick;
+	int level, slot;
+
+	return timer_wheel_first_(w, &tick) == timer_wheel_slot_(w,
+	    timer_wheel_tick_(&e->ev_timeout), &level, &slot);
+}
+
+/* Take the events in list 'from' off it and put them on 'to'. */
+static inline void
+timer_wheel_move_(struct event_list* from, struct event_list* to)
+{
+	struct event *e;
+
+	while ((e = TAILQ_FIRST(from)) != NULL) {
+		TAILQ_REMOVE(from, e, ev_timeout_pos.ev_next_with_common_timeout);
+		TAILQ_INSERT_TAIL(to, e, ev_timeout_pos.ev_next_with_common_timeout);
+	}
+}
+
+/* Advance the wheel to 'now', and put the events whose tick has come
+ * on 'expired'. */
+void timer_wheel_advance_(timer_wheel_t* w, const struct timeval* now, struct event_list* expired)
+{
+	struct event_list moved;
+	struct event *e;
+	ev_uint64_t tick = timer_wheel_tick_(now), bits;
+	int l, shift, slot;
+
+	if (tick <= w->now)
+		return;
+
+	/* Empty every slot whose time has come: on each level, those up
+	 * to the new digit, or all of them if a higher digit changed. */
+	TAILQ_INIT(&moved);
+	for (l = 0; l < TIMER_WHEEL_LEVELS; ++l) {
+		shift = (l + 1) * TIMER_WHEEL_BITS;
+		bits = w->pending[l];
+		if ((w->now >> shift) == (tick >> shift))
+			bits &= ((ev_uint64_t)2 << timer_wheel_digit(tick, l)) - 1;
+		while (bits) {
+			slot = timer_wheel_ffs_(bits);
+			bits &= bits - 1;
+			w->pending[l] &= ~((ev_uint64_t)1 << slot);
+			timer_wheel_move_(&w->slots[l][slot], &moved);
+		}
+	}
+	shift = TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS;
+	if ((w->now >> shift) != (tick >> shift))
+		timer_wheel_move_(&w->overflow, &moved);
+
+	w->now = tick;
+	while ((e = TAILQ_FIRST(&moved)) != NULL) {
+		TAILQ_REMOVE(&moved, e, ev_timeout_pos.ev_next_with_common_timeout);
+		--w->n;
+		if (timer_wheel_holds_(w, e))
+			timer_wheel_push_(w, e);
+		else
+			TAILQ_INSERT_TAIL(expired, e,
+			    ev_timeout_pos.ev_next_with_common_timeout);
+	}
+}
+
+#endif /* TIMERWHEEL_INTERNAL_H_INCLUDED_ */
@@ -411,6 +411,560 @@ bpf_filter(const struct bpf_insn *pc, const u_char *p, u_int wirelen,
 	return bpf_filter_with_aux_data(pc, p, wirelen, buflen, NULL);
 }
 
+/*
+ * Pre-decoded filter programs.
+ *
+ * When a lot of packets are filtered in userland, as when reading a
+ * savefile, the validated program is translated once into an array of
+ * "struct bpf_fast_insn": every opcode is turned into a dense operation
+ * number, jump offsets are turned into pointers, and the "load a packet
+ * field, compare it with a constant" pairs that gencode.c emits are
+ * fused into one operation.
+ *
+ * The program is translated twice.  The second copy does no bounds
+ * checks on absolute loads, and is used for packets that have at least
+ * as many bytes as the furthest absolute load of the program needs;
+ * that is the common case, as the filter usually only looks at the
+ * headers.
+ *
+ * With GCC and compatible compilers, the operations are dispatched
+ * with computed gotos rather than with a switch statement.
+ */
+#define BPF_FAST_OPS \
+	BFO(RET_K) BFO(RET_A) \
+	BFO(LD_W_ABS) BFO(LD_H_ABS) BFO(LD_B_ABS) BFO(LDX_MSH_B) \
+	BFO(LD_W_ABS_JEQ) BFO(LD_H_ABS_JEQ) BFO(LD_B_ABS_JEQ) \
+	BFO(LD_B_ABS_JSET) \
+	BFO(LD_W_ABS_NC) BFO(LD_H_ABS_NC) BFO(LD_B_ABS_NC) BFO(LDX_MSH_B_NC) \
+	BFO(LD_W_ABS_JEQ_NC) BFO(LD_H_ABS_JEQ_NC) BFO(LD_B_ABS_JEQ_NC) \
+	BFO(LD_B_ABS_JSET_NC) \
+	BFO(LD_W_IND) BFO(LD_H_IND) BFO(LD_B_IND) \
+	BFO(LD_W_LEN) BFO(LDX_W_LEN) BFO(LD_IMM) BFO(LDX_IMM) \
+	BFO(LD_MEM) BFO(LDX_MEM) BFO(ST) BFO(STX) \
+	BFO(JA) BFO(JGT_K) BFO(JGE_K) BFO(JEQ_K) BFO(JSET_K) \
+	BFO(JGT_X) BFO(JGE_X) BFO(JEQ_X) BFO(JSET_X) \
+	BFO(ADD_X) BFO(SUB_X) BFO(MUL_X) BFO(DIV_X) BFO(MOD_X) \
+	BFO(AND_X) BFO(OR_X) BFO(XOR_X) BFO(LSH_X) BFO(RSH_X) \
+	BFO(ADD_K) BFO(SUB_K) BFO(MUL_K) BFO(DIV_K) BFO(MOD_K) \
+	BFO(AND_K) BFO(OR_K) BFO(XOR_K) BFO(LSH_K) BFO(RSH_K) \
+	BFO(NEG) BFO(TAX) BFO(TXA)
+
+enum bpf_fast_op {
+#define BFO(op)	BFO_##op,
+	BPF_FAST_OPS
+#undef BFO
+	BFO_INVALID
+};
+
+/*
+ * The distance between a checked absolute load and its unchecked
+ * variant in the list above.
+ */
+#define BFO_NOCHECK	(BFO_LD_W_ABS_NC - BFO_LD_W_ABS)
+
+struct bpf_fast_insn {
+	u_int op;
+	bpf_u_int32 k;
+	bpf_u_int32 k2;		/* constant of a fused comparison */
+	const struct bpf_fast_insn *jt;
+	const struct bpf_fast_insn *jf;
+};
+
+struct bpf_fast_program {
+	u_int len;
+	u_int abs_len;		/* bytes needed by the absolute loads */
+	struct bpf_fast_insn *checked;
+	struct bpf_fast_insn *nocheck;
+};
+
+/*
+ * Map a BPF opcode to an operation; returns BFO_INVALID for opcodes
+ * that bpf_filter_with_aux_data() doesn't know about either.
+ */
+static u_int
+bpf_fast_decode(u_short code)
+{
+	switch (code) {
+
+	case BPF_RET|BPF_K:		return BFO_RET_K;
+	case BPF_RET|BPF_A:		return BFO_RET_A;
+	case BPF_LD|BPF_W|BPF_ABS:	return BFO_LD_W_ABS;
+	case BPF_LD|BPF_H|BPF_ABS:	return BFO_LD_H_ABS;
+	case BPF_LD|BPF_B|BPF_ABS:	return BFO_LD_B_ABS;
+	case BPF_LDX|BPF_MSH|BPF_B:	return BFO_LDX_MSH_B;
+	case BPF_LD|BPF_W|BPF_IND:	return BFO_LD_W_IND;
+	case BPF_LD|BPF_H|BPF_IND:	return BFO_LD_H_IND;
+	case BPF_LD|BPF_B|BPF_IND:	return BFO_LD_B_IND;
+	case BPF_LD|BPF_W|BPF_LEN:	return BFO_LD_W_LEN;
+	case BPF_LDX|BPF_W|BPF_LEN:	return BFO_LDX_W_LEN;
+	case BPF_LD|BPF_IMM:		return BFO_LD_IMM;
+	case BPF_LDX|BPF_IMM:		return BFO_LDX_IMM;
+	case BPF_LD|BPF_MEM:		return BFO_LD_MEM;
+	case BPF_LDX|BPF_MEM:		return BFO_LDX_MEM;
+	case BPF_ST:			return BFO_ST;
+	case BPF_STX:			return BFO_STX;
+	case BPF_JMP|BPF_JA:		return BFO_JA;
+	case BPF_JMP|BPF_JGT|BPF_K:	return BFO_JGT_K;
+	case BPF_JMP|BPF_JGE|BPF_K:	return BFO_JGE_K;
+	case BPF_JMP|BPF_JEQ|BPF_K:	return BFO_JEQ_K;
+	case BPF_JMP|BPF_JSET|BPF_K:	return BFO_JSET_K;
+	case BPF_JMP|BPF_JGT|BPF_X:	return BFO_JGT_X;
+	case BPF_JMP|BPF_JGE|BPF_X:	return BFO_JGE_X;
+	case BPF_JMP|BPF_JEQ|BPF_X:	return BFO_JEQ_X;
+	case BPF_JMP|BPF_JSET|BPF_X:	return BFO_JSET_X;
+	case BPF_ALU|BPF_ADD|BPF_X:	return BFO_ADD_X;
+	case BPF_ALU|BPF_SUB|BPF_X:	return BFO_SUB_X;
+	case BPF_ALU|BPF_MUL|BPF_X:	return BFO_MUL_X;
+	case BPF_ALU|BPF_DIV|BPF_X:	return BFO_DIV_X;
+	case BPF_ALU|BPF_MOD|BPF_X:	return BFO_MOD_X;
+	case BPF_ALU|BPF_AND|BPF_X:	return BFO_AND_X;
+	case BPF_ALU|BPF_OR|BPF_X:	return BFO_OR_X;
+	case BPF_ALU|BPF_XOR|BPF_X:	return BFO_XOR_X;
+	case BPF_ALU|BPF_LSH|BPF_X:	return BFO_LSH_X;
+	case BPF_ALU|BPF_RSH|BPF_X:	return BFO_RSH_X;
+	case BPF_ALU|BPF_ADD|BPF_K:	return BFO_ADD_K;
+	case BPF_ALU|BPF_SUB|BPF_K:	return BFO_SUB_K;
+	case BPF_ALU|BPF_MUL|BPF_K:	return BFO_MUL_K;
+	case BPF_ALU|BPF_DIV|BPF_K:	return BFO_DIV_K;
+	case BPF_ALU|BPF_MOD|BPF_K:	return BFO_MOD_K;
+	case BPF_ALU|BPF_AND|BPF_K:	return BFO_AND_K;
+	case BPF_ALU|BPF_OR|BPF_K:	return BFO_OR_K;
+	case BPF_ALU|BPF_XOR|BPF_K:	return BFO_XOR_K;
+	case BPF_ALU|BPF_LSH|BPF_K:	return BFO_LSH_K;
+	case BPF_ALU|BPF_RSH|BPF_K:	return BFO_RSH_K;
+	case BPF_ALU|BPF_NEG:		return BFO_NEG;
+	case BPF_MISC|BPF_TAX:		return BFO_TAX;
+	case BPF_MISC|BPF_TXA:		return BFO_TXA;
+	default:			return BFO_INVALID;
+	}
+}
+
+/*
+ * Translate a program into its pre-decoded form.  Returns NULL if the
+ * program is not valid, if it uses an opcode that can't be translated,
+ * or if we run out of memory; the caller then has to fall back on
+ * bpf_filter().
+ */
+struct bpf_fast_program *
+bpf_fast_compile(const struct bpf_insn *f, u_int len)
+{
+	struct bpf_fast_program *prog;
+	struct bpf_fast_insn *fi;
+	const struct bpf_insn *p;
+	uint64_t end, abs_len;
+	u_int i;
+
+	/*
+	 * The size check is only there to keep the size computation
+	 * below from overflowing; real programs are much smaller.
+	 */
+	if (f == NULL || len > 0xffffff || !bpf_validate(f, (int)len))
+		return NULL;
+	prog = (struct bpf_fast_program *)malloc(sizeof(*prog) +
+	    2 * len * sizeof(struct bpf_fast_insn));
+	if (prog == NULL)
+		return NULL;
+	prog->len = len;
+	prog->checked = (struct bpf_fast_insn *)(prog + 1);
+	prog->nocheck = prog->checked + len;
+
+	abs_len = 0;
+	for (i = 0; i < len; i++) {
+		p = &f[i];
+		fi = &prog->checked[i];
+		fi->op = bpf_fast_decode(p->code);
+		if (fi->op == BFO_INVALID) {
+			free(prog);
+			return NULL;
+		}
+		fi->k = p->k;
+		fi->k2 = 0;
+		fi->jt = fi->jf = NULL;
+
+		/*
+		 * bpf_validate() has made sure that all jump targets
+		 * are within the program.
+		 */
+		if (fi->op == BFO_JA)
+			fi->jt = &prog->checked[i + 1 + (bpf_int32)p->k];
+		else if (BPF_CLASS(p->code) == BPF_JMP) {
+			fi->jt = &prog->checked[i + 1 + p->jt];
+			fi->jf = &prog->checked[i + 1 + p->jf];
+		}
+
+		switch (fi->op) {
+
+		case BFO_LD_W_ABS:
+			end = (uint64_t)p->k + 4;
+			break;
+
+		case BFO_LD_H_ABS:
+			end = (uint64_t)p->k + 2;
+			break;
+
+		case BFO_LD_B_ABS:
+		case BFO_LDX_MSH_B:
+			end = (uint64_t)p->k + 1;
+			break;
+
+		default:
+			continue;
+		}
+		if (end > abs_len)
+			abs_len = end;
+
+		/*
+		 * Fuse a load that is followed by a comparison with a
+		 * constant.  The comparison stays in place, in case
+		 * something else jumps to it.
+		 */
+		if (i + 1 < len && fi->op != BFO_LDX_MSH_B &&
+		    (p[1].code == (BPF_JMP|BPF_JEQ|BPF_K) ||
+		    (p[1].code == (BPF_JMP|BPF_JSET|BPF_K) &&
+		    fi->op == BFO_LD_B_ABS))) {
+			if (p[1].code == (BPF_JMP|BPF_JSET|BPF_K))
+				fi->op = BFO_LD_B_ABS_JSET;
+			else
+				fi->op += BFO_LD_W_ABS_JEQ - BFO_LD_W_ABS;
+			fi->k2 = p[1].k;
+			fi->jt = &prog->checked[i + 2 + p[1].jt];
+			fi->jf = &prog->checked[i + 2 + p[1].jf];
+		}
+	}
+
+	/*
+	 * If some absolute load is beyond what any buffer can hold, every
+	 * packet takes the checked path.
+	 */
+	if (abs_len > 0xffffffffU)
+		abs_len = 0xffffffffU;
+	prog->abs_len = (u_int)abs_len;
+
+	for (i = 0; i < len; i++) {
+		fi = &prog->nocheck[i];
+		*fi = prog->checked[i];
+		if (fi->op >= BFO_LD_W_ABS && fi->op < BFO_LD_W_ABS_NC)
+			fi->op += BFO_NOCHECK;
+		if (fi->jt != NULL)
+			fi->jt += len;
+		if (fi->jf != NULL)
+			fi->jf += len;
+	}
+	return prog;
+}
+
+void
+bpf_fast_free(struct bpf_fast_program *prog)
+{
+	free(prog);
+}
+
+#if defined(__GNUC__)
+#define BFO_THREADED
+#endif
+
+#ifdef BFO_THREADED
+#define BFO_DISPATCH()	goto *bfo_labels[pc->op]
+#define BFO_BEGIN()	BFO_DISPATCH();
+#define BFO_END()
+#define BFO_CASE(op)	bfo_##op
+#else
+#define BFO_DISPATCH()	continue
+#define BFO_BEGIN()	for (;;) switch (pc->op) {
+#define BFO_END()	default: abort(); }
+#define BFO_CASE(op)	case BFO_##op
+#endif
+#define BFO_NEXT()	++pc; BFO_DISPATCH()
+#define BFO_JUMP(cond)	pc = (cond) ? pc->jt : pc->jf; BFO_DISPATCH()
+
+/*
+ * Run a pre-decoded program on the packet p; the arguments and the
+ * result are those of bpf_filter().
+ */
+u_int
+bpf_fast_filter(const struct bpf_fast_program *prog, const u_char *p,
+    u_int wirelen, u_int buflen)
+{
+	register const struct bpf_fast_insn *pc;
+	register u_int32 A, X;
+	register bpf_u_int32 k;
+	u_int32 mem[BPF_MEMWORDS];
+#ifdef BFO_THREADED
+	static const void *const bfo_labels[] = {
+#define BFO(op)	&&bfo_##op,
+		BPF_FAST_OPS
+#undef BFO
+	};
+#endif
+
+	A = 0;
+	X = 0;
+	pc = buflen >= prog->abs_len ? prog->nocheck : prog->checked;
+
+	BFO_BEGIN()
+
+	BFO_CASE(RET_K):
+		return (u_int)pc->k;
+
+	BFO_CASE(RET_A):
+		return (u_int)A;
+
+	BFO_CASE(LD_W_ABS):
+		k = pc->k;
+		if (k > buflen || sizeof(int32_t) > buflen - k)
+			return 0;
+		/* FALLTHROUGH */
+	BFO_CASE(LD_W_ABS_NC):
+		A = EXTRACT_LONG(&p[pc->k]);
+		BFO_NEXT();
+
+	BFO_CASE(LD_H_ABS):
+		k = pc->k;
+		if (k > buflen || sizeof(int16_t) > buflen - k)
+			return 0;
+		/* FALLTHROUGH */
+	BFO_CASE(LD_H_ABS_NC):
+		A = EXTRACT_SHORT(&p[pc->k]);
+		BFO_NEXT();
+
+	BFO_CASE(LD_B_ABS):
+		if (pc->k >= buflen)
+			return 0;
+		/* FALLTHROUGH */
+	BFO_CASE(LD_B_ABS_NC):
+		A = p[pc->k];
+		BFO_NEXT();
+
+	BFO_CASE(LDX_MSH_B):
+		if (pc->k >= buflen)
+			return 0;
+		/* FALLTHROUGH */
+	BFO_CASE(LDX_MSH_B_NC):
+		X = (p[pc->k] & 0xf) << 2;
+		BFO_NEXT();
+
+	BFO_CASE(LD_W_ABS_JEQ):
+		k = pc->k;
+		if (k > buflen || sizeof(int32_t) > buflen - k)
+			return 0;
+		/* FALLTHROUGH */
+	BFO_CASE(LD_W_ABS_JEQ_NC):
+		A = EXTRACT_LONG(&p[pc->k]);
+		BFO_JUMP(A == pc->k2);
+
+	BFO_CASE(LD_H_ABS_JEQ):
+		k = pc->k;
+		if (k > buflen || sizeof(int16_t) > buflen - k)
+			return 0;
+		/* FALLTHROUGH */
+	BFO_CASE(LD_H_ABS_JEQ_NC):
+		A = EXTRACT_SHORT(&p[pc->k]);
+		BFO_JUMP(A == pc->k2);
+
+	BFO_CASE(LD_B_ABS_JEQ):
+		if (pc->k >= buflen)
+			return 0;
+		/* FALLTHROUGH */
+	BFO_CASE(LD_B_ABS_JEQ_NC):
+		A = p[pc->k];
+		BFO_JUMP(A == pc->k2);
+
+	BFO_CASE(LD_B_ABS_JSET):
+		if (pc->k >= buflen)
+			return 0;
+		/* FALLTHROUGH */
+	BFO_CASE(LD_B_ABS_JSET_NC):
+		A = p[pc->k];
+		BFO_JUMP(A & pc->k2);
+
+	BFO_CASE(LD_W_IND):
+		k = X + pc->k;
+		if (pc->k > buflen || X > buflen - pc->k ||
+		    sizeof(int32_t) > buflen - k)
+			return 0;
+		A = EXTRACT_LONG(&p[k]);
+		BFO_NEXT();
+
+	BFO_CASE(LD_H_IND):
+		k = X + pc->k;
+		if (X > buflen || pc->k > buflen - X ||
+		    sizeof(int16_t) > buflen - k)
+			return 0;
+		A = EXTRACT_SHORT(&p[k]);
+		BFO_NEXT();
+
+	BFO_CASE(LD_B_IND):
+		k = X + pc->k;
+		if (pc->k >= buflen || X >= buflen - pc->k)
+			return 0;
+		A = p[k];
+		BFO_NEXT();
+
+	BFO_CASE(LD_W_LEN):
+		A = wirelen;
+		BFO_NEXT();
+
+	BFO_CASE(LDX_W_LEN):
+		X = wirelen;
+		BFO_NEXT();
+
+	BFO_CASE(LD_IMM):
+		A = pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(LDX_IMM):
+		X = pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(LD_MEM):
+		A = mem[pc->k];
+		BFO_NEXT();
+
+	BFO_CASE(LDX_MEM):
+		X = mem[pc->k];
+		BFO_NEXT();
+
+	BFO_CASE(ST):
+		mem[pc->k] = A;
+		BFO_NEXT();
+
+	BFO_CASE(STX):
+		mem[pc->k] = X;
+		BFO_NEXT();
+
+	BFO_CASE(JA):
+		pc = pc->jt;
+		BFO_DISPATCH();
+
+	BFO_CASE(JGT_K):
+		BFO_JUMP(A > pc->k);
+
+	BFO_CASE(JGE_K):
+		BFO_JUMP(A >= pc->k);
+
+	BFO_CASE(JEQ_K):
+		BFO_JUMP(A == pc->k);
+
+	BFO_CASE(JSET_K):
+		BFO_JUMP(A & pc->k);
+
+	BFO_CASE(JGT_X):
+		BFO_JUMP(A > X);
+
+	BFO_CASE(JGE_X):
+		BFO_JUMP(A >= X);
+
+	BFO_CASE(JEQ_X):
+		BFO_JUMP(A == X);
+
+	BFO_CASE(JSET_X):
+		BFO_JUMP(A & X);
+
+	BFO_CASE(ADD_X):
+		A += X;
+		BFO_NEXT();
+
+	BFO_CASE(SUB_X):
+		A -= X;
+		BFO_NEXT();
+
+	BFO_CASE(MUL_X):
+		A *= X;
+		BFO_NEXT();
+
+	BFO_CASE(DIV_X):
+		if (X == 0)
+			return 0;
+		A /= X;
+		BFO_NEXT();
+
+	BFO_CASE(MOD_X):
+		if (X == 0)
+			return 0;
+		A %= X;
+		BFO_NEXT();
+
+	BFO_CASE(AND_X):
+		A &= X;
+		BFO_NEXT();
+
+	BFO_CASE(OR_X):
+		A |= X;
+		BFO_NEXT();
+
+	BFO_CASE(XOR_X):
+		A ^= X;
+		BFO_NEXT();
+
+	BFO_CASE(LSH_X):
+		if (X < 32)
+			A <<= X;
+		else
+			A = 0;
+		BFO_NEXT();
+
+	BFO_CASE(RSH_X):
+		if (X < 32)
+			A >>= X;
+		else
+			A = 0;
+		BFO_NEXT();
+
+	BFO_CASE(ADD_K):
+		A += pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(SUB_K):
+		A -= pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(MUL_K):
+		A *= pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(DIV_K):
+		A /= pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(MOD_K):
+		A %= pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(AND_K):
+		A &= pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(OR_K):
+		A |= pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(XOR_K):
+		A ^= pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(LSH_K):
+		A <<= pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(RSH_K):
+		A >>= pc->k;
+		BFO_NEXT();
+
+	BFO_CASE(NEG):
+		A = (0U - A);
+		BFO_NEXT();
+
+	BFO_CASE(TAX):
+		X = A;
+		BFO_NEXT();
+
+	BFO_CASE(TXA):
+		A = X;
+		BFO_NEXT();
+
+	BFO_END()
+}
+
 
 /*
  * Return true if the 'fcode' is a valid filter program.
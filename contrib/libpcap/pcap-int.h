@@ -247,6 +247,12 @@ struct pcap {
 	 */
 	struct bpf_program fcode;
 
+	/*
+	 * Pre-decoded form of fcode, for savefiles; NULL if fcode
+	 * couldn't be translated.
+	 */
+	struct bpf_fast_program *fast_fcode;
+
 	char errbuf[PCAP_ERRBUF_SIZE + 1];
 	int dlt_count;
 	u_int *dlt_list;
@@ -509,6 +515,18 @@ struct bpf_aux_data {
 u_int	bpf_filter_with_aux_data(const struct bpf_insn *,
     const u_char *, u_int, u_int, const struct bpf_aux_data *);
 
+/*
+ * Filter programs translated into a form that is faster to interpret,
+ * for filtering large numbers of packets in userland.
+ * bpf_fast_compile() returns NULL if the program can't be translated,
+ * in which case bpf_filter() has to be used.
+ */
+struct bpf_fast_program;
+struct bpf_fast_program *bpf_fast_compile(const struct bpf_insn *, u_int);
+u_int	bpf_fast_filter(const struct bpf_fast_program *, const u_char *,
+    u_int, u_int);
+void	bpf_fast_free(struct bpf_fast_program *);
+
 /*
  * Internal interfaces for both "pcap_create()" and routines that
  * open savefiles.
@@ -237,6 +237,20 @@ sf_setdirection(pcap_t *p, pcap_direction_t d _U_)
 	return (-1);
 }
 
+/*
+ * Install the filter, and translate it for bpf_fast_filter(); as
+ * savefiles are filtered in userland, that's worth doing once.
+ */
+static int
+sf_setfilter(pcap_t *p, struct bpf_program *fp)
+{
+	if (install_bpf_program(p, fp) < 0)
+		return (-1);
+	bpf_fast_free(p->fast_fcode);
+	p->fast_fcode = bpf_fast_compile(p->fcode.bf_insns, p->fcode.bf_len);
+	return (0);
+}
+
 void
 sf_cleanup(pcap_t *p)
 {
@@ -245,6 +259,8 @@ sf_cleanup(pcap_t *p)
 	if (p->buffer != NULL)
 		free(p->buffer);
 	pcap_freecode(&p->fcode);
+	bpf_fast_free(p->fast_fcode);
+	p->fast_fcode = NULL;
 }
 
 pcap_t *
@@ -288,6 +304,12 @@ pcap_open_offline_with_tstamp_precision(const char *fname, u_int precision,
 	if (p == NULL) {
 		if (fp != stdin)
 			fclose(fp);
+	} else if (fp != stdin) {
+		/*
+		 * We opened the file, so nobody else looks at the
+		 * stream; it can be read through a mapping.
+		 */
+		pcap_map_savefile(p);
 	}
 	return (p);
 }
@@ -443,7 +465,7 @@ pcap_fopen_offline_with_tstamp_precision(FILE *fp, u_int precision,
 
 	p->read_op = pcap_offline_read;
 	p->inject_op = sf_inject;
-	p->setfilter_op = install_bpf_program;
+	p->setfilter_op = sf_setfilter;
 	p->setdirection_op = sf_setdirection;
 	p->set_datalink_op = NULL;	/* we don't support munging link-layer headers */
 	p->getnonblock_op = sf_getnonblock;
@@ -531,7 +553,9 @@ pcap_offline_read(pcap_t *p, int cnt, pcap_handler callback, u_char *user)
 		}
 
 		if ((fcode = p->fcode.bf_insns) == NULL ||
-		    bpf_filter(fcode, data, h.len, h.caplen)) {
+		    (p->fast_fcode != NULL ?
+		    bpf_fast_filter(p->fast_fcode, data, h.len, h.caplen) :
+		    bpf_filter(fcode, data, h.len, h.caplen))) {
 			(*callback)(user, &h, data);
 			if (++n >= cnt && cnt > 0)
 				break;
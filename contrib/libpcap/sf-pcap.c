@@ -38,6 +38,12 @@
 #include <fcntl.h>
 #endif /* _WIN32 */
 
+#if !defined(_WIN32) && !defined(MSDOS)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define SF_USE_MMAP
+#endif
+
 #include <errno.h>
 #include <memory.h>
 #include <stdio.h>
@@ -143,8 +149,20 @@ struct pcap_sf {
 	size_t hdrsize;
 	swapped_type_t lengths_swapped;
 	tstamp_scale_type_t scale_type;
+#ifdef SF_USE_MMAP
+	u_char *map;		/* the whole file, if it's mapped */
+	size_t mapsize;
+	size_t mapoff;		/* offset of the next record in map */
+#endif
 };
 
+#ifdef SF_USE_MMAP
+static int sf_pcap_next_mapped(pcap_t *p, struct pcap_pkthdr *hdr,
+    u_char **datap);
+static int sf_pcap_unmap(pcap_t *p);
+static void sf_pcap_cleanup(pcap_t *p);
+#endif
+
 /*
  * Check whether this is a pcap savefile and, if it is, extract the
  * relevant information from the header.
@@ -410,11 +428,115 @@ pcap_check_header(const uint8_t *magic, FILE *fp, u_int precision, char *errbuf,
 		return (NULL);
 	}
 
+#ifdef SF_USE_MMAP
+	p->cleanup_op = sf_pcap_cleanup;
+#else
 	p->cleanup_op = sf_cleanup;
+#endif
 
 	return (p);
 }
 
+/*
+ * Map a savefile that pcap_open_offline() opened, if it's a regular
+ * file in pcap format, so that records can be handed out without being
+ * copied.  This isn't done for a stream handed to pcap_fopen_offline(),
+ * as the caller might look at its offset, which doesn't move while
+ * records come from the mapping.  A file that's truncated while it's
+ * being read gets the process a SIGBUS.  The mapping is private and
+ * writable, as swap_pseudo_headers() modifies packet data in place.
+ * The stream has to be seekable, so that we can continue with stdio
+ * where the mapping ends; anything that goes wrong just leaves us
+ * reading with stdio.
+ */
+void
+pcap_map_savefile(pcap_t *p)
+{
+#ifdef SF_USE_MMAP
+	struct pcap_sf *ps = p->priv;
+	FILE *fp = p->rfile;
+	struct stat st;
+	off_t off;
+	void *map;
+
+	if (p->next_packet_op != pcap_next_packet || ps->map != NULL)
+		return;
+	if (fstat(fileno(fp), &st) < 0 || !S_ISREG(st.st_mode))
+		return;
+	off = ftello(fp);
+	if (off < 0 || st.st_size <= off ||
+	    (uintmax_t)st.st_size > (uintmax_t)SIZE_MAX ||
+	    fseeko(fp, off, SEEK_SET) < 0)
+		return;
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ|PROT_WRITE,
+	    MAP_PRIVATE, fileno(fp), 0);
+	if (map == MAP_FAILED)
+		return;
+#ifdef MADV_SEQUENTIAL
+	(void)madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+	ps->map = map;
+	ps->mapsize = (size_t)st.st_size;
+	ps->mapoff = (size_t)off;
+	p->next_packet_op = sf_pcap_next_mapped;
+#else
+	(void)p;
+#endif
+}
+
+#ifdef SF_USE_MMAP
+/*
+ * Read a record while the file is mapped.  Once we stop, at the end of
+ * the file or on an error, leave the stream where stdio would have.
+ */
+static int
+sf_pcap_next_mapped(pcap_t *p, struct pcap_pkthdr *hdr, u_char **data)
+{
+	int status;
+
+	status = pcap_next_packet(p, hdr, data);
+	if (status != 0)
+		(void)sf_pcap_unmap(p);
+	return (status);
+}
+
+/*
+ * Stop using the mapping, and continue reading at the same place with
+ * stdio; that's how we get at data that was appended to the file after
+ * it was mapped.  If we can't seek (as in capability mode, where the
+ * descriptor might only be allowed to read), keep the mapping, and
+ * return -1; the file then ends where the mapping does.
+ */
+static int
+sf_pcap_unmap(pcap_t *p)
+{
+	struct pcap_sf *ps = p->priv;
+
+	if (ps->map == NULL)
+		return (0);
+	if (p->rfile != NULL &&
+	    fseeko(p->rfile, (off_t)ps->mapoff, SEEK_SET) < 0)
+		return (-1);
+	(void)munmap(ps->map, ps->mapsize);
+	ps->map = NULL;
+	ps->mapsize = 0;
+	ps->mapoff = 0;
+	return (0);
+}
+
+static void
+sf_pcap_cleanup(pcap_t *p)
+{
+	struct pcap_sf *ps = p->priv;
+
+	if (ps->map != NULL) {
+		(void)munmap(ps->map, ps->mapsize);
+		ps->map = NULL;
+	}
+	sf_cleanup(p);
+}
+#endif /* SF_USE_MMAP */
+
 /*
  * Grow the packet buffer to the specified size.
  */
@@ -454,6 +576,17 @@ pcap_next_packet(pcap_t *p, struct pcap_pkthdr *hdr, u_char **data)
 	 * unpatched libpcap we only read as many bytes as the regular
 	 * header has.
 	 */
+#ifdef SF_USE_MMAP
+	if (ps->map != NULL && ps->mapsize - ps->mapoff < ps->hdrsize &&
+	    sf_pcap_unmap(p) < 0) {
+		amt_read = ps->mapsize - ps->mapoff;
+		ps->mapoff = ps->mapsize;
+	} else if (ps->map != NULL) {
+		memcpy(&sf_hdr, ps->map + ps->mapoff, ps->hdrsize);
+		ps->mapoff += ps->hdrsize;
+		amt_read = ps->hdrsize;
+	} else
+#endif
 	amt_read = fread(&sf_hdr, 1, ps->hdrsize, fp);
 	if (amt_read != ps->hdrsize) {
 		if (ferror(fp)) {
@@ -558,6 +691,32 @@ pcap_next_packet(pcap_t *p, struct pcap_pkthdr *hdr, u_char **data)
 		return (-1);
 	}
 
+#ifdef SF_USE_MMAP
+	if (ps->map != NULL) {
+		if (ps->mapsize - ps->mapoff >= hdr->caplen) {
+			/*
+			 * The whole record is in the mapping; hand it out
+			 * from there, cut off at the snapshot length (see
+			 * below).
+			 */
+			*data = ps->map + ps->mapoff;
+			ps->mapoff += hdr->caplen;
+			if (hdr->caplen > (bpf_u_int32)p->snapshot)
+				hdr->caplen = p->snapshot;
+			if (p->swapped)
+				swap_pseudo_headers(p->linktype, hdr, *data);
+			return (0);
+		}
+		if (sf_pcap_unmap(p) < 0) {
+			pcap_snprintf(p->errbuf, PCAP_ERRBUF_SIZE,
+			    "truncated dump file; tried to read %u captured bytes, only got %" PRIsize,
+			    hdr->caplen, ps->mapsize - ps->mapoff);
+			ps->mapoff = ps->mapsize;
+			return (-1);
+		}
+	}
+#endif
+
 	if (hdr->caplen > (bpf_u_int32)p->snapshot) {
 		/*
 		 * The packet is bigger than the snapshot length
@@ -33,5 +33,6 @@
 
 extern pcap_t *pcap_check_header(const uint8_t *magic, FILE *fp,
     u_int precision, char *errbuf, int *err);
+extern void pcap_map_savefile(pcap_t *p);
 
 #endif
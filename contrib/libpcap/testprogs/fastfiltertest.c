@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2026 The HardenedBSD Project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code distributions
+ * retain the above copyright notice and this paragraph in its entirety, (2)
+ * distributions including binary code include the above copyright notice and
+ * this paragraph in its entirety in the documentation or other materials
+ * provided with the distribution, and (3) all advertising materials mentioning
+ * features or use of this software display the following acknowledgement:
+ * ``This product includes software developed by the University of California,
+ * Lawrence Berkeley Laboratory and its contributors.'' Neither the name of
+ * the University nor the names of its contributors may be used to endorse
+ * or promote products derived from this software without specific prior
+ * written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Check that the pre-decoded filter interpreter used for savefiles gives
+ * the same result as bpf_filter(), for every packet and for every
+ * truncation of every packet.  The packets come from a savefile, or are
+ * made up: random bytes, with the constants the program compares with
+ * written at the offsets it loads them from, so that the deeper parts of
+ * the program are reached as well.
+ */
+
+#include "varattrs.h"
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pcap.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#ifdef _WIN32
+  #include "getopt.h"
+  #include "unix.h"
+#else
+  #include <unistd.h>
+#endif
+
+#include "pcap/funcattrs.h"
+
+/*
+ * Internal interfaces of libpcap, from pcap-int.h.
+ */
+struct bpf_fast_program;
+struct bpf_fast_program *bpf_fast_compile(const struct bpf_insn *, u_int);
+u_int	bpf_fast_filter(const struct bpf_fast_program *, const u_char *,
+    u_int, u_int);
+void	bpf_fast_free(struct bpf_fast_program *);
+
+static char *program_name;
+static u_long mismatches;
+
+/* Forwards */
+static void PCAP_NORETURN usage(void);
+static void PCAP_NORETURN error(const char *, ...) PCAP_PRINTFLIKE(1, 2);
+
+/*
+ * Run both interpreters on the packet, and on all its truncations.
+ */
+static void
+check(const struct bpf_program *fcode, const struct bpf_fast_program *fp,
+    const u_char *pkt, u_int wirelen, u_int caplen, u_long pktno)
+{
+	u_int buflen, ref, fast;
+
+	for (buflen = 0; buflen <= caplen; buflen++) {
+		ref = bpf_filter(fcode->bf_insns, pkt, wirelen, buflen);
+		fast = bpf_fast_filter(fp, pkt, wirelen, buflen);
+		if (ref != fast) {
+			if (mismatches++ < 10)
+				fprintf(stderr, "packet %lu, %u of %u bytes: "
+				    "bpf_filter %u, bpf_fast_filter %u\n",
+				    pktno, buflen, wirelen, ref, fast);
+		}
+	}
+}
+
+/*
+ * Make up a packet for the program.
+ */
+static void
+make_packet(const struct bpf_program *fcode, u_char *pkt, u_int len)
+{
+	const struct bpf_insn *p, *next;
+	u_int i, k;
+
+	for (i = 0; i < len; i++)
+		pkt[i] = (u_char)random();
+	for (i = 0; i + 1 < fcode->bf_len; i++) {
+		p = &fcode->bf_insns[i];
+		next = p + 1;
+		if (BPF_CLASS(p->code) != BPF_LD ||
+		    BPF_MODE(p->code) != BPF_ABS ||
+		    BPF_CLASS(next->code) != BPF_JMP ||
+		    BPF_SRC(next->code) != BPF_K || random() % 4 == 0)
+			continue;
+		k = next->k;
+		switch (BPF_SIZE(p->code)) {
+
+		case BPF_W:
+			if (p->k < len && len - p->k >= 4) {
+				pkt[p->k] = (u_char)(k >> 24);
+				pkt[p->k + 1] = (u_char)(k >> 16);
+				pkt[p->k + 2] = (u_char)(k >> 8);
+				pkt[p->k + 3] = (u_char)k;
+			}
+			break;
+
+		case BPF_H:
+			if (p->k < len && len - p->k >= 2) {
+				pkt[p->k] = (u_char)(k >> 8);
+				pkt[p->k + 1] = (u_char)k;
+			}
+			break;
+
+		case BPF_B:
+			if (p->k < len)
+				pkt[p->k] = (u_char)k;
+			break;
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	char *cp, *infile = NULL;
+	int op, dlt, Oflag = 1;
+	int snaplen = 256;
+	u_long count = 10000, n;
+	char *p;
+	char errbuf[PCAP_ERRBUF_SIZE];
+	pcap_t *pd;
+	struct bpf_program fcode;
+	struct bpf_fast_program *fp;
+	struct pcap_pkthdr *h;
+	const u_char *data;
+	u_char *pkt;
+
+	if ((cp = strrchr(argv[0], '/')) != NULL)
+		program_name = cp + 1;
+	else
+		program_name = argv[0];
+
+	while ((op = getopt(argc, argv, "n:Or:")) != -1) {
+		switch (op) {
+
+		case 'n':
+			count = strtoul(optarg, &p, 10);
+			if (p == optarg || *p != '\0')
+				error("invalid packet count %s", optarg);
+			break;
+
+		case 'O':
+			Oflag = 0;
+			break;
+
+		case 'r':
+			infile = optarg;
+			break;
+
+		default:
+			usage();
+			/* NOTREACHED */
+		}
+	}
+
+	if (infile != NULL) {
+		if (optind + 1 != argc)
+			usage();
+		pd = pcap_open_offline(infile, errbuf);
+		if (pd == NULL)
+			error("%s", errbuf);
+	} else {
+		if (optind + 2 != argc)
+			usage();
+		dlt = pcap_datalink_name_to_val(argv[optind]);
+		if (dlt < 0) {
+			dlt = (int)strtol(argv[optind], &p, 10);
+			if (p == argv[optind] || *p != '\0')
+				error("invalid data link type %s",
+				    argv[optind]);
+		}
+		pd = pcap_open_dead(dlt, snaplen);
+		if (pd == NULL)
+			error("Can't open fake pcap_t");
+	}
+
+	if (pcap_compile(pd, &fcode, argv[argc - 1], Oflag,
+	    PCAP_NETMASK_UNKNOWN) < 0)
+		error("%s", pcap_geterr(pd));
+	fp = bpf_fast_compile(fcode.bf_insns, fcode.bf_len);
+	if (fp == NULL)
+		error("Can't translate the filter");
+
+	if (infile != NULL) {
+		n = 0;
+		while (pcap_next_ex(pd, &h, &data) == 1)
+			check(&fcode, fp, data, h->len, h->caplen, n++);
+		printf("%lu packets", n);
+	} else {
+		pkt = (u_char *)malloc(snaplen);
+		if (pkt == NULL)
+			error("malloc");
+		srandom(1);
+		for (n = 0; n < count; n++) {
+			make_packet(&fcode, pkt, snaplen);
+			check(&fcode, fp, pkt, snaplen, snaplen, n);
+		}
+		free(pkt);
+		printf("%lu made-up packets", count);
+	}
+	printf(", %lu mismatches\n", mismatches);
+
+	bpf_fast_free(fp);
+	pcap_freecode(&fcode);
+	pcap_close(pd);
+	exit(mismatches != 0);
+}
+
+/* VARARGS */
+static void
+error(const char *fmt, ...)
+{
+	va_list ap;
+
+	(void)fprintf(stderr, "%s: ", program_name);
+	va_start(ap, fmt);
+	(void)vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	if (*fmt) {
+		fmt += strlen(fmt);
+		if (fmt[-1] != '\n')
+			(void)fputc('\n', stderr);
+	}
+	exit(1);
+	/* NOTREACHED */
+}
+
+static void
+usage(void)
+{
+	(void)fprintf(stderr, "%s, with %s\n", program_name,
+	    pcap_lib_version());
+	(void)fprintf(stderr,
+	    "Usage: %s [-O] [ -n count ] dlt expression\n"
+	    "       %s [-O] -r file expression\n",
+	    program_name, program_name);
+	exit(1);
+}
@@ -15,30 +15,90 @@
 
 #include <iostream>
 
-#ifdef __linux__
+// Platforms without a native way to wait on an address park waiters on a
+// condition variable in the contention table instead.  Defining
+// _LIBCPP_ATOMIC_USE_PARKING_LOT selects this on any platform.
+#if !defined(_LIBCPP_ATOMIC_USE_PARKING_LOT) && !defined(__linux__) && \
+    !(defined(__APPLE__) && defined(_LIBCPP_USE_ULOCK))
+#define _LIBCPP_ATOMIC_USE_PARKING_LOT
+#endif
+
+#if defined(_LIBCPP_ATOMIC_USE_PARKING_LOT)
+
+#include <__threading_support>
+#include <chrono>
+
+#elif defined(__linux__)
 
 #include <unistd.h>
 #include <linux/futex.h>
 #include <sys/syscall.h>
 
-#else // <- Add other operating systems here
+#endif
 
-// Baseline needs no new headers
+_LIBCPP_BEGIN_NAMESPACE_STD
 
+static constexpr size_t __libcpp_contention_table_size = (1 << 8);  /* < there's no magic in this number */
+
+struct alignas(64) /*  aim to avoid false sharing */ __libcpp_contention_table_entry
+{
+    __cxx_atomic_contention_t __contention_state;
+    __cxx_atomic_contention_t __platform_state;
+#if defined(_LIBCPP_ATOMIC_USE_PARKING_LOT)
+    // Waiters on every location that hashes to this entry park here.
+    __libcpp_mutex_t __mutex = _LIBCPP_MUTEX_INITIALIZER;
+    __libcpp_condvar_t __condvar = _LIBCPP_CONDVAR_INITIALIZER;
 #endif
+    inline constexpr __libcpp_contention_table_entry() :
+        __contention_state(0), __platform_state(0) { }
+};
 
-_LIBCPP_BEGIN_NAMESPACE_STD
+#if defined(_LIBCPP_ATOMIC_USE_PARKING_LOT)
 
-#ifdef __linux__
+static void __libcpp_platform_wait_on_address(__libcpp_contention_table_entry* __entry,
+                                              __cxx_atomic_contention_t const volatile* __ptr,
+                                              __cxx_contention_t __val)
+{
+    using namespace chrono;
+    // Like the futex, give up after a while in case a wake was missed; the
+    // caller checks the value again.
+    nanoseconds __d = system_clock::now().time_since_epoch() + seconds(2);
+    __libcpp_timespec_t __ts;
+    seconds __s = duration_cast<seconds>(__d);
+    __ts.tv_sec = static_cast<decltype(__ts.tv_sec)>(__s.count());
+    __ts.tv_nsec = static_cast<decltype(__ts.tv_nsec)>((__d - __s).count());
 
-static void __libcpp_platform_wait_on_address(__cxx_atomic_contention_t const volatile* __ptr,
+    __libcpp_mutex_lock(&__entry->__mutex);
+    // A waker takes the mutex after changing the value, so it either sees
+    // us waiting or we see the new value here.
+    if (__cxx_nonatomic_compare_equal(__cxx_atomic_load(__ptr, memory_order_relaxed), __val))
+        __libcpp_condvar_timedwait(&__entry->__condvar, &__entry->__mutex, &__ts);
+    __libcpp_mutex_unlock(&__entry->__mutex);
+}
+
+static void __libcpp_platform_wake_by_address(__libcpp_contention_table_entry* __entry,
+                                              __cxx_atomic_contention_t const volatile*,
+                                              bool)
+{
+    // Other locations can share the entry, so even notify_one has to wake
+    // everyone; waiters whose value has not changed go back to sleep.
+    __libcpp_mutex_lock(&__entry->__mutex);
+    __libcpp_condvar_broadcast(&__entry->__condvar);
+    __libcpp_mutex_unlock(&__entry->__mutex);
+}
+
+#elif defined(__linux__)
+
+static void __libcpp_platform_wait_on_address(__libcpp_contention_table_entry*,
+                                              __cxx_atomic_contention_t const volatile* __ptr,
                                               __cxx_contention_t __val)
 {
     static constexpr timespec __timeout = { 2, 0 };
     syscall(SYS_futex, __ptr, FUTEX_WAIT_PRIVATE, __val, &__timeout, 0, 0);
 }
 
-static void __libcpp_platform_wake_by_address(__cxx_atomic_contention_t const volatile* __ptr,
+static void __libcpp_platform_wake_by_address(__libcpp_contention_table_entry*,
+                                              __cxx_atomic_contention_t const volatile* __ptr,
                                               bool __notify_one)
 {
     syscall(SYS_futex, __ptr, FUTEX_WAKE_PRIVATE, __notify_one ? 1 : INT_MAX, 0, 0, 0);
@@ -53,45 +113,23 @@ extern "C" int __ulock_wake(uint32_t operation, void *addr, uint64_t wake_value)
 #define UL_COMPARE_AND_WAIT				1
 #define ULF_WAKE_ALL					0x00000100
 
-static void __libcpp_platform_wait_on_address(__cxx_atomic_contention_t const volatile* __ptr,
+static void __libcpp_platform_wait_on_address(__libcpp_contention_table_entry*,
+                                              __cxx_atomic_contention_t const volatile* __ptr,
                                               __cxx_contention_t __val)
 {
     __ulock_wait(UL_COMPARE_AND_WAIT,
                  const_cast<__cxx_atomic_contention_t*>(__ptr), __val, 0);
 }
 
-static void __libcpp_platform_wake_by_address(__cxx_atomic_contention_t const volatile* __ptr,
+static void __libcpp_platform_wake_by_address(__libcpp_contention_table_entry*,
+                                              __cxx_atomic_contention_t const volatile* __ptr,
                                               bool __notify_one)
 {
     __ulock_wake(UL_COMPARE_AND_WAIT | (__notify_one ? 0 : ULF_WAKE_ALL),
                  const_cast<__cxx_atomic_contention_t*>(__ptr), 0);
 }
 
-#else // <- Add other operating systems here
-
-// Baseline is just a timed backoff
-
-static void __libcpp_platform_wait_on_address(__cxx_atomic_contention_t const volatile* __ptr,
-                                              __cxx_contention_t __val)
-{
-    __libcpp_thread_poll_with_backoff([=]() -> bool {
-        return !__cxx_nonatomic_compare_equal(__cxx_atomic_load(__ptr, memory_order_relaxed), __val);
-    }, __libcpp_timed_backoff_policy());
-}
-
-static void __libcpp_platform_wake_by_address(__cxx_atomic_contention_t const volatile*, bool) { }
-
-#endif // __linux__
-
-static constexpr size_t __libcpp_contention_table_size = (1 << 8);  /* < there's no magic in this number */
-
-struct alignas(64) /*  aim to avoid false sharing */ __libcpp_contention_table_entry
-{
-    __cxx_atomic_contention_t __contention_state;
-    __cxx_atomic_contention_t __platform_state;
-    inline constexpr __libcpp_contention_table_entry() :
-        __contention_state(0), __platform_state(0) { }
-};
+#endif // _LIBCPP_ATOMIC_USE_PARKING_LOT
 
 static __libcpp_contention_table_entry __libcpp_contention_table[ __libcpp_contention_table_size ];
 
@@ -105,13 +143,13 @@ static __libcpp_contention_table_entry* __libcpp_contention_state(void const vol
 /* Given an atomic to track contention and an atomic to actually wait on, which may be
    the same atomic, we try to detect contention to avoid spuriously calling the platform. */
 
-static void __libcpp_contention_notify(__cxx_atomic_contention_t volatile* __contention_state,
+static void __libcpp_contention_notify(__libcpp_contention_table_entry* __entry,
                                        __cxx_atomic_contention_t const volatile* __platform_state,
                                        bool __notify_one)
 {
-    if(0 != __cxx_atomic_load(__contention_state, memory_order_seq_cst))
+    if(0 != __cxx_atomic_load(&__entry->__contention_state, memory_order_seq_cst))
         // We only call 'wake' if we consumed a contention bit here.
-        __libcpp_platform_wake_by_address(__platform_state, __notify_one);
+        __libcpp_platform_wake_by_address(__entry, __platform_state, __notify_one);
 }
 static __cxx_contention_t __libcpp_contention_monitor_for_wait(__cxx_atomic_contention_t volatile* __contention_state,
                                                                __cxx_atomic_contention_t const volatile* __platform_state)
@@ -119,14 +157,14 @@ static __cxx_contention_t __libcpp_contention_monitor_for_wait(__cxx_atomic_cont
     // We will monitor this value.
     return __cxx_atomic_load(__platform_state, memory_order_acquire);
 }
-static void __libcpp_contention_wait(__cxx_atomic_contention_t volatile* __contention_state,
+static void __libcpp_contention_wait(__libcpp_contention_table_entry* __entry,
                                      __cxx_atomic_contention_t const volatile* __platform_state,
                                      __cxx_contention_t __old_value)
 {
-    __cxx_atomic_fetch_add(__contention_state, __cxx_contention_t(1), memory_order_seq_cst);
+    __cxx_atomic_fetch_add(&__entry->__contention_state, __cxx_contention_t(1), memory_order_seq_cst);
     // We sleep as long as the monitored value hasn't changed.
-    __libcpp_platform_wait_on_address(__platform_state, __old_value);
-    __cxx_atomic_fetch_sub(__contention_state, __cxx_contention_t(1), memory_order_release);
+    __libcpp_platform_wait_on_address(__entry, __platform_state, __old_value);
+    __cxx_atomic_fetch_sub(&__entry->__contention_state, __cxx_contention_t(1), memory_order_release);
 }
 
 /* When the incoming atomic is the wrong size for the platform wait size, need to
@@ -137,7 +175,7 @@ static void __libcpp_atomic_notify(void const volatile* __location)
     auto const __entry = __libcpp_contention_state(__location);
     // The value sequence laundering happens on the next line below.
     __cxx_atomic_fetch_add(&__entry->__platform_state, __cxx_contention_t(1), memory_order_release);
-    __libcpp_contention_notify(&__entry->__contention_state,
+    __libcpp_contention_notify(__entry,
                                &__entry->__platform_state,
                                false /* when laundering, we can't handle notify_one */);
 }
@@ -157,7 +195,7 @@ _LIBCPP_EXPORTED_FROM_ABI
 void __libcpp_atomic_wait(void const volatile* __location, __cxx_contention_t __old_value)
 {
     auto const __entry = __libcpp_contention_state(__location);
-    __libcpp_contention_wait(&__entry->__contention_state, &__entry->__platform_state, __old_value);
+    __libcpp_contention_wait(__entry, &__entry->__platform_state, __old_value);
 }
 
 /* When the incoming atomic happens to be the platform wait size, we still need to use the
@@ -166,12 +204,12 @@ void __libcpp_atomic_wait(void const volatile* __location, __cxx_contention_t __
 _LIBCPP_EXPORTED_FROM_ABI
 void __cxx_atomic_notify_one(__cxx_atomic_contention_t const volatile* __location)
 {
-    __libcpp_contention_notify(&__libcpp_contention_state(__location)->__contention_state, __location, true);
+    __libcpp_contention_notify(__libcpp_contention_state(__location), __location, true);
 }
 _LIBCPP_EXPORTED_FROM_ABI
 void __cxx_atomic_notify_all(__cxx_atomic_contention_t const volatile* __location)
 {
-    __libcpp_contention_notify(&__libcpp_contention_state(__location)->__contention_state, __location, false);
+    __libcpp_contention_notify(__libcpp_contention_state(__location), __location, false);
 }
 _LIBCPP_EXPORTED_FROM_ABI
 __cxx_contention_t __libcpp_atomic_monitor(__cxx_atomic_contention_t const volatile* __location)
@@ -181,7 +219,7 @@ __cxx_contention_t __libcpp_atomic_monitor(__cxx_atomic_contention_t const volat
 _LIBCPP_EXPORTED_FROM_ABI
 void __libcpp_atomic_wait(__cxx_atomic_contention_t const volatile* __location, __cxx_contention_t __old_value)
 {
-    __libcpp_contention_wait(&__libcpp_contention_state(__location)->__contention_state, __location, __old_value);
+    __libcpp_contention_wait(__libcpp_contention_state(__location), __location, __old_value);
 }
 
 _LIBCPP_END_NAMESPACE_STD
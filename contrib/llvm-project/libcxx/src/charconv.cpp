@@ -7,7 +7,14 @@
 //===----------------------------------------------------------------------===//
 
 #include "charconv"
+#include "cerrno"
+#include "cfloat"
+#include "cmath"
+#include "cstdlib"
+#include "locale"
+#include "new"
 #include <string.h>
+#include "include/charconv_tables.h"
 
 _LIBCPP_BEGIN_NAMESPACE_STD
 
@@ -157,4 +164,1235 @@ __u64toa(uint64_t value, char* buffer) _NOEXCEPT
 
 }  // namespace __itoa
 
+// Floating-point conversions.
+//
+// The shortest digits that round-trip a float or a double come from Ryu
+// (Ulf Adams, "Ryu: Fast Float-to-String Conversion", PLDI 2018); floats go
+// through the same 64-bit code as doubles.  Decimal input is converted with
+// Clinger's fast path where that is exact, and otherwise with the
+// Eisel-Lemire algorithm (Daniel Lemire, "Number Parsing at a Gigabyte per
+// Second", 2021).  What is left -- output with a precision, except for small
+// precisions in fixed notation, long double where it is wider than double,
+// and the rare inputs that Eisel-Lemire cannot decide -- goes to the C
+// library in the "C" locale.
+
+namespace
+{
+
+using namespace __fp_tables;
+
+template <class _Fp> struct float_traits;
+
+template <>
+struct float_traits<float>
+{
+    typedef uint32_t bits_type;
+    static constexpr int mantissa_bits = 23;
+    static constexpr int exponent_bits = 8;
+    static constexpr int exponent_bias = 127;
+};
+
+template <>
+struct float_traits<double>
+{
+    typedef uint64_t bits_type;
+    static constexpr int mantissa_bits = 52;
+    static constexpr int exponent_bits = 11;
+    static constexpr int exponent_bias = 1023;
+};
+
+// The fields of a float or a double.
+struct float_fields
+{
+    uint64_t mantissa;
+    uint32_t exponent;
+    bool negative;
+};
+
+template <class _Fp>
+inline float_fields
+decompose(_Fp value)
+{
+    typedef float_traits<_Fp> traits;
+    typename traits::bits_type bits;
+    memcpy(&bits, &value, sizeof(bits));
+    float_fields f;
+    f.mantissa = bits & ((uint64_t(1) << traits::mantissa_bits) - 1);
+    f.exponent = static_cast<uint32_t>(bits >> traits::mantissa_bits) &
+                 ((1u << traits::exponent_bits) - 1);
+    f.negative = (bits >> (traits::mantissa_bits + traits::exponent_bits)) != 0;
+    return f;
+}
+
+// Returns the low half of a * b, and the high half in hi.
+inline uint64_t
+umul128(uint64_t a, uint64_t b, uint64_t& hi)
+{
+#ifndef _LIBCPP_HAS_NO_INT128
+    __uint128_t p = static_cast<__uint128_t>(a) * b;
+    hi = static_cast<uint64_t>(p >> 64);
+    return static_cast<uint64_t>(p);
+#else
+    const uint64_t a_lo = static_cast<uint32_t>(a), a_hi = a >> 32;
+    const uint64_t b_lo = static_cast<uint32_t>(b), b_hi = b >> 32;
+    const uint64_t b00 = a_lo * b_lo, b01 = a_lo * b_hi;
+    const uint64_t b10 = a_hi * b_lo, b11 = a_hi * b_hi;
+    const uint64_t mid1 = b10 + (b00 >> 32);
+    const uint64_t mid2 = b01 + static_cast<uint32_t>(mid1);
+    hi = b11 + (mid1 >> 32) + (mid2 >> 32);
+    return (mid2 << 32) | static_cast<uint32_t>(b00);
+#endif
+}
+
+// Ryu.
+
+inline uint32_t
+pow5bits(int32_t e)
+{
+    return ((static_cast<uint32_t>(e) * 1217359) >> 19) + 1;
+}
+
+inline uint32_t
+log10_pow2(int32_t e)
+{
+    return (static_cast<uint32_t>(e) * 78913) >> 18;
+}
+
+inline uint32_t
+log10_pow5(int32_t e)
+{
+    return (static_cast<uint32_t>(e) * 732923) >> 20;
+}
+
+inline bool
+multiple_of_pow5(uint64_t value, uint32_t p)
+{
+    uint32_t count = 0;
+    for (; value % 5 == 0; value /= 5)
+        ++count;
+    return count >= p;
+}
+
+inline bool
+multiple_of_pow2(uint64_t value, uint32_t p)
+{
+    return (value & ((uint64_t(1) << p) - 1)) == 0;
+}
+
+// Returns (m * mul) >> j, where mul is a 128-bit multiplier and j > 64.
+inline uint64_t
+mul_shift(uint64_t m, const uint64_t* mul, int32_t j)
+{
+    uint64_t high0, high1;
+    umul128(m, mul[0], high0);
+    const uint64_t low1 = umul128(m, mul[1], high1);
+    const uint64_t sum = high0 + low1;
+    if (sum < high0)
+        ++high1;
+    const int32_t dist = j - 64;
+    if (dist == 0)
+        return sum;
+    if (dist >= 64)
+        return high1 >> (dist - 64);
+    return (high1 << (64 - dist)) | (sum >> dist);
+}
+
+// A decimal value of mantissa * 10^exponent.
+struct decimal
+{
+    uint64_t mantissa;
+    int32_t exponent;
+};
+
+// Returns the shortest decimal that rounds to the float or double with the
+// given fields, which must be finite and nonzero.  If there are several, it
+// is the one closest to the exact value.
+template <class _Fp>
+decimal
+shortest_decimal(const float_fields& f)
+{
+    typedef float_traits<_Fp> traits;
+
+    int32_t e2;
+    uint64_t m2;
+    if (f.exponent == 0) {
+        e2 = 1 - traits::exponent_bias - traits::mantissa_bits - 2;
+        m2 = f.mantissa;
+    } else {
+        e2 = static_cast<int32_t>(f.exponent) - traits::exponent_bias -
+             traits::mantissa_bits - 2;
+        m2 = (uint64_t(1) << traits::mantissa_bits) | f.mantissa;
+    }
+    const bool accept_bounds = (m2 & 1) == 0;
+
+    // The value and the halfway points to its neighbours, as multiples of
+    // 2^e2.
+    const uint64_t mv = 4 * m2;
+    const uint32_t mm_shift = f.mantissa != 0 || f.exponent <= 1;
+    const uint64_t mp = mv + 2;
+    const uint64_t mm = mv - 1 - mm_shift;
+
+    // Scale them by a power of ten, so that they become integers vr, vp
+    // and vm with the value about vr * 10^e10.
+    uint64_t vr, vp, vm;
+    int32_t e10;
+    bool vm_is_trailing_zeros = false;
+    bool vr_is_trailing_zeros = false;
+    if (e2 >= 0) {
+        const uint32_t q = log10_pow2(e2) - (e2 > 3);
+        e10 = static_cast<int32_t>(q);
+        const int32_t k = __pow5_inv_bitcount + static_cast<int32_t>(pow5bits(q)) - 1;
+        const int32_t i = -e2 + static_cast<int32_t>(q) + k;
+        vr = mul_shift(mv, __pow5_inv_split[q], i);
+        vp = mul_shift(mp, __pow5_inv_split[q], i);
+        vm = mul_shift(mm, __pow5_inv_split[q], i);
+        if (q <= 21) {
+            // Only one of mp, mv and mm can be a multiple of 5, if any.
+            if (mv % 5 == 0)
+                vr_is_trailing_zeros = multiple_of_pow5(mv, q);
+            else if (accept_bounds)
+                vm_is_trailing_zeros = multiple_of_pow5(mm, q);
+            else
+                vp -= multiple_of_pow5(mp, q);
+        }
+    } else {
+        const uint32_t q = log10_pow5(-e2) - (-e2 > 1);
+        e10 = static_cast<int32_t>(q) + e2;
+        const int32_t i = -e2 - static_cast<int32_t>(q);
+        const int32_t k = static_cast<int32_t>(pow5bits(i)) - __pow5_bitcount;
+        const int32_t j = static_cast<int32_t>(q) - k;
+        vr = mul_shift(mv, __pow5_split[i], j);
+        vp = mul_shift(mp, __pow5_split[i], j);
+        vm = mul_shift(mm, __pow5_split[i], j);
+        if (q <= 1) {
+            // mv has at least q trailing zero bits, since it is 4 * m2.
+            vr_is_trailing_zeros = true;
+            if (accept_bounds)
+                vm_is_trailing_zeros = mm_shift == 1;
+            else
+                --vp;
+        } else if (q < 63) {
+            vr_is_trailing_zeros = multiple_of_pow2(mv, q);
+        }
+    }
+
+    // Drop digits while vp and vm still differ, rounding vr to nearest.
+    int32_t removed = 0;
+    uint32_t last_removed_digit = 0;
+    uint64_t output;
+    if (vm_is_trailing_zeros || vr_is_trailing_zeros) {
+        // The rare case in which ties or the lower bound may be exact.
+        for (; vp / 10 > vm / 10; ++removed) {
+            vm_is_trailing_zeros &= vm % 10 == 0;
+            vr_is_trailing_zeros &= last_removed_digit == 0;
+            last_removed_digit = static_cast<uint32_t>(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+        }
+        if (vm_is_trailing_zeros) {
+            for (; vm % 10 == 0; ++removed) {
+                vr_is_trailing_zeros &= last_removed_digit == 0;
+                last_removed_digit = static_cast<uint32_t>(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+            }
+        }
+        // Round half to even.
+        if (vr_is_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0)
+            last_removed_digit = 4;
+        output = vr + ((vr == vm && (!accept_bounds || !vm_is_trailing_zeros)) ||
+                       last_removed_digit >= 5);
+    } else {
+        bool round_up = false;
+        if (vp / 100 > vm / 100) {
+            round_up = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        for (; vp / 10 > vm / 10; ++removed) {
+            round_up = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+
+    decimal d;
+    d.mantissa = output;
+    d.exponent = e10 + removed;
+    return d;
+}
+
+// Decimal output.
+
+// The significant digits of a value and where its decimal point goes: the
+// value is digits * 10^exponent.
+struct decimal_digits
+{
+    char digits[24];
+    int count;
+    int exponent;
+};
+
+// Output through the C library, in the "C" locale.  conv is a printf
+// conversion character.
+template <class _Fp>
+int
+c_print(char* buffer, size_t size, char conv, int precision, _Fp value)
+{
+    char format[] = "%.*Lx";
+    if (is_same<_Fp, long double>::value) {
+        format[4] = conv;
+    } else {
+        format[3] = conv;
+        format[4] = '\0';
+    }
+    return __libcpp_snprintf_l(buffer, size, _LIBCPP_GET_C_LOCALE, format,
+                               precision, value);
+}
+
+inline float
+c_strto(const char* s, float*)
+{
+    return strtof_l(s, nullptr, _LIBCPP_GET_C_LOCALE);
+}
+
+inline double
+c_strto(const char* s, double*)
+{
+    return strtod_l(s, nullptr, _LIBCPP_GET_C_LOCALE);
+}
+
+inline long double
+c_strto(const char* s, long double*)
+{
+    return strtold_l(s, nullptr, _LIBCPP_GET_C_LOCALE);
+}
+
+template <class _Fp>
+void
+shortest_digits(_Fp value, decimal_digits& d)
+{
+    decimal dec = shortest_decimal<_Fp>(decompose(value));
+    d.count = static_cast<int>(__itoa::__u64toa(dec.mantissa, d.digits) - d.digits);
+    d.exponent = dec.exponent;
+}
+
+#if LDBL_MANT_DIG != DBL_MANT_DIG
+// Where long double is wider than double, its shortest digits are found by
+// trying each precision in turn; value is positive.
+void
+shortest_digits(long double value, decimal_digits& d)
+{
+    char buffer[64];
+    int precision = 0;
+    for (; precision < numeric_limits<long double>::max_digits10 - 1; ++precision) {
+        c_print(buffer, sizeof(buffer), 'e', precision, value);
+        if (c_strto(buffer, static_cast<long double*>(nullptr)) == value)
+            break;
+    }
+    c_print(buffer, sizeof(buffer), 'e', precision, value);
+
+    // buffer is d[.ddd]e[+-]xx
+    const char* p = buffer;
+    d.count = 0;
+    for (; *p != 'e'; ++p)
+        if (*p != '.')
+            d.digits[d.count++] = *p;
+    while (d.count > 1 && d.digits[d.count - 1] == '0')
+        --d.count;
+    d.exponent = atoi(p + 1) - (d.count - 1);
+}
+#endif
+
+inline int
+fixed_length(const decimal_digits& d)
+{
+    if (d.exponent >= 0)
+        return d.count + d.exponent;
+    if (d.count + d.exponent > 0)
+        return d.count + 1;
+    return 2 - d.exponent;
+}
+
+inline char*
+write_fixed(char* p, const decimal_digits& d)
+{
+    const int n = d.count, e = d.exponent;
+    if (e >= 0) {
+        memcpy(p, d.digits, n);
+        memset(p + n, '0', e);
+        return p + n + e;
+    }
+    if (n + e > 0) {
+        memcpy(p, d.digits, n + e);
+        p += n + e;
+        *p++ = '.';
+        memcpy(p, d.digits + n + e, -e);
+        return p - e;
+    }
+    *p++ = '0';
+    *p++ = '.';
+    memset(p, '0', -(n + e));
+    p -= n + e;
+    memcpy(p, d.digits, n);
+    return p + n;
+}
+
+inline int
+scientific_length(const decimal_digits& d)
+{
+    int x = d.exponent + d.count - 1;
+    if (x < 0)
+        x = -x;
+    return d.count + (d.count > 1) + 2 + (x < 100 ? 2 : x < 1000 ? 3 : 4);
+}
+
+inline char*
+write_scientific(char* p, const decimal_digits& d)
+{
+    *p++ = d.digits[0];
+    if (d.count > 1) {
+        *p++ = '.';
+        memcpy(p, d.digits + 1, d.count - 1);
+        p += d.count - 1;
+    }
+    int x = d.exponent + d.count - 1;
+    *p++ = 'e';
+    if (x < 0) {
+        *p++ = '-';
+        x = -x;
+    } else {
+        *p++ = '+';
+    }
+    if (x >= 1000)
+        p = __itoa::append4(p, x);
+    else if (x >= 100)
+        p = __itoa::append3(p, x);
+    else
+        p = __itoa::append2(p, x);
+    return p;
+}
+
+// Whether the fixed notation of d, which has zeros appended, may differ from
+// the exact value, an integer.  It does not below 2^digits, where the value
+// is the only integer that rounds to itself.
+template <class _Fp>
+inline bool
+needs_exact_integer(_Fp value, const decimal_digits& d)
+{
+    return d.exponent > 0 &&
+           value >= scalbn(_Fp(1), numeric_limits<_Fp>::digits);
+}
+
+template <class _Fp>
+to_chars_result
+write_special(char* first, char* last, _Fp value)
+{
+    const char* s;
+    if (isinf(value))
+        s = signbit(value) ? "-inf" : "inf";
+    else
+        s = signbit(value) ? "-nan" : "nan";
+    const size_t n = strlen(s);
+    if (static_cast<size_t>(last - first) < n)
+        return {last, errc::value_too_large};
+    memcpy(first, s, n);
+    return {first + n, errc()};
+}
+
+// The shortest forms.  fmt is chars_format() when none was given, for the
+// shorter of fixed and scientific notation.
+template <class _Fp>
+to_chars_result
+to_chars_shortest(char* first, char* last, _Fp value, chars_format fmt)
+{
+    const bool negative = signbit(value);
+    if (negative)
+        value = -value;
+
+    decimal_digits d;
+    if (value == 0) {
+        d.digits[0] = '0';
+        d.count = 1;
+        d.exponent = 0;
+    } else {
+        shortest_digits(value, d);
+    }
+
+    // For large integers in fixed notation, the digits of the exact value.
+    char exact[numeric_limits<_Fp>::max_exponent10 + 8];
+    int exact_length = 0;
+
+    bool fixed;
+    switch (fmt) {
+    case chars_format::scientific:
+        fixed = false;
+        break;
+    case chars_format::fixed:
+        fixed = true;
+        break;
+    case chars_format::general: {
+        const int x = d.exponent + d.count - 1;
+        fixed = -4 <= x && x < 6;
+        break;
+    }
+    default: {
+        // The exact value has as many integer digits as d or one fewer, so
+        // it is only worth finding if that might be the shorter.
+        const int sci = scientific_length(d);
+        if (needs_exact_integer(value, d) && d.exponent + d.count - 1 <= sci) {
+            exact_length = c_print(exact, sizeof(exact), 'f', 0, value);
+            fixed = exact_length <= sci;
+        } else {
+            fixed = fixed_length(d) <= sci;
+        }
+        break;
+    }
+    }
+    if (fixed && exact_length == 0 && needs_exact_integer(value, d))
+        exact_length = c_print(exact, sizeof(exact), 'f', 0, value);
+
+    const int length = negative + (!fixed ? scientific_length(d) :
+                                   exact_length != 0 ? exact_length : fixed_length(d));
+    if (last - first < length)
+        return {last, errc::value_too_large};
+    char* p = first;
+    if (negative)
+        *p++ = '-';
+    if (!fixed)
+        p = write_scientific(p, d);
+    else if (exact_length != 0)
+        p = static_cast<char*>(memcpy(p, exact, exact_length)) + exact_length;
+    else
+        p = write_fixed(p, d);
+    return {p, errc()};
+}
+
+#ifndef _LIBCPP_HAS_NO_INT128
+// Fixed notation with up to 9 digits after the decimal point, for values
+// below 2^127 / 10^9.  The value times 10^precision is m2 * 5^precision *
+// 2^(e2 + precision), which is rounded half to even to an integer.
+template <class _Fp>
+bool
+to_chars_fixed_small(char* first, char* last, _Fp value, int precision,
+                     to_chars_result& result)
+{
+    typedef float_traits<_Fp> traits;
+    static constexpr uint32_t pow5[10] = {
+        1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125};
+
+    if (precision > 9)
+        return false;
+    const float_fields f = decompose(value);
+    if (f.exponent > traits::exponent_bias + 96)
+        return false;
+    int32_t e2;
+    uint64_t m2;
+    if (f.exponent == 0) {
+        e2 = 1 - traits::exponent_bias - traits::mantissa_bits;
+        m2 = f.mantissa;
+    } else {
+        e2 = static_cast<int32_t>(f.exponent) - traits::exponent_bias -
+             traits::mantissa_bits;
+        m2 = (uint64_t(1) << traits::mantissa_bits) | f.mantissa;
+    }
+
+    const __uint128_t n = static_cast<__uint128_t>(m2) * pow5[precision];
+    const int32_t shift = e2 + precision;
+    __uint128_t q;
+    if (shift >= 0) {
+        q = n << shift;
+    } else if (shift > -128) {
+        q = n >> -shift;
+        const __uint128_t rem = n - (q << -shift);
+        const __uint128_t half = static_cast<__uint128_t>(1) << (-shift - 1);
+        if (rem > half || (rem == half && (q & 1) != 0))
+            ++q;
+    } else {
+        q = 0;
+    }
+
+    // q < 2^127, so its leading 19-digit block fits in 64 bits.
+    char digits[48];
+    char* end = digits;
+    const uint64_t high = static_cast<uint64_t>(q / 10000000000000000000u);
+    const uint64_t low = static_cast<uint64_t>(q % 10000000000000000000u);
+    if (high != 0) {
+        end = __itoa::__u64toa(high, end);
+        char block[20];
+        const int n_low = static_cast<int>(__itoa::__u64toa(low, block) - block);
+        memset(end, '0', 19 - n_low);
+        memcpy(end + 19 - n_low, block, n_low);
+        end += 19;
+    } else {
+        end = __itoa::__u64toa(low, end);
+    }
+    int count = static_cast<int>(end - digits);
+
+    // At least one digit before the point.
+    const int integer_digits = count > precision ? count - precision : 1;
+    const int length = f.negative + integer_digits + (precision > 0) + precision;
+    if (last - first < length) {
+        result = {last, errc::value_too_large};
+        return true;
+    }
+    char* p = first;
+    if (f.negative)
+        *p++ = '-';
+    if (count > precision) {
+        memcpy(p, digits, integer_digits);
+        p += integer_digits;
+        if (precision > 0) {
+            *p++ = '.';
+            memcpy(p, digits + integer_digits, precision);
+            p += precision;
+        }
+    } else {
+        *p++ = '0';
+        if (precision > 0) {
+            *p++ = '.';
+            memset(p, '0', precision - count);
+            memcpy(p + precision - count, digits, count);
+            p += precision;
+        }
+    }
+    result = {p, errc()};
+    return true;
+}
+#else
+template <class _Fp>
+inline bool
+to_chars_fixed_small(char*, char*, _Fp, int, to_chars_result&)
+{
+    return false;
+}
+#endif  // _LIBCPP_HAS_NO_INT128
+
+#if LDBL_MANT_DIG != DBL_MANT_DIG
+inline bool
+to_chars_fixed_small(char*, char*, long double, int, to_chars_result&)
+{
+    return false;
+}
+#endif
+
+template <class _Fp>
+to_chars_result
+to_chars_precision(char* first, char* last, _Fp value, chars_format fmt, int precision)
+{
+    char conv;
+    switch (fmt) {
+    case chars_format::fixed: {
+        to_chars_result result;
+        if (to_chars_fixed_small(first, last, value, precision < 0 ? 6 : precision,
+                                 result))
+            return result;
+        conv = 'f';
+        break;
+    }
+    case chars_format::scientific:
+        conv = 'e';
+        break;
+    default:
+        conv = 'g';
+        break;
+    }
+
+    // snprintf needs room for a terminating NUL.
+    const size_t size = static_cast<size_t>(last - first);
+    const int n = c_print(first, size, conv, precision, value);
+    if (n < 0)
+        return {last, errc::value_too_large};
+    if (static_cast<size_t>(n) < size)
+        return {first + n, errc()};
+    if (static_cast<size_t>(n) > size)
+        return {last, errc::value_too_large};
+    char* buffer = static_cast<char*>(malloc(size + 1));
+    if (buffer == nullptr)
+        return {last, errc::value_too_large};
+    c_print(buffer, size + 1, conv, precision, value);
+    memcpy(first, buffer, size);
+    free(buffer);
+    return {last, errc()};
+}
+
+// Hexadecimal output, 1.hhhp+d for normal values and 0.hhhp-d for
+// subnormals.  A precision of less than zero gives as many digits as are
+// needed to represent the value exactly.
+template <class _Fp>
+to_chars_result
+to_chars_hex(char* first, char* last, _Fp value, int precision)
+{
+    typedef float_traits<_Fp> traits;
+    // Hex digits in the fraction.
+    static constexpr int hex_digits = (traits::mantissa_bits + 3) / 4;
+
+    const float_fields f = decompose(value);
+    uint32_t leading;
+    int32_t exponent;
+    // The fraction, aligned so that it is made up of whole hex digits.
+    uint64_t fraction = f.mantissa << (hex_digits * 4 - traits::mantissa_bits);
+    if (f.exponent == 0) {
+        leading = 0;
+        exponent = fraction == 0 ? 0 : 1 - traits::exponent_bias;
+    } else {
+        leading = 1;
+        exponent = static_cast<int32_t>(f.exponent) - traits::exponent_bias;
+    }
+
+    int digits;
+    if (precision < 0) {
+        digits = hex_digits;
+        for (; digits > 0 && (fraction & 0xf) == 0; --digits)
+            fraction >>= 4;
+    } else if (precision < hex_digits) {
+        // Round half to even, possibly carrying into the leading digit.
+        digits = precision;
+        const int dropped = (hex_digits - precision) * 4;
+        const uint64_t rem = fraction & ((uint64_t(1) << dropped) - 1);
+        const uint64_t half = uint64_t(1) << (dropped - 1);
+        fraction >>= dropped;
+        const uint64_t odd = (digits == 0 ? leading : fraction) & 1;
+        if (rem > half || (rem == half && odd != 0)) {
+            ++fraction;
+            if (fraction >> (digits * 4) != 0) {
+                fraction = 0;
+                ++leading;
+            }
+        }
+    } else {
+        digits = precision;
+    }
+
+    const uint32_t abs_exponent = exponent < 0 ? -exponent : exponent;
+    const int exponent_digits = abs_exponent < 10 ? 1 : abs_exponent < 100 ? 2 :
+                                abs_exponent < 1000 ? 3 : 4;
+    const size_t length = f.negative + 1 + (digits > 0) + static_cast<size_t>(digits) +
+                          2 + exponent_digits;
+    if (static_cast<size_t>(last - first) < length)
+        return {last, errc::value_too_large};
+
+    char* p = first;
+    if (f.negative)
+        *p++ = '-';
+    *p++ = static_cast<char>('0' + leading);
+    if (digits > 0) {
+        *p++ = '.';
+        const int significant = digits < hex_digits ? digits : hex_digits;
+        for (int i = significant - 1; i >= 0; --i) {
+            p[i] = "0123456789abcdef"[fraction & 0xf];
+            fraction >>= 4;
+        }
+        p += significant;
+        memset(p, '0', digits - significant);
+        p += digits - significant;
+    }
+    *p++ = 'p';
+    *p++ = exponent < 0 ? '-' : '+';
+    return {__itoa::__u32toa(abs_exponent, p), errc()};
+}
+
+#if LDBL_MANT_DIG != DBL_MANT_DIG
+// Where long double is wider than double, hex output comes from %La, less
+// its 0x.
+to_chars_result
+to_chars_hex(char* first, char* last, long double value, int precision)
+{
+    char buffer[64];
+    c_print(buffer, sizeof(buffer), 'a', precision, value);
+    const bool negative = buffer[0] == '-';
+    const char* digits = buffer + negative + 2;
+    const size_t n = strlen(digits);
+    if (static_cast<size_t>(last - first) < negative + n)
+        return {last, errc::value_too_large};
+    char* p = first;
+    if (negative)
+        *p++ = '-';
+    memcpy(p, digits, n);
+    return {p + n, errc()};
+}
+#endif
+
+// fmt is chars_format() when none was given, and precision is ignored unless
+// has_precision.
+template <class _Fp>
+to_chars_result
+floating_to_chars(char* first, char* last, _Fp value, chars_format fmt,
+                  bool has_precision, int precision)
+{
+    if (!isfinite(value))
+        return write_special(first, last, value);
+    if (fmt == chars_format::hex)
+        return to_chars_hex(first, last, value, has_precision ? precision : -1);
+    if (has_precision)
+        return to_chars_precision(first, last, value, fmt, precision);
+    return to_chars_shortest(first, last, value, fmt);
+}
+
+// Decimal and hexadecimal input.
+
+// The subject sequence of a number, as strtod would take it, restricted by
+// chars_format.
+struct floating_subject
+{
+    const char* end;
+    enum { number, infinity, nan } kind;
+    bool negative;
+    bool hex;
+    // Whether any digit is not zero.
+    bool nonzero;
+    // For decimal numbers, the first 19 significant digits and the power of
+    // ten to scale them by.  truncated is set if any digit after those is
+    // not zero.
+    uint64_t mantissa;
+    int64_t exponent;
+    bool truncated;
+};
+
+inline bool
+is_digit(char c)
+{
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+inline bool
+is_hex_digit(char c)
+{
+    return is_digit(c) || static_cast<unsigned char>((c | 0x20) - 'a') < 6;
+}
+
+// Compares the next characters with s, which is in lowercase.
+inline bool
+starts_with_icase(const char* p, const char* last, const char* s)
+{
+    for (; *s != '\0'; ++p, ++s)
+        if (p == last || (*p | 0x20) != *s)
+            return false;
+    return true;
+}
+
+bool
+parse_subject(const char* first, const char* last, chars_format fmt,
+              floating_subject& s)
+{
+    const char* p = first;
+    s.negative = p != last && *p == '-';
+    if (s.negative)
+        ++p;
+    s.kind = floating_subject::number;
+    s.hex = fmt == chars_format::hex;
+    s.nonzero = false;
+    s.mantissa = 0;
+    s.exponent = 0;
+    s.truncated = false;
+
+    if (starts_with_icase(p, last, "inf")) {
+        s.kind = floating_subject::infinity;
+        p += 3;
+        if (starts_with_icase(p, last, "inity"))
+            p += 5;
+        s.end = p;
+        return true;
+    }
+    if (starts_with_icase(p, last, "nan")) {
+        s.kind = floating_subject::nan;
+        p += 3;
+        // An optional (n-char-sequence).
+        if (p != last && *p == '(') {
+            const char* q = p + 1;
+            while (q != last && (is_digit(*q) || *q == '_' ||
+                                 static_cast<unsigned char>((*q | 0x20) - 'a') < 26))
+                ++q;
+            if (q != last && *q == ')')
+                p = q + 1;
+        }
+        s.end = p;
+        return true;
+    }
+
+    bool any_digits = false;
+    if (s.hex) {
+        for (; p != last && is_hex_digit(*p); ++p) {
+            any_digits = true;
+            s.nonzero |= *p != '0';
+        }
+        if (p != last && *p == '.')
+            for (++p; p != last && is_hex_digit(*p); ++p) {
+                any_digits = true;
+                s.nonzero |= *p != '0';
+            }
+        if (!any_digits)
+            return false;
+        // An exponent is optional, and is only taken if it has digits.
+        if (p != last && (*p | 0x20) == 'p') {
+            const char* q = p + 1;
+            if (q != last && (*q == '+' || *q == '-'))
+                ++q;
+            if (q != last && is_digit(*q)) {
+                for (; q != last && is_digit(*q); ++q)
+                    ;
+                p = q;
+            }
+        }
+        s.end = p;
+        return true;
+    }
+
+    int digits = 0;
+    int64_t scale = 0;
+    for (; p != last && *p == '0'; ++p)
+        any_digits = true;
+    for (; p != last && is_digit(*p); ++p) {
+        any_digits = true;
+        if (digits < 19) {
+            s.mantissa = s.mantissa * 10 + static_cast<unsigned>(*p - '0');
+            ++digits;
+        } else {
+            ++scale;
+            s.truncated |= *p != '0';
+        }
+    }
+    if (p != last && *p == '.') {
+        for (++p; p != last && is_digit(*p); ++p) {
+            any_digits = true;
+            if (s.mantissa == 0 && *p == '0') {
+                --scale;
+            } else if (digits < 19) {
+                s.mantissa = s.mantissa * 10 + static_cast<unsigned>(*p - '0');
+                ++digits;
+                --scale;
+            } else {
+                s.truncated |= *p != '0';
+            }
+        }
+    }
+    if (!any_digits)
+        return false;
+    s.nonzero = s.mantissa != 0;
+
+    // The exponent is required for scientific, and not allowed for fixed.
+    bool has_exponent = false;
+    if ((fmt & chars_format::scientific) == chars_format::scientific &&
+        p != last && (*p | 0x20) == 'e') {
+        const char* q = p + 1;
+        const bool negative = q != last && *q == '-';
+        if (q != last && (*q == '+' || *q == '-'))
+            ++q;
+        if (q != last && is_digit(*q)) {
+            int64_t exponent = 0;
+            for (; q != last && is_digit(*q); ++q)
+                if (exponent < 100000000)
+                    exponent = exponent * 10 + (*q - '0');
+            scale += negative ? -exponent : exponent;
+            has_exponent = true;
+            p = q;
+        }
+    }
+    if (fmt == chars_format::scientific && !has_exponent)
+        return false;
+    s.exponent = scale;
+    s.end = p;
+    return true;
+}
+
+// Clinger's fast path: the mantissa and the power of ten are both exact, so
+// the product or quotient is correctly rounded.  This relies on arithmetic
+// being carried out in the precision of the type.
+inline bool
+clinger(uint64_t m, int64_t e, float& value)
+{
+    static constexpr float pow10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                      1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    if (m <= (uint64_t(1) << 24) && -10 <= e && e <= 10) {
+        const float f = static_cast<float>(m);
+        value = e < 0 ? f / pow10[-e] : f * pow10[e];
+        return true;
+    }
+#else
+    (void)pow10;
+#endif
+    return false;
+}
+
+inline bool
+clinger(uint64_t m, int64_t e, double& value)
+{
+    static constexpr double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    if (m <= (uint64_t(1) << 53) && -22 <= e && e <= 22) {
+        const double d = static_cast<double>(m);
+        value = e < 0 ? d / pow10[-e] : d * pow10[e];
+        return true;
+    }
+#else
+    (void)pow10;
+#endif
+    return false;
+}
+
+// Eisel-Lemire: m * 10^e from a 128-bit approximation of 10^e, failing when
+// the truncated bits could make a difference to the rounding.  m is not
+// zero.
+template <class _Fp>
+bool
+eisel_lemire(uint64_t m, int64_t e, bool negative, _Fp& value)
+{
+    typedef float_traits<_Fp> traits;
+    // The bits below the mantissa and its rounding bit.
+    static constexpr uint64_t mask =
+        (uint64_t(1) << (64 - traits::mantissa_bits - 3)) - 1;
+
+    if (e < __pow10_min_exponent || e > __pow10_max_exponent)
+        return false;
+
+    const int clz = __builtin_clzll(m);
+    m <<= clz;
+    uint64_t exp2 = static_cast<uint64_t>(((217706 * e) >> 16) + 64 +
+                                          traits::exponent_bias - clz);
+
+    const uint64_t* pow10 = __pow10_split[e - __pow10_min_exponent];
+    uint64_t x_hi;
+    uint64_t x_lo = umul128(m, pow10[1], x_hi);
+    if ((x_hi & mask) == mask && x_lo + m < x_lo) {
+        // Bring in the low half of the power of ten.
+        uint64_t y_hi;
+        const uint64_t y_lo = umul128(m, pow10[0], y_hi);
+        uint64_t merged_hi = x_hi;
+        const uint64_t merged_lo = x_lo + y_hi;
+        if (merged_lo < x_lo)
+            ++merged_hi;
+        if ((merged_hi & mask) == mask && merged_lo + 1 == 0 && y_lo + m < y_lo)
+            return false;
+        x_hi = merged_hi;
+        x_lo = merged_lo;
+    }
+
+    const uint64_t msb = x_hi >> 63;
+    uint64_t mantissa = x_hi >> (msb + 64 - traits::mantissa_bits - 3);
+    exp2 -= 1 ^ msb;
+
+    // A halfway case, which the approximation cannot round.
+    if (x_lo == 0 && (x_hi & mask) == 0 && (mantissa & 3) == 1)
+        return false;
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >> (traits::mantissa_bits + 1) != 0) {
+        mantissa >>= 1;
+        ++exp2;
+    }
+    // Subnormal, infinite or out of range.
+    if (exp2 - 1 >= (uint64_t(1) << traits::exponent_bits) - 2)
+        return false;
+
+    uint64_t bits = (exp2 << traits::mantissa_bits) |
+                    (mantissa & ((uint64_t(1) << traits::mantissa_bits) - 1));
+    if (negative)
+        bits |= uint64_t(1) << (traits::mantissa_bits + traits::exponent_bits);
+    const typename traits::bits_type narrow =
+        static_cast<typename traits::bits_type>(bits);
+    memcpy(&value, &narrow, sizeof(value));
+    return true;
+}
+
+template <class _Fp>
+bool
+convert_decimal(const floating_subject& s, _Fp& value)
+{
+    if (s.mantissa == 0) {
+        value = s.negative ? -_Fp(0) : _Fp(0);
+        return true;
+    }
+    if (!s.truncated) {
+        if (clinger(s.mantissa, s.exponent, value)) {
+            if (s.negative)
+                value = -value;
+            return true;
+        }
+        return eisel_lemire(s.mantissa, s.exponent, s.negative, value);
+    }
+    // The value lies between m and m + 1 times the power of ten.
+    _Fp low, high;
+    if (eisel_lemire(s.mantissa, s.exponent, s.negative, low) &&
+        eisel_lemire(s.mantissa + 1, s.exponent, s.negative, high) &&
+        low == high) {
+        value = low;
+        return true;
+    }
+    return false;
+}
+
+inline bool
+convert_decimal(const floating_subject& s, long double& value)
+{
+#if LDBL_MANT_DIG == DBL_MANT_DIG
+    double d;
+    if (convert_decimal(s, d)) {
+        value = d;
+        return true;
+    }
+#else
+    (void)s;
+    (void)value;
+#endif
+    return false;
+}
+
+// Converts the subject sequence from first to s.end with the C library.
+template <class _Fp>
+_Fp
+convert_c(const char* first, const floating_subject& s)
+{
+    char stack_buffer[128];
+    const size_t n = static_cast<size_t>(s.end - first);
+    const size_t size = n + 3;
+    char* buffer = stack_buffer;
+    if (size > sizeof(stack_buffer)) {
+        buffer = static_cast<char*>(malloc(size));
+        if (buffer == nullptr)
+            __throw_bad_alloc();
+    }
+    char* p = buffer;
+    const char* digits = first;
+    if (s.negative) {
+        *p++ = '-';
+        ++digits;
+    }
+    if (s.hex) {
+        *p++ = '0';
+        *p++ = 'x';
+    }
+    memcpy(p, digits, static_cast<size_t>(s.end - digits));
+    p[s.end - digits] = '\0';
+
+    const int saved_errno = errno;
+    const _Fp value = c_strto(buffer, static_cast<_Fp*>(nullptr));
+    errno = saved_errno;
+    if (buffer != stack_buffer)
+        free(buffer);
+    return value;
+}
+
+template <class _Fp>
+from_chars_result
+floating_from_chars(const char* first, const char* last, _Fp& value, chars_format fmt)
+{
+    floating_subject s;
+    if (!parse_subject(first, last, fmt, s))
+        return {first, errc::invalid_argument};
+
+    _Fp result;
+    if (s.kind == floating_subject::infinity) {
+        result = numeric_limits<_Fp>::infinity();
+    } else if (s.kind == floating_subject::nan) {
+        result = numeric_limits<_Fp>::quiet_NaN();
+    } else {
+        if (s.hex || !convert_decimal(s, result))
+            result = convert_c<_Fp>(first, s);
+        if (isinf(result) || (result == 0 && s.nonzero))
+            return {s.end, errc::result_out_of_range};
+        value = result;
+        return {s.end, errc()};
+    }
+    value = s.negative ? -result : result;
+    return {s.end, errc()};
+}
+
+}  // unnamed namespace
+
+to_chars_result
+to_chars(char* first, char* last, float value)
+{
+    return floating_to_chars(first, last, value, chars_format(), false, 0);
+}
+
+to_chars_result
+to_chars(char* first, char* last, double value)
+{
+    return floating_to_chars(first, last, value, chars_format(), false, 0);
+}
+
+to_chars_result
+to_chars(char* first, char* last, long double value)
+{
+#if LDBL_MANT_DIG == DBL_MANT_DIG
+    return floating_to_chars(first, last, static_cast<double>(value),
+                             chars_format(), false, 0);
+#else
+    return floating_to_chars(first, last, value, chars_format(), false, 0);
+#endif
+}
+
+to_chars_result
+to_chars(char* first, char* last, float value, chars_format fmt)
+{
+    return floating_to_chars(first, last, value, fmt, false, 0);
+}
+
+to_chars_result
+to_chars(char* first, char* last, double value, chars_format fmt)
+{
+    return floating_to_chars(first, last, value, fmt, false, 0);
+}
+
+to_chars_result
+to_chars(char* first, char* last, long double value, chars_format fmt)
+{
+#if LDBL_MANT_DIG == DBL_MANT_DIG
+    return floating_to_chars(first, last, static_cast<double>(value), fmt, false, 0);
+#else
+    return floating_to_chars(first, last, value, fmt, false, 0);
+#endif
+}
+
+to_chars_result
+to_chars(char* first, char* last, float value, chars_format fmt, int precision)
+{
+    return floating_to_chars(first, last, value, fmt, true, precision);
+}
+
+to_chars_result
+to_chars(char* first, char* last, double value, chars_format fmt, int precision)
+{
+    return floating_to_chars(first, last, value, fmt, true, precision);
+}
+
+to_chars_result
+to_chars(char* first, char* last, long double value, chars_format fmt, int precision)
+{
+#if LDBL_MANT_DIG == DBL_MANT_DIG
+    return floating_to_chars(first, last, static_cast<double>(value), fmt, true,
+                             precision);
+#else
+    return floating_to_chars(first, last, value, fmt, true, precision);
+#endif
+}
+
+from_chars_result
+from_chars(const char* first, const char* last, float& value, chars_format fmt)
+{
+    return floating_from_chars(first, last, value, fmt);
+}
+
+from_chars_result
+from_chars(const char* first, const char* last, double& value, chars_format fmt)
+{
+    return floating_from_chars(first, last, value, fmt);
+}
+
+from_chars_result
+from_chars(const char* first, const char* last, long double& value, chars_format fmt)
+{
+    return floating_from_chars(first, last, value, fmt);
+}
+
 _LIBCPP_END_NAMESPACE_STD
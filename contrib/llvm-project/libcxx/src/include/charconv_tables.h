@@ -0,0 +1,1413 @@
+//===------------------------ charconv_tables.h ---------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _LIBCPP_SRC_INCLUDE_CHARCONV_TABLES_H
+#define _LIBCPP_SRC_INCLUDE_CHARCONV_TABLES_H
+
+#include <__config>
+#include <stdint.h>
+
+_LIBCPP_BEGIN_NAMESPACE_STD
+
+namespace __fp_tables
+{
+
+// Tables for the Ryu shortest round-trip algorithm, as 128-bit values stored
+// low half first.  Multipliers for binary exponents e2 >= 0 are
+//
+//     __pow5_inv_split[q] = floor(2^(bitlength(5^q) - 1 + 125) / 5^q) + 1
+//
+// and for e2 < 0 they are 5^i with all but its top 125 bits shifted out:
+//
+//     __pow5_split[i] = floor(5^i / 2^(bitlength(5^i) - 125))
+
+static constexpr int __pow5_inv_bitcount = 125;
+static constexpr int __pow5_bitcount = 125;
+
+static constexpr uint64_t __pow5_inv_split[342][2] = {
+    {1u, 2305843009213693952u},
+    {11068046444225730970u, 1844674407370955161u},
+    {5165088340638674453u, 1475739525896764129u},
+    {7821419487252849886u, 1180591620717411303u},
+    {8824922364862649494u, 1888946593147858085u},
+    {7059937891890119595u, 1511157274518286468u},
+    {13026647942995916322u, 1208925819614629174u},
+    {9774590264567735146u, 1934281311383406679u},
+    {11509021026396098440u, 1547425049106725343u},
+    {16585914450600699399u, 1237940039285380274u},
+    {15469416676735388068u, 1980704062856608439u},
+    {16064882156130220778u, 1584563250285286751u},
+    {9162556910162266299u, 1267650600228229401u},
+    {7281393426775805432u, 2028240960365167042u},
+    {16893161185646375315u, 1622592768292133633u},
+    {2446482504291369283u, 1298074214633706907u},
+    {7603720821608101175u, 2076918743413931051u},
+    {2393627842544570617u, 1661534994731144841u},
+    {16672297533003297786u, 1329227995784915872u},
+    {11918280793837635165u, 2126764793255865396u},
+    {5845275820328197809u, 1701411834604692317u},
+    {15744267100488289217u, 1361129467683753853u},
+    {3054734472329800808u, 2177807148294006166u},
+    {17201182836831481939u, 1742245718635204932u},
+    {6382248639981364905u, 1393796574908163946u},
+    {2832900194486363201u, 2230074519853062314u},
+    {5955668970331000884u, 1784059615882449851u},
+    {1075186361522890384u, 1427247692705959881u},
+    {12788344622662355584u, 2283596308329535809u},
+    {13920024512871794791u, 1826877046663628647u},
+    {3757321980813615186u, 1461501637330902918u},
+    {10384555214134712795u, 1169201309864722334u},
+    {5547241898389809503u, 1870722095783555735u},
+    {4437793518711847602u, 1496577676626844588u},
+    {10928932444453298728u, 1197262141301475670u},
+    {17486291911125277965u, 1915619426082361072u},
+    {6610335899416401726u, 1532495540865888858u},
+    {12666966349016942027u, 1225996432692711086u},
+    {12888448528943286597u, 1961594292308337738u},
+    {17689456452638449924u, 1569275433846670190u},
+    {14151565162110759939u, 1255420347077336152u},
+    {7885109000409574610u, 2008672555323737844u},
+    {9997436015069570011u, 1606938044258990275u},
+    {7997948812055656009u, 1285550435407192220u},
+    {12796718099289049614u, 2056880696651507552u},
+    {2858676849947419045u, 1645504557321206042u},
+    {13354987924183666206u, 1316403645856964833u},
+    {17678631863951955605u, 2106245833371143733u},
+    {3074859046935833515u, 1684996666696914987u},
+    {13527933681774397782u, 1347997333357531989u},
+    {10576647446613305481u, 2156795733372051183u},
+    {15840015586774465031u, 1725436586697640946u},
+    {8982663654677661702u, 1380349269358112757u},
+    {18061610662226169046u, 2208558830972980411u},
+    {10759939715039024913u, 1766847064778384329u},
+    {12297300586773130254u, 1413477651822707463u},
+    {15986332124095098083u, 2261564242916331941u},
+    {9099716884534168143u, 1809251394333065553u},
+    {14658471137111155161u, 1447401115466452442u},
+    {4348079280205103483u, 1157920892373161954u},
+    {14335624477811986218u, 1852673427797059126u},
+    {7779150767507678651u, 1482138742237647301u},
+    {2533971799264232598u, 1185710993790117841u},
+    {15122401323048503126u, 1897137590064188545u},
+    {12097921058438802501u, 1517710072051350836u},
+    {5988988032009131678u, 1214168057641080669u},
+    {16961078480698431330u, 1942668892225729070u},
+    {13568862784558745064u, 1554135113780583256u},
+    {7165741412905085728u, 1243308091024466605u},
+    {11465186260648137165u, 1989292945639146568u},
+    {16550846638002330379u, 1591434356511317254u},
+    {16930026125143774626u, 1273147485209053803u},
+    {4951948911778577463u, 2037035976334486086u},
+    {272210314680951647u, 1629628781067588869u},
+    {3907117066486671641u, 1303703024854071095u},
+    {6251387306378674625u, 2085924839766513752u},
+    {16069156289328670670u, 1668739871813211001u},
+    {9165976216721026213u, 1334991897450568801u},
+    {7286864317269821294u, 2135987035920910082u},
+    {16897537898041588005u, 1708789628736728065u},
+    {13518030318433270404u, 1367031702989382452u},
+    {6871453250525591353u, 2187250724783011924u},
+    {9186511415162383406u, 1749800579826409539u},
+    {11038557946871817048u, 1399840463861127631u},
+    {10282995085511086630u, 2239744742177804210u},
+    {8226396068408869304u, 1791795793742243368u},
+    {13959814484210916090u, 1433436634993794694u},
+    {11267656730511734774u, 2293498615990071511u},
+    {5324776569667477496u, 1834798892792057209u},
+    {7949170070475892320u, 1467839114233645767u},
+    {17427382500606444826u, 1174271291386916613u},
+    {5747719112518849781u, 1878834066219066582u},
+    {15666221734240810795u, 1503067252975253265u},
+    {12532977387392648636u, 1202453802380202612u},
+    {5295368560860596524u, 1923926083808324180u},
+    {4236294848688477220u, 1539140867046659344u},
+    {7078384693692692099u, 1231312693637327475u},
+    {11325415509908307358u, 1970100309819723960u},
+    {9060332407926645887u, 1576080247855779168u},
+    {14626963555825137356u, 1260864198284623334u},
+    {12335095245094488799u, 2017382717255397335u},
+    {9868076196075591040u, 1613906173804317868u},
+    {15273158586344293478u, 1291124939043454294u},
+    {13369007293925138595u, 2065799902469526871u},
+    {7005857020398200553u, 1652639921975621497u},
+    {16672732060544291412u, 1322111937580497197u},
+    {11918976037903224966u, 2115379100128795516u},
+    {5845832015580669650u, 1692303280103036413u},
+    {12055363241948356366u, 1353842624082429130u},
+    {841837113407818570u, 2166148198531886609u},
+    {4362818505468165179u, 1732918558825509287u},
+    {14558301248600263113u, 1386334847060407429u},
+    {12225235553534690011u, 2218135755296651887u},
+    {2401490813343931363u, 1774508604237321510u},
+    {1921192650675145090u, 1419606883389857208u},
+    {17831303500047873437u, 2271371013423771532u},
+    {6886345170554478103u, 1817096810739017226u},
+    {1819727321701672159u, 1453677448591213781u},
+    {16213177116328979020u, 1162941958872971024u},
+    {14873036941900635463u, 1860707134196753639u},
+    {15587778368262418694u, 1488565707357402911u},
+    {8780873879868024632u, 1190852565885922329u},
+    {2981351763563108441u, 1905364105417475727u},
+    {13453127855076217722u, 1524291284333980581u},
+    {7073153469319063855u, 1219433027467184465u},
+    {11317045550910502167u, 1951092843947495144u},
+    {12742985255470312057u, 1560874275157996115u},
+    {10194388204376249646u, 1248699420126396892u},
+    {1553625868034358140u, 1997919072202235028u},
+    {8621598323911307159u, 1598335257761788022u},
+    {17965325103354776697u, 1278668206209430417u},
+    {13987124906400001422u, 2045869129935088668u},
+    {121653480894270168u, 1636695303948070935u},
+    {97322784715416134u, 1309356243158456748u},
+    {14913111714512307107u, 2094969989053530796u},
+    {8241140556867935363u, 1675975991242824637u},
+    {17660958889720079260u, 1340780792994259709u},
+    {17189487779326395846u, 2145249268790815535u},
+    {13751590223461116677u, 1716199415032652428u},
+    {18379969808252713988u, 1372959532026121942u},
+    {14650556434236701088u, 2196735251241795108u},
+    {652398703163629901u, 1757388200993436087u},
+    {11589965406756634890u, 1405910560794748869u},
+    {7475898206584884855u, 2249456897271598191u},
+    {2291369750525997561u, 1799565517817278553u},
+    {9211793429904618695u, 1439652414253822842u},
+    {18428218302589300235u, 2303443862806116547u},
+    {7363877012587619542u, 1842755090244893238u},
+    {13269799239553916280u, 1474204072195914590u},
+    {10615839391643133024u, 1179363257756731672u},
+    {2227947767661371545u, 1886981212410770676u},
+    {16539753473096738529u, 1509584969928616540u},
+    {13231802778477390823u, 1207667975942893232u},
+    {6413489186596184024u, 1932268761508629172u},
+    {16198837793502678189u, 1545815009206903337u},
+    {5580372605318321905u, 1236652007365522670u},
+    {8928596168509315048u, 1978643211784836272u},
+    {18210923379033183008u, 1582914569427869017u},
+    {7190041073742725760u, 1266331655542295214u},
+    {436019273762630246u, 2026130648867672343u},
+    {7727513048493924843u, 1620904519094137874u},
+    {9871359253537050198u, 1296723615275310299u},
+    {4726128361433549347u, 2074757784440496479u},
+    {7470251503888749801u, 1659806227552397183u},
+    {13354898832594820487u, 1327844982041917746u},
+    {13989140502667892133u, 2124551971267068394u},
+    {14880661216876224029u, 1699641577013654715u},
+    {11904528973500979224u, 1359713261610923772u},
+    {4289851098633925465u, 2175541218577478036u},
+    {18189276137874781665u, 1740432974861982428u},
+    {3483374466074094362u, 1392346379889585943u},
+    {1884050330976640656u, 2227754207823337509u},
+    {5196589079523222848u, 1782203366258670007u},
+    {15225317707844309248u, 1425762693006936005u},
+    {5913764258841343181u, 2281220308811097609u},
+    {8420360221814984868u, 1824976247048878087u},
+    {17804334621677718864u, 1459980997639102469u},
+    {17932816512084085415u, 1167984798111281975u},
+    {10245762345624985047u, 1868775676978051161u},
+    {4507261061758077715u, 1495020541582440929u},
+    {7295157664148372495u, 1196016433265952743u},
+    {7982903447895485668u, 1913626293225524389u},
+    {10075671573058298858u, 1530901034580419511u},
+    {4371188443704728763u, 1224720827664335609u},
+    {14372599139411386667u, 1959553324262936974u},
+    {15187428126271019657u, 1567642659410349579u},
+    {15839291315758726049u, 1254114127528279663u},
+    {3206773216762499739u, 2006582604045247462u},
+    {13633465017635730761u, 1605266083236197969u},
+    {14596120828850494932u, 1284212866588958375u},
+    {4907049252451240275u, 2054740586542333401u},
+    {236290587219081897u, 1643792469233866721u},
+    {14946427728742906810u, 1315033975387093376u},
+    {16535586736504830250u, 2104054360619349402u},
+    {5849771759720043554u, 1683243488495479522u},
+    {15747863852001765813u, 1346594790796383617u},
+    {10439186904235184007u, 2154551665274213788u},
+    {15730047152871967852u, 1723641332219371030u},
+    {12584037722297574282u, 1378913065775496824u},
+    {9066413911450387881u, 2206260905240794919u},
+    {10942479943902220628u, 1765008724192635935u},
+    {8753983955121776503u, 1412006979354108748u},
+    {10317025513452932081u, 2259211166966573997u},
+    {874922781278525018u, 1807368933573259198u},
+    {8078635854506640661u, 1445895146858607358u},
+    {13841606313089133175u, 1156716117486885886u},
+    {14767872471458792434u, 1850745787979017418u},
+    {746251532941302978u, 1480596630383213935u},
+    {597001226353042382u, 1184477304306571148u},
+    {15712597221132509104u, 1895163686890513836u},
+    {8880728962164096960u, 1516130949512411069u},
+    {10793931984473187891u, 1212904759609928855u},
+    {17270291175157100626u, 1940647615375886168u},
+    {2748186495899949531u, 1552518092300708935u},
+    {2198549196719959625u, 1242014473840567148u},
+    {18275073973719576693u, 1987223158144907436u},
+    {10930710364233751031u, 1589778526515925949u},
+    {12433917106128911148u, 1271822821212740759u},
+    {8826220925580526867u, 2034916513940385215u},
+    {7060976740464421494u, 1627933211152308172u},
+    {16716827836597268165u, 1302346568921846537u},
+    {11989529279587987770u, 2083754510274954460u},
+    {9591623423670390216u, 1667003608219963568u},
+    {15051996368420132820u, 1333602886575970854u},
+    {13015147745246481542u, 2133764618521553367u},
+    {3033420566713364587u, 1707011694817242694u},
+    {6116085268112601993u, 1365609355853794155u},
+    {9785736428980163188u, 2184974969366070648u},
+    {15207286772667951197u, 1747979975492856518u},
+    {1097782973908629988u, 1398383980394285215u},
+    {1756452758253807981u, 2237414368630856344u},
+    {5094511021344956708u, 1789931494904685075u},
+    {4075608817075965366u, 1431945195923748060u},
+    {6520974107321544586u, 2291112313477996896u},
+    {1527430471115325346u, 1832889850782397517u},
+    {12289990821117991246u, 1466311880625918013u},
+    {17210690286378213644u, 1173049504500734410u},
+    {9090360384495590213u, 1876879207201175057u},
+    {18340334751822203140u, 1501503365760940045u},
+    {14672267801457762512u, 1201202692608752036u},
+    {16096930852848599373u, 1921924308174003258u},
+    {1809498238053148529u, 1537539446539202607u},
+    {12515645034668249793u, 1230031557231362085u},
+    {1578287981759648052u, 1968050491570179337u},
+    {12330676829633449412u, 1574440393256143469u},
+    {13553890278448669853u, 1259552314604914775u},
+    {3239480371808320148u, 2015283703367863641u},
+    {17348979556414297411u, 1612226962694290912u},
+    {6500486015647617283u, 1289781570155432730u},
+    {10400777625036187652u, 2063650512248692368u},
+    {15699319729512770768u, 1650920409798953894u},
+    {16248804598352126938u, 1320736327839163115u},
+    {7551343283653851484u, 2113178124542660985u},
+    {6041074626923081187u, 1690542499634128788u},
+    {12211557331022285596u, 1352433999707303030u},
+    {1091747655926105338u, 2163894399531684849u},
+    {4562746939482794594u, 1731115519625347879u},
+    {7339546366328145998u, 1384892415700278303u},
+    {8053925371383123274u, 2215827865120445285u},
+    {6443140297106498619u, 1772662292096356228u},
+    {12533209867169019542u, 1418129833677084982u},
+    {5295740528502789974u, 2269007733883335972u},
+    {15304638867027962949u, 1815206187106668777u},
+    {4865013464138549713u, 1452164949685335022u},
+    {14960057215536570740u, 1161731959748268017u},
+    {9178696285890871890u, 1858771135597228828u},
+    {14721654658196518159u, 1487016908477783062u},
+    {4398626097073393881u, 1189613526782226450u},
+    {7037801755317430209u, 1903381642851562320u},
+    {5630241404253944167u, 1522705314281249856u},
+    {814844308661245011u, 1218164251424999885u},
+    {1303750893857992017u, 1949062802279999816u},
+    {15800395974054034906u, 1559250241823999852u},
+    {5261619149759407279u, 1247400193459199882u},
+    {12107939454356961969u, 1995840309534719811u},
+    {5997002748743659252u, 1596672247627775849u},
+    {8486951013736837725u, 1277337798102220679u},
+    {2511075177753209390u, 2043740476963553087u},
+    {13076906586428298482u, 1634992381570842469u},
+    {14150874083884549109u, 1307993905256673975u},
+    {4194654460505726958u, 2092790248410678361u},
+    {18113118827372222859u, 1674232198728542688u},
+    {3422448617672047318u, 1339385758982834151u},
+    {16543964232501006678u, 2143017214372534641u},
+    {9545822571258895019u, 1714413771498027713u},
+    {15015355686490936662u, 1371531017198422170u},
+    {5577825024675947042u, 2194449627517475473u},
+    {11840957649224578280u, 1755559702013980378u},
+    {16851463748863483271u, 1404447761611184302u},
+    {12204946739213931940u, 2247116418577894884u},
+    {13453306206113055875u, 1797693134862315907u},
+    {3383947335406624054u, 1438154507889852726u},
+    {16482362180876329456u, 2301047212623764361u},
+    {9496540929959153242u, 1840837770099011489u},
+    {11286581558709232917u, 1472670216079209191u},
+    {5339916432225476010u, 1178136172863367353u},
+    {4854517476818851293u, 1885017876581387765u},
+    {3883613981455081034u, 1508014301265110212u},
+    {14174937629389795797u, 1206411441012088169u},
+    {11611853762797942306u, 1930258305619341071u},
+    {5600134195496443521u, 1544206644495472857u},
+    {15548153800622885787u, 1235365315596378285u},
+    {6430302007287065643u, 1976584504954205257u},
+    {16212288050055383484u, 1581267603963364205u},
+    {12969830440044306787u, 1265014083170691364u},
+    {9683682259845159889u, 2024022533073106183u},
+    {15125643437359948558u, 1619218026458484946u},
+    {8411165935146048523u, 1295374421166787957u},
+    {17147214310975587960u, 2072599073866860731u},
+    {10028422634038560045u, 1658079259093488585u},
+    {8022738107230848036u, 1326463407274790868u},
+    {9147032156827446534u, 2122341451639665389u},
+    {11006974540203867551u, 1697873161311732311u},
+    {5116230817421183718u, 1358298529049385849u},
+    {15564666937357714594u, 2173277646479017358u},
+    {1383687105660440706u, 1738622117183213887u},
+    {12174996128754083534u, 1390897693746571109u},
+    {8411947361780802685u, 2225436309994513775u},
+    {6729557889424642148u, 1780349047995611020u},
+    {5383646311539713719u, 1424279238396488816u},
+    {1235136468979721303u, 2278846781434382106u},
+    {15745504434151418335u, 1823077425147505684u},
+    {16285752362063044992u, 1458461940118004547u},
+    {5649904260166615347u, 1166769552094403638u},
+    {5350498001524674232u, 1866831283351045821u},
+    {591049586477829062u, 1493465026680836657u},
+    {11540886113407994219u, 1194772021344669325u},
+    {18673707743239135u, 1911635234151470921u},
+    {14772334225162232601u, 1529308187321176736u},
+    {8128518565387875758u, 1223446549856941389u},
+    {1937583260394870242u, 1957514479771106223u},
+    {8928764237799716840u, 1566011583816884978u},
+    {14521709019723594119u, 1252809267053507982u},
+    {8477339172590109297u, 2004494827285612772u},
+    {17849917782297818407u, 1603595861828490217u},
+    {6901236596354434079u, 1282876689462792174u},
+    {18420676183650915173u, 2052602703140467478u},
+    {3668494502695001169u, 1642082162512373983u},
+    {10313493231639821582u, 1313665730009899186u},
+    {9122891541139893884u, 2101865168015838698u},
+    {14677010862395735754u, 1681492134412670958u},
+    {673562245690857633u, 1345193707530136767u},
+};
+
+static constexpr uint64_t __pow5_split[326][2] = {
+    {0u, 1152921504606846976u},
+    {0u, 1441151880758558720u},
+    {0u, 1801439850948198400u},
+    {0u, 2251799813685248000u},
+    {0u, 1407374883553280000u},
+    {0u, 1759218604441600000u},
+    {0u, 2199023255552000000u},
+    {0u, 1374389534720000000u},
+    {0u, 1717986918400000000u},
+    {0u, 2147483648000000000u},
+    {0u, 1342177280000000000u},
+    {0u, 1677721600000000000u},
+    {0u, 2097152000000000000u},
+    {0u, 1310720000000000000u},
+    {0u, 1638400000000000000u},
+    {0u, 2048000000000000000u},
+    {0u, 1280000000000000000u},
+    {0u, 1600000000000000000u},
+    {0u, 2000000000000000000u},
+    {0u, 1250000000000000000u},
+    {0u, 1562500000000000000u},
+    {0u, 1953125000000000000u},
+    {0u, 1220703125000000000u},
+    {0u, 1525878906250000000u},
+    {0u, 1907348632812500000u},
+    {0u, 1192092895507812500u},
+    {0u, 1490116119384765625u},
+    {4611686018427387904u, 1862645149230957031u},
+    {9799832789158199296u, 1164153218269348144u},
+    {12249790986447749120u, 1455191522836685180u},
+    {15312238733059686400u, 1818989403545856475u},
+    {14528612397897220096u, 2273736754432320594u},
+    {13692068767113150464u, 1421085471520200371u},
+    {12503399940464050176u, 1776356839400250464u},
+    {15629249925580062720u, 2220446049250313080u},
+    {9768281203487539200u, 1387778780781445675u},
+    {7598665485932036096u, 1734723475976807094u},
+    {274959820560269312u, 2168404344971008868u},
+    {9395221924704944128u, 1355252715606880542u},
+    {2520655369026404352u, 1694065894508600678u},
+    {12374191248137781248u, 2117582368135750847u},
+    {14651398557727195136u, 1323488980084844279u},
+    {13702562178731606016u, 1654361225106055349u},
+    {3293144668132343808u, 2067951531382569187u},
+    {18199116482078572544u, 1292469707114105741u},
+    {8913837547316051968u, 1615587133892632177u},
+    {15753982952572452864u, 2019483917365790221u},
+    {12152082354571476992u, 1262177448353618888u},
+    {15190102943214346240u, 1577721810442023610u},
+    {9764256642163156992u, 1972152263052529513u},
+    {17631875447420442880u, 1232595164407830945u},
+    {8204786253993389888u, 1540743955509788682u},
+    {1032610780636961552u, 1925929944387235853u},
+    {2951224747111794922u, 1203706215242022408u},
+    {3689030933889743652u, 1504632769052528010u},
+    {13834660704216955373u, 1880790961315660012u},
+    {17870034976990372916u, 1175494350822287507u},
+    {17725857702810578241u, 1469367938527859384u},
+    {3710578054803671186u, 1836709923159824231u},
+    {26536550077201078u, 2295887403949780289u},
+    {11545800389866720434u, 1434929627468612680u},
+    {14432250487333400542u, 1793662034335765850u},
+    {8816941072311974870u, 2242077542919707313u},
+    {17039803216263454053u, 1401298464324817070u},
+    {12076381983474541759u, 1751623080406021338u},
+    {5872105442488401391u, 2189528850507526673u},
+    {15199280947623720629u, 1368455531567204170u},
+    {9775729147674874978u, 1710569414459005213u},
+    {16831347453020981627u, 2138211768073756516u},
+    {1296220121283337709u, 1336382355046097823u},
+    {15455333206886335848u, 1670477943807622278u},
+    {10095794471753144002u, 2088097429759527848u},
+    {6309871544845715001u, 1305060893599704905u},
+    {12499025449484531656u, 1631326116999631131u},
+    {11012095793428276666u, 2039157646249538914u},
+    {11494245889320060820u, 1274473528905961821u},
+    {532749306367912313u, 1593091911132452277u},
+    {5277622651387278295u, 1991364888915565346u},
+    {7910200175544436838u, 1244603055572228341u},
+    {14499436237857933952u, 1555753819465285426u},
+    {8900923260467641632u, 1944692274331606783u},
+    {12480606065433357876u, 1215432671457254239u},
+    {10989071563364309441u, 1519290839321567799u},
+    {9124653435777998898u, 1899113549151959749u},
+    {8008751406574943263u, 1186945968219974843u},
+    {5399253239791291175u, 1483682460274968554u},
+    {15972438586593889776u, 1854603075343710692u},
+    {759402079766405302u, 1159126922089819183u},
+    {14784310654990170340u, 1448908652612273978u},
+    {9257016281882937117u, 1811135815765342473u},
+    {16182956370781059300u, 2263919769706678091u},
+    {7808504722524468110u, 1414949856066673807u},
+    {5148944884728197234u, 1768687320083342259u},
+    {1824495087482858639u, 2210859150104177824u},
+    {1140309429676786649u, 1381786968815111140u},
+    {1425386787095983311u, 1727233711018888925u},
+    {6393419502297367043u, 2159042138773611156u},
+    {13219259225790630210u, 1349401336733506972u},
+    {16524074032238287762u, 1686751670916883715u},
+    {16043406521870471799u, 2108439588646104644u},
+    {803757039314269066u, 1317774742903815403u},
+    {14839754354425000045u, 1647218428629769253u},
+    {4714634887749086344u, 2059023035787211567u},
+    {9864175832484260821u, 1286889397367007229u},
+    {16941905809032713930u, 1608611746708759036u},
+    {2730638187581340797u, 2010764683385948796u},
+    {10930020904093113806u, 1256727927116217997u},
+    {18274212148543780162u, 1570909908895272496u},
+    {4396021111970173586u, 1963637386119090621u},
+    {5053356204195052443u, 1227273366324431638u},
+    {15540067292098591362u, 1534091707905539547u},
+    {14813398096695851299u, 1917614634881924434u},
+    {13870059828862294966u, 1198509146801202771u},
+    {12725888767650480803u, 1498136433501503464u},
+    {15907360959563101004u, 1872670541876879330u},
+    {14553786618154326031u, 1170419088673049581u},
+    {4357175217410743827u, 1463023860841311977u},
+    {10058155040190817688u, 1828779826051639971u},
+    {7961007781811134206u, 2285974782564549964u},
+    {14199001900486734687u, 1428734239102843727u},
+    {13137066357181030455u, 1785917798878554659u},
+    {11809646928048900164u, 2232397248598193324u},
+    {16604401366885338411u, 1395248280373870827u},
+    {16143815690179285109u, 1744060350467338534u},
+    {10956397575869330579u, 2180075438084173168u},
+    {6847748484918331612u, 1362547148802608230u},
+    {17783057643002690323u, 1703183936003260287u},
+    {17617136035325974999u, 2128979920004075359u},
+    {17928239049719816230u, 1330612450002547099u},
+    {17798612793722382384u, 1663265562503183874u},
+    {13024893955298202172u, 2079081953128979843u},
+    {5834715712847682405u, 1299426220705612402u},
+    {16516766677914378815u, 1624282775882015502u},
+    {11422586310538197711u, 2030353469852519378u},
+    {11750802462513761473u, 1268970918657824611u},
+    {10076817059714813937u, 1586213648322280764u},
+    {12596021324643517422u, 1982767060402850955u},
+    {5566670318688504437u, 1239229412751781847u},
+    {2346651879933242642u, 1549036765939727309u},
+    {7545000868343941206u, 1936295957424659136u},
+    {4715625542714963254u, 1210184973390411960u},
+    {5894531928393704067u, 1512731216738014950u},
+    {16591536947346905892u, 1890914020922518687u},
+    {17287239619732898039u, 1181821263076574179u},
+    {16997363506238734644u, 1477276578845717724u},
+    {2799960309088866689u, 1846595723557147156u},
+    {10973347230035317489u, 1154122327223216972u},
+    {13716684037544146861u, 1442652909029021215u},
+    {12534169028502795672u, 1803316136286276519u},
+    {11056025267201106687u, 2254145170357845649u},
+    {18439230838069161439u, 1408840731473653530u},
+    {13825666510731675991u, 1761050914342066913u},
+    {3447025083132431277u, 2201313642927583642u},
+    {6766076695385157452u, 1375821026829739776u},
+    {8457595869231446815u, 1719776283537174720u},
+    {10571994836539308519u, 2149720354421468400u},
+    {6607496772837067824u, 1343575221513417750u},
+    {17482743002901110588u, 1679469026891772187u},
+    {17241742735199000331u, 2099336283614715234u},
+    {15387775227926763111u, 1312085177259197021u},
+    {5399660979626290177u, 1640106471573996277u},
+    {11361262242960250625u, 2050133089467495346u},
+    {11712474920277544544u, 1281333180917184591u},
+    {10028907631919542777u, 1601666476146480739u},
+    {7924448521472040567u, 2002083095183100924u},
+    {14176152362774801162u, 1251301934489438077u},
+    {3885132398186337741u, 1564127418111797597u},
+    {9468101516160310080u, 1955159272639746996u},
+    {15140935484454969608u, 1221974545399841872u},
+    {479425281859160394u, 1527468181749802341u},
+    {5210967620751338397u, 1909335227187252926u},
+    {17091912818251750210u, 1193334516992033078u},
+    {12141518985959911954u, 1491668146240041348u},
+    {15176898732449889943u, 1864585182800051685u},
+    {11791404716994875166u, 1165365739250032303u},
+    {10127569877816206054u, 1456707174062540379u},
+    {8047776328842869663u, 1820883967578175474u},
+    {836348374198811271u, 2276104959472719343u},
+    {7440246761515338900u, 1422565599670449589u},
+    {13911994470321561530u, 1778206999588061986u},
+    {8166621051047176104u, 2222758749485077483u},
+    {2798295147690791113u, 1389224218428173427u},
+    {17332926989895652603u, 1736530273035216783u},
+    {17054472718942177850u, 2170662841294020979u},
+    {8353202440125167204u, 1356664275808763112u},
+    {10441503050156459005u, 1695830344760953890u},
+    {3828506775840797949u, 2119787930951192363u},
+    {86973725686804766u, 1324867456844495227u},
+    {13943775212390669669u, 1656084321055619033u},
+    {3594660960206173375u, 2070105401319523792u},
+    {2246663100128858359u, 1293815875824702370u},
+    {12031700912015848757u, 1617269844780877962u},
+    {5816254103165035138u, 2021587305976097453u},
+    {5941001823691840913u, 1263492066235060908u},
+    {7426252279614801142u, 1579365082793826135u},
+    {4671129331091113523u, 1974206353492282669u},
+    {5225298841145639904u, 1233878970932676668u},
+    {6531623551432049880u, 1542348713665845835u},
+    {3552843420862674446u, 1927935892082307294u},
+    {16055585193321335241u, 1204959932551442058u},
+    {10846109454796893243u, 1506199915689302573u},
+    {18169322836923504458u, 1882749894611628216u},
+    {11355826773077190286u, 1176718684132267635u},
+    {9583097447919099954u, 1470898355165334544u},
+    {11978871809898874942u, 1838622943956668180u},
+    {14973589762373593678u, 2298278679945835225u},
+    {2440964573842414192u, 1436424174966147016u},
+    {3051205717303017741u, 1795530218707683770u},
+    {13037379183483547984u, 2244412773384604712u},
+    {8148361989677217490u, 1402757983365377945u},
+    {14797138505523909766u, 1753447479206722431u},
+    {13884737113477499304u, 2191809349008403039u},
+    {15595489723564518921u, 1369880843130251899u},
+    {14882676136028260747u, 1712351053912814874u},
+    {9379973133180550126u, 2140438817391018593u},
+    {17391698254306313589u, 1337774260869386620u},
+    {3292878744173340370u, 1672217826086733276u},
+    {4116098430216675462u, 2090272282608416595u},
+    {266718509671728212u, 1306420176630260372u},
+    {333398137089660265u, 1633025220787825465u},
+    {5028433689789463235u, 2041281525984781831u},
+    {10060300083759496378u, 1275800953740488644u},
+    {12575375104699370472u, 1594751192175610805u},
+    {1884160825592049379u, 1993438990219513507u},
+    {17318501580490888525u, 1245899368887195941u},
+    {7813068920331446945u, 1557374211108994927u},
+    {5154650131986920777u, 1946717763886243659u},
+    {915813323278131534u, 1216698602428902287u},
+    {14979824709379828129u, 1520873253036127858u},
+    {9501408849870009354u, 1901091566295159823u},
+    {12855909558809837702u, 1188182228934474889u},
+    {2234828893230133415u, 1485227786168093612u},
+    {2793536116537666769u, 1856534732710117015u},
+    {8663489100477123587u, 1160334207943823134u},
+    {1605989338741628675u, 1450417759929778918u},
+    {11230858710281811652u, 1813022199912223647u},
+    {9426887369424876662u, 2266277749890279559u},
+    {12809333633531629769u, 1416423593681424724u},
+    {16011667041914537212u, 1770529492101780905u},
+    {6179525747111007803u, 2213161865127226132u},
+    {13085575628799155685u, 1383226165704516332u},
+    {16356969535998944606u, 1729032707130645415u},
+    {15834525901571292854u, 2161290883913306769u},
+    {2979049660840976177u, 1350806802445816731u},
+    {17558870131333383934u, 1688508503057270913u},
+    {8113529608884566205u, 2110635628821588642u},
+    {9682642023980241782u, 1319147268013492901u},
+    {16714988548402690132u, 1648934085016866126u},
+    {11670363648648586857u, 2061167606271082658u},
+    {11905663298832754689u, 1288229753919426661u},
+    {1047021068258779650u, 1610287192399283327u},
+    {15143834390605638274u, 2012858990499104158u},
+    {4853210475701136017u, 1258036869061940099u},
+    {1454827076199032118u, 1572546086327425124u},
+    {1818533845248790147u, 1965682607909281405u},
+    {3442426662494187794u, 1228551629943300878u},
+    {13526405364972510550u, 1535689537429126097u},
+    {3072948650933474476u, 1919611921786407622u},
+    {15755650962115585259u, 1199757451116504763u},
+    {15082877684217093670u, 1499696813895630954u},
+    {9630225068416591280u, 1874621017369538693u},
+    {8324733676974063502u, 1171638135855961683u},
+    {5794231077790191473u, 1464547669819952104u},
+    {7242788847237739342u, 1830684587274940130u},
+    {18276858095901949986u, 2288355734093675162u},
+    {16034722328366106645u, 1430222333808546976u},
+    {1596658836748081690u, 1787777917260683721u},
+    {6607509564362490017u, 2234722396575854651u},
+    {1823850468512862308u, 1396701497859909157u},
+    {6891499104068465790u, 1745876872324886446u},
+    {17837745916940358045u, 2182346090406108057u},
+    {4231062170446641922u, 1363966306503817536u},
+    {5288827713058302403u, 1704957883129771920u},
+    {6611034641322878003u, 2131197353912214900u},
+    {13355268687681574560u, 1331998346195134312u},
+    {16694085859601968200u, 1664997932743917890u},
+    {11644235287647684442u, 2081247415929897363u},
+    {4971804045566108824u, 1300779634956185852u},
+    {6214755056957636030u, 1625974543695232315u},
+    {3156757802769657134u, 2032468179619040394u},
+    {6584659645158423613u, 1270292612261900246u},
+    {17454196593302805324u, 1587865765327375307u},
+    {17206059723201118751u, 1984832206659219134u},
+    {6142101308573311315u, 1240520129162011959u},
+    {3065940617289251240u, 1550650161452514949u},
+    {8444111790038951954u, 1938312701815643686u},
+    {665883850346957067u, 1211445438634777304u},
+    {832354812933696334u, 1514306798293471630u},
+    {10263815553021896226u, 1892883497866839537u},
+    {17944099766707154901u, 1183052186166774710u},
+    {13206752671529167818u, 1478815232708468388u},
+    {16508440839411459773u, 1848519040885585485u},
+    {12623618533845856310u, 1155324400553490928u},
+    {15779523167307320387u, 1444155500691863660u},
+    {1277659885424598868u, 1805194375864829576u},
+    {1597074856780748586u, 2256492969831036970u},
+    {5609857803915355770u, 1410308106144398106u},
+    {16235694291748970521u, 1762885132680497632u},
+    {1847873790976661535u, 2203606415850622041u},
+    {12684136165428883219u, 1377254009906638775u},
+    {11243484188358716120u, 1721567512383298469u},
+    {219297180166231438u, 2151959390479123087u},
+    {7054589765244976505u, 1344974619049451929u},
+    {13429923224983608535u, 1681218273811814911u},
+    {12175718012802122765u, 2101522842264768639u},
+    {14527352785642408584u, 1313451776415480399u},
+    {13547504963625622826u, 1641814720519350499u},
+    {12322695186104640628u, 2052268400649188124u},
+    {16925056528170176201u, 1282667750405742577u},
+    {7321262604930556539u, 1603334688007178222u},
+    {18374950293017971482u, 2004168360008972777u},
+    {4566814905495150320u, 1252605225005607986u},
+    {14931890668723713708u, 1565756531257009982u},
+    {9441491299049866327u, 1957195664071262478u},
+    {1289246043478778550u, 1223247290044539049u},
+    {6223243572775861092u, 1529059112555673811u},
+    {3167368447542438461u, 1911323890694592264u},
+    {1979605279714024038u, 1194577431684120165u},
+    {7086192618069917952u, 1493221789605150206u},
+    {18081112809442173248u, 1866527237006437757u},
+    {13606538515115052232u, 1166579523129023598u},
+    {7784801107039039482u, 1458224403911279498u},
+    {507629346944023544u, 1822780504889099373u},
+    {5246222702107417334u, 2278475631111374216u},
+    {3278889188817135834u, 1424047269444608885u},
+    {8710297504448807696u, 1780059086805761106u},
+};
+
+// Powers of ten from 10^-348 to 10^347 for the Eisel-Lemire algorithm,
+// normalized so that the top bit is set and rounded down to 128 bits.
+static constexpr int __pow10_min_exponent = -348;
+static constexpr int __pow10_max_exponent = 347;
+static constexpr uint64_t __pow10_split[696][2] = {
+    {1671618768450675795u, 18054884314459144840u},
+    {1044761730281672372u, 11284302696536965525u},
+    {5917638181279478369u, 14105378370671206906u},
+    {16620419763454123769u, 17631722963339008632u},
+    {10387762352158827356u, 11019826852086880395u},
+    {8373016921771146291u, 13774783565108600494u},
+    {1242899115359157055u, 17218479456385750618u},
+    {5388497965526861063u, 10761549660241094136u},
+    {6735622456908576329u, 13451937075301367670u},
+    {17642900107990496220u, 16814921344126709587u},
+    {8720969558280366185u, 10509325840079193492u},
+    {10901211947850457732u, 13136657300098991865u},
+    {18238200953240460069u, 16420821625123739831u},
+    {18316404623416369399u, 10263013515702337394u},
+    {13672133742415685941u, 12828766894627921743u},
+    {12478481159592219522u, 16035958618284902179u},
+    {5493207715531443249u, 10022474136428063862u},
+    {16089881681269079869u, 12528092670535079827u},
+    {15500666083158961933u, 15660115838168849784u},
+    {9687916301974351208u, 9787572398855531115u},
+    {7498209359040551106u, 12234465498569413894u},
+    {149389661945913074u, 15293081873211767368u},
+    {93368538716195671u, 9558176170757354605u},
+    {4728396691822632493u, 11947720213446693256u},
+    {5910495864778290617u, 14934650266808366570u},
+    {8305745933913819539u, 9334156416755229106u},
+    {1158810380537498616u, 11667695520944036383u},
+    {15283571030954036982u, 14584619401180045478u},
+    {9881091751837770420u, 18230774251475056848u},
+    {6175682344898606512u, 11394233907171910530u},
+    {16942974967978033949u, 14242792383964888162u},
+    {11955346673117766628u, 17803490479956110203u},
+    {5166248661484910190u, 11127181549972568877u},
+    {11069496845283525642u, 13908976937465711096u},
+    {13836871056604407053u, 17386221171832138870u},
+    {4036358391950366504u, 10866388232395086794u},
+    {14268820026792733938u, 13582985290493858492u},
+    {17836025033490917422u, 16978731613117323115u},
+    {8841672636718129437u, 10611707258198326947u},
+    {6440404777470273892u, 13264634072747908684u},
+    {8050505971837842365u, 16580792590934885855u},
+    {11949095260039733334u, 10362995369334303659u},
+    {10324683056622278764u, 12953744211667879574u},
+    {3682481783923072647u, 16192180264584849468u},
+    {11524923151806696212u, 10120112665365530917u},
+    {571095884476206553u, 12650140831706913647u},
+    {14548927910877421904u, 15812676039633642058u},
+    {13704765962725776594u, 9882922524771026286u},
+    {7907585416552444934u, 12353653155963782858u},
+    {661109733835780360u, 15442066444954728573u},
+    {2719036592861056677u, 9651291528096705358u},
+    {12622167777931096654u, 12064114410120881697u},
+    {1942651667131707105u, 15080143012651102122u},
+    {5825843310384704845u, 9425089382906938826u},
+    {16505676174835656864u, 11781361728633673532u},
+    {2185351144835019464u, 14726702160792091916u},
+    {2731688931043774330u, 18408377700990114895u},
+    {8624834609543440812u, 11505236063118821809u},
+    {15392729280356688919u, 14381545078898527261u},
+    {5405853545163697437u, 17976931348623159077u},
+    {5684501474941004850u, 11235582092889474423u},
+    {2493940825248868159u, 14044477616111843029u},
+    {7729112049988473103u, 17555597020139803786u},
+    {9442381049670183593u, 10972248137587377366u},
+    {2579604275232953683u, 13715310171984221708u},
+    {3224505344041192104u, 17144137714980277135u},
+    {8932844867666826921u, 10715086071862673209u},
+    {15777742103010921555u, 13393857589828341511u},
+    {15110491610336264040u, 16742321987285426889u},
+    {2526528228819083169u, 10463951242053391806u},
+    {12381532322878629770u, 13079939052566739757u},
+    {1641857348316123500u, 16349923815708424697u},
+    {12555375888766046947u, 10218702384817765435u},
+    {11082533842530170780u, 12773377981022206794u},
+    {4629795266307937667u, 15966722476277758493u},
+    {5199465050656154994u, 9979201547673599058u},
+    {15722703350174969551u, 12474001934591998822u},
+    {10430007150863936130u, 15592502418239998528u},
+    {6518754469289960081u, 9745314011399999080u},
+    {8148443086612450102u, 12181642514249998850u},
+    {962181821410786819u, 15227053142812498563u},
+    {16742264702877599426u, 9516908214257811601u},
+    {7092772823314835570u, 11896135267822264502u},
+    {18089338065998320271u, 14870169084777830627u},
+    {8999993282035256217u, 9293855677986144142u},
+    {2026619565689294464u, 11617319597482680178u},
+    {11756646493966393888u, 14521649496853350222u},
+    {5472436080603216552u, 18152061871066687778u},
+    {8031958568804398249u, 11345038669416679861u},
+    {14651634229432885715u, 14181298336770849826u},
+    {9091170749936331336u, 17726622920963562283u},
+    {3376138709496513133u, 11079139325602226427u},
+    {18055231442152805128u, 13848924157002783033u},
+    {8733981247408842698u, 17311155196253478792u},
+    {5458738279630526686u, 10819471997658424245u},
+    {11435108867965546262u, 13524339997073030306u},
+    {5070514048102157020u, 16905424996341287883u},
+    {863228270850154185u, 10565890622713304927u},
+    {14914093393844856443u, 13207363278391631158u},
+    {9419244705451294746u, 16509204097989538948u},
+    {15110399977761835024u, 10318252561243461842u},
+    {9664627935347517973u, 12897815701554327303u},
+    {7469098900757009562u, 16122269626942909129u},
+    {16197401859041600736u, 10076418516839318205u},
+    {6411694268519837208u, 12595523146049147757u},
+    {12626303854077184414u, 15744403932561434696u},
+    {7891439908798240259u, 9840252457850896685u},
+    {14475985904425188227u, 12300315572313620856u},
+    {18094982380531485284u, 15375394465392026070u},
+    {6697677969404790399u, 9609621540870016294u},
+    {17595469498610763806u, 12012026926087520367u},
+    {17382650854836066854u, 15015033657609400459u},
+    {8558313775058847832u, 9384396036005875287u},
+    {6086206200396171886u, 11730495045007344109u},
+    {12219443768922602761u, 14663118806259180136u},
+    {15274304711153253452u, 18328898507823975170u},
+    {14158126462898171311u, 11455561567389984481u},
+    {3862600023340550427u, 14319451959237480602u},
+    {14051622066030463842u, 17899314949046850752u},
+    {8782263791269039901u, 11187071843154281720u},
+    {10977829739086299876u, 13983839803942852150u},
+    {4498915137003099037u, 17479799754928565188u},
+    {12035193997481712706u, 10924874846830353242u},
+    {5820620459997365075u, 13656093558537941553u},
+    {11887461593424094248u, 17070116948172426941u},
+    {9735506505103752857u, 10668823092607766838u},
+    {2946011094524915263u, 13336028865759708548u},
+    {3682513868156144079u, 16670036082199635685u},
+    {4607414176811284001u, 10418772551374772303u},
+    {1147581702586717097u, 13023465689218465379u},
+    {15269535183515560084u, 16279332111523081723u},
+    {7237616480483531100u, 10174582569701926077u},
+    {13658706619031801779u, 12718228212127407596u},
+    {17073383273789752224u, 15897785265159259495u},
+    {17588393573759676996u, 9936115790724537184u},
+    {3538747893490044629u, 12420144738405671481u},
+    {9035120885289943691u, 15525180923007089351u},
+    {12564479580947296663u, 9703238076879430844u},
+    {15705599476184120828u, 12129047596099288555u},
+    {15020313326802763131u, 15161309495124110694u},
+    {4776009810824339053u, 9475818434452569184u},
+    {5970012263530423816u, 11844773043065711480u},
+    {7462515329413029771u, 14805966303832139350u},
+    {52386062455755702u, 9253728939895087094u},
+    {9288854614924470436u, 11567161174868858867u},
+    {6999382250228200141u, 14458951468586073584u},
+    {8749227812785250177u, 18073689335732591980u},
+    {14691639419845557168u, 11296055834832869987u},
+    {13752863256379558556u, 14120069793541087484u},
+    {17191079070474448196u, 17650087241926359355u},
+    {8438581409832836170u, 11031304526203974597u},
+    {15159912780718433117u, 13789130657754968246u},
+    {9726518939043265588u, 17236413322193710308u},
+    {15302446373756816800u, 10772758326371068942u},
+    {9904685930341245193u, 13465947907963836178u},
+    {3157485376071780683u, 16832434884954795223u},
+    {8890957387685944783u, 10520271803096747014u},
+    {1890324697752655170u, 13150339753870933768u},
+    {2362905872190818963u, 16437924692338667210u},
+    {6088502188546649756u, 10273702932711667006u},
+    {16833999772538088003u, 12842128665889583757u},
+    {7207441660390446292u, 16052660832361979697u},
+    {16033866083812498692u, 10032913020226237310u},
+    {10818960567910847557u, 12541141275282796638u},
+    {4300328673033783639u, 15676426594103495798u},
+    {16522763475928278486u, 9797766621314684873u},
+    {6818396289628184396u, 12247208276643356092u},
+    {8522995362035230495u, 15309010345804195115u},
+    {3021029092058325107u, 9568131466127621947u},
+    {17611344420355070096u, 11960164332659527433u},
+    {8179122470161673908u, 14950205415824409292u},
+    {14335323580705822000u, 9343878384890255807u},
+    {13307468457454889596u, 11679847981112819759u},
+    {12022649553391224092u, 14599809976391024699u},
+    {10416625923311642211u, 18249762470488780874u},
+    {11122077220497164286u, 11406101544055488046u},
+    {4679224488766679549u, 14257626930069360058u},
+    {15072402647813125244u, 17822033662586700072u},
+    {9420251654883203278u, 11138771039116687545u},
+    {16387000587031392001u, 13923463798895859431u},
+    {15872064715361852097u, 17404329748619824289u},
+    {3002511419460075705u, 10877706092887390181u},
+    {8364825292752482535u, 13597132616109237726u},
+    {1232659579085827361u, 16996415770136547158u},
+    {14605470292210805812u, 10622759856335341973u},
+    {4421779809981343554u, 13278449820419177467u},
+    {915538744049291538u, 16598062275523971834u},
+    {5183897733458195115u, 10373788922202482396u},
+    {6479872166822743894u, 12967236152753102995u},
+    {3488154190101041964u, 16209045190941378744u},
+    {2180096368813151227u, 10130653244338361715u},
+    {16560178516298602746u, 12663316555422952143u},
+    {16088537126945865529u, 15829145694278690179u},
+    {7749492695127472003u, 9893216058924181362u},
+    {463493832054564196u, 12366520073655226703u},
+    {14414425345350368957u, 15458150092069033378u},
+    {13620701859271368502u, 9661343807543145861u},
+    {3190819268807046916u, 12076679759428932327u},
+    {17823582141290972357u, 15095849699286165408u},
+    {11139738838306857723u, 9434906062053853380u},
+    {13924673547883572154u, 11793632577567316725u},
+    {3570783879572301480u, 14742040721959145907u},
+    {18298537904747540562u, 18427550902448932383u},
+    {18354115218108294707u, 11517219314030582739u},
+    {18330958004207980480u, 14396524142538228424u},
+    {4466953431550423984u, 17995655178172785531u},
+    {486002885505321038u, 11247284486357990957u},
+    {5219189625309039202u, 14059105607947488696u},
+    {6523987031636299002u, 17573882009934360870u},
+    {17912549950054850588u, 10983676256208975543u},
+    {17779001419141175331u, 13729595320261219429u},
+    {8388693718644305452u, 17161994150326524287u},
+    {12160462601793772764u, 10726246343954077679u},
+    {10588892233814828051u, 13407807929942597099u},
+    {8624429273841147159u, 16759759912428246374u},
+    {778582277723329070u, 10474849945267653984u},
+    {973227847154161338u, 13093562431584567480u},
+    {1216534808942701673u, 16366953039480709350u},
+    {14595392310871352257u, 10229345649675443343u},
+    {13632554370161802418u, 12786682062094304179u},
+    {12429006944274865118u, 15983352577617880224u},
+    {7768129340171790699u, 9989595361011175140u},
+    {9710161675214738374u, 12486994201263968925u},
+    {16749388112445810871u, 15608742751579961156u},
+    {1244995533423855986u, 9755464219737475723u},
+    {15391302472061983695u, 12194330274671844653u},
+    {5404070034795315907u, 15242912843339805817u},
+    {14906758817815542202u, 9526820527087378635u},
+    {14021762503842039848u, 11908525658859223294u},
+    {8303831092947774002u, 14885657073574029118u},
+    {578208414664970847u, 9303535670983768199u},
+    {14557818573613377271u, 11629419588729710248u},
+    {18197273217016721589u, 14536774485912137810u},
+    {13523219484416126178u, 18170968107390172263u},
+    {15369541205401160717u, 11356855067118857664u},
+    {765182433041899281u, 14196068833898572081u},
+    {5568164059729762005u, 17745086042373215101u},
+    {5785945546544795205u, 11090678776483259438u},
+    {16455803970035769814u, 13863348470604074297u},
+    {6734696907262548556u, 17329185588255092872u},
+    {4209185567039092847u, 10830740992659433045u},
+    {9873167977226253963u, 13538426240824291306u},
+    {3118087934678041646u, 16923032801030364133u},
+    {4254647968387469981u, 10576895500643977583u},
+    {706623942056949572u, 13221119375804971979u},
+    {14718337982853350677u, 16526399219756214973u},
+    {11504804248497038125u, 10328999512347634358u},
+    {5157633273766521849u, 12911249390434542948u},
+    {6447041592208152311u, 16139061738043178685u},
+    {6335244004343789146u, 10086913586276986678u},
+    {17142427042284512241u, 12608641982846233347u},
+    {16816347784428252397u, 15760802478557791684u},
+    {1286845328412881940u, 9850501549098619803u},
+    {15443614715798266137u, 12313126936373274753u},
+    {5469460339465668959u, 15391408670466593442u},
+    {8030098730593431003u, 9619630419041620901u},
+    {14649309431669176658u, 12024538023802026126u},
+    {9088264752731695015u, 15030672529752532658u},
+    {10291851488884697288u, 9394170331095332911u},
+    {8253128342678483706u, 11742712913869166139u},
+    {5704724409920716729u, 14678391142336457674u},
+    {16354277549255671720u, 18347988927920572092u},
+    {998051431430019017u, 11467493079950357558u},
+    {10470936326142299579u, 14334366349937946947u},
+    {8476984389250486570u, 17917957937422433684u},
+    {14521487280136329914u, 11198723710889021052u},
+    {18151859100170412392u, 13998404638611276315u},
+    {18078137856785627587u, 17498005798264095394u},
+    {15910522178918405146u, 10936253623915059621u},
+    {6053094668365842720u, 13670317029893824527u},
+    {2954682317029915496u, 17087896287367280659u},
+    {17987577512639554849u, 10679935179604550411u},
+    {17872785872372055657u, 13349918974505688014u},
+    {13117610303610293764u, 16687398718132110018u},
+    {12810192458183821506u, 10429624198832568761u},
+    {2177682517447613171u, 13037030248540710952u},
+    {2722103146809516464u, 16296287810675888690u},
+    {6313000485183335694u, 10185179881672430431u},
+    {3279564588051781713u, 12731474852090538039u},
+    {17934513790346890853u, 15914343565113172548u},
+    {1985699082112030975u, 9946464728195732843u},
+    {16317181907922202431u, 12433080910244666053u},
+    {6561419329620589327u, 15541351137805832567u},
+    {11018416108653950185u, 9713344461128645354u},
+    {4549648098962661924u, 12141680576410806693u},
+    {10298746142130715309u, 15177100720513508366u},
+    {1825030320404309164u, 9485687950320942729u},
+    {6892973918932774359u, 11857109937901178411u},
+    {4004531380238580045u, 14821387422376473014u},
+    {16337890167931276240u, 9263367138985295633u},
+    {6587304654631931588u, 11579208923731619542u},
+    {17457502855144690293u, 14474011154664524427u},
+    {17210192550503474962u, 18092513943330655534u},
+    {6144684325637283947u, 11307821214581659709u},
+    {12292541425473992838u, 14134776518227074636u},
+    {15365676781842491048u, 17668470647783843295u},
+    {16521077016292638761u, 11042794154864902059u},
+    {16039660251938410547u, 13803492693581127574u},
+    {10826203278068237376u, 17254365866976409468u},
+    {15989749085647424168u, 10783978666860255917u},
+    {6152128301777116498u, 13479973333575319897u},
+    {12301846395648783526u, 16849966666969149871u},
+    {14606183024921571560u, 10531229166855718669u},
+    {4422670725869800738u, 13164036458569648337u},
+    {10140024425764638826u, 16455045573212060421u},
+    {8643358275316593218u, 10284403483257537763u},
+    {6192511825718353619u, 12855504354071922204u},
+    {7740639782147942024u, 16069380442589902755u},
+    {2532056854628769813u, 10043362776618689222u},
+    {12388443105140738074u, 12554203470773361527u},
+    {10873867862998534689u, 15692754338466701909u},
+    {9102010423587778132u, 9807971461541688693u},
+    {15989199047912110569u, 12259964326927110866u},
+    {10763126773035362404u, 15324955408658888583u},
+    {13644483260788183358u, 9578097130411805364u},
+    {17055604075985229198u, 11972621413014756705u},
+    {7484447039699372786u, 14965776766268445882u},
+    {9289465418239495895u, 9353610478917778676u},
+    {11611831772799369869u, 11692013098647223345u},
+    {679731660717048624u, 14615016373309029182u},
+    {10073036612751086588u, 18268770466636286477u},
+    {8601490892183123069u, 11417981541647679048u},
+    {10751863615228903837u, 14272476927059598810u},
+    {4216457482181353988u, 17840596158824498513u},
+    {14164500972431816002u, 11150372599265311570u},
+    {8482254178684994195u, 13937965749081639463u},
+    {5991131704928854840u, 17422457186352049329u},
+    {15273672361649004035u, 10889035741470030830u},
+    {9868718415206479236u, 13611294676837538538u},
+    {3112525982153323237u, 17014118346046923173u},
+    {4251171748059520975u, 10633823966279326983u},
+    {702278666647013314u, 13292279957849158729u},
+    {5489534351736154547u, 16615349947311448411u},
+    {1125115960621402640u, 10384593717069655257u},
+    {6018080969204141204u, 12980742146337069071u},
+    {2910915193077788601u, 16225927682921336339u},
+    {17960223060169475539u, 10141204801825835211u},
+    {17838592806784456520u, 12676506002282294014u},
+    {13074868971625794843u, 15845632502852867518u},
+    {3560107088838733872u, 9903520314283042199u},
+    {18285191916330581053u, 12379400392853802748u},
+    {4409745821703674700u, 15474250491067253436u},
+    {11979463175419572495u, 9671406556917033397u},
+    {1139270913992301907u, 12089258196146291747u},
+    {15259146697772541096u, 15111572745182864683u},
+    {7231123676894144233u, 9444732965739290427u},
+    {4427218577690292387u, 11805916207174113034u},
+    {14757395258967641292u, 14757395258967641292u},
+    {0u, 9223372036854775808u},
+    {0u, 11529215046068469760u},
+    {0u, 14411518807585587200u},
+    {0u, 18014398509481984000u},
+    {0u, 11258999068426240000u},
+    {0u, 14073748835532800000u},
+    {0u, 17592186044416000000u},
+    {0u, 10995116277760000000u},
+    {0u, 13743895347200000000u},
+    {0u, 17179869184000000000u},
+    {0u, 10737418240000000000u},
+    {0u, 13421772800000000000u},
+    {0u, 16777216000000000000u},
+    {0u, 10485760000000000000u},
+    {0u, 13107200000000000000u},
+    {0u, 16384000000000000000u},
+    {0u, 10240000000000000000u},
+    {0u, 12800000000000000000u},
+    {0u, 16000000000000000000u},
+    {0u, 10000000000000000000u},
+    {0u, 12500000000000000000u},
+    {0u, 15625000000000000000u},
+    {0u, 9765625000000000000u},
+    {0u, 12207031250000000000u},
+    {0u, 15258789062500000000u},
+    {0u, 9536743164062500000u},
+    {0u, 11920928955078125000u},
+    {0u, 14901161193847656250u},
+    {4611686018427387904u, 9313225746154785156u},
+    {5764607523034234880u, 11641532182693481445u},
+    {11817445422220181504u, 14551915228366851806u},
+    {5548434740920451072u, 18189894035458564758u},
+    {17302829768357445632u, 11368683772161602973u},
+    {7793479155164643328u, 14210854715202003717u},
+    {14353534962383192064u, 17763568394002504646u},
+    {4359273333062107136u, 11102230246251565404u},
+    {5449091666327633920u, 13877787807814456755u},
+    {2199678564482154496u, 17347234759768070944u},
+    {1374799102801346560u, 10842021724855044340u},
+    {1718498878501683200u, 13552527156068805425u},
+    {6759809616554491904u, 16940658945086006781u},
+    {6530724019560251392u, 10587911840678754238u},
+    {17386777061305090048u, 13234889800848442797u},
+    {7898413271349198848u, 16543612251060553497u},
+    {16465723340661719040u, 10339757656912845935u},
+    {15970468157399760896u, 12924697071141057419u},
+    {15351399178322313216u, 16155871338926321774u},
+    {4982938468024057856u, 10097419586828951109u},
+    {10840359103457460224u, 12621774483536188886u},
+    {4327076842467049472u, 15777218104420236108u},
+    {11927795063396681728u, 9860761315262647567u},
+    {10298057810818464256u, 12325951644078309459u},
+    {8260886245095692416u, 15407439555097886824u},
+    {5163053903184807760u, 9629649721936179265u},
+    {11065503397408397604u, 12037062152420224081u},
+    {18443565265187884909u, 15046327690525280101u},
+    {13833071299956122020u, 9403954806578300063u},
+    {12679653106517764621u, 11754943508222875079u},
+    {11237880364719817872u, 14693679385278593849u},
+    {212292400617608628u, 18367099231598242312u},
+    {132682750386005392u, 11479437019748901445u},
+    {4777539456409894645u, 14349296274686126806u},
+    {15195296357367144114u, 17936620343357658507u},
+    {7191217214140771119u, 11210387714598536567u},
+    {4377335499248575995u, 14012984643248170709u},
+    {10083355392488107898u, 17516230804060213386u},
+    {10913783138732455340u, 10947644252537633366u},
+    {4418856886560793367u, 13684555315672041708u},
+    {5523571108200991709u, 17105694144590052135u},
+    {10369760970266701674u, 10691058840368782584u},
+    {12962201212833377092u, 13363823550460978230u},
+    {6979379479186945558u, 16704779438076222788u},
+    {13585484211346616781u, 10440487148797639242u},
+    {7758483227328495169u, 13050608935997049053u},
+    {14309790052588006865u, 16313261169996311316u},
+    {18166990819722280098u, 10195788231247694572u},
+    {4261994450943298507u, 12744735289059618216u},
+    {5327493063679123134u, 15930919111324522770u},
+    {7941369183226839863u, 9956824444577826731u},
+    {5315025460606161924u, 12446030555722283414u},
+    {15867153862612478214u, 15557538194652854267u},
+    {7611128154919104931u, 9723461371658033917u},
+    {14125596212076269068u, 12154326714572542396u},
+    {17656995265095336336u, 15192908393215677995u},
+    {8729779031470891258u, 9495567745759798747u},
+    {6300537770911226168u, 11869459682199748434u},
+    {17099044250493808518u, 14836824602749685542u},
+    {6075216638131242420u, 9273015376718553464u},
+    {7594020797664053025u, 11591269220898191830u},
+    {269153960225290473u, 14489086526122739788u},
+    {336442450281613091u, 18111358157653424735u},
+    {7127805559067090038u, 11319598848533390459u},
+    {4298070930406474644u, 14149498560666738074u},
+    {14595960699862869113u, 17686873200833422592u},
+    {9122475437414293195u, 11054295750520889120u},
+    {11403094296767866494u, 13817869688151111400u},
+    {14253867870959833118u, 17272337110188889250u},
+    {13520353437777283602u, 10795210693868055781u},
+    {3065383741939440791u, 13494013367335069727u},
+    {17666787732706464701u, 16867516709168837158u},
+    {6430056314514152534u, 10542197943230523224u},
+    {8037570393142690668u, 13177747429038154030u},
+    {823590954573587527u, 16472184286297692538u},
+    {5126430365035880108u, 10295115178936057836u},
+    {6408037956294850135u, 12868893973670072295u},
+    {3398361426941174765u, 16086117467087590369u},
+    {13653190937906703988u, 10053823416929743980u},
+    {17066488672383379985u, 12567279271162179975u},
+    {16721424822051837077u, 15709099088952724969u},
+    {3533361486141316317u, 9818186930595453106u},
+    {13640073894531421205u, 12272733663244316382u},
+    {7826720331309500698u, 15340917079055395478u},
+    {280014188641050032u, 9588073174409622174u},
+    {9573389772656088348u, 11985091468012027717u},
+    {16578423234247498339u, 14981364335015034646u},
+    {5749828502977298558u, 9363352709384396654u},
+    {16410657665576399005u, 11704190886730495817u},
+    {6678264026688335045u, 14630238608413119772u},
+    {8347830033360418806u, 18287798260516399715u},
+    {2911550761636567802u, 11429873912822749822u},
+    {12862810488900485560u, 14287342391028437277u},
+    {2243455055843443238u, 17859177988785546597u},
+    {3708002419115845976u, 11161986242990966623u},
+    {23317005467419566u, 13952482803738708279u},
+    {13864204312116438170u, 17440603504673385348u},
+    {17888499731927549664u, 10900377190420865842u},
+    {13137252628054661272u, 13625471488026082303u},
+    {11809879766640938686u, 17031839360032602879u},
+    {14298703881791668535u, 10644899600020376799u},
+    {13261693833812197764u, 13306124500025470999u},
+    {11965431273837859301u, 16632655625031838749u},
+    {9784237555362356015u, 10395409765644899218u},
+    {3006924907348169211u, 12994262207056124023u},
+    {17593714189467375226u, 16242827758820155028u},
+    {1772699331562333708u, 10151767349262596893u},
+    {6827560182880305039u, 12689709186578246116u},
+    {8534450228600381299u, 15862136483222807645u},
+    {7639874402088932264u, 9913835302014254778u},
+    {326470965756389522u, 12392294127517818473u},
+    {5019774725622874806u, 15490367659397273091u},
+    {831516194300602802u, 9681479787123295682u},
+    {10262767279730529310u, 12101849733904119602u},
+    {3605087062808385830u, 15127312167380149503u},
+    {9170708441896323000u, 9454570104612593439u},
+    {6851699533943015846u, 11818212630765741799u},
+    {3952938399001381903u, 14772765788457177249u},
+    {13999801545444333449u, 9232978617785735780u},
+    {17499751931805416812u, 11541223272232169725u},
+    {8039631859474607303u, 14426529090290212157u},
+    {14661225842770647033u, 18033161362862765196u},
+    {18386638188586430203u, 11270725851789228247u},
+    {18371611717305649850u, 14088407314736535309u},
+    {9129456591349898601u, 17610509143420669137u},
+    {17235125415662156385u, 11006568214637918210u},
+    {12320534732722919674u, 13758210268297397763u},
+    {10788982397476261688u, 17197762835371747204u},
+    {15966486035277439363u, 10748601772107342002u},
+    {10734735507242023396u, 13435752215134177503u},
+    {8806733365625141341u, 16794690268917721879u},
+    {12421737381156795194u, 10496681418073576174u},
+    {6303799689591218185u, 13120851772591970218u},
+    {17103121648843798539u, 16401064715739962772u},
+    {1466078993672598279u, 10250665447337476733u},
+    {6444284760518135752u, 12813331809171845916u},
+    {8055355950647669691u, 16016664761464807395u},
+    {2728754459941099604u, 10010415475915504622u},
+    {12634315111781150314u, 12513019344894380777u},
+    {1957835834444274180u, 15641274181117975972u},
+    {10447019433382447170u, 9775796363198734982u},
+    {3835402254873283155u, 12219745453998418728u},
+    {4794252818591603944u, 15274681817498023410u},
+    {7608094030047140369u, 9546676135936264631u},
+    {4898431519131537557u, 11933345169920330789u},
+    {10734725417341809851u, 14916681462400413486u},
+    {2097517367411243253u, 9322925914000258429u},
+    {7233582727691441970u, 11653657392500323036u},
+    {9041978409614302462u, 14567071740625403795u},
+    {6690786993590490174u, 18208839675781754744u},
+    {4181741870994056359u, 11380524797363596715u},
+    {615491320315182544u, 14225655996704495894u},
+    {9992736187248753989u, 17782069995880619867u},
+    {3939617107816777291u, 11113793747425387417u},
+    {9536207403198359517u, 13892242184281734271u},
+    {7308573235570561493u, 17365302730352167839u},
+    {11485387299872682789u, 10853314206470104899u},
+    {9745048106413465582u, 13566642758087631124u},
+    {12181310133016831978u, 16958303447609538905u},
+    {695789805494438130u, 10598939654755961816u},
+    {869737256868047663u, 13248674568444952270u},
+    {10310543607939835386u, 16560843210556190337u},
+    {17973304801030866876u, 10350527006597618960u},
+    {4019886927579031980u, 12938158758247023701u},
+    {9636544677901177879u, 16172698447808779626u},
+    {10634526442115624078u, 10107936529880487266u},
+    {4069786015789754290u, 12634920662350609083u},
+    {475546501309804958u, 15793650827938261354u},
+    {4908902581746016003u, 9871031767461413346u},
+    {15359500264037295811u, 12338789709326766682u},
+    {9976003293191843956u, 15423487136658458353u},
+    {17764217104313372233u, 9639679460411536470u},
+    {12981899343536939483u, 12049599325514420588u},
+    {16227374179421174354u, 15061999156893025735u},
+    {17059637889779315827u, 9413749473058141084u},
+    {2877803288514593168u, 11767186841322676356u},
+    {3597254110643241460u, 14708983551653345445u},
+    {9108253656731439729u, 18386229439566681806u},
+    {1080972517029761926u, 11491393399729176129u},
+    {5962901664714590312u, 14364241749661470161u},
+    {12065313099320625794u, 17955302187076837701u},
+    {9846663696289085073u, 11222063866923023563u},
+    {7696643601933968437u, 14027579833653779454u},
+    {397432465562684739u, 17534474792067224318u},
+    {14083453346258841674u, 10959046745042015198u},
+    {8380944645968776284u, 13698808431302518998u},
+    {1252808770606194547u, 17123510539128148748u},
+    {10006377518483647400u, 10702194086955092967u},
+    {7896285879677171346u, 13377742608693866209u},
+    {14482043368023852087u, 16722178260867332761u},
+    {2133748077373825698u, 10451361413042082976u},
+    {2667185096717282123u, 13064201766302603720u},
+    {3333981370896602653u, 16330252207878254650u},
+    {6695424375237764562u, 10206407629923909156u},
+    {8369280469047205703u, 12758009537404886445u},
+    {15073286604736395033u, 15947511921756108056u},
+    {9420804127960246895u, 9967194951097567535u},
+    {7164319141522920715u, 12458993688871959419u},
+    {4343712908476262990u, 15573742111089949274u},
+    {7326506586225052273u, 9733588819431218296u},
+    {9158133232781315341u, 12166986024289022870u},
+    {2224294504121868368u, 15208732530361278588u},
+    {10613556101930943538u, 9505457831475799117u},
+    {17878631145841067327u, 11881822289344748896u},
+    {3901544858591782542u, 14852277861680936121u},
+    {13967680582688333849u, 9282673663550585075u},
+    {12847914709933029407u, 11603342079438231344u},
+    {16059893387416286759u, 14504177599297789180u},
+    {1628122660560806833u, 18130221999122236476u},
+    {10240948699705280078u, 11331388749451397797u},
+    {17412871893058988002u, 14164235936814247246u},
+    {12542717829468959195u, 17705294921017809058u},
+    {12450884661845487401u, 11065809325636130661u},
+    {1728547772024695539u, 13832261657045163327u},
+    {15995742770313033136u, 17290327071306454158u},
+    {5385653213018257806u, 10806454419566533849u},
+    {11343752534700210161u, 13508068024458167311u},
+    {9568004649947874797u, 16885085030572709139u},
+    {3674159897003727796u, 10553178144107943212u},
+    {4592699871254659745u, 13191472680134929015u},
+    {1129188820640936778u, 16489340850168661269u},
+    {3011586022114279438u, 10305838031355413293u},
+    {8376168546070237202u, 12882297539194266616u},
+    {10470210682587796502u, 16102871923992833270u},
+    {1932195658189984910u, 10064294952495520794u},
+    {11638616609592256945u, 12580368690619400992u},
+    {14548270761990321182u, 15725460863274251240u},
+    {9092669226243950738u, 9828413039546407025u},
+    {15977522551232326327u, 12285516299433008781u},
+    {6136845133758244197u, 15356895374291260977u},
+    {15364743254667372383u, 9598059608932038110u},
+    {9982557031479439671u, 11997574511165047638u},
+    {3254824252494523781u, 14996968138956309548u},
+    {11257637194663853171u, 9373105086847693467u},
+    {9460360474902428559u, 11716381358559616834u},
+    {2602078556773259891u, 14645476698199521043u},
+    {17087656251248738576u, 18306845872749401303u},
+    {17597314184671543466u, 11441778670468375814u},
+    {12773270693984653525u, 14302223338085469768u},
+    {15966588367480816906u, 17877779172606837210u},
+    {14590803748102898470u, 11173611982879273256u},
+    {18238504685128623088u, 13967014978599091570u},
+    {13574758819556003052u, 17458768723248864463u},
+    {15401753289863583763u, 10911730452030540289u},
+    {5417133557047315992u, 13639663065038175362u},
+    {15994788983163920798u, 17049578831297719202u},
+    {14608429132904838403u, 10655986769561074501u},
+    {4425478360848884291u, 13319983461951343127u},
+    {920161932633717460u, 16649979327439178909u},
+    {2880944217109767365u, 10406237079649486818u},
+    {12824552308241985014u, 13007796349561858522u},
+    {6807318348447705459u, 16259745436952323153u},
+    {15783789013848285672u, 10162340898095201970u},
+    {10506364230455581282u, 12702926122619002463u},
+    {8521269269642088699u, 15878657653273753079u},
+    {12243322321167387293u, 9924161033296095674u},
+    {6080780864604458308u, 12405201291620119593u},
+    {12212662099182960789u, 15506501614525149491u},
+    {5327070802775656541u, 9691563509078218432u},
+    {6658838503469570676u, 12114454386347773040u},
+    {8323548129336963345u, 15143067982934716300u},
+    {14425589617690377899u, 9464417489334197687u},
+    {13420301003685584469u, 11830521861667747109u},
+    {2940318199324816875u, 14788152327084683887u},
+    {8755227902219092403u, 9242595204427927429u},
+    {15555720896201253407u, 11553244005534909286u},
+    {10221279083396790951u, 14441555006918636608u},
+    {12776598854245988689u, 18051943758648295760u},
+    {7985374283903742931u, 11282464849155184850u},
+    {758345818024902856u, 14103081061443981063u},
+    {14782990327813292282u, 17628851326804976328u},
+    {9239368954883307676u, 11018032079253110205u},
+    {16160897212031522499u, 13772540099066387756u},
+    {1754377441329851508u, 17215675123832984696u},
+    {1096485900831157192u, 10759796952395615435u},
+    {15205665431321110202u, 13449746190494519293u},
+    {5172023733869224041u, 16812182738118149117u},
+    {5538357842881958977u, 10507614211323843198u},
+    {16146319340457224530u, 13134517764154803997u},
+    {6347841120289366950u, 16418147205193504997u},
+    {6273243709394548296u, 10261342003245940623u},
+    {3229868618315797466u, 12826677504057425779u},
+    {17872393828176910545u, 16033346880071782223u},
+    {18087775170251650946u, 10020841800044863889u},
+    {8774660907532399971u, 12526052250056079862u},
+    {1744954097560724156u, 15657565312570099828u},
+    {10313968347830228405u, 9785978320356312392u},
+    {12892460434787785506u, 12232472900445390490u},
+    {6892203506629956075u, 15290591125556738113u},
+    {15836842237712192307u, 9556619453472961320u},
+    {1349308723430688768u, 11945774316841201651u},
+    {15521693959570524672u, 14932217896051502063u},
+    {16618587752372659776u, 9332636185032188789u},
+    {6938176635183661008u, 11665795231290235987u},
+    {4061034775552188356u, 14582244039112794984u},
+    {5076293469440235445u, 18227805048890993730u},
+    {7784369436827535057u, 11392378155556871081u},
+    {14342147814461806725u, 14240472694446088851u},
+    {13315998749649870503u, 17800590868057611064u},
+    {8322499218531169064u, 11125369292536006915u},
+    {5791438004736573426u, 13906711615670008644u},
+    {7239297505920716783u, 17383389519587510805u},
+    {6830403950414141941u, 10864618449742194253u},
+    {13149690956445065330u, 13580773062177742816u},
+    {16437113695556331663u, 16975966327722178520u},
+    {10273196059722707289u, 10609978954826361575u},
+    {8229809056225996208u, 13262473693532951969u},
+    {14898947338709883164u, 16578092116916189961u},
+    {2394313059052595121u, 10361307573072618726u},
+    {12216263360670519709u, 12951634466340773407u},
+    {10658643182410761733u, 16189543082925966759u},
+    {13579181016647807939u, 10118464426828729224u},
+    {16973976270809759924u, 12648080533535911530u},
+    {11994098301657424097u, 15810100666919889413u},
+    {9802154447749584012u, 9881312916824930883u},
+    {7641007041259592112u, 12351641146031163604u},
+    {9551258801574490140u, 15439551432538954505u},
+    {17498751797052526097u, 9649719645336846565u},
+    {8038381691033493909u, 12062149556671058207u},
+    {5436291095364479483u, 15077686945838822759u},
+};
+
+}  // namespace __fp_tables
+
+_LIBCPP_END_NAMESPACE_STD
+
+#endif  // _LIBCPP_SRC_INCLUDE_CHARCONV_TABLES_H
@@ -8,6 +8,8 @@
 
 #include "string"
 #include "charconv"
+#include "clocale"
+#include "cmath"
 #include "cstdlib"
 #include "cwchar"
 #include "cerrno"
@@ -435,6 +437,24 @@ S i_to_string(const V v)
     return S(buf, res.ptr);
 }
 
+// %f is to_chars in fixed notation with 6 digits after the point, as long as
+// the current locale uses a period for it, which is far faster than printf.
+template <typename S, typename P, typename V>
+S fp_to_string(P sprintf_like, const typename S::value_type* fmt, const V v)
+{
+    const char* point = localeconv()->decimal_point;
+    if (isfinite(v) && point[0] == '.' && point[1] == '\0')
+    {
+        // Sign, integer digits, point and 6 more digits.
+        constexpr size_t bufsize = numeric_limits<V>::max_exponent10 + 10;
+        char buf[bufsize];
+        const auto res = to_chars(buf, buf + bufsize, v, chars_format::fixed, 6);
+        _LIBCPP_ASSERT(res.ec == errc(), "bufsize must be large enough to accomodate the value");
+        return S(buf, res.ptr);
+    }
+    return as_string(sprintf_like, initial_string<S>()(), fmt, v);
+}
+
 }  // unnamed namespace
 
 string  to_string (int val)                { return i_to_string< string>(val); }
@@ -452,12 +472,12 @@ wstring to_wstring(unsigned long val)      { return i_to_string<wstring>(val); }
 wstring to_wstring(unsigned long long val) { return i_to_string<wstring>(val); }
 
 
-string  to_string (float val)       { return as_string(snprintf,       initial_string< string>()(),   "%f", val); }
-string  to_string (double val)      { return as_string(snprintf,       initial_string< string>()(),   "%f", val); }
+string  to_string (float val)       { return fp_to_string< string>(snprintf,         "%f", val); }
+string  to_string (double val)      { return fp_to_string< string>(snprintf,         "%f", val); }
 string  to_string (long double val) { return as_string(snprintf,       initial_string< string>()(),  "%Lf", val); }
 
-wstring to_wstring(float val)       { return as_string(get_swprintf(), initial_string<wstring>()(),  L"%f", val); }
-wstring to_wstring(double val)      { return as_string(get_swprintf(), initial_string<wstring>()(),  L"%f", val); }
+wstring to_wstring(float val)       { return fp_to_string<wstring>(get_swprintf(),  L"%f", val); }
+wstring to_wstring(double val)      { return fp_to_string<wstring>(get_swprintf(),  L"%f", val); }
 wstring to_wstring(long double val) { return as_string(get_swprintf(), initial_string<wstring>()(), L"%Lf", val); }
 
 _LIBCPP_END_NAMESPACE_STD
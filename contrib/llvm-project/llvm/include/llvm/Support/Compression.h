@@ -0,0 +1,113 @@
+//===-- llvm/Support/Compression.h ---Compression----------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains basic functions for compression/uncompression.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_COMPRESSION_H
+#define LLVM_SUPPORT_COMPRESSION_H
+
+#include "llvm/Support/DataTypes.h"
+
+namespace llvm {
+template <typename T> class SmallVectorImpl;
+class Error;
+class StringRef;
+
+namespace zlib {
+
+static constexpr int NoCompression = 0;
+static constexpr int BestSpeedCompression = 1;
+static constexpr int DefaultCompression = 6;
+static constexpr int BestSizeCompression = 9;
+
+bool isAvailable();
+
+Error compress(StringRef InputBuffer, SmallVectorImpl<char> &CompressedBuffer,
+               int Level = DefaultCompression);
+
+Error uncompress(StringRef InputBuffer, char *UncompressedBuffer,
+                 size_t &UncompressedSize);
+
+Error uncompress(StringRef InputBuffer,
+                 SmallVectorImpl<char> &UncompressedBuffer,
+                 size_t UncompressedSize);
+
+uint32_t crc32(StringRef Buffer);
+
+}  // End of namespace zlib
+
+namespace zstd {
+
+static constexpr int BestSpeedCompression = 1;
+static constexpr int DefaultCompression = 5;
+static constexpr int BestSizeCompression = 12;
+
+bool isAvailable();
+
+Error compress(StringRef InputBuffer, SmallVectorImpl<char> &CompressedBuffer,
+               int Level = DefaultCompression);
+
+/// Compress \p InputBuffer into a single zstd frame, splitting the work
+/// between \p Threads threads.  The frame can be read with uncompress();
+/// zero threads compresses on the calling thread.
+Error compress(StringRef InputBuffer, SmallVectorImpl<char> &CompressedBuffer,
+               int Level, unsigned Threads);
+
+Error uncompress(StringRef InputBuffer, char *UncompressedBuffer,
+                 size_t &UncompressedSize);
+
+Error uncompress(StringRef InputBuffer,
+                 SmallVectorImpl<char> &UncompressedBuffer,
+                 size_t UncompressedSize);
+
+}  // End of namespace zstd
+
+namespace compression {
+
+enum class Format {
+  Zlib,
+  Zstd,
+};
+
+/// An algorithm and the level to use it at.
+struct Params {
+  constexpr Params(Format F);
+  constexpr Params(Format F, int L) : format(F), level(L) {}
+
+  Format format;
+  int level;
+};
+
+constexpr Params::Params(Format F)
+    : format(F), level(F == Format::Zlib ? zlib::DefaultCompression
+                                         : zstd::DefaultCompression) {}
+
+const char *getName(Format F);
+
+bool isAvailable(Format F);
+
+/// Compress with the algorithm and level in \p P.  \p Threads > 0 asks for
+/// multi-threaded compression where the algorithm supports it; the output
+/// is the same format either way.
+Error compress(Params P, StringRef InputBuffer,
+               SmallVectorImpl<char> &CompressedBuffer, unsigned Threads = 0);
+
+Error uncompress(Format F, StringRef InputBuffer, char *UncompressedBuffer,
+                 size_t &UncompressedSize);
+
+Error uncompress(Format F, StringRef InputBuffer,
+                 SmallVectorImpl<char> &UncompressedBuffer,
+                 size_t UncompressedSize);
+
+}  // End of namespace compression
+
+} // End of namespace llvm
+
+#endif
@@ -0,0 +1,186 @@
+//===--- JSONDocument.h - Read-only JSON documents --------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===---------------------------------------------------------------------===//
+///
+/// \file
+/// json::Document is a read-only alternative to json::parse() for large
+/// inputs such as compilation databases and time traces.
+///
+/// It accepts exactly what json::parse() accepts and reports the same errors,
+/// but instead of a tree of json::Values, each owning its strings, arrays and
+/// maps, it stores the nodes in one flat array in document order.  Strings
+/// that contain no escape sequences point into the parsed text, which must
+/// therefore outlive the Document; the others are unescaped into an arena
+/// owned by the Document.
+///
+/// \code
+///   Expected<json::Document> Doc = json::Document::parse(Text);
+///   if (!Doc)
+///     return Doc.takeError();
+///   for (json::Document::Node Entry : Doc->root().elements())
+///     if (Optional<json::Document::Node> File = Entry.get("file"))
+///       Files.push_back(*File->getAsString());
+/// \endcode
+///
+//===---------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_JSONDOCUMENT_H
+#define LLVM_SUPPORT_JSONDOCUMENT_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/iterator_range.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+namespace json {
+
+class Document {
+  struct Entry;
+
+public:
+  enum Kind {
+    Null,
+    Boolean,
+    /// Number values can store both int64s and doubles at full precision,
+    /// depending on what they were parsed from.
+    Number,
+    String,
+    Array,
+    Object,
+  };
+
+  class ElementIterator;
+  class MemberIterator;
+
+  /// A value within a Document.  Nodes are cheap to copy, and valid as long
+  /// as the Document is neither destroyed nor moved.
+  class Node {
+  public:
+    Kind kind() const { return entry().K; }
+
+    llvm::Optional<std::nullptr_t> getAsNull() const;
+    llvm::Optional<bool> getAsBoolean() const;
+    llvm::Optional<double> getAsNumber() const;
+    /// Succeeds if the Node is a Number, and exactly representable as int64_t.
+    llvm::Optional<int64_t> getAsInteger() const;
+    llvm::Optional<llvm::StringRef> getAsString() const;
+
+    /// The number of elements of an Array, or members of an Object.
+    size_t size() const;
+    /// The elements of an Array; empty for anything else.
+    iterator_range<ElementIterator> elements() const;
+    /// The key and value of each member of an Object, in document order;
+    /// empty for anything else.
+    iterator_range<MemberIterator> members() const;
+    /// The value of the member of an Object called \p Key.  If there are
+    /// several, this is the last one, as json::parse() would keep.
+    llvm::Optional<Node> get(llvm::StringRef Key) const;
+
+    /// Copies the Node and everything in it into a json::Value.
+    Value toValue() const;
+
+  private:
+    friend class Document;
+    friend class ElementIterator;
+    friend class MemberIterator;
+    Node(const Document *Doc, size_t Index) : Doc(Doc), Index(Index) {}
+    const Entry &entry() const { return Doc->Entries[Index]; }
+
+    const Document *Doc;
+    size_t Index;
+  };
+
+  class ElementIterator {
+  public:
+    Node operator*() const { return Node(Doc, Index); }
+    ElementIterator &operator++() {
+      Index = Doc->Entries[Index].End;
+      return *this;
+    }
+    bool operator==(const ElementIterator &RHS) const {
+      return Index == RHS.Index;
+    }
+    bool operator!=(const ElementIterator &RHS) const {
+      return Index != RHS.Index;
+    }
+
+  private:
+    friend class Node;
+    ElementIterator(const Document *Doc, size_t Index)
+        : Doc(Doc), Index(Index) {}
+
+    const Document *Doc;
+    size_t Index;
+  };
+
+  class MemberIterator {
+  public:
+    std::pair<llvm::StringRef, Node> operator*() const {
+      return {*Node(Doc, Index).getAsString(), Node(Doc, Index + 1)};
+    }
+    MemberIterator &operator++() {
+      Index = Doc->Entries[Index + 1].End;
+      return *this;
+    }
+    bool operator==(const MemberIterator &RHS) const {
+      return Index == RHS.Index;
+    }
+    bool operator!=(const MemberIterator &RHS) const {
+      return Index != RHS.Index;
+    }
+
+  private:
+    friend class Node;
+    MemberIterator(const Document *Doc, size_t Index)
+        : Doc(Doc), Index(Index) {}
+
+    const Document *Doc;
+    size_t Index;
+  };
+
+  /// Parses \p JSON, which must outlive the returned Document.
+  static llvm::Expected<Document> parse(llvm::StringRef JSON);
+
+  Node root() const { return Node(this, 0); }
+
+private:
+  class Builder;
+
+  Document() = default;
+
+  // One node.  Arrays are followed by their elements, and objects by a
+  // String node for each key, followed by the value.
+  struct Entry {
+    Kind K;
+    bool IsInteger;
+    // Index of the node after this one and everything in it.
+    uint32_t End;
+    // Length of a String, or number of elements or members.
+    uint64_t Size;
+    union {
+      bool Boolean;
+      int64_t Integer;
+      double Double;
+      const char *String;
+    };
+  };
+
+  std::vector<Entry> Entries;
+  // Strings that had escape sequences in them.
+  BumpPtrAllocator Strings;
+};
+
+} // namespace json
+} // namespace llvm
+
+#endif
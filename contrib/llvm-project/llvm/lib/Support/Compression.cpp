@@ -13,6 +13,7 @@
 #include "llvm/Support/Compression.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
 #include "llvm/Config/config.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Error.h"
@@ -20,14 +21,17 @@
 #if LLVM_ENABLE_ZLIB == 1 && HAVE_ZLIB_H
 #include <zlib.h>
 #endif
+#if LLVM_ENABLE_ZSTD == 1
+#include <zstd.h>
+#endif
 
 using namespace llvm;
 
-#if LLVM_ENABLE_ZLIB == 1 && HAVE_LIBZ
-static Error createError(StringRef Err) {
+static Error createError(const Twine &Err) {
   return make_error<StringError>(Err, inconvertibleErrorCode());
 }
 
+#if LLVM_ENABLE_ZLIB == 1 && HAVE_LIBZ
 static StringRef convertZlibCodeToString(int Code) {
   switch (Code) {
   case Z_MEM_ERROR:
@@ -104,3 +108,174 @@ uint32_t zlib::crc32(StringRef Buffer) {
   llvm_unreachable("zlib::crc32 is unavailable");
 }
 #endif
+
+#if LLVM_ENABLE_ZSTD == 1
+bool zstd::isAvailable() { return true; }
+
+Error zstd::compress(StringRef InputBuffer,
+                     SmallVectorImpl<char> &CompressedBuffer, int Level) {
+  size_t CompressedBufferSize = ::ZSTD_compressBound(InputBuffer.size());
+  CompressedBuffer.reserve(CompressedBufferSize);
+  size_t CompressedSize =
+      ::ZSTD_compress(CompressedBuffer.data(), CompressedBufferSize,
+                      InputBuffer.data(), InputBuffer.size(), Level);
+  if (ZSTD_isError(CompressedSize))
+    return createError(Twine("zstd error: ") +
+                       ::ZSTD_getErrorName(CompressedSize));
+  // Tell MemorySanitizer that zstd output buffer is fully initialized.
+  // This avoids a false report when running LLVM with uninstrumented zstd.
+  __msan_unpoison(CompressedBuffer.data(), CompressedSize);
+  CompressedBuffer.set_size(CompressedSize);
+  return Error::success();
+}
+
+Error zstd::compress(StringRef InputBuffer,
+                     SmallVectorImpl<char> &CompressedBuffer, int Level,
+                     unsigned Threads) {
+  if (Threads == 0)
+    return compress(InputBuffer, CompressedBuffer, Level);
+
+  ZSTD_CCtx *CCtx = ::ZSTD_createCCtx();
+  if (!CCtx)
+    return createError("zstd error: out of memory");
+  ::ZSTD_CCtx_setParameter(CCtx, ZSTD_c_compressionLevel, Level);
+  // Fails, leaving compression on this thread, if libzstd was built without
+  // ZSTD_MULTITHREAD.  The frame is the same either way.
+  ::ZSTD_CCtx_setParameter(CCtx, ZSTD_c_nbWorkers, Threads);
+
+  // Ending the frame in the first call records the input size in it, and
+  // lets the workers each take a slice of the input straight away.
+  ZSTD_inBuffer In = {InputBuffer.data(), InputBuffer.size(), 0};
+  // Like the single-threaded version, write from the start of the buffer.
+  CompressedBuffer.clear();
+  CompressedBuffer.reserve(::ZSTD_compressBound(InputBuffer.size()));
+  size_t Res;
+  do {
+    if (CompressedBuffer.size() == CompressedBuffer.capacity())
+      CompressedBuffer.reserve(CompressedBuffer.capacity() * 2);
+    ZSTD_outBuffer Out = {CompressedBuffer.data(), CompressedBuffer.capacity(),
+                          CompressedBuffer.size()};
+    Res = ::ZSTD_compressStream2(CCtx, &Out, &In, ZSTD_e_end);
+    __msan_unpoison(CompressedBuffer.data(), Out.pos);
+    CompressedBuffer.set_size(Out.pos);
+  } while (Res != 0 && !ZSTD_isError(Res));
+  ::ZSTD_freeCCtx(CCtx);
+
+  if (ZSTD_isError(Res))
+    return createError(Twine("zstd error: ") + ::ZSTD_getErrorName(Res));
+  return Error::success();
+}
+
+Error zstd::uncompress(StringRef InputBuffer, char *UncompressedBuffer,
+                       size_t &UncompressedSize) {
+  size_t Res = ::ZSTD_decompress(UncompressedBuffer, UncompressedSize,
+                                 InputBuffer.data(), InputBuffer.size());
+  if (ZSTD_isError(Res))
+    return createError(Twine("zstd error: ") + ::ZSTD_getErrorName(Res));
+  UncompressedSize = Res;
+  // Tell MemorySanitizer that zstd output buffer is fully initialized.
+  // This avoids a false report when running LLVM with uninstrumented zstd.
+  __msan_unpoison(UncompressedBuffer, UncompressedSize);
+  return Error::success();
+}
+
+Error zstd::uncompress(StringRef InputBuffer,
+                       SmallVectorImpl<char> &UncompressedBuffer,
+                       size_t UncompressedSize) {
+  UncompressedBuffer.reserve(UncompressedSize);
+  Error E =
+      uncompress(InputBuffer, UncompressedBuffer.data(), UncompressedSize);
+  UncompressedBuffer.set_size(UncompressedSize);
+  return E;
+}
+
+#else
+bool zstd::isAvailable() { return false; }
+Error zstd::compress(StringRef InputBuffer,
+                     SmallVectorImpl<char> &CompressedBuffer, int Level) {
+  llvm_unreachable("zstd::compress is unavailable");
+}
+Error zstd::compress(StringRef InputBuffer,
+                     SmallVectorImpl<char> &CompressedBuffer, int Level,
+                     unsigned Threads) {
+  llvm_unreachable("zstd::compress is unavailable");
+}
+Error zstd::uncompress(StringRef InputBuffer, char *UncompressedBuffer,
+                       size_t &UncompressedSize) {
+  llvm_unreachable("zstd::uncompress is unavailable");
+}
+Error zstd::uncompress(StringRef InputBuffer,
+                       SmallVectorImpl<char> &UncompressedBuffer,
+                       size_t UncompressedSize) {
+  llvm_unreachable("zstd::uncompress is unavailable");
+}
+#endif
+
+const char *compression::getName(Format F) {
+  switch (F) {
+  case Format::Zlib:
+    return "zlib";
+  case Format::Zstd:
+    return "zstd";
+  }
+  llvm_unreachable("unknown compression format");
+}
+
+bool compression::isAvailable(Format F) {
+  switch (F) {
+  case Format::Zlib:
+    return zlib::isAvailable();
+  case Format::Zstd:
+    return zstd::isAvailable();
+  }
+  llvm_unreachable("unknown compression format");
+}
+
+// Unlike the per-algorithm functions, these report a missing algorithm as
+// an error, since the format often comes from the user or from the input.
+static Error createUnavailableError(compression::Format F) {
+  return createError(Twine(compression::getName(F)) +
+                     " support is not available");
+}
+
+Error compression::compress(Params P, StringRef InputBuffer,
+                            SmallVectorImpl<char> &CompressedBuffer,
+                            unsigned Threads) {
+  if (!isAvailable(P.format))
+    return createUnavailableError(P.format);
+  switch (P.format) {
+  case Format::Zlib:
+    return zlib::compress(InputBuffer, CompressedBuffer, P.level);
+  case Format::Zstd:
+    return zstd::compress(InputBuffer, CompressedBuffer, P.level, Threads);
+  }
+  llvm_unreachable("unknown compression format");
+}
+
+Error compression::uncompress(Format F, StringRef InputBuffer,
+                              char *UncompressedBuffer,
+                              size_t &UncompressedSize) {
+  if (!isAvailable(F))
+    return createUnavailableError(F);
+  switch (F) {
+  case Format::Zlib:
+    return zlib::uncompress(InputBuffer, UncompressedBuffer, UncompressedSize);
+  case Format::Zstd:
+    return zstd::uncompress(InputBuffer, UncompressedBuffer, UncompressedSize);
+  }
+  llvm_unreachable("unknown compression format");
+}
+
+Error compression::uncompress(Format F, StringRef InputBuffer,
+                              SmallVectorImpl<char> &UncompressedBuffer,
+                              size_t UncompressedSize) {
+  if (!isAvailable(F))
+    return createUnavailableError(F);
+  switch (F) {
+  case Format::Zlib:
+    return zlib::uncompress(InputBuffer, UncompressedBuffer, UncompressedSize);
+  case Format::Zstd:
+    return zstd::uncompress(InputBuffer, UncompressedBuffer, UncompressedSize);
+  }
+  llvm_unreachable("unknown compression format");
+}
@@ -9,7 +9,14 @@
 #include "llvm/Support/JSON.h"
 #include "llvm/Support/ConvertUTF.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/JSONDocument.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/SwapByteOrder.h"
 #include <cctype>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace llvm {
 namespace json {
@@ -198,6 +205,79 @@ bool operator==(const Value &L, const Value &R) {
   llvm_unreachable("Unknown value kind");
 }
 
+// Most of a typical JSON text is plain ASCII string contents, so the loops
+// below that skip over those look at 16 bytes at a time with SSE2, or else
+// 8 at a time in a 64-bit word.  In the word-at-a-time tests, a byte's top
+// bit may also be set spuriously, but only above a byte that really
+// matched, so the lowest set bit is always right.
+static constexpr uint64_t EachByte = 0x0101010101010101ULL;
+
+static uint64_t zeroBytes(uint64_t W) {
+  return (W - EachByte) & ~W & (EachByte << 7);
+}
+
+// Bytes below N, for N <= 0x80.
+static uint64_t bytesBelow(uint64_t W, uint8_t N) {
+  return (W - EachByte * N) & ~W & (EachByte << 7);
+}
+
+// Returns the length of the ASCII prefix of [P, End).
+static size_t asciiLength(const char *P, const char *End) {
+  const char *Begin = P;
+#if defined(__SSE2__)
+  for (; End - P >= 16; P += 16) {
+    __m128i V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(P));
+    if (unsigned Mask = _mm_movemask_epi8(V))
+      return P - Begin + countTrailingZeros(Mask);
+  }
+#else
+  for (; End - P >= 8; P += 8) {
+    uint64_t W;
+    memcpy(&W, P, sizeof(W));
+    if (W & (EachByte << 7))
+      break;
+  }
+#endif
+  while (P != End && static_cast<unsigned char>(*P) < 0x80)
+    ++P;
+  return P - Begin;
+}
+
+// Returns the length of the prefix of [P, End) that goes into a string
+// unchanged: everything up to a quote, backslash or control character.
+static size_t plainStringLength(const char *P, const char *End) {
+  const char *Begin = P;
+#if defined(__SSE2__)
+  const __m128i Quote = _mm_set1_epi8('"');
+  const __m128i Backslash = _mm_set1_epi8('\\');
+  const __m128i MaxControl = _mm_set1_epi8(0x1f);
+  for (; End - P >= 16; P += 16) {
+    __m128i V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(P));
+    __m128i Special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(V, Quote), _mm_cmpeq_epi8(V, Backslash)),
+        _mm_cmpeq_epi8(_mm_max_epu8(V, MaxControl), MaxControl));
+    if (unsigned Mask = _mm_movemask_epi8(Special))
+      return P - Begin + countTrailingZeros(Mask);
+  }
+#else
+  if (sys::IsLittleEndianHost) {
+    for (; End - P >= 8; P += 8) {
+      uint64_t W;
+      memcpy(&W, P, sizeof(W));
+      uint64_t Special = zeroBytes(W ^ (EachByte * '"')) |
+                         zeroBytes(W ^ (EachByte * '\\')) |
+                         bytesBelow(W, 0x20);
+      if (Special)
+        return P - Begin + countTrailingZeros(Special) / 8;
+    }
+  }
+#endif
+  while (P != End && *P != '"' && *P != '\\' &&
+         static_cast<unsigned char>(*P) >= 0x20)
+    ++P;
+  return P - Begin;
+}
+
 namespace {
 // Simple recursive-descent JSON parser.
 class Parser {
@@ -227,7 +307,7 @@ class Parser {
     return std::move(*Err);
   }
 
-private:
+protected:
   void eatWhitespace() {
     while (P != End && (*P == ' ' || *P == '\r' || *P == '\n' || *P == '\t'))
       ++P;
@@ -235,6 +315,8 @@ class Parser {
 
   // On invalid syntax, parseX() functions return false and set Err.
   bool parseNumber(char First, Value &Out);
+  bool parseNumber(char First, bool &IsInteger, int64_t &Integer,
+                   double &Double);
   bool parseString(std::string &Out);
   bool parseUnicode(std::string &Out);
   bool parseError(const char *Msg); // always returns false
@@ -341,6 +423,33 @@ bool Parser::parseValue(Value &Out) {
 }
 
 bool Parser::parseNumber(char First, Value &Out) {
+  bool IsInteger;
+  int64_t Integer;
+  double Double;
+  if (!parseNumber(First, IsInteger, Integer, Double))
+    return false;
+  if (IsInteger)
+    Out = Integer;
+  else
+    Out = Double;
+  return true;
+}
+
+bool Parser::parseNumber(char First, bool &IsInteger, int64_t &Integer,
+                         double &Double) {
+  // Fast path for integers that cannot overflow, which most numbers are.
+  const char *Digits = First == '-' ? P : P - 1;
+  const char *D = Digits;
+  uint64_t N = 0;
+  while (D != End && *D >= '0' && *D <= '9' && D - Digits < 18)
+    N = N * 10 + (*D++ - '0');
+  if (D != Digits && (D == End || !isNumber(*D))) {
+    P = D;
+    IsInteger = true;
+    Integer = First == '-' ? -int64_t(N) : int64_t(N);
+    return true;
+  }
+
   // Read the number into a string. (Must be null-terminated for strto*).
   SmallString<24> S;
   S.push_back(First);
@@ -352,25 +461,30 @@ bool Parser::parseNumber(char First, Value &Out) {
   auto I = std::strtoll(S.c_str(), &End, 10);
   if (End == S.end() && I >= std::numeric_limits<int64_t>::min() &&
       I <= std::numeric_limits<int64_t>::max()) {
-    Out = int64_t(I);
+    IsInteger = true;
+    Integer = int64_t(I);
     return true;
   }
   // If it's not an integer
-  Out = std::strtod(S.c_str(), &End);
+  IsInteger = false;
+  Double = std::strtod(S.c_str(), &End);
   return End == S.end() || parseError("Invalid JSON value (number?)");
 }
 
 bool Parser::parseString(std::string &Out) {
   // leading quote was already consumed.
-  for (char C = next(); C != '"'; C = next()) {
+  for (;;) {
+    // Take everything up to the next quote, escape or error at once.
+    size_t N = plainStringLength(P, End);
+    Out.append(P, N);
+    P += N;
+    char C = next();
+    if (C == '"')
+      return true;
     if (LLVM_UNLIKELY(P == End))
       return parseError("Unterminated string");
     if (LLVM_UNLIKELY((C & 0x1f) == C))
       return parseError("Control character in string");
-    if (LLVM_LIKELY(C != '\\')) {
-      Out.push_back(C);
-      continue;
-    }
     // Handle escape sequence.
     switch (C = next()) {
     case '"':
@@ -401,7 +515,6 @@ bool Parser::parseString(std::string &Out) {
       return parseError("Invalid escape sequence");
     }
   }
-  return true;
 }
 
 static void encodeUtf8(uint32_t Rune, std::string &Out) {
@@ -518,6 +631,265 @@ Expected<Value> parse(StringRef JSON) {
 }
 char ParseError::ID = 0;
 
+// Parses into a Document rather than a Value, with the same grammar and
+// errors as Parser::parseValue().
+class Document::Builder : public Parser {
+public:
+  Builder(StringRef JSON, Document &Doc) : Parser(JSON), Doc(Doc) {}
+
+  bool parseNode();
+
+private:
+  bool push(Kind K, size_t &Index);
+  bool parseNode(char C, size_t Index);
+  bool parseString(size_t Index);
+  bool parseArray(size_t Index);
+  bool parseObject(size_t Index);
+
+  Document &Doc;
+};
+
+bool Document::Builder::push(Kind K, size_t &Index) {
+  // Entry::End must fit.
+  if (LLVM_UNLIKELY(Doc.Entries.size() == std::numeric_limits<uint32_t>::max()))
+    return parseError("Document too large");
+  Index = Doc.Entries.size();
+  Doc.Entries.emplace_back();
+  Doc.Entries.back().K = K;
+  return true;
+}
+
+bool Document::Builder::parseNode() {
+  eatWhitespace();
+  if (P == End)
+    return parseError("Unexpected EOF");
+  size_t Index;
+  if (!push(Null, Index))
+    return false;
+  bool OK = parseNode(next(), Index);
+  Doc.Entries[Index].End = Doc.Entries.size();
+  return OK;
+}
+
+// Any reference into Entries is invalidated by parsing a nested node, so
+// these all work with indexes.
+bool Document::Builder::parseNode(char C, size_t Index) {
+  Entry &E = Doc.Entries[Index];
+  switch (C) {
+  case 'n':
+    return (next() == 'u' && next() == 'l' && next() == 'l') ||
+           parseError("Invalid JSON value (null?)");
+  case 't':
+    E.K = Boolean;
+    E.Boolean = true;
+    return (next() == 'r' && next() == 'u' && next() == 'e') ||
+           parseError("Invalid JSON value (true?)");
+  case 'f':
+    E.K = Boolean;
+    E.Boolean = false;
+    return (next() == 'a' && next() == 'l' && next() == 's' && next() == 'e') ||
+           parseError("Invalid JSON value (false?)");
+  case '"':
+    E.K = String;
+    return parseString(Index);
+  case '[':
+    E.K = Array;
+    return parseArray(Index);
+  case '{':
+    E.K = Object;
+    return parseObject(Index);
+  default:
+    if (isNumber(C)) {
+      E.K = Number;
+      return Parser::parseNumber(C, E.IsInteger, E.Integer, E.Double);
+    }
+    return parseError("Invalid JSON value");
+  }
+}
+
+bool Document::Builder::parseString(size_t Index) {
+  // leading quote was already consumed.  Strings without escapes are
+  // used where they are.
+  size_t N = plainStringLength(P, End);
+  if (LLVM_LIKELY(N != size_t(End - P) && P[N] == '"')) {
+    Doc.Entries[Index].String = P;
+    Doc.Entries[Index].Size = N;
+    P += N + 1;
+    return true;
+  }
+  std::string S;
+  if (!Parser::parseString(S))
+    return false;
+  char *Copy = Doc.Strings.Allocate<char>(S.size());
+  std::copy(S.begin(), S.end(), Copy);
+  Doc.Entries[Index].String = Copy;
+  Doc.Entries[Index].Size = S.size();
+  return true;
+}
+
+bool Document::Builder::parseArray(size_t Index) {
+  eatWhitespace();
+  if (peek() == ']') {
+    ++P;
+    return true;
+  }
+  for (;;) {
+    if (!parseNode())
+      return false;
+    ++Doc.Entries[Index].Size;
+    eatWhitespace();
+    switch (next()) {
+    case ',':
+      eatWhitespace();
+      continue;
+    case ']':
+      return true;
+    default:
+      return parseError("Expected , or ] after array element");
+    }
+  }
+}
+
+bool Document::Builder::parseObject(size_t Index) {
+  eatWhitespace();
+  if (peek() == '}') {
+    ++P;
+    return true;
+  }
+  for (;;) {
+    if (next() != '"')
+      return parseError("Expected object key");
+    size_t Key;
+    if (!push(String, Key))
+      return false;
+    Doc.Entries[Key].End = Key + 1;
+    if (!parseString(Key))
+      return false;
+    eatWhitespace();
+    if (next() != ':')
+      return parseError("Expected : after object key");
+    eatWhitespace();
+    if (!parseNode())
+      return false;
+    ++Doc.Entries[Index].Size;
+    eatWhitespace();
+    switch (next()) {
+    case ',':
+      eatWhitespace();
+      continue;
+    case '}':
+      return true;
+    default:
+      return parseError("Expected , or } after object property");
+    }
+  }
+}
+
+Expected<Document> Document::parse(StringRef JSON) {
+  Document Doc;
+  Builder B(JSON, Doc);
+  if (B.checkUTF8())
+    if (B.parseNode())
+      if (B.assertEnd())
+        return std::move(Doc);
+  return B.takeError();
+}
+
+Optional<std::nullptr_t> Document::Node::getAsNull() const {
+  if (LLVM_LIKELY(kind() == Null))
+    return nullptr;
+  return llvm::None;
+}
+
+Optional<bool> Document::Node::getAsBoolean() const {
+  if (LLVM_LIKELY(kind() == Boolean))
+    return entry().Boolean;
+  return llvm::None;
+}
+
+Optional<double> Document::Node::getAsNumber() const {
+  if (LLVM_UNLIKELY(kind() != Number))
+    return llvm::None;
+  if (entry().IsInteger)
+    return double(entry().Integer);
+  return entry().Double;
+}
+
+Optional<int64_t> Document::Node::getAsInteger() const {
+  if (LLVM_UNLIKELY(kind() != Number))
+    return llvm::None;
+  if (LLVM_LIKELY(entry().IsInteger))
+    return entry().Integer;
+  // Same as Value::getAsInteger().
+  double D = entry().Double;
+  if (LLVM_LIKELY(std::modf(D, &D) == 0.0 &&
+                  D >= double(std::numeric_limits<int64_t>::min()) &&
+                  D <= double(std::numeric_limits<int64_t>::max())))
+    return D;
+  return llvm::None;
+}
+
+Optional<StringRef> Document::Node::getAsString() const {
+  if (LLVM_LIKELY(kind() == String))
+    return StringRef(entry().String, entry().Size);
+  return llvm::None;
+}
+
+size_t Document::Node::size() const {
+  if (kind() == Array || kind() == Object)
+    return entry().Size;
+  return 0;
+}
+
+iterator_range<Document::ElementIterator> Document::Node::elements() const {
+  size_t Begin = kind() == Array ? Index + 1 : entry().End;
+  return make_range(ElementIterator(Doc, Begin),
+                    ElementIterator(Doc, entry().End));
+}
+
+iterator_range<Document::MemberIterator> Document::Node::members() const {
+  size_t Begin = kind() == Object ? Index + 1 : entry().End;
+  return make_range(MemberIterator(Doc, Begin),
+                    MemberIterator(Doc, entry().End));
+}
+
+Optional<Document::Node> Document::Node::get(StringRef Key) const {
+  Optional<Node> Found;
+  for (const auto &M : members())
+    if (M.first == Key)
+      Found = M.second;
+  return Found;
+}
+
+Value Document::Node::toValue() const {
+  switch (kind()) {
+  case Null:
+    return nullptr;
+  case Boolean:
+    return entry().Boolean;
+  case Number:
+    if (entry().IsInteger)
+      return entry().Integer;
+    return entry().Double;
+  case String:
+    return *getAsString();
+  case Array: {
+    json::Array A;
+    A.reserve(size());
+    for (Node E : elements())
+      A.push_back(E.toValue());
+    return std::move(A);
+  }
+  case Object: {
+    json::Object O;
+    for (const auto &M : members())
+      O[M.first] = M.second.toValue();
+    return std::move(O);
+  }
+  }
+  llvm_unreachable("Unknown kind");
+}
+
 static std::vector<const Object::value_type *> sortedElements(const Object &O) {
   std::vector<const Object::value_type *> Elements;
   for (const auto &E : O)
@@ -531,16 +903,24 @@ static std::vector<const Object::value_type *> sortedElements(const Object &O) {
 
 bool isUTF8(llvm::StringRef S, size_t *ErrOffset) {
   // Fast-path for ASCII, which is valid UTF-8.
-  if (LLVM_LIKELY(isASCII(S)))
-    return true;
-
-  const UTF8 *Data = reinterpret_cast<const UTF8 *>(S.data()), *Rest = Data;
-  if (LLVM_LIKELY(isLegalUTF8String(&Rest, Data + S.size())))
+  size_t N = asciiLength(S.begin(), S.end());
+  if (LLVM_LIKELY(N == S.size()))
     return true;
 
-  if (ErrOffset)
-    *ErrOffset = Rest - Data;
-  return false;
+  // Otherwise check each multi-byte sequence, skipping the ASCII between.
+  const UTF8 *Data = reinterpret_cast<const UTF8 *>(S.data());
+  const UTF8 *Rest = Data + N, *End = Data + S.size();
+  while (Rest != End) {
+    if (!isLegalUTF8Sequence(Rest, End)) {
+      if (ErrOffset)
+        *ErrOffset = Rest - Data;
+      return false;
+    }
+    Rest += getNumBytesForUTF8(*Rest);
+    Rest += asciiLength(reinterpret_cast<const char *>(Rest),
+                        reinterpret_cast<const char *>(End));
+  }
+  return true;
 }
 
 std::string fixUTF8(llvm::StringRef S) {
@@ -562,7 +942,13 @@ std::string fixUTF8(llvm::StringRef S) {
 
 static void quote(llvm::raw_ostream &OS, llvm::StringRef S) {
   OS << '\"';
-  for (unsigned char C : S) {
+  for (const char *P = S.begin(), *End = S.end(); P != End; ++P) {
+    size_t N = plainStringLength(P, End);
+    OS.write(P, N);
+    P += N;
+    if (P == End)
+      break;
+    unsigned char C = *P;
     if (C == 0x22 || C == 0x5C)
       OS << '\\';
     if (C >= 0x20) {
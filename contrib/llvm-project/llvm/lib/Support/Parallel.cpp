@@ -8,12 +8,14 @@
 
 #include "llvm/Support/Parallel.h"
 #include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Compiler.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Threading.h"
 
 #include <atomic>
+#include <deque>
 #include <future>
-#include <stack>
+#include <memory>
 #include <thread>
 #include <vector>
 
@@ -33,15 +35,129 @@ class Executor {
   virtual ~Executor() = default;
   virtual void add(std::function<void()> func) = 0;
 
+  /// Run one queued closure on the calling thread, if there is one.  Returns
+  /// false if there was nothing to run.
+  virtual bool runOne() = 0;
+
   static Executor *getDefaultExecutor();
 };
 
-/// An implementation of an Executor that runs closures on a thread pool
-///   in filo order.
+using Task = std::function<void()>;
+
+/// A Chase-Lev work-stealing deque of tasks, as described in "Correct and
+/// Efficient Work-Stealing for Weak Memory Models" (Le et al., PPoPP 2013).
+/// Only the owning worker pushes and pops, at the bottom; any thread may
+/// steal from the top.
+class WorkDeque {
+  struct Array {
+    explicit Array(unsigned LogSize)
+        : LogSize(LogSize), Mask((int64_t(1) << LogSize) - 1),
+          Slots(new std::atomic<Task *>[Mask + 1]) {}
+
+    int64_t size() const { return Mask + 1; }
+    // The paper only needs relaxed accesses here, but release/acquire is
+    // free on common hardware and also publishes the task itself to a
+    // thief in a way that tools like ThreadSanitizer can follow.
+    Task *get(int64_t I) const {
+      return Slots[I & Mask].load(std::memory_order_acquire);
+    }
+    void put(int64_t I, Task *T) {
+      Slots[I & Mask].store(T, std::memory_order_release);
+    }
+
+    unsigned LogSize;
+    int64_t Mask;
+    std::unique_ptr<std::atomic<Task *>[]> Slots;
+  };
+
+  std::atomic<int64_t> Top{0};
+  std::atomic<int64_t> Bottom{0};
+  std::atomic<Array *> Buffer;
+  // Every array this deque has used.  Thieves may still be reading an old
+  // one after it has grown, so they are only freed with the deque.
+  std::vector<std::unique_ptr<Array>> Arrays;
+
+public:
+  WorkDeque() {
+    Arrays.emplace_back(new Array(8));
+    Buffer.store(Arrays.back().get(), std::memory_order_relaxed);
+  }
+
+  ~WorkDeque() {
+    // Only called once no thread can steal any more.
+    while (Task *T = pop())
+      delete T;
+  }
+
+  void push(Task *T) {
+    int64_t B = Bottom.load(std::memory_order_relaxed);
+    int64_t Tp = Top.load(std::memory_order_acquire);
+    Array *A = Buffer.load(std::memory_order_relaxed);
+    if (B - Tp > A->size() - 1) {
+      Array *Bigger = new Array(A->LogSize + 1);
+      for (int64_t I = Tp; I != B; ++I)
+        Bigger->put(I, A->get(I));
+      Arrays.emplace_back(Bigger);
+      Buffer.store(Bigger, std::memory_order_release);
+      A = Bigger;
+    }
+    A->put(B, T);
+    std::atomic_thread_fence(std::memory_order_release);
+    Bottom.store(B + 1, std::memory_order_relaxed);
+  }
+
+  Task *pop() {
+    int64_t B = Bottom.load(std::memory_order_relaxed) - 1;
+    Array *A = Buffer.load(std::memory_order_relaxed);
+    Bottom.store(B, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t Tp = Top.load(std::memory_order_relaxed);
+    if (Tp > B) {
+      Bottom.store(B + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    Task *T = A->get(B);
+    if (Tp == B) {
+      // The last one; race the thieves for it.
+      if (!Top.compare_exchange_strong(Tp, Tp + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed))
+        T = nullptr;
+      Bottom.store(B + 1, std::memory_order_relaxed);
+    }
+    return T;
+  }
+
+  /// Take the oldest task.  Sets \p Lost if the deque was not empty but
+  /// another thread took that task first, in which case it is worth trying
+  /// again.
+  Task *steal(bool &Lost) {
+    int64_t Tp = Top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t B = Bottom.load(std::memory_order_acquire);
+    if (Tp >= B)
+      return nullptr;
+    Array *A = Buffer.load(std::memory_order_acquire);
+    Task *T = A->get(Tp);
+    if (!Top.compare_exchange_strong(Tp, Tp + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+      Lost = true;
+      return nullptr;
+    }
+    return T;
+  }
+};
+
+/// An implementation of an Executor that runs closures on a thread pool.
+/// Each worker has its own deque: closures added by a worker go on its own
+/// deque and are run in filo order, idle workers steal the oldest closures
+/// from the others, and closures added by any other thread go on a shared
+/// queue.
 class ThreadPoolExecutor : public Executor {
 public:
   explicit ThreadPoolExecutor(ThreadPoolStrategy S = hardware_concurrency()) {
     unsigned ThreadCount = S.compute_thread_count();
+    for (unsigned I = 0; I < ThreadCount; ++I)
+      Deques.emplace_back(new WorkDeque);
     // Spawn all but one of the threads in another thread as spawning threads
     // can take a while.
     Threads.reserve(ThreadCount);
@@ -77,6 +193,8 @@ class ThreadPoolExecutor : public Executor {
         T.detach();
       else
         T.join();
+    for (Task *T : Injected)
+      delete T;
   }
 
   struct Creator {
@@ -87,36 +205,125 @@ class ThreadPoolExecutor : public Executor {
   };
 
   void add(std::function<void()> F) override {
-    {
+    Task *T = new Task(std::move(F));
+    if (CurrentExecutor == this) {
+      Deques[CurrentWorker]->push(T);
+    } else {
       std::lock_guard<std::mutex> Lock(Mutex);
-      WorkStack.push(F);
+      Injected.push_back(T);
+      NumInjected.fetch_add(1, std::memory_order_relaxed);
     }
-    Cond.notify_one();
+    wakeOne();
+  }
+
+  bool runOne() override {
+    Task *T = findTask();
+    if (!T)
+      return false;
+    run(T);
+    return true;
   }
 
 private:
   void work(ThreadPoolStrategy S, unsigned ThreadID) {
     S.apply_thread_strategy(ThreadID);
-    while (true) {
+    CurrentExecutor = this;
+    CurrentWorker = ThreadID;
+    while (!Stop) {
+      if (Task *T = findTask()) {
+        run(T);
+        continue;
+      }
+
+      // Nothing to do.  Announce that we are about to sleep and look once
+      // more: either that finds the work or add() sees us and wakes us up.
       std::unique_lock<std::mutex> Lock(Mutex);
-      Cond.wait(Lock, [&] { return Stop || !WorkStack.empty(); });
-      if (Stop)
-        break;
-      auto Task = WorkStack.top();
-      WorkStack.pop();
+      unsigned WakeEpoch = Epoch;
+      Sleepers.fetch_add(1, std::memory_order_seq_cst);
       Lock.unlock();
-      Task();
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (Task *T = findTask()) {
+        Sleepers.fetch_sub(1, std::memory_order_relaxed);
+        run(T);
+        continue;
+      }
+      Lock.lock();
+      Cond.wait(Lock, [&] { return Stop || Epoch != WakeEpoch; });
+      Sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  void wakeOne() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (Sleepers.load(std::memory_order_seq_cst) == 0)
+      return;
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      ++Epoch;
+    }
+    Cond.notify_one();
+  }
+
+  static void run(Task *T) {
+    (*T)();
+    delete T;
+  }
+
+  /// Find a task for the calling thread: the newest one on its own deque if
+  /// it is one of our workers, else the newest one on the shared queue, else
+  /// the oldest one on some other worker's deque.
+  Task *findTask() {
+    bool IsWorker = CurrentExecutor == this;
+    if (IsWorker)
+      if (Task *T = Deques[CurrentWorker]->pop())
+        return T;
+
+    if (NumInjected.load(std::memory_order_relaxed) != 0) {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (!Injected.empty()) {
+        Task *T = Injected.back();
+        Injected.pop_back();
+        NumInjected.fetch_sub(1, std::memory_order_relaxed);
+        return T;
+      }
     }
+
+    // Start with the next worker over so that thieves spread out.
+    unsigned N = Deques.size();
+    unsigned Start = IsWorker ? CurrentWorker + 1 : 0;
+    bool Lost;
+    do {
+      Lost = false;
+      for (unsigned I = 0; I < N; ++I) {
+        unsigned Victim = (Start + I) % N;
+        if (IsWorker && Victim == CurrentWorker)
+          continue;
+        if (Task *T = Deques[Victim]->steal(Lost))
+          return T;
+      }
+    } while (Lost);
+    return nullptr;
   }
 
+  // The executor and worker index of the calling thread, if it is a worker.
+  static LLVM_THREAD_LOCAL ThreadPoolExecutor *CurrentExecutor;
+  static LLVM_THREAD_LOCAL unsigned CurrentWorker;
+
   std::atomic<bool> Stop{false};
-  std::stack<std::function<void()>> WorkStack;
+  std::vector<std::unique_ptr<WorkDeque>> Deques;
+  std::deque<Task *> Injected;
+  std::atomic<unsigned> NumInjected{0};
+  std::atomic<unsigned> Sleepers{0};
+  unsigned Epoch = 0;
   std::mutex Mutex;
   std::condition_variable Cond;
   std::promise<void> ThreadsCreated;
   std::vector<std::thread> Threads;
 };
 
+LLVM_THREAD_LOCAL ThreadPoolExecutor *ThreadPoolExecutor::CurrentExecutor;
+LLVM_THREAD_LOCAL unsigned ThreadPoolExecutor::CurrentWorker;
+
 Executor *Executor::getDefaultExecutor() {
   // The ManagedStatic enables the ThreadPoolExecutor to be stopped via
   // llvm_shutdown() which allows a "clean" fast exit, e.g. via _exit(). This
@@ -144,20 +351,71 @@ Executor *Executor::getDefaultExecutor() {
 }
 } // namespace
 
-static std::atomic<int> TaskGroupInstances;
+namespace {
+/// A TaskGroup that is alive, and the number of its tasks that have not
+/// finished yet.
+struct GroupRecord {
+  const TaskGroup *Group;
+  GroupRecord *Outer;
+  std::atomic<unsigned> Pending{0};
+};
+} // namespace
 
-// Latch::sync() called by the dtor may cause one thread to block. If is a dead
-// lock if all threads in the default executor are blocked. To prevent the dead
-// lock, only allow the first TaskGroup to run tasks parallelly. In the scenario
-// of nested parallel_for_each(), only the outermost one runs parallelly.
-TaskGroup::TaskGroup() : Parallel(TaskGroupInstances++ == 0) {}
-TaskGroup::~TaskGroup() { --TaskGroupInstances; }
+// The TaskGroups created on this thread that are still alive, innermost
+// first.  They are destroyed in the reverse order of creation.
+static LLVM_THREAD_LOCAL GroupRecord *InnermostGroup;
+
+// The TaskGroup of the task that this thread is running, if any.
+static LLVM_THREAD_LOCAL GroupRecord *RunningGroup;
+
+// Any TaskGroup runs its tasks in parallel, including ones nested in the
+// tasks of another: a thread that waits for a group runs queued tasks in the
+// meantime, so even if every worker waits for a nested group, the tasks they
+// wait for still get to run.  Only a single-threaded strategy runs them on
+// the spot.
+TaskGroup::TaskGroup() : Parallel(strategy.ThreadsRequested != 1) {
+  if (Parallel)
+    InnermostGroup = new GroupRecord{this, InnermostGroup};
+}
+
+TaskGroup::~TaskGroup() {
+  if (!Parallel)
+    return;
+  GroupRecord *Record = InnermostGroup;
+  assert(Record && Record->Group == this &&
+         "TaskGroups must be destroyed in reverse order of creation");
+
+  // Help out until our tasks are done.  When nothing is left to run, those
+  // that are not done are running on other threads, so blocking is safe.
+  Executor *E = Executor::getDefaultExecutor();
+  while (Record->Pending.load(std::memory_order_acquire) != 0 && E->runOne())
+    ;
+  L.sync();
+
+  InnermostGroup = Record->Outer;
+  delete Record;
+}
 
 void TaskGroup::spawn(std::function<void()> F) {
   if (Parallel) {
+    // Tasks are counted if they are spawned by the thread that created the
+    // group or by one of its tasks, which covers recursive algorithms like
+    // parallel_sort.  The Latch still decides when the group is done.
+    GroupRecord *Record = InnermostGroup;
+    if (!Record || Record->Group != this)
+      Record = RunningGroup;
+    if (Record && Record->Group != this)
+      Record = nullptr;
+    if (Record)
+      Record->Pending.fetch_add(1, std::memory_order_relaxed);
     L.inc();
-    Executor::getDefaultExecutor()->add([&, F] {
+    Executor::getDefaultExecutor()->add([&, F, Record] {
+      GroupRecord *Outer = RunningGroup;
+      RunningGroup = Record;
       F();
+      RunningGroup = Outer;
+      if (Record)
+        Record->Pending.fetch_sub(1, std::memory_order_release);
       L.dec();
     });
   } else {
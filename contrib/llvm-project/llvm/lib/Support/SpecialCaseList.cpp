@@ -14,11 +14,13 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/SpecialCaseList.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Regex.h"
 #include "llvm/Support/VirtualFileSystem.h"
+#include <algorithm>
 #include <string>
 #include <system_error>
 #include <utility>
@@ -26,6 +28,211 @@
 #include <stdio.h>
 namespace llvm {
 
+// Plain wildcards use no metacharacters but '.' and '*'.
+static bool isGlob(StringRef Regexp) {
+  return Regexp.find_first_of("^$|()[]{}+?\\") == StringRef::npos;
+}
+
+// Matches Query against a plain wildcard, where '.' stands for any one
+// character and '*' for any run of them, just like the regex the entry
+// stands for once '*' is replaced with '.*'.
+static bool matchGlob(StringRef Glob, StringRef Query) {
+  size_t G = 0, Q = 0;
+  size_t StarG = StringRef::npos, StarQ = 0;
+  while (Q < Query.size()) {
+    if (G < Glob.size() && Glob[G] == '*') {
+      StarG = G++;
+      StarQ = Q;
+    } else if (G < Glob.size() && (Glob[G] == '.' || Glob[G] == Query[Q])) {
+      ++G;
+      ++Q;
+    } else if (StarG != StringRef::npos) {
+      // Let the last '*' take one more character and try again.
+      G = StarG + 1;
+      Q = ++StarQ;
+    } else {
+      return false;
+    }
+  }
+  while (G < Glob.size() && Glob[G] == '*')
+    ++G;
+  return G == Glob.size();
+}
+
+// Returns the longest run of text that anything matching the entry Regexp
+// (before '*' is replaced with '.*') must contain, or an empty string if
+// there is none or it is not obvious.
+static std::string requiredLiteral(StringRef Regexp) {
+  if (Regexp.contains('|'))
+    return std::string();
+  std::string Best, Run;
+  auto EndRun = [&] {
+    if (Run.size() > Best.size())
+      Best = Run;
+    Run.clear();
+  };
+  for (size_t I = 0, E = Regexp.size(); I != E; ++I) {
+    char C = Regexp[I];
+    switch (C) {
+    case '?':
+    case '{':
+      // The character before is optional.
+      if (!Run.empty())
+        Run.pop_back();
+      EndRun();
+      if (C == '{')
+        I = std::min(Regexp.find('}', I), E - 1);
+      break;
+    case '+':
+    case '*':
+    case '.':
+    case '^':
+    case '$':
+    case ')':
+      EndRun();
+      break;
+    case '(': {
+      EndRun();
+      // Skip the group; it may be optional.
+      unsigned Depth = 1;
+      while (Depth && ++I != E) {
+        if (Regexp[I] == '\\')
+          ++I;
+        else if (Regexp[I] == '(')
+          ++Depth;
+        else if (Regexp[I] == ')')
+          --Depth;
+      }
+      if (I == E)
+        return std::string();
+      break;
+    }
+    case '[':
+      EndRun();
+      // Skip the bracket expression, in which a leading ']' is literal,
+      // and "[:class:]", "[=equiv=]" and "[.coll.]" have ']' of their own.
+      if (I + 1 != E && Regexp[I + 1] == '^')
+        ++I;
+      if (I + 1 != E && Regexp[I + 1] == ']')
+        ++I;
+      while (++I != E && Regexp[I] != ']') {
+        if (Regexp[I] == '[' && I + 1 != E &&
+            (Regexp[I + 1] == ':' || Regexp[I + 1] == '=' ||
+             Regexp[I + 1] == '.')) {
+          char Close[] = {Regexp[I + 1], ']', '\0'};
+          I = Regexp.find(Close, I + 2);
+          if (I == StringRef::npos)
+            return std::string();
+          ++I;
+        }
+      }
+      if (I == E)
+        return std::string();
+      break;
+    case '\\':
+      // An escaped '*' becomes an escaped '.' that may repeat.
+      if (I + 1 == E || isAlnum(Regexp[I + 1]) || Regexp[I + 1] == '*') {
+        EndRun();
+        ++I;
+        break;
+      }
+      Run += Regexp[++I];
+      break;
+    default:
+      Run += C;
+      break;
+    }
+  }
+  EndRun();
+  return Best;
+}
+
+void SpecialCaseList::Matcher::LiteralIndex::insert(StringRef Literal,
+                                                    unsigned PatternIndex) {
+  Literals.emplace_back(std::string(Literal), PatternIndex);
+}
+
+unsigned SpecialCaseList::Matcher::LiteralIndex::next(unsigned S,
+                                                      unsigned char C) const {
+  if (S == 0)
+    return RootNext[C];
+  const auto &Next = States[S].Next;
+  auto It = std::lower_bound(
+      Next.begin(), Next.end(), C,
+      [](const std::pair<unsigned char, unsigned> &P, unsigned char C) {
+        return P.first < C;
+      });
+  return It != Next.end() && It->first == C ? It->second : 0;
+}
+
+void SpecialCaseList::Matcher::LiteralIndex::build() {
+  if (NumBuilt == Literals.size())
+    return;
+  States.assign(1, State());
+  std::fill(std::begin(RootNext), std::end(RootNext), 0);
+
+  // A trie of the literals...
+  for (const auto &L : Literals) {
+    unsigned S = 0;
+    for (unsigned char C : L.first) {
+      unsigned T = next(S, C);
+      if (!T) {
+        T = States.size();
+        States.emplace_back();
+        auto &Next = States[S].Next;
+        Next.insert(std::upper_bound(
+                        Next.begin(), Next.end(), std::make_pair(C, 0u),
+                        [](const std::pair<unsigned char, unsigned> &A,
+                           const std::pair<unsigned char, unsigned> &B) {
+                          return A.first < B.first;
+                        }),
+                    std::make_pair(C, T));
+        if (S == 0)
+          RootNext[C] = T;
+      }
+      S = T;
+    }
+    States[S].Ends.push_back(L.second);
+  }
+
+  // ...with failure links added breadth first, so that a state's links are
+  // set before those of its children.
+  std::vector<unsigned> Queue;
+  for (const auto &P : States[0].Next)
+    Queue.push_back(P.second);
+  for (size_t Head = 0; Head != Queue.size(); ++Head) {
+    unsigned S = Queue[Head];
+    for (const auto &P : States[S].Next) {
+      unsigned T = P.second;
+      unsigned F = States[S].Fail;
+      while (F && !next(F, P.first))
+        F = States[F].Fail;
+      F = next(F, P.first);
+      States[T].Fail = F;
+      States[T].Output = States[F].Ends.empty() ? States[F].Output : F;
+      Queue.push_back(T);
+    }
+  }
+  NumBuilt = Literals.size();
+}
+
+void SpecialCaseList::Matcher::LiteralIndex::find(
+    StringRef Query, SmallVectorImpl<unsigned> &Found) const {
+  if (!States.empty()) {
+    unsigned S = 0;
+    for (unsigned char C : Query) {
+      while (S && !next(S, C))
+        S = States[S].Fail;
+      S = next(S, C);
+      for (unsigned O = States[S].Ends.empty() ? States[S].Output : S; O;
+           O = States[O].Output)
+        Found.append(States[O].Ends.begin(), States[O].Ends.end());
+    }
+  }
+  for (size_t I = NumBuilt, E = Literals.size(); I != E; ++I)
+    Found.push_back(Literals[I].second);
+}
+
 bool SpecialCaseList::Matcher::insert(std::string Regexp,
                                       unsigned LineNumber,
                                       std::string &REError) {
@@ -38,35 +245,53 @@ bool SpecialCaseList::Matcher::insert(std::string Regexp,
     Strings[Regexp] = LineNumber;
     return true;
   }
-  Trigrams.insert(Regexp);
 
-  // Replace * with .*
-  for (size_t pos = 0; (pos = Regexp.find('*', pos)) != std::string::npos;
-       pos += strlen(".*")) {
-    Regexp.replace(pos, strlen("*"), ".*");
-  }
+  Pattern P;
+  P.LineNumber = LineNumber;
+  std::string Literal = requiredLiteral(Regexp);
+  if (isGlob(Regexp)) {
+    P.Glob = std::move(Regexp);
+  } else {
+    // Replace * with .*
+    for (size_t pos = 0; (pos = Regexp.find('*', pos)) != std::string::npos;
+         pos += strlen(".*")) {
+      Regexp.replace(pos, strlen("*"), ".*");
+    }
 
-  Regexp = (Twine("^(") + StringRef(Regexp) + ")$").str();
+    Regexp = (Twine("^(") + StringRef(Regexp) + ")$").str();
 
-  // Check that the regexp is valid.
-  Regex CheckRE(Regexp);
-  if (!CheckRE.isValid(REError))
-    return false;
+    // Check that the regexp is valid.
+    Regex CheckRE(Regexp);
+    if (!CheckRE.isValid(REError))
+      return false;
+    P.RegEx = std::make_unique<Regex>(std::move(CheckRE));
+  }
 
-  RegExes.emplace_back(
-      std::make_pair(std::make_unique<Regex>(std::move(CheckRE)), LineNumber));
+  if (Literal.empty())
+    Unindexed.push_back(Patterns.size());
+  else
+    Index.insert(Literal, Patterns.size());
+  Patterns.push_back(std::move(P));
   return true;
 }
 
+void SpecialCaseList::Matcher::finalize() { Index.build(); }
+
 unsigned SpecialCaseList::Matcher::match(StringRef Query) const {
   auto It = Strings.find(Query);
   if (It != Strings.end())
     return It->second;
-  if (Trigrams.isDefinitelyOut(Query))
-    return false;
-  for (auto& RegExKV : RegExes)
-    if (RegExKV.first->match(Query))
-      return RegExKV.second;
+  SmallVector<unsigned, 16> Candidates(Unindexed.begin(), Unindexed.end());
+  Index.find(Query, Candidates);
+  // Try them in the order they were listed, as the first match wins.
+  llvm::sort(Candidates);
+  Candidates.erase(std::unique(Candidates.begin(), Candidates.end()),
+                   Candidates.end());
+  for (unsigned I : Candidates) {
+    const Pattern &P = Patterns[I];
+    if (P.RegEx ? P.RegEx->match(Query) : matchGlob(P.Glob, Query))
+      return P.LineNumber;
+  }
   return 0;
 }
 
@@ -196,6 +421,13 @@ bool SpecialCaseList::parse(const MemoryBuffer *MB,
       return false;
     }
   }
+
+  for (auto &S : Sections) {
+    S.SectionMatcher->finalize();
+    for (auto &PrefixEntries : S.Entries)
+      for (auto &CategoryMatcher : PrefixEntries.getValue())
+        CategoryMatcher.getValue().finalize();
+  }
   return true;
 }
 
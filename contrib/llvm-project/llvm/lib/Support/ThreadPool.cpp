@@ -28,10 +28,22 @@ ThreadPool::ThreadPool(ThreadPoolStrategy S)
   for (unsigned ThreadID = 0; ThreadID < ThreadCount; ++ThreadID) {
     Threads.emplace_back([S, ThreadID, this] {
       S.apply_thread_strategy(ThreadID);
+      bool RanTask = false;
       while (true) {
         PackagedTaskTy Task;
         {
           std::unique_lock<std::mutex> LockGuard(QueueLock);
+          // Account for the task we just ran, if any, under the same lock as
+          // picking the next one.
+          if (RanTask) {
+            // Adjust `ActiveThreads`, in case someone waits on
+            // ThreadPool::wait(), and notify task completion if this is the
+            // last active thread.
+            --ActiveThreads;
+            if (workCompletedUnlocked())
+              CompletionCondition.notify_all();
+            RanTask = false;
+          }
           // Wait for tasks to be pushed in the queue
           QueueCondition.wait(LockGuard,
                               [&] { return !EnableFlag || !Tasks.empty(); });
@@ -49,26 +61,30 @@ ThreadPool::ThreadPool(ThreadPoolStrategy S)
         }
         // Run the task we just grabbed
         Task();
-
-        bool Notify;
-        {
-          // Adjust `ActiveThreads`, in case someone waits on ThreadPool::wait()
-          std::lock_guard<std::mutex> LockGuard(QueueLock);
-          --ActiveThreads;
-          Notify = workCompletedUnlocked();
-        }
-        // Notify task completion if this is the last active thread, in case
-        // someone waits on ThreadPool::wait().
-        if (Notify)
-          CompletionCondition.notify_all();
+        RanTask = true;
       }
     });
   }
 }
 
 void ThreadPool::wait() {
-  // Wait for all threads to complete and the queue to be empty
   std::unique_lock<std::mutex> LockGuard(QueueLock);
+  // Rather than sit idle, run queued tasks on this thread as well.
+  while (!Tasks.empty()) {
+    ++ActiveThreads;
+    PackagedTaskTy Task = std::move(Tasks.front());
+    Tasks.pop();
+    LockGuard.unlock();
+    Task();
+    LockGuard.lock();
+    --ActiveThreads;
+  }
+  if (workCompletedUnlocked()) {
+    // Others may be waiting too.
+    CompletionCondition.notify_all();
+    return;
+  }
+  // Wait for all threads to complete and the queue to be empty
   CompletionCondition.wait(LockGuard, [&] { return workCompletedUnlocked(); });
 }
 
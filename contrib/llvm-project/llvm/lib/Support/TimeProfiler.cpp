@@ -12,7 +12,9 @@
 
 #include "llvm/Support/TimeProfiler.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/JSON.h"
 #include "llvm/Support/Path.h"
@@ -21,6 +23,7 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -42,19 +45,16 @@ TimeTraceProfiler *llvm::getTimeTraceProfilerInstance() {
 typedef duration<steady_clock::rep, steady_clock::period> DurationType;
 typedef time_point<steady_clock> TimePointType;
 typedef std::pair<size_t, DurationType> CountAndDurationType;
-typedef std::pair<std::string, CountAndDurationType>
-    NameAndCountAndDurationType;
 
 namespace {
+// A finished event.  Names are interned per thread, and details are copied
+// into the thread's arena, so recording one needs no allocation beyond an
+// occasional new chunk.
 struct Entry {
-  const TimePointType Start;
+  TimePointType Start;
   TimePointType End;
-  const std::string Name;
-  const std::string Detail;
-
-  Entry(TimePointType &&S, TimePointType &&E, std::string &&N, std::string &&Dt)
-      : Start(std::move(S)), End(std::move(E)), Name(std::move(N)),
-        Detail(std::move(Dt)) {}
+  unsigned NameId;
+  StringRef Detail;
 
   // Calculate timings for FlameGraph. Cast time points to microsecond precision
   // rather than casting duration. This avoid truncation issues causing inner
@@ -71,6 +71,22 @@ struct Entry {
         .count();
   }
 };
+
+// An event that has begun but not ended.  Its detail is kept in
+// OpenDetails until then, since most events are shorter than the
+// granularity and never stored.
+struct OpenEntry {
+  TimePointType Start;
+  unsigned NameId;
+  size_t DetailBegin;
+};
+
+struct NameInfo {
+  StringRef Name;
+  // Number of open events with this name.
+  unsigned Open = 0;
+  CountAndDurationType CountAndTotal;
+};
 } // namespace
 
 struct llvm::TimeTraceProfiler {
@@ -81,46 +97,77 @@ struct llvm::TimeTraceProfiler {
     llvm::get_thread_name(ThreadName);
   }
 
-  void begin(std::string Name, llvm::function_ref<std::string()> Detail) {
-    Stack.emplace_back(steady_clock::now(), TimePointType(), std::move(Name),
-                       Detail());
+  void begin(StringRef Name, StringRef Detail) {
+    unsigned NameId = intern(Name);
+    ++Names[NameId].Open;
+    size_t DetailBegin = OpenDetails.size();
+    OpenDetails.append(Detail.begin(), Detail.end());
+    Stack.push_back({steady_clock::now(), NameId, DetailBegin});
   }
 
   void end() {
+    TimePointType End = steady_clock::now();
     assert(!Stack.empty() && "Must call begin() first");
-    Entry &E = Stack.back();
-    E.End = steady_clock::now();
-
-    // Check that end times monotonically increase.
-    assert((Entries.empty() ||
-            (E.getFlameGraphStartUs(StartTime) + E.getFlameGraphDurUs() >=
-             Entries.back().getFlameGraphStartUs(StartTime) +
-                 Entries.back().getFlameGraphDurUs())) &&
-           "TimeProfiler scope ended earlier than previous scope");
+    OpenEntry &O = Stack.back();
 
     // Calculate duration at full precision for overall counts.
-    DurationType Duration = E.End - E.Start;
+    DurationType Duration = End - O.Start;
 
     // Only include sections longer or equal to TimeTraceGranularity msec.
-    if (duration_cast<microseconds>(Duration).count() >= TimeTraceGranularity)
-      Entries.emplace_back(E);
+    if (duration_cast<microseconds>(Duration).count() >= TimeTraceGranularity) {
+      StringRef Detail(OpenDetails.data() + O.DetailBegin,
+                       OpenDetails.size() - O.DetailBegin);
+      if (!Detail.empty())
+        Detail = Detail.copy(Details);
+      Entry &E = addEntry();
+      E = {O.Start, End, O.NameId, Detail};
+
+      // Check that end times monotonically increase.
+      assert((NumEntries == 1 ||
+              (E.getFlameGraphStartUs(StartTime) + E.getFlameGraphDurUs() >=
+               LastEnd)) &&
+             "TimeProfiler scope ended earlier than previous scope");
+#ifndef NDEBUG
+      LastEnd = E.getFlameGraphStartUs(StartTime) + E.getFlameGraphDurUs();
+#endif
+    }
 
     // Track total time taken by each "name", but only the topmost levels of
     // them; e.g. if there's a template instantiation that instantiates other
     // templates from within, we only want to add the topmost one. "topmost"
     // happens to be the ones that don't have any currently open entries above
     // itself.
-    if (std::find_if(++Stack.rbegin(), Stack.rend(), [&](const Entry &Val) {
-          return Val.Name == E.Name;
-        }) == Stack.rend()) {
-      auto &CountAndTotal = CountAndTotalPerName[E.Name];
-      CountAndTotal.first++;
-      CountAndTotal.second += Duration;
+    NameInfo &N = Names[O.NameId];
+    if (--N.Open == 0) {
+      N.CountAndTotal.first++;
+      N.CountAndTotal.second += Duration;
     }
 
+    OpenDetails.truncate(O.DetailBegin);
     Stack.pop_back();
   }
 
+  unsigned intern(StringRef Name) {
+    auto R = NameIds.try_emplace(Name, Names.size());
+    if (R.second) {
+      Names.emplace_back();
+      Names.back().Name = R.first->getKey();
+    }
+    return R.first->getValue();
+  }
+
+  Entry &addEntry() {
+    if (NumEntries % EntriesPerChunk == 0)
+      Chunks.push_back(std::make_unique<Entry[]>(EntriesPerChunk));
+    size_t I = NumEntries++;
+    return Chunks[I / EntriesPerChunk][I % EntriesPerChunk];
+  }
+
+  template <typename Fn> void forEachEntry(Fn F) const {
+    for (size_t I = 0; I != NumEntries; ++I)
+      F(Chunks[I / EntriesPerChunk][I % EntriesPerChunk]);
+  }
+
   // Write events from this TimeTraceProfilerInstance and
   // ThreadTimeTraceProfilerInstances.
   void write(raw_pwrite_stream &OS) {
@@ -137,28 +184,30 @@ struct llvm::TimeTraceProfiler {
     J.attributeBegin("traceEvents");
     J.arrayBegin();
 
-    // Emit all events for the main flame graph.
-    auto writeEvent = [&](const auto &E, uint64_t Tid) {
-      auto StartUs = E.getFlameGraphStartUs(StartTime);
-      auto DurUs = E.getFlameGraphDurUs();
-
-      J.object([&] {
-        J.attribute("pid", Pid);
-        J.attribute("tid", int64_t(Tid));
-        J.attribute("ph", "X");
-        J.attribute("ts", StartUs);
-        J.attribute("dur", DurUs);
-        J.attribute("name", E.Name);
-        if (!E.Detail.empty()) {
-          J.attributeObject("args", [&] { J.attribute("detail", E.Detail); });
-        }
+    // Emit all events for the main flame graph, straight from each thread's
+    // chunks.
+    auto writeEvents = [&](const TimeTraceProfiler &TTP) {
+      TTP.forEachEntry([&](const Entry &E) {
+        auto StartUs = E.getFlameGraphStartUs(StartTime);
+        auto DurUs = E.getFlameGraphDurUs();
+
+        J.object([&] {
+          J.attribute("pid", Pid);
+          J.attribute("tid", int64_t(TTP.Tid));
+          J.attribute("ph", "X");
+          J.attribute("ts", StartUs);
+          J.attribute("dur", DurUs);
+          J.attribute("name", TTP.Names[E.NameId].Name);
+          if (!E.Detail.empty()) {
+            J.attributeObject("args",
+                              [&] { J.attribute("detail", E.Detail); });
+          }
+        });
       });
     };
-    for (const Entry &E : Entries)
-      writeEvent(E, this->Tid);
+    writeEvents(*this);
     for (const TimeTraceProfiler *TTP : ThreadTimeTraceProfilerInstances)
-      for (const Entry &E : TTP->Entries)
-        writeEvent(E, TTP->Tid);
+      writeEvents(*TTP);
 
     // Emit totals by section name as additional "thread" events, sorted from
     // longest one.
@@ -167,36 +216,39 @@ struct llvm::TimeTraceProfiler {
     for (const TimeTraceProfiler *TTP : ThreadTimeTraceProfilerInstances)
       MaxTid = std::max(MaxTid, TTP->Tid);
 
-    // Combine all CountAndTotalPerName from threads into one.
+    // Combine all names' totals from threads into one.  There are only as
+    // many of these as there are distinct names.  Names whose events are
+    // all still open have no finished event to report.
     StringMap<CountAndDurationType> AllCountAndTotalPerName;
-    auto combineStat = [&](const auto &Stat) {
-      StringRef Key = Stat.getKey();
-      auto Value = Stat.getValue();
-      auto &CountAndTotal = AllCountAndTotalPerName[Key];
-      CountAndTotal.first += Value.first;
-      CountAndTotal.second += Value.second;
+    auto combineStats = [&](const TimeTraceProfiler &TTP) {
+      for (const NameInfo &N : TTP.Names) {
+        if (N.CountAndTotal.first == 0)
+          continue;
+        auto &CountAndTotal = AllCountAndTotalPerName[N.Name];
+        CountAndTotal.first += N.CountAndTotal.first;
+        CountAndTotal.second += N.CountAndTotal.second;
+      }
     };
-    for (const auto &Stat : CountAndTotalPerName)
-      combineStat(Stat);
+    combineStats(*this);
     for (const TimeTraceProfiler *TTP : ThreadTimeTraceProfilerInstances)
-      for (const auto &Stat : TTP->CountAndTotalPerName)
-        combineStat(Stat);
+      combineStats(*TTP);
 
-    std::vector<NameAndCountAndDurationType> SortedTotals;
+    std::vector<const StringMapEntry<CountAndDurationType> *> SortedTotals;
     SortedTotals.reserve(AllCountAndTotalPerName.size());
     for (const auto &Total : AllCountAndTotalPerName)
-      SortedTotals.emplace_back(std::string(Total.getKey()), Total.getValue());
+      SortedTotals.push_back(&Total);
 
-    llvm::sort(SortedTotals, [](const NameAndCountAndDurationType &A,
-                                const NameAndCountAndDurationType &B) {
-      return A.second.second > B.second.second;
+    llvm::sort(SortedTotals, [](const StringMapEntry<CountAndDurationType> *A,
+                                const StringMapEntry<CountAndDurationType> *B) {
+      return A->getValue().second > B->getValue().second;
     });
 
     // Report totals on separate threads of tracing file.
     uint64_t TotalTid = MaxTid + 1;
-    for (const NameAndCountAndDurationType &Total : SortedTotals) {
-      auto DurUs = duration_cast<microseconds>(Total.second.second).count();
-      auto Count = AllCountAndTotalPerName[Total.first].first;
+    for (const StringMapEntry<CountAndDurationType> *Total : SortedTotals) {
+      const CountAndDurationType &CountAndTotal = Total->getValue();
+      auto DurUs = duration_cast<microseconds>(CountAndTotal.second).count();
+      auto Count = CountAndTotal.first;
 
       J.object([&] {
         J.attribute("pid", Pid);
@@ -204,7 +256,7 @@ struct llvm::TimeTraceProfiler {
         J.attribute("ph", "X");
         J.attribute("ts", 0);
         J.attribute("dur", DurUs);
-        J.attribute("name", "Total " + Total.first);
+        J.attribute("name", "Total " + Total->getKey().str());
         J.attributeObject("args", [&] {
           J.attribute("count", int64_t(Count));
           J.attribute("avg ms", int64_t(DurUs / Count / 1000));
@@ -246,9 +298,20 @@ struct llvm::TimeTraceProfiler {
     J.objectEnd();
   }
 
-  SmallVector<Entry, 16> Stack;
-  SmallVector<Entry, 128> Entries;
-  StringMap<CountAndDurationType> CountAndTotalPerName;
+  // Everything below belongs to the thread that owns the profiler until
+  // it calls timeTraceProfilerFinishThread(), so recording takes no locks.
+  SmallVector<OpenEntry, 16> Stack;
+  SmallString<256> OpenDetails;
+  // Finished events, in fixed-size chunks so that they are never moved.
+  static constexpr size_t EntriesPerChunk = 1024;
+  SmallVector<std::unique_ptr<Entry[]>, 0> Chunks;
+  size_t NumEntries = 0;
+#ifndef NDEBUG
+  steady_clock::rep LastEnd = 0;
+#endif
+  BumpPtrAllocator Details;
+  StringMap<unsigned> NameIds;
+  std::vector<NameInfo> Names;
   const time_point<system_clock> BeginningOfTime;
   const TimePointType StartTime;
   const std::string ProcName;
@@ -272,6 +335,7 @@ void llvm::timeTraceProfilerInitialize(unsigned TimeTraceGranularity,
 // Called from main thread.
 void llvm::timeTraceProfilerCleanup() {
   delete TimeTraceProfilerInstance;
+  TimeTraceProfilerInstance = nullptr;
   std::lock_guard<std::mutex> Lock(Mu);
   for (auto TTP : ThreadTimeTraceProfilerInstances)
     delete TTP;
@@ -314,14 +378,13 @@ Error llvm::timeTraceProfilerWrite(StringRef PreferredFileName,
 
 void llvm::timeTraceProfilerBegin(StringRef Name, StringRef Detail) {
   if (TimeTraceProfilerInstance != nullptr)
-    TimeTraceProfilerInstance->begin(std::string(Name),
-                                     [&]() { return std::string(Detail); });
+    TimeTraceProfilerInstance->begin(Name, Detail);
 }
 
 void llvm::timeTraceProfilerBegin(StringRef Name,
                                   llvm::function_ref<std::string()> Detail) {
   if (TimeTraceProfilerInstance != nullptr)
-    TimeTraceProfilerInstance->begin(std::string(Name), Detail);
+    TimeTraceProfilerInstance->begin(Name, Detail());
 }
 
 void llvm::timeTraceProfilerEnd() {
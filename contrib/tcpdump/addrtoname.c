@@ -57,6 +57,9 @@ extern int ether_ntohost(char *, const struct ether_addr *);
 
 #include <pcap.h>
 #include <pcap-namedb.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 #include <signal.h>
 #include <stdio.h>
 #include <string.h>
@@ -83,18 +86,102 @@ extern int ether_ntohost(char *, const struct ether_addr *);
 
 #define HASHNAMESIZE 4096
 
+/* Still used by print-atalk.c, through newhnamemem(). */
 struct hnamemem {
 	uint32_t addr;
 	const char *name;
 	struct hnamemem *nxt;
 };
 
-static struct hnamemem hnametable[HASHNAMESIZE];
-static struct hnamemem tporttable[HASHNAMESIZE];
-static struct hnamemem uporttable[HASHNAMESIZE];
-static struct hnamemem eprototable[HASHNAMESIZE];
-static struct hnamemem dnaddrtable[HASHNAMESIZE];
-static struct hnamemem ipxsaptable[HASHNAMESIZE];
+/*
+ * Names for IPv4 addresses, and for port and protocol numbers, are kept
+ * in open-addressed tables, keyed on the whole address or number.  A
+ * table starts out empty and doubles in size whenever it gets half
+ * full, so a capture with millions of hosts doesn't turn every lookup
+ * into a walk down a long chain.
+ */
+struct hnameent {
+	uint32_t addr;
+	u_int pending;			/* being looked up by a resolver thread */
+	const char *name;		/* NULL if the slot is free */
+};
+
+struct hnametab {
+	struct hnameent *ent;
+	u_int size;			/* 0, or a power of 2 */
+	u_int count;
+};
+
+static struct hnametab hnametable;
+static struct hnametab tporttable;
+static struct hnametab uporttable;
+static struct hnametab eprototable;
+static struct hnametab dnaddrtable;
+static struct hnametab ipxsaptable;
+
+#define HNAME_MINSIZE	256
+
+static inline u_int
+hname_hash(uint32_t addr)
+{
+	addr *= 0x9e3779b1U;
+	return (addr ^ (addr >> 16));
+}
+
+static void
+hname_grow(netdissect_options *ndo, struct hnametab *t)
+{
+	struct hnameent *ent, *e;
+	u_int size, i, j;
+
+	size = t->size != 0 ? t->size * 2 : HNAME_MINSIZE;
+	ent = (struct hnameent *)calloc(size, sizeof(*ent));
+	if (ent == NULL)
+		(*ndo->ndo_error)(ndo, "hname_grow: calloc");
+	for (i = 0; i < t->size; i++) {
+		e = &t->ent[i];
+		if (e->name == NULL)
+			continue;
+		for (j = hname_hash(e->addr) & (size - 1); ent[j].name != NULL;
+		    j = (j + 1) & (size - 1))
+			continue;
+		ent[j] = *e;
+	}
+	free(t->ent);
+	t->ent = ent;
+	t->size = size;
+}
+
+/*
+ * Find the entry for addr.  If there isn't one and insert is set, a
+ * free slot is claimed for it, and the caller must set its name before
+ * anything else is done with the table; otherwise NULL is returned.
+ */
+static struct hnameent *
+hname_lookup(netdissect_options *ndo, struct hnametab *t, uint32_t addr,
+    int insert)
+{
+	struct hnameent *e;
+	u_int i;
+
+	if (insert && (t->count + 1) * 2 > t->size)
+		hname_grow(ndo, t);
+	if (t->size == 0)
+		return (NULL);
+	for (i = hname_hash(addr) & (t->size - 1); ; i = (i + 1) & (t->size - 1)) {
+		e = &t->ent[i];
+		if (e->name == NULL)
+			break;
+		if (e->addr == addr)
+			return (e);
+	}
+	if (!insert)
+		return (NULL);
+	e->addr = addr;
+	e->pending = 0;
+	t->count++;
+	return (e);
+}
 
 #ifdef _WIN32
 /*
@@ -136,13 +223,83 @@ win32_gethostbyaddr(const char *addr, int len, int type)
 #define gethostbyaddr win32_gethostbyaddr
 #endif /* _WIN32 */
 
-struct h6namemem {
+/* The same, for IPv6 addresses. */
+struct h6nameent {
 	struct in6_addr addr;
-	char *name;
-	struct h6namemem *nxt;
+	u_int pending;
+	const char *name;
+};
+
+struct h6nametab {
+	struct h6nameent *ent;
+	u_int size;
+	u_int count;
 };
 
-static struct h6namemem h6nametable[HASHNAMESIZE];
+static struct h6nametab h6nametable;
+
+static inline u_int
+h6name_hash(const struct in6_addr *addr)
+{
+	uint32_t w[4], h;
+
+	memcpy(w, addr, sizeof(w));
+	h = (w[0] * 0x9e3779b1U) ^ w[1];
+	h = (h * 0x9e3779b1U) ^ w[2];
+	h = (h * 0x9e3779b1U) ^ w[3];
+	return (hname_hash(h));
+}
+
+static void
+h6name_grow(netdissect_options *ndo, struct h6nametab *t)
+{
+	struct h6nameent *ent, *e;
+	u_int size, i, j;
+
+	size = t->size != 0 ? t->size * 2 : HNAME_MINSIZE;
+	ent = (struct h6nameent *)calloc(size, sizeof(*ent));
+	if (ent == NULL)
+		(*ndo->ndo_error)(ndo, "h6name_grow: calloc");
+	for (i = 0; i < t->size; i++) {
+		e = &t->ent[i];
+		if (e->name == NULL)
+			continue;
+		for (j = h6name_hash(&e->addr) & (size - 1);
+		    ent[j].name != NULL; j = (j + 1) & (size - 1))
+			continue;
+		ent[j] = *e;
+	}
+	free(t->ent);
+	t->ent = ent;
+	t->size = size;
+}
+
+static struct h6nameent *
+h6name_lookup(netdissect_options *ndo, struct h6nametab *t,
+    const struct in6_addr *addr, int insert)
+{
+	struct h6nameent *e;
+	u_int i;
+
+	if (insert && (t->count + 1) * 2 > t->size)
+		h6name_grow(ndo, t);
+	if (t->size == 0)
+		return (NULL);
+	for (i = h6name_hash(addr) & (t->size - 1); ;
+	    i = (i + 1) & (t->size - 1)) {
+		e = &t->ent[i];
+		if (e->name == NULL)
+			break;
+		if (memcmp(&e->addr, addr, sizeof(*addr)) == 0)
+			return (e);
+	}
+	if (!insert)
+		return (NULL);
+	e->addr = *addr;
+	e->pending = 0;
+	t->count++;
+	return (e);
+}
 
 struct enamemem {
 	u_short e_addr0;
@@ -216,6 +373,222 @@ static uint32_t f_localnet;
 extern cap_channel_t *capdns;
 #endif
 
+#ifdef HAVE_LIBPTHREAD
+/*
+ * Asynchronous name lookups (--resolver-threads).  getname() and
+ * getname6() don't wait for the name server; they queue the address
+ * for a pool of resolver threads, and print it numerically until the
+ * name comes back.  Finished lookups are collected by the printing
+ * thread when it next looks up an address that is still pending, and
+ * the name then replaces the number in the table.  The numeric string
+ * isn't freed, as a caller may still be holding on to it.
+ */
+#define DNS_MAXQUEUED	65536
+
+struct dnsreq {
+	struct dnsreq *next;
+	int af;
+	union {
+		uint32_t v4;
+		struct in6_addr v6;
+	} addr;
+	char *name;			/* result, or NULL */
+};
+
+static pthread_mutex_t dns_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dns_cv = PTHREAD_COND_INITIALIZER;
+static struct dnsreq *dns_todo;		/* queued, oldest first */
+static struct dnsreq **dns_todo_tail = &dns_todo;
+static struct dnsreq *dns_done;		/* finished */
+static u_int dns_queued;		/* not collected yet; printing thread only */
+static int dns_started;
+#ifdef HAVE_CASPER
+static pthread_mutex_t dns_cap_mtx = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static char *
+dns_resolve(struct dnsreq *req, void *chan)
+{
+	char host[NI_MAXHOST];
+	struct sockaddr_storage ss;
+	struct sockaddr_in *sin;
+	struct sockaddr_in6 *sin6;
+	socklen_t sslen;
+#ifdef HAVE_CASPER
+	struct hostent *hp;
+	char *name;
+
+	if (chan != NULL) {
+		/* A channel to the DNS service handles one lookup at a time. */
+		if (chan == capdns)
+			pthread_mutex_lock(&dns_cap_mtx);
+		if (req->af == AF_INET)
+			hp = cap_gethostbyaddr(chan, (char *)&req->addr.v4,
+			    sizeof(req->addr.v4), AF_INET);
+		else
+			hp = cap_gethostbyaddr(chan, (char *)&req->addr.v6,
+			    sizeof(req->addr.v6), AF_INET6);
+		name = hp != NULL ? strdup(hp->h_name) : NULL;
+		if (chan == capdns)
+			pthread_mutex_unlock(&dns_cap_mtx);
+		return (name);
+	}
+#endif
+	/* gethostbyaddr() needn't be thread-safe; getnameinfo() is. */
+	memset(&ss, 0, sizeof(ss));
+	if (req->af == AF_INET) {
+		sin = (struct sockaddr_in *)&ss;
+		sin->sin_family = AF_INET;
+		memcpy(&sin->sin_addr, &req->addr.v4, sizeof(req->addr.v4));
+		sslen = sizeof(*sin);
+	} else {
+		sin6 = (struct sockaddr_in6 *)&ss;
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_addr = req->addr.v6;
+		sslen = sizeof(*sin6);
+	}
+#ifdef HAVE_STRUCT_SOCKADDR_SA_LEN
+	((struct sockaddr *)&ss)->sa_len = sslen;
+#endif
+	if (getnameinfo((struct sockaddr *)&ss, sslen, host, sizeof(host),
+	    NULL, 0, NI_NAMEREQD) != 0)
+		return (NULL);
+	return (strdup(host));
+}
+
+static void *
+dns_resolver(void *arg _U_)
+{
+	struct dnsreq *req;
+	void *chan = NULL;
+
+#ifdef HAVE_CASPER
+	/* Get a channel of our own, if we can, rather than share one. */
+	if (capdns != NULL) {
+		pthread_mutex_lock(&dns_cap_mtx);
+		chan = cap_clone(capdns);
+		pthread_mutex_unlock(&dns_cap_mtx);
+		if (chan == NULL)
+			chan = capdns;
+	}
+#endif
+	for (;;) {
+		pthread_mutex_lock(&dns_mtx);
+		while (dns_todo == NULL)
+			pthread_cond_wait(&dns_cv, &dns_mtx);
+		req = dns_todo;
+		dns_todo = req->next;
+		if (dns_todo == NULL)
+			dns_todo_tail = &dns_todo;
+		pthread_mutex_unlock(&dns_mtx);
+
+		req->name = dns_resolve(req, chan);
+
+		pthread_mutex_lock(&dns_mtx);
+		req->next = dns_done;
+		dns_done = req;
+		pthread_mutex_unlock(&dns_mtx);
+	}
+	/* NOTREACHED */
+	return (NULL);
+}
+
+/*
+ * Queue a lookup; returns -1 if it can't be done, in which case the
+ * address stays numeric.  The threads are started with the first
+ * lookup, so that they belong to the process that does the printing.
+ */
+static int
+dns_request(netdissect_options *ndo, int af, const void *addr)
+{
+	struct dnsreq *req;
+	pthread_t td;
+	int i;
+
+	if (dns_started == 0) {
+		for (i = 0; i < ndo->ndo_resolver_threads; i++) {
+			if (pthread_create(&td, NULL, dns_resolver, NULL) != 0)
+				break;
+			pthread_detach(td);
+		}
+		if (i == 0)
+			(*ndo->ndo_warning)(ndo,
+			    "can't start resolver threads; not resolving names");
+		dns_started = i > 0 ? 1 : -1;
+	}
+	if (dns_started < 0 || dns_queued >= DNS_MAXQUEUED)
+		return (-1);
+
+	req = (struct dnsreq *)calloc(1, sizeof(*req));
+	if (req == NULL)
+		(*ndo->ndo_error)(ndo, "dns_request: calloc");
+	req->af = af;
+	if (af == AF_INET)
+		memcpy(&req->addr.v4, addr, sizeof(req->addr.v4));
+	else
+		memcpy(&req->addr.v6, addr, sizeof(req->addr.v6));
+
+	dns_queued++;
+	pthread_mutex_lock(&dns_mtx);
+	*dns_todo_tail = req;
+	dns_todo_tail = &req->next;
+	pthread_cond_signal(&dns_cv);
+	pthread_mutex_unlock(&dns_mtx);
+	return (0);
+}
+
+/*
+ * Put the names that have come back into the tables.  This doesn't add
+ * entries, so pointers into the tables stay good.  If a resolver thread
+ * holds the lock, try again later rather than wait.
+ */
+static void
+dns_collect(netdissect_options *ndo)
+{
+	struct dnsreq *req, *next;
+	struct hnameent *e;
+	struct h6nameent *e6;
+	const char **namep;
+	char *dotp;
+
+	if (pthread_mutex_trylock(&dns_mtx) != 0)
+		return;
+	req = dns_done;
+	dns_done = NULL;
+	pthread_mutex_unlock(&dns_mtx);
+
+	for (; req != NULL; req = next) {
+		next = req->next;
+		namep = NULL;
+		if (req->af == AF_INET) {
+			e = hname_lookup(ndo, &hnametable, req->addr.v4, 0);
+			if (e != NULL && e->pending) {
+				e->pending = 0;
+				namep = &e->name;
+			}
+		} else {
+			e6 = h6name_lookup(ndo, &h6nametable, &req->addr.v6, 0);
+			if (e6 != NULL && e6->pending) {
+				e6->pending = 0;
+				namep = &e6->name;
+			}
+		}
+		if (namep != NULL && req->name != NULL) {
+			if (ndo->ndo_Nflag) {
+				/* Remove domain qualifications */
+				dotp = strchr(req->name, '.');
+				if (dotp)
+					*dotp = '\0';
+			}
+			*namep = req->name;
+		} else
+			free(req->name);
+		free(req);
+		dns_queued--;
+	}
+}
+#endif /* HAVE_LIBPTHREAD */
+
 /*
  * Return a name for the IP address pointed to by ap.  This address
  * is assumed to be in network byte order.
@@ -240,16 +613,17 @@ getname(netdissect_options *ndo, const u_char *ap)
 {
 	register struct hostent *hp;
 	uint32_t addr;
-	struct hnamemem *p;
+	struct hnameent *p;
 
 	memcpy(&addr, ap, sizeof(addr));
-	p = &hnametable[addr & (HASHNAMESIZE-1)];
-	for (; p->nxt; p = p->nxt) {
-		if (p->addr == addr)
-			return (p->name);
+	p = hname_lookup(ndo, &hnametable, addr, 1);
+	if (p->name != NULL) {
+#ifdef HAVE_LIBPTHREAD
+		if (p->pending)
+			dns_collect(ndo);
+#endif
+		return (p->name);
 	}
-	p->addr = addr;
-	p->nxt = newhnamemem(ndo);
 
 	/*
 	 * Print names unless:
@@ -260,6 +634,12 @@ getname(netdissect_options *ndo, const u_char *ap)
 	 */
 	if (!ndo->ndo_nflag &&
 	    (addr & f_netmask) == f_localnet) {
+#ifdef HAVE_LIBPTHREAD
+		if (ndo->ndo_resolver_threads > 0) {
+			p->pending = dns_request(ndo, AF_INET, &addr) == 0;
+			hp = NULL;
+		} else
+#endif
 #ifdef HAVE_CASPER
 		if (capdns != NULL) {
 			hp = cap_gethostbyaddr(capdns, (char *)&addr, 4,
@@ -297,30 +677,31 @@ const char *
 getname6(netdissect_options *ndo, const u_char *ap)
 {
 	register struct hostent *hp;
-	union {
-		struct in6_addr addr;
-		struct for_hash_addr {
-			char fill[14];
-			uint16_t d;
-		} addra;
-	} addr;
-	struct h6namemem *p;
+	struct in6_addr addr;
+	struct h6nameent *p;
 	register const char *cp;
 	char ntop_buf[INET6_ADDRSTRLEN];
 
 	memcpy(&addr, ap, sizeof(addr));
-	p = &h6nametable[addr.addra.d & (HASHNAMESIZE-1)];
-	for (; p->nxt; p = p->nxt) {
-		if (memcmp(&p->addr, &addr, sizeof(addr)) == 0)
-			return (p->name);
+	p = h6name_lookup(ndo, &h6nametable, &addr, 1);
+	if (p->name != NULL) {
+#ifdef HAVE_LIBPTHREAD
+		if (p->pending)
+			dns_collect(ndo);
+#endif
+		return (p->name);
 	}
-	p->addr = addr.addr;
-	p->nxt = newh6namemem(ndo);
 
 	/*
 	 * Do not print names if -n was given.
 	 */
 	if (!ndo->ndo_nflag) {
+#ifdef HAVE_LIBPTHREAD
+		if (ndo->ndo_resolver_threads > 0) {
+			p->pending = dns_request(ndo, AF_INET6, &addr) == 0;
+			hp = NULL;
+		} else
+#endif
 #ifdef HAVE_CASPER
 		if (capdns != NULL) {
 			hp = cap_gethostbyaddr(capdns, (char *)&addr,
@@ -624,16 +1005,13 @@ const char *
 etherproto_string(netdissect_options *ndo, u_short port)
 {
 	register char *cp;
-	register struct hnamemem *tp;
+	register struct hnameent *tp;
 	register uint32_t i = port;
 	char buf[sizeof("0000")];
 
-	for (tp = &eprototable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
-		if (tp->addr == i)
-			return (tp->name);
-
-	tp->addr = i;
-	tp->nxt = newhnamemem(ndo);
+	tp = hname_lookup(ndo, &eprototable, i, 1);
+	if (tp->name != NULL)
+		return (tp->name);
 
 	cp = buf;
 	NTOHS(port);
@@ -712,16 +1090,13 @@ isonsap_string(netdissect_options *ndo, const u_char *nsap,
 const char *
 tcpport_string(netdissect_options *ndo, u_short port)
 {
-	register struct hnamemem *tp;
+	register struct hnameent *tp;
 	register uint32_t i = port;
 	char buf[sizeof("00000")];
 
-	for (tp = &tporttable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
-		if (tp->addr == i)
-			return (tp->name);
-
-	tp->addr = i;
-	tp->nxt = newhnamemem(ndo);
+	tp = hname_lookup(ndo, &tporttable, i, 1);
+	if (tp->name != NULL)
+		return (tp->name);
 
 	(void)snprintf(buf, sizeof(buf), "%u", i);
 	tp->name = strdup(buf);
@@ -733,16 +1108,13 @@ tcpport_string(netdissect_options *ndo, u_short port)
 const char *
 udpport_string(netdissect_options *ndo, register u_short port)
 {
-	register struct hnamemem *tp;
+	register struct hnameent *tp;
 	register uint32_t i = port;
 	char buf[sizeof("00000")];
 
-	for (tp = &uporttable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
-		if (tp->addr == i)
-			return (tp->name);
-
-	tp->addr = i;
-	tp->nxt = newhnamemem(ndo);
+	tp = hname_lookup(ndo, &uporttable, i, 1);
+	if (tp->name != NULL)
+		return (tp->name);
 
 	(void)snprintf(buf, sizeof(buf), "%u", i);
 	tp->name = strdup(buf);
@@ -755,16 +1127,13 @@ const char *
 ipxsap_string(netdissect_options *ndo, u_short port)
 {
 	register char *cp;
-	register struct hnamemem *tp;
+	register struct hnameent *tp;
 	register uint32_t i = port;
 	char buf[sizeof("0000")];
 
-	for (tp = &ipxsaptable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
-		if (tp->addr == i)
-			return (tp->name);
-
-	tp->addr = i;
-	tp->nxt = newhnamemem(ndo);
+	tp = hname_lookup(ndo, &ipxsaptable, i, 1);
+	if (tp->name != NULL)
+		return (tp->name);
 
 	cp = buf;
 	NTOHS(port);
@@ -783,22 +1152,21 @@ static void
 init_servarray(netdissect_options *ndo)
 {
 	struct servent *sv;
-	register struct hnamemem *table;
-	register int i;
+	register struct hnameent *table;
 	char buf[sizeof("0000000000")];
 
 	while ((sv = getservent()) != NULL) {
 		int port = ntohs(sv->s_port);
-		i = port & (HASHNAMESIZE-1);
 		if (strcmp(sv->s_proto, "tcp") == 0)
-			table = &tporttable[i];
+			table = hname_lookup(ndo, &tporttable, port, 1);
 		else if (strcmp(sv->s_proto, "udp") == 0)
-			table = &uporttable[i];
+			table = hname_lookup(ndo, &uporttable, port, 1);
 		else
 			continue;
 
-		while (table->name)
-			table = table->nxt;
+		/* The first entry for a port wins. */
+		if (table->name != NULL)
+			continue;
 		if (ndo->ndo_nflag) {
 			(void)snprintf(buf, sizeof(buf), "%d", port);
 			table->name = strdup(buf);
@@ -806,9 +1174,6 @@ init_servarray(netdissect_options *ndo)
 			table->name = strdup(sv->s_name);
 		if (table->name == NULL)
 			(*ndo->ndo_error)(ndo, "init_servarray: strdup");
-
-		table->addr = port;
-		table->nxt = newhnamemem(ndo);
 	}
 	endservent();
 }
@@ -844,16 +1209,13 @@ static void
 init_eprotoarray(netdissect_options *ndo)
 {
 	register int i;
-	register struct hnamemem *table;
+	register struct hnameent *table;
 
 	for (i = 0; eproto_db[i].s; i++) {
-		int j = htons(eproto_db[i].p) & (HASHNAMESIZE-1);
-		table = &eprototable[j];
-		while (table->name)
-			table = table->nxt;
-		table->name = eproto_db[i].s;
-		table->addr = htons(eproto_db[i].p);
-		table->nxt = newhnamemem(ndo);
+		table = hname_lookup(ndo, &eprototable,
+		    htons(eproto_db[i].p), 1);
+		if (table->name == NULL)
+			table->name = eproto_db[i].s;
 	}
 }
 
@@ -1196,16 +1558,13 @@ static void
 init_ipxsaparray(netdissect_options *ndo)
 {
 	register int i;
-	register struct hnamemem *table;
+	register struct hnameent *table;
 
 	for (i = 0; ipxsap_db[i].s != NULL; i++) {
-		int j = htons(ipxsap_db[i].v) & (HASHNAMESIZE-1);
-		table = &ipxsaptable[j];
-		while (table->name)
-			table = table->nxt;
-		table->name = ipxsap_db[i].s;
-		table->addr = htons(ipxsap_db[i].v);
-		table->nxt = newhnamemem(ndo);
+		table = hname_lookup(ndo, &ipxsaptable,
+		    htons(ipxsap_db[i].v), 1);
+		if (table->name == NULL)
+			table->name = ipxsap_db[i].s;
 	}
 }
 
@@ -1238,15 +1597,11 @@ init_addrtoname(netdissect_options *ndo, uint32_t localnet, uint32_t mask)
 const char *
 dnaddr_string(netdissect_options *ndo, u_short dnaddr)
 {
-	register struct hnamemem *tp;
-
-	for (tp = &dnaddrtable[dnaddr & (HASHNAMESIZE-1)]; tp->nxt != NULL;
-	     tp = tp->nxt)
-		if (tp->addr == dnaddr)
-			return (tp->name);
+	register struct hnameent *tp;
 
-	tp->addr = dnaddr;
-	tp->nxt = newhnamemem(ndo);
+	tp = hname_lookup(ndo, &dnaddrtable, dnaddr, 1);
+	if (tp->name != NULL)
+		return (tp->name);
 	tp->name = dnnum_string(ndo, dnaddr);
 
 	return(tp->name);
@@ -1271,25 +1626,6 @@ newhnamemem(netdissect_options *ndo)
 	return (p);
 }
 
-/* Return a zero'ed h6namemem struct and cuts down on calloc() overhead */
-struct h6namemem *
-newh6namemem(netdissect_options *ndo)
-{
-	register struct h6namemem *p;
-	static struct h6namemem *ptr = NULL;
-	static u_int num = 0;
-
-	if (num  <= 0) {
-		num = 64;
-		ptr = (struct h6namemem *)calloc(num, sizeof (*ptr));
-		if (ptr == NULL)
-			(*ndo->ndo_error)(ndo, "newh6namemem: calloc");
-	}
-	--num;
-	p = ptr++;
-	return (p);
-}
-
 /* Represent TCI part of the 802.1Q 4-octet tag as text. */
 const char *
 ieee8021q_tci_string(const uint16_t tci)
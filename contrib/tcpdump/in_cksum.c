@@ -1,7 +1,7 @@
 /* in_cksum.c
  * 4.4-Lite-2 Internet checksum routine, modified to take a vector of
- * pointers/lengths giving the pieces to be checksummed.  Also using
- * Tahoe/CGI version of ADDCARRY(x) macro instead of from portable version.
+ * pointers/lengths giving the pieces to be checksummed, and to sum
+ * them in wide words.
  */
 
 /*
@@ -39,112 +39,234 @@
 # include "config.h"
 #endif
 
+#include <string.h>
+
+/*
+ * The SIMD headers come before netdissect.h, which defines __attribute__
+ * away if the compiler does not have it.
+ */
+#if defined(HAVE___ATTRIBUTE__) && defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define IN_CKSUM_X86
+#elif defined(HAVE___ATTRIBUTE__) && defined(__GNUC__) && \
+    defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define IN_CKSUM_NEON
+#endif
+
 #include <netdissect-stdinc.h>
 
 #include "netdissect.h"
 
 /*
- * Checksum routine for Internet Protocol family headers (Portable Version).
+ * Checksum routine for Internet Protocol family headers.
  *
- * This routine is very heavily used in the network
- * code and should be modified for each CPU to be as fast as possible.
+ * This routine is very heavily used, so the bulk of every chunk is
+ * summed in 32- or 64-bit words, with SIMD where the CPU has it.  That
+ * gives the same ones' complement sum as adding up 16-bit words, in
+ * either byte order, as 0x10000 is 1 modulo 0xffff.  A chunk that starts at
+ * an odd offset into the data has its sum byte-swapped before it is
+ * added in (RFC 1071, section 2(B)).
  */
 
-#define ADDCARRY(x)  {if ((x) > 65535) (x) -= 65535;}
-#define REDUCE {l_util.l = sum; sum = l_util.s[0] + l_util.s[1]; ADDCARRY(sum);}
+/* Chunks shorter than this are summed without SIMD. */
+#define IN_CKSUM_SIMD_MIN	64
+/*
+ * SIMD loop iterations before the 32-bit lanes are added up; every
+ * iteration adds at most 2 * 0xffff to a lane.
+ */
+#define IN_CKSUM_SIMD_ITERS	16384
 
-uint16_t
-in_cksum(const struct cksum_vec *vec, int veclen)
+static uint32_t
+in_cksum_fold(uint64_t sum)
 {
-	register const uint16_t *w;
-	register int sum = 0;
-	register int mlen = 0;
-	int byte_swapped = 0;
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return (uint32_t)sum;
+}
 
+/*
+ * Sum the 16-bit words of the buffer, in host byte order, as 64-bit
+ * words with end-around carry; 2^64 is 1 modulo 0xffff as well.  A last
+ * odd byte is added as the first byte of a word whose second byte is 0.
+ */
+static uint64_t
+in_cksum_sum_generic(const uint8_t *p, size_t len)
+{
+	uint64_t sum = 0, w64;
+	uint32_t w32;
+	uint16_t w16;
 	union {
 		uint8_t		c[2];
 		uint16_t	s;
 	} s_util;
-	union {
-		uint16_t	s[2];
-		uint32_t	l;
-	} l_util;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&w64, p, 8);
+		sum += w64;
+		sum += (sum < w64);
+	}
+	sum = (sum >> 32) + (sum & 0xffffffff);
+	if (len >= 4) {
+		memcpy(&w32, p, 4);
+		sum += w32;
+		p += 4;
+		len -= 4;
+	}
+	if (len >= 2) {
+		memcpy(&w16, p, 2);
+		sum += w16;
+		p += 2;
+		len -= 2;
+	}
+	if (len != 0) {
+		s_util.c[0] = *p;
+		s_util.c[1] = 0;
+		sum += s_util.s;
+	}
+	return sum;
+}
+
+#ifdef IN_CKSUM_X86
+static uint64_t
+in_cksum_sum_sse2(const uint8_t *p, size_t len)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc, v;
+	uint32_t lanes[4];
+	uint64_t sum = 0;
+	size_t n;
+
+	while (len >= 16) {
+		n = len / 16;
+		if (n > IN_CKSUM_SIMD_ITERS)
+			n = IN_CKSUM_SIMD_ITERS;
+		len -= n * 16;
+		acc = zero;
+		for (; n != 0; n--, p += 16) {
+			v = _mm_loadu_si128((const __m128i *)(const void *)p);
+			acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+			acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+		}
+		_mm_storeu_si128((__m128i *)(void *)lanes, acc);
+		sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+	return sum + in_cksum_sum_generic(p, len);
+}
+
+__attribute__((target("avx2")))
+static uint64_t
+in_cksum_sum_avx2(const uint8_t *p, size_t len)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i acc0, acc1, v0, v1;
+	uint32_t lanes[8];
+	uint64_t sum = 0;
+	size_t n;
+	int i;
+
+	/* Two accumulators, so that the additions can overlap. */
+	while (len >= 64) {
+		n = len / 64;
+		if (n > IN_CKSUM_SIMD_ITERS)
+			n = IN_CKSUM_SIMD_ITERS;
+		len -= n * 64;
+		acc0 = acc1 = zero;
+		for (; n != 0; n--, p += 64) {
+			v0 = _mm256_loadu_si256((const __m256i *)(const void *)p);
+			v1 = _mm256_loadu_si256(
+			    (const __m256i *)(const void *)(p + 32));
+			acc0 = _mm256_add_epi32(acc0,
+			    _mm256_unpacklo_epi16(v0, zero));
+			acc1 = _mm256_add_epi32(acc1,
+			    _mm256_unpackhi_epi16(v0, zero));
+			acc0 = _mm256_add_epi32(acc0,
+			    _mm256_unpacklo_epi16(v1, zero));
+			acc1 = _mm256_add_epi32(acc1,
+			    _mm256_unpackhi_epi16(v1, zero));
+		}
+		_mm256_storeu_si256((__m256i *)(void *)lanes, acc0);
+		for (i = 0; i < 8; i++)
+			sum += lanes[i];
+		_mm256_storeu_si256((__m256i *)(void *)lanes, acc1);
+		for (i = 0; i < 8; i++)
+			sum += lanes[i];
+	}
+	return sum + in_cksum_sum_generic(p, len);
+}
+#endif /* IN_CKSUM_X86 */
+
+#ifdef IN_CKSUM_NEON
+static uint64_t
+in_cksum_sum_neon(const uint8_t *p, size_t len)
+{
+	uint32x4_t acc;
+	uint64_t sum = 0;
+	size_t n;
+
+	while (len >= 16) {
+		n = len / 16;
+		if (n > IN_CKSUM_SIMD_ITERS)
+			n = IN_CKSUM_SIMD_ITERS;
+		len -= n * 16;
+		acc = vdupq_n_u32(0);
+		for (; n != 0; n--, p += 16)
+			acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(p)));
+		sum += vaddlvq_u32(acc);
+	}
+	return sum + in_cksum_sum_generic(p, len);
+}
+#endif /* IN_CKSUM_NEON */
+
+static uint64_t in_cksum_sum_init(const uint8_t *, size_t);
+
+static uint64_t (*in_cksum_sum)(const uint8_t *, size_t) = in_cksum_sum_init;
+
+/*
+ * Pick the routine for the CPU we run on, the first time it is needed.
+ */
+static uint64_t
+in_cksum_sum_init(const uint8_t *p, size_t len)
+{
+#if defined(IN_CKSUM_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		in_cksum_sum = in_cksum_sum_avx2;
+	else
+		in_cksum_sum = in_cksum_sum_sse2;
+#elif defined(IN_CKSUM_NEON)
+	in_cksum_sum = in_cksum_sum_neon;
+#else
+	in_cksum_sum = in_cksum_sum_generic;
+#endif
+	return in_cksum_sum(p, len);
+}
+
+uint16_t
+in_cksum(const struct cksum_vec *vec, int veclen)
+{
+	uint64_t sum = 0;
+	uint32_t part;
+	int odd = 0;		/* odd number of bytes so far */
 
 	for (; veclen != 0; vec++, veclen--) {
-		if (vec->len == 0)
+		if (vec->len <= 0)
 			continue;
-		w = (const uint16_t *)(const void *)vec->ptr;
-		if (mlen == -1) {
-			/*
-			 * The first byte of this chunk is the continuation
-			 * of a word spanning between this chunk and the
-			 * last chunk.
-			 *
-			 * s_util.c[0] is already saved when scanning previous
-			 * chunk.
-			 */
-			s_util.c[1] = *(const uint8_t *)w;
-			sum += s_util.s;
-			w = (const uint16_t *)(const void *)((const uint8_t *)w + 1);
-			mlen = vec->len - 1;
-		} else
-			mlen = vec->len;
-		/*
-		 * Force to even boundary.
-		 */
-		if ((1 & (uintptr_t) w) && (mlen > 0)) {
-			REDUCE;
-			sum <<= 8;
-			s_util.c[0] = *(const uint8_t *)w;
-			w = (const uint16_t *)(const void *)((const uint8_t *)w + 1);
-			mlen--;
-			byte_swapped = 1;
-		}
+		if (vec->len < IN_CKSUM_SIMD_MIN)
+			part = in_cksum_fold(in_cksum_sum_generic(vec->ptr,
+			    vec->len));
+		else
+			part = in_cksum_fold(in_cksum_sum(vec->ptr, vec->len));
 		/*
-		 * Unroll the loop to make overhead from
-		 * branches &c small.
+		 * The first byte of this chunk is the second byte of a
+		 * word, so all of its words are byte-swapped.
 		 */
-		while ((mlen -= 32) >= 0) {
-			sum += w[0]; sum += w[1]; sum += w[2]; sum += w[3];
-			sum += w[4]; sum += w[5]; sum += w[6]; sum += w[7];
-			sum += w[8]; sum += w[9]; sum += w[10]; sum += w[11];
-			sum += w[12]; sum += w[13]; sum += w[14]; sum += w[15];
-			w += 16;
-		}
-		mlen += 32;
-		while ((mlen -= 8) >= 0) {
-			sum += w[0]; sum += w[1]; sum += w[2]; sum += w[3];
-			w += 4;
-		}
-		mlen += 8;
-		if (mlen == 0 && byte_swapped == 0)
-			continue;
-		REDUCE;
-		while ((mlen -= 2) >= 0) {
-			sum += *w++;
-		}
-		if (byte_swapped) {
-			REDUCE;
-			sum <<= 8;
-			byte_swapped = 0;
-			if (mlen == -1) {
-				s_util.c[1] = *(const uint8_t *)w;
-				sum += s_util.s;
-				mlen = 0;
-			} else
-				mlen = -1;
-		} else if (mlen == -1)
-			s_util.c[0] = *(const uint8_t *)w;
-	}
-	if (mlen == -1) {
-		/* The last mbuf has odd # of bytes. Follow the
-		   standard (the odd byte may be shifted left by 8 bits
-		   or not as determined by endian-ness of the machine) */
-		s_util.c[1] = 0;
-		sum += s_util.s;
+		if (odd)
+			part = ((part & 0xff) << 8) | (part >> 8);
+		sum += part;
+		odd ^= vec->len & 1;
 	}
-	REDUCE;
-	return (~sum & 0xffff);
+	return (~in_cksum_fold(sum) & 0xffff);
 }
 
 /*
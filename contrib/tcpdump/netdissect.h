@@ -160,6 +160,7 @@ struct netdissect_options {
   int ndo_packet_number;	/* print a packet number in the beginning of line */
   int ndo_suppress_default_print; /* don't use default_print() for unknown packet types */
   int ndo_tstamp_precision;	/* requested time stamp precision */
+  int ndo_resolver_threads;	/* look names up asynchronously */
   const char *program_name;	/* Name of the program using the library */
 
   char *ndo_espsecret;
@@ -169,6 +169,10 @@ static int Wflag;			/* recycle output files after this number of files */
 static int WflagChars;
 static char *zflag = NULL;		/* compress each savefile using a specified command (like gzip or bzip2) */
 static int immediate_mode;
+#ifdef HAVE_FORK
+#define PAR_MAXJOBS	64
+static int jobs;			/* processes printing a savefile */
+#endif
 
 static int infodelay;
 static int infoprint;
@@ -194,6 +198,13 @@ static void show_devices_and_exit (void) NORETURN;
 #endif
 
 static void print_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
+#ifdef HAVE_FORK
+static void par_start(netdissect_options *, const char *, struct bpf_program *,
+    pcap_handler *, u_char **);
+static void par_print_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
+static void par_finish(int) NORETURN;
+static int par_merge(void);
+#endif
 static void dump_packet_and_trunc(u_char *, const struct pcap_pkthdr *, const u_char *);
 static void dump_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
 static void droproot(const char *, const char *);
@@ -548,6 +559,8 @@ show_devices_and_exit (void)
 #define OPTION_VERSION		128
 #define OPTION_TSTAMP_PRECISION	129
 #define OPTION_IMMEDIATE_MODE	130
+#define OPTION_JOBS		131
+#define OPTION_RESOLVER_THREADS	132
 
 static const struct option longopts[] = {
 #if defined(HAVE_PCAP_CREATE) || defined(_WIN32)
@@ -584,6 +597,12 @@ static const struct option longopts[] = {
 #endif
 #ifdef HAVE_PCAP_SET_PARSER_DEBUG
 	{ "debug-filter-parser", no_argument, NULL, 'Y' },
+#endif
+#ifdef HAVE_FORK
+	{ "jobs", required_argument, NULL, OPTION_JOBS },
+#endif
+#ifdef HAVE_LIBPTHREAD
+	{ "resolver-threads", required_argument, NULL, OPTION_RESOLVER_THREADS },
 #endif
 	{ "relinquish-privileges", required_argument, NULL, 'Z' },
 	{ "number", no_argument, NULL, '#' },
@@ -1167,6 +1186,9 @@ main(int argc, char **argv)
 	cap_rights_t rights;
 	int cansandbox;
 #endif	/* HAVE_CAPSICUM */
+#ifdef HAVE_FORK
+	struct stat st;
+#endif
 	int Oflag = 1;			/* run filter code optimizer */
 	int yflag_dlt = -1;
 	const char *yflag_dlt_name = NULL;
@@ -1549,6 +1571,24 @@ main(int argc, char **argv)
 			break;
 #endif
 
+#ifdef HAVE_FORK
+		case OPTION_JOBS:
+			jobs = atoi(optarg);
+			if (jobs <= 0 || jobs > PAR_MAXJOBS)
+				error("invalid number of jobs %s", optarg);
+			break;
+#endif
+
+#ifdef HAVE_LIBPTHREAD
+		case OPTION_RESOLVER_THREADS:
+			ndo->ndo_resolver_threads = atoi(optarg);
+			if (ndo->ndo_resolver_threads <= 0 ||
+			    ndo->ndo_resolver_threads > 64)
+				error("invalid number of resolver threads %s",
+				    optarg);
+			break;
+#endif
+
 		default:
 			print_usage();
 			exit_tcpdump(1);
@@ -1578,6 +1618,22 @@ main(int argc, char **argv)
 		break;
 	}
 
+#ifdef HAVE_FORK
+	if (jobs > 1) {
+		/*
+		 * Every job prints only some of the packets, so nothing
+		 * that depends on the packets before the one being
+		 * printed can be used.
+		 */
+		if (RFileName == NULL || WFileName != NULL ||
+		    stat(RFileName, &st) < 0 || !S_ISREG(st.st_mode))
+			error("--jobs can only be used to print a savefile read with -r");
+		if (ndo->ndo_tflag == 3 || ndo->ndo_tflag == 5)
+			error("--jobs can't be used with -ttt or -ttttt");
+		ndo->ndo_Sflag = 1;
+	}
+#endif
+
 	if (ndo->ndo_fflag != 0 && (VFileName != NULL || RFileName != NULL))
 		error("-f can not be used with -V or -r");
 
@@ -2039,6 +2095,11 @@ main(int argc, char **argv)
 		(void)fflush(stderr);
 	}
 
+#ifdef HAVE_FORK
+	if (jobs > 1)
+		par_start(ndo, RFileName, &fcode, &callback, &pcap_userdata);
+#endif
+
 #ifdef HAVE_CAPSICUM
 	cansandbox = (VFileName == NULL && zflag == NULL &&
 	    ndo->ndo_espsecret == NULL);
@@ -2055,7 +2116,16 @@ main(int argc, char **argv)
 #endif	/* HAVE_CAPSICUM */
 
 	do {
+#ifdef HAVE_FORK
+		if (callback == NULL)
+			status = par_merge();
+		else
+#endif
 		status = pcap_loop(pd, cnt, callback, pcap_userdata);
+#ifdef HAVE_FORK
+		if (callback == par_print_packet)
+			par_finish(status);
+#endif
 		if (WFileName == NULL) {
 			/*
 			 * We're printing packets.  Flush the printed output,
@@ -2559,6 +2629,285 @@ print_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 		info(0);
 }
 
+#ifdef HAVE_FORK
+/*
+ * Printing a savefile with several processes (--jobs).
+ *
+ * Every worker reads the whole savefile and runs the filter, so that
+ * they all agree on the number of each packet that passes it, but it
+ * only dissects the packets of its own blocks of PAR_BLOCK packets:
+ * worker i gets blocks i, i + jobs, i + 2 * jobs, and so on.  The
+ * output for a block is collected in memory and sent to the parent
+ * through a pipe, after a struct par_frame; the parent copies the
+ * blocks to the standard output in order.
+ */
+#define PAR_BLOCK	1024
+
+struct par_frame {
+	uint32_t	len;		/* bytes of output that follow */
+	uint32_t	count;		/* packets in the block */
+};
+
+static int par_index;			/* this worker's number */
+static int par_fd = -1;			/* this worker's pipe */
+static u_int par_count;			/* packets in the current block */
+static char *par_buf;			/* output for the current block */
+static size_t par_len, par_size;
+static int par_fds[PAR_MAXJOBS];	/* the parent's end of the pipes */
+static pid_t par_pids[PAR_MAXJOBS];
+
+static int
+par_printf(netdissect_options *ndo _U_, const char *fmt, ...)
+{
+	va_list args;
+	size_t size;
+	char *buf;
+	int ret;
+
+	for (;;) {
+		va_start(args, fmt);
+		ret = vsnprintf(par_buf + par_len, par_size - par_len, fmt, args);
+		va_end(args);
+		if (ret < 0)
+			error("unable to format output");
+		if ((size_t)ret < par_size - par_len)
+			break;
+		size = par_size * 2;
+		if (size < par_len + ret + 1)
+			size = par_len + ret + 1;
+		buf = realloc(par_buf, size);
+		if (buf == NULL)
+			error("par_printf: realloc");
+		par_buf = buf;
+		par_size = size;
+	}
+	par_len += ret;
+	return (ret);
+}
+
+static int
+par_write(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		p += n;
+		len -= n;
+	}
+	return (0);
+}
+
+static ssize_t
+par_read(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t n;
+	size_t done;
+
+	for (done = 0; done < len; done += n) {
+		n = read(fd, p + done, len - done);
+		if (n < 0 && errno == EINTR) {
+			n = 0;
+			continue;
+		}
+		if (n <= 0)
+			break;
+	}
+	return (done);
+}
+
+/*
+ * Send the output for the current block to the parent.  If the parent
+ * is gone, or has stopped reading, there's nobody left to complain to.
+ */
+static void
+par_flush(void)
+{
+	struct par_frame frame;
+
+	frame.len = (uint32_t)par_len;
+	frame.count = par_count;
+	if (par_write(par_fd, &frame, sizeof(frame)) < 0 ||
+	    par_write(par_fd, par_buf, par_len) < 0)
+		exit(0);
+	par_len = 0;
+	par_count = 0;
+}
+
+static void
+par_print_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	++packets_captured;
+
+	if ((packets_captured - 1) / PAR_BLOCK % jobs != (u_int)par_index)
+		return;
+	pretty_print_packet((netdissect_options *)user, h, sp, packets_captured);
+	if (++par_count == PAR_BLOCK)
+		par_flush();
+}
+
+/*
+ * Start the workers.  A worker gets its own handle for the savefile,
+ * and returns with the callback set to par_print_packet(); the parent
+ * returns with the callback set to NULL, and collects the output with
+ * par_merge().
+ */
+static void
+par_start(netdissect_options *ndo, const char *fname,
+    struct bpf_program *fcode, pcap_handler *callback, u_char **userdata)
+{
+	char ebuf[PCAP_ERRBUF_SIZE];
+#ifdef HAVE_CAPSICUM
+	cap_rights_t rights;
+#endif
+	int i, j, fds[2];
+	pid_t pid;
+
+	/* child_cleanup() would reap the workers before par_merge() does. */
+	(void)setsignal(SIGCHLD, SIG_DFL);
+	(void)fflush(stdout);
+	(void)fflush(stderr);
+	for (i = 0; i < jobs; i++) {
+		if (pipe(fds) < 0)
+			error("pipe: %s", pcap_strerror(errno));
+		pid = fork();
+		if (pid == -1)
+			error("fork: %s", pcap_strerror(errno));
+		if (pid == 0)
+			break;
+		close(fds[1]);
+		par_fds[i] = fds[0];
+		par_pids[i] = pid;
+	}
+	if (i == jobs) {
+		*callback = NULL;
+		return;
+	}
+
+	/*
+	 * Worker process.  The savefile is opened again, so that it can
+	 * be read from the beginning without getting in the way of the
+	 * other workers.
+	 */
+	close(fds[0]);
+	for (j = 0; j < i; j++)
+		close(par_fds[j]);
+	par_index = i;
+	par_fd = fds[1];
+	par_size = 256 * 1024;
+	par_buf = malloc(par_size);
+	if (par_buf == NULL)
+		error("par_start: malloc");
+
+	pcap_close(pd);
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	pd = pcap_open_offline_with_tstamp_precision(fname,
+	    ndo->ndo_tstamp_precision, ebuf);
+#else
+	pd = pcap_open_offline(fname, ebuf);
+#endif
+	if (pd == NULL)
+		error("%s", ebuf);
+#ifdef HAVE_CAPSICUM
+	cap_rights_init(&rights, CAP_READ);
+	if (cap_rights_limit(fileno(pcap_file(pd)), &rights) < 0 &&
+	    errno != ENOSYS) {
+		error("unable to limit pcap descriptor");
+	}
+#endif
+	if (pcap_setfilter(pd, fcode) < 0)
+		error("%s", pcap_geterr(pd));
+#ifdef HAVE_CASPER
+	/* The workers can't share a channel to the DNS service. */
+	if (capdns != NULL) {
+		cap_close(capdns);
+		capdns = capdns_setup();
+	}
+#endif
+	ndo->ndo_printf = par_printf;
+	*callback = par_print_packet;
+	*userdata = (u_char *)ndo;
+}
+
+/*
+ * Called by a worker when pcap_loop() returns; sends the last, partial,
+ * block, and exits.
+ */
+static void
+par_finish(int status)
+{
+	/* All the workers read the same file, and fail the same way. */
+	if (status == -1 && par_index == 0)
+		(void)fprintf(stderr, "%s: pcap_loop: %s\n",
+		    program_name, pcap_geterr(pd));
+	if (par_count != 0)
+		par_flush();
+	close(par_fd);
+	exit(status == -1 ? 1 : 0);
+}
+
+/*
+ * Copy the output of the workers to the standard output, one block at
+ * a time, until the worker that should have the next block has no more.
+ */
+static int
+par_merge(void)
+{
+	struct par_frame frame;
+	char buf[65536];
+	size_t len, n;
+	u_int block;
+	int i, status, failed;
+
+	for (block = 0; ; block++) {
+		i = block % jobs;
+		if (par_read(par_fds[i], &frame, sizeof(frame)) !=
+		    (ssize_t)sizeof(frame))
+			break;
+		for (len = frame.len; len > 0; len -= n) {
+			n = len < sizeof(buf) ? len : sizeof(buf);
+			if (par_read(par_fds[i], buf, n) != (ssize_t)n)
+				break;
+			if (fwrite(buf, 1, n, stdout) != n)
+				break;
+		}
+		if (len > 0)
+			break;
+		packets_captured += frame.count;
+	}
+
+	/* Workers that still have something to say get EPIPE. */
+	for (i = 0; i < jobs; i++)
+		close(par_fds[i]);
+	failed = 0;
+	for (i = 0; i < jobs; i++) {
+		while (waitpid(par_pids[i], &status, 0) < 0) {
+			if (errno != EINTR) {
+				status = 0;
+				break;
+			}
+		}
+		if (WIFSIGNALED(status))
+			warning("job %d killed by signal %d", i,
+			    WTERMSIG(status));
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed = 1;
+	}
+	if (failed) {
+		(void)fflush(stdout);
+		exit_tcpdump(1);
+	}
+	return (0);
+}
+#endif /* HAVE_FORK */
+
 #ifdef _WIN32
 	/*
 	 * XXX - there should really be libpcap calls to get the version
@@ -2687,6 +3036,12 @@ print_usage(void)
 #endif
 #ifdef HAVE_PCAP_SET_IMMEDIATE_MODE
 	(void)fprintf(stderr, "[ --immediate-mode ] ");
+#endif
+#ifdef HAVE_FORK
+	(void)fprintf(stderr, "[ --jobs n ] ");
+#endif
+#ifdef HAVE_LIBPTHREAD
+	(void)fprintf(stderr, "[ --resolver-threads n ]\n\t\t");
 #endif
 	(void)fprintf(stderr, "[ -T type ] [ --version ] [ -V file ]\n");
 	(void)fprintf(stderr,
@@ -211,6 +211,7 @@ dt_apply_cfg(struct dt_env *env, struct config_file *cfg)
 
 	dt_apply_identity(env, cfg);
 	dt_apply_version(env, cfg);
+	env->drop_oldest = (unsigned int)cfg->dnstap_drop_oldest;
 	if ((env->log_resolver_query_messages = (unsigned int)
 	     cfg->dnstap_log_resolver_query_messages))
 	{
@@ -251,6 +252,7 @@ dt_init(struct dt_env *env, struct comm_base* base)
 		log_err("malloc failure");
 		return 0;
 	}
+	env->msgqueue->drop_oldest = (int)env->drop_oldest;
 	if(!dt_io_thread_register_queue(env->dtio, env->msgqueue)) {
 		log_err("malloc failure");
 		dt_msg_queue_delete(env->msgqueue);
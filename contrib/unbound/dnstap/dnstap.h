@@ -75,6 +75,8 @@ struct dt_env {
 	unsigned log_forwarder_query_messages : 1;
 	/** whether to log Message/FORWARDER_RESPONSE */
 	unsigned log_forwarder_response_messages : 1;
+	/** whether to drop the oldest messages if the queue is full */
+	unsigned drop_oldest : 1;
 };
 
 /**
@@ -70,6 +70,44 @@
 #define DTIO_RECONNECT_TIMEOUT_SLOW 1000
 /** number of messages before wakeup of thread */
 #define DTIO_MSG_FOR_WAKEUP 32
+/** number of entries in the message ring of a worker, a power of two */
+#define DTIO_QUEUE_SLOTS 16384
+
+#ifdef USE_DT_ATOMIC
+/* the ring is lock-free, head and tail are published with atomics */
+#define dt_load(v) atomic_load_explicit(&(v), memory_order_acquire)
+#define dt_load_relaxed(v) atomic_load_explicit(&(v), memory_order_relaxed)
+#define dt_store(v, x) atomic_store_explicit(&(v), (x), memory_order_release)
+#define dt_store_relaxed(v, x) \
+	atomic_store_explicit(&(v), (x), memory_order_relaxed)
+#define dt_cas(v, e, x) atomic_compare_exchange_strong_explicit(&(v), &(e), \
+	(x), memory_order_acq_rel, memory_order_acquire)
+#define dt_add(v, x) atomic_fetch_add_explicit(&(v), (x), memory_order_relaxed)
+#define dt_sub(v, x) atomic_fetch_sub_explicit(&(v), (x), memory_order_relaxed)
+#define dt_exchange(v, x) atomic_exchange_explicit(&(v), (x), \
+	memory_order_acq_rel)
+#define dt_ring_lock(mq) /* nothing */
+#define dt_ring_unlock(mq) /* nothing */
+#else
+/* the ring is protected by the queue lock */
+#define dt_load(v) (v)
+#define dt_load_relaxed(v) (v)
+#define dt_store(v, x) ((v) = (x))
+#define dt_store_relaxed(v, x) ((v) = (x))
+#define dt_cas(v, e, x) ((v) == (e) ? ((v) = (x), 1) : ((e) = (v), 0))
+#define dt_add(v, x) ((v) += (x))
+#define dt_sub(v, x) ((v) -= (x))
+#define dt_exchange(v, x) dt_exchange_int(&(v), (x))
+#define dt_ring_lock(mq) lock_basic_lock(&(mq)->lock)
+#define dt_ring_unlock(mq) lock_basic_unlock(&(mq)->lock)
+/** set a value, return the old value */
+static int dt_exchange_int(int* v, int x)
+{
+	int old = *v;
+	*v = x;
+	return old;
+}
+#endif
 
 /** maximum length of received frame */
 #define DTIO_RECV_FRAME_MAX_LEN 1000
@@ -108,40 +146,48 @@ dt_msg_queue_create(struct comm_base* base)
 	mq->maxsize = 1*1024*1024; /* set max size of buffer, per worker,
 		about 1 M should contain 64K messages with some overhead,
 		or a whole bunch smaller ones */
+	mq->ring = calloc(DTIO_QUEUE_SLOTS, sizeof(*mq->ring));
+	if(!mq->ring) {
+		free(mq);
+		return NULL;
+	}
 	mq->wakeup_timer = comm_timer_create(base, mq_wakeup_cb, mq);
 	if(!mq->wakeup_timer) {
+		free(mq->ring);
 		free(mq);
 		return NULL;
 	}
 	lock_basic_init(&mq->lock);
+#ifdef USE_DT_ATOMIC
+	lock_protect(&mq->lock, &mq->dtio, sizeof(mq->dtio));
+#else
 	lock_protect(&mq->lock, mq, sizeof(*mq));
+#endif
 	return mq;
 }
 
-/** clear the message list, caller must hold the lock */
+/** clear the message ring, the writer thread must not use the queue */
 static void
 dt_msg_queue_clear(struct dt_msg_queue* mq)
 {
-	struct dt_msg_entry* e = mq->first, *next=NULL;
-	while(e) {
-		next = e->next;
-		free(e->buf);
-		free(e);
-		e = next;
-	}
-	mq->first = NULL;
-	mq->last = NULL;
-	mq->cursize = 0;
-	mq->msgcount = 0;
+	size_t h = dt_load(mq->head), t = dt_load(mq->tail);
+	for(; h != t; h++)
+		free(dt_load_relaxed(mq->ring[h & (DTIO_QUEUE_SLOTS-1)].buf));
+	dt_store(mq->head, t);
+	dt_store(mq->cursize, 0);
 }
 
 void
 dt_msg_queue_delete(struct dt_msg_queue* mq)
 {
 	if(!mq) return;
+	if(mq->dropped)
+		verbose(VERB_OPS, "dnstap: %u messages dropped because the "
+			"queue was full", (unsigned)mq->dropped);
 	lock_basic_destroy(&mq->lock);
 	dt_msg_queue_clear(mq);
 	comm_timer_delete(mq->wakeup_timer);
+	free(mq->ring);
 	free(mq);
 }
 
@@ -183,9 +229,23 @@ mq_wakeup_cb(void* arg)
 	lock_basic_lock(&mq->dtio->wakeup_timer_lock);
 	mq->dtio->wakeup_timer_enabled = 0;
 	lock_basic_unlock(&mq->dtio->wakeup_timer_lock);
+	/* the timer wakes up regardless of a pending wakeup, so that a
+	 * lost wakeup does not stall the queue */
 	dtio_wakeup(mq->dtio);
 }
 
+/** wake up the dtio, unless a wakeup is already on its way */
+static void
+dtio_wakeup_batched(struct dt_io_thread* dtio)
+{
+	if(!dtio) return;
+	if(dt_load_relaxed(dtio->wakeup_pending))
+		return;
+	if(dt_exchange(dtio->wakeup_pending, 1))
+		return;
+	dtio_wakeup(dtio);
+}
+
 /** start timer to wakeup dtio because there is content in the queue */
 static void
 dt_msg_queue_start_timer(struct dt_msg_queue* mq)
@@ -219,11 +279,36 @@ dt_msg_queue_start_timer(struct dt_msg_queue* mq)
 	comm_timer_set(mq->wakeup_timer, &tv);
 }
 
+/** drop the oldest message in the ring, called by the worker, returns
+ * false if the ring is empty */
+static int
+dt_msg_queue_drop_oldest(struct dt_msg_queue* mq)
+{
+	struct dt_msg_entry* e;
+	size_t h = dt_load(mq->head);
+	void* buf;
+	size_t len;
+	while(h != dt_load_relaxed(mq->tail)) {
+		e = &mq->ring[h & (DTIO_QUEUE_SLOTS-1)];
+		buf = dt_load_relaxed(e->buf);
+		len = dt_load_relaxed(e->len);
+		/* the writer thread may take the message at the same time,
+		 * whoever moves the head owns it */
+		if(dt_cas(mq->head, h, h+1)) {
+			dt_sub(mq->cursize, len);
+			free(buf);
+			return 1;
+		}
+	}
+	return 0;
+}
+
 void
 dt_msg_queue_submit(struct dt_msg_queue* mq, void* buf, size_t len)
 {
 	int wakeupnow = 0, wakeupstarttimer = 0;
-	struct dt_msg_entry* entry;
+	size_t h, t, cursize;
+	struct dt_msg_entry* e;
 
 	/* check conditions */
 	if(!buf) return;
@@ -240,51 +325,42 @@ dt_msg_queue_submit(struct dt_msg_queue* mq, void* buf, size_t len)
 		return;
 	}
 
-	/* allocate memory for queue entry */
-	entry = malloc(sizeof(*entry));
-	if(!entry) {
-		log_err("out of memory logging dnstap");
-		free(buf);
-		return;
-	}
-	entry->next = NULL;
-	entry->buf = buf;
-	entry->len = len;
-
-	/* aqcuire lock */
-	lock_basic_lock(&mq->lock);
-	/* if list was empty, start timer for (eventual) wakeup */
-	if(mq->first == NULL)
-		wakeupstarttimer = 1;
-	/* if list contains more than wakeupnum elements, wakeup now,
-	 * or if list is (going to be) almost full */
-	if(mq->msgcount == DTIO_MSG_FOR_WAKEUP ||
-		(mq->cursize < mq->maxsize * 9 / 10 &&
-		mq->cursize+len >= mq->maxsize * 9 / 10))
-		wakeupnow = 1;
+	dt_ring_lock(mq);
+	t = dt_load_relaxed(mq->tail);
+	h = dt_load(mq->head);
+	cursize = dt_load_relaxed(mq->cursize);
 	/* see if it is going to fit */
-	if(mq->cursize + len > mq->maxsize) {
+	while(t - h >= DTIO_QUEUE_SLOTS || cursize + len > mq->maxsize) {
 		/* buffer full, or congested. */
-		/* drop */
-		lock_basic_unlock(&mq->lock);
-		free(buf);
-		free(entry);
-		return;
-	}
-	mq->cursize += len;
-	mq->msgcount ++;
-	/* append to list */
-	if(mq->last) {
-		mq->last->next = entry;
-	} else {
-		mq->first = entry;
+		mq->dropped++;
+		if(!mq->drop_oldest || len > mq->maxsize ||
+			!dt_msg_queue_drop_oldest(mq)) {
+			/* drop */
+			dt_ring_unlock(mq);
+			free(buf);
+			return;
+		}
+		h = dt_load(mq->head);
+		cursize = dt_load_relaxed(mq->cursize);
 	}
-	mq->last = entry;
-	/* release lock */
-	lock_basic_unlock(&mq->lock);
+	/* if ring was empty, start timer for (eventual) wakeup */
+	if(t == h)
+		wakeupstarttimer = 1;
+	/* if ring contains more than wakeupnum elements, wakeup now,
+	 * or if ring is (going to be) almost full */
+	if(t - h >= DTIO_MSG_FOR_WAKEUP ||
+		cursize+len >= mq->maxsize * 9 / 10)
+		wakeupnow = 1;
+	/* append to ring */
+	e = &mq->ring[t & (DTIO_QUEUE_SLOTS-1)];
+	dt_store_relaxed(e->buf, buf);
+	dt_store_relaxed(e->len, len);
+	dt_add(mq->cursize, len);
+	dt_store(mq->tail, t+1);
+	dt_ring_unlock(mq);
 
 	if(wakeupnow) {
-		dtio_wakeup(mq->dtio);
+		dtio_wakeup_batched(mq->dtio);
 	} else if(wakeupstarttimer) {
 		dt_msg_queue_start_timer(mq);
 	}
@@ -479,26 +555,27 @@ void dt_io_thread_unregister_queue(struct dt_io_thread* dtio,
 	}
 }
 
-/** pick a message from the queue, the routine locks and unlocks,
- * returns true if there is a message */
+/** pick a message from the queue, returns true if there is a message */
 static int dt_msg_queue_pop(struct dt_msg_queue* mq, void** buf,
 	size_t* len)
 {
-	lock_basic_lock(&mq->lock);
-	if(mq->first) {
-		struct dt_msg_entry* entry = mq->first;
-		mq->first = entry->next;
-		if(!entry->next) mq->last = NULL;
-		mq->cursize -= entry->len;
-		mq->msgcount --;
-		lock_basic_unlock(&mq->lock);
-
-		*buf = entry->buf;
-		*len = entry->len;
-		free(entry);
-		return 1;
+	struct dt_msg_entry* e;
+	size_t h;
+	dt_ring_lock(mq);
+	h = dt_load(mq->head);
+	while(h != dt_load(mq->tail)) {
+		e = &mq->ring[h & (DTIO_QUEUE_SLOTS-1)];
+		*buf = dt_load_relaxed(e->buf);
+		*len = dt_load_relaxed(e->len);
+		/* the worker may drop the oldest message at the same time,
+		 * whoever moves the head owns it */
+		if(dt_cas(mq->head, h, h+1)) {
+			dt_sub(mq->cursize, *len);
+			dt_ring_unlock(mq);
+			return 1;
+		}
 	}
-	lock_basic_unlock(&mq->lock);
+	dt_ring_unlock(mq);
 	return 0;
 }
 
@@ -1560,6 +1637,9 @@ void dtio_cmd_cb(int fd, short ATTR_UNUSED(bits), void* arg)
 		verbose(VERB_ALGO, "dnstap io: cmd channel cmd quit");
 	} else if(r == 1 && cmd == DTIO_COMMAND_WAKEUP) {
 		verbose(VERB_ALGO, "dnstap io: cmd channel cmd wakeup");
+		/* workers can send a wakeup again, the queues are
+		 * looked at after this */
+		dt_store(dtio->wakeup_pending, 0);
 
 		if(dtio->is_bidirectional && !dtio->accept_frame_received) {
 			verbose(VERB_ALGO, "dnstap io: cmd wakeup ignored, "
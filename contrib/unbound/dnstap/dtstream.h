@@ -45,6 +45,16 @@
 #define DTSTREAM_H
 
 #include "util/locks.h"
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+	!defined(__STDC_NO_ATOMICS__) && !defined(THREADS_DISABLED)
+#include <stdatomic.h>
+/** the message queue is a lock-free ring */
+#define USE_DT_ATOMIC 1
+/** a field that is accessed by more than one thread */
+#define dt_atomic(t) _Atomic(t)
+#else
+#define dt_atomic(t) t
+#endif
 struct dt_msg_entry;
 struct dt_io_list_item;
 struct dt_io_thread;
@@ -53,27 +63,40 @@ struct comm_base;
 
 /**
  * A message buffer with dnstap messages queued up.  It is per-worker.
- * It has locks to synchronize.  If the buffer is full, a new message
- * cannot be added and is discarded.  A thread reads the messages and sends
+ * It is a ring with one producer, the worker, and one consumer, the
+ * writer thread.  With C11 atomics it is lock-free, otherwise the lock
+ * is held to add or remove entries.  If the buffer is full, the new
+ * message is discarded, or with drop_oldest the oldest messages are
+ * discarded to make room for it.  A thread reads the messages and sends
  * them.
  */
 struct dt_msg_queue {
-	/** lock of the buffer structure.  Hold this lock to add or remove
-	 * entries to the buffer.  Release it so that other threads can also
-	 * put messages to log, or a message can be taken out to send away
-	 * by the writer thread.
+	/** lock of the buffer structure.  It protects the dtio reference.
+	 * Without atomics, hold this lock to add or remove entries to the
+	 * buffer.  Release it so that other threads can also put messages
+	 * to log, or a message can be taken out to send away by the writer
+	 * thread.
 	 */
 	lock_basic_type lock;
 	/** the maximum size of the buffer, in bytes */
 	size_t maxsize;
 	/** current size of the buffer, in bytes.  data bytes of messages.
 	 * If a new message make it more than maxsize, the buffer is full */
-	size_t cursize;
-	/** number of messages in the queue */
-	int msgcount;
-	/** list of messages.  The messages are added to the back and taken
-	 * out from the front. */
-	struct dt_msg_entry* first, *last;
+	dt_atomic(size_t) cursize;
+	/** the ring of messages, DTIO_QUEUE_SLOTS entries.  The messages
+	 * are added at the tail and taken out from the head. */
+	struct dt_msg_entry* ring;
+	/** position of the oldest message, moved by the writer thread when
+	 * it takes a message, and by the worker when it drops one */
+	dt_atomic(size_t) head;
+	/** position after the newest message, moved by the worker */
+	dt_atomic(size_t) tail;
+	/** if the oldest messages are dropped when the buffer is full,
+	 * instead of the new message */
+	int drop_oldest;
+	/** number of messages dropped because the buffer was full, only
+	 * changed by the worker */
+	size_t dropped;
 	/** reference to the io thread to wakeup */
 	struct dt_io_thread* dtio;
 	/** the wakeup timer for dtio, on worker event base */
@@ -82,15 +105,13 @@ struct dt_msg_queue {
 
 /**
  * An entry in the dt_msg_queue. contains one DNSTAP message.
- * It is malloced.
  */
 struct dt_msg_entry {
-	/** next in the list. */
-	struct dt_msg_entry* next;
-	/** the buffer with the data to send, an encoded DNSTAP message */
-	void* buf;
+	/** the buffer with the data to send, an encoded DNSTAP message.
+	 * It is malloced. */
+	dt_atomic(void*) buf;
 	/** the length to send. */
-	size_t len;
+	dt_atomic(size_t) len;
 };
 
 /**
@@ -175,6 +196,9 @@ struct dt_io_thread {
 	lock_basic_type wakeup_timer_lock;
 	/** if wakeup timer is enabled in some thread */
 	int wakeup_timer_enabled;
+	/** if a wakeup command has been sent that the io thread has not
+	 * picked up yet; more wakeups are not sent until it has */
+	dt_atomic(int) wakeup_pending;
 	/** command pipe that stops the pipe if closed.  Used to quit
 	 * the program. [0] is read, [1] is written to. */
 	int commandpipe[2];
@@ -66,6 +66,11 @@ local_zones_create(void)
 	rbtree_init(&zones->ztree, &local_zone_cmp);
 	lock_rw_init(&zones->lock);
 	lock_protect(&zones->lock, &zones->ztree, sizeof(zones->ztree));
+	lock_protect(&zones->lock, &zones->index, sizeof(zones->index));
+	lock_protect(&zones->lock, &zones->index_size,
+		sizeof(zones->index_size));
+	lock_protect(&zones->lock, &zones->index_count,
+		sizeof(zones->index_count));
 	/* also lock protects the rbnode's in struct local_zone */
 	return zones;
 }
@@ -86,6 +91,7 @@ local_zones_delete(struct local_zones* zones)
 	lock_rw_destroy(&zones->lock);
 	/* walk through zones and delete them all */
 	traverse_postorder(&zones->ztree, lzdel, NULL);
+	free(zones->index);
 	free(zones);
 }
 
@@ -127,6 +133,218 @@ local_data_cmp(const void* d1, const void* d2)
 		b->namelabs, &m);
 }
 
+/** maximum number of labels in a domain name, including the root */
+#define LZ_INDEX_MAXLABS ((LDNS_MAX_DOMAINLEN+1)/2)
+
+/** lowercase an octet of a domain name */
+#define lz_lower(c) (((c) >= 'A' && (c) <= 'Z') ? (c) - 'A' + 'a' : (c))
+
+/**
+ * Hash all the suffixes of a name.  The hash is computed from the root
+ * down, so that every suffix gets its own hash in one pass.
+ * @param name: the name.
+ * @param labs: labelcount of name.
+ * @param dclass: class of the zones to look for.
+ * @param suf: suf[d] is set to the suffix of name with d labels,
+ *	for d from 1 (the root) to labs.
+ * @param hash: hash[d] is set to the hash of suf[d].
+ * @return 0 if the name has too many labels.
+ */
+static int
+lz_index_hash(uint8_t* name, int labs, uint16_t dclass, uint8_t** suf,
+	uint32_t* hash)
+{
+	uint8_t* p;
+	uint32_t h;
+	int d;
+	size_t i;
+	if(labs < 1 || labs > LZ_INDEX_MAXLABS)
+		return 0;
+	p = name;
+	for(d = labs; d > 1; d--) {
+		suf[d] = p;
+		p += *p + 1;
+	}
+	suf[1] = p;
+	/* FNV-1a over the class and the labels, starting at the root */
+	h = 2166136261U;
+	h = (h ^ (dclass & 0xff)) * 16777619U;
+	h = (h ^ (dclass >> 8)) * 16777619U;
+	hash[1] = h;
+	for(d = 2; d <= labs; d++) {
+		p = suf[d];
+		for(i = 0; i <= (size_t)*p; i++)
+			h = (h ^ lz_lower(p[i])) * 16777619U;
+		hash[d] = h;
+	}
+	return 1;
+}
+
+/** find an entry in the name index, returns its slot or NULL */
+static struct local_zone_index_entry*
+lz_index_find(struct local_zones* zones, uint8_t* name, size_t len, int labs,
+	uint16_t dclass, uint32_t hash)
+{
+	struct local_zone_index_entry* e;
+	size_t mask, i;
+	if(!zones->index)
+		return NULL;
+	mask = zones->index_size - 1;
+	for(i = hash & mask; (e = &zones->index[i])->name; i = (i+1) & mask) {
+		if(e->hash == hash && e->namelen == len &&
+			e->namelabs == labs && e->dclass == dclass &&
+			query_dname_compare(e->name, name) == 0)
+			return e;
+	}
+	return NULL;
+}
+
+/** make room in the name index for n more entries, returns 0 on malloc
+ * failure */
+static int
+lz_index_grow(struct local_zones* zones, size_t n)
+{
+	struct local_zone_index_entry* old = zones->index, *e;
+	size_t oldsize = zones->index_size, size = oldsize, i, j;
+	/* keep the load under 3/4 */
+	if(size == 0)
+		size = 64;
+	while((zones->index_count + n)*4 > size*3)
+		size *= 2;
+	if(size == oldsize)
+		return 1;
+	e = (struct local_zone_index_entry*)calloc(size, sizeof(*e));
+	if(!e)
+		return 0;
+	for(i = 0; i < oldsize; i++) {
+		if(!old[i].name)
+			continue;
+		for(j = old[i].hash & (size-1); e[j].name; j = (j+1) & (size-1))
+			;
+		e[j] = old[i];
+	}
+	free(old);
+	zones->index = e;
+	zones->index_size = size;
+	return 1;
+}
+
+/** remove the entry in a slot from the name index */
+static void
+lz_index_del_slot(struct local_zones* zones, struct local_zone_index_entry* e)
+{
+	size_t mask = zones->index_size - 1;
+	size_t i = (size_t)(e - zones->index), j = i, k;
+	/* move later entries of the probe sequence into the hole, unless
+	 * their home slot is cyclically between the hole and them */
+	for(;;) {
+		j = (j+1) & mask;
+		if(!zones->index[j].name)
+			break;
+		k = zones->index[j].hash & mask;
+		if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		zones->index[i] = zones->index[j];
+		i = j;
+	}
+	zones->index[i].name = NULL;
+	zones->index[i].zone = NULL;
+	zones->index_count--;
+}
+
+/** add a zone, that is in the zones tree, to the name index, and set
+ * its parent pointer to the closest enclosing zone on the way.
+ * Returns 0 on malloc failure, the index is not changed then. */
+static int
+lz_index_insert(struct local_zones* zones, struct local_zone* z)
+{
+	uint8_t* suf[LZ_INDEX_MAXLABS+1];
+	uint32_t hash[LZ_INDEX_MAXLABS+1];
+	struct local_zone_index_entry* e;
+	size_t len, mask, i;
+	int d;
+	if(!lz_index_hash(z->name, z->namelabs, z->dclass, suf, hash)) {
+		log_err("local zone name has too many labels");
+		return 0;
+	}
+	if(!lz_index_grow(zones, (size_t)z->namelabs))
+		return 0;
+	mask = zones->index_size - 1;
+	z->parent = NULL;
+	for(d = 1; d <= z->namelabs; d++) {
+		len = z->namelen - (size_t)(suf[d] - z->name);
+		if((e = lz_index_find(zones, suf[d], len, d, z->dclass,
+			hash[d])) != NULL) {
+			e->count++;
+			if(d == z->namelabs) {
+				e->zone = z;
+				e->name = z->name;
+			} else if(e->zone)
+				z->parent = e->zone;
+		} else {
+			for(i = hash[d] & mask; zones->index[i].name;
+				i = (i+1) & mask)
+				;
+			e = &zones->index[i];
+			e->name = suf[d];
+			e->zone = (d == z->namelabs)?z:NULL;
+			e->hash = hash[d];
+			e->count = 1;
+			e->namelen = (uint16_t)len;
+			e->namelabs = (uint8_t)d;
+			e->dclass = z->dclass;
+			zones->index_count++;
+		}
+	}
+	return 1;
+}
+
+/** remove a zone, that has been removed from the zones tree, from the
+ * name index */
+static void
+lz_index_remove(struct local_zones* zones, struct local_zone* z)
+{
+	uint8_t* suf[LZ_INDEX_MAXLABS+1];
+	uint32_t hash[LZ_INDEX_MAXLABS+1];
+	struct local_zone_index_entry* e;
+	struct local_zone key, *below;
+	rbnode_type* node;
+	size_t len;
+	int d;
+	if(!lz_index_hash(z->name, z->namelabs, z->dclass, suf, hash))
+		return;
+	for(d = z->namelabs; d >= 1; d--) {
+		len = z->namelen - (size_t)(suf[d] - z->name);
+		e = lz_index_find(zones, suf[d], len, d, z->dclass, hash[d]);
+		log_assert(e && e->count > 0);
+		if(!e)
+			continue;
+		if(e->zone == z)
+			e->zone = NULL;
+		if(--e->count == 0) {
+			lz_index_del_slot(zones, e);
+			continue;
+		}
+		if(e->zone)
+			e->name = e->zone->name;
+		if(e->name < z->name || e->name >= z->name + z->namelen)
+			continue;
+		/* the name pointed into z, the zones below this empty
+		 * nonterminal directly follow it in the sorted tree */
+		key.node.key = &key;
+		key.dclass = z->dclass;
+		key.name = suf[d];
+		key.namelen = len;
+		key.namelabs = d;
+		(void)rbtree_find_less_equal(&zones->ztree, &key, &node);
+		node = node?rbtree_next(node):rbtree_first(&zones->ztree);
+		below = (struct local_zone*)node;
+		log_assert(node != RBTREE_NULL && below->dclass == z->dclass &&
+			below->namelen >= len);
+		e->name = below->name + below->namelen - len;
+	}
+}
+
 /* form wireformat from text format domain name */
 int
 parse_dname(const char* str, uint8_t** res, size_t* len, int* labs)
@@ -199,6 +417,14 @@ lz_enter_zone_dname(struct local_zones* zones, uint8_t* nm, size_t len,
 		local_zone_delete(oldz);
 		return z;
 	}
+	if(!lz_index_insert(zones, z)) {
+		(void)rbtree_delete(&zones->ztree, z);
+		lock_rw_unlock(&z->lock);
+		lock_rw_unlock(&zones->lock);
+		local_zone_delete(z);
+		log_err("out of memory");
+		return NULL;
+	}
 	lock_rw_unlock(&zones->lock);
 	return z;
 }
@@ -746,6 +972,18 @@ lz_enter_zones(struct local_zones* zones, struct config_file* cfg)
 {
 	struct config_str2list* p;
 	struct local_zone* z;
+	size_t n = 0;
+	/* size the name index for the zones up front, most names share
+	 * their ancestors, so count about two entries per zone */
+	for(p = cfg->local_zones; p; p = p->next)
+		n += 2;
+	lock_rw_wrlock(&zones->lock);
+	if(!lz_index_grow(zones, n)) {
+		lock_rw_unlock(&zones->lock);
+		log_err("out of memory");
+		return 0;
+	}
+	lock_rw_unlock(&zones->lock);
 	for(p = cfg->local_zones; p; p = p->next) {
 		if(!(z=lz_enter_zone(zones, p->str, p->str2, 
 			LDNS_RR_CLASS_IN)))
@@ -1140,34 +1378,33 @@ local_zones_tags_lookup(struct local_zones* zones,
         uint8_t* name, size_t len, int labs, uint16_t dclass, uint16_t dtype,
 	uint8_t* taglist, size_t taglen, int ignoretags)
 {
-	rbnode_type* res = NULL;
-	struct local_zone *result;
-	struct local_zone key;
-	int m;
+	uint8_t* suf[LZ_INDEX_MAXLABS+1];
+	uint32_t hash[LZ_INDEX_MAXLABS+1];
+	struct local_zone_index_entry* e;
+	struct local_zone *result = NULL;
+	int d;
 	/* for type DS use a zone higher when on a zonecut */
 	if(dtype == LDNS_RR_TYPE_DS && !dname_is_root(name)) {
 		dname_remove_label(&name, &len);
 		labs--;
 	}
-	key.node.key = &key;
-	key.dclass = dclass;
-	key.name = name;
-	key.namelen = len;
-	key.namelabs = labs;
-	rbtree_find_less_equal(&zones->ztree, &key, &res);
-	result = (struct local_zone*)res;
-	/* exact or smaller element (or no element) */
-	if(!result || result->dclass != dclass)
+	if(!lz_index_hash(name, labs, dclass, suf, hash))
 		return NULL;
-	/* count number of labels matched */
-	(void)dname_lab_cmp(result->name, result->namelabs, key.name,
-		key.namelabs, &m);
-	while(result) { /* go up until qname is zone or subdomain of zone */
-		if(result->namelabs <= m)
-			if(ignoretags || !result->taglist ||
-				taglist_intersect(result->taglist, 
-				result->taglen, taglist, taglen))
-				break;
+	/* go down from the root, the last zone seen is the closest
+	 * enclosing zone; stop where there are no zones below */
+	for(d = 1; d <= labs; d++) {
+		e = lz_index_find(zones, suf[d], len - (size_t)(suf[d] - name),
+			d, dclass, hash[d]);
+		if(!e)
+			break;
+		if(e->zone)
+			result = e->zone;
+	}
+	while(result) { /* go up until the zone tags match */
+		if(ignoretags || !result->taglist ||
+			taglist_intersect(result->taglist, 
+			result->taglen, taglist, taglen))
+			break;
 		result = result->parent;
 	}
 	return result;
@@ -1177,14 +1414,46 @@ struct local_zone*
 local_zones_find(struct local_zones* zones,
         uint8_t* name, size_t len, int labs, uint16_t dclass)
 {
-	struct local_zone key;
-	key.node.key = &key;
-	key.dclass = dclass;
-	key.name = name;
-	key.namelen = len;
-	key.namelabs = labs;
+	uint8_t* suf[LZ_INDEX_MAXLABS+1];
+	uint32_t hash[LZ_INDEX_MAXLABS+1];
+	struct local_zone_index_entry* e;
+	if(!zones->index || !lz_index_hash(name, labs, dclass, suf, hash))
+		return NULL;
 	/* exact */
-	return (struct local_zone*)rbtree_search(&zones->ztree, &key);
+	e = lz_index_find(zones, name, len, labs, dclass, hash[labs]);
+	return e?e->zone:NULL;
+}
+
+int
+local_zones_has_wildcard(struct local_zones* zones,
+	uint8_t* name, size_t len, int labs, uint16_t dclass)
+{
+	uint8_t* suf[LZ_INDEX_MAXLABS+1];
+	uint32_t hash[LZ_INDEX_MAXLABS+1];
+	uint8_t wc[LDNS_MAX_DOMAINLEN+1];
+	struct local_zone_index_entry* e;
+	size_t suflen;
+	uint32_t h;
+	int d;
+	if(!zones->index || !lz_index_hash(name, labs, dclass, suf, hash))
+		return 0;
+	wc[0] = 1; /* length of wildcard label */
+	wc[1] = (uint8_t)'*'; /* wildcard label */
+	/* go down from below the root to the parent of the name, stop
+	 * where there are no zones below */
+	for(d = 2; d < labs; d++) {
+		suflen = len - (size_t)(suf[d] - name);
+		if(!lz_index_find(zones, suf[d], suflen, d, dclass, hash[d]))
+			return 0;
+		/* the hash of the wildcard continues that of its parent */
+		h = (hash[d] ^ 1) * 16777619U;
+		h = (h ^ (uint8_t)'*') * 16777619U;
+		memmove(wc+2, suf[d], suflen);
+		e = lz_index_find(zones, wc, suflen+2, d+1, dclass, h);
+		if(e && e->zone)
+			return 1;
+	}
+	return 0;
 }
 
 struct local_zone*
@@ -1931,9 +2200,6 @@ struct local_zone* local_zones_add_zone(struct local_zones* zones,
 	}
 	lock_rw_wrlock(&z->lock);
 
-	/* find the closest parent */
-	z->parent = local_zones_find(zones, name, len, labs, dclass);
-
 	/* insert into the tree */
 	if(!rbtree_insert(&zones->ztree, &z->node)) {
 		/* duplicate entry! */
@@ -1942,6 +2208,14 @@ struct local_zone* local_zones_add_zone(struct local_zones* zones,
 		log_err("internal: duplicate entry in local_zones_add_zone");
 		return NULL;
 	}
+	/* add to the name index, that also finds the closest parent */
+	if(!lz_index_insert(zones, z)) {
+		(void)rbtree_delete(&zones->ztree, z);
+		lock_rw_unlock(&z->lock);
+		local_zone_delete(z);
+		log_err("out of memory");
+		return NULL;
+	}
 
 	/* set parent pointers right */
 	set_kiddo_parents(z, z->parent, z);
@@ -1958,6 +2232,7 @@ void local_zones_del_zone(struct local_zones* zones, struct local_zone* z)
 
 	/* remove from tree */
 	(void)rbtree_delete(&zones->ztree, z);
+	lz_index_remove(zones, z);
 
 	/* delete the zone */
 	lock_rw_unlock(&z->lock);
@@ -105,6 +105,30 @@ enum localzone_type {
 	local_zone_invalid
 };
 
+/**
+ * Entry in the name index of the local zones.  There is an entry for
+ * every zone name and for every ancestor of a zone name, so a lookup
+ * can go down from the root one label at a time and stop at the first
+ * name that has no zones at or below it.
+ */
+struct local_zone_index_entry {
+	/** the name, points into the name of a zone at or below it;
+	 * NULL if the slot is empty */
+	uint8_t* name;
+	/** the zone with this name, or NULL for an empty nonterminal */
+	struct local_zone* zone;
+	/** hash of the class and the lowercased name */
+	uint32_t hash;
+	/** number of zones at or below this name */
+	uint32_t count;
+	/** length of name */
+	uint16_t namelen;
+	/** number of labels in name */
+	uint8_t namelabs;
+	/** the class of the zones */
+	uint16_t dclass;
+};
+
 /**
  * Authoritative local zones storage, shared.
  */
@@ -113,6 +137,13 @@ struct local_zones {
 	lock_rw_type lock;
 	/** rbtree of struct local_zone */
 	rbtree_type ztree;
+	/** name index on the zones in ztree, open addressing hash table
+	 * with linear probing; NULL if there are no zones */
+	struct local_zone_index_entry* index;
+	/** number of slots in the index, a power of two */
+	size_t index_size;
+	/** number of used slots in the index */
+	size_t index_count;
 };
 
 /**
@@ -373,6 +404,21 @@ const char* local_zone_type2str(enum localzone_type t);
 struct local_zone* local_zones_find(struct local_zones* zones, 
 	uint8_t* name, size_t len, int labs, uint16_t dclass);
 
+/**
+ * See if there is a wildcard zone for any ancestor of the name, other
+ * than the root and the name itself.  Uses the name index, so that
+ * names without wildcard zones above them can skip the tree walk.
+ * User must lock the tree.
+ * @param zones: the zones tree
+ * @param name: dname to lookup
+ * @param len: length of name.
+ * @param labs: labelcount of name.
+ * @param dclass: class to lookup.
+ * @return 1 if there is such a wildcard zone, 0 if not.
+ */
+int local_zones_has_wildcard(struct local_zones* zones,
+	uint8_t* name, size_t len, int labs, uint16_t dclass);
+
 /**
  * Find zone that with exactly or smaller name/class
  * User must lock the tree or result zone.
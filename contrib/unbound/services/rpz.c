@@ -669,7 +669,7 @@ rpz_find_zone(struct rpz* r, uint8_t* qname, size_t qname_len, uint16_t qclass,
 {
 	uint8_t* ce;
 	size_t ce_len;
-	int ce_labs;
+	int ce_labs, labs;
 	uint8_t wc[LDNS_MAX_DOMAINLEN+1];
 	int exact;
 	struct local_zone* z = NULL;
@@ -678,62 +678,45 @@ rpz_find_zone(struct rpz* r, uint8_t* qname, size_t qname_len, uint16_t qclass,
 	} else {
 		lock_rw_rdlock(&r->local_zones->lock);
 	}
-	z = local_zones_find_le(r->local_zones, qname, qname_len,
-		dname_count_labels(qname),
-		LDNS_RR_CLASS_IN, &exact);
-	if(!z || (only_exact && !exact)) {
-		lock_rw_unlock(&r->local_zones->lock);
-		return NULL;
-	}
-	if(wr) {
-		lock_rw_wrlock(&z->lock);
-	} else {
-		lock_rw_rdlock(&z->lock);
-	}
-	if(!zones_keep_lock) {
-		lock_rw_unlock(&r->local_zones->lock);
-	}
-
-	if(exact)
-		return z;
-
-	/* No exact match found, lookup wildcard. closest encloser must
-	 * be the shared parent between the qname and the best local
-	 * zone match, append '*' to that and do another lookup. */
-
-	ce = dname_get_shared_topdomain(z->name, qname);
-	if(!ce /* should not happen */ || !*ce /* root */) {
-		lock_rw_unlock(&z->lock);
-		if(zones_keep_lock) {
+	labs = dname_count_labels(qname);
+	z = local_zones_find(r->local_zones, qname, qname_len, labs,
+		LDNS_RR_CLASS_IN);
+	if(!z) {
+		/* No exact match found, lookup wildcard. closest encloser must
+		 * be the shared parent between the qname and the best local
+		 * zone match, append '*' to that and do another lookup.
+		 * The index tells if there is any wildcard above the qname,
+		 * if not, the zone tree does not have to be searched. */
+		if(only_exact || !local_zones_has_wildcard(r->local_zones,
+			qname, qname_len, labs, qclass)) {
 			lock_rw_unlock(&r->local_zones->lock);
+			return NULL;
 		}
-		return NULL;
-	}
-	ce_labs = dname_count_size_labels(ce, &ce_len);
-	if(ce_len+2 > sizeof(wc)) {
-		lock_rw_unlock(&z->lock);
-		if(zones_keep_lock) {
+		z = local_zones_find_le(r->local_zones, qname, qname_len,
+			labs, LDNS_RR_CLASS_IN, &exact);
+		if(!z) {
 			lock_rw_unlock(&r->local_zones->lock);
+			return NULL;
 		}
-		return NULL;
-	}
-	wc[0] = 1; /* length of wildcard label */
-	wc[1] = (uint8_t)'*'; /* wildcard label */
-	memmove(wc+2, ce, ce_len);
-	lock_rw_unlock(&z->lock);
-
-	if(!zones_keep_lock) {
-		if(wr) {
-			lock_rw_wrlock(&r->local_zones->lock);
-		} else {
-			lock_rw_rdlock(&r->local_zones->lock);
+		ce = dname_get_shared_topdomain(z->name, qname);
+		if(!ce /* should not happen */ || !*ce /* root */) {
+			lock_rw_unlock(&r->local_zones->lock);
+			return NULL;
+		}
+		ce_labs = dname_count_size_labels(ce, &ce_len);
+		if(ce_len+2 > sizeof(wc)) {
+			lock_rw_unlock(&r->local_zones->lock);
+			return NULL;
+		}
+		wc[0] = 1; /* length of wildcard label */
+		wc[1] = (uint8_t)'*'; /* wildcard label */
+		memmove(wc+2, ce, ce_len);
+		z = local_zones_find(r->local_zones, wc, ce_len+2, ce_labs+1,
+			qclass);
+		if(!z) {
+			lock_rw_unlock(&r->local_zones->lock);
+			return NULL;
 		}
-	}
-	z = local_zones_find_le(r->local_zones, wc,
-		ce_len+2, ce_labs+1, qclass, &exact);
-	if(!z || !exact) {
-		lock_rw_unlock(&r->local_zones->lock);
-		return NULL;
 	}
 	if(wr) {
 		lock_rw_wrlock(&z->lock);
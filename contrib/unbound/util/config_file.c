@@ -684,6 +684,7 @@ int config_set_option(struct config_file* cfg, const char* opt,
 #ifdef USE_DNSTAP
 	else S_YNO("dnstap-enable:", dnstap)
 	else S_YNO("dnstap-bidirectional:", dnstap_bidirectional)
+	else S_YNO("dnstap-drop-oldest:", dnstap_drop_oldest)
 	else S_STR("dnstap-socket-path:", dnstap_socket_path)
 	else S_STR("dnstap-ip:", dnstap_ip)
 	else S_YNO("dnstap-tls:", dnstap_tls)
@@ -1116,6 +1117,7 @@ config_get_option(struct config_file* cfg, const char* opt,
 #ifdef USE_DNSTAP
 	else O_YNO(opt, "dnstap-enable", dnstap)
 	else O_YNO(opt, "dnstap-bidirectional", dnstap_bidirectional)
+	else O_YNO(opt, "dnstap-drop-oldest", dnstap_drop_oldest)
 	else O_STR(opt, "dnstap-socket-path", dnstap_socket_path)
 	else O_STR(opt, "dnstap-ip", dnstap_ip)
 	else O_YNO(opt, "dnstap-tls", dnstap_tls)
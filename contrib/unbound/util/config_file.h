@@ -504,6 +504,9 @@ struct config_file {
 	int dnstap;
 	/** using bidirectional frame streams if true */
 	int dnstap_bidirectional;
+	/** if the queue is full, drop the oldest messages instead of the
+	 * new one */
+	int dnstap_drop_oldest;
 	/** dnstap socket path */
 	char* dnstap_socket_path;
 	/** dnstap IP */
@@ -124,7 +124,7 @@ extern struct config_parser_state* cfg_parser;
 %token VAR_DNSTAP_TLS VAR_DNSTAP_TLS_SERVER_NAME VAR_DNSTAP_TLS_CERT_BUNDLE
 %token VAR_DNSTAP_TLS_CLIENT_KEY_FILE VAR_DNSTAP_TLS_CLIENT_CERT_FILE
 %token VAR_DNSTAP_SEND_IDENTITY VAR_DNSTAP_SEND_VERSION VAR_DNSTAP_BIDIRECTIONAL
-%token VAR_DNSTAP_IDENTITY VAR_DNSTAP_VERSION
+%token VAR_DNSTAP_IDENTITY VAR_DNSTAP_VERSION VAR_DNSTAP_DROP_OLDEST
 %token VAR_DNSTAP_LOG_RESOLVER_QUERY_MESSAGES
 %token VAR_DNSTAP_LOG_RESOLVER_RESPONSE_MESSAGES
 %token VAR_DNSTAP_LOG_CLIENT_QUERY_MESSAGES
@@ -2950,6 +2950,7 @@ dtstart: VAR_DNSTAP
 contents_dt: contents_dt content_dt
 	| ;
 content_dt: dt_dnstap_enable | dt_dnstap_socket_path | dt_dnstap_bidirectional |
+	dt_dnstap_drop_oldest |
 	dt_dnstap_ip | dt_dnstap_tls | dt_dnstap_tls_server_name |
 	dt_dnstap_tls_cert_bundle |
 	dt_dnstap_tls_client_key_file | dt_dnstap_tls_client_cert_file |
@@ -2981,6 +2982,16 @@ dt_dnstap_bidirectional: VAR_DNSTAP_BIDIRECTIONAL STRING_ARG
 		free($2);
 	}
 	;
+dt_dnstap_drop_oldest: VAR_DNSTAP_DROP_OLDEST STRING_ARG
+	{
+		OUTYY(("P(dt_dnstap_drop_oldest:%s)\n", $2));
+		if(strcmp($2, "yes") != 0 && strcmp($2, "no") != 0)
+			yyerror("expected yes or no.");
+		else cfg_parser->cfg->dnstap_drop_oldest =
+			(strcmp($2, "yes")==0);
+		free($2);
+	}
+	;
 dt_dnstap_socket_path: VAR_DNSTAP_SOCKET_PATH STRING_ARG
 	{
 		OUTYY(("P(dt_dnstap_socket_path:%s)\n", $2));
@@ -97,6 +97,43 @@
 #define NUM_UDP_PER_SELECT 1
 #endif
 
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG) && !defined(NONBLOCKING_IS_BROKEN)
+/** receive UDP queries, and send the replies, in batches */
+#define USE_UDP_MMSG 1
+/** number of UDP datagrams per recvmmsg and per sendmmsg call */
+#define NUM_UDP_PER_MMSG 32
+
+/**
+ * Buffers for batched UDP receive and reply.  The UDP callback fills
+ * them and empties them again before it returns, so one set per comm
+ * base is shared by all its UDP comm points.
+ */
+struct udp_mmsg {
+	/** size of every packet buffer */
+	size_t bufsize;
+	/** set if the system calls turned out to be unavailable */
+	int disabled;
+	/** received datagrams */
+	struct mmsghdr recv_hdr[NUM_UDP_PER_MMSG];
+	/** received datagram buffers */
+	struct iovec recv_iov[NUM_UDP_PER_MMSG];
+	/** received datagram source addresses */
+	struct sockaddr_storage recv_addr[NUM_UDP_PER_MMSG];
+	/** storage for the received datagrams */
+	uint8_t* recv_buf;
+	/** number of replies waiting to be sent */
+	int num_send;
+	/** replies waiting to be sent */
+	struct mmsghdr send_hdr[NUM_UDP_PER_MMSG];
+	/** reply buffers */
+	struct iovec send_iov[NUM_UDP_PER_MMSG];
+	/** reply destination addresses */
+	struct sockaddr_storage send_addr[NUM_UDP_PER_MMSG];
+	/** storage for the replies */
+	uint8_t* send_buf;
+};
+#endif /* HAVE_RECVMMSG && HAVE_SENDMMSG && !NONBLOCKING_IS_BROKEN */
+
 /**
  * The internal event structure for keeping ub_event info for the event.
  * Possibly other structures (list, tree) this is part of.
@@ -122,6 +159,10 @@ struct internal_base {
 	struct ub_event* slow_accept;
 	/** true if slow_accept is enabled */
 	int slow_accept_enabled;
+#ifdef USE_UDP_MMSG
+	/** buffers for batched UDP receive and reply, allocated on use */
+	struct udp_mmsg* mmsg;
+#endif
 };
 
 /**
@@ -148,6 +189,11 @@ struct internal_signal {
 	struct internal_signal* next;
 };
 
+#ifdef USE_UDP_MMSG
+/** delete the batched UDP buffers */
+static void udp_mmsg_delete(struct udp_mmsg* m);
+#endif
+
 /** create a tcp handler with a parent */
 static struct comm_point* comm_point_create_tcp_handler(
 	struct comm_base *base, struct comm_point* parent, size_t bufsize,
@@ -210,6 +256,9 @@ comm_base_delete(struct comm_base* b)
 		}
 		ub_event_free(b->eb->slow_accept);
 	}
+#ifdef USE_UDP_MMSG
+	udp_mmsg_delete(b->eb->mmsg);
+#endif
 	ub_event_base_free(b->eb->base);
 	b->eb->base = NULL;
 	free(b->eb);
@@ -227,6 +276,9 @@ comm_base_delete_no_base(struct comm_base* b)
 		}
 		ub_event_free(b->eb->slow_accept);
 	}
+#ifdef USE_UDP_MMSG
+	udp_mmsg_delete(b->eb->mmsg);
+#endif
 	b->eb->base = NULL;
 	free(b->eb);
 	free(b);
@@ -723,6 +775,205 @@ comm_point_udp_ancil_callback(int fd, short event, void* arg)
 #endif /* AF_INET6 && IPV6_PKTINFO && HAVE_RECVMSG */
 }
 
+#ifdef USE_UDP_MMSG
+static void
+udp_mmsg_delete(struct udp_mmsg* m)
+{
+	if(!m)
+		return;
+	free(m->recv_buf);
+	free(m->send_buf);
+	free(m);
+}
+
+/** get the batched UDP buffers of a comm base, NULL if not available */
+static struct udp_mmsg*
+udp_mmsg_get(struct comm_base* b, size_t bufsize)
+{
+	struct udp_mmsg* m = b->eb->mmsg;
+	int i;
+	if(m && m->disabled)
+		return NULL;
+	if(m && m->bufsize >= bufsize)
+		return m;
+	udp_mmsg_delete(m);
+	b->eb->mmsg = NULL;
+	m = (struct udp_mmsg*)calloc(1, sizeof(*m));
+	if(!m)
+		return NULL;
+	m->bufsize = bufsize;
+	m->recv_buf = (uint8_t*)malloc(bufsize*NUM_UDP_PER_MMSG);
+	m->send_buf = (uint8_t*)malloc(bufsize*NUM_UDP_PER_MMSG);
+	if(!m->recv_buf || !m->send_buf) {
+		log_err("could not allocate batched UDP buffers, out of memory");
+		udp_mmsg_delete(m);
+		return NULL;
+	}
+	for(i=0; i<NUM_UDP_PER_MMSG; i++) {
+		m->recv_iov[i].iov_base = m->recv_buf + i*bufsize;
+		m->recv_hdr[i].msg_hdr.msg_name = &m->recv_addr[i];
+		m->recv_hdr[i].msg_hdr.msg_iov = &m->recv_iov[i];
+		m->recv_hdr[i].msg_hdr.msg_iovlen = 1;
+		m->send_iov[i].iov_base = m->send_buf + i*bufsize;
+		m->send_hdr[i].msg_hdr.msg_name = &m->send_addr[i];
+		m->send_hdr[i].msg_hdr.msg_iov = &m->send_iov[i];
+		m->send_hdr[i].msg_hdr.msg_iovlen = 1;
+	}
+	b->eb->mmsg = m;
+	return m;
+}
+
+/** stop using batched UDP on the comm base, the calls are not there */
+static void
+udp_mmsg_disable(struct udp_mmsg* m)
+{
+	verbose(VERB_ALGO, "recvmmsg not supported, using recvfrom");
+	free(m->recv_buf);
+	free(m->send_buf);
+	m->recv_buf = NULL;
+	m->send_buf = NULL;
+	m->disabled = 1;
+}
+
+/** send the replies that are waiting in the batch, on the socket fd
+ * that their queries came in on */
+static void
+udp_mmsg_flush(struct comm_point* c, struct udp_mmsg* m, int fd)
+{
+	struct sldns_buffer packet;
+	struct msghdr* hdr;
+	int done = 0, sent;
+	while(done < m->num_send) {
+		sent = (int)sendmmsg(fd, &m->send_hdr[done],
+			m->num_send - done, 0);
+		if(sent > 0) {
+			done += sent;
+			continue;
+		}
+		hdr = &m->send_hdr[done].msg_hdr;
+		if(c->fd != fd) {
+			/* the commpoint has moved to another socket,
+			 * there is no retry on the old one */
+			if(udp_send_errno_needs_log(
+				(struct sockaddr*)hdr->msg_name,
+				hdr->msg_namelen))
+				verbose(VERB_OPS, "sendmmsg failed: %s",
+					sock_strerror(errno));
+			done++;
+			continue;
+		}
+		/* send the failed reply on its own, that waits for buffer
+		 * space if need be, and logs the error */
+		sldns_buffer_init_frm_data(&packet, hdr->msg_iov->iov_base,
+			hdr->msg_iov->iov_len);
+		(void)comm_point_send_udp_msg(c, &packet,
+			(struct sockaddr*)hdr->msg_name, hdr->msg_namelen, 0);
+		done++;
+	}
+	m->num_send = 0;
+}
+
+/** add the reply in the packet to the batch for socket fd */
+static void
+udp_mmsg_queue(struct comm_point* c, struct udp_mmsg* m, int fd,
+	struct sldns_buffer* packet, struct comm_reply* rep)
+{
+	struct msghdr* hdr = &m->send_hdr[m->num_send].msg_hdr;
+	size_t len = sldns_buffer_remaining(packet);
+	if(len > m->bufsize) {
+		(void)comm_point_send_udp_msg(c, packet,
+			(struct sockaddr*)&rep->addr, rep->addrlen, 0);
+		return;
+	}
+#ifdef UNBOUND_DEBUG
+	if(len == 0)
+		log_err("error: send empty UDP packet");
+#endif
+	memmove(hdr->msg_iov->iov_base, sldns_buffer_begin(packet), len);
+	hdr->msg_iov->iov_len = len;
+	memmove(hdr->msg_name, &rep->addr, rep->addrlen);
+	hdr->msg_namelen = rep->addrlen;
+	hdr->msg_control = NULL;
+	hdr->msg_controllen = 0;
+	hdr->msg_flags = 0;
+	if(++m->num_send == NUM_UDP_PER_MMSG)
+		udp_mmsg_flush(c, m, fd);
+}
+
+/**
+ * Handle UDP read indication with recvmmsg and sendmmsg: drain up to
+ * NUM_UDP_PER_SELECT datagrams in batches, and send the replies that
+ * are ready straight away together.  Returns false if batching is not
+ * available, and the caller should read datagrams one by one.
+ */
+static int
+comm_point_udp_mmsg_callback(struct comm_point* c, int fd)
+{
+	struct comm_reply rep;
+	struct udp_mmsg* m;
+	struct sldns_buffer* buffer;
+	size_t bufsize = sldns_buffer_capacity(c->buffer);
+	int i, n, total;
+
+	if(!(m = udp_mmsg_get(c->ev->base, bufsize)))
+		return 0;
+	rep.c = c;
+	for(total=0; total<NUM_UDP_PER_SELECT; total+=n) {
+		for(i=0; i<NUM_UDP_PER_MMSG; i++) {
+			m->recv_iov[i].iov_len = bufsize;
+			m->recv_hdr[i].msg_hdr.msg_namelen =
+				(socklen_t)sizeof(m->recv_addr[i]);
+			m->recv_hdr[i].msg_hdr.msg_control = NULL;
+			m->recv_hdr[i].msg_hdr.msg_controllen = 0;
+			m->recv_hdr[i].msg_hdr.msg_flags = 0;
+		}
+		n = (int)recvmmsg(fd, m->recv_hdr, NUM_UDP_PER_MMSG, 0, NULL);
+		if(n == -1) {
+			if(errno == ENOSYS && total == 0) {
+				udp_mmsg_disable(m);
+				return 0;
+			}
+			if(errno != EAGAIN && errno != EINTR
+				&& udp_recv_needs_log(errno))
+				log_err("recvmmsg %d failed: %s",
+					fd, strerror(errno));
+			break;
+		}
+		for(i=0; i<n; i++) {
+			sldns_buffer_clear(c->buffer);
+			sldns_buffer_write(c->buffer, m->recv_iov[i].iov_base,
+				m->recv_hdr[i].msg_len);
+			sldns_buffer_flip(c->buffer);
+			rep.addrlen = m->recv_hdr[i].msg_hdr.msg_namelen;
+			memmove(&rep.addr, &m->recv_addr[i], rep.addrlen);
+			rep.srctype = 0;
+			fptr_ok(fptr_whitelist_comm_point(c->callback));
+			if((*c->callback)(c, c->cb_arg, NETEVENT_NOERROR, &rep)) {
+				/* queue immediate reply */
+#ifdef USE_DNSCRYPT
+				buffer = c->dnscrypt_buffer;
+#else
+				buffer = c->buffer;
+#endif
+				udp_mmsg_queue(c, m, fd, buffer, &rep);
+			}
+			if(c->fd != fd) {
+				/* commpoint closed to -1 or reused for
+				 * another UDP port; send the replies that
+				 * are already built on the socket that they
+				 * belong to before forgetting it. */
+				udp_mmsg_flush(c, m, fd);
+				return 1;
+			}
+		}
+		if(n < NUM_UDP_PER_MMSG)
+			break;
+	}
+	udp_mmsg_flush(c, m, fd);
+	return 1;
+}
+#endif /* USE_UDP_MMSG */
+
 void 
 comm_point_udp_callback(int fd, short event, void* arg)
 {
@@ -738,6 +989,10 @@ comm_point_udp_callback(int fd, short event, void* arg)
 		return;
 	log_assert(rep.c && rep.c->buffer && rep.c->fd == fd);
 	ub_comm_base_now(rep.c->ev->base);
+#ifdef USE_UDP_MMSG
+	if(comm_point_udp_mmsg_callback(rep.c, fd))
+		return;
+#endif
 	for(i=0; i<NUM_UDP_PER_SELECT; i++) {
 		sldns_buffer_clear(rep.c->buffer);
 		rep.addrlen = (socklen_t)sizeof(rep.addr);
@@ -1269,17 +1269,20 @@ ZSTD_compressionParameters ZSTD_getCParamsFromCCtxParams(
 
 static size_t
 ZSTD_sizeof_matchState(const ZSTD_compressionParameters* const cParams,
+                       const int useRowMatchFinder,
                        const U32 forCCtx)
 {
-    size_t const chainSize = (cParams->strategy == ZSTD_fast) ? 0 : ((size_t)1 << cParams->chainLog);
+    size_t const chainSize = (cParams->strategy == ZSTD_fast || useRowMatchFinder) ? 0 : ((size_t)1 << cParams->chainLog);
     size_t const hSize = ((size_t)1) << cParams->hashLog;
+    size_t const tagTableSize = useRowMatchFinder ? hSize : 0;
     U32    const hashLog3 = (forCCtx && cParams->minMatch==3) ? MIN(ZSTD_HASHLOG3_MAX, cParams->windowLog) : 0;
     size_t const h3Size = hashLog3 ? ((size_t)1) << hashLog3 : 0;
     /* We don't use ZSTD_cwksp_alloc_size() here because the tables aren't
      * surrounded by redzones in ASAN. */
     size_t const tableSpace = chainSize * sizeof(U32)
                             + hSize * sizeof(U32)
-                            + h3Size * sizeof(U32);
+                            + h3Size * sizeof(U32)
+                            + tagTableSize;
     size_t const optPotentialSpace =
         ZSTD_cwksp_alloc_size((MaxML+1) * sizeof(U32))
       + ZSTD_cwksp_alloc_size((MaxLL+1) * sizeof(U32))
@@ -1298,6 +1301,7 @@ ZSTD_sizeof_matchState(const ZSTD_compressionParameters* const cParams,
 static size_t ZSTD_estimateCCtxSize_usingCCtxParams_internal(
         const ZSTD_compressionParameters* cParams,
         const ldmParams_t* ldmParams,
+        const int useRowMatchFinder,
         const int isStatic,
         const size_t buffInSize,
         const size_t buffOutSize,
@@ -1312,7 +1316,7 @@ static size_t ZSTD_estimateCCtxSize_usingCCtxParams_internal(
                             + 3 * ZSTD_cwksp_alloc_size(maxNbSeq * sizeof(BYTE));
     size_t const entropySpace = ZSTD_cwksp_alloc_size(ENTROPY_WORKSPACE_SIZE);
     size_t const blockStateSpace = 2 * ZSTD_cwksp_alloc_size(sizeof(ZSTD_compressedBlockState_t));
-    size_t const matchStateSize = ZSTD_sizeof_matchState(cParams, /* forCCtx */ 1);
+    size_t const matchStateSize = ZSTD_sizeof_matchState(cParams, useRowMatchFinder, /* forCCtx */ 1);
 
     size_t const ldmSpace = ZSTD_ldm_getTableSize(*ldmParams);
     size_t const maxNbLdmSeq = ZSTD_ldm_getMaxNbSeq(*ldmParams, blockSize);
@@ -1347,9 +1351,17 @@ size_t ZSTD_estimateCCtxSize_usingCCtxParams(const ZSTD_CCtx_params* params)
     RETURN_ERROR_IF(params->nbWorkers > 0, GENERIC, "Estimate CCtx size is supported for single-threaded compression only.");
     /* estimateCCtxSize is for one-shot compression. So no buffers should
      * be needed. However, we still allocate two 0-sized buffers, which can
-     * take space under ASAN. */
-    return ZSTD_estimateCCtxSize_usingCCtxParams_internal(
-        &cParams, &params->ldmParams, 1, 0, 0, ZSTD_CONTENTSIZE_UNKNOWN);
+     * take space under ASAN.
+     * The context falls back to the hash chain when a dictionary is
+     * referenced, so budget for whichever table layout is larger. */
+    {   size_t const chainEstimate = ZSTD_estimateCCtxSize_usingCCtxParams_internal(
+            &cParams, &params->ldmParams, 0, 1, 0, 0, ZSTD_CONTENTSIZE_UNKNOWN);
+        size_t const rowEstimate = ZSTD_rowMatchFinderSupported(&cParams)
+            ? ZSTD_estimateCCtxSize_usingCCtxParams_internal(
+                &cParams, &params->ldmParams, 1, 1, 0, 0, ZSTD_CONTENTSIZE_UNKNOWN)
+            : 0;
+        return MAX(chainEstimate, rowEstimate);
+    }
 }
 
 size_t ZSTD_estimateCCtxSize_usingCParams(ZSTD_compressionParameters cParams)
@@ -1388,9 +1400,15 @@ size_t ZSTD_estimateCStreamSize_usingCCtxParams(const ZSTD_CCtx_params* params)
                 ? ZSTD_compressBound(blockSize) + 1
                 : 0;
 
-        return ZSTD_estimateCCtxSize_usingCCtxParams_internal(
-            &cParams, &params->ldmParams, 1, inBuffSize, outBuffSize,
+        size_t const chainEstimate = ZSTD_estimateCCtxSize_usingCCtxParams_internal(
+            &cParams, &params->ldmParams, 0, 1, inBuffSize, outBuffSize,
             ZSTD_CONTENTSIZE_UNKNOWN);
+        size_t const rowEstimate = ZSTD_rowMatchFinderSupported(&cParams)
+            ? ZSTD_estimateCCtxSize_usingCCtxParams_internal(
+                &cParams, &params->ldmParams, 1, 1, inBuffSize, outBuffSize,
+                ZSTD_CONTENTSIZE_UNKNOWN)
+            : 0;
+        return MAX(chainEstimate, rowEstimate);
     }
 }
 
@@ -1526,12 +1544,14 @@ static size_t
 ZSTD_reset_matchState(ZSTD_matchState_t* ms,
                       ZSTD_cwksp* ws,
                 const ZSTD_compressionParameters* cParams,
+                const int useRowMatchFinder,
                 const ZSTD_compResetPolicy_e crp,
                 const ZSTD_indexResetPolicy_e forceResetIndex,
                 const ZSTD_resetTarget_e forWho)
 {
-    size_t const chainSize = (cParams->strategy == ZSTD_fast) ? 0 : ((size_t)1 << cParams->chainLog);
+    size_t const chainSize = (cParams->strategy == ZSTD_fast || useRowMatchFinder) ? 0 : ((size_t)1 << cParams->chainLog);
     size_t const hSize = ((size_t)1) << cParams->hashLog;
+    size_t const tagTableSize = useRowMatchFinder ? hSize : 0;
     U32    const hashLog3 = ((forWho == ZSTD_resetTarget_CCtx) && cParams->minMatch==3) ? MIN(ZSTD_HASHLOG3_MAX, cParams->windowLog) : 0;
     size_t const h3Size = hashLog3 ? ((size_t)1) << hashLog3 : 0;
 
@@ -1554,9 +1574,17 @@ ZSTD_reset_matchState(ZSTD_matchState_t* ms,
     ms->hashTable = (U32*)ZSTD_cwksp_reserve_table(ws, hSize * sizeof(U32));
     ms->chainTable = (U32*)ZSTD_cwksp_reserve_table(ws, chainSize * sizeof(U32));
     ms->hashTable3 = (U32*)ZSTD_cwksp_reserve_table(ws, h3Size * sizeof(U32));
+    ms->tagTable = (BYTE*)ZSTD_cwksp_reserve_table(ws, tagTableSize);
     RETURN_ERROR_IF(ZSTD_cwksp_reserve_failed(ws), memory_allocation,
                     "failed a workspace allocation in ZSTD_reset_matchState");
 
+    ms->useRowMatchFinder = useRowMatchFinder;
+    if (useRowMatchFinder) {
+        U32 const rowLog = MAX(4, MIN(cParams->searchLog, 6));
+        assert(cParams->hashLog > rowLog);
+        ms->rowHashLog = cParams->hashLog - rowLog;
+    }
+
     DEBUGLOG(4, "reset table : %u", crp!=ZSTDcrp_leaveDirty);
     if (crp!=ZSTDcrp_leaveDirty) {
         /* reset tables only */
@@ -1630,14 +1658,17 @@ static size_t ZSTD_resetCCtx_internal(ZSTD_CCtx* zc,
                 : 0;
         size_t const maxNbLdmSeq = ZSTD_ldm_getMaxNbSeq(params.ldmParams, blockSize);
 
+        int const useRowMatchFinder = !params.disableRowMatchFinder
+                                   && ZSTD_rowMatchFinderSupported(&params.cParams);
+
         int const indexTooClose = ZSTD_indexTooCloseToMax(zc->blockState.matchState.window);
         ZSTD_indexResetPolicy_e needsIndexReset =
             (!indexTooClose && zc->initialized) ? ZSTDirp_continue : ZSTDirp_reset;
 
         size_t const neededSpace =
             ZSTD_estimateCCtxSize_usingCCtxParams_internal(
-                &params.cParams, &params.ldmParams, zc->staticSize != 0,
-                buffInSize, buffOutSize, pledgedSrcSize);
+                &params.cParams, &params.ldmParams, useRowMatchFinder,
+                zc->staticSize != 0, buffInSize, buffOutSize, pledgedSrcSize);
         FORWARD_IF_ERROR(neededSpace, "cctx size estimate failed!");
 
         if (!zc->staticSize) ZSTD_cwksp_bump_oversized_duration(ws, 0);
@@ -1730,6 +1761,7 @@ static size_t ZSTD_resetCCtx_internal(ZSTD_CCtx* zc,
             &zc->blockState.matchState,
             ws,
             &params.cParams,
+            useRowMatchFinder,
             crp,
             needsIndexReset,
             ZSTD_resetTarget_CCtx), "");
@@ -1825,6 +1857,7 @@ ZSTD_resetCCtx_byAttachingCDict(ZSTD_CCtx* cctx,
         params.cParams = ZSTD_adjustCParams_internal(adjusted_cdict_cParams, pledgedSrcSize,
                                                      cdict->dictContentSize, ZSTD_cpm_attachDict);
         params.cParams.windowLog = windowLog;
+        params.disableRowMatchFinder = 1;   /* dictMatchState search walks hash chains */
         FORWARD_IF_ERROR(ZSTD_resetCCtx_internal(cctx, params, pledgedSrcSize,
                                                  ZSTDcrp_makeClean, zbuff), "");
         assert(cctx->appliedParams.cParams.strategy == adjusted_cdict_cParams.strategy);
@@ -1876,6 +1909,7 @@ static size_t ZSTD_resetCCtx_byCopyingCDict(ZSTD_CCtx* cctx,
         /* Copy only compression parameters related to tables. */
         params.cParams = *cdict_cParams;
         params.cParams.windowLog = windowLog;
+        params.disableRowMatchFinder = 1;   /* tables are copied from the CDict */
         FORWARD_IF_ERROR(ZSTD_resetCCtx_internal(cctx, params, pledgedSrcSize,
                                                  ZSTDcrp_leaveDirty, zbuff), "");
         assert(cctx->appliedParams.cParams.strategy == cdict_cParams->strategy);
@@ -1966,6 +2000,7 @@ static size_t ZSTD_copyCCtx_internal(ZSTD_CCtx* dstCCtx,
         /* Copy only compression parameters related to tables. */
         params.cParams = srcCCtx->appliedParams.cParams;
         params.fParams = fParams;
+        params.disableRowMatchFinder = srcCCtx->appliedParams.disableRowMatchFinder;
         ZSTD_resetCCtx_internal(dstCCtx, params, pledgedSrcSize,
                                 ZSTDcrp_leaveDirty, zbuff);
         assert(dstCCtx->appliedParams.cParams.windowLog == srcCCtx->appliedParams.cParams.windowLog);
@@ -1973,13 +2008,16 @@ static size_t ZSTD_copyCCtx_internal(ZSTD_CCtx* dstCCtx,
         assert(dstCCtx->appliedParams.cParams.hashLog == srcCCtx->appliedParams.cParams.hashLog);
         assert(dstCCtx->appliedParams.cParams.chainLog == srcCCtx->appliedParams.cParams.chainLog);
         assert(dstCCtx->blockState.matchState.hashLog3 == srcCCtx->blockState.matchState.hashLog3);
+        assert(dstCCtx->blockState.matchState.useRowMatchFinder == srcCCtx->blockState.matchState.useRowMatchFinder);
     }
 
     ZSTD_cwksp_mark_tables_dirty(&dstCCtx->workspace);
 
     /* copy tables */
-    {   size_t const chainSize = (srcCCtx->appliedParams.cParams.strategy == ZSTD_fast) ? 0 : ((size_t)1 << srcCCtx->appliedParams.cParams.chainLog);
+    {   int const useRowMatchFinder = srcCCtx->blockState.matchState.useRowMatchFinder;
+        size_t const chainSize = (srcCCtx->appliedParams.cParams.strategy == ZSTD_fast || useRowMatchFinder) ? 0 : ((size_t)1 << srcCCtx->appliedParams.cParams.chainLog);
         size_t const hSize =  (size_t)1 << srcCCtx->appliedParams.cParams.hashLog;
+        size_t const tagTableSize = useRowMatchFinder ? hSize : 0;
         int const h3log = srcCCtx->blockState.matchState.hashLog3;
         size_t const h3Size = h3log ? ((size_t)1 << h3log) : 0;
 
@@ -1992,6 +2030,9 @@ static size_t ZSTD_copyCCtx_internal(ZSTD_CCtx* dstCCtx,
         ZSTD_memcpy(dstCCtx->blockState.matchState.hashTable3,
                srcCCtx->blockState.matchState.hashTable3,
                h3Size * sizeof(U32));
+        ZSTD_memcpy(dstCCtx->blockState.matchState.tagTable,
+               srcCCtx->blockState.matchState.tagTable,
+               tagTableSize);
     }
 
     ZSTD_cwksp_mark_tables_clean(&dstCCtx->workspace);
@@ -2091,7 +2132,7 @@ static void ZSTD_reduceIndex (ZSTD_matchState_t* ms, ZSTD_CCtx_params const* par
         ZSTD_reduceTable(ms->hashTable, hSize, reducerValue);
     }
 
-    if (params->cParams.strategy != ZSTD_fast) {
+    if (params->cParams.strategy != ZSTD_fast && !ms->useRowMatchFinder) {
         U32 const chainSize = (U32)1 << params->cParams.chainLog;
         if (params->cParams.strategy == ZSTD_btlazy2)
             ZSTD_reduceTable_btlazy2(ms->chainTable, chainSize, reducerValue);
@@ -3121,6 +3162,8 @@ static size_t ZSTD_loadDictionaryContent(ZSTD_matchState_t* ms,
             if (chunk >= HASH_READ_SIZE && ms->dedicatedDictSearch) {
                 assert(chunk == remaining); /* must load everything in one go */
                 ZSTD_dedicatedDictSearch_lazy_loadDictionary(ms, ichunk-HASH_READ_SIZE);
+            } else if (chunk >= HASH_READ_SIZE && ms->useRowMatchFinder) {
+                ZSTD_row_update(ms, ichunk-HASH_READ_SIZE);
             } else if (chunk >= HASH_READ_SIZE) {
                 ZSTD_insertAndFindFirstIndex(ms, ichunk-HASH_READ_SIZE);
             }
@@ -3596,7 +3639,7 @@ size_t ZSTD_estimateCDictSize_advanced(
     DEBUGLOG(5, "sizeof(ZSTD_CDict) : %u", (unsigned)sizeof(ZSTD_CDict));
     return ZSTD_cwksp_alloc_size(sizeof(ZSTD_CDict))
          + ZSTD_cwksp_alloc_size(HUF_WORKSPACE_SIZE)
-         + ZSTD_sizeof_matchState(&cParams, /* forCCtx */ 0)
+         + ZSTD_sizeof_matchState(&cParams, /* useRowMatchFinder */ 0, /* forCCtx */ 0)
          + (dictLoadMethod == ZSTD_dlm_byRef ? 0
             : ZSTD_cwksp_alloc_size(ZSTD_cwksp_align(dictSize, sizeof(void *))));
 }
@@ -3650,6 +3693,7 @@ static size_t ZSTD_initCDict_internal(
         &cdict->matchState,
         &cdict->workspace,
         &params.cParams,
+        /* useRowMatchFinder */ 0,
         ZSTDcrp_makeClean,
         ZSTDirp_reset,
         ZSTD_resetTarget_CDict), "");
@@ -3680,7 +3724,7 @@ static ZSTD_CDict* ZSTD_createCDict_advanced_internal(size_t dictSize,
     {   size_t const workspaceSize =
             ZSTD_cwksp_alloc_size(sizeof(ZSTD_CDict)) +
             ZSTD_cwksp_alloc_size(HUF_WORKSPACE_SIZE) +
-            ZSTD_sizeof_matchState(&cParams, /* forCCtx */ 0) +
+            ZSTD_sizeof_matchState(&cParams, /* useRowMatchFinder */ 0, /* forCCtx */ 0) +
             (dictLoadMethod == ZSTD_dlm_byRef ? 0
              : ZSTD_cwksp_alloc_size(ZSTD_cwksp_align(dictSize, sizeof(void*))));
         void* const workspace = ZSTD_customMalloc(workspaceSize, customMem);
@@ -3823,7 +3867,7 @@ const ZSTD_CDict* ZSTD_initStaticCDict(
                                  ZSTD_dictContentType_e dictContentType,
                                  ZSTD_compressionParameters cParams)
 {
-    size_t const matchStateSize = ZSTD_sizeof_matchState(&cParams, /* forCCtx */ 0);
+    size_t const matchStateSize = ZSTD_sizeof_matchState(&cParams, /* useRowMatchFinder */ 0, /* forCCtx */ 0);
     size_t const neededSize = ZSTD_cwksp_alloc_size(sizeof(ZSTD_CDict))
                             + (dictLoadMethod == ZSTD_dlm_byRef ? 0
                                : ZSTD_cwksp_alloc_size(ZSTD_cwksp_align(dictSize, sizeof(void*))))
@@ -40,6 +40,8 @@ extern "C" {
                                        But candidate 1 cannot hide a large tree of candidates, so it's a minimal loss.
                                        The benefit is that ZSTD_DUBT_UNSORTED_MARK cannot be mishandled after table re-use with a different strategy.
                                        This constant is required by ZSTD_compressBlock_btlazy2() and ZSTD_reduceTable_internal() */
+#define ZSTD_ROW_HASH_TAG_BITS 8        /* nb bits to use for the tag, for the row-based matchfinder */
+#define ZSTD_ROW_HASH_CACHE_SIZE 8      /* Size of prefetching hash cache for row-based matchfinder */
 
 
 /*-*************************************
@@ -166,6 +168,13 @@ struct ZSTD_matchState_t {
     int dedicatedDictSearch;  /* Indicates whether this matchState is using the
                                * dedicated dictionary search structure.
                                */
+    int useRowMatchFinder;  /* Indicates whether hashTable is organised in rows
+                             * (see ZSTD_rowMatchFinderSupported()). When set,
+                             * chainTable is not allocated.
+                             */
+    BYTE* tagTable;         /* For row-based matchfinder: one byte tag per hashTable entry */
+    U32 rowHashLog;         /* For row-based matchfinder: hashLog - rowLog */
+    U32 hashCache[ZSTD_ROW_HASH_CACHE_SIZE]; /* For row-based matchfinder: hashes of the next positions */
     optState_t opt;         /* optimal parser state */
     const ZSTD_matchState_t* dictMatchState;
     ZSTD_compressionParameters cParams;
@@ -238,6 +247,10 @@ struct ZSTD_CCtx_params_s {
     /* Dedicated dict search algorithm trigger */
     int enableDedicatedDictSearch;
 
+    /* Internal use : set when the working tables must keep the hash chain
+     * layout, because they are built from, or searched along, a CDict */
+    int disableRowMatchFinder;
+
     /* Input/output buffer modes */
     ZSTD_bufferMode_e inBufferMode;
     ZSTD_bufferMode_e outBufferMode;
@@ -477,6 +490,19 @@ MEM_STATIC int ZSTD_disableLiteralsCompression(const ZSTD_CCtx_params* cctxParam
     }
 }
 
+/*! ZSTD_rowMatchFinderSupported() :
+ *  The row-based matchfinder replaces the hash chain for the greedy, lazy and
+ *  lazy2 strategies. Small windows keep the hash chain, which is cheaper to
+ *  reset, and so do hashLogs whose row hash would not fit in 32 bits. */
+MEM_STATIC int ZSTD_rowMatchFinderSupported(const ZSTD_compressionParameters* cParams)
+{
+    U32 const rowLog = MAX(4, MIN(cParams->searchLog, 6));
+    return (cParams->strategy >= ZSTD_greedy)
+        && (cParams->strategy <= ZSTD_lazy2)
+        && (cParams->windowLog > 14)
+        && (cParams->hashLog + ZSTD_ROW_HASH_TAG_BITS <= 32 + rowLog);
+}
+
 /*! ZSTD_safecopyLiterals() :
  *  memcpy() function that won't read beyond more than WILDCOPY_OVERLENGTH bytes past ilimit_w.
  *  Only called when the sequence ends past ilimit_w, so it only needs to be optimized for single
@@ -11,6 +11,18 @@
 #include "zstd_compress_internal.h"
 #include "zstd_lazy.h"
 
+/* SIMD tag comparison for the row-based matchfinder.
+ * The kernel does not save SIMD state, so it uses the SWAR fallback. */
+#if !defined(_KERNEL) && !defined(ZSTD_NO_INTRINSICS)
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    include <emmintrin.h>
+#    define ZSTD_ROW_SSE2 1
+#  elif defined(__ARM_NEON) && defined(__aarch64__) && defined(__LITTLE_ENDIAN__)
+#    include <arm_neon.h>
+#    define ZSTD_ROW_NEON 1
+#  endif
+#endif
+
 
 /*-*************************************
 *  Binary Tree search
@@ -846,10 +858,429 @@ FORCE_INLINE_TEMPLATE size_t ZSTD_HcFindBestMatch_extDict_selectMLS (
 }
 
 
+/* *********************************
+*  Row-based matchfinder
+***********************************/
+/* The hashTable is split into rows of 16, 32 or 64 entries (rowLog 4 to 6,
+ * following searchLog). The row index is taken from the high bits of the
+ * hash, and a tagTable mirrors the hashTable with one byte per entry, holding
+ * the low ZSTD_ROW_HASH_TAG_BITS of the hash of that entry.
+ * Byte 0 of each tag row is not a tag : it is the "head" of the row, which is
+ * used as a circular buffer, newest entry first.
+ * A search compares the tag of the current position against the whole tag
+ * row at once (SSE2, NEON, or SWAR), and only dereferences the candidates
+ * whose tag matches, instead of walking a hash chain through memory. */
+
+#define ZSTD_ROW_HASH_TAG_MASK ((1u << ZSTD_ROW_HASH_TAG_BITS) - 1)
+#define ZSTD_ROW_HASH_MAX_ENTRIES 64    /* absolute maximum number of entries per row, for all configurations */
+#define ZSTD_ROW_HASH_CACHE_MASK (ZSTD_ROW_HASH_CACHE_SIZE - 1)
+
+typedef U64 ZSTD_VecMask;   /* one bit per row entry */
+
+/* ZSTD_VecMask_next() :
+ * @return the index of the lowest bit set in val, which must be != 0 */
+static U32 ZSTD_VecMask_next(ZSTD_VecMask val)
+{
+    assert(val != 0);
+#   if defined(_MSC_VER) && defined(_WIN64)
+    {   unsigned long r = 0;
+        _BitScanForward64(&r, val);
+        return (U32)r;
+    }
+#   elif defined(__GNUC__) && (__GNUC__ >= 4)
+    return (U32)__builtin_ctzll(val);
+#   else
+    {   U32 n = 0;
+        while (!(val & 1)) { val >>= 1; n++; }
+        return n;
+    }
+#   endif
+}
+
+static U64 ZSTD_row_rotateRight64(U64 const value, U32 count)
+{
+    assert(count < 64);
+    count &= 0x3F;   /* for pattern recognition */
+    return (value >> count) | (U64)(value << ((0U - count) & 0x3F));
+}
+
+static U32 ZSTD_row_rotateRight32(U32 const value, U32 count)
+{
+    assert(count < 32);
+    count &= 0x1F;
+    return (value >> count) | (U32)(value << ((0U - count) & 0x1F));
+}
+
+static U16 ZSTD_row_rotateRight16(U16 const value, U32 count)
+{
+    assert(count < 16);
+    count &= 0x0F;
+    return (U16)((value >> count) | (U16)(value << ((0U - count) & 0x0F)));
+}
+
+/* ZSTD_row_nextIndex() :
+ * @return the next position to insert at within a row, and updates the head
+ * of the row. Cycles backwards through [1, rowEntries), skipping position 0,
+ * which holds the head itself. */
+FORCE_INLINE_TEMPLATE U32 ZSTD_row_nextIndex(BYTE* const tagRow, U32 const rowMask)
+{
+    U32 next = (*tagRow - 1) & rowMask;
+    next += (next == 0) ? rowMask : 0;
+    *tagRow = (BYTE)next;
+    return next;
+}
+
+FORCE_INLINE_TEMPLATE void ZSTD_row_prefetch(U32 const* hashTable, BYTE const* tagTable, U32 const relRow, U32 const rowLog)
+{
+    PREFETCH_L1(hashTable + relRow);
+    if (rowLog >= 5) {
+        PREFETCH_L1(hashTable + relRow + 16);
+    }
+    PREFETCH_L1(tagTable + relRow);
+    if (rowLog == 6) {
+        PREFETCH_L1(tagTable + relRow + 32);
+    }
+}
+
+/* ZSTD_row_fillHashCache() :
+ * Fills the hash cache with the hashes of positions idx onwards (at most
+ * ZSTD_ROW_HASH_CACHE_SIZE of them, and none beyond iLimit), prefetching
+ * the rows they will be inserted into. */
+FORCE_INLINE_TEMPLATE void ZSTD_row_fillHashCache(ZSTD_matchState_t* ms, const BYTE* base,
+                                   U32 const rowLog, U32 const mls,
+                                   U32 idx, const BYTE* const iLimit)
+{
+    U32 const* const hashTable = ms->hashTable;
+    BYTE const* const tagTable = ms->tagTable;
+    U32 const hashLog = ms->rowHashLog;
+    U32 const maxElemsToPrefetch = (base + idx) > iLimit ? 0 : (U32)(iLimit - (base + idx) + 1);
+    U32 const lim = idx + MIN(ZSTD_ROW_HASH_CACHE_SIZE, maxElemsToPrefetch);
+
+    for (; idx < lim; ++idx) {
+        U32 const hash = (U32)ZSTD_hashPtr(base + idx, hashLog + ZSTD_ROW_HASH_TAG_BITS, mls);
+        U32 const row = (hash >> ZSTD_ROW_HASH_TAG_BITS) << rowLog;
+        ZSTD_row_prefetch(hashTable, tagTable, row, rowLog);
+        ms->hashCache[idx & ZSTD_ROW_HASH_CACHE_MASK] = hash;
+    }
+}
+
+/* ZSTD_row_nextCachedHash() :
+ * @return the hash of base + idx, taken from the cache, which is refilled
+ * with the hash of base + idx + ZSTD_ROW_HASH_CACHE_SIZE. */
+FORCE_INLINE_TEMPLATE U32 ZSTD_row_nextCachedHash(U32* cache, U32 const* hashTable,
+                                                  BYTE const* tagTable, BYTE const* base,
+                                                  U32 idx, U32 const hashLog,
+                                                  U32 const rowLog, U32 const mls)
+{
+    U32 const newHash = (U32)ZSTD_hashPtr(base+idx+ZSTD_ROW_HASH_CACHE_SIZE, hashLog + ZSTD_ROW_HASH_TAG_BITS, mls);
+    U32 const row = (newHash >> ZSTD_ROW_HASH_TAG_BITS) << rowLog;
+    ZSTD_row_prefetch(hashTable, tagTable, row, rowLog);
+    {   U32 const hash = cache[idx & ZSTD_ROW_HASH_CACHE_MASK];
+        cache[idx & ZSTD_ROW_HASH_CACHE_MASK] = newHash;
+        return hash;
+    }
+}
+
+/* ZSTD_row_update_internal() :
+ * Inserts positions from ms->nextToUpdate up to (but excluding) ip.
+ * When using the hash cache, i.e. while compressing, only the beginning and
+ * the end of long skipped sections (typically long matches) are inserted. */
+FORCE_INLINE_TEMPLATE void ZSTD_row_update_internal(ZSTD_matchState_t* ms, const BYTE* ip,
+                                                    U32 const mls, U32 const rowLog,
+                                                    U32 const rowMask, U32 const useCache)
+{
+    U32* const hashTable = ms->hashTable;
+    BYTE* const tagTable = ms->tagTable;
+    U32 const hashLog = ms->rowHashLog;
+    const BYTE* const base = ms->window.base;
+    const U32 target = (U32)(ip - base);
+    U32 idx = ms->nextToUpdate;
+    U32 const kSkipThreshold = 384;
+    U32 const kMaxMatchStartPositionsToUpdate = 96;
+    U32 const kMaxMatchEndPositionsToUpdate = 32;
+    U32 bound = target;
+
+    assert(target >= idx);
+    if (useCache && (target - idx > kSkipThreshold))
+        bound = idx + kMaxMatchStartPositionsToUpdate;
+
+    for (;;) {
+        for (; idx < bound; ++idx) {
+            U32 const hash = useCache ? ZSTD_row_nextCachedHash(ms->hashCache, hashTable, tagTable, base, idx, hashLog, rowLog, mls)
+                                      : (U32)ZSTD_hashPtr(base + idx, hashLog + ZSTD_ROW_HASH_TAG_BITS, mls);
+            U32 const relRow = (hash >> ZSTD_ROW_HASH_TAG_BITS) << rowLog;
+            U32* const row = hashTable + relRow;
+            BYTE* const tagRow = tagTable + relRow;
+            U32 const pos = ZSTD_row_nextIndex(tagRow, rowMask);
+
+            assert(hash == ZSTD_hashPtr(base + idx, hashLog + ZSTD_ROW_HASH_TAG_BITS, mls));
+            tagRow[pos] = (BYTE)(hash & ZSTD_ROW_HASH_TAG_MASK);
+            row[pos] = idx;
+        }
+        if (bound == target) break;
+        idx = target - kMaxMatchEndPositionsToUpdate;
+        ZSTD_row_fillHashCache(ms, base, rowLog, mls, idx, ip+1);
+        bound = target;
+    }
+    ms->nextToUpdate = target;
+}
+
+/* ZSTD_row_update() :
+ * Fills the row hash table up to ip, without the hash cache.
+ * Used when loading a dictionary. */
+void ZSTD_row_update(ZSTD_matchState_t* const ms, const BYTE* ip)
+{
+    U32 const rowLog = MAX(4, MIN(ms->cParams.searchLog, 6));
+    U32 const rowMask = (1u << rowLog) - 1;
+    U32 const mls = MIN(MAX(ms->cParams.minMatch, 4), 6);
+
+    DEBUGLOG(5, "ZSTD_row_update(), rowLog=%u", rowLog);
+    assert(ms->useRowMatchFinder);
+    ZSTD_row_update_internal(ms, ip, mls, rowLog, rowMask, 0 /* don't use cache */);
+}
+
+/* ZSTD_row_getMatchMask() :
+ * @return a mask with bit n set when the tag at position (head + n) of the
+ * row equals tag, i.e. candidates ordered from the most recent one. */
+FORCE_INLINE_TEMPLATE ZSTD_VecMask
+ZSTD_row_getMatchMask(const BYTE* const tagRow, const BYTE tag, const U32 head, const U32 rowEntries)
+{
+    const BYTE* const src = tagRow;
+    assert((rowEntries == 16) || (rowEntries == 32) || (rowEntries == 64));
+    assert(rowEntries <= ZSTD_ROW_HASH_MAX_ENTRIES);
+
+#if defined(ZSTD_ROW_SSE2)
+    {   const __m128i comparisonMask = _mm_set1_epi8((char)tag);
+        U32 const nbChunks = rowEntries / 16;
+        U64 matches = 0;
+        U32 i;
+        for (i = 0; i < nbChunks; i++) {
+            const __m128i chunk = _mm_loadu_si128((const __m128i*)(const void*)(src + 16*i));
+            const __m128i equalMask = _mm_cmpeq_epi8(chunk, comparisonMask);
+            matches |= (U64)(U32)_mm_movemask_epi8(equalMask) << (16*i);
+        }
+        if (rowEntries == 16) return ZSTD_row_rotateRight16((U16)matches, head);
+        if (rowEntries == 32) return ZSTD_row_rotateRight32((U32)matches, head);
+        return ZSTD_row_rotateRight64(matches, head);
+    }
+#elif defined(ZSTD_ROW_NEON)
+    {   static const BYTE kBitWeights[16] = { 1, 2, 4, 8, 16, 32, 64, 128,
+                                              1, 2, 4, 8, 16, 32, 64, 128 };
+        const uint8x16_t weights = vld1q_u8(kBitWeights);
+        const uint8x16_t dup = vdupq_n_u8(tag);
+        U32 const nbChunks = rowEntries / 16;
+        U64 matches = 0;
+        U32 i;
+        for (i = 0; i < nbChunks; i++) {
+            const uint8x16_t chunk = vld1q_u8(src + 16*i);
+            const uint8x16_t equalMask = vandq_u8(vceqq_u8(chunk, dup), weights);
+            U32 const lo = vaddv_u8(vget_low_u8(equalMask));
+            U32 const hi = vaddv_u8(vget_high_u8(equalMask));
+            matches |= (U64)(lo | (hi << 8)) << (16*i);
+        }
+        if (rowEntries == 16) return ZSTD_row_rotateRight16((U16)matches, head);
+        if (rowEntries == 32) return ZSTD_row_rotateRight32((U32)matches, head);
+        return ZSTD_row_rotateRight64(matches, head);
+    }
+#else
+    /* SWAR */
+    {   const int chunkSize = sizeof(size_t);
+        const size_t shiftAmount = ((chunkSize * 8) - chunkSize);
+        const size_t xFF = ~((size_t)0);
+        const size_t x01 = xFF / 0xFF;
+        const size_t x80 = x01 << 7;
+        const size_t splatChar = tag * x01;
+        ZSTD_VecMask matches = 0;
+        int i = rowEntries - chunkSize;
+        assert((sizeof(size_t) == 4) || (sizeof(size_t) == 8));
+        if (MEM_isLittleEndian()) { /* runtime check so have two loops */
+            const size_t extractMagic = (xFF / 0x7F) >> chunkSize;
+            do {
+                size_t chunk = MEM_readST(&src[i]);
+                chunk ^= splatChar;
+                chunk = (((chunk | x80) - x01) | chunk) & x80;
+                matches <<= chunkSize;
+                matches |= (chunk * extractMagic) >> shiftAmount;
+                i -= chunkSize;
+            } while (i >= 0);
+        } else { /* big endian: reverse bits during extraction */
+            const size_t msb = xFF ^ (xFF >> 1);
+            const size_t extractMagic = (msb / 0x1FF) | msb;
+            do {
+                size_t chunk = MEM_readST(&src[i]);
+                chunk ^= splatChar;
+                chunk = (((chunk | x80) - x01) | chunk) & x80;
+                matches <<= chunkSize;
+                matches |= ((chunk >> 7) * extractMagic) >> shiftAmount;
+                i -= chunkSize;
+            } while (i >= 0);
+        }
+        matches = ~matches;
+        if (rowEntries == 16) return ZSTD_row_rotateRight16((U16)matches, head);
+        if (rowEntries == 32) return ZSTD_row_rotateRight32((U32)matches, head);
+        return ZSTD_row_rotateRight64(matches, head);
+    }
+#endif
+}
+
+/* inlining is important to hardwire a hot branch (template emulation) */
+FORCE_INLINE_TEMPLATE
+size_t ZSTD_RowFindBestMatch_generic (
+                        ZSTD_matchState_t* ms,
+                        const BYTE* const ip, const BYTE* const iLimit,
+                        size_t* offsetPtr,
+                        const U32 mls, const ZSTD_dictMode_e dictMode,
+                        const U32 rowLog)
+{
+    U32* const hashTable = ms->hashTable;
+    BYTE* const tagTable = ms->tagTable;
+    U32* const hashCache = ms->hashCache;
+    const U32 hashLog = ms->rowHashLog;
+    const ZSTD_compressionParameters* const cParams = &ms->cParams;
+    const BYTE* const base = ms->window.base;
+    const BYTE* const dictBase = ms->window.dictBase;
+    const U32 dictLimit = ms->window.dictLimit;
+    const BYTE* const prefixStart = base + dictLimit;
+    const BYTE* const dictEnd = dictBase + dictLimit;
+    const U32 curr = (U32)(ip-base);
+    const U32 maxDistance = 1U << cParams->windowLog;
+    const U32 lowestValid = ms->window.lowLimit;
+    const U32 withinMaxDistance = (curr - lowestValid > maxDistance) ? curr - maxDistance : lowestValid;
+    const U32 isDictionary = (ms->loadedDictEnd != 0);
+    const U32 lowLimit = isDictionary ? lowestValid : withinMaxDistance;
+    const U32 rowEntries = (1U << rowLog);
+    const U32 rowMask = rowEntries - 1;
+    const U32 cappedSearchLog = MIN(cParams->searchLog, rowLog); /* nb of searches is capped at nb entries per row */
+    U32 nbAttempts = 1U << cappedSearchLog;
+    size_t ml=4-1;
+
+    assert(dictMode == ZSTD_noDict || dictMode == ZSTD_extDict);
+    assert(ms->useRowMatchFinder);
+
+    /* Update the hashTable and tagTable up to (but not including) ip */
+    ZSTD_row_update_internal(ms, ip, mls, rowLog, rowMask, 1 /* useCache */);
+
+    {   /* Get the hash for ip, compute the appropriate row */
+        U32 const hash = ZSTD_row_nextCachedHash(hashCache, hashTable, tagTable, base, curr, hashLog, rowLog, mls);
+        U32 const relRow = (hash >> ZSTD_ROW_HASH_TAG_BITS) << rowLog;
+        U32 const tag = hash & ZSTD_ROW_HASH_TAG_MASK;
+        U32* const row = hashTable + relRow;
+        BYTE* const tagRow = tagTable + relRow;
+        U32 const head = *tagRow & rowMask;
+        U32 matchBuffer[ZSTD_ROW_HASH_MAX_ENTRIES];
+        size_t numMatches = 0;
+        size_t currMatch = 0;
+        ZSTD_VecMask matches = ZSTD_row_getMatchMask(tagRow, (BYTE)tag, head, rowEntries);
+
+        /* Cycle through the matches and prefetch */
+        for (; (matches > 0) && (nbAttempts > 0); matches &= (matches - 1)) {
+            U32 const matchPos = (head + ZSTD_VecMask_next(matches)) & rowMask;
+            U32 const matchIndex = row[matchPos];
+            if (matchPos == 0) continue;   /* the head, not a tag */
+            assert(numMatches < rowEntries);
+            if (matchIndex < lowLimit)
+                break;
+            if ((dictMode != ZSTD_extDict) || matchIndex >= dictLimit) {
+                PREFETCH_L1(base + matchIndex);
+            } else {
+                PREFETCH_L1(dictBase + matchIndex);
+            }
+            matchBuffer[numMatches++] = matchIndex;
+            --nbAttempts;
+        }
+
+        /* Speed opt : insert current position into the row too. This saves
+         * one iteration of ZSTD_row_update_internal() at the next search. */
+        {   U32 const pos = ZSTD_row_nextIndex(tagRow, rowMask);
+            tagRow[pos] = (BYTE)tag;
+            row[pos] = ms->nextToUpdate++;
+        }
+
+        /* Return the longest match */
+        for (; currMatch < numMatches; ++currMatch) {
+            U32 const matchIndex = matchBuffer[currMatch];
+            size_t currentMl=0;
+            assert(matchIndex < curr);
+            assert(matchIndex >= lowLimit);
+
+            if ((dictMode != ZSTD_extDict) || matchIndex >= dictLimit) {
+                const BYTE* const match = base + matchIndex;
+                assert(matchIndex >= dictLimit);   /* ensures this is true if dictMode != ZSTD_extDict */
+                /* read 4B starting from (match + ml + 1 - sizeof(U32)) */
+                if (MEM_read32(match + ml - 3) == MEM_read32(ip + ml - 3))   /* potentially better */
+                    currentMl = ZSTD_count(ip, match, iLimit);
+            } else {
+                const BYTE* const match = dictBase + matchIndex;
+                assert(match+4 <= dictEnd);
+                if (MEM_read32(match) == MEM_read32(ip))   /* assumption : matchIndex <= dictLimit-4 (by table construction) */
+                    currentMl = ZSTD_count_2segments(ip+4, match+4, iLimit, dictEnd, prefixStart) + 4;
+            }
+
+            /* save best solution */
+            if (currentMl > ml) {
+                ml = currentMl;
+                *offsetPtr = curr - matchIndex + ZSTD_REP_MOVE;
+                if (ip+currentMl == iLimit) break; /* best possible, avoids read overflow on next attempt */
+            }
+        }
+    }
+
+    return ml;
+}
+
+
+FORCE_INLINE_TEMPLATE size_t ZSTD_RowFindBestMatch_selectRowLog (
+                        ZSTD_matchState_t* ms,
+                        const BYTE* ip, const BYTE* const iLimit,
+                        size_t* offsetPtr,
+                        const U32 mls, const ZSTD_dictMode_e dictMode)
+{
+    switch(MIN(ms->cParams.searchLog, 6))
+    {
+    default : /* includes searchLog < 4 */
+    case 4 : return ZSTD_RowFindBestMatch_generic(ms, ip, iLimit, offsetPtr, mls, dictMode, 4);
+    case 5 : return ZSTD_RowFindBestMatch_generic(ms, ip, iLimit, offsetPtr, mls, dictMode, 5);
+    case 6 : return ZSTD_RowFindBestMatch_generic(ms, ip, iLimit, offsetPtr, mls, dictMode, 6);
+    }
+}
+
+
+static size_t ZSTD_RowFindBestMatch_selectMLS (
+                        ZSTD_matchState_t* ms,
+                        const BYTE* ip, const BYTE* const iLimit,
+                        size_t* offsetPtr)
+{
+    switch(ms->cParams.minMatch)
+    {
+    default : /* includes case 3 */
+    case 4 : return ZSTD_RowFindBestMatch_selectRowLog(ms, ip, iLimit, offsetPtr, 4, ZSTD_noDict);
+    case 5 : return ZSTD_RowFindBestMatch_selectRowLog(ms, ip, iLimit, offsetPtr, 5, ZSTD_noDict);
+    case 7 :
+    case 6 : return ZSTD_RowFindBestMatch_selectRowLog(ms, ip, iLimit, offsetPtr, 6, ZSTD_noDict);
+    }
+}
+
+
+static size_t ZSTD_RowFindBestMatch_extDict_selectMLS (
+                        ZSTD_matchState_t* ms,
+                        const BYTE* ip, const BYTE* const iLimit,
+                        size_t* offsetPtr)
+{
+    switch(ms->cParams.minMatch)
+    {
+    default : /* includes case 3 */
+    case 4 : return ZSTD_RowFindBestMatch_selectRowLog(ms, ip, iLimit, offsetPtr, 4, ZSTD_extDict);
+    case 5 : return ZSTD_RowFindBestMatch_selectRowLog(ms, ip, iLimit, offsetPtr, 5, ZSTD_extDict);
+    case 7 :
+    case 6 : return ZSTD_RowFindBestMatch_selectRowLog(ms, ip, iLimit, offsetPtr, 6, ZSTD_extDict);
+    }
+}
+
+
 /* *******************************
 *  Common parser - lazy strategy
 *********************************/
-typedef enum { search_hashChain, search_binaryTree } searchMethod_e;
+typedef enum { search_hashChain, search_binaryTree, search_rowHash } searchMethod_e;
 
 FORCE_INLINE_TEMPLATE size_t
 ZSTD_compressBlock_lazy_generic(
@@ -863,7 +1294,7 @@ ZSTD_compressBlock_lazy_generic(
     const BYTE* ip = istart;
     const BYTE* anchor = istart;
     const BYTE* const iend = istart + srcSize;
-    const BYTE* const ilimit = iend - 8;
+    const BYTE* const ilimit = (searchMethod == search_rowHash) ? iend - 8 - ZSTD_ROW_HASH_CACHE_SIZE : iend - 8;
     const BYTE* const base = ms->window.base;
     const U32 prefixLowestIndex = ms->window.dictLimit;
     const BYTE* const prefixLowest = base + prefixLowestIndex;
@@ -874,30 +1305,35 @@ ZSTD_compressBlock_lazy_generic(
 
     /**
      * This table is indexed first by the four ZSTD_dictMode_e values, and then
-     * by the two searchMethod_e values. NULLs are placed for configurations
+     * by the three searchMethod_e values. NULLs are placed for configurations
      * that should never occur (extDict modes go to the other implementation
-     * below and there is no DDSS for binary tree search yet).
+     * below, there is no DDSS for binary tree search yet, and contexts with
+     * an attached dictionary don't use the row-based matchfinder).
      */
-    const searchMax_f searchFuncs[4][2] = {
+    const searchMax_f searchFuncs[4][3] = {
         {
             ZSTD_HcFindBestMatch_selectMLS,
-            ZSTD_BtFindBestMatch_selectMLS
+            ZSTD_BtFindBestMatch_selectMLS,
+            ZSTD_RowFindBestMatch_selectMLS
         },
         {
+            NULL,
             NULL,
             NULL
         },
         {
             ZSTD_HcFindBestMatch_dictMatchState_selectMLS,
-            ZSTD_BtFindBestMatch_dictMatchState_selectMLS
+            ZSTD_BtFindBestMatch_dictMatchState_selectMLS,
+            NULL
         },
         {
             ZSTD_HcFindBestMatch_dedicatedDictSearch_selectMLS,
+            NULL,
             NULL
         }
     };
 
-    searchMax_f const searchMax = searchFuncs[dictMode][searchMethod == search_binaryTree];
+    searchMax_f const searchMax = searchFuncs[dictMode][searchMethod];
     U32 offset_1 = rep[0], offset_2 = rep[1], savedOffset=0;
 
     const int isDMS = dictMode == ZSTD_dictMatchState;
@@ -933,6 +1369,12 @@ ZSTD_compressBlock_lazy_generic(
         assert(offset_2 <= dictAndPrefixLength);
     }
 
+    if (searchMethod == search_rowHash) {
+        ZSTD_row_fillHashCache(ms, base, MAX(4, MIN(ms->cParams.searchLog, 6)),
+                               MIN(MAX(ms->cParams.minMatch, 4), 6),
+                               ms->nextToUpdate, ilimit);
+    }
+
     /* Match Loop */
 #if defined(__GNUC__) && defined(__x86_64__)
     /* I've measured random a 5% speed loss on levels 5 & 6 (greedy) when the
@@ -1131,6 +1573,8 @@ size_t ZSTD_compressBlock_lazy2(
         ZSTD_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD_REP_NUM],
         void const* src, size_t srcSize)
 {
+    if (ms->useRowMatchFinder)
+        return ZSTD_compressBlock_lazy_generic(ms, seqStore, rep, src, srcSize, search_rowHash, 2, ZSTD_noDict);
     return ZSTD_compressBlock_lazy_generic(ms, seqStore, rep, src, srcSize, search_hashChain, 2, ZSTD_noDict);
 }
 
@@ -1138,6 +1582,8 @@ size_t ZSTD_compressBlock_lazy(
         ZSTD_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD_REP_NUM],
         void const* src, size_t srcSize)
 {
+    if (ms->useRowMatchFinder)
+        return ZSTD_compressBlock_lazy_generic(ms, seqStore, rep, src, srcSize, search_rowHash, 1, ZSTD_noDict);
     return ZSTD_compressBlock_lazy_generic(ms, seqStore, rep, src, srcSize, search_hashChain, 1, ZSTD_noDict);
 }
 
@@ -1145,6 +1591,8 @@ size_t ZSTD_compressBlock_greedy(
         ZSTD_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD_REP_NUM],
         void const* src, size_t srcSize)
 {
+    if (ms->useRowMatchFinder)
+        return ZSTD_compressBlock_lazy_generic(ms, seqStore, rep, src, srcSize, search_rowHash, 0, ZSTD_noDict);
     return ZSTD_compressBlock_lazy_generic(ms, seqStore, rep, src, srcSize, search_hashChain, 0, ZSTD_noDict);
 }
 
@@ -1210,7 +1658,7 @@ size_t ZSTD_compressBlock_lazy_extDict_generic(
     const BYTE* ip = istart;
     const BYTE* anchor = istart;
     const BYTE* const iend = istart + srcSize;
-    const BYTE* const ilimit = iend - 8;
+    const BYTE* const ilimit = (searchMethod == search_rowHash) ? iend - 8 - ZSTD_ROW_HASH_CACHE_SIZE : iend - 8;
     const BYTE* const base = ms->window.base;
     const U32 dictLimit = ms->window.dictLimit;
     const BYTE* const prefixStart = base + dictLimit;
@@ -1222,7 +1670,9 @@ size_t ZSTD_compressBlock_lazy_extDict_generic(
     typedef size_t (*searchMax_f)(
                         ZSTD_matchState_t* ms,
                         const BYTE* ip, const BYTE* iLimit, size_t* offsetPtr);
-    searchMax_f searchMax = searchMethod==search_binaryTree ? ZSTD_BtFindBestMatch_extDict_selectMLS : ZSTD_HcFindBestMatch_extDict_selectMLS;
+    searchMax_f searchMax = searchMethod==search_binaryTree ? ZSTD_BtFindBestMatch_extDict_selectMLS
+                          : searchMethod==search_rowHash ? ZSTD_RowFindBestMatch_extDict_selectMLS
+                          : ZSTD_HcFindBestMatch_extDict_selectMLS;
 
     U32 offset_1 = rep[0], offset_2 = rep[1];
 
@@ -1230,6 +1680,11 @@ size_t ZSTD_compressBlock_lazy_extDict_generic(
 
     /* init */
     ip += (ip == prefixStart);
+    if (searchMethod == search_rowHash) {
+        ZSTD_row_fillHashCache(ms, base, MAX(4, MIN(ms->cParams.searchLog, 6)),
+                               MIN(MAX(ms->cParams.minMatch, 4), 6),
+                               ms->nextToUpdate, ilimit);
+    }
 
     /* Match Loop */
 #if defined(__GNUC__) && defined(__x86_64__)
@@ -1384,6 +1839,8 @@ size_t ZSTD_compressBlock_greedy_extDict(
         ZSTD_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD_REP_NUM],
         void const* src, size_t srcSize)
 {
+    if (ms->useRowMatchFinder)
+        return ZSTD_compressBlock_lazy_extDict_generic(ms, seqStore, rep, src, srcSize, search_rowHash, 0);
     return ZSTD_compressBlock_lazy_extDict_generic(ms, seqStore, rep, src, srcSize, search_hashChain, 0);
 }
 
@@ -1392,6 +1849,8 @@ size_t ZSTD_compressBlock_lazy_extDict(
         void const* src, size_t srcSize)
 
 {
+    if (ms->useRowMatchFinder)
+        return ZSTD_compressBlock_lazy_extDict_generic(ms, seqStore, rep, src, srcSize, search_rowHash, 1);
     return ZSTD_compressBlock_lazy_extDict_generic(ms, seqStore, rep, src, srcSize, search_hashChain, 1);
 }
 
@@ -1400,6 +1859,8 @@ size_t ZSTD_compressBlock_lazy2_extDict(
         void const* src, size_t srcSize)
 
 {
+    if (ms->useRowMatchFinder)
+        return ZSTD_compressBlock_lazy_extDict_generic(ms, seqStore, rep, src, srcSize, search_rowHash, 2);
     return ZSTD_compressBlock_lazy_extDict_generic(ms, seqStore, rep, src, srcSize, search_hashChain, 2);
 }
 
@@ -36,6 +36,7 @@
 #include "datagen.h"     /* RDG_genBuffer */
 #include "../lib/common/xxhash.h"
 #include "benchzstd.h"
+#include "fileio.h"      /* FIO_compressFilename, FIO_decompressFilename */
 #include "../lib/common/zstd_errors.h"
 
 
@@ -886,3 +887,147 @@ BMK_benchOutcome_t BMK_benchFiles(
     BMK_advancedParams_t const adv = BMK_initAdvancedParams();
     return BMK_benchFilesAdvanced(fileNamesTable, nbFiles, dictFileName, cLevel, compressionParams, displayLevel, &adv);
 }
+
+
+/* ===  End-to-end file benchmark  === */
+
+#define BMK_IO_SUFFIX ".bmkio"
+
+static char* BMK_IO_tmpName(const char* srcName, const char* suffix)
+{
+    size_t const srcLen = strlen(srcName);
+    size_t const sfxLen = strlen(suffix);
+    char* const name = (char*)malloc(srcLen + sfxLen + 1);
+    if (name == NULL) return NULL;
+    memcpy(name, srcName, srcLen);
+    memcpy(name + srcLen, suffix, sfxLen + 1);
+    return name;
+}
+
+/* BMK_IO_pass() :
+ * compresses each srcNames[n] into cNames[n],
+ * or decompresses each cNames[n] into dNames[n], through fileio.
+ * @return : elapsed wall-clock time in nanoseconds, or 0 on error */
+static U64 BMK_IO_pass(FIO_prefs_t* prefs,
+                       const char* const * srcNames, char* const * cNames, char* const * dNames,
+                       unsigned nbFiles, const char* dictFileName,
+                       int cLevel, ZSTD_compressionParameters cParams, int decompress)
+{
+    UTIL_time_t const clockStart = UTIL_getTime();
+    unsigned n;
+    for (n = 0; n < nbFiles; n++) {
+        FIO_ctx_t* const fCtx = FIO_createContext();
+        int const error = decompress ?
+            FIO_decompressFilename(fCtx, prefs, dNames[n], cNames[n], dictFileName) :
+            FIO_compressFilename(fCtx, prefs, cNames[n], srcNames[n], dictFileName, cLevel, cParams);
+        FIO_freeContext(fCtx);
+        if (error) return 0;
+    }
+    {   U64 const elapsed = UTIL_clockSpanNano(clockStart);
+        return elapsed ? elapsed : 1;
+    }
+}
+
+BMK_benchOutcome_t BMK_benchFilesIO(
+                        const char* const * fileNamesTable, unsigned nbFiles,
+                        const char* dictFileName, int cLevel,
+                        const ZSTD_compressionParameters* compressionParams,
+                        int displayLevel, const BMK_advancedParams_t* adv)
+{
+    static const char* const modeNames[2] = { "sync I/O", "async I/O" };
+#ifdef ZSTD_MULTITHREAD
+    int const lastMode = 1;
+#else
+    int const lastMode = 0;
+#endif
+    U64 const totalSize = UTIL_getTotalFileSize(fileNamesTable, nbFiles);
+    BMK_benchResult_t benchResult;
+    char** cNames = NULL;
+    char** dNames = NULL;
+    FIO_prefs_t* prefs = NULL;
+    const char* displayName;
+    char mfName[20] = {0};
+    int errorNum = 0;
+    int asyncIO;
+    unsigned n;
+
+    memset(&benchResult, 0, sizeof(benchResult));
+    if (!nbFiles) {
+        RETURN_ERROR(14, BMK_benchOutcome_t, "No Files to Benchmark");
+    }
+    if (cLevel > ZSTD_maxCLevel()) {
+        RETURN_ERROR(15, BMK_benchOutcome_t, "Invalid Compression Level");
+    }
+    if (totalSize == UTIL_FILESIZE_UNKNOWN || totalSize == 0) {
+        RETURN_ERROR(32, BMK_benchOutcome_t, "Impossible to determine original size ");
+    }
+    snprintf(mfName, sizeof(mfName), " %u files", nbFiles);
+    displayName = (nbFiles > 1) ? mfName : fileNamesTable[0];
+    if (strlen(displayName)>17) displayName += strlen(displayName) - 17;   /* display last 17 characters */
+
+    cNames = (char**)calloc(nbFiles, sizeof(char*));
+    dNames = (char**)calloc(nbFiles, sizeof(char*));
+    if (!cNames || !dNames) { errorNum = 12; goto _cleanUp; }
+    for (n = 0; n < nbFiles; n++) {
+        cNames[n] = BMK_IO_tmpName(fileNamesTable[n], BMK_IO_SUFFIX ZSTD_EXTENSION);
+        dNames[n] = BMK_IO_tmpName(fileNamesTable[n], BMK_IO_SUFFIX);
+        if (!cNames[n] || !dNames[n]) { errorNum = 12; goto _cleanUp; }
+    }
+
+    prefs = FIO_createPreferences();
+    FIO_overwriteMode(prefs);
+    FIO_setNbWorkers(prefs, adv->nbWorkers);
+    FIO_setMemLimit(prefs, 1U << MAX(ZSTD_WINDOWLOG_LIMIT_DEFAULT, compressionParams->windowLog));
+    FIO_setNotificationLevel(displayLevel >= 4 ? displayLevel - 2 : 1);
+    FIO_setNoProgress(1);
+
+    for (asyncIO = 0; asyncIO <= lastMode; asyncIO++) {
+        U64 bestCTime = 0, bestDTime = 0, totalTime = 0, cSize = 0;
+        FIO_setAsyncIOFlag(prefs, asyncIO);
+        do {
+            U64 const cTime = BMK_IO_pass(prefs, fileNamesTable, cNames, dNames, nbFiles,
+                                          dictFileName, cLevel, *compressionParams, 0);
+            U64 const dTime = cTime ? BMK_IO_pass(prefs, fileNamesTable, cNames, dNames, nbFiles,
+                                                  dictFileName, cLevel, *compressionParams, 1) : 0;
+            if (!dTime) { errorNum = 20; goto _cleanUp; }
+            if (!bestCTime || cTime < bestCTime) bestCTime = cTime;
+            if (!bestDTime || dTime < bestDTime) bestDTime = dTime;
+            totalTime += cTime + dTime;
+            DISPLAYLEVEL(2, "%2i-%-17.17s :%10u ->  (%s) \r", cLevel, displayName, (unsigned)totalSize, modeNames[asyncIO]);
+        } while (totalTime < (U64)adv->nbSeconds * TIMELOOP_NANOSEC);
+
+        for (n = 0; n < nbFiles; n++) {
+            if (UTIL_getFileSize(dNames[n]) != UTIL_getFileSize(fileNamesTable[n])) {
+                DISPLAYLEVEL(1, "%s : decompressed size mismatch \n", dNames[n]);
+                errorNum = 21; goto _cleanUp;
+            }
+            cSize += UTIL_getFileSize(cNames[n]);
+        }
+        benchResult.cSize = (size_t)cSize;
+        benchResult.cSpeed = (U64)((double)totalSize * TIMELOOP_NANOSEC / bestCTime);
+        benchResult.dSpeed = (U64)((double)totalSize * TIMELOOP_NANOSEC / bestDTime);
+        {   double const ratio = (double)totalSize / (double)(cSize + !cSize);
+            DISPLAYLEVEL(2, "%2i#%-17.17s :%10u ->%10u (%5.3f),%6.1f MB/s ,%6.1f MB/s  (%s) \n",
+                    cLevel, displayName, (unsigned)totalSize, (unsigned)cSize, ratio,
+                    (double)benchResult.cSpeed / MB_UNIT, (double)benchResult.dSpeed / MB_UNIT,
+                    modeNames[asyncIO]);
+            if (displayLevel == 1)   /* hidden display mode -q, used by python speed benchmark */
+                DISPLAY("-%-3i%11i (%5.3f) %6.2f MB/s %6.1f MB/s  %s (%s)\n", cLevel, (int)cSize, ratio,
+                        (double)benchResult.cSpeed / MB_UNIT, (double)benchResult.dSpeed / MB_UNIT,
+                        displayName, modeNames[asyncIO]);
+        }
+    }
+
+_cleanUp:
+    for (n = 0; n < nbFiles; n++) {
+        if (cNames && cNames[n]) { remove(cNames[n]); free(cNames[n]); }
+        if (dNames && dNames[n]) { remove(dNames[n]); free(dNames[n]); }
+    }
+    free(cNames);
+    free(dNames);
+    if (prefs) FIO_freePreferences(prefs);
+    if (errorNum) {
+        RETURN_ERROR(errorNum, BMK_benchOutcome_t, "file benchmark aborted");
+    }
+    return BMK_benchOutcome_setValidResult(benchResult);
+}
@@ -131,6 +131,22 @@ BMK_benchOutcome_t BMK_benchFilesAdvanced(
                    int cLevel, const ZSTD_compressionParameters* compressionParams,
                    int displayLevel, const BMK_advancedParams_t* adv);
 
+/*! BMK_benchFilesIO() -- called by zstdcli (--bench-io) */
+/*  End-to-end variant of BMK_benchFilesAdvanced() :
+ *  instead of benchmarking in memory, each file is compressed into,
+ *  then decompressed from, a temporary file created next to it (and removed afterwards),
+ *  through the regular fileio.c path, first with synchronous I/O,
+ *  then with asynchronous I/O (when compiled with ZSTD_MULTITHREAD).
+ *  Speeds are wall-clock and include reading and writing files.
+ *  Only adv->nbSeconds and adv->nbWorkers are used.
+ * @return: see BMK_benchFiles(); valid result reflects the last mode measured.
+ */
+BMK_benchOutcome_t BMK_benchFilesIO(
+                   const char* const * fileNamesTable, unsigned nbFiles,
+                   const char* dictFileName,
+                   int cLevel, const ZSTD_compressionParameters* compressionParams,
+                   int displayLevel, const BMK_advancedParams_t* adv);
+
 /*! BMK_syntheticTest() -- called from zstdcli */
 /*  Generates a sample with datagen, using compressibility argument */
 /*  cLevel - compression level to benchmark, errors if invalid
@@ -40,6 +40,7 @@
 #endif
 
 #include "../lib/common/mem.h"     /* U32, U64 */
+#include "../lib/common/threading.h" /* ZSTD_pthread_* (only used with ZSTD_MULTITHREAD) */
 #include "fileio.h"
 
 #define ZSTD_STATIC_LINKING_ONLY   /* ZSTD_magicNumber, ZSTD_frameHeaderSize_max */
@@ -311,6 +312,7 @@ struct FIO_prefs_s {
     /* IO preferences */
     U32 removeSrcFile;
     U32 overwrite;
+    int asyncIO;   /* overlap file I/O with (de)compression using reader/writer threads */
 
     /* Computation resources preferences */
     unsigned memLimit;
@@ -379,6 +381,13 @@ FIO_prefs_t* FIO_createPreferences(void)
     ret->testMode = 0;
     ret->literalCompressionMode = ZSTD_lcm_auto;
     ret->excludeCompressedFiles = 0;
+    ret->patchFromMode = 0;
+    ret->contentSize = 1;
+#ifdef ZSTD_MULTITHREAD
+    ret->asyncIO = 1;
+#else
+    ret->asyncIO = 0;
+#endif
     return ret;
 }
 
@@ -446,6 +455,14 @@ void FIO_setNbWorkers(FIO_prefs_t* const prefs, int nbWorkers) {
 
 void FIO_setExcludeCompressedFile(FIO_prefs_t* const prefs, int excludeCompressedFiles) { prefs->excludeCompressedFiles = excludeCompressedFiles; }
 
+void FIO_setAsyncIOFlag(FIO_prefs_t* const prefs, int asyncIO) {
+#ifndef ZSTD_MULTITHREAD
+    if (asyncIO) DISPLAYLEVEL(2, "Note : asynchronous I/O is disabled (zstd compiled without multi-threading) \n");
+    asyncIO = 0;
+#endif
+    prefs->asyncIO = asyncIO;
+}
+
 void FIO_setBlockSize(FIO_prefs_t* const prefs, int blockSize) {
     if (blockSize && prefs->nbWorkers==0)
         DISPLAYLEVEL(2, "Setting block size is useless in single-thread mode \n");
@@ -879,6 +896,498 @@ static int FIO_removeMultiFilesWarning(FIO_ctx_t* const fCtx, const FIO_prefs_t*
     return error;
 }
 
+/* **********************************************************************
+ *  Asynchronous I/O
+ ************************************************************************/
+
+/** FIO_fwriteSparse() :
+*  @return : storedSkips,
+*            argument for next call to FIO_fwriteSparse() or FIO_fwriteSparseEnd() */
+static unsigned
+FIO_fwriteSparse(FILE* file,
+                 const void* buffer, size_t bufferSize,
+                 const FIO_prefs_t* const prefs,
+                 unsigned storedSkips)
+{
+    const size_t* const bufferT = (const size_t*)buffer;   /* Buffer is supposed malloc'ed, hence aligned on size_t */
+    size_t bufferSizeT = bufferSize / sizeof(size_t);
+    const size_t* const bufferTEnd = bufferT + bufferSizeT;
+    const size_t* ptrT = bufferT;
+    static const size_t segmentSizeT = (32 KB) / sizeof(size_t);   /* check every 32 KB */
+
+    if (prefs->testMode) return 0;  /* do not output anything in test mode */
+
+    if (!prefs->sparseFileSupport) {  /* normal write */
+        size_t const sizeCheck = fwrite(buffer, 1, bufferSize, file);
+        if (sizeCheck != bufferSize)
+            EXM_THROW(70, "Write error : cannot write decoded block : %s",
+                            strerror(errno));
+        return 0;
+    }
+
+    /* avoid int overflow */
+    if (storedSkips > 1 GB) {
+        if (LONG_SEEK(file, 1 GB, SEEK_CUR) != 0)
+            EXM_THROW(91, "1 GB skip error (sparse file support)");
+        storedSkips -= 1 GB;
+    }
+
+    while (ptrT < bufferTEnd) {
+        size_t nb0T;
+
+        /* adjust last segment if < 32 KB */
+        size_t seg0SizeT = segmentSizeT;
+        if (seg0SizeT > bufferSizeT) seg0SizeT = bufferSizeT;
+        bufferSizeT -= seg0SizeT;
+
+        /* count leading zeroes */
+        for (nb0T=0; (nb0T < seg0SizeT) && (ptrT[nb0T] == 0); nb0T++) ;
+        storedSkips += (unsigned)(nb0T * sizeof(size_t));
+
+        if (nb0T != seg0SizeT) {   /* not all 0s */
+            size_t const nbNon0ST = seg0SizeT - nb0T;
+            /* skip leading zeros */
+            if (LONG_SEEK(file, storedSkips, SEEK_CUR) != 0)
+                EXM_THROW(92, "Sparse skip error ; try --no-sparse");
+            storedSkips = 0;
+            /* write the rest */
+            if (fwrite(ptrT + nb0T, sizeof(size_t), nbNon0ST, file) != nbNon0ST)
+                EXM_THROW(93, "Write error : cannot write decoded block : %s",
+                            strerror(errno));
+        }
+        ptrT += seg0SizeT;
+    }
+
+    {   static size_t const maskT = sizeof(size_t)-1;
+        if (bufferSize & maskT) {
+            /* size not multiple of sizeof(size_t) : implies end of block */
+            const char* const restStart = (const char*)bufferTEnd;
+            const char* restPtr = restStart;
+            const char* const restEnd = (const char*)buffer + bufferSize;
+            assert(restEnd > restStart && restEnd < restStart + sizeof(size_t));
+            for ( ; (restPtr < restEnd) && (*restPtr == 0); restPtr++) ;
+            storedSkips += (unsigned) (restPtr - restStart);
+            if (restPtr != restEnd) {
+                /* not all remaining bytes are 0 */
+                size_t const restSize = (size_t)(restEnd - restPtr);
+                if (LONG_SEEK(file, storedSkips, SEEK_CUR) != 0)
+                    EXM_THROW(92, "Sparse skip error ; try --no-sparse");
+                if (fwrite(restPtr, 1, restSize, file) != restSize)
+                    EXM_THROW(95, "Write error : cannot write end of decoded block : %s",
+                        strerror(errno));
+                storedSkips = 0;
+    }   }   }
+
+    return storedSkips;
+}
+
+static void
+FIO_fwriteSparseEnd(const FIO_prefs_t* const prefs, FILE* file, unsigned storedSkips)
+{
+    if (prefs->testMode) assert(storedSkips == 0);
+    if (storedSkips>0) {
+        assert(prefs->sparseFileSupport > 0);  /* storedSkips>0 implies sparse support is enabled */
+        (void)prefs;   /* assert can be disabled, in which case prefs becomes unused */
+        if (LONG_SEEK(file, storedSkips-1, SEEK_CUR) != 0)
+            EXM_THROW(69, "Final skip error (sparse file support)");
+        /* last zero must be explicitly written,
+         * so that skipped ones get implicitly translated as zero by FS */
+        {   const char lastZeroByte[1] = { 0 };
+            if (fwrite(lastZeroByte, 1, 1, file) != 1)
+                EXM_THROW(69, "Write error : cannot write last zero : %s", strerror(errno));
+    }   }
+}
+
+
+/* Source and destination files are accessed through a read pool and a
+ * write pool.  With asyncIO enabled, each pool owns one thread cycling
+ * through a ring of AIO_NB_BUFFERS buffers: the reader keeps the ring
+ * filled ahead of the consumer, and the writer drains buffers handed to it
+ * (including sparse-file detection) while the caller keeps producing.
+ * Otherwise, every operation runs synchronously in the caller. */
+
+#define AIO_NB_BUFFERS 8   /* per pool; must be a power of 2 */
+
+typedef struct {
+    void*  buffer;
+    size_t size;   /* nb of bytes used within buffer */
+} AIO_buffer_t;
+
+typedef struct {
+    const FIO_prefs_t* prefs;
+    int threaded;
+    int sparse;      /* route writes through FIO_fwriteSparse() (decompression) */
+    FILE* file;
+    size_t bufferSize;
+    unsigned nbBuffers;
+    AIO_buffer_t bufs[AIO_NB_BUFFERS];
+    /* buffers [done, queued) belong to the writer,
+     * buffer `queued` is being filled by the caller */
+    unsigned queued;
+    unsigned done;
+    unsigned storedSkips;   /* sparse state, owned by whoever performs the writes */
+#ifdef ZSTD_MULTITHREAD
+    int stop;
+    ZSTD_pthread_t thread;
+    ZSTD_pthread_mutex_t mutex;
+    ZSTD_pthread_cond_t cond;
+#endif
+} AIO_WritePool_t;
+
+typedef struct {
+    int threaded;
+    FILE* file;
+    size_t bufferSize;
+    unsigned nbBuffers;
+    AIO_buffer_t bufs[AIO_NB_BUFFERS];
+    /* buffers [consumed, filled) hold data not yet delivered,
+     * reading position within buffer `consumed` is `pos` */
+    unsigned filled;
+    unsigned consumed;
+    size_t pos;
+    int reachedEnd;   /* reader hit end of file, or an error */
+    int error;        /* ferror() at the time reachedEnd was set */
+#ifdef ZSTD_MULTITHREAD
+    int stop;
+    int busy;         /* reader is inside fread() */
+    ZSTD_pthread_t thread;
+    ZSTD_pthread_mutex_t mutex;
+    ZSTD_pthread_cond_t cond;
+#endif
+} AIO_ReadPool_t;
+
+static void AIO_allocBuffers(AIO_buffer_t* bufs, unsigned nbBuffers, size_t bufferSize)
+{
+    unsigned u;
+    for (u = 0; u < nbBuffers; u++) {
+        bufs[u].buffer = malloc(bufferSize);
+        bufs[u].size = 0;
+        if (bufs[u].buffer == NULL)
+            EXM_THROW(101, "Allocation error : not enough memory for I/O buffers");
+    }
+}
+
+static void AIO_freeBuffers(AIO_buffer_t* bufs, unsigned nbBuffers)
+{
+    unsigned u;
+    for (u = 0; u < nbBuffers; u++) free(bufs[u].buffer);
+}
+
+/* AIO_WritePool_writeBuffer() :
+ * performs the actual write of one buffer, in the writer thread if any */
+static void AIO_WritePool_writeBuffer(AIO_WritePool_t* wp, const AIO_buffer_t* b)
+{
+    if (wp->sparse) {
+        wp->storedSkips = FIO_fwriteSparse(wp->file, b->buffer, b->size, wp->prefs, wp->storedSkips);
+        return;
+    }
+    if (fwrite(b->buffer, 1, b->size, wp->file) != b->size)
+        EXM_THROW(25, "Write error : %s (cannot write compressed block)",
+                        strerror(errno));
+}
+
+#ifdef ZSTD_MULTITHREAD
+static void* AIO_WritePool_worker(void* opaque)
+{
+    AIO_WritePool_t* const wp = (AIO_WritePool_t*)opaque;
+    ZSTD_pthread_mutex_lock(&wp->mutex);
+    for (;;) {
+        const AIO_buffer_t* b;
+        while (wp->done == wp->queued && !wp->stop)
+            ZSTD_pthread_cond_wait(&wp->cond, &wp->mutex);
+        if (wp->done == wp->queued) break;   /* stop requested, and nothing left to write */
+        b = &wp->bufs[wp->done & (wp->nbBuffers-1)];
+        ZSTD_pthread_mutex_unlock(&wp->mutex);
+        AIO_WritePool_writeBuffer(wp, b);
+        ZSTD_pthread_mutex_lock(&wp->mutex);
+        wp->done++;
+        ZSTD_pthread_cond_broadcast(&wp->cond);
+    }
+    ZSTD_pthread_mutex_unlock(&wp->mutex);
+    return NULL;
+}
+#endif
+
+static AIO_WritePool_t*
+AIO_WritePool_create(const FIO_prefs_t* prefs, size_t bufferSize, int sparse)
+{
+    AIO_WritePool_t* const wp = (AIO_WritePool_t*)calloc(1, sizeof(*wp));
+    if (wp == NULL) EXM_THROW(101, "Allocation error : not enough memory");
+    wp->prefs = prefs;
+    wp->sparse = sparse;
+    wp->bufferSize = bufferSize;
+    wp->threaded = prefs->asyncIO;
+    wp->nbBuffers = wp->threaded ? AIO_NB_BUFFERS : 1;
+    AIO_allocBuffers(wp->bufs, wp->nbBuffers, bufferSize);
+#ifdef ZSTD_MULTITHREAD
+    if (wp->threaded) {
+        if ( ZSTD_pthread_mutex_init(&wp->mutex, NULL)
+          || ZSTD_pthread_cond_init(&wp->cond, NULL)
+          || ZSTD_pthread_create(&wp->thread, NULL, AIO_WritePool_worker, wp) )
+            EXM_THROW(102, "Error : cannot start writer thread");
+    }
+#endif
+    return wp;
+}
+
+/* AIO_WritePool_enqueue() :
+ * hands the buffer being filled over to the writer,
+ * then waits until the next one in the ring is free */
+static void AIO_WritePool_enqueue(AIO_WritePool_t* wp)
+{
+    AIO_buffer_t* const b = &wp->bufs[wp->queued & (wp->nbBuffers-1)];
+    if (b->size == 0) return;
+#ifdef ZSTD_MULTITHREAD
+    if (wp->threaded) {
+        ZSTD_pthread_mutex_lock(&wp->mutex);
+        wp->queued++;
+        ZSTD_pthread_cond_broadcast(&wp->cond);
+        while (wp->queued - wp->done >= wp->nbBuffers)
+            ZSTD_pthread_cond_wait(&wp->cond, &wp->mutex);
+        ZSTD_pthread_mutex_unlock(&wp->mutex);
+        wp->bufs[wp->queued & (wp->nbBuffers-1)].size = 0;
+        return;
+    }
+#endif
+    AIO_WritePool_writeBuffer(wp, b);
+    b->size = 0;
+}
+
+/* AIO_WritePool_reserve() :
+ * @return : pointer to free space within the buffer being filled,
+ *           of size *capacity (> 0), to be followed by AIO_WritePool_commit() */
+static void* AIO_WritePool_reserve(AIO_WritePool_t* wp, size_t* capacity)
+{
+    AIO_buffer_t* const b = &wp->bufs[wp->queued & (wp->nbBuffers-1)];
+    assert(b->size < wp->bufferSize);
+    *capacity = wp->bufferSize - b->size;
+    return (char*)b->buffer + b->size;
+}
+
+static void AIO_WritePool_commit(AIO_WritePool_t* wp, size_t size)
+{
+    AIO_buffer_t* const b = &wp->bufs[wp->queued & (wp->nbBuffers-1)];
+    assert(b->size + size <= wp->bufferSize);
+    b->size += size;
+    if (b->size == wp->bufferSize) AIO_WritePool_enqueue(wp);
+}
+
+/* AIO_WritePool_write() :
+ * copying variant, for producers which need their own output buffer */
+static void AIO_WritePool_write(AIO_WritePool_t* wp, const void* src, size_t size)
+{
+    while (size) {
+        size_t capacity;
+        void* const dst = AIO_WritePool_reserve(wp, &capacity);
+        size_t const toCopy = MIN(size, capacity);
+        memcpy(dst, src, toCopy);
+        AIO_WritePool_commit(wp, toCopy);
+        src = (const char*)src + toCopy;
+        size -= toCopy;
+    }
+}
+
+/* AIO_WritePool_flush() :
+ * returns once everything handed to the pool has been written */
+static void AIO_WritePool_flush(AIO_WritePool_t* wp)
+{
+    AIO_WritePool_enqueue(wp);
+#ifdef ZSTD_MULTITHREAD
+    if (wp->threaded) {
+        ZSTD_pthread_mutex_lock(&wp->mutex);
+        while (wp->done != wp->queued)
+            ZSTD_pthread_cond_wait(&wp->cond, &wp->mutex);
+        ZSTD_pthread_mutex_unlock(&wp->mutex);
+    }
+#endif
+}
+
+/* AIO_WritePool_sparseWriteEnd() :
+ * flushes, then terminates pending sparse skips, see FIO_fwriteSparseEnd() */
+static void AIO_WritePool_sparseWriteEnd(AIO_WritePool_t* wp)
+{
+    AIO_WritePool_flush(wp);
+    if (wp->sparse) FIO_fwriteSparseEnd(wp->prefs, wp->file, wp->storedSkips);
+    wp->storedSkips = 0;
+}
+
+/* AIO_WritePool_setFile() :
+ * flushes pending writes to the previous file, if any.
+ * Must be called with NULL before the current file is closed. */
+static void AIO_WritePool_setFile(AIO_WritePool_t* wp, FILE* file)
+{
+    AIO_WritePool_flush(wp);
+    wp->file = file;
+    wp->storedSkips = 0;
+}
+
+static void AIO_WritePool_free(AIO_WritePool_t* wp)
+{
+    if (wp == NULL) return;
+    AIO_WritePool_flush(wp);
+#ifdef ZSTD_MULTITHREAD
+    if (wp->threaded) {
+        ZSTD_pthread_mutex_lock(&wp->mutex);
+        wp->stop = 1;
+        ZSTD_pthread_cond_broadcast(&wp->cond);
+        ZSTD_pthread_mutex_unlock(&wp->mutex);
+        ZSTD_pthread_join(wp->thread, NULL);
+        ZSTD_pthread_cond_destroy(&wp->cond);
+        ZSTD_pthread_mutex_destroy(&wp->mutex);
+    }
+#endif
+    AIO_freeBuffers(wp->bufs, wp->nbBuffers);
+    free(wp);
+}
+
+#ifdef ZSTD_MULTITHREAD
+static void* AIO_ReadPool_worker(void* opaque)
+{
+    AIO_ReadPool_t* const rp = (AIO_ReadPool_t*)opaque;
+    ZSTD_pthread_mutex_lock(&rp->mutex);
+    for (;;) {
+        FILE* file;
+        AIO_buffer_t* b;
+        while ( !rp->stop
+             && (rp->file == NULL || rp->reachedEnd || rp->filled - rp->consumed >= rp->nbBuffers) )
+            ZSTD_pthread_cond_wait(&rp->cond, &rp->mutex);
+        if (rp->stop) break;
+        file = rp->file;
+        b = &rp->bufs[rp->filled & (rp->nbBuffers-1)];
+        rp->busy = 1;
+        ZSTD_pthread_mutex_unlock(&rp->mutex);
+        b->size = fread(b->buffer, 1, rp->bufferSize, file);
+        ZSTD_pthread_mutex_lock(&rp->mutex);
+        rp->busy = 0;
+        if (b->size < rp->bufferSize) {
+            rp->reachedEnd = 1;
+            rp->error = ferror(file);
+        }
+        if (b->size) rp->filled++;
+        ZSTD_pthread_cond_broadcast(&rp->cond);
+    }
+    ZSTD_pthread_mutex_unlock(&rp->mutex);
+    return NULL;
+}
+#endif
+
+static AIO_ReadPool_t* AIO_ReadPool_create(const FIO_prefs_t* prefs, size_t bufferSize)
+{
+    AIO_ReadPool_t* const rp = (AIO_ReadPool_t*)calloc(1, sizeof(*rp));
+    if (rp == NULL) EXM_THROW(101, "Allocation error : not enough memory");
+    rp->threaded = prefs->asyncIO;
+    rp->bufferSize = bufferSize;
+    rp->nbBuffers = rp->threaded ? AIO_NB_BUFFERS : 0;   /* synchronous reads go straight into the caller's buffer */
+    AIO_allocBuffers(rp->bufs, rp->nbBuffers, bufferSize);
+#ifdef ZSTD_MULTITHREAD
+    if (rp->threaded) {
+        if ( ZSTD_pthread_mutex_init(&rp->mutex, NULL)
+          || ZSTD_pthread_cond_init(&rp->cond, NULL)
+          || ZSTD_pthread_create(&rp->thread, NULL, AIO_ReadPool_worker, rp) )
+            EXM_THROW(102, "Error : cannot start reader thread");
+    }
+#endif
+    return rp;
+}
+
+/* AIO_ReadPool_setFile() :
+ * detaches the previous file (waiting for an ongoing read, and dropping
+ * whatever was read ahead), then starts reading ahead from `file`.
+ * Must be called with NULL before the current file is closed. */
+static void AIO_ReadPool_setFile(AIO_ReadPool_t* rp, FILE* file)
+{
+#ifdef ZSTD_MULTITHREAD
+    if (rp->threaded) {
+        ZSTD_pthread_mutex_lock(&rp->mutex);
+        rp->file = NULL;
+        while (rp->busy)
+            ZSTD_pthread_cond_wait(&rp->cond, &rp->mutex);
+        rp->filled = rp->consumed = 0;
+        rp->pos = 0;
+        rp->reachedEnd = rp->error = 0;
+        rp->file = file;
+        ZSTD_pthread_cond_broadcast(&rp->cond);
+        ZSTD_pthread_mutex_unlock(&rp->mutex);
+        return;
+    }
+#endif
+    rp->file = file;
+}
+
+/* AIO_ReadPool_read() :
+ * same contract as fread(dst, 1, size, file) :
+ * a short count means end of file or error, see AIO_ReadPool_error() */
+static size_t AIO_ReadPool_read(AIO_ReadPool_t* rp, void* dst, size_t size)
+{
+#ifdef ZSTD_MULTITHREAD
+    if (rp->threaded) {
+        size_t total = 0;
+        while (total < size) {
+            const AIO_buffer_t* b;
+            ZSTD_pthread_mutex_lock(&rp->mutex);
+            while (rp->filled == rp->consumed && !rp->reachedEnd)
+                ZSTD_pthread_cond_wait(&rp->cond, &rp->mutex);
+            if (rp->filled == rp->consumed) {   /* end of file */
+                ZSTD_pthread_mutex_unlock(&rp->mutex);
+                break;
+            }
+            ZSTD_pthread_mutex_unlock(&rp->mutex);
+            b = &rp->bufs[rp->consumed & (rp->nbBuffers-1)];
+            {   size_t const toCopy = MIN(size - total, b->size - rp->pos);
+                memcpy((char*)dst + total, (const char*)b->buffer + rp->pos, toCopy);
+                rp->pos += toCopy;
+                total += toCopy;
+            }
+            if (rp->pos == b->size) {   /* buffer entirely delivered : give it back to the reader */
+                ZSTD_pthread_mutex_lock(&rp->mutex);
+                rp->consumed++;
+                rp->pos = 0;
+                ZSTD_pthread_cond_broadcast(&rp->cond);
+                ZSTD_pthread_mutex_unlock(&rp->mutex);
+            }
+        }
+        return total;
+    }
+#endif
+    return fread(dst, 1, size, rp->file);
+}
+
+/* AIO_ReadPool_error() :
+ * equivalent of ferror(file), meaningful after a short read */
+static int AIO_ReadPool_error(AIO_ReadPool_t* rp)
+{
+#ifdef ZSTD_MULTITHREAD
+    if (rp->threaded) {
+        int error;
+        ZSTD_pthread_mutex_lock(&rp->mutex);
+        error = rp->error;
+        ZSTD_pthread_mutex_unlock(&rp->mutex);
+        return error;
+    }
+#endif
+    return ferror(rp->file);
+}
+
+static void AIO_ReadPool_free(AIO_ReadPool_t* rp)
+{
+    if (rp == NULL) return;
+#ifdef ZSTD_MULTITHREAD
+    if (rp->threaded) {
+        AIO_ReadPool_setFile(rp, NULL);
+        ZSTD_pthread_mutex_lock(&rp->mutex);
+        rp->stop = 1;
+        ZSTD_pthread_cond_broadcast(&rp->cond);
+        ZSTD_pthread_mutex_unlock(&rp->mutex);
+        ZSTD_pthread_join(rp->thread, NULL);
+        ZSTD_pthread_cond_destroy(&rp->cond);
+        ZSTD_pthread_mutex_destroy(&rp->mutex);
+    }
+#endif
+    AIO_freeBuffers(rp->bufs, rp->nbBuffers);
+    free(rp);
+}
+
+
 #ifndef ZSTD_NOCOMPRESS
 
 /* **********************************************************************
@@ -895,6 +1404,8 @@ typedef struct {
     size_t dictBufferSize;
     const char* dictFileName;
     ZSTD_CStream* cctx;
+    AIO_ReadPool_t* readCtx;     /* all reads from srcFile go through readCtx */
+    AIO_WritePool_t* writeCtx;   /* all writes to dstFile go through writeCtx */
 } cRess_t;
 
 static void FIO_adjustParamsForPatchFromMode(FIO_prefs_t* const prefs,
@@ -954,6 +1465,9 @@ static cRess_t FIO_createCResources(FIO_prefs_t* const prefs,
         EXM_THROW(32, "allocation error : can't create dictBuffer");
     ress.dictFileName = dictFileName;
 
+    ress.readCtx = AIO_ReadPool_create(prefs, ress.srcBufferSize);
+    ress.writeCtx = AIO_WritePool_create(prefs, ress.dstBufferSize, 0 /* sparse */);
+
     if (prefs->adaptiveMode && !prefs->ldmFlag && !comprParams.windowLog)
         comprParams.windowLog = ADAPT_WINDOWLOG_DEFAULT;
 
@@ -1013,6 +1527,8 @@ static void FIO_freeCResources(const cRess_t* const ress)
     free(ress->dstBuffer);
     free(ress->dictBuffer);
     ZSTD_freeCStream(ress->cctx);   /* never fails */
+    AIO_ReadPool_free(ress->readCtx);
+    AIO_WritePool_free(ress->writeCtx);
 }
 
 
@@ -1047,7 +1563,7 @@ FIO_compressGzFrame(const cRess_t* ress,  /* buffers & handlers are used, but no
     while (1) {
         int ret;
         if (strm.avail_in == 0) {
-            size_t const inSize = fread(ress->srcBuffer, 1, ress->srcBufferSize, ress->srcFile);
+            size_t const inSize = AIO_ReadPool_read(ress->readCtx, ress->srcBuffer, ress->srcBufferSize);
             if (inSize == 0) break;
             inFileSize += inSize;
             strm.next_in = (z_const unsigned char*)ress->srcBuffer;
@@ -1058,8 +1574,7 @@ FIO_compressGzFrame(const cRess_t* ress,  /* buffers & handlers are used, but no
             EXM_THROW(72, "zstd: %s: deflate error %d \n", srcFileName, ret);
         {   size_t const cSize = ress->dstBufferSize - strm.avail_out;
             if (cSize) {
-                if (fwrite(ress->dstBuffer, 1, cSize, ress->dstFile) != cSize)
-                    EXM_THROW(73, "Write error : cannot write to output file : %s ", strerror(errno));
+                AIO_WritePool_write(ress->writeCtx, ress->dstBuffer, cSize);
                 outFileSize += cSize;
                 strm.next_out = (Bytef*)ress->dstBuffer;
                 strm.avail_out = (uInt)ress->dstBufferSize;
@@ -1078,8 +1593,7 @@ FIO_compressGzFrame(const cRess_t* ress,  /* buffers & handlers are used, but no
         int const ret = deflate(&strm, Z_FINISH);
         {   size_t const cSize = ress->dstBufferSize - strm.avail_out;
             if (cSize) {
-                if (fwrite(ress->dstBuffer, 1, cSize, ress->dstFile) != cSize)
-                    EXM_THROW(75, "Write error : %s ", strerror(errno));
+                AIO_WritePool_write(ress->writeCtx, ress->dstBuffer, cSize);
                 outFileSize += cSize;
                 strm.next_out = (Bytef*)ress->dstBuffer;
                 strm.avail_out = (uInt)ress->dstBufferSize;
@@ -1133,7 +1647,7 @@ FIO_compressLzmaFrame(cRess_t* ress,
 
     while (1) {
         if (strm.avail_in == 0) {
-            size_t const inSize = fread(ress->srcBuffer, 1, ress->srcBufferSize, ress->srcFile);
+            size_t const inSize = AIO_ReadPool_read(ress->readCtx, ress->srcBuffer, ress->srcBufferSize);
             if (inSize == 0) action = LZMA_FINISH;
             inFileSize += inSize;
             strm.next_in = (BYTE const*)ress->srcBuffer;
@@ -1146,8 +1660,7 @@ FIO_compressLzmaFrame(cRess_t* ress,
             EXM_THROW(84, "zstd: %s: lzma_code encoding error %d", srcFileName, ret);
         {   size_t const compBytes = ress->dstBufferSize - strm.avail_out;
             if (compBytes) {
-                if (fwrite(ress->dstBuffer, 1, compBytes, ress->dstFile) != compBytes)
-                    EXM_THROW(85, "Write error : %s", strerror(errno));
+                AIO_WritePool_write(ress->writeCtx, ress->dstBuffer, compBytes);
                 outFileSize += compBytes;
                 strm.next_out = (BYTE*)ress->dstBuffer;
                 strm.avail_out = ress->dstBufferSize;
@@ -1215,12 +1728,11 @@ FIO_compressLz4Frame(cRess_t* ress,
         if (LZ4F_isError(headerSize))
             EXM_THROW(33, "File header generation failed : %s",
                             LZ4F_getErrorName(headerSize));
-        if (fwrite(ress->dstBuffer, 1, headerSize, ress->dstFile) != headerSize)
-            EXM_THROW(34, "Write error : %s (cannot write header)", strerror(errno));
+        AIO_WritePool_write(ress->writeCtx, ress->dstBuffer, headerSize);
         outFileSize += headerSize;
 
         /* Read first block */
-        readSize  = fread(ress->srcBuffer, (size_t)1, (size_t)blockSize, ress->srcFile);
+        readSize  = AIO_ReadPool_read(ress->readCtx, ress->srcBuffer, (size_t)blockSize);
         inFileSize += readSize;
 
         /* Main Loop */
@@ -1243,16 +1755,13 @@ FIO_compressLz4Frame(cRess_t* ress,
             }
 
             /* Write Block */
-            {   size_t const sizeCheck = fwrite(ress->dstBuffer, 1, outSize, ress->dstFile);
-                if (sizeCheck != outSize)
-                    EXM_THROW(36, "Write error : %s", strerror(errno));
-            }
+            AIO_WritePool_write(ress->writeCtx, ress->dstBuffer, outSize);
 
             /* Read next block */
-            readSize  = fread(ress->srcBuffer, (size_t)1, (size_t)blockSize, ress->srcFile);
+            readSize  = AIO_ReadPool_read(ress->readCtx, ress->srcBuffer, (size_t)blockSize);
             inFileSize += readSize;
         }
-        if (ferror(ress->srcFile)) EXM_THROW(37, "Error reading %s ", srcFileName);
+        if (AIO_ReadPool_error(ress->readCtx)) EXM_THROW(37, "Error reading %s ", srcFileName);
 
         /* End of Stream mark */
         headerSize = LZ4F_compressEnd(ctx, ress->dstBuffer, ress->dstBufferSize, NULL);
@@ -1260,11 +1769,7 @@ FIO_compressLz4Frame(cRess_t* ress,
             EXM_THROW(38, "zstd: %s: lz4 end of file generation failed : %s",
                         srcFileName, LZ4F_getErrorName(headerSize));
 
-        {   size_t const sizeCheck = fwrite(ress->dstBuffer, 1, headerSize, ress->dstFile);
-            if (sizeCheck != headerSize)
-                EXM_THROW(39, "Write error : %s (cannot write end of stream)",
-                            strerror(errno));
-        }
+        AIO_WritePool_write(ress->writeCtx, ress->dstBuffer, headerSize);
         outFileSize += headerSize;
     }
 
@@ -1284,8 +1789,6 @@ FIO_compressZstdFrame(FIO_ctx_t* const fCtx,
                       int compressionLevel, U64* readsize)
 {
     cRess_t const ress = *ressPtr;
-    FILE* const srcFile = ress.srcFile;
-    FILE* const dstFile = ress.dstFile;
     U64 compressedfilesize = 0;
     ZSTD_EndDirective directive = ZSTD_e_continue;
 
@@ -1314,7 +1817,7 @@ FIO_compressZstdFrame(FIO_ctx_t* const fCtx,
     do {
         size_t stillToFlush;
         /* Fill input Buffer */
-        size_t const inSize = fread(ress.srcBuffer, (size_t)1, ress.srcBufferSize, srcFile);
+        size_t const inSize = AIO_ReadPool_read(ress.readCtx, ress.srcBuffer, ress.srcBufferSize);
         ZSTD_inBuffer inBuff = { ress.srcBuffer, inSize, 0 };
         DISPLAYLEVEL(6, "fread %u bytes from source \n", (unsigned)inSize);
         *readsize += inSize;
@@ -1327,8 +1830,11 @@ FIO_compressZstdFrame(FIO_ctx_t* const fCtx,
             || (directive == ZSTD_e_end && stillToFlush != 0) ) {
 
             size_t const oldIPos = inBuff.pos;
-            ZSTD_outBuffer outBuff = { ress.dstBuffer, ress.dstBufferSize, 0 };
+            ZSTD_outBuffer outBuff;
             size_t const toFlushNow = ZSTD_toFlushNow(ress.cctx);
+            /* compress straight into the writer's buffer */
+            outBuff.dst = AIO_WritePool_reserve(ress.writeCtx, &outBuff.size);
+            outBuff.pos = 0;
             CHECK_V(stillToFlush, ZSTD_compressStream2(ress.cctx, &outBuff, &inBuff, directive));
 
             /* count stats */
@@ -1339,13 +1845,8 @@ FIO_compressZstdFrame(FIO_ctx_t* const fCtx,
             /* Write compressed stream */
             DISPLAYLEVEL(6, "ZSTD_compress_generic(end:%u) => input pos(%u)<=(%u)size ; output generated %u bytes \n",
                             (unsigned)directive, (unsigned)inBuff.pos, (unsigned)inBuff.size, (unsigned)outBuff.pos);
-            if (outBuff.pos) {
-                size_t const sizeCheck = fwrite(ress.dstBuffer, 1, outBuff.pos, dstFile);
-                if (sizeCheck != outBuff.pos)
-                    EXM_THROW(25, "Write error : %s (cannot write compressed block)",
-                                    strerror(errno));
-                compressedfilesize += outBuff.pos;
-            }
+            AIO_WritePool_commit(ress.writeCtx, outBuff.pos);
+            compressedfilesize += outBuff.pos;
 
             /* display notification; and adapt compression level */
             if (READY_FOR_UPDATE()) {
@@ -1471,7 +1972,7 @@ FIO_compressZstdFrame(FIO_ctx_t* const fCtx,
         }  /* while ((inBuff.pos != inBuff.size) */
     } while (directive != ZSTD_e_end);
 
-    if (ferror(srcFile)) {
+    if (AIO_ReadPool_error(ress.readCtx)) {
         EXM_THROW(26, "Read error : I/O error");
     }
     if (fileSize != UTIL_FILESIZE_UNKNOWN && *readsize != fileSize) {
@@ -1600,6 +2101,7 @@ static int FIO_compressFilename_dstFile(FIO_ctx_t* const fCtx,
         DISPLAYLEVEL(6, "FIO_compressFilename_dstFile: opening dst: %s \n", dstFileName);
         ress.dstFile = FIO_openDstFile(fCtx, prefs, srcFileName, dstFileName);
         if (ress.dstFile==NULL) return 1;  /* could not open dstFileName */
+        AIO_WritePool_setFile(ress.writeCtx, ress.dstFile);
         /* Must only be added after FIO_openDstFile() succeeds.
          * Otherwise we may delete the destination file if it already exists,
          * and the user presses Ctrl-C when asked if they wish to overwrite.
@@ -1617,6 +2119,7 @@ static int FIO_compressFilename_dstFile(FIO_ctx_t* const fCtx,
     if (closeDstFile) {
         FILE* const dstFile = ress.dstFile;
         ress.dstFile = NULL;
+        AIO_WritePool_setFile(ress.writeCtx, NULL);
 
         clearHandler();
 
@@ -1694,9 +2197,11 @@ FIO_compressFilename_srcFile(FIO_ctx_t* const fCtx,
 
     ress.srcFile = FIO_openSrcFile(srcFileName);
     if (ress.srcFile == NULL) return 1;   /* srcFile could not be opened */
+    AIO_ReadPool_setFile(ress.readCtx, ress.srcFile);
 
     result = FIO_compressFilename_dstFile(fCtx, prefs, ress, dstFileName, srcFileName, compressionLevel);
 
+    AIO_ReadPool_setFile(ress.readCtx, NULL);
     fclose(ress.srcFile);
     ress.srcFile = NULL;
     if ( prefs->removeSrcFile   /* --rm */
@@ -1809,11 +2314,13 @@ int FIO_compressMultipleFilenames(FIO_ctx_t* const fCtx,
         if (ress.dstFile == NULL) {  /* could not open outFileName */
             error = 1;
         } else {
+            AIO_WritePool_setFile(ress.writeCtx, ress.dstFile);
             for (; fCtx->currFileIdx < fCtx->nbFilesTotal; ++fCtx->currFileIdx) {
                 status = FIO_compressFilename_srcFile(fCtx, prefs, ress, outFileName, inFileNamesTable[fCtx->currFileIdx], compressionLevel);
                 if (!status) fCtx->nbFilesProcessed++;
                 error |= status;
             }
+            AIO_WritePool_setFile(ress.writeCtx, NULL);
             if (fclose(ress.dstFile))
                 EXM_THROW(29, "Write error (%s) : cannot properly close %s",
                             strerror(errno), outFileName);
@@ -1876,6 +2383,8 @@ typedef struct {
     size_t dstBufferSize;
     ZSTD_DStream* dctx;
     FILE*  dstFile;
+    AIO_ReadPool_t* readCtx;     /* all reads from the source go through readCtx */
+    AIO_WritePool_t* writeCtx;   /* all writes to dstFile go through writeCtx */
 } dRess_t;
 
 static dRess_t FIO_createDResources(FIO_prefs_t* const prefs, const char* dictFileName)
@@ -1899,6 +2408,8 @@ static dRess_t FIO_createDResources(FIO_prefs_t* const prefs, const char* dictFi
     ress.dstBuffer = malloc(ress.dstBufferSize);
     if (!ress.srcBuffer || !ress.dstBuffer)
         EXM_THROW(61, "Allocation error : not enough memory");
+    ress.readCtx = AIO_ReadPool_create(prefs, ress.srcBufferSize);
+    ress.writeCtx = AIO_WritePool_create(prefs, ress.dstBufferSize, 1 /* sparse */);
 
     /* dictionary */
     {   void* dictBuffer;
@@ -1915,137 +2426,31 @@ static void FIO_freeDResources(dRess_t ress)
     CHECK( ZSTD_freeDStream(ress.dctx) );
     free(ress.srcBuffer);
     free(ress.dstBuffer);
-}
-
-
-/** FIO_fwriteSparse() :
-*  @return : storedSkips,
-*            argument for next call to FIO_fwriteSparse() or FIO_fwriteSparseEnd() */
-static unsigned
-FIO_fwriteSparse(FILE* file,
-                 const void* buffer, size_t bufferSize,
-                 const FIO_prefs_t* const prefs,
-                 unsigned storedSkips)
-{
-    const size_t* const bufferT = (const size_t*)buffer;   /* Buffer is supposed malloc'ed, hence aligned on size_t */
-    size_t bufferSizeT = bufferSize / sizeof(size_t);
-    const size_t* const bufferTEnd = bufferT + bufferSizeT;
-    const size_t* ptrT = bufferT;
-    static const size_t segmentSizeT = (32 KB) / sizeof(size_t);   /* check every 32 KB */
-
-    if (prefs->testMode) return 0;  /* do not output anything in test mode */
-
-    if (!prefs->sparseFileSupport) {  /* normal write */
-        size_t const sizeCheck = fwrite(buffer, 1, bufferSize, file);
-        if (sizeCheck != bufferSize)
-            EXM_THROW(70, "Write error : cannot write decoded block : %s",
-                            strerror(errno));
-        return 0;
-    }
-
-    /* avoid int overflow */
-    if (storedSkips > 1 GB) {
-        if (LONG_SEEK(file, 1 GB, SEEK_CUR) != 0)
-            EXM_THROW(91, "1 GB skip error (sparse file support)");
-        storedSkips -= 1 GB;
-    }
-
-    while (ptrT < bufferTEnd) {
-        size_t nb0T;
-
-        /* adjust last segment if < 32 KB */
-        size_t seg0SizeT = segmentSizeT;
-        if (seg0SizeT > bufferSizeT) seg0SizeT = bufferSizeT;
-        bufferSizeT -= seg0SizeT;
-
-        /* count leading zeroes */
-        for (nb0T=0; (nb0T < seg0SizeT) && (ptrT[nb0T] == 0); nb0T++) ;
-        storedSkips += (unsigned)(nb0T * sizeof(size_t));
-
-        if (nb0T != seg0SizeT) {   /* not all 0s */
-            size_t const nbNon0ST = seg0SizeT - nb0T;
-            /* skip leading zeros */
-            if (LONG_SEEK(file, storedSkips, SEEK_CUR) != 0)
-                EXM_THROW(92, "Sparse skip error ; try --no-sparse");
-            storedSkips = 0;
-            /* write the rest */
-            if (fwrite(ptrT + nb0T, sizeof(size_t), nbNon0ST, file) != nbNon0ST)
-                EXM_THROW(93, "Write error : cannot write decoded block : %s",
-                            strerror(errno));
-        }
-        ptrT += seg0SizeT;
-    }
-
-    {   static size_t const maskT = sizeof(size_t)-1;
-        if (bufferSize & maskT) {
-            /* size not multiple of sizeof(size_t) : implies end of block */
-            const char* const restStart = (const char*)bufferTEnd;
-            const char* restPtr = restStart;
-            const char* const restEnd = (const char*)buffer + bufferSize;
-            assert(restEnd > restStart && restEnd < restStart + sizeof(size_t));
-            for ( ; (restPtr < restEnd) && (*restPtr == 0); restPtr++) ;
-            storedSkips += (unsigned) (restPtr - restStart);
-            if (restPtr != restEnd) {
-                /* not all remaining bytes are 0 */
-                size_t const restSize = (size_t)(restEnd - restPtr);
-                if (LONG_SEEK(file, storedSkips, SEEK_CUR) != 0)
-                    EXM_THROW(92, "Sparse skip error ; try --no-sparse");
-                if (fwrite(restPtr, 1, restSize, file) != restSize)
-                    EXM_THROW(95, "Write error : cannot write end of decoded block : %s",
-                        strerror(errno));
-                storedSkips = 0;
-    }   }   }
-
-    return storedSkips;
-}
-
-static void
-FIO_fwriteSparseEnd(const FIO_prefs_t* const prefs, FILE* file, unsigned storedSkips)
-{
-    if (prefs->testMode) assert(storedSkips == 0);
-    if (storedSkips>0) {
-        assert(prefs->sparseFileSupport > 0);  /* storedSkips>0 implies sparse support is enabled */
-        (void)prefs;   /* assert can be disabled, in which case prefs becomes unused */
-        if (LONG_SEEK(file, storedSkips-1, SEEK_CUR) != 0)
-            EXM_THROW(69, "Final skip error (sparse file support)");
-        /* last zero must be explicitly written,
-         * so that skipped ones get implicitly translated as zero by FS */
-        {   const char lastZeroByte[1] = { 0 };
-            if (fwrite(lastZeroByte, 1, 1, file) != 1)
-                EXM_THROW(69, "Write error : cannot write last zero : %s", strerror(errno));
-    }   }
+    AIO_ReadPool_free(ress.readCtx);
+    AIO_WritePool_free(ress.writeCtx);
 }
 
 
 /** FIO_passThrough() : just copy input into output, for compatibility with gzip -df mode
     @return : 0 (no error) */
-static int FIO_passThrough(const FIO_prefs_t* const prefs,
-                           FILE* foutput, FILE* finput,
-                           void* buffer, size_t bufferSize,
-                           size_t alreadyLoaded)
+static int FIO_passThrough(dRess_t* ress)
 {
-    size_t const blockSize = MIN(64 KB, bufferSize);
+    size_t const blockSize = MIN(64 KB, ress->srcBufferSize);
     size_t readFromInput;
-    unsigned storedSkips = 0;
 
     /* assumption : ress->srcBufferLoaded bytes already loaded and stored within buffer */
-    {   size_t const sizeCheck = fwrite(buffer, 1, alreadyLoaded, foutput);
-        if (sizeCheck != alreadyLoaded) {
-            DISPLAYLEVEL(1, "Pass-through write error : %s\n", strerror(errno));
-            return 1;
-    }   }
+    AIO_WritePool_write(ress->writeCtx, ress->srcBuffer, ress->srcBufferLoaded);
 
     do {
-        readFromInput = fread(buffer, 1, blockSize, finput);
-        storedSkips = FIO_fwriteSparse(foutput, buffer, readFromInput, prefs, storedSkips);
+        readFromInput = AIO_ReadPool_read(ress->readCtx, ress->srcBuffer, blockSize);
+        AIO_WritePool_write(ress->writeCtx, ress->srcBuffer, readFromInput);
     } while (readFromInput == blockSize);
-    if (ferror(finput)) {
+    if (AIO_ReadPool_error(ress->readCtx)) {
         DISPLAYLEVEL(1, "Pass-through read error : %s\n", strerror(errno));
         return 1;
     }
-    assert(feof(finput));
 
-    FIO_fwriteSparseEnd(prefs, foutput, storedSkips);
+    AIO_WritePool_sparseWriteEnd(ress->writeCtx);
     return 0;
 }
 
@@ -2086,13 +2491,12 @@ FIO_zstdErrorHelp(const FIO_prefs_t* const prefs,
  */
 #define FIO_ERROR_FRAME_DECODING   ((unsigned long long)(-2))
 static unsigned long long
-FIO_decompressZstdFrame(FIO_ctx_t* const fCtx, dRess_t* ress, FILE* finput,
+FIO_decompressZstdFrame(FIO_ctx_t* const fCtx, dRess_t* ress,
                         const FIO_prefs_t* const prefs,
                         const char* srcFileName,
                         U64 alreadyDecoded)  /* for multi-frames streams */
 {
     U64 frameSize = 0;
-    U32 storedSkips = 0;
 
     /* display last 20 characters only */
     {   size_t const srcFileLength = strlen(srcFileName);
@@ -2106,14 +2510,18 @@ FIO_decompressZstdFrame(FIO_ctx_t* const fCtx, dRess_t* ress, FILE* finput,
         if (ress->srcBufferLoaded < toDecode) {
             size_t const toRead = toDecode - ress->srcBufferLoaded;
             void* const startPosition = (char*)ress->srcBuffer + ress->srcBufferLoaded;
-            ress->srcBufferLoaded += fread(startPosition, 1, toRead, finput);
+            ress->srcBufferLoaded += AIO_ReadPool_read(ress->readCtx, startPosition, toRead);
     }   }
 
     /* Main decompression Loop */
     while (1) {
         ZSTD_inBuffer  inBuff = { ress->srcBuffer, ress->srcBufferLoaded, 0 };
-        ZSTD_outBuffer outBuff= { ress->dstBuffer, ress->dstBufferSize, 0 };
-        size_t const readSizeHint = ZSTD_decompressStream(ress->dctx, &outBuff, &inBuff);
+        ZSTD_outBuffer outBuff;
+        size_t readSizeHint;
+        /* decompress straight into the writer's buffer */
+        outBuff.dst = AIO_WritePool_reserve(ress->writeCtx, &outBuff.size);
+        outBuff.pos = 0;
+        readSizeHint = ZSTD_decompressStream(ress->dctx, &outBuff, &inBuff);
         if (ZSTD_isError(readSizeHint)) {
             DISPLAYLEVEL(1, "%s : Decoding error (36) : %s \n",
                             srcFileName, ZSTD_getErrorName(readSizeHint));
@@ -2122,7 +2530,7 @@ FIO_decompressZstdFrame(FIO_ctx_t* const fCtx, dRess_t* ress, FILE* finput,
         }
 
         /* Write block */
-        storedSkips = FIO_fwriteSparse(ress->dstFile, ress->dstBuffer, outBuff.pos, prefs, storedSkips);
+        AIO_WritePool_commit(ress->writeCtx, outBuff.pos);
         frameSize += outBuff.pos;
         if (!fCtx->hasStdoutOutput) {
             if (fCtx->nbFilesTotal > 1) {
@@ -2153,7 +2561,7 @@ FIO_decompressZstdFrame(FIO_ctx_t* const fCtx, dRess_t* ress, FILE* finput,
             if (ress->srcBufferLoaded < toDecode) {
                 size_t const toRead = toDecode - ress->srcBufferLoaded;   /* > 0 */
                 void* const startPosition = (char*)ress->srcBuffer + ress->srcBufferLoaded;
-                size_t const readSize = fread(startPosition, 1, toRead, finput);
+                size_t const readSize = AIO_ReadPool_read(ress->readCtx, startPosition, toRead);
                 if (readSize==0) {
                     DISPLAYLEVEL(1, "%s : Read error (39) : premature end \n",
                                     srcFileName);
@@ -2162,7 +2570,7 @@ FIO_decompressZstdFrame(FIO_ctx_t* const fCtx, dRess_t* ress, FILE* finput,
                 ress->srcBufferLoaded += readSize;
     }   }   }
 
-    FIO_fwriteSparseEnd(prefs, ress->dstFile, storedSkips);
+    AIO_WritePool_sparseWriteEnd(ress->writeCtx);
 
     return frameSize;
 }
@@ -2170,15 +2578,12 @@ FIO_decompressZstdFrame(FIO_ctx_t* const fCtx, dRess_t* ress, FILE* finput,
 
 #ifdef ZSTD_GZDECOMPRESS
 static unsigned long long
-FIO_decompressGzFrame(dRess_t* ress, FILE* srcFile,
-                      const FIO_prefs_t* const prefs,
-                      const char* srcFileName)
+FIO_decompressGzFrame(dRess_t* ress, const char* srcFileName)
 {
     unsigned long long outFileSize = 0;
     z_stream strm;
     int flush = Z_NO_FLUSH;
     int decodingError = 0;
-    unsigned storedSkips = 0;
 
     strm.zalloc = Z_NULL;
     strm.zfree = Z_NULL;
@@ -2197,7 +2602,7 @@ FIO_decompressGzFrame(dRess_t* ress, FILE* srcFile,
     for ( ; ; ) {
         int ret;
         if (strm.avail_in == 0) {
-            ress->srcBufferLoaded = fread(ress->srcBuffer, 1, ress->srcBufferSize, srcFile);
+            ress->srcBufferLoaded = AIO_ReadPool_read(ress->readCtx, ress->srcBuffer, ress->srcBufferSize);
             if (ress->srcBufferLoaded == 0) flush = Z_FINISH;
             strm.next_in = (z_const unsigned char*)ress->srcBuffer;
             strm.avail_in = (uInt)ress->srcBufferLoaded;
@@ -2213,7 +2618,7 @@ FIO_decompressGzFrame(dRess_t* ress, FILE* srcFile,
         }
         {   size_t const decompBytes = ress->dstBufferSize - strm.avail_out;
             if (decompBytes) {
-                storedSkips = FIO_fwriteSparse(ress->dstFile, ress->dstBuffer, decompBytes, prefs, storedSkips);
+                AIO_WritePool_write(ress->writeCtx, ress->dstBuffer, decompBytes);
                 outFileSize += decompBytes;
                 strm.next_out = (Bytef*)ress->dstBuffer;
                 strm.avail_out = (uInt)ress->dstBufferSize;
@@ -2230,7 +2635,7 @@ FIO_decompressGzFrame(dRess_t* ress, FILE* srcFile,
         DISPLAYLEVEL(1, "zstd: %s: inflateEnd error \n", srcFileName);
         decodingError = 1;
     }
-    FIO_fwriteSparseEnd(prefs, ress->dstFile, storedSkips);
+    AIO_WritePool_sparseWriteEnd(ress->writeCtx);
     return decodingError ? FIO_ERROR_FRAME_DECODING : outFileSize;
 }
 #endif
@@ -2238,8 +2643,7 @@ FIO_decompressGzFrame(dRess_t* ress, FILE* srcFile,
 
 #ifdef ZSTD_LZMADECOMPRESS
 static unsigned long long
-FIO_decompressLzmaFrame(dRess_t* ress, FILE* srcFile,
-                        const FIO_prefs_t* const prefs,
+FIO_decompressLzmaFrame(dRess_t* ress,
                         const char* srcFileName, int plain_lzma)
 {
     unsigned long long outFileSize = 0;
@@ -2247,7 +2651,6 @@ FIO_decompressLzmaFrame(dRess_t* ress, FILE* srcFile,
     lzma_action action = LZMA_RUN;
     lzma_ret initRet;
     int decodingError = 0;
-    unsigned storedSkips = 0;
 
     strm.next_in = 0;
     strm.avail_in = 0;
@@ -2272,7 +2675,7 @@ FIO_decompressLzmaFrame(dRess_t* ress, FILE* srcFile,
     for ( ; ; ) {
         lzma_ret ret;
         if (strm.avail_in == 0) {
-            ress->srcBufferLoaded = fread(ress->srcBuffer, 1, ress->srcBufferSize, srcFile);
+            ress->srcBufferLoaded = AIO_ReadPool_read(ress->readCtx, ress->srcBuffer, ress->srcBufferSize);
             if (ress->srcBufferLoaded == 0) action = LZMA_FINISH;
             strm.next_in = (BYTE const*)ress->srcBuffer;
             strm.avail_in = ress->srcBufferLoaded;
@@ -2290,7 +2693,7 @@ FIO_decompressLzmaFrame(dRess_t* ress, FILE* srcFile,
         }
         {   size_t const decompBytes = ress->dstBufferSize - strm.avail_out;
             if (decompBytes) {
-                storedSkips = FIO_fwriteSparse(ress->dstFile, ress->dstBuffer, decompBytes, prefs, storedSkips);
+                AIO_WritePool_write(ress->writeCtx, ress->dstBuffer, decompBytes);
                 outFileSize += decompBytes;
                 strm.next_out = (BYTE*)ress->dstBuffer;
                 strm.avail_out = ress->dstBufferSize;
@@ -2302,23 +2705,20 @@ FIO_decompressLzmaFrame(dRess_t* ress, FILE* srcFile,
         memmove(ress->srcBuffer, strm.next_in, strm.avail_in);
     ress->srcBufferLoaded = strm.avail_in;
     lzma_end(&strm);
-    FIO_fwriteSparseEnd(prefs, ress->dstFile, storedSkips);
+    AIO_WritePool_sparseWriteEnd(ress->writeCtx);
     return decodingError ? FIO_ERROR_FRAME_DECODING : outFileSize;
 }
 #endif
 
 #ifdef ZSTD_LZ4DECOMPRESS
 static unsigned long long
-FIO_decompressLz4Frame(dRess_t* ress, FILE* srcFile,
-                       const FIO_prefs_t* const prefs,
-                       const char* srcFileName)
+FIO_decompressLz4Frame(dRess_t* ress, const char* srcFileName)
 {
     unsigned long long filesize = 0;
     LZ4F_errorCode_t nextToLoad;
     LZ4F_decompressionContext_t dCtx;
     LZ4F_errorCode_t const errorCode = LZ4F_createDecompressionContext(&dCtx, LZ4F_VERSION);
     int decodingError = 0;
-    unsigned storedSkips = 0;
 
     if (LZ4F_isError(errorCode)) {
         DISPLAYLEVEL(1, "zstd: failed to create lz4 decompression context \n");
@@ -2345,7 +2745,7 @@ FIO_decompressLz4Frame(dRess_t* ress, FILE* srcFile,
 
         /* Read input */
         if (nextToLoad > ress->srcBufferSize) nextToLoad = ress->srcBufferSize;
-        readSize = fread(ress->srcBuffer, 1, nextToLoad, srcFile);
+        readSize = AIO_ReadPool_read(ress->readCtx, ress->srcBuffer, nextToLoad);
         if (!readSize) break;   /* reached end of file or stream */
 
         while ((pos < readSize) || (decodedBytes == ress->dstBufferSize)) {  /* still to read, or still to flush */
@@ -2362,7 +2762,7 @@ FIO_decompressLz4Frame(dRess_t* ress, FILE* srcFile,
 
             /* Write Block */
             if (decodedBytes) {
-                storedSkips = FIO_fwriteSparse(ress->dstFile, ress->dstBuffer, decodedBytes, prefs, storedSkips);
+                AIO_WritePool_write(ress->writeCtx, ress->dstBuffer, decodedBytes);
                 filesize += decodedBytes;
                 DISPLAYUPDATE(2, "\rDecompressed : %u MB  ", (unsigned)(filesize>>20));
             }
@@ -2371,7 +2771,7 @@ FIO_decompressLz4Frame(dRess_t* ress, FILE* srcFile,
         }
     }
     /* can be out because readSize == 0, which could be an fread() error */
-    if (ferror(srcFile)) {
+    if (AIO_ReadPool_error(ress->readCtx)) {
         DISPLAYLEVEL(1, "zstd: %s: read error \n", srcFileName);
         decodingError=1;
     }
@@ -2383,7 +2783,7 @@ FIO_decompressLz4Frame(dRess_t* ress, FILE* srcFile,
 
     LZ4F_freeDecompressionContext(dCtx);
     ress->srcBufferLoaded = 0; /* LZ4F will reach exact frame boundary */
-    FIO_fwriteSparseEnd(prefs, ress->dstFile, storedSkips);
+    AIO_WritePool_sparseWriteEnd(ress->writeCtx);
 
     return decodingError ? FIO_ERROR_FRAME_DECODING : filesize;
 }
@@ -2393,18 +2793,17 @@ FIO_decompressLz4Frame(dRess_t* ress, FILE* srcFile,
 
 /** FIO_decompressFrames() :
  *  Find and decode frames inside srcFile
- *  srcFile presumed opened and valid
+ *  srcFile presumed opened, valid, and attached to ress.readCtx
  * @return : 0 : OK
  *           1 : error
  */
 static int FIO_decompressFrames(FIO_ctx_t* const fCtx,
-                          dRess_t ress, FILE* srcFile,
+                          dRess_t ress,
                           const FIO_prefs_t* const prefs,
                           const char* dstFileName, const char* srcFileName)
 {
     unsigned readSomething = 0;
     unsigned long long filesize = 0;
-    assert(srcFile != NULL);
 
     /* for each frame */
     for ( ; ; ) {
@@ -2412,8 +2811,8 @@ static int FIO_decompressFrames(FIO_ctx_t* const fCtx,
         size_t const toRead = 4;
         const BYTE* const buf = (const BYTE*)ress.srcBuffer;
         if (ress.srcBufferLoaded < toRead)  /* load up to 4 bytes for header */
-            ress.srcBufferLoaded += fread((char*)ress.srcBuffer + ress.srcBufferLoaded,
-                                          (size_t)1, toRead - ress.srcBufferLoaded, srcFile);
+            ress.srcBufferLoaded += AIO_ReadPool_read(ress.readCtx, (char*)ress.srcBuffer + ress.srcBufferLoaded,
+                                                      toRead - ress.srcBufferLoaded);
         if (ress.srcBufferLoaded==0) {
             if (readSomething==0) {  /* srcFile is empty (which is invalid) */
                 DISPLAYLEVEL(1, "zstd: %s: unexpected end of file \n", srcFileName);
@@ -2427,12 +2826,12 @@ static int FIO_decompressFrames(FIO_ctx_t* const fCtx,
             return 1;
         }
         if (ZSTD_isFrame(buf, ress.srcBufferLoaded)) {
-            unsigned long long const frameSize = FIO_decompressZstdFrame(fCtx, &ress, srcFile, prefs, srcFileName, filesize);
+            unsigned long long const frameSize = FIO_decompressZstdFrame(fCtx, &ress, prefs, srcFileName, filesize);
             if (frameSize == FIO_ERROR_FRAME_DECODING) return 1;
             filesize += frameSize;
         } else if (buf[0] == 31 && buf[1] == 139) { /* gz magic number */
 #ifdef ZSTD_GZDECOMPRESS
-            unsigned long long const frameSize = FIO_decompressGzFrame(&ress, srcFile, prefs, srcFileName);
+            unsigned long long const frameSize = FIO_decompressGzFrame(&ress, srcFileName);
             if (frameSize == FIO_ERROR_FRAME_DECODING) return 1;
             filesize += frameSize;
 #else
@@ -2442,7 +2841,7 @@ static int FIO_decompressFrames(FIO_ctx_t* const fCtx,
         } else if ((buf[0] == 0xFD && buf[1] == 0x37)  /* xz magic number */
                 || (buf[0] == 0x5D && buf[1] == 0x00)) { /* lzma header (no magic number) */
 #ifdef ZSTD_LZMADECOMPRESS
-            unsigned long long const frameSize = FIO_decompressLzmaFrame(&ress, srcFile, prefs, srcFileName, buf[0] != 0xFD);
+            unsigned long long const frameSize = FIO_decompressLzmaFrame(&ress, srcFileName, buf[0] != 0xFD);
             if (frameSize == FIO_ERROR_FRAME_DECODING) return 1;
             filesize += frameSize;
 #else
@@ -2451,7 +2850,7 @@ static int FIO_decompressFrames(FIO_ctx_t* const fCtx,
 #endif
         } else if (MEM_readLE32(buf) == LZ4_MAGICNUMBER) {
 #ifdef ZSTD_LZ4DECOMPRESS
-            unsigned long long const frameSize = FIO_decompressLz4Frame(&ress, srcFile, prefs, srcFileName);
+            unsigned long long const frameSize = FIO_decompressLz4Frame(&ress, srcFileName);
             if (frameSize == FIO_ERROR_FRAME_DECODING) return 1;
             filesize += frameSize;
 #else
@@ -2459,10 +2858,7 @@ static int FIO_decompressFrames(FIO_ctx_t* const fCtx,
             return 1;
 #endif
         } else if ((prefs->overwrite) && !strcmp (dstFileName, stdoutmark)) {  /* pass-through mode */
-            return FIO_passThrough(prefs,
-                                   ress.dstFile, srcFile,
-                                   ress.srcBuffer, ress.srcBufferSize,
-                                   ress.srcBufferLoaded);
+            return FIO_passThrough(&ress);
         } else {
             DISPLAYLEVEL(1, "zstd: %s: unsupported format \n", srcFileName);
             return 1;
@@ -2490,7 +2886,7 @@ static int FIO_decompressFrames(FIO_ctx_t* const fCtx,
 */
 static int FIO_decompressDstFile(FIO_ctx_t* const fCtx,
                                  FIO_prefs_t* const prefs,
-                                 dRess_t ress, FILE* srcFile,
+                                 dRess_t ress,
                                  const char* dstFileName, const char* srcFileName)
 {
     int result;
@@ -2503,6 +2899,7 @@ static int FIO_decompressDstFile(FIO_ctx_t* const fCtx,
 
         ress.dstFile = FIO_openDstFile(fCtx, prefs, srcFileName, dstFileName);
         if (ress.dstFile==NULL) return 1;
+        AIO_WritePool_setFile(ress.writeCtx, ress.dstFile);
 
         /* Must only be added after FIO_openDstFile() succeeds.
          * Otherwise we may delete the destination file if it already exists,
@@ -2516,10 +2913,11 @@ static int FIO_decompressDstFile(FIO_ctx_t* const fCtx,
             transfer_permissions = 1;
     }
 
-    result = FIO_decompressFrames(fCtx, ress, srcFile, prefs, dstFileName, srcFileName);
+    result = FIO_decompressFrames(fCtx, ress, prefs, dstFileName, srcFileName);
 
     if (releaseDstFile) {
         FILE* const dstFile = ress.dstFile;
+        AIO_WritePool_setFile(ress.writeCtx, NULL);
         clearHandler();
         ress.dstFile = NULL;
         if (fclose(dstFile)) {
@@ -2558,10 +2956,12 @@ static int FIO_decompressSrcFile(FIO_ctx_t* const fCtx, FIO_prefs_t* const prefs
     srcFile = FIO_openSrcFile(srcFileName);
     if (srcFile==NULL) return 1;
     ress.srcBufferLoaded = 0;
+    AIO_ReadPool_setFile(ress.readCtx, srcFile);
 
-    result = FIO_decompressDstFile(fCtx, prefs, ress, srcFile, dstFileName, srcFileName);
+    result = FIO_decompressDstFile(fCtx, prefs, ress, dstFileName, srcFileName);
 
     /* Close file */
+    AIO_ReadPool_setFile(ress.readCtx, NULL);
     if (fclose(srcFile)) {
         DISPLAYLEVEL(1, "zstd: %s: %s \n", srcFileName, strerror(errno));  /* error should not happen */
         return 1;
@@ -2736,12 +3136,14 @@ FIO_decompressMultipleFilenames(FIO_ctx_t* const fCtx,
         if (!prefs->testMode) {
             ress.dstFile = FIO_openDstFile(fCtx, prefs, NULL, outFileName);
             if (ress.dstFile == 0) EXM_THROW(19, "cannot open %s", outFileName);
+            AIO_WritePool_setFile(ress.writeCtx, ress.dstFile);
         }
         for (; fCtx->currFileIdx < fCtx->nbFilesTotal; fCtx->currFileIdx++) {
             status = FIO_decompressSrcFile(fCtx, prefs, ress, outFileName, srcNamesTable[fCtx->currFileIdx]);
             if (!status) fCtx->nbFilesProcessed++;
             error |= status;
         }
+        AIO_WritePool_setFile(ress.writeCtx, NULL);
         if ((!prefs->testMode) && (fclose(ress.dstFile)))
             EXM_THROW(72, "Write error : %s : cannot properly close output file",
                         strerror(errno));
@@ -102,6 +102,7 @@ void FIO_setLiteralCompressionMode(
 void FIO_setNoProgress(unsigned noProgress);
 void FIO_setNotificationLevel(int level);
 void FIO_setExcludeCompressedFile(FIO_prefs_t* const prefs, int excludeCompressedFiles);
+void FIO_setAsyncIOFlag(FIO_prefs_t* const prefs, int asyncIO);  /**< 0: plain fread/fwrite; 1: reader and writer threads (default with ZSTD_MULTITHREAD) */
 void FIO_setPatchFromMode(FIO_prefs_t* const prefs, int value);
 void FIO_setContentSize(FIO_prefs_t* const prefs, int value);
 
@@ -155,6 +155,9 @@ static void usage_advanced(const char* programName)
 #ifdef UTIL_HAS_MIRRORFILELIST
     DISPLAYOUT( "--output-dir-mirror DIR : processed files are stored into DIR respecting original directory structure \n");
 #endif
+#ifdef ZSTD_MULTITHREAD
+    DISPLAYOUT( "--[no-]asyncio : overlap file reads and writes with (de)compression using I/O threads (default: enabled) \n");
+#endif
 
 
 #ifndef ZSTD_NOCOMPRESS
@@ -237,6 +240,7 @@ static void usage_advanced(const char* programName)
     DISPLAYOUT( " -i#    : minimum evaluation time in seconds (default: 3s) \n");
     DISPLAYOUT( " -B#    : cut file into independent blocks of size # (default: no block) \n");
     DISPLAYOUT( " -S     : output one benchmark result per input file (default: consolidated result) \n");
+    DISPLAYOUT( "--bench-io : benchmark end-to-end file (de)compression throughput, with sync then async I/O \n");
     DISPLAYOUT( "--priority=rt : set process priority to real-time \n");
 #endif
 
@@ -708,6 +712,7 @@ int main(int const argCount, const char* argv[])
         nextArgumentsAreFiles = 0,
         operationResult = 0,
         separateFiles = 0,
+        benchIO = 0,
         setRealTimePrio = 0,
         singleThread = 0,
         showDefaultCParams = 0,
@@ -818,6 +823,9 @@ int main(int const argCount, const char* argv[])
                 if (!strcmp(argument, "--no-check")) { FIO_setChecksumFlag(prefs, 0); continue; }
                 if (!strcmp(argument, "--sparse")) { FIO_setSparseWrite(prefs, 2); continue; }
                 if (!strcmp(argument, "--no-sparse")) { FIO_setSparseWrite(prefs, 0); continue; }
+                if (!strcmp(argument, "--asyncio")) { FIO_setAsyncIOFlag(prefs, 1); continue; }
+                if (!strcmp(argument, "--no-asyncio")) { FIO_setAsyncIOFlag(prefs, 0); continue; }
+                if (!strcmp(argument, "--bench-io")) { operation=zom_bench; benchIO=1; continue; }
                 if (!strcmp(argument, "--test")) { operation=zom_test; continue; }
                 if (!strcmp(argument, "--train")) { operation=zom_train; if (outFileName==NULL) outFileName=g_defaultDictName; continue; }
                 if (!strcmp(argument, "--no-dictID")) { FIO_setDictIDFlag(prefs, 0); continue; }
@@ -1177,7 +1185,15 @@ int main(int const argCount, const char* argv[])
         if (cLevelLast < cLevel) cLevelLast = cLevel;
         if (cLevelLast > cLevel)
             DISPLAYLEVEL(3, "Benchmarking levels from %d to %d\n", cLevel, cLevelLast);
-        if (filenames->tableSize > 0) {
+        if (benchIO) {
+            if (filenames->tableSize == 0) {
+                DISPLAYLEVEL(1, "--bench-io requires input files \n");
+                CLEAN_RETURN(1);
+            }
+            for(; cLevel <= cLevelLast; cLevel++) {
+                BMK_benchFilesIO(filenames->fileNames, (unsigned)filenames->tableSize, dictFileName, cLevel, &compressionParams, g_displayLevel, &benchParams);
+            }
+        } else if (filenames->tableSize > 0) {
             if(separateFiles) {
                 unsigned i;
                 for(i = 0; i < filenames->tableSize; i++) {
@@ -1196,7 +1212,7 @@ int main(int const argCount, const char* argv[])
         }   }
 
 #else
-        (void)bench_nbSeconds; (void)blockSize; (void)setRealTimePrio; (void)separateFiles; (void)compressibility;
+        (void)bench_nbSeconds; (void)blockSize; (void)setRealTimePrio; (void)separateFiles; (void)benchIO; (void)compressibility;
 #endif
         goto _end;
     }
@@ -0,0 +1,200 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Benchmark for std::atomic<T>::wait and notify in libc++, against the
+ * timed backoff that libc++ falls back to where it has no way to block on
+ * an address: poll 64 times, then yield, then sleep for up to 8 ms at a
+ * time.
+ *
+ * Two threads first hand a counter back and forth, which gives the latency
+ * of a wake.  Then a number of threads wait on one atomic for a while
+ * before they are all notified, which gives the CPU time that idle waiters
+ * burn and how long it takes for the last of them to notice the change.
+ */
+
+#include <sys/resource.h>
+
+#include <err.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static void
+backoffWait(const std::atomic<uint32_t> &A, uint32_t Old)
+{
+	Clock::time_point Start = Clock::now();
+
+	for (int I = 0; I < 64; ++I)
+		if (A.load(std::memory_order_acquire) != Old)
+			return;
+	while (A.load(std::memory_order_acquire) == Old) {
+		Clock::duration Elapsed = Clock::now() - Start;
+		if (Elapsed > std::chrono::milliseconds(128))
+			std::this_thread::sleep_for(std::chrono::milliseconds(8));
+		else if (Elapsed > std::chrono::microseconds(64))
+			std::this_thread::sleep_for(Elapsed / 2);
+		else if (Elapsed > std::chrono::microseconds(4))
+			std::this_thread::yield();
+	}
+}
+
+static void
+wait(const std::atomic<uint32_t> &A, uint32_t Old, bool Backoff)
+{
+
+	if (Backoff)
+		backoffWait(A, Old);
+	else
+		A.wait(Old, std::memory_order_acquire);
+}
+
+static void
+notifyAll(std::atomic<uint32_t> &A, bool Backoff)
+{
+
+	if (!Backoff)
+		A.notify_all();
+}
+
+/* CPU time used by the process, in seconds. */
+static double
+cpuTime(void)
+{
+	struct rusage RU;
+
+	if (getrusage(RUSAGE_SELF, &RU) != 0)
+		err(1, "getrusage");
+	return (RU.ru_utime.tv_sec + RU.ru_stime.tv_sec +
+	    (RU.ru_utime.tv_usec + RU.ru_stime.tv_usec) / 1e6);
+}
+
+static void
+pingPong(unsigned N, bool Backoff)
+{
+	std::atomic<uint32_t> A(0);
+	double CPU = cpuTime();
+	Clock::time_point Start = Clock::now();
+
+	std::thread T([&] {
+		for (uint32_t I = 0; I < N; ++I) {
+			wait(A, 2 * I, Backoff);
+			A.store(2 * I + 2, std::memory_order_release);
+			notifyAll(A, Backoff);
+		}
+	});
+	for (uint32_t I = 0; I < N; ++I) {
+		A.store(2 * I + 1, std::memory_order_release);
+		notifyAll(A, Backoff);
+		wait(A, 2 * I + 1, Backoff);
+	}
+	T.join();
+
+	double NS = std::chrono::duration<double, std::nano>(Clock::now() -
+	    Start).count();
+	printf("%-8s ping-pong: %.0f ns and %.0f ns of CPU per round trip\n",
+	    Backoff ? "backoff" : "wait", NS / N, (cpuTime() - CPU) * 1e9 / N);
+}
+
+static void
+idle(unsigned Threads, unsigned MS, bool Backoff)
+{
+	std::atomic<uint32_t> A(0);
+	std::atomic<unsigned> Woken(0);
+	std::vector<std::thread> T;
+
+	for (unsigned I = 0; I < Threads; ++I)
+		T.emplace_back([&] {
+			wait(A, 0, Backoff);
+			Woken.fetch_add(1, std::memory_order_release);
+		});
+	double CPU = cpuTime();
+	std::this_thread::sleep_for(std::chrono::milliseconds(MS));
+	CPU = cpuTime() - CPU;
+
+	Clock::time_point Start = Clock::now();
+	A.store(1, std::memory_order_release);
+	notifyAll(A, Backoff);
+	while (Woken.load(std::memory_order_acquire) != Threads)
+		std::this_thread::yield();
+	double US = std::chrono::duration<double, std::micro>(Clock::now() -
+	    Start).count();
+	for (std::thread &Th : T)
+		Th.join();
+
+	printf("%-8s %u idle waiters: %.1f ms of CPU in %u ms, "
+	    "all awake after %.0f us\n", Backoff ? "backoff" : "wait",
+	    Threads, CPU * 1e3, MS, US);
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "atomicwaitbench [-d ms] [-n round-trips] [-t threads]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned MS = 1000, N = 100000, Threads = 16;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "d:n:t:")) != -1) {
+		switch (ch) {
+		case 'd':
+			MS = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			N = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			Threads = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (N == 0)
+		usage();
+
+	for (bool Backoff : {false, true}) {
+		pingPong(N, Backoff);
+		idle(Threads, MS, Backoff);
+	}
+	return (0);
+}
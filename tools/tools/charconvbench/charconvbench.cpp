@@ -0,0 +1,219 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Benchmark for the floating-point std::to_chars and std::from_chars in
+ * libc++, against the printf and strtod calls they replace.  The values
+ * are a mix of random bit patterns, numbers with a few decimal digits, as
+ * found in configuration and JSON files, and integers.
+ *
+ * Output is timed in the shortest round-trip form, against "%.17g", which
+ * is what it takes to round-trip with printf, and in fixed notation with six
+ * digits after the point, as std::to_string gives, for the values below
+ * 10^9.  Input is timed on the shortest forms.  Every value is checked to
+ * read back unchanged.
+ *
+ * With -x, every finite float is instead written in its shortest form and
+ * read back, with both std::from_chars and strtof.
+ */
+
+#include <err.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static volatile double Sink;
+
+static std::vector<double>
+makeValues(std::mt19937_64 &R, unsigned N)
+{
+	std::vector<double> V;
+	double D;
+
+	while (V.size() < N) {
+		switch (R() % 3) {
+		case 0: {
+			uint64_t Bits = R();
+			memcpy(&D, &Bits, sizeof(D));
+			break;
+		}
+		case 1:
+			D = (double)(int64_t)(R() % 2000000 - 1000000) /
+			    pow(10, R() % 7);
+			break;
+		default:
+			D = (double)(R() % 100000);
+			break;
+		}
+		if (std::isfinite(D))
+			V.push_back(D);
+	}
+	return (V);
+}
+
+template <class F>
+static double
+timeNS(unsigned Rounds, size_t N, F Fn)
+{
+	auto Start = std::chrono::steady_clock::now();
+
+	for (unsigned Round = 0; Round < Rounds; ++Round)
+		Fn();
+	return (std::chrono::duration<double, std::nano>(
+	    std::chrono::steady_clock::now() - Start).count() /
+	    ((double)Rounds * N));
+}
+
+static int
+exhaustive(void)
+{
+	char Buf[64];
+	uint64_t Failed = 0;
+
+	for (uint64_t I = 0; I < UINT64_C(1) << 32; ++I) {
+		uint32_t Bits = (uint32_t)I;
+		float F, G;
+
+		memcpy(&F, &Bits, sizeof(F));
+		if (!std::isfinite(F))
+			continue;
+		std::to_chars_result TR = std::to_chars(Buf, Buf + sizeof(Buf) - 1,
+		    F);
+		*TR.ptr = '\0';
+		std::from_chars_result FR = std::from_chars(Buf, TR.ptr, G);
+		if (FR.ec != std::errc() || FR.ptr != TR.ptr ||
+		    memcmp(&F, &G, sizeof(F)) != 0 ||
+		    strtof(Buf, NULL) != F) {
+			if (Failed++ < 10)
+				warnx("%#010x: %s", Bits, Buf);
+		}
+	}
+	printf("%ju floats did not round-trip\n", (uintmax_t)Failed);
+	return (Failed != 0);
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "charconvbench [-x] [-n values] [-r rounds]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned N = 1000000, Rounds = 3;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:r:x")) != -1) {
+		switch (ch) {
+		case 'n':
+			N = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			Rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 'x':
+			return (exhaustive());
+		default:
+			usage();
+		}
+	}
+	if (N == 0 || Rounds == 0)
+		usage();
+
+	std::mt19937_64 R(1);
+	std::vector<double> Values = makeValues(R, N);
+	std::vector<char> Out(N * 32);
+	std::vector<char *> Ends(N);
+	char Buf[400];
+
+	double Shortest = timeNS(Rounds, N, [&] {
+		char *P = Out.data();
+		for (unsigned I = 0; I < N; ++I) {
+			P = std::to_chars(P, P + 32, Values[I]).ptr;
+			Ends[I] = P;
+		}
+	});
+	double Printf17 = timeNS(Rounds, N, [&] {
+		for (unsigned I = 0; I < N; ++I)
+			Sink = snprintf(Buf, sizeof(Buf), "%.17g", Values[I]);
+	});
+
+	std::vector<double> Small;
+	for (double D : Values)
+		if (fabs(D) < 1e9)
+			Small.push_back(D);
+	double Fixed = timeNS(Rounds, Small.size(), [&] {
+		for (double D : Small)
+			Sink = std::to_chars(Buf, Buf + sizeof(Buf), D,
+			    std::chars_format::fixed, 6).ptr - Buf;
+	});
+	double PrintfF = timeNS(Rounds, Small.size(), [&] {
+		for (double D : Small)
+			Sink = snprintf(Buf, sizeof(Buf), "%f", D);
+	});
+
+	unsigned Mismatches = 0;
+	double FromChars = timeNS(Rounds, N, [&] {
+		const char *P = Out.data();
+		for (unsigned I = 0; I < N; ++I) {
+			double D;
+			std::from_chars(P, Ends[I], D);
+			Mismatches += D != Values[I];
+			P = Ends[I];
+		}
+	});
+	std::vector<std::string> Strings;
+	for (unsigned I = 0; I < N; ++I)
+		Strings.emplace_back(I == 0 ? Out.data() : Ends[I - 1], Ends[I]);
+	double Strtod = timeNS(Rounds, N, [&] {
+		for (unsigned I = 0; I < N; ++I)
+			Sink = strtod(Strings[I].c_str(), NULL);
+	});
+
+	printf("%u values, %zu bytes shortest\n", N,
+	    (size_t)(Ends[N - 1] - Out.data()));
+	printf("to_chars shortest %.1f ns, snprintf %%.17g %.1f ns\n",
+	    Shortest, Printf17);
+	printf("to_chars fixed 6 %.1f ns, snprintf %%f %.1f ns\n", Fixed,
+	    PrintfF);
+	printf("from_chars %.1f ns, strtod %.1f ns\n", FromChars, Strtod);
+	printf("%u values did not round-trip\n", Mismatches / Rounds);
+	return (Mismatches != 0);
+}
@@ -0,0 +1,196 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Microbenchmark for tcpdump's in_cksum().  The routine is first checked
+ * against a byte-at-a-time sum for random vectors of one to five chunks,
+ * with odd lengths and odd start addresses.  Then packets of common
+ * sizes, from minimum-sized frames to jumbo frames, are summed the way
+ * the TCP and UDP printers do it: a 12-byte pseudo-header followed by
+ * the segment.  Ethernet-sized packets start at an odd offset (-o) to
+ * exercise the unaligned case as well.
+ */
+
+#include <netdissect-stdinc.h>
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "netdissect.h"
+
+#define	MAXPKT		65535
+#define	NCHECKS		100000
+
+static const int sizes[] = {
+	64, 128, 256, 512, 576, 1024, 1500, 4096, 9000, 16384, 65535
+};
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "cksumbench [-n megabytes] [-o offset] [-s size]\n");
+	exit(-1);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/*
+ * The checksum, a byte at a time, in network byte order.
+ */
+static uint16_t
+ref_cksum(const struct cksum_vec *vec, int veclen)
+{
+	uint64_t sum = 0;
+	size_t k = 0;
+	int i, j;
+
+	for (i = 0; i < veclen; i++)
+		for (j = 0; j < vec[i].len; j++, k++)
+			sum += (k & 1) ? vec[i].ptr[j] :
+			    (uint32_t)vec[i].ptr[j] << 8;
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return (htons(~sum & 0xffff));
+}
+
+static void
+check(u_char *buf)
+{
+	struct cksum_vec vec[5];
+	uint16_t got, want;
+	int i, j, n, len;
+	size_t off;
+
+	for (i = 0; i < NCHECKS; i++) {
+		/* Some all-ones data, to catch carries that get lost. */
+		if (i % 10 == 0)
+			memset(buf, 0xff, 2 * MAXPKT);
+		else if (i % 10 == 1)
+			for (j = 0; j < 2 * MAXPKT; j++)
+				buf[j] = (u_char)random();
+		n = 1 + random() % 5;
+		off = random() % 64;
+		for (j = 0; j < n; j++) {
+			len = random() % (i % 100 == 0 ? MAXPKT / n : 3000);
+			vec[j].ptr = buf + off;
+			vec[j].len = len;
+			off += len + random() % 8;
+		}
+		got = in_cksum(vec, n);
+		want = ref_cksum(vec, n);
+		if (got != want)
+			errx(1, "mismatch: %d chunks, first %d bytes at +%zu: "
+			    "got %04x, want %04x", n, vec[0].len,
+			    (size_t)(vec[0].ptr - buf), got, want);
+	}
+}
+
+static void
+bench(const u_char *pkt, int size, double megabytes)
+{
+	struct cksum_vec vec[2];
+	uint8_t phdr[12];
+	volatile uint16_t sink;
+	double start, secs;
+	long i, iters;
+
+	memset(phdr, 0x5a, sizeof(phdr));
+	vec[0].ptr = phdr;
+	vec[0].len = sizeof(phdr);
+	vec[1].ptr = pkt;
+	vec[1].len = size;
+	iters = megabytes * 1024 * 1024 / size;
+	if (iters < 1)
+		iters = 1;
+
+	start = now();
+	for (i = 0; i < iters; i++)
+		sink = in_cksum(vec, 2);
+	secs = now() - start;
+	(void)sink;
+
+	printf("%6d bytes: %9.1f ns/packet %8.2f GB/s\n", size,
+	    secs * 1e9 / iters, (double)iters * size / secs / 1e9);
+}
+
+int
+main(int argc, char *argv[])
+{
+	u_char *buf;
+	double megabytes = 1024;
+	int ch, i, offset = 1, size = 0;
+
+	while ((ch = getopt(argc, argv, "n:o:s:")) != -1) {
+		switch (ch) {
+		case 'n':
+			megabytes = atof(optarg);
+			break;
+		case 'o':
+			offset = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (megabytes <= 0 || offset < 0 || offset > 63 || size < 0 ||
+	    size > MAXPKT || optind != argc)
+		usage();
+
+	buf = malloc(2 * MAXPKT + 64);
+	if (buf == NULL)
+		err(-1, "malloc");
+	srandom(1);
+	check(buf);
+	printf("in_cksum: %d random vectors checked\n", NCHECKS);
+
+	for (i = 0; i < 2 * MAXPKT + 64; i++)
+		buf[i] = (u_char)random();
+	if (size != 0)
+		bench(buf + offset, size, megabytes);
+	else
+		for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+			bench(buf + offset, sizes[i], megabytes);
+	free(buf);
+	return (0);
+}
@@ -0,0 +1,251 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Compression benchmark for llvm::compression, on the kind of input it
+ * mostly sees: DWARF debug sections.  Give it a section to work on, e.g.
+ *
+ *	objcopy --dump-section .debug_info=debug_info.bin clang
+ *	compressbench -f debug_info.bin
+ *
+ * or let it make up a .debug_info-like stream of DIEs: abbreviation codes,
+ * string offsets, nearby references, rising addresses and line numbers.
+ * Every available codec is run at its fast, default and best levels, and
+ * zstd once more with -j threads.
+ */
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <err.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static void
+put(std::string &S, uint64_t V, unsigned Bytes)
+{
+
+	for (unsigned I = 0; I < Bytes; ++I)
+		S.push_back(char(V >> (8 * I)));
+}
+
+static void
+putULEB(std::string &S, uint64_t V)
+{
+
+	do {
+		uint8_t B = V & 0x7f;
+		V >>= 7;
+		S.push_back(char(V ? B | 0x80 : B));
+	} while (V);
+}
+
+static std::string
+makeDebugInfo(size_t Size)
+{
+	std::mt19937_64 R(1);
+	std::geometric_distribution<unsigned> Few(0.3), Some(0.02);
+	std::vector<uint32_t> Names, Types;
+	std::string S;
+	uint64_t Addr = 0x201000, Line = 1;
+
+	/* Names and types are mostly reused, as in real debug info. */
+	for (unsigned I = 0; I < 4096; ++I)
+		Names.push_back(R() % (1 << 22));
+	for (unsigned I = 0; I < 512; ++I)
+		Types.push_back(R() % (1 << 20));
+
+	S.reserve(Size + 64);
+	while (S.size() < Size) {
+		/* A handful of abbreviations cover most DIEs. */
+		unsigned Abbrev = Few(R);
+		putULEB(S, Abbrev % 40 + 1);
+		switch (Abbrev % 5) {
+		case 0:		/* subprogram: name, decl_line, low_pc, high_pc */
+			put(S, Names[Some(R) % Names.size()], 4);
+			Line += Few(R) * 4;
+			put(S, Line, 2);
+			Addr += 16 * (1 + Some(R));
+			put(S, Addr, 8);
+			put(S, 16 * (1 + Few(R)), 4);
+			break;
+		case 1:		/* variable: name, type, decl_line, location */
+			put(S, Names[Some(R) % Names.size()], 4);
+			put(S, Types[Few(R) % Types.size()], 4);
+			put(S, Line + Few(R), 2);
+			S.push_back(2);
+			S.push_back(char(0x91));
+			putULEB(S, 8 * Few(R));
+			break;
+		case 2:		/* formal_parameter: type, name */
+			put(S, Types[Few(R) % Types.size()], 4);
+			put(S, Names[Few(R) % Names.size()], 4);
+			break;
+		case 3:		/* member: name, type, data_member_location */
+			put(S, Names[Some(R) % Names.size()], 4);
+			put(S, Types[Few(R) % Types.size()], 4);
+			S.push_back(char(8 * Few(R)));
+			break;
+		default:	/* end of children */
+			S.push_back(0);
+			break;
+		}
+	}
+	S.resize(Size);
+	return (S);
+}
+
+static double
+seconds(std::chrono::steady_clock::time_point Start)
+{
+
+	return (std::chrono::duration<double>(
+	    std::chrono::steady_clock::now() - Start).count());
+}
+
+static void
+run(StringRef Input, compression::Params P, unsigned Threads, unsigned Rounds)
+{
+	SmallVector<char, 0> Compressed, Uncompressed;
+	double CTime = 0, DTime = 0;
+
+	for (unsigned I = 0; I < Rounds; ++I) {
+		Compressed.clear();
+		auto Start = std::chrono::steady_clock::now();
+		if (Error E = compression::compress(P, Input, Compressed,
+		    Threads))
+			errx(1, "compress: %s", toString(std::move(E)).c_str());
+		CTime += seconds(Start);
+
+		Uncompressed.clear();
+		Start = std::chrono::steady_clock::now();
+		if (Error E = compression::uncompress(P.format,
+		    StringRef(Compressed.data(), Compressed.size()),
+		    Uncompressed, Input.size()))
+			errx(1, "uncompress: %s",
+			    toString(std::move(E)).c_str());
+		DTime += seconds(Start);
+	}
+	if (Uncompressed.size() != Input.size() ||
+	    memcmp(Uncompressed.data(), Input.data(), Input.size()) != 0)
+		errx(1, "%s level %d: round trip mismatch",
+		    compression::getName(P.format), P.level);
+
+	double MB = Input.size() / 1e6 * Rounds;
+	printf("%-4s %3d %2u thr  ratio %5.2f  compress %8.1f MB/s  "
+	    "uncompress %8.1f MB/s\n", compression::getName(P.format),
+	    P.level, Threads, double(Input.size()) / Compressed.size(),
+	    MB / CTime, MB / DTime);
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "compressbench [-f file | -s megabytes] [-j threads] "
+	    "[-r rounds]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *File = NULL;
+	unsigned Threads = 4, Rounds = 3;
+	size_t Size = 64;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "f:j:r:s:")) != -1) {
+		switch (ch) {
+		case 'f':
+			File = optarg;
+			break;
+		case 'j':
+			Threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			Rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			Size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (Rounds == 0 || Size == 0)
+		usage();
+
+	std::unique_ptr<MemoryBuffer> Buffer;
+	std::string Generated;
+	StringRef Input;
+	if (File != NULL) {
+		auto BufferOrErr = MemoryBuffer::getFile(File);
+		if (!BufferOrErr)
+			errx(1, "%s: %s", File,
+			    BufferOrErr.getError().message().c_str());
+		Buffer = std::move(*BufferOrErr);
+		Input = Buffer->getBuffer();
+	} else {
+		Generated = makeDebugInfo(Size << 20);
+		Input = Generated;
+	}
+	printf("%zu bytes of %s\n", Input.size(),
+	    File != NULL ? File : "generated .debug_info");
+
+	if (compression::isAvailable(compression::Format::Zlib)) {
+		for (int Level : {zlib::BestSpeedCompression,
+		    zlib::DefaultCompression, zlib::BestSizeCompression})
+			run(Input, {compression::Format::Zlib, Level}, 0,
+			    Rounds);
+	}
+	if (compression::isAvailable(compression::Format::Zstd)) {
+		for (int Level : {zstd::BestSpeedCompression,
+		    zstd::DefaultCompression, zstd::BestSizeCompression})
+			run(Input, {compression::Format::Zstd, Level}, 0,
+			    Rounds);
+		if (Threads > 0)
+			run(Input, compression::Format::Zstd, Threads,
+			    Rounds);
+	}
+
+	return (0);
+}
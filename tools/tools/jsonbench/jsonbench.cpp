@@ -0,0 +1,250 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Benchmark for reading large JSON files with llvm::json, such as the
+ * compile_commands.json of a big tree or a -ftime-trace profile.  Each
+ * file is parsed both into a json::Value and into a json::Document, and
+ * then walked the way a tool would: every entry's "file" and "command",
+ * or every event's "name" and "dur".
+ *
+ * Without -f, a compilation database with -n entries is generated.  The
+ * output ends with a count and checksum of what the walk found, which
+ * must be the same for both kinds of parse.
+ */
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/JSONDocument.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <err.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+using namespace llvm;
+
+static const char *Words[] = {
+	"alloc", "buffer", "cache", "decode", "entry", "frame", "graph",
+	"hash", "index", "json", "kernel", "lexer", "mutex", "node", "object",
+	"parser", "queue", "render", "socket", "thread", "unwind", "vector",
+	"worker", "xml", "yield", "zone",
+};
+
+static std::string
+name(std::mt19937 &R)
+{
+
+	return (std::string(Words[R() % (sizeof(Words) / sizeof(Words[0]))]) +
+	    std::to_string(R() % 100));
+}
+
+static std::string
+makeDatabase(std::mt19937 &R, unsigned Entries)
+{
+	std::string S = "[\n";
+
+	for (unsigned I = 0; I < Entries; ++I) {
+		std::string Dir = "/usr/obj/usr/src/amd64.amd64/lib/" + name(R);
+		std::string File = "/usr/src/lib/" + name(R) + "/" + name(R) +
+		    ".cpp";
+		std::string Cmd = "/usr/bin/c++ -target x86_64-unknown-freebsd14.0"
+		    " -O2 -pipe -fstack-protector-strong -g -std=c++17"
+		    " -DNDEBUG -DHAVE_CONFIG_H";
+		for (unsigned J = 0; J < 8; ++J)
+			Cmd += " -I/usr/src/contrib/" + name(R) + "/include";
+		for (unsigned J = 0; J < 4; ++J)
+			Cmd += " -D" + name(R) + "=" + std::to_string(R() % 10);
+		if (R() % 4 == 0)
+			Cmd += " -DVERSION=\\\"" + name(R) + "\\\"";
+		Cmd += " -c " + File + " -o " + name(R) + ".o";
+		S += "{\n  \"directory\": \"" + Dir + "\",\n  \"command\": \"" +
+		    Cmd + "\",\n  \"file\": \"" + File + "\",\n  \"output\": \"" +
+		    name(R) + ".o\"\n}";
+		S += I + 1 < Entries ? ",\n" : "\n";
+	}
+	S += "]\n";
+	return (S);
+}
+
+struct Result {
+	unsigned	Count = 0;
+	uint64_t	Sum = 0;
+};
+
+/*
+ * A compilation database is an array of objects; a time trace is an object
+ * with an array of objects called "traceEvents".
+ */
+static Result
+walk(const json::Value &V)
+{
+	Result Res;
+	const json::Array *A = V.getAsArray();
+
+	if (const json::Object *O = V.getAsObject())
+		A = O->getArray("traceEvents");
+	if (A == nullptr)
+		errx(1, "not a compilation database or time trace");
+	for (const json::Value &E : *A) {
+		const json::Object *O = E.getAsObject();
+		if (O == nullptr)
+			continue;
+		Res.Count++;
+		for (StringRef Key : {"file", "command", "name"})
+			if (Optional<StringRef> S = O->getString(Key))
+				Res.Sum += S->size();
+		if (Optional<int64_t> Dur = O->getInteger("dur"))
+			Res.Sum += *Dur;
+	}
+	return (Res);
+}
+
+static Result
+walk(json::Document::Node N)
+{
+	Result Res;
+	Optional<json::Document::Node> A = N;
+
+	if (N.kind() == json::Document::Object)
+		A = N.get("traceEvents");
+	if (!A || A->kind() != json::Document::Array)
+		errx(1, "not a compilation database or time trace");
+	for (json::Document::Node E : A->elements()) {
+		if (E.kind() != json::Document::Object)
+			continue;
+		Res.Count++;
+		for (const auto &M : E.members()) {
+			if (M.first == "file" || M.first == "command" ||
+			    M.first == "name") {
+				if (Optional<StringRef> S = M.second.getAsString())
+					Res.Sum += S->size();
+			} else if (M.first == "dur") {
+				if (Optional<int64_t> Dur = M.second.getAsInteger())
+					Res.Sum += *Dur;
+			}
+		}
+	}
+	return (Res);
+}
+
+static double
+since(std::chrono::steady_clock::time_point Start)
+{
+
+	return (std::chrono::duration<double, std::milli>(
+	    std::chrono::steady_clock::now() - Start).count());
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "jsonbench [-f file | -n entries] [-r rounds]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *Path = nullptr;
+	unsigned Entries = 50000, Rounds = 5;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "f:n:r:")) != -1) {
+		switch (ch) {
+		case 'f':
+			Path = optarg;
+			break;
+		case 'n':
+			Entries = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			Rounds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (Rounds == 0)
+		usage();
+
+	std::string Text;
+	if (Path != nullptr) {
+		ErrorOr<std::unique_ptr<MemoryBuffer>> MB =
+		    MemoryBuffer::getFile(Path);
+		if (!MB)
+			errx(1, "%s: %s", Path, MB.getError().message().c_str());
+		Text = (*MB)->getBuffer().str();
+	} else {
+		std::mt19937 R(1);
+		Text = makeDatabase(R, Entries);
+	}
+
+	double ValueParse = 0, ValueWalk = 0, DocParse = 0, DocWalk = 0;
+	Result ValueRes, DocRes;
+	for (unsigned Round = 0; Round < Rounds; ++Round) {
+		auto Start = std::chrono::steady_clock::now();
+		Expected<json::Value> V = json::parse(Text);
+		if (!V)
+			errx(1, "%s", toString(V.takeError()).c_str());
+		ValueParse += since(Start);
+		Start = std::chrono::steady_clock::now();
+		ValueRes = walk(*V);
+		ValueWalk += since(Start);
+
+		Start = std::chrono::steady_clock::now();
+		Expected<json::Document> D = json::Document::parse(Text);
+		if (!D)
+			errx(1, "%s", toString(D.takeError()).c_str());
+		DocParse += since(Start);
+		Start = std::chrono::steady_clock::now();
+		DocRes = walk(D->root());
+		DocWalk += since(Start);
+	}
+
+	double MB = Text.size() / 1e6;
+	printf("%.1f MB: json::Value    parse %7.1f ms (%6.1f MB/s), "
+	    "walk %6.1f ms\n", MB, ValueParse / Rounds,
+	    MB * 1e3 * Rounds / ValueParse, ValueWalk / Rounds);
+	printf("%.1f MB: json::Document parse %7.1f ms (%6.1f MB/s), "
+	    "walk %6.1f ms\n", MB, DocParse / Rounds,
+	    MB * 1e3 * Rounds / DocParse, DocWalk / Rounds);
+	printf("Value: %u entries, sum %ju\n", ValueRes.Count,
+	    (uintmax_t)ValueRes.Sum);
+	printf("Document: %u entries, sum %ju\n", DocRes.Count,
+	    (uintmax_t)DocRes.Sum);
+	return (0);
+}
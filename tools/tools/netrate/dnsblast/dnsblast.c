@@ -0,0 +1,280 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Closed-loop DNS load generator.  Every thread owns a UDP socket and
+ * keeps a fixed number of queries outstanding against the server,
+ * sending a new query for every answer that comes back.  Queries that
+ * are not answered within a second are counted as lost and sent again.
+ * At the end, the answer rate and the mean latency are printed.
+ *
+ * Meant for loopback measurements of a resolver answering from its
+ * cache, e.g. unbound with a local-data entry for the query name.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <netinet/in.h>
+#include <netdb.h>			/* getaddrinfo */
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define	MAXTHREADS	64
+#define	MAXWINDOW	4096
+#define	TIMEOUT_NS	1000000000LL
+
+struct slot {
+	struct timespec	sent;
+	int		busy;
+};
+
+struct td_desc {
+	pthread_t	td_id;
+	int		fd;
+	int		index;
+	uint64_t	answers;
+	uint64_t	lost;
+	uint64_t	latency_ns;	/* Sum over all answers. */
+};
+
+static struct addrinfo *server;
+static u_char	query[512];
+static size_t	query_len;
+static int	window = 32;
+static int	duration = 10;
+static volatile int global_stop_flag;
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "dnsblast [-c window] [-d duration] [-n qname] "
+	    "[-t threads] ip port\n");
+	exit(-1);
+}
+
+static int64_t
+ts_diff(const struct timespec *a, const struct timespec *b)
+{
+
+	return ((int64_t)(a->tv_sec - b->tv_sec) * 1000000000LL +
+	    (a->tv_nsec - b->tv_nsec));
+}
+
+/*
+ * Build a recursion-desired query for an A record.  Only the ID is
+ * changed before every send.
+ */
+static void
+build_query(const char *qname)
+{
+	const char *label, *dot;
+	u_char *p;
+	size_t len;
+
+	memset(query, 0, sizeof(query));
+	query[2] = 0x01;		/* RD */
+	query[5] = 1;			/* QDCOUNT */
+	p = query + 12;
+	for (label = qname; *label != '\0'; label = dot + 1) {
+		dot = strchr(label, '.');
+		if (dot == NULL)
+			dot = label + strlen(label);
+		len = dot - label;
+		if (len == 0 || len > 63 || p + len + 6 >= query + 255)
+			errx(-1, "bad query name %s", qname);
+		*p++ = (u_char)len;
+		memcpy(p, label, len);
+		p += len;
+		if (*dot == '\0')
+			break;
+	}
+	*p++ = 0;
+	*p++ = 0; *p++ = 1;		/* QTYPE A */
+	*p++ = 0; *p++ = 1;		/* QCLASS IN */
+	query_len = p - query;
+}
+
+static void
+send_query(struct td_desc *t, struct slot *slots, int i)
+{
+
+	query[0] = (u_char)(i >> 8);
+	query[1] = (u_char)i;
+	clock_gettime(CLOCK_MONOTONIC, &slots[i].sent);
+	slots[i].busy = 1;
+	/*
+	 * A failed send looks like a lost query; it is retried after
+	 * the timeout.
+	 */
+	(void)send(t->fd, query, query_len, 0);
+}
+
+static void *
+blast(void *arg)
+{
+	struct td_desc *t = arg;
+	struct slot *slots;
+	struct timespec now, last_check;
+	struct pollfd pfd;
+	u_char buf[4096];
+	ssize_t n;
+	int i, id;
+
+	slots = calloc(window, sizeof(*slots));
+	if (slots == NULL)
+		err(-1, "calloc");
+	for (i = 0; i < window; i++)
+		send_query(t, slots, i);
+	clock_gettime(CLOCK_MONOTONIC, &last_check);
+
+	pfd.fd = t->fd;
+	pfd.events = POLLIN;
+	while (!global_stop_flag) {
+		if (poll(&pfd, 1, 100) < 0 && errno != EINTR)
+			err(-1, "poll");
+		while ((n = recv(t->fd, buf, sizeof(buf), 0)) >= 12) {
+			id = (buf[0] << 8) | buf[1];
+			if (id >= window || !slots[id].busy ||
+			    (buf[2] & 0x80) == 0)
+				continue;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			t->latency_ns += ts_diff(&now, &slots[id].sent);
+			t->answers++;
+			send_query(t, slots, id);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (ts_diff(&now, &last_check) < TIMEOUT_NS / 10)
+			continue;
+		last_check = now;
+		for (i = 0; i < window; i++) {
+			if (ts_diff(&now, &slots[i].sent) > TIMEOUT_NS) {
+				t->lost++;
+				send_query(t, slots, i);
+			}
+		}
+	}
+	free(slots);
+	return (NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct addrinfo hints;
+	struct td_desc *tds;
+	struct timespec start, end;
+	uint64_t answers, lost, latency_ns;
+	const char *qname = "example.com";
+	double secs;
+	int ch, i, nthreads = 1, error;
+
+	while ((ch = getopt(argc, argv, "c:d:n:t:")) != -1) {
+		switch (ch) {
+		case 'c':
+			window = atoi(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'n':
+			qname = optarg;
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 2 || window < 1 || window > MAXWINDOW ||
+	    duration < 1 || nthreads < 1 || nthreads > MAXTHREADS)
+		usage();
+	build_query(qname);
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = PF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	error = getaddrinfo(argv[0], argv[1], &hints, &server);
+	if (error != 0)
+		errx(-1, "%s", gai_strerror(error));
+
+	tds = calloc(nthreads, sizeof(*tds));
+	if (tds == NULL)
+		err(-1, "calloc");
+	for (i = 0; i < nthreads; i++) {
+		tds[i].index = i;
+		tds[i].fd = socket(server->ai_family, server->ai_socktype,
+		    server->ai_protocol);
+		if (tds[i].fd < 0)
+			err(-1, "socket");
+		if (connect(tds[i].fd, server->ai_addr,
+		    server->ai_addrlen) < 0)
+			err(-1, "connect");
+		if (fcntl(tds[i].fd, F_SETFL, O_NONBLOCK) < 0)
+			err(-1, "fcntl");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&tds[i].td_id, NULL, blast, &tds[i]) != 0)
+			errx(-1, "pthread_create failed");
+	sleep(duration);
+	global_stop_flag = 1;
+	answers = lost = latency_ns = 0;
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(tds[i].td_id, NULL);
+		answers += tds[i].answers;
+		lost += tds[i].lost;
+		latency_ns += tds[i].latency_ns;
+		close(tds[i].fd);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = ts_diff(&end, &start) / 1e9;
+
+	printf("answers %ju in %.2f s: %.0f qps, mean latency %.1f us, "
+	    "lost %ju\n", (uintmax_t)answers, secs, answers / secs,
+	    answers ? latency_ns / 1e3 / answers : 0.0, (uintmax_t)lost);
+	freeaddrinfo(server);
+	free(tds);
+	return (0);
+}
@@ -0,0 +1,169 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Scaling benchmark for llvm::parallel and llvm::ThreadPool.  Each phase
+ * runs the same total amount of busy work, split into items:
+ *
+ *   flat	parallelForEachN() over all items;
+ *   nested	a parallelForEachN() over a few groups, each of which runs a
+ *		parallelForEachN() over its items, as a linker does when it
+ *		handles the sections of a handful of large inputs;
+ *   sort	parallelSort() of random numbers;
+ *   pool	one ThreadPool::async() per item, then ThreadPool::wait().
+ *
+ * The executor behind llvm::parallel is created once per process, so the
+ * number of threads is fixed by -j; "make bench" runs it for several.
+ */
+
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
+#include <err.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace llvm;
+
+static std::atomic<uint64_t> Sink;
+
+/* Roughly Work nanoseconds of computation that cannot be optimized out. */
+static void
+spin(uint64_t Seed, unsigned Work)
+{
+	uint64_t X = Seed | 1;
+
+	for (unsigned I = 0; I < Work; ++I) {
+		X ^= X << 13;
+		X ^= X >> 7;
+		X ^= X << 17;
+	}
+	Sink.fetch_add(X, std::memory_order_relaxed);
+}
+
+template <typename Fn>
+static void
+report(const char *Name, size_t Items, unsigned Rounds, Fn F)
+{
+	auto Start = std::chrono::steady_clock::now();
+	for (unsigned R = 0; R < Rounds; ++R)
+		F();
+	auto End = std::chrono::steady_clock::now();
+	double NS = std::chrono::duration<double, std::nano>(End - Start).count();
+
+	printf("%-8s %10.2f ms %10.1f ns/item\n", Name, NS / 1e6 / Rounds,
+	    NS / Rounds / Items);
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "parallelbench [-j threads] [-n items] [-g groups] "
+	    "[-w work] [-r rounds]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned Threads = 0, Groups = 4, Work = 1000, Rounds = 5;
+	size_t Items = 100000;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "g:j:n:r:w:")) != -1) {
+		switch (ch) {
+		case 'g':
+			Groups = strtoul(optarg, NULL, 0);
+			break;
+		case 'j':
+			Threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			Items = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			Rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			Work = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (Groups == 0 || Items < Groups || Rounds == 0)
+		usage();
+
+	parallel::strategy = hardware_concurrency(Threads);
+	printf("%u threads, %zu items of %u steps\n",
+	    parallel::strategy.compute_thread_count(), Items, Work);
+
+	report("flat", Items, Rounds, [&] {
+		parallelForEachN(0, Items, [&](size_t I) { spin(I, Work); });
+	});
+
+	report("nested", Items, Rounds, [&] {
+		size_t PerGroup = Items / Groups;
+		parallelForEachN(0, Groups, [&](size_t G) {
+			parallelForEachN(G * PerGroup, (G + 1) * PerGroup,
+			    [&](size_t I) { spin(I, Work); });
+		});
+	});
+
+	std::vector<uint64_t> Numbers(Items * 10);
+	report("sort", Numbers.size(), Rounds, [&] {
+		uint64_t X = 88172645463325252ULL;
+		for (uint64_t &N : Numbers) {
+			X ^= X << 13;
+			X ^= X >> 7;
+			X ^= X << 17;
+			N = X;
+		}
+		parallelSort(Numbers.begin(), Numbers.end());
+	});
+	if (!std::is_sorted(Numbers.begin(), Numbers.end()))
+		errx(1, "parallelSort did not sort");
+
+	ThreadPool Pool(hardware_concurrency(Threads));
+	report("pool", Items, Rounds, [&] {
+		for (size_t I = 0; I < Items; ++I)
+			Pool.async([I, Work] { spin(I, Work); });
+		Pool.wait();
+	});
+
+	return (0);
+}
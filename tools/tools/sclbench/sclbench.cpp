@@ -0,0 +1,214 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Benchmark for llvm::SpecialCaseList lookups with a large sanitizer
+ * ignore list.  The list is made up of the usual kinds of entries:
+ * exact function names, "fun:*Name*" and "fun:_ZN4name*" wildcards,
+ * source directory wildcards, a few "=init" categories and a sprinkling
+ * of real regular expressions.  It is then queried with function names and source
+ * paths, most of which are not listed, as an instrumented build does for
+ * every function and file.
+ *
+ * The output ends with the number of queries that matched and the sum of
+ * the lines they matched, which must not depend on how the list is
+ * searched.
+ */
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SpecialCaseList.h"
+
+#include <err.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static const char *Words[] = {
+	"alloc", "buffer", "cache", "decode", "entry", "frame", "graph",
+	"hash", "index", "json", "kernel", "lexer", "mutex", "node", "object",
+	"parser", "queue", "render", "socket", "thread", "unwind", "vector",
+	"worker", "xml", "yield", "zone",
+};
+
+static std::string
+name(std::mt19937 &R)
+{
+	std::string S;
+	unsigned N = 1 + R() % 3;
+
+	for (unsigned I = 0; I < N; ++I) {
+		S += Words[R() % (sizeof(Words) / sizeof(Words[0]))];
+		S += std::to_string(R() % 1000);
+	}
+	return (S);
+}
+
+static std::string
+mangled(std::mt19937 &R)
+{
+	std::string NS = name(R), Fn = name(R);
+
+	return ("_ZN" + std::to_string(NS.size()) + NS +
+	    std::to_string(Fn.size()) + Fn + "Ev");
+}
+
+static std::string
+path(std::mt19937 &R)
+{
+
+	return ("/usr/src/" + name(R) + "/" + name(R) + ".cpp");
+}
+
+static std::string
+makeList(std::mt19937 &R, unsigned Entries)
+{
+	std::string S = "# Generated ignore list\n[address|thread|memory]\n";
+
+	for (unsigned I = 0; I < Entries; ++I) {
+		switch (R() % 10) {
+		case 0:
+		case 1:
+			S += "fun:" + mangled(R) + "\n";
+			break;
+		case 2:
+		case 3:
+		case 4:
+			S += "fun:*" + name(R) + "*\n";
+			break;
+		case 5:
+			S += "fun:_ZN" + std::to_string(R() % 20) + name(R) +
+			    "*\n";
+			break;
+		case 6:
+		case 7:
+			S += "src:*/" + name(R) + "/*\n";
+			break;
+		case 8:
+			S += "global:*" + name(R) + "*=init\n";
+			break;
+		default:
+			S += "fun:*" + name(R) + "[[:digit:]]*_" +
+			    std::string(1, 'a' + R() % 26) + "?*\n";
+			break;
+		}
+	}
+	return (S);
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "sclbench [-n entries] [-q queries] [-r rounds]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned Entries = 10000, Queries = 20000, Rounds = 3;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:q:r:")) != -1) {
+		switch (ch) {
+		case 'n':
+			Entries = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			Queries = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			Rounds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (Queries == 0 || Rounds == 0)
+		usage();
+
+	std::mt19937 R(1);
+	std::string List = makeList(R, Entries);
+	std::vector<std::pair<std::string, std::string>> Query;
+	for (unsigned I = 0; I < Queries; ++I) {
+		switch (R() % 3) {
+		case 0:
+			Query.emplace_back("fun", mangled(R));
+			break;
+		case 1:
+			Query.emplace_back("src", path(R));
+			break;
+		default:
+			Query.emplace_back("global", name(R));
+			break;
+		}
+	}
+
+	auto Start = std::chrono::steady_clock::now();
+	std::unique_ptr<MemoryBuffer> MB = MemoryBuffer::getMemBuffer(List);
+	std::string Error;
+	std::unique_ptr<SpecialCaseList> SCL =
+	    SpecialCaseList::create(MB.get(), Error);
+	if (!SCL)
+		errx(1, "%s", Error.c_str());
+	double Load = std::chrono::duration<double, std::milli>(
+	    std::chrono::steady_clock::now() - Start).count();
+
+	unsigned Matches = 0;
+	uint64_t Lines = 0;
+	Start = std::chrono::steady_clock::now();
+	for (unsigned Round = 0; Round < Rounds; ++Round) {
+		for (const auto &Q : Query) {
+			unsigned Line = SCL->inSectionBlame("address", Q.first,
+			    Q.second, Q.first == "global" ? "init" : "");
+			if (Round == 0 && Line != 0) {
+				Matches++;
+				Lines += Line;
+			}
+		}
+	}
+	double NS = std::chrono::duration<double, std::nano>(
+	    std::chrono::steady_clock::now() - Start).count();
+
+	printf("%u entries: load %.1f ms, %.0f ns/query\n", Entries, Load,
+	    NS / ((double)Rounds * Queries));
+	printf("%u of %u queries matched, line sum %ju\n", Matches, Queries,
+	    (uintmax_t)Lines);
+	return (0);
+}
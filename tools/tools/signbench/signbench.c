@@ -0,0 +1,300 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Zone signing benchmark for libldns.  A zone with the given number of
+ * names is generated in memory, with an A record for every name and an
+ * AAAA or a TXT record for some of them, and is signed with a fresh
+ * KSK and ZSK, using NSEC or NSEC3.  The time spent in the signing
+ * call is printed, together with a digest of the records it created,
+ * in order and without key tags and signature data, so that runs with and
+ * without threads can be compared.  With -v, every signature in the
+ * zone is verified afterwards.
+ */
+
+#include <sys/types.h>
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ldns/ldns.h>
+
+#define	ORIGIN		"example."
+#define	INCEPTION	1790000000U
+#define	EXPIRATION	1800000000U
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "signbench [-3tv] [-a algorithm] [-i iterations] "
+	    "[-n names]\n");
+	exit(-1);
+}
+
+static void
+add_rr(ldns_dnssec_zone *zone, const char *str)
+{
+	ldns_rr *rr;
+	ldns_status s;
+
+	s = ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL);
+	if (s != LDNS_STATUS_OK)
+		errx(-1, "%s: %s", str, ldns_get_errorstr_by_id(s));
+	s = ldns_dnssec_zone_add_rr(zone, rr);
+	if (s != LDNS_STATUS_OK)
+		errx(-1, "%s: %s", str, ldns_get_errorstr_by_id(s));
+}
+
+static void
+add_key(ldns_dnssec_zone *zone, ldns_key_list *keys,
+    ldns_signing_algorithm alg, uint16_t flags)
+{
+	ldns_key *key;
+	ldns_rr *rr;
+	ldns_rdf *origin;
+
+	key = ldns_key_new_frm_algorithm(alg, alg == LDNS_SIGN_RSASHA256 ?
+	    2048 : 256);
+	if (key == NULL)
+		errx(-1, "cannot create a key for algorithm %d", alg);
+	origin = ldns_dname_new_frm_str(ORIGIN);
+	ldns_key_set_pubkey_owner(key, origin);
+	ldns_key_set_flags(key, flags);
+	ldns_key_set_inception(key, INCEPTION);
+	ldns_key_set_expiration(key, EXPIRATION);
+	rr = ldns_key2rr(key);
+	ldns_key_set_keytag(key, ldns_calc_keytag(rr));
+	if (ldns_dnssec_zone_add_rr(zone, rr) != LDNS_STATUS_OK)
+		errx(-1, "cannot add the DNSKEY record");
+	ldns_key_list_push_key(keys, key);
+}
+
+/*
+ * Verify the signatures of an RRset with the zone keys.  Returns the
+ * number of signatures that do not verify, and adds the number of
+ * signatures to *count.
+ */
+static long
+verify_rrs(ldns_dnssec_rrs *rrs, ldns_dnssec_rrs *sigs, ldns_rr_list *dnskeys,
+    long *count)
+{
+	ldns_rr_list *rrset;
+	long bad = 0;
+
+	rrset = ldns_rr_list_new();
+	for (; rrs != NULL; rrs = rrs->next)
+		ldns_rr_list_push_rr(rrset, rrs->rr);
+	for (; sigs != NULL; sigs = sigs->next) {
+		(*count)++;
+		if (ldns_verify_rrsig_keylist_notime(rrset, sigs->rr, dnskeys,
+		    NULL) != LDNS_STATUS_OK)
+			bad++;
+	}
+	ldns_rr_list_free(rrset);
+	return (bad);
+}
+
+static void
+verify_zone(ldns_dnssec_zone *zone, ldns_key_list *keys)
+{
+	ldns_rbnode_t *node;
+	ldns_dnssec_name *name;
+	ldns_dnssec_rrsets *rrset;
+	ldns_dnssec_rrs nsec;
+	ldns_rr_list *dnskeys;
+	long bad = 0, sigs = 0;
+	size_t i;
+
+	dnskeys = ldns_rr_list_new();
+	for (i = 0; i < ldns_key_list_key_count(keys); i++)
+		ldns_rr_list_push_rr(dnskeys,
+		    ldns_key2rr(ldns_key_list_key(keys, i)));
+	for (node = ldns_rbtree_first(zone->names); node != LDNS_RBTREE_NULL;
+	    node = ldns_rbtree_next(node)) {
+		name = (ldns_dnssec_name *)node->data;
+		for (rrset = name->rrsets; rrset != NULL; rrset = rrset->next) {
+			bad += verify_rrs(rrset->rrs, rrset->signatures,
+			    dnskeys, &sigs);
+		}
+		if (name->nsec != NULL) {
+			nsec.rr = name->nsec;
+			nsec.next = NULL;
+			bad += verify_rrs(&nsec, name->nsec_signatures,
+			    dnskeys, &sigs);
+		}
+	}
+	ldns_rr_list_deep_free(dnskeys);
+	printf("%ld signatures, %ld bad\n", sigs, bad);
+	if (bad != 0)
+		exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	ldns_dnssec_zone *zone;
+	ldns_key_list *keys;
+	ldns_rr_list *new_rrs;
+	ldns_rr *rr;
+	ldns_rdf *sig, *keytag, *notag;
+	ldns_buffer *buf;
+	ldns_sha256_CTX ctx;
+	ldns_lookup_table *lt;
+	ldns_signing_algorithm alg = LDNS_SIGN_ECDSAP256SHA256;
+	struct timespec start, end;
+	uint8_t digest[LDNS_SHA256_DIGEST_LENGTH];
+	uint8_t salt[4] = { 0xab, 0xcd, 0xef, 0x01 };
+	char str[256];
+	long names = 1000000, i;
+	double secs;
+	int ch, nsec3 = 0, flags = 0, iterations = 5, verify = 0;
+	ldns_status s;
+
+	while ((ch = getopt(argc, argv, "3a:i:n:tv")) != -1) {
+		switch (ch) {
+		case '3':
+			nsec3 = 1;
+			break;
+		case 'a':
+			lt = ldns_lookup_by_name(ldns_signing_algorithms,
+			    optarg);
+			if (lt == NULL)
+				errx(-1, "unknown algorithm %s", optarg);
+			alg = lt->id;
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'n':
+			names = atol(optarg);
+			break;
+		case 't':
+			flags |= LDNS_SIGN_WITH_THREADS;
+			break;
+		case 'v':
+			verify = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc != optind || names < 1 || iterations < 0 ||
+	    iterations > 65535)
+		usage();
+
+	zone = ldns_dnssec_zone_new();
+	if (zone == NULL)
+		errx(-1, "ldns_dnssec_zone_new failed");
+	add_rr(zone, ORIGIN " 3600 IN SOA ns." ORIGIN " hostmaster." ORIGIN
+	    " 1 7200 3600 1209600 300");
+	add_rr(zone, ORIGIN " 3600 IN NS ns." ORIGIN);
+	for (i = 0; i < names; i++) {
+		snprintf(str, sizeof(str), "h%ld." ORIGIN " 3600 IN A "
+		    "10.%ld.%ld.%ld", i, (i >> 16) & 0xff, (i >> 8) & 0xff,
+		    i & 0xff);
+		add_rr(zone, str);
+		if (i % 4 == 1) {
+			snprintf(str, sizeof(str), "h%ld." ORIGIN
+			    " 3600 IN AAAA 2001:db8::%lx", i, i & 0xffff);
+			add_rr(zone, str);
+		} else if (i % 4 == 3) {
+			snprintf(str, sizeof(str), "h%ld." ORIGIN
+			    " 3600 IN TXT \"host %ld\"", i, i);
+			add_rr(zone, str);
+		}
+	}
+	keys = ldns_key_list_new();
+	add_key(zone, keys, alg, LDNS_KEY_ZONE_KEY | LDNS_KEY_SEP_KEY);
+	add_key(zone, keys, alg, LDNS_KEY_ZONE_KEY);
+
+	new_rrs = ldns_rr_list_new();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (nsec3)
+		s = ldns_dnssec_zone_sign_nsec3_flg(zone, new_rrs, keys,
+		    ldns_dnssec_default_replace_signatures, NULL,
+		    LDNS_SHA1, 0, (uint16_t)iterations, sizeof(salt), salt,
+		    flags);
+	else
+		s = ldns_dnssec_zone_sign_flg(zone, new_rrs, keys,
+		    ldns_dnssec_default_replace_signatures, NULL, flags);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (s != LDNS_STATUS_OK)
+		errx(-1, "signing failed: %s", ldns_get_errorstr_by_id(s));
+	secs = (end.tv_sec - start.tv_sec) +
+	    (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	buf = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	notag = ldns_native2rdf_int16(LDNS_RDF_TYPE_INT16, 0);
+	ldns_sha256_init(&ctx);
+	for (i = 0; i < (long)ldns_rr_list_rr_count(new_rrs); i++) {
+		rr = ldns_rr_list_rr(new_rrs, i);
+		/* leave out the key tag and the signature, they change
+		 * with every key */
+		sig = keytag = NULL;
+		if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_RRSIG) {
+			sig = ldns_rr_pop_rdf(rr);
+			keytag = ldns_rr_set_rdf(rr, notag, 6);
+		}
+		ldns_buffer_clear(buf);
+		if (ldns_rr2buffer_wire(buf, rr, LDNS_SECTION_ANSWER) !=
+		    LDNS_STATUS_OK)
+			errx(-1, "cannot convert record %ld", i);
+		if (sig != NULL) {
+			(void)ldns_rr_set_rdf(rr, keytag, 6);
+			ldns_rr_push_rdf(rr, sig);
+		}
+		ldns_sha256_update(&ctx, ldns_buffer_begin(buf),
+		    ldns_buffer_position(buf));
+	}
+	ldns_sha256_final(digest, &ctx);
+
+	printf("%ld names, %zu new records in %.2f s, %.0f records/s%s\n",
+	    names, ldns_rr_list_rr_count(new_rrs), secs,
+	    ldns_rr_list_rr_count(new_rrs) / secs,
+	    flags & LDNS_SIGN_WITH_THREADS ? " (threads)" : "");
+	printf("digest ");
+	for (i = 0; i < LDNS_SHA256_DIGEST_LENGTH; i++)
+		printf("%02x", digest[i]);
+	printf("\n");
+	if (verify)
+		verify_zone(zone, keys);
+
+	ldns_rdf_deep_free(notag);
+	ldns_buffer_free(buf);
+	/* the new records belong to the zone */
+	ldns_rr_list_free(new_rrs);
+	ldns_key_list_free(keys);
+	ldns_dnssec_zone_deep_free(zone);
+	return (0);
+}
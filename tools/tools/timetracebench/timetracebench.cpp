@@ -0,0 +1,187 @@
+/*-
+ * Copyright (c) 2026 The HardenedBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Benchmark for the overhead of llvm::TimeTraceScope, as used by
+ * -ftime-trace.  Each thread opens nested scopes with the kinds of names
+ * and details a compiler front end records, the details being built only
+ * when tracing is on, and does a little work in each.  This is timed with
+ * tracing off, with tracing at the default granularity of 500
+ * microseconds, so that nearly all events are dropped, and with a
+ * granularity of 0, so that every event is kept and then written out.
+ *
+ * With -o, the last trace is written to a file rather than discarded.
+ */
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <err.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+
+static const char *Names[] = {
+	"ParseClass", "ParseTemplate", "InstantiateClass",
+	"InstantiateFunction", "PerformPendingInstantiations", "CodeGen Function",
+	"DebugType", "RunPass", "OptFunction",
+};
+#define	NNAMES	(sizeof(Names) / sizeof(Names[0]))
+
+static volatile unsigned Sink;
+
+static void
+work(unsigned N)
+{
+
+	for (unsigned I = 0; I < N; ++I)
+		Sink = Sink + I;
+}
+
+static void
+scope(unsigned Depth, unsigned &Counter)
+{
+	unsigned I = Counter++;
+
+	TimeTraceScope Scope(Names[I % NNAMES], [&]() {
+		return ("std::vector<std::pair<llvm::StringRef, unsigned>>::"
+		    "emplace_back<" + std::to_string(I) + ">");
+	});
+	work(20);
+	if (Depth > 1) {
+		scope(Depth - 1, Counter);
+		scope(Depth - 1, Counter);
+	}
+}
+
+/* Runs Events events on this thread, in trees of depth 4. */
+static void
+record(unsigned Events)
+{
+	unsigned Counter = 0;
+
+	while (Counter < Events)
+		scope(4, Counter);
+}
+
+static double
+run(int Granularity, unsigned Threads, unsigned Events, const char *Out,
+    double *WriteMs)
+{
+
+	if (Granularity >= 0)
+		timeTraceProfilerInitialize(Granularity, "timetracebench");
+	auto Start = std::chrono::steady_clock::now();
+	std::vector<std::thread> Workers;
+	for (unsigned T = 1; T < Threads; ++T)
+		Workers.emplace_back([&]() {
+			if (Granularity >= 0)
+				timeTraceProfilerInitialize(Granularity,
+				    "timetracebench");
+			record(Events);
+			if (Granularity >= 0)
+				timeTraceProfilerFinishThread();
+		});
+	record(Events);
+	for (std::thread &W : Workers)
+		W.join();
+	double NS = std::chrono::duration<double, std::nano>(
+	    std::chrono::steady_clock::now() - Start).count();
+
+	*WriteMs = 0;
+	if (Granularity >= 0) {
+		Start = std::chrono::steady_clock::now();
+		std::error_code EC;
+		raw_fd_ostream OS(Out != nullptr ? Out : "/dev/null", EC,
+		    sys::fs::OF_None);
+		if (EC)
+			errx(1, "%s: %s", Out, EC.message().c_str());
+		timeTraceProfilerWrite(OS);
+		OS.flush();
+		*WriteMs = std::chrono::duration<double, std::milli>(
+		    std::chrono::steady_clock::now() - Start).count();
+		timeTraceProfilerCleanup();
+	}
+	return (NS / Events);
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr,
+	    "timetracebench [-n events] [-t threads] [-o trace.json]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *Out = nullptr;
+	unsigned Events = 1000000, Threads = 1;
+	double NS, WriteMs;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:o:t:")) != -1) {
+		switch (ch) {
+		case 'n':
+			Events = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			Out = optarg;
+			break;
+		case 't':
+			Threads = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (Events == 0 || Threads == 0)
+		usage();
+
+	NS = run(-1, Threads, Events, nullptr, &WriteMs);
+	printf("off:             %6.1f ns/event\n", NS);
+	NS = run(500, Threads, Events, nullptr, &WriteMs);
+	printf("granularity 500: %6.1f ns/event, write %6.1f ms\n", NS,
+	    WriteMs);
+	NS = run(0, Threads, Events, Out, &WriteMs);
+	printf("granularity 0:   %6.1f ns/event, write %6.1f ms\n", NS,
+	    WriteMs);
+	return (0);
+}
@@ -870,6 +870,9 @@ unzip(const char *fn)
 		error("archive_read_new failed");
 
 	ac(archive_read_support_format_zip(a));
+	/* Inflate upcoming entries on all CPUs when extracting to disk. */
+	if (!zipinfo_mode && !t_opt && !v_opt && !p_opt && !c_opt)
+		ac(archive_read_set_format_option(a, "zip", "threads", "0"));
 	ac(archive_read_open_filename(a, fn, 8192));
 
 	if (!zipinfo_mode) {
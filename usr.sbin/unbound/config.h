@@ -464,9 +464,15 @@
 /* If we have reallocarray(3) */
 #define HAVE_REALLOCARRAY 1
 
+/* Define to 1 if you have the `recvmmsg' function. */
+#define HAVE_RECVMMSG 1
+
 /* Define to 1 if you have the `recvmsg' function. */
 #define HAVE_RECVMSG 1
 
+/* Define to 1 if you have the `sendmmsg' function. */
+#define HAVE_SENDMMSG 1
+
 /* Define to 1 if you have the `sendmsg' function. */
 #define HAVE_SENDMSG 1
 